@@ -0,0 +1,4251 @@
+/**
+ * Offline benchmarks of the capture pipeline, runnable without the engine.
+ *
+ *   capture_bench compress [--size WxH] [--frames N] [--threads N] [--fps N] [--capture file.ucap]
+ *   capture_bench formats [--size WxH] [--frames N]
+ *   capture_bench pipeline [--size WxH] [--frames N] [--threads N] [--fps N] [--compress] [--overflow drop|block|coalesce] [--output file.ucap]
+ *                          [--trace file.json]
+ *   capture_bench ring
+ *   capture_bench container
+ *   capture_bench taps
+ *   capture_bench pack [--size WxH]
+ *   capture_bench pool [--size WxH] [--frames N] [--threads N]
+ *   capture_bench stream [--size WxH] [--frames N]
+ *   capture_bench trace
+ *   capture_bench rate
+ *   capture_bench taa [--frames N] [--threads N]
+ *   capture_bench kernels [--frames N] [--threads N] [--capture file.ucap]
+ *   capture_bench gen5 [--frames N] [--threads N] [--capture file.ucap]
+ *   capture_bench sweep [--frames N] [--threads N]
+ *   capture_bench metrics [--size WxH] [--frames N] [--threads N]
+ *   capture_bench resample [--size WxH] [--frames N] [--threads N]
+ *   capture_bench half [--size WxH]
+ *
+ * Build: g++ -O2 -std=c++17 CaptureBench.cpp CaptureBufferPool.cpp CaptureCompress.cpp CaptureContainer.cpp CaptureDepth.cpp
+ *        CaptureFrame.cpp CaptureHalf.cpp CapturePack.cpp CapturePixelFormat.cpp CaptureReadback.cpp CaptureReader.cpp CaptureSink.cpp
+ *        CaptureFilterKernels.cpp CaptureImage.cpp CaptureMetrics.cpp CaptureParallel.cpp CaptureRateControl.cpp CaptureResample.cpp
+ *        CaptureStream.cpp CaptureTAAGen4.cpp CaptureTAAGen5.cpp CaptureTAASweep.cpp CaptureTap.cpp CaptureTrace.cpp -lpthread
+ *        Add -mavx2 for the eight lane AVX2 path of the CPU kernels.
+ */
+
+#include "CaptureBufferPool.h"
+#include "CaptureCompress.h"
+#include "CaptureContainer.h"
+#include "CaptureDepth.h"
+#include "CaptureFilterKernels.h"
+#include "CaptureFrame.h"
+#include "CaptureHalf.h"
+#include "CaptureImage.h"
+#include "CaptureMetrics.h"
+#include "CapturePack.h"
+#include "CapturePixelFormat.h"
+#include "CaptureRateControl.h"
+#include "CaptureReadback.h"
+#include "CaptureReader.h"
+#include "CaptureResample.h"
+#include "CaptureSimd.h"
+#include "CaptureSink.h"
+#include "CaptureStream.h"
+#include "CaptureTAAGen4.h"
+#include "CaptureTAAGen5.h"
+#include "CaptureTAASweep.h"
+#include "CaptureTap.h"
+#include "CaptureTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+
+struct FBenchOptions
+{
+	int32_t Width = 1280;
+	int32_t Height = 720;
+	uint32_t NumFrames = 32;
+	uint32_t NumThreads = 2;
+	double TargetFps = 60.0;
+	std::string CapturePath;
+
+	/** Set by --size; the pipeline benchmark otherwise sweeps 720p, 1080p and 4K. */
+	bool bCustomSize = false;
+	bool bCompress = false;
+	ECaptureOverflow Overflow = ECaptureOverflow::Block;
+	std::string OutputPath = "capture_bench.ucap";
+
+	/** Pipeline: Chrome trace of every size, the size name is inserted before the extension. */
+	std::string TracePath;
+};
+
+/** One layer to push through a benchmark, either synthesized or copied out of a capture. */
+struct FBenchLayer
+{
+	std::string Name;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t PixelFormat = 0;
+	uint32_t BytesPerPixel = 0;
+	std::vector<uint8_t> Bytes;
+};
+
+/** Round to nearest even float to half, enough for synthetic frames. */
+uint16_t FloatToHalf(float Value)
+{
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+
+	const uint32_t Sign = (Bits >> 16) & 0x8000;
+	const int32_t Exponent = int32_t((Bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t Mantissa = Bits & 0x7FFFFF;
+
+	if (Exponent >= 31)
+	{
+		return uint16_t(Sign | 0x7C00);
+	}
+	if (Exponent <= 0)
+	{
+		if (Exponent < -10)
+		{
+			return uint16_t(Sign);
+		}
+		Mantissa |= 0x800000;
+		const uint32_t Shift = uint32_t(14 - Exponent);
+		const uint32_t Half = Mantissa >> Shift;
+		const uint32_t Rest = Mantissa & ((1u << Shift) - 1);
+		const uint32_t Midpoint = 1u << (Shift - 1);
+		return uint16_t(Sign | (Half + (Rest > Midpoint || (Rest == Midpoint && (Half & 1)))));
+	}
+
+	const uint32_t Half = Sign | (uint32_t(Exponent) << 10) | (Mantissa >> 13);
+	const uint32_t Rest = Mantissa & 0x1FFF;
+	return uint16_t(Half + (Rest > 0x1000 || (Rest == 0x1000 && (Half & 1))));
+}
+
+/**
+ * Scene color, velocity and depth/stencil of a camera pan over smooth shading with a bit of film grain, so
+ * the planes carry roughly the entropy of a real HDR capture. Depth is laid out as the 8 byte DepthPixel of an
+ * unpacked depth/stencil readback.
+ */
+std::vector<FBenchLayer> MakeSyntheticFrame(int32_t Width, int32_t Height, uint32_t FrameIndex, std::mt19937& Random)
+{
+	std::normal_distribution<float> Grain(0.0f, 0.004f);
+
+	FBenchLayer Color;
+	Color.Name = "output";
+	Color.Width = Width;
+	Color.Height = Height;
+	Color.PixelFormat = CapturePF_FloatRGBA;
+	Color.BytesPerPixel = 8;
+	Color.Bytes.resize(size_t(Width) * Height * Color.BytesPerPixel);
+
+	FBenchLayer Velocity;
+	Velocity.Name = "velocity";
+	Velocity.Width = Width;
+	Velocity.Height = Height;
+	Velocity.PixelFormat = CapturePF_G16R16F;
+	Velocity.BytesPerPixel = 4;
+	Velocity.Bytes.resize(size_t(Width) * Height * Velocity.BytesPerPixel);
+
+	FBenchLayer Depth;
+	Depth.Name = "depth";
+	Depth.Width = Width;
+	Depth.Height = Height;
+	Depth.PixelFormat = CapturePF_DepthStencil;
+	Depth.BytesPerPixel = 8;
+	Depth.Bytes.resize(size_t(Width) * Height * Depth.BytesPerPixel);
+
+	uint16_t* ColorData = (uint16_t*)Color.Bytes.data();
+	uint16_t* VelocityData = (uint16_t*)Velocity.Bytes.data();
+	uint8_t* DepthData = Depth.Bytes.data();
+	const float Pan = float(FrameIndex) * 3.0f;
+
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		for (int32_t X = 0; X < Width; X++)
+		{
+			const float U = (float(X) + Pan) / float(Width);
+			const float V = float(Y) / float(Height);
+			const float Shade = 0.5f + 0.5f * std::sin(U * 12.0f) * std::cos(V * 7.0f);
+			const float Sky = V < 0.3f ? 4.0f * (0.3f - V) : 0.0f;
+
+			uint16_t* Pixel = ColorData + (size_t(Y) * Width + X) * 4;
+			Pixel[0] = FloatToHalf(std::max(0.0f, Shade * 0.8f + Sky + Grain(Random)));
+			Pixel[1] = FloatToHalf(std::max(0.0f, Shade * 0.6f + Sky + Grain(Random)));
+			Pixel[2] = FloatToHalf(std::max(0.0f, Shade * 0.3f + Sky * 1.5f + Grain(Random)));
+			Pixel[3] = FloatToHalf(1.0f);
+
+			uint16_t* Motion = VelocityData + (size_t(Y) * Width + X) * 2;
+			Motion[0] = FloatToHalf(3.0f / float(Width) + V * 0.001f);
+			Motion[1] = FloatToHalf(0.0f);
+
+			// Reversed Z of a ground plane below the horizon and the far plane above it.
+			const float DeviceZ = V < 0.3f ? 0.0f : 0.01f / (1.0f + 40.0f * (1.0f - V)) + Shade * 1e-4f;
+			uint8_t* DepthPixel = DepthData + (size_t(Y) * Width + X) * 8;
+			memcpy(DepthPixel, &DeviceZ, sizeof(DeviceZ));
+			DepthPixel[4] = V < 0.3f ? 0 : uint8_t(1 + (X * 4 / Width));
+			DepthPixel[5] = DepthPixel[6] = DepthPixel[7] = 0;
+		}
+	}
+
+	std::vector<FBenchLayer> Layers;
+	Layers.push_back(std::move(Color));
+	Layers.push_back(std::move(Velocity));
+	Layers.push_back(std::move(Depth));
+	return Layers;
+}
+
+/** Copies every layer of the first NumFrames frames of a capture, decoding compressed records. */
+bool LoadCaptureFrames(const std::string& Path, uint32_t NumFrames, std::vector<std::vector<FBenchLayer>>& OutFrames)
+{
+	FCaptureReader Reader;
+	if (!Reader.Open(Path))
+	{
+		fprintf(stderr, "cannot open %s\n", Path.c_str());
+		return false;
+	}
+
+	std::vector<uint8_t> DecodeBuffer;
+	for (uint32_t FrameIndex = 0; FrameIndex < std::min(NumFrames, Reader.GetNumFrames()); FrameIndex++)
+	{
+		std::vector<FBenchLayer> Frame;
+		for (const FCaptureLayerDesc& Desc : Reader.GetContainer().GetLayers())
+		{
+			FCaptureView View;
+			if (!Reader.GetView(FrameIndex, Desc.Name, nullptr, View, &DecodeBuffer))
+			{
+				continue;
+			}
+
+			const FCaptureChunkHeader* Record = Reader.GetContainer().FindRecord(Reader.GetFrameId(FrameIndex), Desc.Name);
+			FBenchLayer Layer;
+			Layer.Name = Desc.Name;
+			Layer.Width = Record->Width;
+			Layer.Height = Record->Height;
+			Layer.PixelFormat = Record->PixelFormat;
+			Layer.BytesPerPixel = Record->BytesPerPixel;
+			Layer.Bytes.assign(View.Data, View.Data + Record->RawSize);
+			Frame.push_back(std::move(Layer));
+		}
+		OutFrames.push_back(std::move(Frame));
+	}
+	return !OutFrames.empty();
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+/**
+ * Encodes every frame on NumThreads threads the way the capture writers would, then decodes and compares.
+ * Reports the ratio per layer, the throughput per thread and the frame rate the pool sustains against the target,
+ * then what the governed writers reach and how much they still encode when the frames arrive at the target rate.
+ */
+int RunCompressBench(const FBenchOptions& Options)
+{
+	std::vector<std::vector<FBenchLayer>> Frames;
+	if (!Options.CapturePath.empty())
+	{
+		if (!LoadCaptureFrames(Options.CapturePath, Options.NumFrames, Frames))
+		{
+			return 1;
+		}
+		printf("compress: %zu frames of %s\n", Frames.size(), Options.CapturePath.c_str());
+	}
+	else
+	{
+		std::mt19937 Random(1234);
+		for (uint32_t FrameIndex = 0; FrameIndex < Options.NumFrames; FrameIndex++)
+		{
+			Frames.push_back(MakeSyntheticFrame(Options.Width, Options.Height, FrameIndex, Random));
+		}
+		printf("compress: %u synthetic frames at %dx%d\n", Options.NumFrames, Options.Width, Options.Height);
+	}
+
+	struct FLayerJob
+	{
+		const FBenchLayer* Layer = nullptr;
+		std::vector<uint8_t> Encoded;
+		double EncodeSeconds = 0.0;
+		double DecodeSeconds = 0.0;
+		bool bMatches = false;
+	};
+
+	std::vector<FLayerJob> Jobs;
+	for (const std::vector<FBenchLayer>& Frame : Frames)
+	{
+		for (const FBenchLayer& Layer : Frame)
+		{
+			Jobs.emplace_back();
+			Jobs.back().Layer = &Layer;
+		}
+	}
+
+	std::atomic<size_t> NextJob(0);
+	auto EncodeMain = [&]()
+	{
+		for (size_t JobIndex = NextJob++; JobIndex < Jobs.size(); JobIndex = NextJob++)
+		{
+			FLayerJob& Job = Jobs[JobIndex];
+			const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+			EncodeCapturePayload(Job.Layer->Bytes.data(), Job.Layer->Width, Job.Layer->Height, Job.Layer->BytesPerPixel, Job.Encoded);
+			Job.EncodeSeconds = SecondsSince(Start);
+		}
+	};
+
+	const std::chrono::steady_clock::time_point EncodeStart = std::chrono::steady_clock::now();
+	{
+		std::vector<std::thread> Threads;
+		for (uint32_t ThreadIndex = 0; ThreadIndex < Options.NumThreads; ThreadIndex++)
+		{
+			Threads.emplace_back(EncodeMain);
+		}
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+	}
+	const double EncodeWallSeconds = SecondsSince(EncodeStart);
+
+	std::vector<uint8_t> Decoded;
+	for (FLayerJob& Job : Jobs)
+	{
+		Decoded.resize(Job.Layer->Bytes.size());
+		const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		const bool bDecoded = DecodeCapturePayload(Job.Encoded.data(), Job.Encoded.size(), Job.Layer->Width, Job.Layer->Height, Job.Layer->BytesPerPixel, Decoded.data());
+		Job.DecodeSeconds = SecondsSince(Start);
+		Job.bMatches = bDecoded && Decoded == Job.Layer->Bytes;
+	}
+
+	// Per layer name totals.
+	std::vector<std::string> Names;
+	for (const FLayerJob& Job : Jobs)
+	{
+		if (std::find(Names.begin(), Names.end(), Job.Layer->Name) == Names.end())
+		{
+			Names.push_back(Job.Layer->Name);
+		}
+	}
+
+	uint64_t TotalRaw = 0;
+	uint64_t TotalEncoded = 0;
+	double TotalEncodeSeconds = 0.0;
+	double TotalDecodeSeconds = 0.0;
+	uint64_t NumMismatches = 0;
+
+	printf("  %-16s %10s %10s %8s %12s %12s\n", "layer", "raw MB", "coded MB", "ratio", "enc GB/s", "dec GB/s");
+	for (const std::string& Name : Names)
+	{
+		uint64_t Raw = 0;
+		uint64_t Encoded = 0;
+		double EncodeSeconds = 0.0;
+		double DecodeSeconds = 0.0;
+		for (const FLayerJob& Job : Jobs)
+		{
+			if (Job.Layer->Name == Name)
+			{
+				Raw += Job.Layer->Bytes.size();
+				Encoded += Job.Encoded.size();
+				EncodeSeconds += Job.EncodeSeconds;
+				DecodeSeconds += Job.DecodeSeconds;
+				NumMismatches += Job.bMatches ? 0 : 1;
+			}
+		}
+
+		printf("  %-16s %10.1f %10.1f %8.2f %12.2f %12.2f\n", Name.c_str(), double(Raw) / 1e6, double(Encoded) / 1e6,
+			double(Raw) / double(std::max<uint64_t>(Encoded, 1)), double(Raw) / EncodeSeconds / 1e9, double(Raw) / DecodeSeconds / 1e9);
+
+		TotalRaw += Raw;
+		TotalEncoded += Encoded;
+		TotalEncodeSeconds += EncodeSeconds;
+		TotalDecodeSeconds += DecodeSeconds;
+	}
+
+	const double FramesPerSecond = double(Frames.size()) / EncodeWallSeconds;
+	printf("  %-16s %10.1f %10.1f %8.2f %12.2f %12.2f\n", "total", double(TotalRaw) / 1e6, double(TotalEncoded) / 1e6,
+		double(TotalRaw) / double(std::max<uint64_t>(TotalEncoded, 1)), double(TotalRaw) / TotalEncodeSeconds / 1e9, double(TotalRaw) / TotalDecodeSeconds / 1e9);
+	printf("  %u writer threads: %.2f GB/s, %.1f frames/s encoding every layer, %.0f%% of %.0f fps\n", Options.NumThreads,
+		double(TotalRaw) / EncodeWallSeconds / 1e9, FramesPerSecond, 100.0 * FramesPerSecond / Options.TargetFps, Options.TargetFps);
+
+	// The writers the way r.Capture.Compression 1 runs them: frames arrive at the target rate and the governor has
+	// the layers the pool cannot encode in time stored raw. Two seconds of frames, cycling the ones above.
+	const uint32_t NumPacedFrames = std::max<uint32_t>(uint32_t(Frames.size()), uint32_t(2.0 * Options.TargetFps));
+	FCaptureCompressionGovernor Governor(Options.NumThreads, 4.0 / Options.TargetFps);
+
+	struct FPacedJob
+	{
+		const FBenchLayer* Layer = nullptr;
+		std::chrono::steady_clock::time_point ArrivalTime;
+	};
+	std::vector<FPacedJob> PacedJobs;
+	const std::chrono::steady_clock::time_point PacedStart = std::chrono::steady_clock::now();
+	for (uint32_t FrameIndex = 0; FrameIndex < NumPacedFrames; FrameIndex++)
+	{
+		const std::chrono::steady_clock::time_point ArrivalTime = PacedStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(double(FrameIndex) / Options.TargetFps));
+		for (const FBenchLayer& Layer : Frames[FrameIndex % Frames.size()])
+		{
+			PacedJobs.push_back({ &Layer, ArrivalTime });
+		}
+	}
+
+	std::atomic<size_t> NextPacedJob(0);
+	std::atomic<uint64_t> PacedRaw(0);
+	std::atomic<uint64_t> PacedEncodedRaw(0);
+	std::atomic<uint64_t> PacedStored(0);
+	auto PacedMain = [&]()
+	{
+		std::vector<uint8_t> Encoded;
+		for (size_t JobIndex = NextPacedJob++; JobIndex < PacedJobs.size(); JobIndex = NextPacedJob++)
+		{
+			const FPacedJob& Job = PacedJobs[JobIndex];
+			std::this_thread::sleep_until(Job.ArrivalTime);
+
+			const uint64_t RawBytes = Job.Layer->Bytes.size();
+			uint64_t StoredBytes = RawBytes;
+			if (Governor.Admit(RawBytes, Job.ArrivalTime))
+			{
+				const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+				EncodeCapturePayload(Job.Layer->Bytes.data(), Job.Layer->Width, Job.Layer->Height, Job.Layer->BytesPerPixel, Encoded);
+				Governor.AddEncode(RawBytes, SecondsSince(Start));
+				StoredBytes = Encoded.size();
+				PacedEncodedRaw += RawBytes;
+			}
+			PacedRaw += RawBytes;
+			PacedStored += StoredBytes;
+		}
+	};
+	{
+		std::vector<std::thread> Threads;
+		for (uint32_t ThreadIndex = 0; ThreadIndex < Options.NumThreads; ThreadIndex++)
+		{
+			Threads.emplace_back(PacedMain);
+		}
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+	}
+
+	// The last frame arrives (NumPacedFrames - 1) / fps in, so a pool that keeps up ends one frame later.
+	const double PacedFramesPerSecond = double(NumPacedFrames) / SecondsSince(PacedStart);
+	const double PacedEncodedShare = double(PacedEncodedRaw.load()) / double(std::max<uint64_t>(PacedRaw.load(), 1));
+	printf("  paced at %.0f fps: %.1f frames/s written, %.0f%% of the bytes encoded, %u layers stored raw, ratio %.2f\n", Options.TargetFps,
+		PacedFramesPerSecond, 100.0 * PacedEncodedShare, uint32_t(Governor.GetNumBypassed()),
+		double(PacedRaw.load()) / double(std::max<uint64_t>(PacedStored.load(), 1)));
+	if (FramesPerSecond < Options.TargetFps)
+	{
+		printf("  the codec keeps up with %.1f fps, not %.0f; the paced rate is held by storing %.0f%% of the bytes raw\n", FramesPerSecond,
+			Options.TargetFps, 100.0 * (1.0 - PacedEncodedShare));
+	}
+	printf("  round trip: %s\n", NumMismatches ? "MISMATCH" : "bit exact");
+
+	return NumMismatches ? 2 : 0;
+}
+
+/**
+ * Packs synthetic surfaces of every known format whose rows are padded the way drivers pad staging
+ * buffers, checks that no padding byte leaks into the packed rows, then times the row copy against a
+ * byte loop at the requested size.
+ */
+int RunFormatsCheck(const FBenchOptions& Options)
+{
+	const uint8_t PaddingByte = 0xCD;
+	const int32_t Widths[] = { 1, 3, 17, 64, 333, 1280 };
+	const uint32_t PitchAlignments[] = { 1, 4, 256 };
+	std::mt19937 Random(7);
+
+	uint32_t NumFormats = 0;
+	const FCapturePixelFormatDesc* Formats = GetCapturePixelFormats(NumFormats);
+
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	for (uint32_t FormatIndex = 0; FormatIndex < NumFormats; FormatIndex++)
+	{
+		const FCapturePixelFormatDesc& Desc = Formats[FormatIndex];
+
+		const uint32_t ChannelBytes = Desc.NumChannels * GetCaptureElementSize(Desc.ElementType);
+		if (FindCapturePixelFormat(Desc.PixelFormat) != &Desc || (ChannelBytes != Desc.BytesPerPixel && !Desc.bDepthStencil))
+		{
+			printf("  %-20s descriptor is inconsistent\n", Desc.Name);
+			NumFailures++;
+			continue;
+		}
+
+		for (int32_t Width : Widths)
+		{
+			for (uint32_t Alignment : PitchAlignments)
+			{
+				// One extra alignment step of padding plus an odd source offset exercises the unaligned paths.
+				const int32_t Height = 5;
+				const uint64_t RowBytes = uint64_t(Width) * Desc.BytesPerPixel;
+				const uint64_t RowPitch = (RowBytes + Alignment - 1) / Alignment * Alignment + Alignment;
+				std::vector<uint8_t> Surface(RowPitch * Height + 1, PaddingByte);
+				std::vector<uint8_t> Expected(RowBytes * Height);
+
+				uint8_t* Rows = Surface.data() + 1;
+				for (int32_t Y = 0; Y < Height; Y++)
+				{
+					for (uint64_t X = 0; X < RowBytes; X++)
+					{
+						// Never the padding value, so a leak cannot go unnoticed.
+						const uint8_t Value = uint8_t(Random() % 0xCD);
+						Rows[Y * RowPitch + X] = Value;
+						Expected[Y * RowBytes + X] = Value;
+					}
+				}
+
+				std::vector<uint8_t> Packed;
+				NumCases++;
+				if (!PackCaptureSurface(Rows, RowPitch, Width, Height, Desc.BytesPerPixel, Packed) || Packed != Expected)
+				{
+					printf("  %-20s width %d pitch %llu: packed rows differ\n", Desc.Name, Width, (unsigned long long)RowPitch);
+					NumFailures++;
+				}
+			}
+		}
+	}
+
+	// A pitch shorter than a row means the caller got the format wrong, which must not be packed anyway.
+	std::vector<uint8_t> Rejected;
+	const uint8_t Pixel[8] = {};
+	NumCases++;
+	if (PackCaptureSurface(Pixel, 4, 1, 1, 8, Rejected))
+	{
+		printf("  surface with a pitch shorter than its row was packed\n");
+		NumFailures++;
+	}
+
+	printf("formats: %u formats, %u padded surfaces, %u failures\n", NumFormats, NumCases, NumFailures);
+
+	// Throughput at the requested size, FloatRGBA with a 256 byte pitch alignment.
+	const uint64_t RowBytes = uint64_t(Options.Width) * 8;
+	const uint64_t RowPitch = (RowBytes + 255) / 256 * 256 + 256;
+	std::vector<uint8_t> Surface(RowPitch * Options.Height, 1);
+	std::vector<uint8_t> Packed(RowBytes * Options.Height);
+
+	std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for (uint32_t Frame = 0; Frame < Options.NumFrames; Frame++)
+	{
+		CopyCaptureRows(Packed.data(), RowBytes, Surface.data(), RowPitch, RowBytes, uint32_t(Options.Height));
+	}
+	const double CopySeconds = SecondsSince(Start);
+
+	Start = std::chrono::steady_clock::now();
+	for (uint32_t Frame = 0; Frame < Options.NumFrames; Frame++)
+	{
+		for (int32_t Y = 0; Y < Options.Height; Y++)
+		{
+			volatile uint8_t* Dest = Packed.data() + Y * RowBytes;
+			for (uint64_t X = 0; X < RowBytes; X++)
+			{
+				Dest[X] = Surface[Y * RowPitch + X];
+			}
+		}
+	}
+	const double ByteLoopSeconds = SecondsSince(Start);
+
+	const double Bytes = double(RowBytes) * Options.Height * Options.NumFrames;
+	printf("  row copy %dx%d FloatRGBA: %.2f GB/s (byte loop %.2f GB/s)\n", Options.Width, Options.Height, Bytes / CopySeconds / 1e9, Bytes / ByteLoopSeconds / 1e9);
+
+	return NumFailures ? 2 : 0;
+}
+
+/** Peak resident set of the process in bytes. */
+uint64_t GetPeakMemoryBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS Counters = {};
+	return GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)) ? uint64_t(Counters.PeakWorkingSetSize) : 0;
+#else
+	struct rusage Usage = {};
+	return getrusage(RUSAGE_SELF, &Usage) == 0 ? uint64_t(Usage.ru_maxrss) * 1024 : 0;
+#endif
+}
+
+/** Page faults the process took so far, soft ones included. */
+uint64_t GetPageFaults()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS Counters = {};
+	return GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)) ? uint64_t(Counters.PageFaultCount) : 0;
+#else
+	struct rusage Usage = {};
+	return getrusage(RUSAGE_SELF, &Usage) == 0 ? uint64_t(Usage.ru_minflt) + uint64_t(Usage.ru_majflt) : 0;
+#endif
+}
+
+uint64_t GetFileSize(const std::string& Path)
+{
+	std::ifstream File(Path, std::ios::binary | std::ios::ate);
+	return File ? uint64_t(File.tellg()) : 0;
+}
+
+double Percentile(std::vector<double> Values, double Fraction)
+{
+	if (Values.empty())
+	{
+		return 0.0;
+	}
+	const size_t Index = std::min(Values.size() - 1, size_t(Fraction * double(Values.size())));
+	std::nth_element(Values.begin(), Values.begin() + Index, Values.end());
+	return Values[Index];
+}
+
+/** Cost of one recorded scope in nanoseconds, timer reads included. Leaves the trace reset and disabled. */
+double MeasureTraceScopeCost(bool bEnabled, uint32_t NumScopes)
+{
+	ResetCaptureTrace();
+	SetCaptureTraceEnabled(bEnabled);
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for (uint32_t Index = 0; Index < NumScopes; Index++)
+	{
+		CAPTURE_TRACE_SCOPE("Bench.Calibrate");
+	}
+	const double Seconds = SecondsSince(Start);
+	SetCaptureTraceEnabled(false);
+	ResetCaptureTrace();
+	return Seconds * 1e9 / double(NumScopes);
+}
+
+std::string InsertBeforeExtension(const std::string& Path, const std::string& Suffix)
+{
+	const size_t Dot = Path.find_last_of('.');
+	const size_t Slash = Path.find_last_of("/\\");
+	if (Dot == std::string::npos || (Slash != std::string::npos && Dot < Slash))
+	{
+		return Path + Suffix;
+	}
+	return Path.substr(0, Dot) + Suffix + Path.substr(Dot);
+}
+
+/**
+ * Writer side of the pipeline, mirroring AppendToContainer() in CaptureSubsystem.cpp: layers of a bundle are
+ * encoded and parked in their frame, the frame is appended when it completes.
+ */
+struct FPipelineWriter
+{
+	FCaptureContainerWriter Container;
+	FCaptureBufferPool Pool;
+	bool bCompress = false;
+	FCaptureCompressionGovernor* Governor = nullptr;
+	std::thread::id RenderThread;
+	FCaptureSink* Sink = nullptr;
+
+	/** Packed bytes not yet in the container, and their high-water mark. */
+	std::atomic<uint64_t> BytesInFlight{ 0 };
+	std::atomic<uint64_t> PeakBytesInFlight{ 0 };
+	std::atomic<uint64_t> RawBytes{ 0 };
+	std::atomic<uint64_t> EncodedBytes{ 0 };
+
+	void AddInFlight(uint64_t Bytes)
+	{
+		const uint64_t Now = BytesInFlight += Bytes;
+		uint64_t Peak = PeakBytesInFlight.load(std::memory_order_relaxed);
+		while (Now > Peak && !PeakBytesInFlight.compare_exchange_weak(Peak, Now, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	bool WriteFrame(FCaptureFrame& Frame)
+	{
+		const std::vector<FCaptureLayerPayload> Payloads = Frame.GetPayloads();
+		const bool bWritten = Container.AppendFrame(Frame.GetInfo(), Payloads.data(), uint32_t(Payloads.size()));
+		for (const FCaptureLayerPayload& Payload : Payloads)
+		{
+			BytesInFlight -= Payload.Codec == ECaptureCodec::Raw ? Payload.Size : Payload.RawSize;
+			RawBytes += Payload.Codec == ECaptureCodec::Raw ? Payload.Size : Payload.RawSize;
+		}
+		Frame.ReleaseLayers(Pool);
+		return bWritten;
+	}
+
+	bool Write(FCaptureWriteJob& Job)
+	{
+		if (Job.Frame)
+		{
+			return WriteFrame(*Job.Frame);
+		}
+
+		FCaptureFrameLayer Layer;
+		Layer.Width = Job.Width;
+		Layer.Height = Job.Height;
+		Layer.PixelFormat = Job.PixelFormat;
+		Layer.BytesPerPixel = Job.BytesPerPixel;
+		Layer.RawSize = Job.Bytes.size();
+		bool bEncoded = false;
+		if (bCompress && Governor->Admit(Job.Bytes.size(), Job.EnqueueTime))
+		{
+			Layer.Bytes = Pool.Acquire(0, size_t(GetCaptureEncodedBound(Job.Width, Job.Height, Job.BytesPerPixel)));
+			const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+			bEncoded = EncodeCapturePayload(Job.Bytes.data(), Job.Width, Job.Height, Job.BytesPerPixel, Layer.Bytes);
+			Governor->AddEncode(Job.Bytes.size(), std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count());
+		}
+		if (bEncoded)
+		{
+			Layer.Codec = ECaptureCodec::ShuffleDeltaRans;
+			EncodedBytes += Job.Bytes.size();
+		}
+		else
+		{
+			Pool.Release(std::move(Layer.Bytes));
+			Layer.Bytes = std::move(Job.Bytes);
+		}
+		Job.FrameLayer.Complete(std::move(Layer));
+		return true;
+	}
+
+	void OnFrameComplete(std::shared_ptr<FCaptureFrame> Frame)
+	{
+		// Same rule as the engine: the render thread never writes to the container itself.
+		if (std::this_thread::get_id() == RenderThread)
+		{
+			FCaptureSink::FCaptureJobPtr Job = std::make_unique<FCaptureWriteJob>();
+			Job->FrameId = Frame->GetFrameId();
+			Job->Frame = std::move(Frame);
+			Sink->Enqueue(std::move(Job));
+		}
+		else
+		{
+			const uint64_t NumBytes = Frame->GetPayloadBytes();
+			if (WriteFrame(*Frame))
+			{
+				Sink->AddBytesWritten(NumBytes);
+			}
+		}
+	}
+};
+
+/**
+ * Drives the capture path the hooks use, without a GPU: every frame, color, velocity and depth are copied
+ * into a mock staging ring with padded rows, retired a few frames later into write jobs, and written as one
+ * bundle per frame by the writer pool, optionally compressed. The render thread side is timed per frame. With
+ * --compress the frames are paced at --fps, the rate a game would offer them at, so the compression governor
+ * sees the real capture rate; without it they go out as fast as the pipeline takes them.
+ */
+int RunPipelineBench(const FBenchOptions& Options)
+{
+	struct FResolution
+	{
+		const char* Name;
+		int32_t Width;
+		int32_t Height;
+	};
+	std::vector<FResolution> Resolutions = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+	if (Options.bCustomSize)
+	{
+		Resolutions = { { "custom", Options.Width, Options.Height } };
+	}
+
+	const char* OverflowNames[] = { "drop", "block", "coalesce" };
+	printf("pipeline: %u frames per size, %u writer threads, %s, overflow %s, %s\n", Options.NumFrames, Options.NumThreads,
+		Options.bCompress ? "compressed" : "raw", OverflowNames[uint32_t(Options.Overflow)], Options.OutputPath.c_str());
+	printf("  %-8s %11s %9s %11s %11s %11s %11s %11s %9s %9s\n", "size", "extent", "fps", "submit p50", "submit p99", "in-flight", "peak RSS", "written",
+		"dropped", "pool hits");
+
+	int Result = 0;
+	for (const FResolution& Resolution : Resolutions)
+	{
+		// A few distinct frames are cycled so generating them does not dominate the run.
+		const uint32_t NumSourceFrames = std::min<uint32_t>(Options.NumFrames, 3);
+		std::mt19937 Random(99);
+		std::vector<std::vector<FBenchLayer>> SourceFrames;
+		for (uint32_t FrameIndex = 0; FrameIndex < NumSourceFrames; FrameIndex++)
+		{
+			SourceFrames.push_back(MakeSyntheticFrame(Resolution.Width, Resolution.Height, FrameIndex, Random));
+		}
+		const uint32_t NumLayers = uint32_t(SourceFrames[0].size());
+
+		FCaptureCompressionGovernor Governor(Options.NumThreads, 4.0 / Options.TargetFps);
+		FPipelineWriter Writer;
+		Writer.bCompress = Options.bCompress;
+		Writer.Governor = &Governor;
+		Writer.RenderThread = std::this_thread::get_id();
+		if (!Writer.Container.Open(Options.OutputPath))
+		{
+			fprintf(stderr, "cannot create %s\n", Options.OutputPath.c_str());
+			return 1;
+		}
+
+		FCaptureSinkConfig Config;
+		Config.NumWriters = Options.NumThreads;
+		Config.QueueCapacity = 16;
+		Config.Overflow = Options.Overflow;
+		Config.BufferPool = &Writer.Pool;
+		FCaptureSink Sink(Config, [&Writer](FCaptureWriteJob& Job) { return Writer.Write(Job); });
+		Writer.Sink = &Sink;
+
+		// Same ring configuration as the r.Capture.Readback* defaults, with D3D12 style 256 byte row pitches.
+		const uint32_t NumSlots = 16;
+		const uint32_t LatencyFrames = 2;
+		FCaptureMockReadbackBackend Backend(NumSlots, LatencyFrames, 256);
+		FCaptureReadbackRing Ring(Backend, NumSlots, LatencyFrames, ECaptureBackPressure::WaitOldest,
+			[&Writer, &Sink](const FCaptureReadbackRequest& Request, const FCaptureMappedSurface& Surface)
+			{
+				// EnqueueReadbackWrite() in CaptureReadbackRHI.cpp.
+				const size_t PackedPitch = size_t(Request.Width) * Request.BytesPerPixel;
+				FCaptureSink::FCaptureJobPtr Job = std::make_unique<FCaptureWriteJob>();
+				Job->FrameId = Request.FrameId;
+				Job->Layer = Request.Layer;
+				Job->Width = Request.Width;
+				Job->Height = Request.Height;
+				Job->PixelFormat = Request.PixelFormat;
+				Job->BytesPerPixel = Request.BytesPerPixel;
+				Job->FrameLayer = Request.FrameLayer;
+				Job->Bytes = Writer.Pool.Acquire(PackedPitch * Request.Height);
+				CopyCaptureRows(Job->Bytes.data(), PackedPitch, Surface.Data, Surface.RowPitch, PackedPitch, uint32_t(Request.Height));
+
+				Writer.AddInFlight(Job->Bytes.size());
+				const uint64_t Bytes = Job->Bytes.size();
+				if (!Sink.Enqueue(std::move(Job)))
+				{
+					Writer.BytesInFlight -= Bytes;
+				}
+			});
+
+		std::vector<double> SubmitMilliseconds;
+		SubmitMilliseconds.reserve(Options.NumFrames);
+
+		const bool bTrace = !Options.TracePath.empty();
+		if (bTrace)
+		{
+			SetCaptureTraceThreadName("Render thread");
+			ResetCaptureTrace();
+			SetCaptureTraceEnabled(true);
+		}
+
+		const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+		for (uint32_t FrameIndex = 0; FrameIndex < Options.NumFrames; FrameIndex++)
+		{
+			if (Options.bCompress)
+			{
+				std::this_thread::sleep_until(Start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(double(FrameIndex) / Options.TargetFps)));
+			}
+
+			const std::vector<FBenchLayer>& Source = SourceFrames[FrameIndex % NumSourceFrames];
+			Backend.SetFrame(FrameIndex);
+
+			std::shared_ptr<FCaptureFrame> Frame = FCaptureFrame::Create(FrameIndex, Options.OutputPath,
+				[&Writer](std::shared_ptr<FCaptureFrame> Completed) { Writer.OnFrameComplete(std::move(Completed)); });
+			Frame->GetInfo().JitterX = 0.5f * float(FrameIndex % 8) / 8.0f;
+
+			const std::chrono::steady_clock::time_point SubmitStart = std::chrono::steady_clock::now();
+			double CopySeconds = 0.0;
+
+			// The hooks' layers go out as one batch, like the DLSS history.
+			Ring.BeginFrame(FrameIndex);
+			Ring.Poll();
+			Ring.Reserve(NumLayers);
+			for (uint32_t LayerIndex = 0; LayerIndex < NumLayers; LayerIndex++)
+			{
+				const FBenchLayer& Layer = Source[LayerIndex];
+
+				FCaptureReadbackRequest Request;
+				Request.FrameId = FrameIndex;
+				Request.Layer = Layer.Name;
+				Request.Width = Layer.Width;
+				Request.Height = Layer.Height;
+				Request.PixelFormat = Layer.PixelFormat;
+				Request.BytesPerPixel = Layer.BytesPerPixel;
+				Request.FrameLayer = Frame->AddLayer(Layer.Name);
+
+				CAPTURE_TRACE_SCOPE("Capture.Submit");
+				const int32_t Slot = Ring.Acquire(std::move(Request));
+				if (Slot >= 0)
+				{
+					// Stands in for the GPU copy, which costs the render thread nothing.
+					const std::chrono::steady_clock::time_point CopyStart = std::chrono::steady_clock::now();
+					Backend.EnqueueCopy(uint32_t(Slot), Layer.Bytes.data(), Layer.Width, Layer.Height, Layer.BytesPerPixel);
+					CopySeconds += SecondsSince(CopyStart);
+				}
+			}
+			Frame->Seal();
+			Frame.reset();
+
+			SubmitMilliseconds.push_back((SecondsSince(SubmitStart) - CopySeconds) * 1000.0);
+		}
+		Ring.Flush();
+		Sink.Flush();
+		const double Seconds = SecondsSince(Start);
+
+		const FCaptureSinkStats Stats = Sink.GetStats();
+		Writer.Container.Close();
+		SetCaptureTraceEnabled(false);
+
+		const uint64_t FileBytes = GetFileSize(Options.OutputPath);
+		const double FramesPerSecond = double(Options.NumFrames) / Seconds;
+		char Extent[32];
+		snprintf(Extent, sizeof(Extent), "%dx%d", Resolution.Width, Resolution.Height);
+		printf("  %-8s %11s %9.1f %8.2f ms %8.2f ms %8.0f MB %8.0f MB %8.0f MB %9llu %8.1f%%\n", Resolution.Name, Extent, FramesPerSecond,
+			Percentile(SubmitMilliseconds, 0.5), Percentile(SubmitMilliseconds, 0.99), double(Writer.PeakBytesInFlight.load()) / 1e6,
+			double(GetPeakMemoryBytes()) / 1e6, double(FileBytes) / 1e6, (unsigned long long)(Stats.Dropped + Stats.Coalesced + Ring.GetStats().Dropped),
+			100.0 * Writer.Pool.GetStats().GetHitRate());
+
+		// The container has to hold every frame that was not dropped on purpose, with all its layers.
+		FCaptureContainerReader Reader;
+		const bool bReadable = Reader.Open(Options.OutputPath) && Reader.IsFinalized();
+		const bool bComplete = bReadable && Options.Overflow == ECaptureOverflow::Block
+			? Reader.GetFrames().size() == Options.NumFrames && Reader.GetRecords().size() == size_t(Options.NumFrames) * NumLayers
+			: bReadable;
+		if (!bComplete)
+		{
+			printf("  %-8s container is incomplete: %zu frames, %zu records\n", Resolution.Name, Reader.GetFrames().size(), Reader.GetRecords().size());
+			Result = 2;
+		}
+
+		// The rate controller paces on the sink's byte count, so it has to match what the bundles put in the file.
+		uint64_t PayloadBytes = 0;
+		for (const FCaptureChunkHeader& Record : Reader.GetRecords())
+		{
+			PayloadBytes += Record.PayloadSize;
+		}
+		if (bReadable && Stats.BytesWritten != PayloadBytes)
+		{
+			printf("  %-8s writers counted %llu bytes, the container holds %llu\n", Resolution.Name, (unsigned long long)Stats.BytesWritten,
+				(unsigned long long)PayloadBytes);
+			Result = 2;
+		}
+		if (Options.bCompress)
+		{
+			printf("  %-8s %.1f of %.0f fps (%.0f%%), %.2f GB/s raw, %.0f%% of the bytes encoded (%llu layers stored raw)\n", Resolution.Name,
+				FramesPerSecond, Options.TargetFps, 100.0 * FramesPerSecond / Options.TargetFps, double(Writer.RawBytes.load()) / Seconds / 1e9,
+				100.0 * double(Writer.EncodedBytes.load()) / double(std::max<uint64_t>(Writer.RawBytes.load(), 1)), (unsigned long long)Governor.GetNumBypassed());
+		}
+		else
+		{
+			printf("  %-8s %.1f of %.0f fps (%.0f%%), %.2f GB/s raw\n", Resolution.Name, FramesPerSecond, Options.TargetFps,
+				100.0 * FramesPerSecond / Options.TargetFps, double(Writer.RawBytes.load()) / Seconds / 1e9);
+		}
+
+		if (bTrace)
+		{
+			const FCaptureTraceSummary Summary = SummarizeCaptureTrace();
+			const std::string TracePath = Options.bCustomSize ? Options.TracePath : InsertBeforeExtension(Options.TracePath, std::string("_") + Resolution.Name);
+			if (!WriteCaptureTrace(TracePath))
+			{
+				printf("  %-8s cannot write %s\n", Resolution.Name, TracePath.c_str());
+				Result = 2;
+			}
+
+			// Every event costs about one enabled scope; compare with the time the run took per frame.
+			const double EventsPerFrame = double(Summary.NumEvents) / double(Options.NumFrames);
+			const double OverheadPercent = 100.0 * EventsPerFrame * MeasureTraceScopeCost(true, 100000) / (Seconds * 1e9 / double(Options.NumFrames));
+			printf("  %-8s trace %s: %.1f events per frame, about %.3f%% of the frame time\n", Resolution.Name, TracePath.c_str(), EventsPerFrame, OverheadPercent);
+			const std::string Table = FormatCaptureTraceSummary(Summary);
+			for (size_t LineStart = 0; LineStart < Table.size();)
+			{
+				const size_t LineEnd = Table.find('\n', LineStart);
+				printf("    %s\n", Table.substr(LineStart, LineEnd - LineStart).c_str());
+				LineStart = LineEnd == std::string::npos ? Table.size() : LineEnd + 1;
+			}
+		}
+	}
+
+	remove(Options.OutputPath.c_str());
+	return Result;
+}
+
+/**
+ * Host buffer churn of the capture path with and without FCaptureBufferPool. Each frame the render thread takes a
+ * buffer per layer (color, velocity, depth/stencil), fills it as EnqueueReadbackWrite() does, and hands it to the
+ * writers, which only read it, so allocation and page faults are all that is measured. The warm up lasts until a
+ * frame is served from the free lists alone. How deep the writer queue gets depends on scheduling, so the pool may
+ * still grow after that; it fails only if it allocates more buffers of a size than can be in flight at once.
+ */
+int RunPoolBench(const FBenchOptions& Options)
+{
+	struct FResolution
+	{
+		const char* Name;
+		int32_t Width;
+		int32_t Height;
+	};
+	std::vector<FResolution> Resolutions = { { "720p", 1280, 720 }, { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+	if (Options.bCustomSize)
+	{
+		Resolutions = { { "custom", Options.Width, Options.Height } };
+	}
+	const uint32_t LayerBytesPerPixel[] = { 8, 4, 8 };
+	const uint32_t NumLayers = uint32_t(std::size(LayerBytesPerPixel));
+	const uint32_t QueueCapacity = 16;
+	const uint32_t MinWarmupFrames = 4;
+	const uint32_t MaxWarmupFrames = std::max(Options.NumFrames / 2, MinWarmupFrames);
+	const uint32_t NumFrames = std::max(Options.NumFrames, MaxWarmupFrames + 8);
+
+	// Buffers of one size class that can be out of the pool at once: a full queue, one per writer and a frame being filled.
+	const uint64_t MaxInFlight = QueueCapacity + Options.NumThreads + NumLayers;
+
+	printf("pool: %u frames per size (warm up until a frame allocates nothing, at most %u), %u writer threads\n", NumFrames, MaxWarmupFrames,
+		Options.NumThreads);
+	printf("  %-8s %-7s %7s %11s %11s %13s %13s %9s %11s\n", "size", "buffers", "warm up", "fill p50", "fill p99", "allocs/frame", "faults/frame",
+		"hit rate", "peak pool");
+
+	int Result = 0;
+	for (const FResolution& Resolution : Resolutions)
+	{
+		const size_t NumPixels = size_t(Resolution.Width) * Resolution.Height;
+		std::vector<uint8_t> Source(NumPixels * 8, 0x3C);
+
+		for (const bool bPooled : { false, true })
+		{
+			FCaptureBufferPool Pool;
+			std::atomic<uint64_t> Checksum{ 0 };
+
+			FCaptureSinkConfig Config;
+			Config.NumWriters = Options.NumThreads;
+			Config.QueueCapacity = QueueCapacity;
+			Config.Overflow = ECaptureOverflow::Block;
+			Config.BufferPool = bPooled ? &Pool : nullptr;
+			FCaptureSink Sink(Config, [&Checksum](FCaptureWriteJob& Job)
+			{
+				// Reads a byte per page, the way the container write would touch it.
+				uint64_t Sum = 0;
+				for (size_t Offset = 0; Offset < Job.Bytes.size(); Offset += 4096)
+				{
+					Sum += Job.Bytes[Offset];
+				}
+				Checksum += Sum;
+				return true;
+			});
+
+			std::vector<double> FillMilliseconds;
+			uint64_t SteadyAllocs = 0;
+			uint64_t SteadyFaults = 0;
+			uint32_t NumWarmupFrames = MaxWarmupFrames;
+			for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+			{
+				const bool bSteady = FrameIndex >= NumWarmupFrames;
+				const uint64_t FaultsBefore = GetPageFaults();
+				const uint64_t HitsBefore = Pool.GetStats().NumHits;
+				const std::chrono::steady_clock::time_point FillStart = std::chrono::steady_clock::now();
+
+				for (const uint32_t BytesPerPixel : LayerBytesPerPixel)
+				{
+					FCaptureSink::FCaptureJobPtr Job = std::make_unique<FCaptureWriteJob>();
+					Job->FrameId = FrameIndex;
+					Job->Width = Resolution.Width;
+					Job->Height = Resolution.Height;
+					Job->BytesPerPixel = BytesPerPixel;
+					if (bPooled)
+					{
+						Job->Bytes = Pool.Acquire(NumPixels * BytesPerPixel);
+					}
+					else
+					{
+						Job->Bytes.resize(NumPixels * BytesPerPixel);
+					}
+					memcpy(Job->Bytes.data(), Source.data(), Job->Bytes.size());
+					Sink.Enqueue(std::move(Job));
+				}
+
+				const double Milliseconds = SecondsSince(FillStart) * 1000.0;
+				const uint64_t Allocs = bPooled ? NumLayers - (Pool.GetStats().NumHits - HitsBefore) : NumLayers;
+				if (bSteady)
+				{
+					FillMilliseconds.push_back(Milliseconds);
+					SteadyAllocs += Allocs;
+					SteadyFaults += GetPageFaults() - FaultsBefore;
+				}
+				else if (bPooled && Allocs == 0 && FrameIndex + 1 >= MinWarmupFrames)
+				{
+					NumWarmupFrames = FrameIndex + 1;
+				}
+			}
+			Sink.Flush();
+
+			const FCaptureBufferPoolStats PoolStats = Pool.GetStats();
+			const uint32_t NumSteadyFrames = NumFrames - NumWarmupFrames;
+			printf("  %-8s %-7s %7u %8.2f ms %8.2f ms %13.2f %13.1f %8.1f%% %8.0f MB\n", Resolution.Name, bPooled ? "pooled" : "fresh",
+				NumWarmupFrames, Percentile(FillMilliseconds, 0.5), Percentile(FillMilliseconds, 0.99), double(SteadyAllocs) / NumSteadyFrames,
+				double(SteadyFaults) / NumSteadyFrames, 100.0 * PoolStats.GetHitRate(), double(PoolStats.PeakResidentBytes) / 1e6);
+
+			// Each size class only allocates while all of its buffers are out, so it never needs more than can be in flight.
+			std::vector<size_t> SizeClasses;
+			for (const uint32_t BytesPerPixel : LayerBytesPerPixel)
+			{
+				SizeClasses.push_back(FCaptureBufferPool::GetSizeClass(NumPixels * BytesPerPixel));
+			}
+			std::sort(SizeClasses.begin(), SizeClasses.end());
+			const uint64_t NumSizeClasses = uint64_t(std::unique(SizeClasses.begin(), SizeClasses.end()) - SizeClasses.begin());
+			const uint64_t NumAllocs = PoolStats.NumAcquired - PoolStats.NumHits;
+			if (bPooled && (NumAllocs > NumSizeClasses * MaxInFlight || PoolStats.NumReleased != PoolStats.NumAcquired))
+			{
+				printf("  %-8s pool allocated %llu buffers, more than the %llu that can be in flight, %llu of %llu returned\n", Resolution.Name,
+					(unsigned long long)NumAllocs, (unsigned long long)(NumSizeClasses * MaxInFlight), (unsigned long long)PoolStats.NumReleased,
+					(unsigned long long)PoolStats.NumAcquired);
+				Result = 2;
+			}
+		}
+	}
+	return Result;
+}
+
+#if !defined(_WIN32)
+/** What the consumer process of the stream benchmark reports back through its pipe. */
+struct FStreamConsumerResult
+{
+	FCaptureStreamReaderStats Stats;
+	uint64_t NumCorrupt = 0;
+	uint64_t NumBytes = 0;
+	double Seconds = 0.0;
+};
+
+/** Every page of a streamed payload starts with the id of its frame and the index of its layer. */
+void StampStreamPayload(std::vector<uint8_t>& Bytes, uint64_t FrameId, uint32_t Layer)
+{
+	const uint64_t Stamp = FrameId << 8 | Layer;
+	for (size_t Offset = 0; Offset + sizeof(Stamp) <= Bytes.size(); Offset += 4096)
+	{
+		memcpy(Bytes.data() + Offset, &Stamp, sizeof(Stamp));
+	}
+}
+
+/**
+ * Reference consumer: copies every frame out of the ring as a training process would, then checks the copy. A
+ * frame EndRead() accepted has to carry its own stamps on every page. A consumer delay simulates a slow reader.
+ */
+FStreamConsumerResult ConsumeStream(const std::string& Name, double DelayMilliseconds)
+{
+	FStreamConsumerResult Result;
+	FCaptureStreamReader Reader;
+	if (!Reader.Open(Name))
+	{
+		Result.NumCorrupt = ~0ull;
+		return Result;
+	}
+
+	std::vector<uint8_t> Copy;
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	for (;;)
+	{
+		FCaptureStreamFrameView Frame;
+		const ECaptureStreamRead Status = Reader.BeginRead(Frame);
+		if (Status == ECaptureStreamRead::Closed)
+		{
+			break;
+		}
+		if (Status == ECaptureStreamRead::NoFrame)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::vector<std::pair<size_t, size_t>> Ranges;
+		size_t NumBytes = 0;
+		for (uint32_t Layer = 0; Layer < Frame.Info.NumLayers; Layer++)
+		{
+			const size_t Size = size_t(std::min<uint64_t>(Frame.Layers[Layer].Size, 1ull << 32));
+			Copy.resize(std::max(Copy.size(), NumBytes + Size));
+			memcpy(Copy.data() + NumBytes, Frame.GetPayload(Layer), Size);
+			Ranges.push_back({ NumBytes, Size });
+			NumBytes += Size;
+		}
+		if (!Reader.EndRead(Frame))
+		{
+			continue;
+		}
+
+		bool bIntact = Frame.Info.NumLayers == 3;
+		for (uint32_t Layer = 0; Layer < Ranges.size() && bIntact; Layer++)
+		{
+			const uint64_t Stamp = Frame.Info.FrameId << 8 | Layer;
+			for (size_t Offset = 0; Offset + sizeof(Stamp) <= Ranges[Layer].second; Offset += 4096)
+			{
+				bIntact = bIntact && memcmp(Copy.data() + Ranges[Layer].first + Offset, &Stamp, sizeof(Stamp)) == 0;
+			}
+		}
+		Result.NumCorrupt += bIntact ? 0 : 1;
+		Result.NumBytes += NumBytes;
+
+		if (DelayMilliseconds > 0.0)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(DelayMilliseconds));
+		}
+	}
+	Result.Seconds = SecondsSince(Start);
+	Result.Stats = Reader.GetStats();
+	return Result;
+}
+
+/**
+ * Throughput of the live stream on one box: the bench publishes synthetic color, velocity and depth/stencil frames
+ * as fast as it can while a forked process reads them through FCaptureStreamReader. Run once with a reader that
+ * keeps up as well as it can and once with one that takes 20 ms per frame; publishing must not slow down for the
+ * latter, which skips instead, and no frame a reader accepted may be torn.
+ */
+int RunStreamBench(const FBenchOptions& Options)
+{
+	std::mt19937 Random(9);
+	std::vector<FBenchLayer> Layers = MakeSyntheticFrame(Options.Width, Options.Height, 0, Random);
+	uint64_t FrameBytes = 0;
+	for (const FBenchLayer& Layer : Layers)
+	{
+		FrameBytes += Layer.Bytes.size();
+	}
+	const uint32_t NumSlots = 4;
+	const uint32_t NumFrames = std::max(Options.NumFrames, 120u);
+	const std::string Name = "capture_bench_" + std::to_string(getpid());
+
+	printf("stream: %dx%d, %.1f MB per frame, %u frames, %u slots\n", Options.Width, Options.Height, double(FrameBytes) / 1e6, NumFrames, NumSlots);
+	printf("  %-7s %10s %10s %8s %8s %8s %8s %10s\n", "reader", "publish", "publish", "read", "skipped", "torn", "corrupt", "read");
+
+	int Result = 0;
+	for (const double DelayMilliseconds : { 0.0, 20.0 })
+	{
+		FCaptureStreamWriter Writer;
+		int Pipe[2];
+		if (!Writer.Open(Name, NumSlots, FrameBytes + CaptureContainerAlignment * 2) || pipe(Pipe) != 0)
+		{
+			printf("  cannot create the shared memory ring %s\n", Name.c_str());
+			return 2;
+		}
+
+		const pid_t Consumer = fork();
+		if (Consumer == 0)
+		{
+			close(Pipe[0]);
+			const FStreamConsumerResult ConsumerResult = ConsumeStream(Name, DelayMilliseconds);
+			const bool bReported = write(Pipe[1], &ConsumerResult, sizeof(ConsumerResult)) == ssize_t(sizeof(ConsumerResult));
+			_exit(bReported ? 0 : 1);
+		}
+		close(Pipe[1]);
+
+		// Let the reader map the ring before the first frame, so it sees every one.
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		double PublishSeconds = 0.0;
+		for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+		{
+			FCaptureFrameInfo Info = {};
+			Info.FrameId = FrameIndex;
+			Info.JitterX = 0.25f;
+			Info.JitterY = -0.25f;
+			Info.PreExposure = 1.0f;
+
+			std::vector<FCaptureLayerPayload> Payloads;
+			for (uint32_t Layer = 0; Layer < Layers.size(); Layer++)
+			{
+				StampStreamPayload(Layers[Layer].Bytes, FrameIndex, Layer);
+
+				FCaptureLayerPayload Payload;
+				Payload.Layer = Layers[Layer].Name.c_str();
+				Payload.Width = Layers[Layer].Width;
+				Payload.Height = Layers[Layer].Height;
+				Payload.PixelFormat = Layers[Layer].PixelFormat;
+				Payload.BytesPerPixel = Layers[Layer].BytesPerPixel;
+				Payload.Data = Layers[Layer].Bytes.data();
+				Payload.Size = Layers[Layer].Bytes.size();
+				Payloads.push_back(Payload);
+			}
+
+			const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+			Writer.Publish(Info, Payloads.data(), uint32_t(Payloads.size()));
+			PublishSeconds += SecondsSince(Start);
+		}
+		const FCaptureStreamStats WriterStats = Writer.GetStats();
+		Writer.Close();
+
+		FStreamConsumerResult ConsumerResult;
+		const bool bReported = read(Pipe[0], &ConsumerResult, sizeof(ConsumerResult)) == ssize_t(sizeof(ConsumerResult));
+		close(Pipe[0]);
+		int Status = 0;
+		waitpid(Consumer, &Status, 0);
+
+		const FCaptureStreamReaderStats& ReaderStats = ConsumerResult.Stats;
+		printf("  %-7s %6.0f fps %6.2f GB/s %8llu %8llu %8llu %8llu %6.2f GB/s\n", DelayMilliseconds > 0.0 ? "slow" : "fast",
+			NumFrames / std::max(PublishSeconds, 1e-9), double(FrameBytes) * NumFrames / std::max(PublishSeconds, 1e-9) / 1e9,
+			(unsigned long long)ReaderStats.Read, (unsigned long long)ReaderStats.Skipped, (unsigned long long)ReaderStats.Torn,
+			(unsigned long long)ConsumerResult.NumCorrupt, double(ConsumerResult.NumBytes) / std::max(ConsumerResult.Seconds, 1e-9) / 1e9);
+
+		const bool bAccounted = ReaderStats.Read + ReaderStats.Skipped + ReaderStats.Torn == NumFrames;
+		if (!bReported || WriterStats.Published != NumFrames || ConsumerResult.NumCorrupt != 0 || !bAccounted)
+		{
+			printf("  reader lost track of the stream: %llu of %u frames published, %s\n", (unsigned long long)WriterStats.Published, NumFrames,
+				bReported ? "counts do not add up or frames were corrupt" : "no report from the reader");
+			Result = 2;
+		}
+	}
+	return Result;
+}
+#else
+int RunStreamBench(const FBenchOptions&)
+{
+	printf("stream: the benchmark forks its reader and is not supported on Windows\n");
+	return 1;
+}
+#endif
+
+/**
+ * Checks the trace recorder: per-thread buffers lose nothing below their capacity and keep the newest events
+ * above it, an export running next to a recording thread never sees a torn event, and a scope costs next to
+ * nothing while recording is off. Also reports what an enabled scope costs.
+ */
+int RunTraceCheck()
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+	auto FindRow = [](const FCaptureTraceSummary& Summary, const char* Name)
+	{
+		for (const FCaptureTraceSummaryRow& Row : Summary.Rows)
+		{
+			if (Row.Name == Name)
+			{
+				return Row;
+			}
+		}
+		return FCaptureTraceSummaryRow();
+	};
+
+	const double DisabledCost = MeasureTraceScopeCost(false, 10000000);
+	const double EnabledCost = MeasureTraceScopeCost(true, 1000000);
+	printf("trace: %.1f ns per scope while off, %.1f ns while recording\n", DisabledCost, EnabledCost);
+
+	// Four threads below capacity: every scope and counter arrives.
+	ResetCaptureTrace();
+	SetCaptureTraceEnabled(true);
+	{
+		std::vector<std::thread> Threads;
+		for (uint32_t ThreadIndex = 0; ThreadIndex < 4; ThreadIndex++)
+		{
+			Threads.emplace_back([ThreadIndex]()
+			{
+				for (uint32_t Index = 0; Index < 10000; Index++)
+				{
+					CAPTURE_TRACE_SCOPE("Bench.Scope");
+					CAPTURE_TRACE_COUNTER("Bench.Counter", ThreadIndex);
+				}
+			});
+		}
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+	}
+	FCaptureTraceSummary Summary = SummarizeCaptureTrace();
+	Expect(FindRow(Summary, "Bench.Scope").Count == 40000 && FindRow(Summary, "Bench.Counter").Count == 40000 && Summary.NumLost == 0,
+		"events recorded by four threads are missing");
+	Expect(FindRow(Summary, "Bench.Counter").bCounter && FindRow(Summary, "Bench.Counter").Max == 3.0, "counter values are wrong");
+
+	// One thread past capacity keeps its newest events.
+	ResetCaptureTrace();
+	std::thread([]()
+	{
+		for (uint32_t Index = 0; Index < 3 * CaptureTraceEventsPerThread; Index++)
+		{
+			RecordCaptureTraceScope("Bench.Wrap", 1000 + Index, 1000 + Index + Index % 2);
+		}
+	}).join();
+	Summary = SummarizeCaptureTrace();
+	Expect(FindRow(Summary, "Bench.Wrap").Count == CaptureTraceEventsPerThread && Summary.NumLost == 2 * CaptureTraceEventsPerThread,
+		"a full buffer does not keep exactly its newest events");
+
+	// Exports while a thread records as fast as it can: every scope lasts 7 ns, a torn one would not.
+	ResetCaptureTrace();
+	std::atomic<bool> bStop{ false };
+	std::thread Recorder([&bStop]()
+	{
+		for (uint64_t Index = 1; !bStop.load(std::memory_order_relaxed); Index++)
+		{
+			RecordCaptureTraceScope("Bench.Race", Index * 16, Index * 16 + 7);
+		}
+	});
+	bool bIntact = true;
+	uint32_t NumExports = 0;
+	for (; NumExports < 50; NumExports++)
+	{
+		const FCaptureTraceSummaryRow Row = FindRow(SummarizeCaptureTrace(), "Bench.Race");
+		bIntact = bIntact && (Row.Count == 0 || (Row.Min == 7.0 && Row.Max == 7.0));
+	}
+	bStop = true;
+	Recorder.join();
+	Expect(bIntact, "an export running next to the recorder returned a torn event");
+
+	// Chrome trace of a nested scope and a counter.
+	ResetCaptureTrace();
+	{
+		CAPTURE_TRACE_SCOPE("Bench.Outer");
+		CAPTURE_TRACE_SCOPE("Bench.Inner");
+		CAPTURE_TRACE_COUNTER("Bench.Depth", -2);
+	}
+	const std::string TracePath = "capture_bench_trace.json";
+	std::string Json;
+	if (WriteCaptureTrace(TracePath))
+	{
+		std::ifstream File(TracePath, std::ios::binary);
+		Json.assign(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	}
+	remove(TracePath.c_str());
+	Expect(Json.find("\"name\":\"Bench.Outer\",\"cat\":\"capture\",\"ph\":\"X\"") != std::string::npos
+		&& Json.find("\"name\":\"Bench.Depth\",\"cat\":\"capture\",\"ph\":\"C\"") != std::string::npos
+		&& Json.find("\"value\":-2") != std::string::npos && Json.find("\"thread_name\"") != std::string::npos, "Chrome trace is missing events");
+
+	SetCaptureTraceEnabled(false);
+	ResetCaptureTrace();
+	Expect(!IsCaptureTraceEnabled() && DisabledCost < 5.0, "a scope costs more than 5 ns while recording is off");
+
+	printf("trace: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks batched acquisition on the readback ring (FCaptureReadbackRing::Reserve, used for the four DLSS history
+ * targets): a batch fits whole or is dropped whole, and stalling makes room by retiring the oldest slots in order,
+ * but never by waiting on a copy submitted in the current frame.
+ */
+int RunRingCheck()
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* Case)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", Case);
+			NumFailures++;
+		}
+	};
+
+	const uint8_t Pixel[4] = {};
+	for (const ECaptureBackPressure BackPressure : { ECaptureBackPressure::DropNewest, ECaptureBackPressure::WaitOldest })
+	{
+		const bool bWait = BackPressure == ECaptureBackPressure::WaitOldest;
+		std::vector<uint64_t> Delivered;
+		FCaptureMockReadbackBackend Backend(4, 2, 256);
+		FCaptureReadbackRing Ring(Backend, 4, 2, BackPressure,
+			[&Delivered](const FCaptureReadbackRequest& Request, const FCaptureMappedSurface&) { Delivered.push_back(Request.FrameId); });
+
+		auto Submit = [&Ring, &Backend, &Pixel](uint64_t FrameId)
+		{
+			FCaptureReadbackRequest Request;
+			Request.FrameId = FrameId;
+			const int32_t Slot = Ring.Acquire(std::move(Request));
+			if (Slot >= 0)
+			{
+				Backend.EnqueueCopy(uint32_t(Slot), Pixel, 1, 1, 4);
+			}
+			return Slot >= 0;
+		};
+
+		Backend.SetFrame(0);
+		Ring.BeginFrame(0);
+		Expect(Ring.Reserve(3) && Submit(0) && Submit(1) && Submit(2), "a batch fits an empty ring");
+		Expect(!Ring.Reserve(5) && Ring.GetNumInFlight() == 3, "a batch larger than the ring is refused");
+
+		// The copies of this frame are recorded in a graph that has not run, so not even waiting makes room.
+		const uint64_t DroppedInFrame = Ring.GetStats().Dropped;
+		Expect(!Ring.Reserve(3) && Ring.GetNumInFlight() == 3 && Delivered.empty() && Ring.GetStats().Stalls == 0,
+			"a batch is refused rather than waiting on copies of the current frame");
+		Expect(Ring.GetStats().Dropped == DroppedInFrame + 3, "every request of a batch refused in its frame counts as dropped");
+
+		// Nothing is ready yet: dropping refuses the whole batch, waiting retires the oldest two in order.
+		Backend.SetFrame(1);
+		Ring.BeginFrame(1);
+		const uint64_t DroppedBefore = Ring.GetStats().Dropped;
+		const bool bReserved = Ring.Reserve(3);
+		if (bWait)
+		{
+			Expect(bReserved && Ring.GetNumInFlight() == 1 && Delivered == std::vector<uint64_t>({ 0, 1 }), "waiting retires the oldest slots");
+			Expect(Ring.GetStats().Stalls == 2, "every retired slot counts as a stall");
+			Expect(Submit(3) && Submit(4) && Submit(5), "a reserved batch is acquired without further waits");
+		}
+		else
+		{
+			Expect(!bReserved && Ring.GetNumInFlight() == 3 && Delivered.empty(), "dropping leaves the ring untouched");
+			Expect(Ring.GetStats().Dropped == DroppedBefore + 3, "every request of a dropped batch counts");
+		}
+
+		// Once the copies land, polling inside Reserve() frees the slots.
+		Backend.SetFrame(2);
+		Ring.BeginFrame(2);
+		Expect(Ring.Reserve(4) && Ring.GetNumInFlight() == 0, "landed copies are retired to fit a batch");
+		Expect(bWait ? Delivered == std::vector<uint64_t>({ 0, 1, 2, 3, 4, 5 }) : Delivered == std::vector<uint64_t>({ 0, 1, 2 }), "delivery stays in submission order");
+
+		// A full ring drops a single request rather than wait on a slot of the same frame, and only waits on older ones.
+		const uint64_t DroppedFull = Ring.GetStats().Dropped;
+		Expect(Submit(6) && Submit(7) && Submit(8) && Submit(9) && !Submit(10), "a full ring drops a request rather than waiting on copies of the current frame");
+		Expect(Ring.GetStats().Dropped == DroppedFull + 1, "a request refused in its frame counts as dropped");
+		Backend.SetFrame(3);
+		Ring.BeginFrame(3);
+		Expect(Submit(11) == bWait, "a full ring applies its policy to copies of earlier frames");
+	}
+
+	printf("ring: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the container lifecycle of back to back sessions: two sessions started and stopped within one second each
+ * get a container of their own, and a late write to a closed container leaves it finalized instead of truncating it.
+ * Then recovers a session that flushed its tables and crashed, cut at several points after the flush.
+ */
+int RunContainerCheck()
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* Case)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", Case);
+			NumFailures++;
+		}
+	};
+
+	const uint32_t Pixel = 0x3c003c00u;
+	auto WriteFrame = [&Pixel](FCaptureContainerWriter& Writer, uint64_t FrameId)
+	{
+		FCaptureLayerPayload Payload;
+		Payload.Layer = "output";
+		Payload.Width = 1;
+		Payload.Height = 1;
+		Payload.BytesPerPixel = sizeof(Pixel);
+		Payload.Data = &Pixel;
+		Payload.Size = sizeof(Pixel);
+		FCaptureFrameInfo Info = {};
+		Info.FrameId = FrameId;
+		return Writer.AppendFrame(Info, &Payload, 1);
+	};
+
+	// Start, stop, start and stop again as fast as the session allows, like a restart sent while capturing.
+	const std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	std::string Paths[2];
+	for (uint32_t Session = 0; Session < 2; ++Session)
+	{
+		Paths[Session] = "capture_bench_" + MakeCaptureSessionName() + ".ucap";
+		FCaptureContainerWriter Writer;
+		Expect(Writer.Open(Paths[Session], false) && WriteFrame(Writer, Session) && Writer.Close(), "every session creates and finalizes its container");
+	}
+	const bool bWithinSecond = std::chrono::steady_clock::now() - Start < std::chrono::seconds(1);
+	Expect(Paths[0] != Paths[1], "sessions started within one second get containers of their own");
+
+	// A write of the first session landing after its container was closed must not reopen it.
+	FCaptureContainerWriter Late;
+	Expect(!Late.Open(Paths[0], false), "a closed container is not opened again without overwriting");
+
+	for (uint32_t Session = 0; Session < 2; ++Session)
+	{
+		FCaptureContainerReader Reader;
+		Expect(Reader.Open(Paths[Session]) && Reader.IsFinalized() && Reader.GetFrameIds() == std::vector<uint64_t>({ Session }),
+			"every session keeps its own finalized frames");
+	}
+
+	remove(Paths[0].c_str());
+	remove(Paths[1].c_str());
+
+	// A session that flushed after three frames, wrote two more and died before Close(), cut where the disk stopped.
+	const std::string FlushedPath = "capture_bench_flushed.ucap";
+	const std::string CutPath = "capture_bench_cut.ucap";
+	{
+		FCaptureContainerWriter Writer;
+		bool bWritten = Writer.Open(FlushedPath);
+		for (uint64_t FrameId = 0; FrameId < 3; FrameId++)
+		{
+			bWritten = bWritten && WriteFrame(Writer, FrameId);
+		}
+		bWritten = bWritten && Writer.Flush();
+		const uint64_t FlushedSize = GetFileSize(FlushedPath);
+		for (uint64_t FrameId = 3; FrameId < 5; FrameId++)
+		{
+			bWritten = bWritten && WriteFrame(Writer, FrameId);
+		}
+		Expect(bWritten, "a flushed container takes more frames");
+
+		std::ifstream File(FlushedPath, std::ios::binary);
+		const std::vector<char> Bytes((std::istreambuf_iterator<char>(File)), std::istreambuf_iterator<char>());
+
+		struct FCut
+		{
+			uint64_t Size;
+			std::vector<uint64_t> FrameIds;
+			const char* Case;
+		};
+		const FCut Cuts[] = {
+			{ Bytes.size(), { 0, 1, 2, 3, 4 }, "every frame written after a flush is recovered" },
+			{ Bytes.size() - CaptureContainerAlignment, { 0, 1, 2, 3 }, "a frame cut short after a flush is left out, the ones before it are recovered" },
+			{ FlushedSize, { 0, 1, 2 }, "a container cut right behind its flushed tables keeps the flushed frames" },
+		};
+		for (const FCut& Cut : Cuts)
+		{
+			std::ofstream(CutPath, std::ios::binary | std::ios::trunc).write(Bytes.data(), std::streamsize(Cut.Size));
+			FCaptureContainerReader Reader;
+			Expect(Reader.Open(CutPath) && !Reader.IsFinalized() && Reader.GetFrameIds() == Cut.FrameIds, Cut.Case);
+		}
+
+		Expect(Writer.Close(), "a flushed container closes");
+		FCaptureContainerReader Reader;
+		Expect(Reader.Open(FlushedPath) && Reader.IsFinalized() && Reader.GetFrameIds() == Cuts[0].FrameIds && Reader.GetFrames().size() == 5,
+			"closing after a flush finalizes every frame");
+	}
+	remove(FlushedPath.c_str());
+	remove(CutPath.c_str());
+
+	printf("container: %u cases, %u failures%s\n", NumCases, NumFailures, bWithinSecond ? "" : " (sessions took over a second)");
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the r.Capture.Taps matching and scheduling against the intermediates AddGen5MainTemporalAAPasses()
+ * offers at 1080p input with a 2160p history.
+ */
+int RunTapsCheck()
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	Expect(MatchCaptureTapPattern("TAA.DilatedVelocity", "TAA.DilatedVelocity"), "exact name does not match");
+	Expect(MatchCaptureTapPattern("taa.dilatedvelocity", "TAA.DilatedVelocity"), "matching is case sensitive");
+	Expect(!MatchCaptureTapPattern("TAA.DilatedVelocity", "TAA.DilatedVelocityX"), "pattern matches a longer name");
+	Expect(!MatchCaptureTapPattern("TAA.DilatedVelocityX", "TAA.DilatedVelocity"), "pattern matches a shorter name");
+	Expect(MatchCaptureTapPattern("TAA.History.*", "TAA.History.Metadata"), "trailing wildcard does not match");
+	Expect(!MatchCaptureTapPattern("TAA.History.*", "TAA.HistoryRejection"), "trailing wildcard matches across the dot");
+	Expect(MatchCaptureTapPattern("*Rejection*", "TAA.DilatedHistoryRejection"), "inner wildcards do not match");
+	Expect(MatchCaptureTapPattern("*.*.*", "Debug.TAA.UpdateHistory"), "repeated wildcards do not match");
+	Expect(MatchCaptureTapPattern("TAA.*Velocity", "TAA.DilatedVelocity"), "wildcard does not backtrack");
+	Expect(MatchCaptureTapPattern("*a*a*b", "aaaaaaaaaaaaab") && !MatchCaptureTapPattern("*a*a*b", "aaaaaaaaaaaaaa"), "wildcards backtrack wrongly");
+	Expect(MatchCaptureTapPattern("TAA.?istory.Metadata", "TAA.History.Metadata"), "single character wildcard does not match");
+	Expect(!MatchCaptureTapPattern("TAA.History?", "TAA.History"), "single character wildcard matches nothing");
+	Expect(MatchCaptureTapPattern("*", "") && !MatchCaptureTapPattern("", "TAA.Output"), "empty names are handled wrongly");
+
+	FCaptureTapFilter Filter;
+	Filter.Parse(" Debug.TAA.* ;TAA.DilatedVelocity,, TAA.History.*  ,");
+	Expect(Filter.GetPatterns().size() == 3, "tap list is not split into three patterns");
+	Expect(Filter.Match("TAA.DilatedVelocity") == 1 && Filter.Match("Debug.TAA.CompareHistory") == 0, "first matching pattern is not reported");
+	Expect(Filter.Match("TAA.Output") < 0, "unlisted texture matches");
+
+	const struct
+	{
+		const char* Name;
+		uint64_t Bytes;
+	} Gen5Textures[] =
+	{
+		{ "Debug.TAA.DilateVelocity", 1920ull * 1080 * 8 },
+		{ "TAA.DilatedVelocity", 1920ull * 1080 * 4 },
+		{ "TAA.ClosestDepthTexture", 1920ull * 1080 * 2 },
+		{ "Debug.TAA.DecimateHistory", 1920ull * 1080 * 8 },
+		{ "TAA.ParallaxRejectionMask", 1920ull * 1080 },
+		{ "TAA.HistoryRejection", 960ull * 540 },
+		{ "TAA.History.LowFrequencies", 3840ull * 2160 * 4 },
+		{ "TAA.History.HighFrequencies", 3840ull * 2160 * 4 },
+		{ "TAA.History.Metadata", 3840ull * 2160 * 2 },
+		{ "Debug.TAA.UpdateHistory", 3840ull * 2160 * 8 },
+		{ "TAA.DilatedVelocity", 1920ull * 1080 * 4 },
+		{ "TAA.Compressed", 0 },
+	};
+	std::vector<FCaptureTapCandidate> Candidates;
+	for (const auto& Texture : Gen5Textures)
+	{
+		Candidates.push_back({ Texture.Name, Texture.Bytes });
+	}
+
+	auto SelectedNames = [&Candidates](const FCaptureTapSchedule& Schedule)
+	{
+		std::string Names;
+		for (uint32_t Index : Schedule.Selected)
+		{
+			Names += (Names.empty() ? "" : " ") + Candidates[Index].Name;
+		}
+		return Names;
+	};
+
+	FCaptureTapBudget Unlimited;
+	Unlimited.MaxTaps = 0;
+
+	Filter.Parse("");
+	Expect(ScheduleCaptureTaps(Filter, Candidates, Unlimited).Selected.empty(), "empty tap list schedules a readback");
+
+	// Pattern order first, offer order second, each name once.
+	Filter.Parse("TAA.History.*, TAA.DilatedVelocity, TAA.Compressed");
+	FCaptureTapSchedule Schedule = ScheduleCaptureTaps(Filter, Candidates, Unlimited);
+	Expect(SelectedNames(Schedule) == "TAA.History.LowFrequencies TAA.History.HighFrequencies TAA.History.Metadata TAA.DilatedVelocity",
+		"taps are not ordered by pattern, then by offer");
+	Expect(Schedule.NumDuplicates == 1 && Schedule.NumUnsupported == 1 && Schedule.NumOverBudget == 0, "duplicate or uncapturable taps are not counted");
+
+	// Two taps at most: the history layers listed first take the slots.
+	FCaptureTapBudget TwoTaps;
+	TwoTaps.MaxTaps = 2;
+	Schedule = ScheduleCaptureTaps(Filter, Candidates, TwoTaps);
+	Expect(SelectedNames(Schedule) == "TAA.History.LowFrequencies TAA.History.HighFrequencies" && Schedule.NumOverBudget == 2,
+		"tap count budget is not applied in priority order");
+
+	// 60 MB: the first history layer fits, the second does not, the smaller ones after it still do.
+	FCaptureTapBudget SixtyMegabytes;
+	SixtyMegabytes.MaxTaps = 0;
+	SixtyMegabytes.MaxBytes = 60ull * 1024 * 1024;
+	Schedule = ScheduleCaptureTaps(Filter, Candidates, SixtyMegabytes);
+	Expect(SelectedNames(Schedule) == "TAA.History.LowFrequencies TAA.History.Metadata TAA.DilatedVelocity"
+		&& Schedule.SelectedBytes <= SixtyMegabytes.MaxBytes, "byte budget starves taps that still fit");
+
+	Filter.Parse("debug.taa.*");
+	Schedule = ScheduleCaptureTaps(Filter, Candidates, Unlimited);
+	Expect(SelectedNames(Schedule) == "Debug.TAA.DilateVelocity Debug.TAA.DecimateHistory Debug.TAA.UpdateHistory", "debug UAV wildcard selects the wrong taps");
+
+	printf("taps: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Drives the rate controller with a simulated slow sink at 60 fps: a writer queue of 16 frames that drops when full,
+ * drained at a fixed disk bandwidth. The controller has to settle on a disk slower than the capture without losing
+ * frames, climb back to full rate on a fast one, and slow down, then pause, as the disk fills up.
+ */
+int RunRateCheck()
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	const struct
+	{
+		const char* Name;
+		uint64_t Bytes;
+	} Layers[] =
+	{
+		{ "output", 1920ull * 1080 * 8 },
+		{ "input", 1920ull * 1080 * 8 },
+		{ "input_post", 1920ull * 1080 * 8 },
+		{ "velocity", 1920ull * 1080 * 4 },
+		{ "depth", 1920ull * 1080 * 4 },
+	};
+	constexpr double FrameSeconds = 1.0 / 60.0;
+	constexpr uint32_t QueueCapacity = 16;
+
+	FCaptureRateConfig Config;
+	Config.MinFreeDiskBytes = 2ull << 30;
+	FCaptureRateController Controller(Config);
+
+	std::vector<uint64_t> Queue;
+	uint64_t HeadWritten = 0;
+	uint64_t BytesWritten = 0;
+	uint64_t NumLost = 0;
+	uint64_t NumOffered = 0;
+	uint64_t NumAdmitted = 0;
+	uint64_t FrameId = 0;
+	uint64_t FreeDisk = ~0ull;
+	double DiskBytesPerSecond = 0.0;
+
+	struct FPhase
+	{
+		uint64_t Lost = 0;
+		uint64_t LostLastTenSeconds = 0;
+		uint64_t Admitted = 0;
+		uint64_t Shed = 0;
+	};
+	auto Run = [&](double Seconds)
+	{
+		FPhase Phase;
+		const uint64_t NumFrames = uint64_t(Seconds / FrameSeconds);
+		for (uint64_t Frame = 0; Frame < NumFrames; Frame++, FrameId++)
+		{
+			FCaptureRateSample Sample;
+			Sample.Time = double(FrameId) * FrameSeconds;
+			Sample.FrameId = FrameId;
+			Sample.QueueDepth = uint32_t(Queue.size());
+			Sample.QueueCapacity = QueueCapacity;
+			Sample.BytesWritten = BytesWritten;
+			Sample.Overflows = NumLost;
+			Sample.FreeDiskBytes = FreeDisk;
+			Controller.Update(Sample);
+
+			NumOffered++;
+			if (Controller.AdmitFrame(FrameId))
+			{
+				uint64_t Bytes = 0;
+				for (const auto& Layer : Layers)
+				{
+					if (Controller.IsLayerShed(Layer.Name))
+					{
+						Phase.Shed++;
+						continue;
+					}
+					Bytes += Layer.Bytes;
+				}
+				NumAdmitted++;
+				Phase.Admitted++;
+				if (Queue.size() < QueueCapacity)
+				{
+					Queue.push_back(Bytes);
+				}
+				else
+				{
+					NumLost++;
+					Phase.Lost++;
+					Phase.LostLastTenSeconds += Frame + uint64_t(10.0 / FrameSeconds) >= NumFrames ? 1 : 0;
+				}
+			}
+
+			double Budget = DiskBytesPerSecond * FrameSeconds;
+			while (Budget > 0.0 && !Queue.empty())
+			{
+				const uint64_t Chunk = std::min(uint64_t(Budget), Queue.front() - HeadWritten);
+				HeadWritten += Chunk;
+				BytesWritten += Chunk;
+				Budget -= double(Chunk) + 1.0;
+				if (FreeDisk != ~0ull)
+				{
+					FreeDisk -= std::min(FreeDisk, Chunk);
+				}
+				if (HeadWritten == Queue.front())
+				{
+					Queue.erase(Queue.begin());
+					HeadWritten = 0;
+				}
+			}
+		}
+		return Phase;
+	};
+	auto Report = [&Controller](const char* Name, const FPhase& Phase)
+	{
+		printf("  %-34s level %u, interval %u, %u shed, %s, %llu frames captured, %llu lost (%llu in the last 10 s), %.0f MB/s\n", Name,
+			Controller.GetLevel(), Controller.GetInterval(), Controller.GetNumShedPatterns(), Controller.IsPaused() ? "paused" : "running",
+			(unsigned long long)Phase.Admitted, (unsigned long long)Phase.Lost, (unsigned long long)Phase.LostLastTenSeconds,
+			Controller.GetWriteBytesPerSecond() / 1e6);
+	};
+
+	// 4 GB/s of layers against a 1.2 GB/s disk: only every fourth frame without input_post fits.
+	DiskBytesPerSecond = 1.2e9;
+	const FPhase Slow = Run(120.0);
+	Report("1.2 GB/s disk for 120 s:", Slow);
+	Expect(Slow.Shed > 0 && Controller.IsLayerShed("input_post") && !Controller.IsLayerShed("output"), "input_post is not shed first");
+	Expect(Controller.GetLevel() == 3 && Controller.GetInterval() == 4, "controller does not settle on every fourth frame");
+	Expect(Slow.LostLastTenSeconds == 0, "controller keeps losing frames after settling");
+
+	DiskBytesPerSecond = 6e9;
+	const FPhase Fast = Run(120.0);
+	Report("6 GB/s disk for 120 s:", Fast);
+	Expect(Controller.GetLevel() == 0 && Controller.GetInterval() == 1 && !Controller.IsLayerShed("input_post"), "controller does not recover full rate");
+	Expect(Fast.Lost == 0, "recovery loses frames");
+
+	// 100 GB left: 25 s at full rate, the controller has to stretch it, then stop short of the reserve.
+	FreeDisk = Config.MinFreeDiskBytes + 100ull * 1000 * 1000 * 1000;
+	const FPhase Filling = Run(20.0);
+	Report("100 GB free for 20 s:", Filling);
+	Expect(Controller.GetLevel() == Controller.GetMaxLevel() && !Controller.IsPaused(), "filling disk does not slow capture down");
+	const FPhase Full = Run(400.0);
+	Report("then 400 s more:", Full);
+	Expect(Controller.IsPaused() && FreeDisk + (64ull << 20) * QueueCapacity >= Config.MinFreeDiskBytes, "capture does not pause at the disk reserve");
+	const uint64_t AdmittedWhilePaused = NumAdmitted;
+	Run(5.0);
+	Expect(NumAdmitted == AdmittedWhilePaused, "paused controller admits frames");
+	FreeDisk = 50ull << 30;
+	Run(1.0);
+	Expect(!Controller.IsPaused() && Controller.GetDecisions().back().Reason == std::string("disk_freed"), "capture does not resume once space is freed");
+
+	// Every offered frame is either admitted or inside a skipped range, and every range holds skipped frames only.
+	uint64_t RangeFrames = 0;
+	bool bRangesOrdered = true;
+	uint64_t PreviousEnd = 0;
+	for (const std::pair<uint64_t, uint64_t>& Range : Controller.GetSkippedRanges())
+	{
+		bRangesOrdered &= Range.first <= Range.second && (RangeFrames == 0 || Range.first > PreviousEnd + 1);
+		RangeFrames += Range.second - Range.first + 1;
+		PreviousEnd = Range.second;
+	}
+	Expect(bRangesOrdered && RangeFrames == Controller.GetNumSkipped() && NumAdmitted + Controller.GetNumSkipped() == NumOffered,
+		"skipped ranges do not account for every refused frame");
+
+	uint32_t NumDecisionLines = 0;
+	bool bDecisionsChained = true;
+	uint32_t Level = 0;
+	for (const FCaptureRateDecision& Decision : Controller.GetDecisions())
+	{
+		const std::string Line = FormatCaptureRateDecision(Decision, Controller);
+		NumDecisionLines += Line.front() == '{' && Line.back() == '}' && Line.find(Decision.Reason) != std::string::npos ? 1 : 0;
+		bDecisionsChained &= Decision.FromLevel == Level && (Decision.Level + 1 == Level || Decision.Level == Level + 1 || Decision.Level == Level);
+		Level = Decision.Level;
+	}
+	Expect(NumDecisionLines == Controller.GetDecisions().size() && bDecisionsChained, "decisions are not logged one level at a time");
+	const std::string Summary = FormatCaptureRateSummary(Controller);
+	Expect(Summary.find("\"skipped_frames\":" + std::to_string(Controller.GetNumSkipped())) != std::string::npos, "summary does not list the skipped frames");
+	printf("  %zu decisions, %llu of %llu frames skipped in %zu ranges\n", Controller.GetDecisions().size(), (unsigned long long)Controller.GetNumSkipped(),
+		(unsigned long long)NumOffered, Controller.GetSkippedRanges().size());
+
+	printf("rate: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/** Analytic test scene for the TAA checks: a rotated checkerboard with a bright HDR stripe, at a point in output UV. */
+void ShadeTAAScene(float U, float V, float Out[3])
+{
+	const float S = U * 0.955f - V * 0.296f;
+	const float T = U * 0.296f + V * 0.955f;
+	const bool bChecker = (int32_t(std::floor(S * 96.0f)) + int32_t(std::floor(T * 54.0f))) & 1;
+	const bool bStripe = std::fabs(S - 0.61f) < 0.004f;
+	Out[0] = bStripe ? 8.0f : bChecker ? 0.9f : 0.05f;
+	Out[1] = bStripe ? 6.0f : bChecker ? 0.7f : 0.1f;
+	Out[2] = bChecker ? 0.2f : 0.4f;
+}
+
+/** Point samples the scene into an input frame as the rasterizer would with View.TemporalJitterPixels. */
+void RenderTAAFrame(int32_t Width, int32_t Height, float JitterX, float JitterY, float OffsetU, FCaptureImage& Color, FCaptureImage& Depth,
+	FCaptureImage& Velocity, float VelocityU)
+{
+	Color.Resize(Width, Height, 3);
+	Depth.Resize(Width, Height, 1);
+	Velocity.Resize(Width, Height, 2);
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		for (int32_t X = 0; X < Width; X++)
+		{
+			float RGB[3];
+			ShadeTAAScene((float(X) + 0.5f - JitterX) / float(Width) + OffsetU, (float(Y) + 0.5f - JitterY) / float(Height), RGB);
+			const size_t Pixel = size_t(Y) * Width + X;
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				Color.GetPlane(Channel)[Pixel] = RGB[Channel];
+			}
+			Depth.GetPlane(0)[Pixel] = 0.01f;
+			// ScreenPos moves by twice the UV offset; 0 means no velocity, so static frames leave it at 0.
+			Velocity.GetPlane(0)[Pixel] = VelocityU != 0.0f ? -2.0f * VelocityU * (0.499f * 0.5f) + 32767.0f / 65535.0f : 0.0f;
+			Velocity.GetPlane(1)[Pixel] = VelocityU != 0.0f ? 32767.0f / 65535.0f : 0.0f;
+		}
+	}
+}
+
+/** Output sized reference of the scene, every pixel averaged over 8x8 samples. */
+void RenderTAAReference(int32_t Width, int32_t Height, float OffsetU, FCaptureImage& Reference)
+{
+	Reference.Resize(Width, Height, 3);
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		for (int32_t X = 0; X < Width; X++)
+		{
+			float Sum[3] = {};
+			for (int32_t Sample = 0; Sample < 64; Sample++)
+			{
+				float RGB[3];
+				ShadeTAAScene((float(X) + (float(Sample % 8) + 0.5f) / 8.0f) / float(Width) + OffsetU, (float(Y) + (float(Sample / 8) + 0.5f) / 8.0f) / float(Height), RGB);
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Sum[Channel] += RGB[Channel] / 64.0f;
+				}
+			}
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				Reference.GetPlane(Channel)[size_t(Y) * Width + X] = Sum[Channel];
+			}
+		}
+	}
+}
+
+/** Mean absolute difference over the first three channels, tonemapped by x / (1 + x) so the HDR stripe does not dominate. */
+double MeanTonemappedError(const FCaptureImage& A, const FCaptureImage& B)
+{
+	double Sum = 0.0;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		for (size_t Pixel = 0; Pixel < A.GetPlaneSize(); Pixel++)
+		{
+			const float ValueA = A.GetPlane(Channel)[Pixel];
+			const float ValueB = B.GetPlane(Channel)[Pixel];
+			Sum += std::fabs(ValueA / (1.0f + ValueA) - ValueB / (1.0f + ValueB));
+		}
+	}
+	return Sum / double(A.GetPlaneSize() * 3);
+}
+
+bool SameImageBits(const FCaptureImage& A, const FCaptureImage& B)
+{
+	const size_t Size = A.GetPlaneSize() * size_t(A.NumChannels);
+	return A.Width == B.Width && A.Height == B.Height && A.NumChannels == B.NumChannels && memcmp(A.Data.data(), B.Data.data(), Size * sizeof(float)) == 0;
+}
+
+/** Halton (2, 3) jitter in [-0.5, 0.5), the 8 sample sequence of the engine. */
+void GetTAAJitter(uint32_t Frame, float& OutX, float& OutY)
+{
+	auto Halton = [](uint32_t Index, uint32_t Base)
+	{
+		float Result = 0.0f;
+		float Fraction = 1.0f / float(Base);
+		for (; Index; Index /= Base, Fraction /= float(Base))
+		{
+			Result += float(Index % Base) * Fraction;
+		}
+		return Result;
+	};
+	OutX = Halton(Frame % 8 + 1, 2) - 0.5f;
+	OutY = Halton(Frame % 8 + 1, 3) - 0.5f;
+}
+
+/**
+ * Checks the CPU reference of the Gen4 TAA resolve: sample weights against SetupSampleWeightParameters(), history
+ * rounding against its definition, eight lanes against one and threads against one thread to the bit, convergence
+ * and stability on a static scene, reprojection with velocity, camera cuts. Then times 720p to 1080p upsampling.
+ */
+int RunTAACheck(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	// Weights.
+	{
+		float SampleWeights[9];
+		float PlusWeights[5];
+		ComputeCaptureFilterWeights(ECaptureFilterKernel::Gaussian, 0.0f, 0.0f, 1.0f, SampleWeights, PlusWeights);
+		const float Side = std::exp(-2.29f);
+		const float Corner = std::exp(-4.58f);
+		Expect(std::fabs(SampleWeights[4] - 1.0f / (1.0f + 4.0f * Side + 4.0f * Corner)) < 1e-6f && std::fabs(SampleWeights[0] - SampleWeights[8]) < 1e-7f,
+			"gaussian weights of a centered sample");
+		Expect(std::fabs(PlusWeights[2] - 1.0f / (1.0f + 4.0f * Side)) < 1e-6f, "plus weights are not the renormalized cross");
+
+		ComputeCaptureFilterWeights(ECaptureFilterKernel::CatmullRom, 0.0f, 0.0f, 1.0f, SampleWeights, PlusWeights);
+		Expect(SampleWeights[4] == 1.0f && SampleWeights[1] == 0.0f && SampleWeights[0] == 0.0f, "catmull-rom weights of a centered sample");
+
+		bool bNormalized = true;
+		for (uint32_t Frame = 0; Frame < 8; Frame++)
+		{
+			float JitterX, JitterY;
+			GetTAAJitter(Frame, JitterX, JitterY);
+			ComputeCaptureFilterWeights(ECaptureFilterKernel(Frame % uint32_t(ECaptureFilterKernel::Count)), JitterX, JitterY, 1.3f, SampleWeights, PlusWeights);
+			float Sum = 0.0f;
+			for (float Weight : SampleWeights)
+			{
+				Sum += Weight;
+			}
+			bNormalized &= std::fabs(Sum - 1.0f) < 1e-5f;
+		}
+		Expect(bNormalized, "sample weights do not sum to one");
+	}
+
+	// History rounding: nearest even at 10, 6 and 5 bits of mantissa, against double arithmetic.
+	{
+		std::mt19937 Random(19);
+		std::uniform_real_distribution<float> Exponent(-26.0f, 17.0f);
+		uint32_t NumWrong = 0;
+		const int32_t MantissaBits[3] = { 10, 6, 5 };
+		const float MaxValues[3] = { 65504.0f, 65024.0f, 64512.0f };
+		for (uint32_t Index = 0; Index < 300000; Index++)
+		{
+			const float Value = Index < 1000 ? float(Index) / 1000.0f * 1e-4f : std::exp2(Exponent(Random));
+			for (int32_t Format = 0; Format < 3; Format++)
+			{
+				const double Step = std::ldexp(1.0, std::max(int32_t(std::floor(std::log2(double(Value)))), -14) - MantissaBits[Format]);
+				const double Expected = std::min(std::nearbyint(double(Value) / Step) * Step, double(MaxValues[Format]));
+				const float Quantized = QuantizeCaptureFloat(FCaptureFloat1::Splat(Value), MantissaBits[Format], MaxValues[Format]).V;
+				NumWrong += Value > 0.0f && double(Quantized) != Expected;
+			}
+		}
+		Expect(NumWrong == 0, "history rounding differs from round to nearest even");
+	}
+
+	const int32_t Width = 160;
+	const int32_t Height = 96;
+	FCaptureImage Color, Depth, Velocity, Output, Reference;
+
+	// Eight lanes against one, threads against one thread, for every configuration.
+	{
+		struct FConfig
+		{
+			const char* Name;
+			int32_t OutputWidth;
+			int32_t OutputHeight;
+			bool bFast;
+			bool bR11G11B10;
+			ECaptureFilterKernel FilterKernel;
+		} Configs[] =
+		{
+			{ "main", Width, Height, false, false, ECaptureFilterKernel::Gaussian },
+			{ "main catmull-rom", Width, Height, false, false, ECaptureFilterKernel::CatmullRom },
+			{ "main fast r11g11b10", Width, Height, true, true, ECaptureFilterKernel::Gaussian },
+			{ "upsampling", Width * 3 / 2 + 5, Height * 3 / 2, false, false, ECaptureFilterKernel::Gaussian },
+		};
+		for (const FConfig& Config : Configs)
+		{
+			FCaptureTAAGen4Settings Settings;
+			Settings.bFast = Config.bFast;
+			Settings.bR11G11B10History = Config.bR11G11B10;
+			Settings.FilterKernel = Config.FilterKernel;
+			Settings.NumThreads = 1;
+			FCaptureTAAGen4Settings ScalarSettings = Settings;
+			ScalarSettings.bScalar = true;
+			FCaptureTAAGen4Settings ThreadedSettings = Settings;
+			ThreadedSettings.NumThreads = std::max(Options.NumThreads, 2u);
+
+			FCaptureTAAGen4 Simd(Settings);
+			FCaptureTAAGen4 Scalar(ScalarSettings);
+			FCaptureTAAGen4 Threaded(ThreadedSettings);
+			bool bSameLanes = true;
+			bool bSameThreads = true;
+			for (uint32_t Frame = 0; Frame < 4; Frame++)
+			{
+				FCaptureTAAGen4Frame Input;
+				GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+				RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.004f * float(Frame), Color, Depth, Velocity, 0.004f);
+				// Half the pixels move with the camera.
+				for (size_t Pixel = 0; Pixel < Velocity.GetPlaneSize(); Pixel += 2)
+				{
+					Velocity.GetPlane(0)[Pixel] = 0.0f;
+				}
+				const float ClipToPrevClip[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -0.008f, 0, 0, 1 };
+				Input.Color = &Color;
+				Input.Depth = &Depth;
+				Input.Velocity = &Velocity;
+				Input.ClipToPrevClip = ClipToPrevClip;
+				Input.PreExposure = 1.0f + 0.1f * float(Frame);
+
+				FCaptureImage ScalarOutput, ThreadedOutput;
+				Simd.Resolve(Input, Config.OutputWidth, Config.OutputHeight, Output);
+				Scalar.Resolve(Input, Config.OutputWidth, Config.OutputHeight, ScalarOutput);
+				Threaded.Resolve(Input, Config.OutputWidth, Config.OutputHeight, ThreadedOutput);
+				bSameLanes &= SameImageBits(Output, ScalarOutput);
+				bSameThreads &= SameImageBits(Output, ThreadedOutput);
+			}
+			std::string What = std::string(Config.Name) + ": eight lanes differ from one";
+			Expect(bSameLanes, What.c_str());
+			What = std::string(Config.Name) + ": threads change the result";
+			Expect(bSameThreads, What.c_str());
+
+			if (Config.bR11G11B10)
+			{
+				bool bRepresentable = true;
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					for (size_t Pixel = 0; Pixel < Output.GetPlaneSize(); Pixel++)
+					{
+						uint32_t Bits;
+						memcpy(&Bits, &Output.GetPlane(Channel)[Pixel], sizeof(Bits));
+						bRepresentable &= (Bits >> 31) == 0 && (Output.GetPlane(Channel)[Pixel] < 1.0f / 16384.0f || (Bits & ((1u << (Channel == 2 ? 18 : 17)) - 1)) == 0);
+					}
+				}
+				Expect(bRepresentable, "r11g11b10 history holds values the format cannot");
+			}
+		}
+	}
+
+	// Static scene: the resolve converges towards the supersampled scene and stops shimmering.
+	{
+		FCaptureTAAGen4Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen4 TAA(Settings);
+		RenderTAAReference(Width, Height, 0.0f, Reference);
+
+		FCaptureImage PreviousColor, PreviousOutput;
+		double InputError = 0.0, OutputError = 0.0, InputChange = 0.0, OutputChange = 0.0;
+		for (uint32_t Frame = 0; Frame < 48; Frame++)
+		{
+			FCaptureTAAGen4Frame Input;
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.0f, Color, Depth, Velocity, 0.0f);
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.Velocity = &Velocity;
+			TAA.Resolve(Input, Width, Height, Output);
+			if (Frame >= 40)
+			{
+				InputError += MeanTonemappedError(Color, Reference) / 8.0;
+				OutputError += MeanTonemappedError(Output, Reference) / 8.0;
+				InputChange += MeanTonemappedError(Color, PreviousColor) / 8.0;
+				OutputChange += MeanTonemappedError(Output, PreviousOutput) / 8.0;
+			}
+			PreviousColor = Color;
+			PreviousOutput = Output;
+		}
+		printf("  static: error %.4f -> %.4f, frame to frame change %.4f -> %.4f\n", InputError, OutputError, InputChange, OutputChange);
+		Expect(OutputError < InputError, "static scene does not converge towards the reference");
+		Expect(OutputChange < 0.25 * InputChange, "static scene still shimmers");
+	}
+
+	// Moving scene: reprojecting with the velocity keeps the history, ignoring it ghosts.
+	{
+		double Errors[2] = {};
+		for (int32_t bUseVelocity = 0; bUseVelocity < 2; bUseVelocity++)
+		{
+			FCaptureTAAGen4Settings Settings;
+			Settings.NumThreads = Options.NumThreads;
+			FCaptureTAAGen4 TAA(Settings);
+			const float Speed = 3.0f / float(Width);
+			for (uint32_t Frame = 0; Frame < 32; Frame++)
+			{
+				FCaptureTAAGen4Frame Input;
+				GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+				RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, Speed * float(Frame), Color, Depth, Velocity, bUseVelocity ? Speed : 0.0f);
+				Input.Color = &Color;
+				Input.Depth = &Depth;
+				Input.Velocity = &Velocity;
+				TAA.Resolve(Input, Width, Height, Output);
+				if (Frame >= 24)
+				{
+					RenderTAAReference(Width, Height, Speed * float(Frame), Reference);
+					Errors[bUseVelocity] += MeanTonemappedError(Output, Reference) / 8.0;
+				}
+			}
+		}
+		printf("  moving: error %.4f without velocity, %.4f with\n", Errors[0], Errors[1]);
+		Expect(Errors[1] < Errors[0], "velocity does not help a moving scene");
+	}
+
+	// Camera cut: nothing of the previous history survives, the frame resolves as the first one of a sequence.
+	{
+		FCaptureTAAGen4Settings Settings;
+		Settings.NumThreads = 1;
+		FCaptureTAAGen4 TAA(Settings);
+		FCaptureTAAGen4 Fresh(Settings);
+		FCaptureTAAGen4Frame Input;
+		for (uint32_t Frame = 0; Frame < 6; Frame++)
+		{
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, Frame < 5 ? 0.0f : 0.3f, Color, Depth, Velocity, 0.0f);
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.bCameraCut = Frame == 5;
+			TAA.Resolve(Input, Width, Height, Output);
+		}
+		FCaptureImage FreshOutput;
+		Fresh.Resolve(Input, Width, Height, FreshOutput);
+		Expect(SameImageBits(Output, FreshOutput), "camera cut keeps history");
+	}
+
+	// Throughput of 720p to 1080p upsampling on one thread and on the pool.
+	{
+		const int32_t InputWidth = 1280, InputHeight = 720;
+		RenderTAAFrame(InputWidth, InputHeight, 0.0f, 0.0f, 0.0f, Color, Depth, Velocity, 0.001f);
+		const uint32_t NumThreads[2] = { 1, std::max(std::thread::hardware_concurrency(), 1u) };
+		for (uint32_t Run = 0; Run < (NumThreads[1] > 1 ? 2u : 1u); Run++)
+		{
+			FCaptureTAAGen4Settings Settings;
+			Settings.NumThreads = NumThreads[Run];
+			FCaptureTAAGen4 TAA(Settings);
+			FCaptureTAAGen4Frame Input;
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.Velocity = &Velocity;
+			const uint32_t NumFrames = std::min(Options.NumFrames, 16u);
+			const auto Start = std::chrono::steady_clock::now();
+			for (uint32_t Frame = 0; Frame < NumFrames; Frame++)
+			{
+				GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+				TAA.Resolve(Input, 1920, 1080, Output);
+			}
+			const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count() / NumFrames;
+			printf("  720p -> 1080p, %u thread%s%s: %.1f ms per frame, %.1f fps\n", NumThreads[Run], NumThreads[Run] > 1 ? "s" : "",
+				CAPTURE_SIMD_AVX2 ? ", avx2" : "", Seconds * 1e3, 1.0 / Seconds);
+		}
+	}
+
+	printf("taa: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/** SetupSampleWeightParameters() of 4.26 as it was, the two kernels it had evaluated per frame. */
+void ComputeLegacyTAASampleWeights(float JitterX, float JitterY, float FilterSize, bool bCatmullRom, float OutSampleWeights[9])
+{
+	auto CatmullRom = [](float x)
+	{
+		float ax = std::fabs(x);
+		if (ax > 1.0f)
+			return ((-0.5f * ax + 2.5f) * ax - 4.0f) * ax + 2.0f;
+		else
+			return (1.5f * ax - 2.5f) * ax * ax + 1.0f;
+	};
+	float TotalWeight = 0.0f;
+	for (int32_t i = 0; i < 9; i++)
+	{
+		float PixelOffsetX = float(i % 3 - 1) - JitterX;
+		float PixelOffsetY = float(i / 3 - 1) - JitterY;
+
+		PixelOffsetX /= FilterSize;
+		PixelOffsetY /= FilterSize;
+
+		if (bCatmullRom)
+		{
+			OutSampleWeights[i] = CatmullRom(PixelOffsetX) * CatmullRom(PixelOffsetY);
+		}
+		else
+		{
+			OutSampleWeights[i] = std::exp(-2.29f * (PixelOffsetX * PixelOffsetX + PixelOffsetY * PixelOffsetY));
+		}
+		TotalWeight += OutSampleWeights[i];
+	}
+	for (int32_t i = 0; i < 9; i++)
+	{
+		OutSampleWeights[i] /= TotalWeight;
+	}
+}
+
+/** Resolves NumFrames of the TAA scene moving by Speed and returns the error and frame to frame change of the last eight. */
+void ResolveTAAScene(const FCaptureTAAGen4Settings& Settings, float Speed, uint32_t NumFrames, double& OutError, double& OutChange)
+{
+	const int32_t Width = 160;
+	const int32_t Height = 96;
+	FCaptureTAAGen4 TAA(Settings);
+	FCaptureImage Color, Depth, Velocity, Output, PreviousOutput, Reference;
+	OutError = 0.0;
+	OutChange = 0.0;
+	if (Speed == 0.0f)
+	{
+		RenderTAAReference(Width, Height, 0.0f, Reference);
+	}
+	for (uint32_t Frame = 0; Frame < NumFrames; Frame++)
+	{
+		FCaptureTAAGen4Frame Input;
+		GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+		RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, Speed * float(Frame), Color, Depth, Velocity, Speed);
+		Input.Color = &Color;
+		Input.Depth = &Depth;
+		Input.Velocity = &Velocity;
+		TAA.Resolve(Input, Width, Height, Output);
+		if (Frame + 8 >= NumFrames)
+		{
+			if (Speed != 0.0f)
+			{
+				RenderTAAReference(Width, Height, Speed * float(Frame), Reference);
+			}
+			OutError += MeanTonemappedError(Output, Reference) / 8.0;
+			OutChange += MeanTonemappedError(Output, PreviousOutput) / 8.0;
+		}
+		PreviousOutput = Output;
+	}
+}
+
+/**
+ * Compares the reconstruction filters of CaptureFilterKernels.h. Checks Gaussian and Catmull-Rom against 4.26, the
+ * weights of every kernel, and the weight tables against direct evaluation; times the per frame weight setup both
+ * ways; then resolves a static and a moving scene with every kernel, or the frames of --capture, and reports the
+ * error against the reference (or the captured output) and how much the output changes from frame to frame.
+ */
+int RunKernelsBench(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	const uint32_t NumKernels = uint32_t(ECaptureFilterKernel::Count);
+	std::mt19937 Random(20);
+	std::uniform_real_distribution<float> JitterDistribution(-0.5f, 0.5f);
+	std::uniform_real_distribution<float> FilterSizeDistribution(0.5f, 2.0f);
+
+	// Gaussian and Catmull-Rom give the bits 4.26 did, over the filter sizes where its Catmull-Rom stays within 2 pixels.
+	{
+		std::uniform_real_distribution<float> LegacyFilterSizeDistribution(0.75f, 2.0f);
+		bool bSame = true;
+		for (uint32_t Index = 0; Index < 20000; Index++)
+		{
+			const float JitterX = JitterDistribution(Random);
+			const float JitterY = JitterDistribution(Random);
+			const float FilterSize = LegacyFilterSizeDistribution(Random);
+			const bool bCatmullRom = Index & 1;
+			float Expected[9], SampleWeights[9], PlusWeights[5];
+			ComputeLegacyTAASampleWeights(JitterX, JitterY, FilterSize, bCatmullRom, Expected);
+			ComputeCaptureFilterWeights(bCatmullRom ? ECaptureFilterKernel::CatmullRom : ECaptureFilterKernel::Gaussian, JitterX, JitterY, FilterSize, SampleWeights, PlusWeights);
+			bSame &= memcmp(Expected, SampleWeights, sizeof(Expected)) == 0;
+		}
+		Expect(bSame, "gaussian or catmull-rom weights differ from 4.26");
+	}
+
+	// Every kernel: normalized, mirrored with the jitter, peaking at the sample the jitter is closest to.
+	for (uint32_t KernelIndex = 0; KernelIndex < NumKernels; KernelIndex++)
+	{
+		const ECaptureFilterKernel Kernel = ECaptureFilterKernel(KernelIndex);
+		const std::string Name = GetCaptureFilterKernelName(Kernel);
+		ECaptureFilterKernel Parsed;
+		Expect(ParseCaptureFilterKernel(Name.c_str(), Parsed) && Parsed == Kernel, (Name + ": name does not parse back").c_str());
+
+		bool bNormalized = true;
+		bool bMirrored = true;
+		bool bPeaked = true;
+		for (uint32_t Index = 0; Index < 2000; Index++)
+		{
+			const float JitterX = JitterDistribution(Random);
+			const float JitterY = JitterDistribution(Random);
+			const float FilterSize = FilterSizeDistribution(Random);
+			float SampleWeights[9], PlusWeights[5], MirroredWeights[9], MirroredPlusWeights[5];
+			ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, FilterSize, SampleWeights, PlusWeights);
+			ComputeCaptureFilterWeights(Kernel, -JitterX, JitterY, FilterSize, MirroredWeights, MirroredPlusWeights);
+			float Sum = 0.0f, PlusSum = 0.0f;
+			for (int32_t i = 0; i < 9; i++)
+			{
+				Sum += SampleWeights[i];
+				bMirrored &= std::fabs(SampleWeights[i] - MirroredWeights[i / 3 * 3 + 2 - i % 3]) < 1e-5f;
+			}
+			for (float Weight : PlusWeights)
+			{
+				PlusSum += Weight;
+			}
+			bNormalized &= std::fabs(Sum - 1.0f) < 1e-5f && std::fabs(PlusSum - 1.0f) < 1e-5f;
+			bPeaked &= *std::max_element(SampleWeights, SampleWeights + 9) == SampleWeights[4];
+		}
+		Expect(bNormalized, (Name + ": weights do not sum to one").c_str());
+
+		float SampleWeights[9], PlusWeights[5];
+		ComputeCaptureFilterWeights(Kernel, 0.3f, -0.2f, 0.0f, SampleWeights, PlusWeights);
+		Expect(SampleWeights[4] == 1.0f && PlusWeights[2] == 1.0f && std::count(SampleWeights, SampleWeights + 9, 0.0f) == 8,
+			(Name + ": a filter size of 0 does not take the closest sample").c_str());
+		Expect(bMirrored, (Name + ": weights are not mirrored with the jitter").c_str());
+		Expect(bPeaked, (Name + ": the center sample is not the heaviest").c_str());
+	}
+
+	// Tables: exact on the grid, close in between, direct outside.
+	for (uint32_t KernelIndex = 0; KernelIndex < NumKernels; KernelIndex++)
+	{
+		const ECaptureFilterKernel Kernel = ECaptureFilterKernel(KernelIndex);
+		const std::string Name = GetCaptureFilterKernelName(Kernel);
+		const FCaptureFilterWeightTable Table(Kernel, 1.0f, 1.0f, 1);
+		const FCaptureFilterWeightTable SizesTable(Kernel, 1.0f, 2.0f, 9);
+
+		bool bExactOnGrid = true;
+		for (int32_t PhaseY = 0; PhaseY < FCaptureFilterWeightTable::DefaultNumPhases; PhaseY++)
+		{
+			for (int32_t PhaseX = 0; PhaseX < FCaptureFilterWeightTable::DefaultNumPhases; PhaseX++)
+			{
+				const float JitterX = float(PhaseX) / 32.0f - 0.5f;
+				const float JitterY = float(PhaseY) / 32.0f - 0.5f;
+				float Expected[9], ExpectedPlus[5], SampleWeights[9], PlusWeights[5];
+				ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, 1.0f, Expected, ExpectedPlus);
+				for (const FCaptureFilterWeightTable* Lookup : { &Table, &SizesTable })
+				{
+					Lookup->Lookup(JitterX, JitterY, 1.0f, SampleWeights, PlusWeights);
+					bExactOnGrid &= std::equal(Expected, Expected + 9, SampleWeights) && std::equal(ExpectedPlus, ExpectedPlus + 5, PlusWeights);
+				}
+			}
+		}
+		Expect(bExactOnGrid, (Name + ": table differs from direct evaluation on its grid").c_str());
+
+		float MaxError = 0.0f;
+		float MaxSizesError = 0.0f;
+		float MaxSumError = 0.0f;
+		for (uint32_t Index = 0; Index < 20000; Index++)
+		{
+			const float JitterX = JitterDistribution(Random);
+			const float JitterY = JitterDistribution(Random);
+			const float FilterSize = 1.0f + JitterDistribution(Random) + 0.5f;
+			float Expected[9], ExpectedPlus[5], SampleWeights[9], PlusWeights[5];
+			ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, 1.0f, Expected, ExpectedPlus);
+			Table.Lookup(JitterX, JitterY, 1.0f, SampleWeights, PlusWeights);
+			float Sum = 0.0f;
+			for (int32_t i = 0; i < 9; i++)
+			{
+				MaxError = std::max(MaxError, std::fabs(SampleWeights[i] - Expected[i]));
+				Sum += SampleWeights[i];
+			}
+			for (int32_t i = 0; i < 5; i++)
+			{
+				MaxError = std::max(MaxError, std::fabs(PlusWeights[i] - ExpectedPlus[i]));
+			}
+			MaxSumError = std::max(MaxSumError, std::fabs(Sum - 1.0f));
+
+			ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, FilterSize, Expected, ExpectedPlus);
+			SizesTable.Lookup(JitterX, JitterY, FilterSize, SampleWeights, PlusWeights);
+			for (int32_t i = 0; i < 9; i++)
+			{
+				MaxSizesError = std::max(MaxSizesError, std::fabs(SampleWeights[i] - Expected[i]));
+			}
+		}
+		printf("  %-18s table %5.1f KB, error %.2e, over filter sizes 1 to 2 (%5.1f KB) %.2e\n", Name.c_str(), double(Table.GetAllocatedSize()) / 1024.0,
+			MaxError, double(SizesTable.GetAllocatedSize()) / 1024.0, MaxSizesError);
+		Expect(MaxError < 2e-3f && MaxSumError < 1e-5f, (Name + ": table interpolation is off").c_str());
+		Expect(MaxSizesError < 3e-2f, (Name + ": table interpolation over filter sizes is off").c_str());
+
+		bool bDirectOutside = true;
+		const float Outside[3][3] = { { 0.7f, 0.0f, 1.0f }, { 0.1f, -0.6f, 1.0f }, { 0.1f, 0.2f, 1.25f } };
+		for (const float* Case : Outside)
+		{
+			float Expected[9], ExpectedPlus[5], SampleWeights[9], PlusWeights[5];
+			ComputeCaptureFilterWeights(Kernel, Case[0], Case[1], Case[2], Expected, ExpectedPlus);
+			Table.Lookup(Case[0], Case[1], Case[2], SampleWeights, PlusWeights);
+			bDirectOutside &= memcmp(Expected, SampleWeights, sizeof(Expected)) == 0 && memcmp(ExpectedPlus, PlusWeights, sizeof(ExpectedPlus)) == 0;
+		}
+		Expect(bDirectOutside, (Name + ": jitter or filter size outside the table is not evaluated directly").c_str());
+	}
+
+	// Per frame setup: evaluating the kernel against looking its weights up.
+	{
+		std::vector<float> Jitters(2 * 4096);
+		for (float& Jitter : Jitters)
+		{
+			Jitter = JitterDistribution(Random);
+		}
+		const uint32_t NumCalls = 1u << 20;
+		for (uint32_t KernelIndex = 0; KernelIndex < NumKernels; KernelIndex++)
+		{
+			const ECaptureFilterKernel Kernel = ECaptureFilterKernel(KernelIndex);
+			const auto BuildStart = std::chrono::steady_clock::now();
+			const FCaptureFilterWeightTable Table(Kernel, 1.0f, 1.0f, 1);
+			const double BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - BuildStart).count();
+
+			double Seconds[2];
+			float Checksum = 0.0f;
+			for (int32_t bTable = 0; bTable < 2; bTable++)
+			{
+				const auto Start = std::chrono::steady_clock::now();
+				for (uint32_t Call = 0; Call < NumCalls; Call++)
+				{
+					const float* Jitter = &Jitters[(Call & 4095) * 2];
+					float SampleWeights[9], PlusWeights[5];
+					if (bTable)
+					{
+						Table.Lookup(Jitter[0], Jitter[1], 1.0f, SampleWeights, PlusWeights);
+					}
+					else
+					{
+						ComputeCaptureFilterWeights(Kernel, Jitter[0], Jitter[1], 1.0f, SampleWeights, PlusWeights);
+					}
+					Checksum += SampleWeights[Call % 9] + PlusWeights[Call % 5];
+				}
+				Seconds[bTable] = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+			}
+			volatile float Sink = Checksum;
+			(void)Sink;
+			printf("  %-18s setup %6.1f ns evaluated, %6.1f ns from the table (built in %.2f ms)\n", GetCaptureFilterKernelName(Kernel),
+				Seconds[0] * 1e9 / NumCalls, Seconds[1] * 1e9 / NumCalls, BuildSeconds * 1e3);
+		}
+	}
+
+	// Resolve quality of every kernel, plus 4.26's per frame evaluation of the default one to show the table is invisible.
+	const uint32_t NumRuns = NumKernels + 1;
+	auto GetRunSettings = [&Options, NumKernels](uint32_t Run)
+	{
+		FCaptureTAAGen4Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		Settings.FilterKernel = Run < NumKernels ? ECaptureFilterKernel(Run) : ECaptureFilterKernel::Gaussian;
+		Settings.bWeightTable = Run < NumKernels;
+		return Settings;
+	};
+	auto GetRunName = [NumKernels](uint32_t Run)
+	{
+		return Run < NumKernels ? std::string(GetCaptureFilterKernelName(ECaptureFilterKernel(Run))) : std::string("gaussian, evaluated");
+	};
+
+	if (Options.CapturePath.empty())
+	{
+		double InputError = 0.0;
+		{
+			FCaptureImage Color, Depth, Velocity, Reference;
+			RenderTAAReference(160, 96, 0.0f, Reference);
+			for (uint32_t Frame = 0; Frame < 8; Frame++)
+			{
+				float JitterX, JitterY;
+				GetTAAJitter(Frame, JitterX, JitterY);
+				RenderTAAFrame(160, 96, JitterX, JitterY, 0.0f, Color, Depth, Velocity, 0.0f);
+				InputError += MeanTonemappedError(Color, Reference) / 8.0;
+			}
+		}
+		printf("  static scene, aliased input error %.4f\n", InputError);
+
+		double Errors[NumRuns][2];
+		for (uint32_t Run = 0; Run < NumRuns; Run++)
+		{
+			double StaticChange, MovingChange;
+			ResolveTAAScene(GetRunSettings(Run), 0.0f, 48, Errors[Run][0], StaticChange);
+			ResolveTAAScene(GetRunSettings(Run), 3.0f / 160.0f, 32, Errors[Run][1], MovingChange);
+			printf("  %-20s static error %.4f, change %.4f   moving error %.4f, change %.4f\n", GetRunName(Run).c_str(), Errors[Run][0], StaticChange,
+				Errors[Run][1], MovingChange);
+			Expect(Errors[Run][0] < InputError, (GetRunName(Run) + ": static scene does not converge towards the reference").c_str());
+		}
+		Expect(std::fabs(Errors[NumKernels][0] - Errors[0][0]) < 1e-4 && std::fabs(Errors[NumKernels][1] - Errors[0][1]) < 1e-4,
+			"table weights change the gaussian resolve");
+	}
+	else
+	{
+		FCaptureReader Reader;
+		if (!Reader.Open(Options.CapturePath))
+		{
+			fprintf(stderr, "cannot open %s\n", Options.CapturePath.c_str());
+			return 1;
+		}
+
+		// Every frame is decoded once and resolved by all kernels, each keeping its own history.
+		std::vector<std::unique_ptr<FCaptureTAAGen4>> Resolvers;
+		for (uint32_t Run = 0; Run < NumRuns; Run++)
+		{
+			Resolvers.emplace_back(new FCaptureTAAGen4(GetRunSettings(Run)));
+		}
+		std::vector<FCaptureImage> Outputs(NumRuns), PreviousOutputs(NumRuns);
+		std::vector<double> SumErrors(NumRuns), SumChanges(NumRuns), ResolveSeconds(NumRuns);
+		FCaptureTAAGen4FrameImages Images;
+		FCaptureImage Captured;
+		std::vector<uint8_t> DecodeBuffer;
+		uint32_t NumResolved = 0, NumCompared = 0, NumChanges = 0;
+		const uint32_t NumFrames = std::min(Options.NumFrames, Reader.GetNumFrames());
+		for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+		{
+			FCaptureTAAGen4Frame Frame;
+			if (!LoadCaptureTAAGen4Frame(Reader, FrameIndex, Images, Frame, DecodeBuffer))
+			{
+				continue;
+			}
+			const bool bHasCaptured = LoadCaptureImage(Reader, FrameIndex, "output", "rgb", Captured, DecodeBuffer) && Captured.NumChannels >= 3;
+			const int32_t Width = bHasCaptured ? Captured.Width : Images.Color.Width;
+			const int32_t Height = bHasCaptured ? Captured.Height : Images.Color.Height;
+			const bool bHasChange = NumResolved > 0 && !Frame.bCameraCut && PreviousOutputs[0].Width == Width && PreviousOutputs[0].Height == Height;
+			for (uint32_t Run = 0; Run < NumRuns; Run++)
+			{
+				const auto Start = std::chrono::steady_clock::now();
+				Resolvers[Run]->Resolve(Frame, Width, Height, Outputs[Run]);
+				ResolveSeconds[Run] += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+				if (bHasCaptured)
+				{
+					SumErrors[Run] += MeanTonemappedError(Outputs[Run], Captured);
+				}
+				if (bHasChange)
+				{
+					SumChanges[Run] += MeanTonemappedError(Outputs[Run], PreviousOutputs[Run]);
+				}
+				std::swap(Outputs[Run], PreviousOutputs[Run]);
+			}
+			NumResolved++;
+			NumCompared += bHasCaptured;
+			NumChanges += bHasChange;
+		}
+		if (!NumResolved)
+		{
+			fprintf(stderr, "%s has no frames with an input layer\n", Options.CapturePath.c_str());
+			return 1;
+		}
+		printf("  %s: %u frames, %u with a captured output\n", Options.CapturePath.c_str(), NumResolved, NumCompared);
+		for (uint32_t Run = 0; Run < NumRuns; Run++)
+		{
+			printf("  %-20s %6.1f ms per frame, error against the captured output %.5f, frame to frame change %.5f\n", GetRunName(Run).c_str(),
+				ResolveSeconds[Run] * 1e3 / NumResolved, NumCompared ? SumErrors[Run] / NumCompared : 0.0, NumChanges ? SumChanges[Run] / NumChanges : 0.0);
+		}
+	}
+
+	printf("kernels: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/** Adds a square of foreground, closer than the TAA scene, moving right by Speed input pixels a frame. */
+void AddGen5Foreground(uint32_t Frame, float Speed, FCaptureImage& Color, FCaptureImage& Depth, FCaptureImage& Velocity)
+{
+	const int32_t MinX = 40 + int32_t(Speed * float(Frame));
+	const int32_t MinY = 30;
+	for (int32_t Y = MinY; Y < MinY + 36; Y++)
+	{
+		for (int32_t X = MinX; X < std::min(MinX + 36, Color.Width); X++)
+		{
+			const size_t Pixel = size_t(Y) * Color.Width + X;
+			Color.GetPlane(0)[Pixel] = 0.8f;
+			Color.GetPlane(1)[Pixel] = 0.2f;
+			Color.GetPlane(2)[Pixel] = 0.1f;
+			Depth.GetPlane(0)[Pixel] = 0.1f;
+			Velocity.GetPlane(0)[Pixel] = 2.0f * Speed / float(Color.Width) * (0.499f * 0.5f) + 32767.0f / 65535.0f;
+			Velocity.GetPlane(1)[Pixel] = 32767.0f / 65535.0f;
+		}
+	}
+}
+
+/** Mean of the first channel of an image. */
+double MeanPlane(const FCaptureImage& Image)
+{
+	double Sum = 0.0;
+	for (size_t Pixel = 0; Pixel < Image.GetPlaneSize(); Pixel++)
+	{
+		Sum += Image.GetPlane(0)[Pixel];
+	}
+	return Image.GetPlaneSize() ? Sum / double(Image.GetPlaneSize()) : 0.0;
+}
+
+void PrintGen5PassTimes(const FCaptureTAAGen5& TAA, uint32_t NumFrames)
+{
+	double Total = 0.0;
+	for (uint32_t Pass = 0; Pass < uint32_t(ECaptureTAAGen5Pass::Count); Pass++)
+	{
+		const double Seconds = TAA.GetPassSeconds(ECaptureTAAGen5Pass(Pass)) / NumFrames;
+		printf("    %-20s %7.2f ms\n", GetCaptureTAAGen5PassName(ECaptureTAAGen5Pass(Pass)), Seconds * 1e3);
+		Total += Seconds;
+	}
+	printf("    %-20s %7.2f ms, %.1f fps\n", "total", Total * 1e3, Total > 0.0 ? 1.0 / Total : 0.0);
+}
+
+/**
+ * Checks the CPU reference of the Gen5 TAAU chain: threads against one thread to the bit over every texture, the
+ * extents of each pass with a history screen percentage, the formats of the history, convergence of a static scene
+ * at 1:1 and upsampled, parallax rejection of what a moving foreground uncovers, history rejection of a content
+ * change, camera cuts. Then times every pass of 720p to 1080p, or of the frames of --capture against the captured
+ * output.
+ */
+int RunGen5Check(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	const int32_t Width = 160;
+	const int32_t Height = 96;
+	FCaptureImage Color, Depth, Velocity, Output, Reference;
+
+	// Threads against one thread, with and without upsampling and a larger history.
+	{
+		struct FConfig
+		{
+			const char* Name;
+			int32_t OutputWidth;
+			int32_t OutputHeight;
+			float HistoryScreenPercentage;
+			bool bR11G11B10;
+		} Configs[] =
+		{
+			{ "1:1", Width, Height, 100.0f, false },
+			{ "1:1 r11g11b10", Width, Height, 100.0f, true },
+			{ "upsampling", Width * 3 / 2 + 5, Height * 3 / 2, 100.0f, false },
+			{ "upsampling history 150%", Width * 3 / 2, Height * 3 / 2, 150.0f, false },
+		};
+		for (const FConfig& Config : Configs)
+		{
+			FCaptureTAAGen5Settings Settings;
+			Settings.HistoryScreenPercentage = Config.HistoryScreenPercentage;
+			Settings.bR11G11B10History = Config.bR11G11B10;
+			Settings.NumThreads = 1;
+			FCaptureTAAGen5Settings ThreadedSettings = Settings;
+			ThreadedSettings.NumThreads = std::max(Options.NumThreads, 2u);
+
+			FCaptureTAAGen5 Single(Settings);
+			FCaptureTAAGen5 Threaded(ThreadedSettings);
+			bool bSameThreads = true;
+			for (uint32_t Frame = 0; Frame < 4; Frame++)
+			{
+				FCaptureTAAGen5Frame Input;
+				GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+				RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.004f * float(Frame), Color, Depth, Velocity, 0.004f);
+				AddGen5Foreground(Frame, 3.0f, Color, Depth, Velocity);
+				// Half the pixels move with the camera.
+				for (size_t Pixel = 0; Pixel < Velocity.GetPlaneSize(); Pixel += 2)
+				{
+					Velocity.GetPlane(0)[Pixel] = 0.0f;
+				}
+				const float ClipToPrevClip[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -0.008f, 0, 0, 1 };
+				Input.Color = &Color;
+				Input.Depth = &Depth;
+				Input.Velocity = &Velocity;
+				Input.ClipToPrevClip = ClipToPrevClip;
+				Input.PreExposure = 1.0f + 0.1f * float(Frame);
+
+				FCaptureImage ThreadedOutput;
+				Single.Resolve(Input, Config.OutputWidth, Config.OutputHeight, Output);
+				Threaded.Resolve(Input, Config.OutputWidth, Config.OutputHeight, ThreadedOutput);
+				const FCaptureTAAGen5Textures& A = Single.GetTextures();
+				const FCaptureTAAGen5Textures& B = Threaded.GetTextures();
+				bSameThreads &= SameImageBits(Output, ThreadedOutput) && SameImageBits(A.DilatedVelocity, B.DilatedVelocity)
+					&& SameImageBits(A.ClosestDepth, B.ClosestDepth) && SameImageBits(A.Prediction, B.Prediction)
+					&& SameImageBits(A.ParallaxRejectionMask, B.ParallaxRejectionMask) && SameImageBits(A.FilteredInput, B.FilteredInput)
+					&& SameImageBits(A.FilteredPrediction, B.FilteredPrediction) && SameImageBits(A.HistoryRejection, B.HistoryRejection)
+					&& SameImageBits(A.DilatedHistoryRejection, B.DilatedHistoryRejection) && SameImageBits(A.HistoryLowFrequencies, B.HistoryLowFrequencies)
+					&& SameImageBits(A.HistoryHighFrequencies, B.HistoryHighFrequencies) && SameImageBits(A.HistoryMetadata, B.HistoryMetadata);
+				for (size_t Pixel = 0; Pixel < A.PrevTexturesSize; Pixel++)
+				{
+					bSameThreads &= A.PrevUseCount[Pixel].load() == B.PrevUseCount[Pixel].load() && A.PrevClosestDepth[Pixel].load() == B.PrevClosestDepth[Pixel].load();
+				}
+			}
+			Expect(bSameThreads, (std::string(Config.Name) + ": threads change the result").c_str());
+
+			const FCaptureTAAGen5Textures& Textures = Single.GetTextures();
+			const int32_t HistoryWidth = int32_t(std::ceil(float(Config.OutputWidth) * Config.HistoryScreenPercentage / 100.0f));
+			const int32_t HistoryHeight = int32_t(std::ceil(float(Config.OutputHeight) * Config.HistoryScreenPercentage / 100.0f));
+			Expect(Textures.Prediction.Width == Width && Textures.Prediction.Height == Height && Textures.HistoryRejection.Width == Width / 2
+				&& Textures.HistoryRejection.Height == Height / 2 && Textures.HistoryHighFrequencies.Width == HistoryWidth
+				&& Textures.HistoryHighFrequencies.Height == HistoryHeight && Output.Width == Config.OutputWidth && Output.Height == Config.OutputHeight,
+				(std::string(Config.Name) + ": pass extents").c_str());
+
+			if (Config.bR11G11B10)
+			{
+				bool bRepresentable = true;
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					for (size_t Pixel = 0; Pixel < Textures.HistoryHighFrequencies.GetPlaneSize(); Pixel++)
+					{
+						const float Value = Textures.HistoryHighFrequencies.GetPlane(Channel)[Pixel];
+						const int32_t MantissaBits = Channel == 2 ? 5 : 6;
+						const float MaxValue = Channel == 2 ? 64512.0f : 65024.0f;
+						bRepresentable &= Value >= 0.0f && QuantizeCaptureFloat(FCaptureFloat1::Splat(Value), MantissaBits, MaxValue).V == Value;
+					}
+				}
+				Expect(bRepresentable, "r11g11b10 history holds values the format cannot");
+			}
+		}
+
+		// The engine clamps the history screen percentage to [100, 200].
+		FCaptureTAAGen5Settings Settings;
+		Settings.HistoryScreenPercentage = 300.0f;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen5 TAA(Settings);
+		FCaptureTAAGen5Frame Input;
+		Input.Color = &Color;
+		TAA.Resolve(Input, Width, Height, Output);
+		Expect(TAA.GetTextures().SceneColor.Width == Width * 2 && Output.Width == Width, "history screen percentage is not clamped to 200");
+	}
+
+	// Static scene: at 1:1 and upsampled 1.5x, the chain converges towards the supersampled scene and keeps its history.
+	for (int32_t bUpsample = 0; bUpsample < 2; bUpsample++)
+	{
+		const int32_t OutputWidth = bUpsample ? Width * 3 / 2 : Width;
+		const int32_t OutputHeight = bUpsample ? Height * 3 / 2 : Height;
+		FCaptureTAAGen5Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen5 TAA(Settings);
+		RenderTAAReference(OutputWidth, OutputHeight, 0.0f, Reference);
+
+		FCaptureImage PreviousOutput;
+		double FirstError = 0.0, OutputError = 0.0, OutputChange = 0.0, Rejection = 0.0;
+		for (uint32_t Frame = 0; Frame < 48; Frame++)
+		{
+			FCaptureTAAGen5Frame Input;
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.0f, Color, Depth, Velocity, 0.0f);
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.Velocity = &Velocity;
+			TAA.Resolve(Input, OutputWidth, OutputHeight, Output);
+			if (Frame == 0)
+			{
+				FirstError = MeanTonemappedError(Output, Reference);
+			}
+			if (Frame >= 40)
+			{
+				OutputError += MeanTonemappedError(Output, Reference) / 8.0;
+				OutputChange += MeanTonemappedError(Output, PreviousOutput) / 8.0;
+				Rejection += MeanPlane(TAA.GetTextures().DilatedHistoryRejection) / 8.0;
+			}
+			PreviousOutput = Output;
+		}
+		printf("  static %s: error %.4f -> %.4f, frame to frame change %.4f, history kept %.3f\n", bUpsample ? "upsampled" : "1:1", FirstError, OutputError,
+			OutputChange, Rejection);
+		Expect(OutputError < FirstError, bUpsample ? "upsampled static scene does not converge" : "static scene does not converge");
+		Expect(Rejection > 0.9, "static scene rejects its history");
+	}
+
+	// Content change without motion: the history no longer matches the input and is rejected.
+	{
+		FCaptureTAAGen5Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen5 TAA(Settings);
+		double Kept[2] = {};
+		for (uint32_t Frame = 0; Frame < 17; Frame++)
+		{
+			FCaptureTAAGen5Frame Input;
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.0f, Color, Depth, Velocity, 0.0f);
+			if (Frame == 16)
+			{
+				const float Flat[3] = { 0.1f, 0.2f, 1.0f };
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					std::fill(Color.GetPlane(Channel), Color.GetPlane(Channel) + Color.GetPlaneSize(), Flat[Channel]);
+				}
+			}
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			TAA.Resolve(Input, Width, Height, Output);
+			if (Frame >= 15)
+			{
+				Kept[Frame - 15] = MeanPlane(TAA.GetTextures().DilatedHistoryRejection);
+			}
+		}
+		printf("  content change: history kept %.3f -> %.3f\n", Kept[0], Kept[1]);
+		Expect(Kept[1] < 0.5 && Kept[0] > 0.9, "content change keeps the history");
+	}
+
+	// Parallax: the background a moving foreground uncovers was hidden the frame before and its history is dropped.
+	{
+		FCaptureTAAGen5Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen5 TAA(Settings);
+		const float Speed = 3.0f;
+		const uint32_t NumFrames = 8;
+		for (uint32_t Frame = 0; Frame < NumFrames; Frame++)
+		{
+			FCaptureTAAGen5Frame Input;
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, 0.0f, Color, Depth, Velocity, 0.0f);
+			AddGen5Foreground(Frame, Speed, Color, Depth, Velocity);
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.Velocity = &Velocity;
+			TAA.Resolve(Input, Width, Height, Output);
+		}
+
+		// Columns the square left this frame, but the one next to it that the dilation gives its velocity; columns it
+		// still covers; background away from it.
+		const FCaptureTAAGen5Textures& Textures = TAA.GetTextures();
+		const int32_t MinX = 40 + int32_t(Speed * float(NumFrames - 1));
+		double Uncovered = 0.0, Foreground = 0.0, Background = 0.0, UncoveredCount = 0.0;
+		for (int32_t Y = 34; Y < 62; Y++)
+		{
+			for (int32_t X = MinX - int32_t(Speed); X < MinX - 1; X++)
+			{
+				Uncovered += Textures.ParallaxRejectionMask.GetPlane(0)[size_t(Y) * Width + X] / (28.0 * (Speed - 1.0f));
+				UncoveredCount += Textures.HistoryMetadata.GetPlane(0)[size_t(Y) * Width + X] * Settings.MaxSampleCount / (28.0 * (Speed - 1.0f));
+			}
+			for (int32_t X = MinX + 4; X < MinX + 32; X++)
+			{
+				Foreground += Textures.ParallaxRejectionMask.GetPlane(0)[size_t(Y) * Width + X] / (28.0 * 28.0);
+			}
+			for (int32_t X = 130; X < 158; X++)
+			{
+				Background += Textures.ParallaxRejectionMask.GetPlane(0)[size_t(Y) * Width + X] / (28.0 * 28.0);
+			}
+		}
+		printf("  parallax: history kept %.3f where uncovered (%.2f samples), %.3f on the foreground, %.3f on the background\n", Uncovered,
+			UncoveredCount, Foreground, Background);
+		Expect(Uncovered < 0.1 && UncoveredCount < 1.5, "uncovered background keeps its history");
+		Expect(Foreground > 0.99 && Background > 0.99, "parallax rejection where nothing was hidden");
+	}
+
+	// Camera cut: nothing of the previous history survives, the frame resolves as the first one of a sequence.
+	{
+		FCaptureTAAGen5Settings Settings;
+		Settings.NumThreads = 1;
+		FCaptureTAAGen5 TAA(Settings);
+		FCaptureTAAGen5 Fresh(Settings);
+		FCaptureTAAGen5Frame Input;
+		for (uint32_t Frame = 0; Frame < 6; Frame++)
+		{
+			GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+			RenderTAAFrame(Width, Height, Input.JitterX, Input.JitterY, Frame < 5 ? 0.0f : 0.3f, Color, Depth, Velocity, 0.0f);
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.bCameraCut = Frame == 5;
+			TAA.Resolve(Input, Width * 3 / 2, Height * 3 / 2, Output);
+		}
+		FCaptureImage FreshOutput;
+		Fresh.Resolve(Input, Width * 3 / 2, Height * 3 / 2, FreshOutput);
+		Expect(SameImageBits(Output, FreshOutput) && SameImageBits(TAA.GetTextures().HistoryHighFrequencies, Fresh.GetTextures().HistoryHighFrequencies),
+			"camera cut keeps history");
+	}
+
+	if (Options.CapturePath.empty())
+	{
+		// Every pass of 720p to 1080p on one thread and on the pool.
+		const int32_t InputWidth = 1280, InputHeight = 720;
+		RenderTAAFrame(InputWidth, InputHeight, 0.0f, 0.0f, 0.0f, Color, Depth, Velocity, 0.001f);
+		const uint32_t NumThreads[2] = { 1, std::max(std::thread::hardware_concurrency(), 1u) };
+		for (uint32_t Run = 0; Run < (NumThreads[1] > 1 ? 2u : 1u); Run++)
+		{
+			FCaptureTAAGen5Settings Settings;
+			Settings.NumThreads = NumThreads[Run];
+			FCaptureTAAGen5 TAA(Settings);
+			FCaptureTAAGen5Frame Input;
+			Input.Color = &Color;
+			Input.Depth = &Depth;
+			Input.Velocity = &Velocity;
+			const uint32_t NumFrames = std::min(Options.NumFrames, 8u);
+			for (uint32_t Frame = 0; Frame < NumFrames; Frame++)
+			{
+				GetTAAJitter(Frame, Input.JitterX, Input.JitterY);
+				TAA.Resolve(Input, 1920, 1080, Output);
+			}
+			printf("  720p -> 1080p, %u thread%s:\n", NumThreads[Run], NumThreads[Run] > 1 ? "s" : "");
+			PrintGen5PassTimes(TAA, NumFrames);
+		}
+	}
+	else
+	{
+		FCaptureReader Reader;
+		if (!Reader.Open(Options.CapturePath))
+		{
+			fprintf(stderr, "cannot open %s\n", Options.CapturePath.c_str());
+			return 1;
+		}
+
+		FCaptureTAAGen5Settings Settings;
+		Settings.NumThreads = Options.NumThreads;
+		FCaptureTAAGen5 TAA(Settings);
+		FCaptureTAAGen4FrameImages Images;
+		FCaptureImage Captured;
+		std::vector<uint8_t> DecodeBuffer;
+		uint32_t NumResolved = 0, NumCompared = 0;
+		double SumError = 0.0;
+		const uint32_t NumFrames = std::min(Options.NumFrames, Reader.GetNumFrames());
+		for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+		{
+			FCaptureTAAGen5Frame Frame;
+			if (!LoadCaptureTAAGen4Frame(Reader, FrameIndex, Images, Frame, DecodeBuffer))
+			{
+				continue;
+			}
+			const bool bHasCaptured = LoadCaptureImage(Reader, FrameIndex, "output", "rgb", Captured, DecodeBuffer) && Captured.NumChannels >= 3;
+			TAA.Resolve(Frame, bHasCaptured ? Captured.Width : Images.Color.Width, bHasCaptured ? Captured.Height : Images.Color.Height, Output);
+			if (bHasCaptured)
+			{
+				SumError += MeanTonemappedError(Output, Captured);
+			}
+			NumResolved++;
+			NumCompared += bHasCaptured;
+		}
+		if (!NumResolved)
+		{
+			fprintf(stderr, "%s has no frames with an input layer\n", Options.CapturePath.c_str());
+			return 1;
+		}
+		printf("  %s: %u frames, error against the captured output %.5f over %u\n", Options.CapturePath.c_str(), NumResolved,
+			NumCompared ? SumError / NumCompared : 0.0, NumCompared);
+		PrintGen5PassTimes(TAA, NumResolved);
+	}
+
+	printf("gen5: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the TAA settings sweep of CaptureTAASweep.h on frames of the moving TAA scene: grid expansion, results that
+ * do not depend on the number of threads nor on the other settings of the sweep, every frame decoded once. Then
+ * times the sweep against running its settings one after the other.
+ */
+int RunSweepCheck(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	FCaptureTAASweepGrid Grid;
+	Grid.Algorithms = { 0, 1 };
+	Grid.CurrentFrameWeights = { 0.04f, 0.1f };
+	Grid.FilterSizes = { 0.75f, 1.0f };
+	Grid.CatmullRoms = { false, true };
+	Grid.HistoryScreenPercentages = { 100.0f, 150.0f };
+	Grid.R11G11B10Histories = { false, true };
+	const std::vector<FCaptureTAASweepConfig> Configs = ExpandCaptureTAASweepGrid(Grid);
+	{
+		// Gen4: 2 weights x 2 filter sizes x 2 kernels, R11G11B10 only applying when fast. Gen5: 2 weights x 2 history
+		// screen percentages x 2 formats.
+		bool bUnique = true;
+		for (size_t Index = 0; Index < Configs.size(); Index++)
+		{
+			for (size_t Other = 0; Other < Index; Other++)
+			{
+				bUnique &= Configs[Index].Name != Configs[Other].Name;
+			}
+		}
+		Expect(Configs.size() == 16 && bUnique, "grid expands to the wrong settings");
+		Expect(!Configs[0].bGen5 && Configs.back().bGen5 && Configs.back().Gen5.MaxSampleCount == 10.0f && Configs.back().Gen5.HistoryScreenPercentage == 150.0f,
+			"grid settings are not the cvars");
+	}
+
+	// Frames of the moving scene with the supersampled scene as reference; frame 5 is missing from the sequence.
+	const int32_t Width = 160;
+	const int32_t Height = 96;
+	const float Speed = 2.0f / float(Width);
+	const uint32_t NumFrames = std::max(std::min(Options.NumFrames, 24u), 8u);
+	std::atomic<uint32_t> NumLoads{ 0 };
+	FCaptureTAASweepLoader Loader = [&](uint32_t FrameIndex, FCaptureTAASweepFrame& OutFrame)
+	{
+		NumLoads++;
+		if (FrameIndex == 5)
+		{
+			return false;
+		}
+		OutFrame.Frame = FCaptureTAAGen4Frame();
+		GetTAAJitter(FrameIndex, OutFrame.Frame.JitterX, OutFrame.Frame.JitterY);
+		RenderTAAFrame(Width, Height, OutFrame.Frame.JitterX, OutFrame.Frame.JitterY, Speed * float(FrameIndex), OutFrame.Images.Color, OutFrame.Images.Depth,
+			OutFrame.Images.Velocity, Speed);
+		RenderTAAReference(Width, Height, Speed * float(FrameIndex), OutFrame.Reference);
+		OutFrame.Frame.Color = &OutFrame.Images.Color;
+		OutFrame.Frame.Depth = &OutFrame.Images.Depth;
+		OutFrame.Frame.Velocity = &OutFrame.Images.Velocity;
+		OutFrame.bHasReference = true;
+		return true;
+	};
+
+	auto SameResult = [](const FCaptureTAASweepResult& A, const FCaptureTAASweepResult& B)
+	{
+		return A.NumResolved == B.NumResolved && A.NumCompared == B.NumCompared && A.NumChanges == B.NumChanges && A.MeanError == B.MeanError
+			&& A.MeanPsnr == B.MeanPsnr && A.MeanChange == B.MeanChange;
+	};
+
+	FCaptureTAASweepOptions SweepOptions;
+	SweepOptions.NumFrames = NumFrames;
+	SweepOptions.NumThreads = std::max(Options.NumThreads, 2u);
+	std::vector<FCaptureTAASweepResult> Results, SingleThreadResults;
+	auto Start = std::chrono::steady_clock::now();
+	Expect(RunCaptureTAASweep(Configs, SweepOptions, Loader, Results), "sweep resolves nothing");
+	const double SweepSeconds = SecondsSince(Start);
+	Expect(NumLoads == NumFrames, "frames are not decoded once for every setting");
+	Expect(Results.size() == Configs.size() && Results[0].NumResolved == NumFrames - 1 && Results[0].NumCompared == NumFrames - 1
+		&& Results[0].NumChanges == NumFrames - 2, "sweep does not resolve every frame it has");
+
+	SweepOptions.NumThreads = 1;
+	RunCaptureTAASweep(Configs, SweepOptions, Loader, SingleThreadResults);
+	bool bSameThreads = SingleThreadResults.size() == Results.size();
+	for (size_t Index = 0; bSameThreads && Index < Results.size(); Index++)
+	{
+		bSameThreads &= SameResult(Results[Index], SingleThreadResults[Index]);
+	}
+	Expect(bSameThreads, "threads change the results of the sweep");
+
+	// Every setting alone, decoding the sequence again each time, as separate replays would.
+	SweepOptions.NumThreads = std::max(Options.NumThreads, 2u);
+	bool bSameAlone = true;
+	Start = std::chrono::steady_clock::now();
+	for (size_t Index = 0; Index < Configs.size(); Index++)
+	{
+		std::vector<FCaptureTAASweepResult> Alone;
+		RunCaptureTAASweep({ Configs[Index] }, SweepOptions, Loader, Alone);
+		bSameAlone &= SameResult(Alone[0], Results[Index]);
+	}
+	const double AloneSeconds = SecondsSince(Start);
+	Expect(bSameAlone, "a setting's results depend on the other settings of the sweep");
+
+	// Quality ordering the sweep should reproduce: Gen4 weights more of a moving scene's current frame at 0.1.
+	double Errors[2] = {};
+	for (size_t Index = 0; Index < Configs.size(); Index++)
+	{
+		const FCaptureTAASweepConfig& Config = Configs[Index];
+		if (!Config.bGen5 && Config.Gen4.FilterSize == 1.0f && Config.Gen4.FilterKernel == ECaptureFilterKernel::Gaussian)
+		{
+			Errors[Config.Gen4.CurrentFrameWeight > 0.05f] = Results[Index].MeanError;
+		}
+		printf("  %.4f error, %6.2f dB, %.4f change, %5.1f ms/frame  %s\n", Results[Index].MeanError, Results[Index].MeanPsnr, Results[Index].MeanChange,
+			Results[Index].ResolveSeconds * 1e3 / std::max(Results[Index].NumResolved, 1u), Config.Name.c_str());
+	}
+	Expect(Errors[0] > 0.0 && Errors[1] > 0.0, "sweep reports no error against the reference");
+
+	printf("  %zu settings x %u frames on %u threads: %.2f s swept, %.2f s one setting at a time\n", Configs.size(), NumFrames - 1,
+		std::max(Options.NumThreads, 2u), SweepSeconds, AloneSeconds);
+
+	printf("sweep: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the image quality metrics of CaptureMetrics.h on images with known answers and on the moving TAA scene:
+ * same bits on any number of threads and with one lane, reprojection through the velocity. Then times them on
+ * 1080p frames (or --size).
+ */
+int RunMetricsCheck(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	const int32_t Width = 203;
+	const int32_t Height = 117;
+	auto Fill = [](FCaptureImage& Image, int32_t ImageWidth, int32_t ImageHeight, const std::function<float(int32_t, int32_t, int32_t)>& Value)
+	{
+		Image.Resize(ImageWidth, ImageHeight, 3);
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			for (int32_t Y = 0; Y < ImageHeight; Y++)
+			{
+				for (int32_t X = 0; X < ImageWidth; X++)
+				{
+					Image.GetPlane(Channel)[size_t(Y) * ImageWidth + X] = Value(X, Y, Channel);
+				}
+			}
+		}
+	};
+	auto Noise = [](int32_t X, int32_t Y, int32_t Channel)
+	{
+		uint32_t Hash = uint32_t(X) * 73856093u ^ uint32_t(Y) * 19349663u ^ uint32_t(Channel) * 83492791u;
+		Hash = (Hash ^ (Hash >> 13)) * 0x5bd1e995u;
+		return float((Hash ^ (Hash >> 15)) & 0xffff) / 65535.0f - 0.5f;
+	};
+
+	FCaptureMetricsSettings Settings;
+	Settings.NumThreads = std::max(Options.NumThreads, 2u);
+	FCaptureMetrics Metrics(Settings);
+	FCaptureFrameMetrics Frame;
+
+	// Known answers: equal images, and 1 against 3, 0.5 against 0.75 tonemapped.
+	FCaptureImage Reference, Test;
+	RenderTAAReference(Width, Height, 0.0f, Reference);
+	Expect(Metrics.Compare(Reference, Reference, nullptr, false, Frame) && Frame.MeanError == 0.0 && std::isinf(Frame.Psnr)
+		&& std::fabs(Frame.MsSsim - 1.0) < 1e-6 && Frame.Flip == 0.0, "equal images score as different");
+	Expect(Metrics.Compare(Reference, Reference, nullptr, false, Frame) && Frame.bHasTemporal && Frame.Flicker == 0.0 && Frame.TestFlicker == Frame.ReferenceFlicker, "equal frames flicker");
+	Fill(Reference, Width, Height, [](int32_t, int32_t, int32_t) { return 1.0f; });
+	Fill(Test, Width, Height, [](int32_t, int32_t, int32_t) { return 3.0f; });
+	Metrics.Reset();
+	Expect(Metrics.Compare(Test, Reference, nullptr, false, Frame) && std::fabs(Frame.MeanError - 0.25) < 1e-6
+		&& std::fabs(Frame.Psnr - 10.0 * std::log10(16.0)) < 1e-4 && !Frame.bHasTemporal, "a constant difference scores wrong");
+	Fill(Reference, Width, Height, [](int32_t, int32_t, int32_t) { return 0.0f; });
+	Fill(Test, Width, Height, [](int32_t, int32_t, int32_t) { return 1e4f; });
+	Expect(Metrics.Compare(Test, Reference, nullptr, true, Frame) && Frame.Flip > 0.9 && Frame.Flip <= 1.0 && !Frame.bHasTemporal,
+		"black against white is not the largest FLIP error");
+	FCaptureImage Small;
+	Small.Resize(Width - 1, Height, 3);
+	Expect(!Metrics.Compare(Small, Reference, nullptr, false, Frame), "images of different sizes compare");
+
+	// Every metric falls with the amount of noise added.
+	RenderTAAReference(Width, Height, 0.0f, Reference);
+	FCaptureFrameMetrics Noisy[3];
+	for (int32_t Level = 0; Level < 3; Level++)
+	{
+		const float Amplitude = 0.05f * float(1 << (2 * Level));
+		Fill(Test, Width, Height, [&](int32_t X, int32_t Y, int32_t Channel)
+		{
+			return std::max(Reference.GetPlane(Channel)[size_t(Y) * Width + X] * (1.0f + Amplitude * Noise(X, Y, Channel)), 0.0f);
+		});
+		Metrics.Reset();
+		Metrics.Compare(Test, Reference, nullptr, false, Noisy[Level]);
+	}
+	Expect(Noisy[0].Psnr > Noisy[1].Psnr && Noisy[1].Psnr > Noisy[2].Psnr && Noisy[0].MsSsim > Noisy[1].MsSsim && Noisy[1].MsSsim > Noisy[2].MsSsim
+		&& Noisy[0].Flip < Noisy[1].Flip && Noisy[1].Flip < Noisy[2].Flip && Noisy[2].MsSsim < 0.99, "metrics do not follow the noise");
+
+	// The moving scene, point sampled with jitter against its supersampled reference. Reprojection with the
+	// velocity leaves the reference nearly still; the jittered test flickers beyond it.
+	const float Speed = 2.5f / float(Width);
+	std::vector<FCaptureFrameMetrics> Runs[4];
+	FCaptureImage Color, Depth, Velocity;
+	std::vector<FCaptureImage> MapsOfRun;
+	for (int32_t Run = 0; Run < 4; Run++)
+	{
+		// 0: eight lanes on many threads, 1: one lane on one thread, 2: no velocity, 3: a camera cut at frame 3.
+		FCaptureMetricsSettings RunSettings = Settings;
+		RunSettings.NumThreads = Run == 1 ? 1 : Settings.NumThreads;
+		RunSettings.bScalar = Run == 1;
+		FCaptureMetrics RunMetrics(RunSettings);
+		for (uint32_t FrameIndex = 0; FrameIndex < 6; FrameIndex++)
+		{
+			float JitterX, JitterY;
+			GetTAAJitter(FrameIndex, JitterX, JitterY);
+			RenderTAAFrame(Width, Height, JitterX, JitterY, Speed * float(FrameIndex), Color, Depth, Velocity, Speed);
+			RenderTAAReference(Width, Height, Speed * float(FrameIndex), Reference);
+			Runs[Run].emplace_back();
+			RunMetrics.Compare(Color, Reference, Run == 2 ? nullptr : &Velocity, Run == 3 && FrameIndex == 3, Runs[Run].back());
+		}
+		if (Run < 2)
+		{
+			MapsOfRun.push_back(RunMetrics.GetMaps().Flip);
+			MapsOfRun.push_back(RunMetrics.GetMaps().Dssim);
+			MapsOfRun.push_back(RunMetrics.GetMaps().Flicker);
+		}
+	}
+	bool bSame = SameImageBits(MapsOfRun[0], MapsOfRun[3]) && SameImageBits(MapsOfRun[1], MapsOfRun[4]) && SameImageBits(MapsOfRun[2], MapsOfRun[5]);
+	for (size_t FrameIndex = 0; FrameIndex < Runs[0].size(); FrameIndex++)
+	{
+		const FCaptureFrameMetrics& A = Runs[0][FrameIndex];
+		const FCaptureFrameMetrics& B = Runs[1][FrameIndex];
+		bSame &= A.MeanError == B.MeanError && A.Psnr == B.Psnr && A.MsSsim == B.MsSsim && A.Flip == B.Flip && A.bHasTemporal == B.bHasTemporal
+			&& A.Flicker == B.Flicker && A.TestFlicker == B.TestFlicker && A.ReferenceFlicker == B.ReferenceFlicker;
+	}
+	Expect(bSame, "eight lanes on many threads differ from one lane on one thread");
+
+	double ReferenceFlicker[2] = {};
+	double Flicker = 0.0;
+	bool bTemporal = !Runs[0][0].bHasTemporal;
+	for (size_t FrameIndex = 1; FrameIndex < Runs[0].size(); FrameIndex++)
+	{
+		bTemporal &= Runs[0][FrameIndex].bHasTemporal && Runs[2][FrameIndex].bHasTemporal && Runs[3][FrameIndex].bHasTemporal == (FrameIndex != 3);
+		ReferenceFlicker[0] += Runs[0][FrameIndex].ReferenceFlicker;
+		ReferenceFlicker[1] += Runs[2][FrameIndex].ReferenceFlicker;
+		Flicker += Runs[0][FrameIndex].Flicker;
+	}
+	Expect(bTemporal, "temporal metrics without a previous frame, or missing with one");
+	Expect(ReferenceFlicker[0] < 0.25 * ReferenceFlicker[1], "velocity does not reproject the previous frame");
+	Expect(Flicker > 0.0 && Runs[0][5].TestFlicker > Runs[0][5].ReferenceFlicker, "jittered point samples do not flicker beyond the reference");
+	printf("  moving scene: psnr %.2f dB, ms-ssim %.4f, flip %.4f, flicker %.5f, reference flicker %.5f reprojected and %.5f not\n", Runs[0][5].Psnr,
+		Runs[0][5].MsSsim, Runs[0][5].Flip, Flicker / 5.0, ReferenceFlicker[0] / 5.0, ReferenceFlicker[1] / 5.0);
+
+	// Throughput on full frames.
+	const int32_t TimedWidth = Options.bCustomSize ? Options.Width : 1920;
+	const int32_t TimedHeight = Options.bCustomSize ? Options.Height : 1080;
+	const uint32_t NumTimedFrames = std::max(std::min(Options.NumFrames, 8u), 2u);
+	RenderTAAFrame(TimedWidth, TimedHeight, 0.0f, 0.0f, 0.0f, Color, Depth, Velocity, Speed);
+	RenderTAAReference(TimedWidth, TimedHeight, 0.0f, Reference);
+	for (int32_t bScalar = 1; bScalar >= 0; bScalar--)
+	{
+		FCaptureMetricsSettings TimedSettings = Settings;
+		TimedSettings.NumThreads = Options.NumThreads;
+		TimedSettings.bScalar = bScalar != 0;
+		FCaptureMetrics TimedMetrics(TimedSettings);
+		const auto Start = std::chrono::steady_clock::now();
+		for (uint32_t FrameIndex = 0; FrameIndex < NumTimedFrames; FrameIndex++)
+		{
+			TimedMetrics.Compare(Color, Reference, &Velocity, false, Frame);
+		}
+		const double Seconds = SecondsSince(Start) / NumTimedFrames;
+		printf("  %dx%d on %u thread%s, %s: %.1f ms per frame, %.1f frames per second\n", TimedWidth, TimedHeight, Options.NumThreads,
+			Options.NumThreads > 1 ? "s" : "", bScalar ? "one lane" : CAPTURE_SIMD_AVX2 ? "avx2" : "eight lanes", Seconds * 1e3, 1.0 / Seconds);
+	}
+
+	printf("metrics: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the resampler of CaptureResample.h against a direct 2D evaluation of its kernels, in doubles, within half
+ * precision at every ratio: downsamples of the history screen percentages, an upsample and odd sizes. Same bits on
+ * any number of threads and with one lane. Then times the 200% and 150% history downsamples to 1080p (or --size).
+ */
+int RunResampleCheck(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+
+	// Smooth content and noise in [1, 4], away from 0 so that the tolerance can be relative.
+	auto Fill = [](FCaptureImage& Image, int32_t Width, int32_t Height)
+	{
+		Image.Resize(Width, Height, 3);
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			for (int32_t Y = 0; Y < Height; Y++)
+			{
+				for (int32_t X = 0; X < Width; X++)
+				{
+					uint32_t Hash = uint32_t(X) * 73856093u ^ uint32_t(Y) * 19349663u ^ uint32_t(Channel) * 83492791u;
+					Hash = (Hash ^ (Hash >> 13)) * 0x5bd1e995u;
+					const float Noise = float((Hash ^ (Hash >> 15)) & 0xffff) / 65535.0f;
+					const float Wave = std::sin(float(X) * 0.21f + float(Channel)) * std::cos(float(Y) * 0.13f);
+					Image.GetPlane(Channel)[size_t(Y) * Width + X] = 2.5f + Wave + 0.5f * Noise;
+				}
+			}
+		}
+	};
+
+	/** The resample of one texel as a sum over its 2D footprint, normalized once. */
+	auto Reference = [](ECaptureFilterKernel Kernel, const FCaptureImage& Source, int32_t DestWidth, int32_t DestHeight, int32_t Channel, int32_t X, int32_t Y)
+	{
+		const double RatioX = double(Source.Width) / DestWidth;
+		const double RatioY = double(Source.Height) / DestHeight;
+		const double ScaleX = std::max(RatioX, 1.0);
+		const double ScaleY = std::max(RatioY, 1.0);
+		const double CenterX = (X + 0.5) * RatioX - 0.5;
+		const double CenterY = (Y + 0.5) * RatioY - 0.5;
+		const double Radius = GetCaptureFilterKernelRadius(Kernel);
+		double Sum = 0.0;
+		double TotalWeight = 0.0;
+		for (int32_t SourceY = int32_t(std::floor(CenterY - Radius * ScaleY)); SourceY <= int32_t(std::ceil(CenterY + Radius * ScaleY)); SourceY++)
+		{
+			const float OffsetY = float((SourceY - CenterY) / ScaleY);
+			const double WeightY = std::fabs(OffsetY) < Radius ? EvaluateCaptureFilterKernel(Kernel, OffsetY, 0.0f) : 0.0;
+			for (int32_t SourceX = int32_t(std::floor(CenterX - Radius * ScaleX)); SourceX <= int32_t(std::ceil(CenterX + Radius * ScaleX)); SourceX++)
+			{
+				const float OffsetX = float((SourceX - CenterX) / ScaleX);
+				const double Weight = std::fabs(OffsetX) < Radius ? WeightY * EvaluateCaptureFilterKernel(Kernel, OffsetX, 0.0f) : 0.0;
+				const int32_t ClampedX = std::min(std::max(SourceX, 0), Source.Width - 1);
+				const int32_t ClampedY = std::min(std::max(SourceY, 0), Source.Height - 1);
+				Sum += Weight * Source.GetPlane(Channel)[size_t(ClampedY) * Source.Width + ClampedX];
+				TotalWeight += Weight;
+			}
+		}
+		return Sum / TotalWeight;
+	};
+
+	struct FResampleCase
+	{
+		int32_t SourceWidth, SourceHeight, DestWidth, DestHeight;
+	};
+	const FResampleCase Cases[] =
+	{
+		{ 320, 180, 160, 90 },    // HistoryScreenPercentage 200
+		{ 240, 135, 160, 90 },    // 150
+		{ 213, 120, 160, 90 },    // 133
+		{ 160, 90, 160, 90 },     // 100 still filters
+		{ 97, 61, 40, 33 },       // a different ratio on each axis
+		{ 64, 36, 150, 83 },      // upsample
+		{ 5, 3, 2, 7 },           // tiny, down one way and up the other
+	};
+	const ECaptureFilterKernel Kernels[] = { ECaptureFilterKernel::MitchellNetravali, ECaptureFilterKernel::CatmullRom, ECaptureFilterKernel::Lanczos3,
+		ECaptureFilterKernel::Gaussian, ECaptureFilterKernel::BlackmanHarris };
+
+	FCaptureParallelPool Pool(std::max(Options.NumThreads, 2u));
+	FCaptureImage Source, Dest, ScalarDest;
+	char What[256];
+	for (ECaptureFilterKernel Kernel : Kernels)
+	{
+		FCaptureResampleSettings Settings;
+		Settings.Kernel = Kernel;
+		FCaptureResampler Resampler(Settings, &Pool);
+		Settings.NumThreads = 1;
+		Settings.bScalar = true;
+		FCaptureResampler ScalarResampler(Settings);
+
+		for (const FResampleCase& Case : Cases)
+		{
+			Fill(Source, Case.SourceWidth, Case.SourceHeight);
+			Resampler.Resample(Source, Case.DestWidth, Case.DestHeight, Dest);
+			ScalarResampler.Resample(Source, Case.DestWidth, Case.DestHeight, ScalarDest);
+
+			double MaxRelativeError = 0.0;
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				for (int32_t Y = 0; Y < Case.DestHeight; Y++)
+				{
+					for (int32_t X = 0; X < Case.DestWidth; X++)
+					{
+						const double Expected = Reference(Kernel, Source, Case.DestWidth, Case.DestHeight, Channel, X, Y);
+						const double Value = Dest.GetPlane(Channel)[size_t(Y) * Case.DestWidth + X];
+						MaxRelativeError = std::max(MaxRelativeError, std::fabs(Value - Expected) / std::max(std::fabs(Expected), 1.0));
+					}
+				}
+			}
+			snprintf(What, sizeof(What), "%s %dx%d to %dx%d is %.2g off, beyond half precision", GetCaptureFilterKernelName(Kernel), Case.SourceWidth,
+				Case.SourceHeight, Case.DestWidth, Case.DestHeight, MaxRelativeError);
+			Expect(MaxRelativeError <= 1.0 / 2048.0, What);
+			snprintf(What, sizeof(What), "%s %dx%d to %dx%d: eight lanes on many threads differ from one lane on one thread", GetCaptureFilterKernelName(Kernel),
+				Case.SourceWidth, Case.SourceHeight, Case.DestWidth, Case.DestHeight);
+			Expect(SameImageBits(Dest, ScalarDest), What);
+		}
+	}
+
+	// A constant stays constant, whatever the negative lobes.
+	{
+		FCaptureResampleSettings Settings;
+		Settings.Kernel = ECaptureFilterKernel::Lanczos3;
+		FCaptureResampler Resampler(Settings, &Pool);
+		Source.Resize(333, 77, 1);
+		std::fill(Source.Data.begin(), Source.Data.begin() + Source.GetPlaneSize(), 0.75f);
+		Resampler.Resample(Source, 128, 200, Dest);
+		Expect(std::all_of(Dest.Data.begin(), Dest.Data.begin() + Dest.GetPlaneSize(), [](float Value) { return std::fabs(Value - 0.75f) < 1e-6f; }),
+			"a constant image does not stay constant");
+	}
+
+	// Throughput of the history downsamples.
+	const int32_t TimedWidth = Options.bCustomSize ? Options.Width : 1920;
+	const int32_t TimedHeight = Options.bCustomSize ? Options.Height : 1080;
+	const uint32_t NumTimedFrames = std::max(std::min(Options.NumFrames, 8u), 2u);
+	for (float HistoryScreenPercentage : { 200.0f, 150.0f })
+	{
+		Fill(Source, int32_t(std::ceil(TimedWidth * HistoryScreenPercentage / 100.0f)), int32_t(std::ceil(TimedHeight * HistoryScreenPercentage / 100.0f)));
+		for (int32_t bScalar = 1; bScalar >= 0; bScalar--)
+		{
+			FCaptureResampleSettings Settings;
+			Settings.NumThreads = Options.NumThreads;
+			Settings.bScalar = bScalar != 0;
+			FCaptureResampler Resampler(Settings);
+			const auto Start = std::chrono::steady_clock::now();
+			for (uint32_t FrameIndex = 0; FrameIndex < NumTimedFrames; FrameIndex++)
+			{
+				Resampler.Resample(Source, TimedWidth, TimedHeight, Dest);
+			}
+			const double Seconds = SecondsSince(Start) / NumTimedFrames;
+			printf("  %dx%d to %dx%d mitchell-netravali on %u thread%s, %s: %.2f ms per frame\n", Source.Width, Source.Height, TimedWidth, TimedHeight,
+				Options.NumThreads, Options.NumThreads > 1 ? "s" : "", bScalar ? "one lane" : CAPTURE_SIMD_AVX2 ? "avx2" : "eight lanes", Seconds * 1e3);
+		}
+	}
+
+	printf("resample: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the conversions of CaptureHalf.h: every half and bfloat16 and every R11G11B10 code against the definition of
+ * its format, rounding on both sides of every midpoint, and the array conversions against the element ones. Then
+ * times them against a memcpy of the same bytes on a 4K RGBA frame.
+ */
+int RunHalfCheck(const FBenchOptions& Options)
+{
+	uint32_t NumCases = 0;
+	uint32_t NumFailures = 0;
+	auto Expect = [&NumCases, &NumFailures](bool bCondition, const char* What)
+	{
+		NumCases++;
+		if (!bCondition)
+		{
+			printf("  FAILED: %s\n", What);
+			NumFailures++;
+		}
+	};
+	auto BitsOf = [](float Value)
+	{
+		uint32_t Bits;
+		memcpy(&Bits, &Value, sizeof(Bits));
+		return Bits;
+	};
+	auto FloatOf = [](uint32_t Bits)
+	{
+		float Value;
+		memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	};
+
+	std::vector<uint16_t> Halves(0x10000);
+	for (uint32_t Half = 0; Half < 0x10000; Half++)
+	{
+		Halves[Half] = uint16_t(Half);
+	}
+
+	// Every half to float, against the value its fields encode. NaNs keep their payload and come out quiet.
+	{
+		std::vector<float> Floats(Halves.size());
+		ConvertCaptureHalfToFloat(Halves.data(), Floats.data(), Halves.size());
+		uint32_t NumWrong = 0;
+		uint32_t NumDiffering = 0;
+		for (uint32_t Half = 0; Half < 0x10000; Half++)
+		{
+			const uint32_t Sign = (Half & 0x8000) << 16;
+			const int32_t Exponent = (Half >> 10) & 0x1F;
+			const int32_t Mantissa = Half & 0x3FF;
+			uint32_t Expected;
+			if (Exponent == 0x1F)
+			{
+				Expected = Sign | 0x7F800000 | (Mantissa ? 0x400000 | uint32_t(Mantissa) << 13 : 0);
+			}
+			else
+			{
+				const float Magnitude = Exponent ? std::ldexp(float(1024 + Mantissa), Exponent - 25) : std::ldexp(float(Mantissa), -24);
+				Expected = Sign | BitsOf(Magnitude);
+			}
+			NumWrong += BitsOf(CaptureHalfToFloat(uint16_t(Half))) != Expected;
+			NumDiffering += BitsOf(Floats[Half]) != Expected;
+		}
+		Expect(NumWrong == 0, "a half does not convert to the float it encodes");
+		Expect(NumDiffering == 0, "the half to float array conversion differs from the element one");
+
+		// And back: exactly the same half, quieted for a NaN.
+		std::vector<uint16_t> Back(Halves.size());
+		ConvertCaptureFloatToHalf(Floats.data(), Back.data(), Floats.size());
+		NumWrong = 0;
+		NumDiffering = 0;
+		for (uint32_t Half = 0; Half < 0x10000; Half++)
+		{
+			const bool bNaN = (Half & 0x7C00) == 0x7C00 && (Half & 0x3FF);
+			const uint16_t Expected = uint16_t(bNaN ? Half | 0x200 : Half);
+			NumWrong += CaptureFloatToHalf(Floats[Half]) != Expected;
+			NumDiffering += Back[Half] != Expected;
+		}
+		Expect(NumWrong == 0, "a half does not survive the trip through float");
+		Expect(NumDiffering == 0, "the float to half array conversion differs from the element one");
+	}
+
+	// Float to half on either side of every midpoint between halves and on it, where ties go to the even half, both
+	// signs. Past the largest finite half the next one is 2^16, rounding to infinity.
+	{
+		std::vector<float> Floats;
+		std::vector<uint16_t> Expected;
+		for (uint32_t Half = 0; Half < 0x7C00; Half++)
+		{
+			const float Lo = CaptureHalfToFloat(uint16_t(Half));
+			const float Hi = Half + 1 < 0x7C00 ? CaptureHalfToFloat(uint16_t(Half + 1)) : 65536.0f;
+			const float Midpoint = 0.5f * (Lo + Hi);
+			for (uint32_t Sign : { 0u, 0x80000000u })
+			{
+				Floats.push_back(FloatOf(BitsOf(std::nextafter(Midpoint, 0.0f)) | Sign));
+				Expected.push_back(uint16_t(Half | Sign >> 16));
+				Floats.push_back(FloatOf(BitsOf(Midpoint) | Sign));
+				Expected.push_back(uint16_t(((Half & 1) ? Half + 1 : Half) | Sign >> 16));
+				Floats.push_back(FloatOf(BitsOf(std::nextafter(Midpoint, INFINITY)) | Sign));
+				Expected.push_back(uint16_t((Half + 1) | Sign >> 16));
+			}
+		}
+
+		// Overflow, infinities, float denormals and NaNs of every kind.
+		const std::pair<uint32_t, uint16_t> Specials[] = { { 0x7F7FFFFF, 0x7C00 }, { 0xC7800000, 0xFC00 }, { 0x7F800000, 0x7C00 },
+			{ 0xFF800000, 0xFC00 }, { 0x00000001, 0x0000 }, { 0x807FFFFF, 0x8000 }, { 0x33000000, 0x0000 }, { 0x33000001, 0x0001 },
+			{ 0x7F800001, 0x7E00 }, { 0x7FC00000, 0x7E00 }, { 0xFFFFFFFF, 0xFFFF }, { 0x7FA02000, 0x7F01 } };
+		for (const auto& Special : Specials)
+		{
+			Floats.push_back(FloatOf(Special.first));
+			Expected.push_back(Special.second);
+		}
+
+		std::vector<uint16_t> Converted(Floats.size());
+		ConvertCaptureFloatToHalf(Floats.data(), Converted.data(), Floats.size());
+		uint32_t NumWrong = 0;
+		uint32_t NumDiffering = 0;
+		for (size_t Index = 0; Index < Floats.size(); Index++)
+		{
+			NumWrong += CaptureFloatToHalf(Floats[Index]) != Expected[Index];
+			NumDiffering += Converted[Index] != Expected[Index];
+		}
+		Expect(NumWrong == 0, "float to half does not round to nearest even");
+		Expect(NumDiffering == 0, "the float to half array conversion rounds differently");
+
+		// A sweep of every exponent: the same half as the bench's own conversion, which has no NaN.
+		Floats.clear();
+		for (uint64_t Bits = 0; Bits < 0x100000000ull; Bits += 251)
+		{
+			Floats.push_back(FloatOf(uint32_t(Bits)));
+		}
+		Converted.resize(Floats.size());
+		ConvertCaptureFloatToHalf(Floats.data(), Converted.data(), Floats.size());
+		NumWrong = 0;
+		NumDiffering = 0;
+		for (size_t Index = 0; Index < Floats.size(); Index++)
+		{
+			const uint16_t Half = CaptureFloatToHalf(Floats[Index]);
+			NumWrong += !std::isnan(Floats[Index]) && Half != FloatToHalf(Floats[Index]);
+			NumDiffering += Converted[Index] != Half;
+		}
+		Expect(NumWrong == 0, "float to half differs from FloatToHalf()");
+		Expect(NumDiffering == 0, "the float to half array conversion differs over the exponent sweep");
+	}
+
+	// Every half to bfloat16, against the closer of the two bfloat16 around it, and every bfloat16 to half.
+	{
+		std::vector<uint16_t> BFloats(Halves.size());
+		ConvertCaptureHalfToBFloat16(Halves.data(), BFloats.data(), Halves.size());
+		uint32_t NumWrong = 0;
+		uint32_t NumDiffering = 0;
+		uint32_t NumNotBack = 0;
+		for (uint32_t Half = 0; Half < 0x10000; Half++)
+		{
+			const float Value = CaptureHalfToFloat(uint16_t(Half));
+			const uint32_t Bits = BitsOf(Value);
+			uint16_t Expected = uint16_t(Bits >> 16);
+			if (std::isnan(Value))
+			{
+				Expected |= 0x40;
+			}
+			else if (!std::isinf(Value))
+			{
+				const double Below = std::fabs(double(Value) - double(FloatOf(uint32_t(Expected) << 16)));
+				const double Above = std::fabs(double(FloatOf(uint32_t(Expected + 1) << 16)) - double(Value));
+				Expected += Above < Below || (Above == Below && (Expected & 1));
+			}
+			const uint16_t BFloat = CaptureHalfToBFloat16(uint16_t(Half));
+			NumWrong += BFloat != Expected;
+			NumDiffering += BFloats[Half] != Expected;
+
+			// Halves with no more than 8 significant bits are bfloat16 values and come back as they were.
+			if ((Bits & 0xFFFF) == 0 && !std::isnan(Value))
+			{
+				NumNotBack += CaptureBFloat16ToHalf(BFloat) != Half;
+			}
+		}
+		Expect(NumWrong == 0, "half to bfloat16 does not round to nearest even");
+		Expect(NumDiffering == 0, "the half to bfloat16 array conversion differs from the element one");
+		Expect(NumNotBack == 0, "a half exactly representable in bfloat16 does not come back");
+
+		std::vector<uint16_t> Converted(Halves.size());
+		ConvertCaptureBFloat16ToHalf(Halves.data(), Converted.data(), Halves.size());
+		NumWrong = 0;
+		NumDiffering = 0;
+		for (uint32_t BFloat = 0; BFloat < 0x10000; BFloat++)
+		{
+			const uint16_t Expected = CaptureFloatToHalf(FloatOf(BFloat << 16));
+			NumWrong += CaptureBFloat16ToHalf(uint16_t(BFloat)) != Expected;
+			NumDiffering += Converted[BFloat] != Expected;
+		}
+		Expect(NumWrong == 0, "bfloat16 to half does not round like float to half");
+		Expect(NumDiffering == 0, "the bfloat16 to half array conversion differs from the element one");
+	}
+
+	// Every R11G11B10 code of every channel against the value it encodes, back to the same code when finite.
+	{
+		const int32_t MantissaBits[3] = { 6, 6, 5 };
+		const int32_t Shifts[3] = { 0, 11, 22 };
+		std::vector<uint32_t> Packed;
+		std::vector<float> Expected;
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			const int32_t Bits = MantissaBits[Channel];
+			for (int32_t Code = 0; Code < (1 << (5 + Bits)); Code++)
+			{
+				const int32_t Exponent = Code >> Bits;
+				const int32_t Mantissa = Code & ((1 << Bits) - 1);
+				float Values[3] = {};
+				if (Exponent == 31)
+				{
+					Values[Channel] = Mantissa ? NAN : INFINITY;
+				}
+				else
+				{
+					Values[Channel] = Exponent ? std::ldexp(float((1 << Bits) + Mantissa), Exponent - 15 - Bits) : std::ldexp(float(Mantissa), -14 - Bits);
+				}
+				Packed.push_back(uint32_t(Code) << Shifts[Channel]);
+				Expected.insert(Expected.end(), Values, Values + 3);
+			}
+		}
+
+		std::vector<float> Unpacked(Expected.size());
+		std::vector<uint32_t> Repacked(Packed.size());
+		ConvertCaptureR11G11B10ToFloat(Packed.data(), Unpacked.data(), Packed.size());
+		uint32_t NumWrong = 0;
+		uint32_t NumDiffering = 0;
+		uint32_t NumNotBack = 0;
+		for (size_t Index = 0; Index < Packed.size(); Index++)
+		{
+			float Element[3];
+			CaptureUnpackR11G11B10(Packed[Index], Element[0], Element[1], Element[2]);
+			bool bFinite = true;
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				const float Value = Expected[Index * 3 + Channel];
+				bFinite = bFinite && std::isfinite(Value);
+				NumWrong += std::isnan(Value) ? !std::isnan(Element[Channel]) : BitsOf(Element[Channel]) != BitsOf(Value);
+				NumDiffering += BitsOf(Unpacked[Index * 3 + Channel]) != BitsOf(Element[Channel]);
+			}
+			if (bFinite)
+			{
+				NumNotBack += CapturePackR11G11B10(Element[0], Element[1], Element[2]) != Packed[Index];
+			}
+		}
+		ConvertCaptureFloatToR11G11B10(Expected.data(), Repacked.data(), Repacked.size());
+		uint32_t NumPackDiffering = 0;
+		for (size_t Index = 0; Index < Packed.size(); Index++)
+		{
+			NumPackDiffering += Repacked[Index] != CapturePackR11G11B10(Expected[Index * 3], Expected[Index * 3 + 1], Expected[Index * 3 + 2]);
+		}
+		Expect(NumWrong == 0, "an R11G11B10 code does not unpack to the float it encodes");
+		Expect(NumDiffering == 0, "the R11G11B10 array unpack differs from the element one");
+		Expect(NumNotBack == 0, "an R11G11B10 value does not pack back to its code");
+		Expect(NumPackDiffering == 0, "the R11G11B10 array pack differs from the element one");
+
+		float Red, Green, Blue;
+		CaptureUnpackR11G11B10(CapturePackR11G11B10(-1.0f, NAN, INFINITY), Red, Green, Blue);
+		Expect(Red == 0.0f && Green == 0.0f && Blue == 64512.0f, "negative, NaN and infinity do not pack to 0, 0 and the largest blue");
+	}
+
+	// R11G11B10 rounds as the TAA references quantize: a sweep of every exponent, odd pixel counts for the tails.
+	{
+		const int32_t MantissaBits[3] = { 6, 6, 5 };
+		const float MaxValues[3] = { 65024.0f, 65024.0f, 64512.0f };
+		std::vector<float> Pixels;
+		for (uint64_t Bits = 0; Bits < 0x100000000ull; Bits += 4099)
+		{
+			Pixels.push_back(FloatOf(uint32_t(Bits)));
+		}
+		const size_t NumPixels = Pixels.size() / 3;
+		std::vector<uint32_t> Packed(NumPixels);
+		ConvertCaptureFloatToR11G11B10(Pixels.data(), Packed.data(), NumPixels);
+		uint32_t NumWrong = 0;
+		uint32_t NumDiffering = 0;
+		for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+		{
+			float Unpacked[3];
+			CaptureUnpackR11G11B10(Packed[Pixel], Unpacked[0], Unpacked[1], Unpacked[2]);
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				const FCaptureFloat1 Value = FCaptureFloat1::Splat(Pixels[Pixel * 3 + Channel]);
+				float Quantized;
+				QuantizeCaptureFloat(Max(Value, FCaptureFloat1::Splat(0.0f)), MantissaBits[Channel], MaxValues[Channel]).Store(&Quantized);
+				NumWrong += BitsOf(Unpacked[Channel]) != BitsOf(Quantized);
+			}
+			NumDiffering += Packed[Pixel] != CapturePackR11G11B10(Pixels[Pixel * 3], Pixels[Pixel * 3 + 1], Pixels[Pixel * 3 + 2]);
+		}
+		Expect(NumWrong == 0, "R11G11B10 does not round like QuantizeCaptureFloat()");
+		Expect(NumDiffering == 0, "the R11G11B10 array pack differs from the element one over the exponent sweep");
+	}
+
+	// Interleaved halves to planes, every channel count of 1 to 4 channel pixels, at sizes around the lane width.
+	{
+		uint32_t NumDiffering = 0;
+		for (int32_t PixelStride = 1; PixelStride <= 4; PixelStride++)
+		{
+			for (int32_t NumChannels = 1; NumChannels <= PixelStride; NumChannels++)
+			{
+				for (size_t Count : { size_t(1), size_t(8), size_t(9), size_t(17), size_t(1001) })
+				{
+					std::vector<float> Planes(Count * NumChannels);
+					float* DestPlanes[4] = {};
+					for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+					{
+						DestPlanes[Channel] = Planes.data() + Channel * Count;
+					}
+					const uint16_t* Src = Halves.data() + 0x3C00;
+					ConvertCaptureHalfToFloatPlanes(Src, PixelStride, NumChannels, Count, DestPlanes);
+					for (size_t Pixel = 0; Pixel < Count; Pixel++)
+					{
+						for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+						{
+							NumDiffering += BitsOf(DestPlanes[Channel][Pixel]) != BitsOf(CaptureHalfToFloat(Src[Pixel * PixelStride + Channel]));
+						}
+					}
+				}
+			}
+		}
+		Expect(NumDiffering == 0, "interleaved halves to planes differ from the element conversion");
+	}
+
+	// Throughput on RGBA halves, source and destination bytes per second, against copying the wider of the two.
+	const int32_t TimedWidth = Options.bCustomSize ? Options.Width : 3840;
+	const int32_t TimedHeight = Options.bCustomSize ? Options.Height : 2160;
+	const size_t NumTimed = size_t(TimedWidth) * TimedHeight * 4;
+	std::vector<uint16_t> Source(NumTimed);
+	for (size_t Index = 0; Index < NumTimed; Index++)
+	{
+		Source[Index] = uint16_t(0x3000 + Index * 2654435761u % 0x1000);
+	}
+	std::vector<float> Wide(NumTimed);
+	std::vector<uint16_t> Narrow(NumTimed);
+	std::vector<uint16_t> Back(NumTimed);
+	std::vector<uint32_t> Packed(NumTimed / 4);
+	ConvertCaptureHalfToFloat(Source.data(), Wide.data(), NumTimed);
+	std::vector<float> Copy(NumTimed);
+
+	auto Time = [&](const char* What, size_t NumBytes, const std::function<void()>& Function)
+	{
+		double Best = 1e30;
+		for (int32_t Repeat = 0; Repeat < 3; Repeat++)
+		{
+			const auto Start = std::chrono::steady_clock::now();
+			Function();
+			Best = std::min(Best, SecondsSince(Start));
+		}
+		printf("  %-32s %7.2f ms, %5.1f GB/s\n", What, Best * 1e3, double(NumBytes) / Best * 1e-9);
+	};
+	printf("  %dx%d RGBA, %s:\n", TimedWidth, TimedHeight, CAPTURE_SIMD_AVX2 ? "f16c and avx2" : "no f16c");
+	Time("memcpy of the floats", NumTimed * 8, [&] { memcpy(Copy.data(), Wide.data(), NumTimed * 4); });
+	Time("half to float, one at a time", NumTimed * 6, [&] { for (size_t Index = 0; Index < NumTimed; Index++) { Copy[Index] = CaptureHalfToFloat(Source[Index]); } });
+	Time("half to float", NumTimed * 6, [&] { ConvertCaptureHalfToFloat(Source.data(), Wide.data(), NumTimed); });
+	Time("float to half, one at a time", NumTimed * 6, [&] { for (size_t Index = 0; Index < NumTimed; Index++) { Narrow[Index] = CaptureFloatToHalf(Wide[Index]); } });
+	Time("float to half", NumTimed * 6, [&] { ConvertCaptureFloatToHalf(Wide.data(), Narrow.data(), NumTimed); });
+	Time("half to bfloat16", NumTimed * 4, [&] { ConvertCaptureHalfToBFloat16(Source.data(), Narrow.data(), NumTimed); });
+	Time("bfloat16 to half", NumTimed * 4, [&] { ConvertCaptureBFloat16ToHalf(Narrow.data(), Back.data(), NumTimed); });
+	{
+		float* Planes[3] = { Wide.data(), Wide.data() + NumTimed / 4, Wide.data() + NumTimed / 2 };
+		Time("RGBA halves to RGB planes", NumTimed * 2 + NumTimed * 3, [&] { ConvertCaptureHalfToFloatPlanes(Source.data(), 4, 3, NumTimed / 4, Planes); });
+	}
+	Time("RGB floats to R11G11B10", NumTimed / 4 * 16, [&] { ConvertCaptureFloatToR11G11B10(Wide.data(), Packed.data(), NumTimed / 4); });
+	Time("R11G11B10 to RGB floats", NumTimed / 4 * 16, [&] { ConvertCaptureR11G11B10ToFloat(Packed.data(), Wide.data(), NumTimed / 4); });
+
+	printf("half: %u cases, %u failures\n", NumCases, NumFailures);
+	return NumFailures ? 2 : 0;
+}
+
+/**
+ * Checks the CPU reference of the pack stage: half conversion against FloatToHalf() over a sweep of every
+ * exponent, 24 bit depth against its definition, and pack/unpack round trips of a synthetic frame. Then reports
+ * the bytes per frame each r.Capture.Pack.Depth mode reads back.
+ */
+int RunPackCheck(const FBenchOptions& Options)
+{
+	uint32_t NumFailures = 0;
+
+	// Every half survives the trip through float, denormals included.
+	for (uint32_t Half = 0; Half < 0x10000; Half++)
+	{
+		const bool bNaN = (Half & 0x7C00) == 0x7C00 && (Half & 0x3FF);
+		float Value = 0.0f;
+		uint32_t Bits = 0;
+		uint8_t Source[8] = {};
+		uint8_t Unpacked[8] = {};
+		memcpy(Source, &Half, 2);
+		UnpackCaptureDepth(Source, CapturePF_PackedDepth16F, nullptr, 1, 1, Unpacked);
+		memcpy(&Bits, Unpacked, sizeof(Bits));
+		memcpy(&Value, &Bits, sizeof(Value));
+
+		const uint16_t Packed = CaptureFloatToHalf(Value);
+		if (Packed != (bNaN ? Half | 0x200 : Half))
+		{
+			printf("  half 0x%04x does not round trip: 0x%04x\n", Half, Packed);
+			NumFailures++;
+		}
+	}
+
+	// Rounding of floats that fall between halves, ties included. Float denormals are flushed by both.
+	uint64_t NumFloats = 0;
+	for (uint64_t Bits = 0; Bits < 0x100000000ull; Bits += 251)
+	{
+		if (((Bits >> 23) & 0xFF) == 0xFF)
+		{
+			continue;
+		}
+		float Value;
+		const uint32_t FloatBits = uint32_t(Bits);
+		memcpy(&Value, &FloatBits, sizeof(Value));
+
+		NumFloats++;
+		if (CaptureFloatToHalf(Value) != FloatToHalf(Value))
+		{
+			printf("  float 0x%08x converts to 0x%04x instead of 0x%04x\n", FloatBits, CaptureFloatToHalf(Value), FloatToHalf(Value));
+			if (++NumFailures > 16)
+			{
+				return 2;
+			}
+		}
+	}
+
+	// 24 bit depth is the floor of the depth in 2^-24 steps, clamped, and unpacks to the center of its step.
+	uint64_t NumDepths = 0;
+	uint32_t Previous = 0;
+	for (uint32_t Step = 0; Step <= (1u << 22); Step++)
+	{
+		const float Depth = float(Step) / float(1u << 22);
+		const uint32_t Packed = CapturePackDepthToUNorm24(Depth);
+		const double Exact = double(Depth) * 16777216.0;
+		const bool bFloor = Packed == std::min<uint32_t>(uint32_t(Exact), 0xFFFFFF);
+		const bool bCenter = std::fabs(double(CaptureUnpackUNorm24(Packed)) - double(Depth)) <= 1.0 / 16777216.0;
+
+		NumDepths++;
+		if (!bFloor || !bCenter || Packed < Previous)
+		{
+			printf("  depth %.9g packs to %u\n", Depth, Packed);
+			NumFailures++;
+		}
+		Previous = Packed;
+	}
+	if (CapturePackDepthToUNorm24(-1.0f) != 0 || CapturePackDepthToUNorm24(std::nanf("")) != 0 || CapturePackDepthToUNorm24(2.0f) != 0xFFFFFF)
+	{
+		printf("  depth outside [0, 1] is not clamped\n");
+		NumFailures++;
+	}
+
+	// Round trips of a synthetic frame through a padded staging pitch.
+	std::mt19937 Random(5);
+	const std::vector<FBenchLayer> Frame = MakeSyntheticFrame(Options.Width, Options.Height, 0, Random);
+	const FBenchLayer& Color = Frame[0];
+	const FBenchLayer& Depth = Frame[2];
+	const size_t NumPixels = size_t(Options.Width) * Options.Height;
+
+	std::vector<uint8_t> Packed(NumPixels * 6);
+	std::vector<uint8_t> Unpacked(NumPixels * 8);
+	PackCaptureColor(Color.Bytes.data(), uint64_t(Options.Width) * 8, Options.Width, Options.Height, Packed.data());
+	UnpackCaptureColor(Packed.data(), Options.Width, Options.Height, Unpacked.data());
+	if (Unpacked != Color.Bytes)
+	{
+		printf("  color does not round trip\n");
+		NumFailures++;
+	}
+
+	const ECaptureDepthPack Modes[] = { ECaptureDepthPack::Float32, ECaptureDepthPack::Float16, ECaptureDepthPack::UNorm24 };
+	const char* ModeNames[] = { "float", "half", "24 bit" };
+	uint64_t DepthBytes[3] = {};
+	for (uint32_t ModeIndex = 0; ModeIndex < 3; ModeIndex++)
+	{
+		const ECaptureDepthPack Mode = Modes[ModeIndex];
+		std::vector<uint8_t> PackedDepth(NumPixels * GetCaptureDepthPackBytes(Mode));
+		std::vector<uint8_t> Stencil(NumPixels);
+		PackCaptureDepth(Depth.Bytes.data(), uint64_t(Options.Width) * 8, 8, Options.Width, Options.Height, Mode, PackedDepth.data(), Stencil.data());
+		UnpackCaptureDepth(PackedDepth.data(), GetCaptureDepthPackFormat(Mode), Stencil.data(), Options.Width, Options.Height, Unpacked.data());
+		DepthBytes[ModeIndex] = PackedDepth.size() + Stencil.size();
+
+		for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+		{
+			float Original;
+			float Restored;
+			memcpy(&Original, Depth.Bytes.data() + Pixel * 8, sizeof(Original));
+			memcpy(&Restored, Unpacked.data() + Pixel * 8, sizeof(Restored));
+
+			const float Tolerance = Mode == ECaptureDepthPack::Float32 ? 0.0f
+				: Mode == ECaptureDepthPack::Float16 ? std::fabs(Original) / 2048.0f + 6e-8f
+				: 1.0f / 33554432.0f;
+			const bool bStencil = memcmp(Unpacked.data() + Pixel * 8 + 4, Depth.Bytes.data() + Pixel * 8 + 4, 4) == 0;
+			if (std::fabs(Restored - Original) > Tolerance || !bStencil)
+			{
+				printf("  %s depth at pixel %zu: %.9g -> %.9g\n", ModeNames[ModeIndex], Pixel, Original, Restored);
+				NumFailures++;
+				break;
+			}
+		}
+	}
+
+	// Writer side linearization, reversed Z with the near plane at 10: the vector path gives the bits of the scalar one
+	// and every packed plane lands on R32_FLOAT.
+	const float DeviceZToWorldZ[4] = { 0.0f, 0.0f, 0.1f, 0.0f };
+	std::vector<float> Linear(NumPixels);
+	for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+	{
+		memcpy(&Linear[Pixel], Depth.Bytes.data() + Pixel * 8, sizeof(float));
+	}
+	std::vector<float> LinearScalar = Linear;
+	LinearizeCaptureDepth(Linear.data(), NumPixels, DeviceZToWorldZ);
+	for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+	{
+		LinearizeCaptureDepth(&LinearScalar[Pixel], 1, DeviceZToWorldZ);
+	}
+	if (memcmp(Linear.data(), LinearScalar.data(), NumPixels * sizeof(float)) != 0)
+	{
+		printf("  vector and scalar linear depth differ\n");
+		NumFailures++;
+	}
+
+	FCaptureDepthLinearization Linearization;
+	Linearization.bEnabled = true;
+	memcpy(Linearization.DeviceZToWorldZ, DeviceZToWorldZ, sizeof(DeviceZToWorldZ));
+	for (uint32_t ModeIndex = 0; ModeIndex < 3; ModeIndex++)
+	{
+		const ECaptureDepthPack Mode = Modes[ModeIndex];
+		std::vector<uint8_t> Plane(NumPixels * GetCaptureDepthPackBytes(Mode));
+		PackCaptureDepth(Depth.Bytes.data(), uint64_t(Options.Width) * 8, 8, Options.Width, Options.Height, Mode, Plane.data(), nullptr);
+		uint32_t PixelFormat = GetCaptureDepthPackFormat(Mode);
+		uint32_t BytesPerPixel = GetCaptureDepthPackBytes(Mode);
+		if (!LinearizeCaptureDepthPlane(Plane, PixelFormat, BytesPerPixel, Linearization)
+			|| PixelFormat != CapturePF_R32_FLOAT || BytesPerPixel != 4 || Plane.size() != NumPixels * 4)
+		{
+			printf("  %s depth plane is not linearized\n", ModeNames[ModeIndex]);
+			NumFailures++;
+			continue;
+		}
+		if (Mode == ECaptureDepthPack::Float32 && memcmp(Plane.data(), Linear.data(), Plane.size()) != 0)
+		{
+			printf("  float depth plane does not linearize in place\n");
+			NumFailures++;
+		}
+	}
+
+	printf("pack: 65536 halves, %llu floats, %llu depths, %dx%d frame, %u failures\n",
+		(unsigned long long)NumFloats, (unsigned long long)NumDepths, Options.Width, Options.Height, NumFailures);
+
+	// Color, velocity and depth/stencil as read back without and with packing.
+	const uint64_t UnpackedBytes = NumPixels * (8 + 4 + 8);
+	for (uint32_t ModeIndex = 0; ModeIndex < 3; ModeIndex++)
+	{
+		const uint64_t PackedBytes = NumPixels * (6 + 4) + DepthBytes[ModeIndex];
+		printf("  color + velocity + %-6s depth + stencil: %6.2f MB per frame instead of %6.2f MB, %4.1f%% less\n", ModeNames[ModeIndex],
+			double(PackedBytes) / 1e6, double(UnpackedBytes) / 1e6, 100.0 * (1.0 - double(PackedBytes) / double(UnpackedBytes)));
+	}
+	return NumFailures ? 2 : 0;
+}
+
+bool ParseOptions(int Argc, char** Argv, FBenchOptions& Options)
+{
+	for (int Arg = 2; Arg < Argc; Arg++)
+	{
+		const char* Value = Argv[Arg];
+		const bool bHasNext = Arg + 1 < Argc;
+
+		if (strcmp(Value, "--size") == 0 && bHasNext)
+		{
+			if (sscanf(Argv[++Arg], "%dx%d", &Options.Width, &Options.Height) != 2 || Options.Width <= 0 || Options.Height <= 0)
+			{
+				return false;
+			}
+			Options.bCustomSize = true;
+		}
+		else if (strcmp(Value, "--frames") == 0 && bHasNext)
+		{
+			Options.NumFrames = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--threads") == 0 && bHasNext)
+		{
+			Options.NumThreads = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--fps") == 0 && bHasNext)
+		{
+			Options.TargetFps = atof(Argv[++Arg]);
+		}
+		else if (strcmp(Value, "--capture") == 0 && bHasNext)
+		{
+			Options.CapturePath = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--compress") == 0)
+		{
+			Options.bCompress = true;
+		}
+		else if (strcmp(Value, "--overflow") == 0 && bHasNext)
+		{
+			const char* Policy = Argv[++Arg];
+			if (strcmp(Policy, "drop") == 0)
+			{
+				Options.Overflow = ECaptureOverflow::Drop;
+			}
+			else if (strcmp(Policy, "block") == 0)
+			{
+				Options.Overflow = ECaptureOverflow::Block;
+			}
+			else if (strcmp(Policy, "coalesce") == 0)
+			{
+				Options.Overflow = ECaptureOverflow::Coalesce;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (strcmp(Value, "--output") == 0 && bHasNext)
+		{
+			Options.OutputPath = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--trace") == 0 && bHasNext)
+		{
+			Options.TracePath = Argv[++Arg];
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void PrintUsage()
+{
+	printf(
+		"usage: capture_bench <benchmark> [options]\n"
+		"  compress             encode and decode frames with the capture codec\n"
+		"  formats              check padded surface packing for every pixel format\n"
+		"  pipeline             push color, velocity and depth through readback ring, writers and container\n"
+		"  ring                 check batched acquisition on the readback ring\n"
+		"  container            check that back to back sessions keep containers of their own and crashed sessions recover\n"
+		"  taps                 check r.Capture.Taps matching and scheduling\n"
+		"  pack                 check the CPU reference of the pack stage and report the bytes it saves\n"
+		"  pool                 compare host buffer allocation and page faults with and without the buffer pool\n"
+		"  stream               publish frames to the shared memory ring while another process reads them\n"
+		"  trace                check the trace recorder and report what a scope costs\n"
+		"  rate                 drive the adaptive rate controller with a simulated slow disk\n"
+		"  taa                  check the CPU reference of the TAA resolve and time 720p to 1080p upsampling\n"
+		"  kernels              check the TAA filter kernels and their weight tables, compare their cost and resolve quality\n"
+		"  gen5                 check the CPU reference of the Gen5 TAAU chain and time each of its passes\n"
+		"  sweep                check the TAA settings sweep and time it against one setting at a time\n"
+		"  metrics              check the image quality metrics and time them on 1080p frames\n"
+		"  resample             check the resampler against its kernels and time the history downsamples to 1080p\n"
+		"  half                 check the half, bfloat16 and R11G11B10 conversions exhaustively and time them on 4K RGBA\n"
+		"options:\n"
+		"  --size WxH           synthetic frame size (default 1280x720, pipeline sweeps 720p, 1080p and 4K)\n"
+		"  --frames N           frames to generate or read (default 32)\n"
+		"  --threads N          writer threads, taa, kernels, gen5 and sweep: resolve threads, metrics and resample: their threads (default 2)\n"
+		"  --fps N              capture frame rate to keep up with (default 60)\n"
+		"  --capture file.ucap  use the frames of a real capture instead of synthetic ones (compress, kernels, gen5)\n"
+		"  --compress           pipeline: compress layers on the writer threads\n"
+		"  --overflow POLICY    pipeline: writer queue policy, drop, block (default) or coalesce\n"
+		"  --output file.ucap   pipeline: scratch container, removed afterwards (default capture_bench.ucap)\n"
+		"  --trace file.json    pipeline: record a Chrome trace of every size and print its summary\n");
+}
+
+} //! namespace
+
+int main(int Argc, char** Argv)
+{
+	FBenchOptions Options;
+	if (Argc < 2 || !ParseOptions(Argc, Argv, Options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (strcmp(Argv[1], "compress") == 0)
+	{
+		return RunCompressBench(Options);
+	}
+	else if (strcmp(Argv[1], "formats") == 0)
+	{
+		return RunFormatsCheck(Options);
+	}
+	else if (strcmp(Argv[1], "pipeline") == 0)
+	{
+		return RunPipelineBench(Options);
+	}
+	else if (strcmp(Argv[1], "ring") == 0)
+	{
+		return RunRingCheck();
+	}
+	else if (strcmp(Argv[1], "container") == 0)
+	{
+		return RunContainerCheck();
+	}
+	else if (strcmp(Argv[1], "taps") == 0)
+	{
+		return RunTapsCheck();
+	}
+	else if (strcmp(Argv[1], "pack") == 0)
+	{
+		return RunPackCheck(Options);
+	}
+	else if (strcmp(Argv[1], "pool") == 0)
+	{
+		return RunPoolBench(Options);
+	}
+	else if (strcmp(Argv[1], "stream") == 0)
+	{
+		return RunStreamBench(Options);
+	}
+	else if (strcmp(Argv[1], "trace") == 0)
+	{
+		return RunTraceCheck();
+	}
+	else if (strcmp(Argv[1], "rate") == 0)
+	{
+		return RunRateCheck();
+	}
+	else if (strcmp(Argv[1], "taa") == 0)
+	{
+		return RunTAACheck(Options);
+	}
+	else if (strcmp(Argv[1], "kernels") == 0)
+	{
+		return RunKernelsBench(Options);
+	}
+	else if (strcmp(Argv[1], "gen5") == 0)
+	{
+		return RunGen5Check(Options);
+	}
+	else if (strcmp(Argv[1], "sweep") == 0)
+	{
+		return RunSweepCheck(Options);
+	}
+	else if (strcmp(Argv[1], "metrics") == 0)
+	{
+		return RunMetricsCheck(Options);
+	}
+	else if (strcmp(Argv[1], "resample") == 0)
+	{
+		return RunResampleCheck(Options);
+	}
+	else if (strcmp(Argv[1], "half") == 0)
+	{
+		return RunHalfCheck(Options);
+	}
+
+	PrintUsage();
+	return 1;
+}
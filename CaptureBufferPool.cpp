@@ -0,0 +1,178 @@
+#include "CaptureBufferPool.h"
+
+#include <algorithm>
+
+namespace
+{
+
+constexpr uint32_t ClassesPerOctave = 8;
+
+size_t GetOctave(size_t NumBytes)
+{
+	size_t Octave = 1;
+	while (Octave <= NumBytes / 2)
+	{
+		Octave <<= 1;
+	}
+	return Octave;
+}
+
+} //! namespace
+
+size_t FCaptureBufferPool::GetSizeClass(size_t NumBytes)
+{
+	if (NumBytes <= MinPooledBytes)
+	{
+		return MinPooledBytes;
+	}
+	// Rounding up may reach the next power of two, which is a class of the next octave as well.
+	const size_t Step = GetOctave(NumBytes) / ClassesPerOctave;
+	return (NumBytes + Step - 1) / Step * Step;
+}
+
+size_t FCaptureBufferPool::GetSizeClassOfCapacity(size_t Capacity)
+{
+	if (Capacity < MinPooledBytes)
+	{
+		return 0;
+	}
+	const size_t Step = GetOctave(Capacity) / ClassesPerOctave;
+	return Capacity / Step * Step;
+}
+
+FCaptureBufferPool::FCaptureBufferPool(uint64_t InMaxPooledBytes)
+	: MaxPooledBytes(InMaxPooledBytes)
+{
+}
+
+std::vector<uint8_t> FCaptureBufferPool::Acquire(size_t NumBytes, size_t ReserveBytes)
+{
+	const size_t NeededBytes = std::max(NumBytes, ReserveBytes);
+	std::vector<uint8_t> Buffer;
+	if (NeededBytes < MinPooledBytes)
+	{
+		Buffer.resize(NumBytes);
+		return Buffer;
+	}
+
+	const size_t SizeClass = GetSizeClass(NeededBytes);
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Stats.NumAcquired++;
+
+		auto It = FreeLists.find(SizeClass);
+		if (It != FreeLists.end() && !It->second.empty())
+		{
+			// Most recently released first, its pages are the likeliest to still be in cache.
+			Buffer = std::move(It->second.back().Buffer);
+			It->second.pop_back();
+
+			Stats.NumHits++;
+			Stats.NumPooled--;
+			Stats.PooledBytes -= Buffer.capacity();
+			OutstandingBytes += Buffer.capacity();
+		}
+		else
+		{
+			OutstandingBytes += SizeClass;
+		}
+		Stats.PeakResidentBytes = std::max(Stats.PeakResidentBytes, OutstandingBytes + Stats.PooledBytes);
+	}
+
+	// Allocating outside the lock; a reused buffer only has to initialize what it grows by, usually nothing.
+	if (Buffer.capacity() == 0)
+	{
+		Buffer.reserve(SizeClass);
+	}
+	Buffer.resize(NumBytes);
+	return Buffer;
+}
+
+void FCaptureBufferPool::Release(std::vector<uint8_t>&& Buffer)
+{
+	const size_t SizeClass = GetSizeClassOfCapacity(Buffer.capacity());
+	if (SizeClass == 0)
+	{
+		std::vector<uint8_t>().swap(Buffer);
+		return;
+	}
+
+	std::vector<uint8_t> Freed;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Stats.NumReleased++;
+
+		// A buffer that grew, or came from outside the pool, is accounted at its release size.
+		OutstandingBytes -= std::min<uint64_t>(OutstandingBytes, Buffer.capacity());
+
+		if (MaxPooledBytes && Buffer.capacity() > MaxPooledBytes)
+		{
+			Stats.NumTrimmed++;
+			Freed = std::move(Buffer);
+		}
+		else
+		{
+			Stats.NumPooled++;
+			Stats.PooledBytes += Buffer.capacity();
+			FreeLists[SizeClass].push_back({ std::move(Buffer), ++ReleaseTick });
+			if (MaxPooledBytes)
+			{
+				TrimTo(MaxPooledBytes);
+			}
+		}
+	}
+	Buffer.clear();
+}
+
+void FCaptureBufferPool::SetMaxPooledBytes(uint64_t InMaxPooledBytes)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	MaxPooledBytes = InMaxPooledBytes;
+	if (MaxPooledBytes)
+	{
+		TrimTo(MaxPooledBytes);
+	}
+}
+
+void FCaptureBufferPool::Trim()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	TrimTo(0);
+}
+
+FCaptureBufferPoolStats FCaptureBufferPool::GetStats() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	FCaptureBufferPoolStats Result = Stats;
+	Result.ResidentBytes = OutstandingBytes + Stats.PooledBytes;
+	return Result;
+}
+
+void FCaptureBufferPool::TrimTo(uint64_t MaxBytes)
+{
+	while (Stats.PooledBytes > MaxBytes)
+	{
+		// Evict the buffer released longest ago; the head of every list is its oldest.
+		auto Oldest = FreeLists.end();
+		for (auto It = FreeLists.begin(); It != FreeLists.end(); ++It)
+		{
+			if (!It->second.empty() && (Oldest == FreeLists.end() || It->second.front().ReleaseTick < Oldest->second.front().ReleaseTick))
+			{
+				Oldest = It;
+			}
+		}
+		if (Oldest == FreeLists.end())
+		{
+			break;
+		}
+
+		Stats.NumTrimmed++;
+		Stats.NumPooled--;
+		Stats.PooledBytes -= Oldest->second.front().Buffer.capacity();
+		Oldest->second.pop_front();
+		if (Oldest->second.empty())
+		{
+			FreeLists.erase(Oldest);
+		}
+	}
+}
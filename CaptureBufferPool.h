@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <vector>
+
+/**
+ * Recycles the host buffers captured layers travel in, so a steady capture stops allocating and faulting in
+ * tens of megabytes per frame.
+ *
+ * The render thread acquires a buffer when a readback lands and the writer threads release it once the layer is
+ * on disk. Buffers are binned by size class: eight classes per power of two from MinPooledBytes up, so a buffer
+ * is at most 12.5% larger than asked for and small changes of the extent (dynamic resolution) still hit. Smaller
+ * requests are plain allocations and are not pooled.
+ *
+ * Free buffers are kept up to a byte budget; past it the buffers released longest ago are freed first. Thread safe.
+ */
+
+struct FCaptureBufferPoolStats
+{
+	uint64_t NumAcquired = 0;
+	uint64_t NumHits = 0;
+	uint64_t NumReleased = 0;
+
+	/** Released buffers freed because the pool was over budget. */
+	uint64_t NumTrimmed = 0;
+
+	/** Free buffers and their capacity. */
+	uint32_t NumPooled = 0;
+	uint64_t PooledBytes = 0;
+
+	/** Capacity of pooled buffers plus buffers handed out and not yet returned, and its high-water mark. */
+	uint64_t ResidentBytes = 0;
+	uint64_t PeakResidentBytes = 0;
+
+	double GetHitRate() const { return NumAcquired ? double(NumHits) / double(NumAcquired) : 0.0; }
+};
+
+class FCaptureBufferPool
+{
+public:
+	static constexpr size_t MinPooledBytes = 64 * 1024;
+
+	/** MaxPooledBytes of 0 keeps every released buffer. */
+	explicit FCaptureBufferPool(uint64_t InMaxPooledBytes = 0);
+
+	FCaptureBufferPool(const FCaptureBufferPool&) = delete;
+	FCaptureBufferPool& operator=(const FCaptureBufferPool&) = delete;
+
+	/**
+	 * Returns a buffer of NumBytes bytes with a capacity of at least ReserveBytes, for callers that grow it later.
+	 * The contents are whatever the previous user left.
+	 */
+	std::vector<uint8_t> Acquire(size_t NumBytes, size_t ReserveBytes = 0);
+
+	/** Takes a buffer back, from any thread. Empty and small buffers are simply freed. */
+	void Release(std::vector<uint8_t>&& Buffer);
+
+	void SetMaxPooledBytes(uint64_t InMaxPooledBytes);
+
+	/** Frees every pooled buffer. */
+	void Trim();
+
+	FCaptureBufferPoolStats GetStats() const;
+
+	/** Smallest size class holding NumBytes, and the largest one a buffer of Capacity bytes can serve. */
+	static size_t GetSizeClass(size_t NumBytes);
+	static size_t GetSizeClassOfCapacity(size_t Capacity);
+
+private:
+	struct FFreeBuffer
+	{
+		std::vector<uint8_t> Buffer;
+		uint64_t ReleaseTick = 0;
+	};
+
+	void TrimTo(uint64_t MaxBytes);
+
+	mutable std::mutex Mutex;
+
+	/** Free buffers per size class, oldest release first. */
+	std::map<size_t, std::deque<FFreeBuffer>> FreeLists;
+
+	uint64_t MaxPooledBytes;
+	uint64_t ReleaseTick = 0;
+	uint64_t OutstandingBytes = 0;
+	FCaptureBufferPoolStats Stats;
+};
@@ -0,0 +1,330 @@
+/**
+ * Scores a captured sequence against a reference with the metrics of CaptureMetrics.h: PSNR, MS-SSIM, FLIP-like
+ * and velocity reprojected flicker, frame by frame.
+ *
+ *   capture_compare [options] <test.ucap> [reference.ucap]
+ *
+ * The test is the --test-layer ("output") of every frame of test.ucap, typically a TAA or DLSS capture or a
+ * capture_replay --output. The reference is the --reference-layer of the same frame index in reference.ucap, or of
+ * test.ucap itself when only one container is given. Flicker reprojects with the test's "velocity" layer (the
+ * reference's when the test has none) and restarts on camera cuts. A reference of another size, e.g. a supersampled
+ * ground truth, is resampled to the test's with --resample. Means over the sequence are printed; --csv writes one
+ * line per frame and --heatmaps one EXR per frame with the flip, dssim and flicker maps as float channels.
+ *
+ * Build: g++ -O2 -std=c++17 -mavx2 CaptureCompare.cpp CaptureMetrics.cpp CaptureResample.cpp CaptureFilterKernels.cpp CaptureImage.cpp
+ *        CaptureParallel.cpp CaptureReader.cpp CaptureContainer.cpp CaptureCompress.cpp CaptureHalf.cpp CapturePack.cpp CapturePixelFormat.cpp CaptureTrace.cpp -lOpenEXR -lImath -lpthread
+ */
+
+#include "CaptureImage.h"
+#include "CaptureMetrics.h"
+#include "CaptureReader.h"
+#include "CaptureResample.h"
+
+#include <ImfChannelList.h>
+#include <ImfCompression.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfOutputFile.h>
+#include <ImfThreading.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct FCompareOptions
+{
+	std::string TestPath;
+	std::string ReferencePath;
+	std::string TestLayer = "output";
+	std::string ReferenceLayer = "output";
+	std::string CsvPath;
+	std::string HeatmapDir;
+	uint32_t NumFrames = ~0u;
+	FCaptureMetricsSettings Settings;
+	ECaptureFilterKernel ResampleKernel = ECaptureFilterKernel::MitchellNetravali;
+};
+
+void PrintUsage()
+{
+	printf(
+		"usage: capture_compare [options] <test.ucap> [reference.ucap]\n"
+		"  --test-layer NAME       layer scored (default output)\n"
+		"  --reference-layer NAME  layer scored against (default output), of test.ucap without reference.ucap\n"
+		"  --frames N              compare the first N frames\n"
+		"  --threads N             metric threads (default: one per hardware thread)\n"
+		"  --exposure F            scale of the colors before tonemapping (default 1)\n"
+		"  --pixels-per-degree F   viewing condition of the FLIP metric (default 67)\n"
+		"  --resample KERNEL       filter bringing a reference of another size to the test's: gaussian, catmull-rom,\n"
+		"                          mitchell-netravali (default), lanczos2, lanczos3 or blackman-harris\n"
+		"  --csv file.csv          write the metrics of every frame\n"
+		"  --heatmaps DIR          write the flip, dssim and flicker maps of every frame as EXRs\n"
+		"  --scalar                one pixel at a time instead of eight lanes\n");
+}
+
+bool ParseOptions(int Argc, char** Argv, FCompareOptions& Options)
+{
+	for (int Arg = 1; Arg < Argc; Arg++)
+	{
+		const char* Value = Argv[Arg];
+		const bool bHasNext = Arg + 1 < Argc;
+
+		if (strcmp(Value, "--test-layer") == 0 && bHasNext)
+		{
+			Options.TestLayer = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--reference-layer") == 0 && bHasNext)
+		{
+			Options.ReferenceLayer = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--frames") == 0 && bHasNext)
+		{
+			Options.NumFrames = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--threads") == 0 && bHasNext)
+		{
+			Options.Settings.NumThreads = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--exposure") == 0 && bHasNext)
+		{
+			Options.Settings.Exposure = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--pixels-per-degree") == 0 && bHasNext)
+		{
+			Options.Settings.PixelsPerDegree = std::max(float(atof(Argv[++Arg])), 1.0f);
+		}
+		else if (strcmp(Value, "--csv") == 0 && bHasNext)
+		{
+			Options.CsvPath = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--heatmaps") == 0 && bHasNext)
+		{
+			Options.HeatmapDir = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--resample") == 0 && bHasNext)
+		{
+			if (!ParseCaptureFilterKernel(Argv[++Arg], Options.ResampleKernel))
+			{
+				return false;
+			}
+		}
+		else if (strcmp(Value, "--scalar") == 0)
+		{
+			Options.Settings.bScalar = true;
+		}
+		else if (Value[0] != '-' && Options.TestPath.empty())
+		{
+			Options.TestPath = Value;
+		}
+		else if (Value[0] != '-' && Options.ReferencePath.empty())
+		{
+			Options.ReferencePath = Value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return !Options.TestPath.empty() && (!Options.ReferencePath.empty() || Options.TestLayer != Options.ReferenceLayer);
+}
+
+/** One EXR with a float channel per map. */
+void WriteHeatmaps(const std::string& Path, const FCaptureMetricsMaps& Maps)
+{
+	const int32_t Width = Maps.Flip.Width;
+	const int32_t Height = Maps.Flip.Height;
+	const std::pair<const char*, const FCaptureImage*> Channels[] = { { "flip", &Maps.Flip }, { "dssim", &Maps.Dssim }, { "flicker", &Maps.Flicker } };
+
+	Imf::Header Header(Width, Height);
+	Header.compression() = Imf::ZIP_COMPRESSION;
+	Imf::FrameBuffer FrameBuffer;
+	for (const auto& Channel : Channels)
+	{
+		Header.channels().insert(Channel.first, Imf::Channel(Imf::FLOAT));
+		FrameBuffer.insert(Channel.first, Imf::Slice(Imf::FLOAT, (char*)Channel.second->Data.data(), sizeof(float), sizeof(float) * size_t(Width)));
+	}
+	Imf::OutputFile File(Path.c_str(), Header, 1);
+	File.setFrameBuffer(FrameBuffer);
+	File.writePixels(Height);
+}
+
+} //! namespace
+
+int main(int Argc, char** Argv)
+{
+	FCompareOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FCaptureReader TestReader;
+	FCaptureReader ReferenceReader;
+	if (!TestReader.Open(Options.TestPath))
+	{
+		fprintf(stderr, "cannot open %s\n", Options.TestPath.c_str());
+		return 1;
+	}
+	if (!Options.ReferencePath.empty() && !ReferenceReader.Open(Options.ReferencePath))
+	{
+		fprintf(stderr, "cannot open %s\n", Options.ReferencePath.c_str());
+		return 1;
+	}
+	const FCaptureReader& Reference = Options.ReferencePath.empty() ? TestReader : ReferenceReader;
+
+	if (!Options.HeatmapDir.empty())
+	{
+		std::error_code Error;
+		fs::create_directories(Options.HeatmapDir, Error);
+		if (Error)
+		{
+			fprintf(stderr, "cannot create %s: %s\n", Options.HeatmapDir.c_str(), Error.message().c_str());
+			return 1;
+		}
+		// Frames are scored on our own workers, so OpenEXR's internal pool would only add contention.
+		Imf::setGlobalThreadCount(0);
+	}
+
+	FILE* Csv = nullptr;
+	if (!Options.CsvPath.empty())
+	{
+		Csv = fopen(Options.CsvPath.c_str(), "w");
+		if (!Csv)
+		{
+			fprintf(stderr, "cannot create %s\n", Options.CsvPath.c_str());
+			return 1;
+		}
+		fprintf(Csv, "frame,frame_id,mean_error,psnr_db,ms_ssim,flip,flicker,test_flicker,reference_flicker\n");
+	}
+
+	FCaptureMetrics Metrics(Options.Settings);
+	FCaptureResampleSettings ResampleSettings;
+	ResampleSettings.Kernel = Options.ResampleKernel;
+	ResampleSettings.NumThreads = Options.Settings.NumThreads;
+	ResampleSettings.bScalar = Options.Settings.bScalar;
+	FCaptureResampler Resampler(ResampleSettings);
+	const uint32_t NumFrames = std::min({ Options.NumFrames, TestReader.GetNumFrames(), Reference.GetNumFrames() });
+	const uint32_t NumThreads = Options.Settings.NumThreads ? Options.Settings.NumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	printf("%s %s against %s %s, %u frames on %u thread%s\n", Options.TestPath.c_str(), Options.TestLayer.c_str(),
+		Options.ReferencePath.empty() ? Options.TestPath.c_str() : Options.ReferencePath.c_str(), Options.ReferenceLayer.c_str(), NumFrames, NumThreads,
+		NumThreads > 1 ? "s" : "");
+
+	FCaptureImage Test;
+	FCaptureImage ReferenceImage;
+	FCaptureImage ResampledReference;
+	FCaptureImage Velocity;
+	std::vector<uint8_t> DecodeBuffer;
+	double Sums[5] = {};
+	uint32_t NumScored = 0;
+	uint32_t NumTemporal = 0;
+	double MetricSeconds = 0.0;
+	const auto Start = std::chrono::steady_clock::now();
+	for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+	{
+		if (FrameIndex + 1 < NumFrames)
+		{
+			TestReader.Prefetch(FrameIndex + 1);
+			Reference.Prefetch(FrameIndex + 1);
+		}
+
+		const uint64_t FrameId = TestReader.GetFrameId(FrameIndex);
+		if (!LoadCaptureImage(TestReader, FrameIndex, Options.TestLayer.c_str(), "rgb", Test, DecodeBuffer)
+			|| !LoadCaptureImage(Reference, FrameIndex, Options.ReferenceLayer.c_str(), "rgb", ReferenceImage, DecodeBuffer))
+		{
+			// A gap in the sequence: the next frame has nothing to reproject from.
+			Metrics.Reset();
+			continue;
+		}
+		const bool bHasVelocity = LoadCaptureImage(TestReader, FrameIndex, "velocity", nullptr, Velocity, DecodeBuffer)
+			|| LoadCaptureImage(Reference, FrameIndex, "velocity", nullptr, Velocity, DecodeBuffer);
+		const FCaptureFrameInfo* Info = TestReader.GetContainer().FindFrame(FrameId);
+		const bool bCameraCut = Info && (Info->Flags & CaptureFrame_CameraCut) != 0;
+
+		FCaptureFrameMetrics Frame;
+		const auto MetricStart = std::chrono::steady_clock::now();
+		const bool bResample = ReferenceImage.Width != Test.Width || ReferenceImage.Height != Test.Height;
+		if (bResample)
+		{
+			Resampler.Resample(ReferenceImage, Test.Width, Test.Height, ResampledReference);
+		}
+		if (!Metrics.Compare(Test, bResample ? ResampledReference : ReferenceImage, bHasVelocity ? &Velocity : nullptr, bCameraCut, Frame))
+		{
+			fprintf(stderr, "frame %u: %s is %dx%d, %s is %dx%d\n", FrameIndex, Options.TestLayer.c_str(), Test.Width, Test.Height,
+				Options.ReferenceLayer.c_str(), ReferenceImage.Width, ReferenceImage.Height);
+			Metrics.Reset();
+			continue;
+		}
+		MetricSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - MetricStart).count();
+
+		NumScored++;
+		Sums[0] += Frame.MeanError;
+		Sums[1] += std::min(Frame.Psnr, 100.0);
+		Sums[2] += Frame.MsSsim;
+		Sums[3] += Frame.Flip;
+		if (Frame.bHasTemporal)
+		{
+			NumTemporal++;
+			Sums[4] += Frame.Flicker;
+		}
+
+		if (Csv)
+		{
+			fprintf(Csv, "%u,%llu,%.6f,%.3f,%.6f,%.6f,", FrameIndex, (unsigned long long)FrameId, Frame.MeanError, Frame.Psnr, Frame.MsSsim, Frame.Flip);
+			if (Frame.bHasTemporal)
+			{
+				fprintf(Csv, "%.6f,%.6f,%.6f\n", Frame.Flicker, Frame.TestFlicker, Frame.ReferenceFlicker);
+			}
+			else
+			{
+				fprintf(Csv, ",,\n");
+			}
+		}
+
+		if (!Options.HeatmapDir.empty())
+		{
+			const std::string Path = (fs::path(Options.HeatmapDir) / (fs::path(Options.TestPath).stem().string() + "_metrics_" + std::to_string(FrameId) + ".exr")).string();
+			try
+			{
+				WriteHeatmaps(Path, Metrics.GetMaps());
+			}
+			catch (const std::exception& Error)
+			{
+				fprintf(stderr, "%s: %s\n", Path.c_str(), Error.what());
+				return 1;
+			}
+		}
+	}
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	if (Csv && fclose(Csv) != 0)
+	{
+		fprintf(stderr, "cannot write %s\n", Options.CsvPath.c_str());
+		return 1;
+	}
+	if (!NumScored)
+	{
+		fprintf(stderr, "no frame has both %s and %s\n", Options.TestLayer.c_str(), Options.ReferenceLayer.c_str());
+		return 1;
+	}
+
+	printf("  mean error %.5f  psnr %.2f dB  ms-ssim %.5f  flip %.5f", Sums[0] / NumScored, Sums[1] / NumScored, Sums[2] / NumScored, Sums[3] / NumScored);
+	if (NumTemporal)
+	{
+		printf("  flicker %.5f", Sums[4] / NumTemporal);
+	}
+	printf("\n%u frames in %.2f s, %.1f ms per frame in the metrics\n", NumScored, Seconds, MetricSeconds * 1e3 / NumScored);
+	return 0;
+}
@@ -0,0 +1,749 @@
+#include "CaptureCompress.h"
+
+#include "CaptureTrace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CAPTURE_COMPRESS_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define CAPTURE_COMPRESS_SSE2 0
+#endif
+
+namespace
+{
+
+enum class EPlaneMode : uint8_t
+{
+	Stored = 0,
+	Constant = 1,
+	Rans = 2,
+};
+
+struct FPayloadHeader
+{
+	uint32_t Magic;
+	uint32_t NumPlanes;
+	uint64_t PlaneSize;
+};
+
+struct FPlaneHeader
+{
+	uint8_t Mode;
+	uint8_t Value;
+	uint16_t Reserved;
+	uint32_t Size;
+};
+
+constexpr uint32_t PayloadMagic = 0x31524453; // "SDR1"
+
+/** rANS with 12 bit probabilities and 32 bit states renormalized one byte at a time. */
+constexpr uint32_t ProbBits = 12;
+constexpr uint32_t ProbScale = 1u << ProbBits;
+constexpr uint32_t RansLow = 1u << 23;
+constexpr uint32_t NumStates = 4;
+constexpr uint32_t FrequencyTableSize = 256 * sizeof(uint16_t);
+
+/** Per-symbol encoder constants; the division by the frequency is replaced by a reciprocal multiply. */
+struct FRansEncSymbol
+{
+	uint32_t MaxState;
+	uint32_t RcpFreq;
+	uint32_t Bias;
+	uint16_t CmplFreq;
+	uint16_t RcpShift;
+};
+
+struct FRansDecSymbol
+{
+	uint16_t Start;
+	uint16_t Freq;
+};
+
+void InitEncSymbol(FRansEncSymbol& Symbol, uint32_t Start, uint32_t Freq)
+{
+	Symbol.MaxState = ((RansLow >> ProbBits) << 8) * Freq;
+	Symbol.CmplFreq = uint16_t(ProbScale - Freq);
+	if (Freq < 2)
+	{
+		// x / 1 == x, folded into the bias so the fast path below stays branch free.
+		Symbol.RcpFreq = ~0u;
+		Symbol.RcpShift = 0;
+		Symbol.Bias = Start + ProbScale - 1;
+	}
+	else
+	{
+		uint32_t Shift = 0;
+		while (Freq > (1u << Shift))
+		{
+			Shift++;
+		}
+		Symbol.RcpFreq = uint32_t(((1ull << (Shift + 31)) + Freq - 1) / Freq);
+		Symbol.RcpShift = uint16_t(Shift - 1);
+		Symbol.Bias = Start;
+	}
+}
+
+inline void EncPut(uint32_t& State, uint8_t*& Ptr, const FRansEncSymbol& Symbol)
+{
+	uint32_t X = State;
+	while (X >= Symbol.MaxState)
+	{
+		*--Ptr = uint8_t(X);
+		X >>= 8;
+	}
+
+	const uint32_t Q = uint32_t((uint64_t(X) * Symbol.RcpFreq) >> 32) >> Symbol.RcpShift;
+	State = X + Symbol.Bias + Q * Symbol.CmplFreq;
+}
+
+inline void EncFlush(uint32_t State, uint8_t*& Ptr)
+{
+	Ptr -= 4;
+	Ptr[0] = uint8_t(State);
+	Ptr[1] = uint8_t(State >> 8);
+	Ptr[2] = uint8_t(State >> 16);
+	Ptr[3] = uint8_t(State >> 24);
+}
+
+/** Scales a histogram to frequencies summing to ProbScale, keeping every present symbol at 1 or more. */
+void NormalizeFrequencies(const uint64_t (&Counts)[256], uint64_t Total, uint32_t (&OutFreqs)[256])
+{
+	uint32_t Sum = 0;
+	uint32_t Largest = 0;
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		uint32_t Freq = uint32_t((Counts[Symbol] * ProbScale) / Total);
+		if (Counts[Symbol] && Freq == 0)
+		{
+			Freq = 1;
+		}
+		OutFreqs[Symbol] = Freq;
+		Sum += Freq;
+		if (Freq > OutFreqs[Largest])
+		{
+			Largest = Symbol;
+		}
+	}
+
+	if (Sum <= ProbScale)
+	{
+		OutFreqs[Largest] += ProbScale - Sum;
+		return;
+	}
+
+	// Rounding rare symbols up overshot, take it back from the most frequent ones.
+	while (Sum > ProbScale)
+	{
+		uint32_t Max = 0;
+		for (uint32_t Symbol = 1; Symbol < 256; Symbol++)
+		{
+			if (OutFreqs[Symbol] > OutFreqs[Max])
+			{
+				Max = Symbol;
+			}
+		}
+		const uint32_t Take = std::min(Sum - ProbScale, OutFreqs[Max] / 2);
+		OutFreqs[Max] -= Take;
+		Sum -= Take;
+	}
+}
+
+uint64_t StorePlane(const uint8_t* Plane, uint64_t Size, uint8_t* Out)
+{
+	FPlaneHeader Header = {};
+	Header.Mode = uint8_t(EPlaneMode::Stored);
+	Header.Size = uint32_t(Size);
+	memcpy(Out, &Header, sizeof(Header));
+	memcpy(Out + sizeof(Header), Plane, Size);
+	return sizeof(Header) + Size;
+}
+
+/** Writes one plane as stored, constant or rANS coded and returns the bytes used. */
+uint64_t EncodePlane(const uint8_t* Plane, uint64_t Size, uint8_t* Out, std::vector<uint8_t>& Scratch)
+{
+	FPlaneHeader Header = {};
+
+	// Four sub-histograms avoid the store-to-load stall of consecutive equal bytes.
+	uint32_t Counts[NumStates][256] = {};
+	uint64_t Index = 0;
+	for (; Index + 8 <= Size; Index += 8)
+	{
+		uint64_t Word;
+		memcpy(&Word, Plane + Index, sizeof(Word));
+		Counts[0][uint8_t(Word)]++;
+		Counts[1][uint8_t(Word >> 8)]++;
+		Counts[2][uint8_t(Word >> 16)]++;
+		Counts[3][uint8_t(Word >> 24)]++;
+		Counts[0][uint8_t(Word >> 32)]++;
+		Counts[1][uint8_t(Word >> 40)]++;
+		Counts[2][uint8_t(Word >> 48)]++;
+		Counts[3][uint8_t(Word >> 56)]++;
+	}
+	for (; Index < Size; Index++)
+	{
+		Counts[0][Plane[Index]]++;
+	}
+
+	uint64_t Histogram[256];
+	uint32_t NumUsed = 0;
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		Histogram[Symbol] = uint64_t(Counts[0][Symbol]) + Counts[1][Symbol] + Counts[2][Symbol] + Counts[3][Symbol];
+		NumUsed += Histogram[Symbol] ? 1 : 0;
+	}
+
+	if (NumUsed <= 1)
+	{
+		Header.Mode = uint8_t(EPlaneMode::Constant);
+		Header.Value = Size ? Plane[0] : 0;
+		memcpy(Out, &Header, sizeof(Header));
+		return sizeof(Header);
+	}
+
+	uint32_t Freqs[256];
+	NormalizeFrequencies(Histogram, Size, Freqs);
+
+	// The coder lands within a few bytes of the cost of the frequencies, so a plane that cannot shrink is stored
+	// without running it.
+	double CodedBits = 0.0;
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		if (Histogram[Symbol])
+		{
+			CodedBits += double(Histogram[Symbol]) * (double(ProbBits) - std::log2(double(Freqs[Symbol])));
+		}
+	}
+	const bool bCannotShrink = FrequencyTableSize + 4 * NumStates + uint64_t(CodedBits / 8.0) >= Size;
+
+	if (bCannotShrink)
+	{
+		return StorePlane(Plane, Size, Out);
+	}
+
+	FRansEncSymbol Symbols[256];
+	uint32_t Start = 0;
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		InitEncSymbol(Symbols[Symbol], Start, std::max<uint32_t>(Freqs[Symbol], 1));
+		Start += Freqs[Symbol];
+	}
+
+	// rANS emits backwards, so the stream is built at the end of the scratch buffer.
+	Scratch.resize(Size + Size / 2 + 64);
+	uint8_t* const End = Scratch.data() + Scratch.size();
+	uint8_t* Ptr = End;
+
+	// Symbol i belongs to state i % 4. The tail is encoded first since the decoder reads it last.
+	uint32_t State0 = RansLow;
+	uint32_t State1 = RansLow;
+	uint32_t State2 = RansLow;
+	uint32_t State3 = RansLow;
+	uint64_t Symbol = Size;
+	for (; Symbol & (NumStates - 1); Symbol--)
+	{
+		uint32_t* const States[NumStates] = { &State0, &State1, &State2, &State3 };
+		EncPut(*States[(Symbol - 1) & (NumStates - 1)], Ptr, Symbols[Plane[Symbol - 1]]);
+	}
+	for (; Symbol > 0; Symbol -= NumStates)
+	{
+		EncPut(State3, Ptr, Symbols[Plane[Symbol - 1]]);
+		EncPut(State2, Ptr, Symbols[Plane[Symbol - 2]]);
+		EncPut(State1, Ptr, Symbols[Plane[Symbol - 3]]);
+		EncPut(State0, Ptr, Symbols[Plane[Symbol - 4]]);
+	}
+	EncFlush(State3, Ptr);
+	EncFlush(State2, Ptr);
+	EncFlush(State1, Ptr);
+	EncFlush(State0, Ptr);
+
+	const uint64_t StreamSize = uint64_t(End - Ptr);
+	if (FrequencyTableSize + StreamSize >= Size)
+	{
+		return StorePlane(Plane, Size, Out);
+	}
+
+	Header.Mode = uint8_t(EPlaneMode::Rans);
+	Header.Size = uint32_t(FrequencyTableSize + StreamSize);
+	memcpy(Out, &Header, sizeof(Header));
+
+	uint16_t Table[256];
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		Table[Symbol] = uint16_t(Freqs[Symbol]);
+	}
+	memcpy(Out + sizeof(Header), Table, FrequencyTableSize);
+	memcpy(Out + sizeof(Header) + FrequencyTableSize, Ptr, StreamSize);
+	return sizeof(Header) + Header.Size;
+}
+
+bool DecodePlane(const uint8_t* Data, uint64_t Available, uint8_t* Plane, uint64_t Size, uint64_t& OutConsumed)
+{
+	FPlaneHeader Header;
+	if (Available < sizeof(Header))
+	{
+		return false;
+	}
+	memcpy(&Header, Data, sizeof(Header));
+	Data += sizeof(Header);
+	Available -= sizeof(Header);
+
+	if (Header.Mode == uint8_t(EPlaneMode::Constant))
+	{
+		memset(Plane, Header.Value, Size);
+		OutConsumed = sizeof(Header);
+		return true;
+	}
+
+	if (Header.Size > Available)
+	{
+		return false;
+	}
+	OutConsumed = sizeof(Header) + Header.Size;
+
+	if (Header.Mode == uint8_t(EPlaneMode::Stored))
+	{
+		if (Header.Size != Size)
+		{
+			return false;
+		}
+		memcpy(Plane, Data, Size);
+		return true;
+	}
+
+	if (Header.Mode != uint8_t(EPlaneMode::Rans) || Header.Size < FrequencyTableSize + 4 * NumStates)
+	{
+		return false;
+	}
+
+	uint16_t Table[256];
+	memcpy(Table, Data, FrequencyTableSize);
+
+	FRansDecSymbol Symbols[256];
+	uint8_t SlotToSymbol[ProbScale];
+	uint32_t Start = 0;
+	for (uint32_t Symbol = 0; Symbol < 256; Symbol++)
+	{
+		if (Start + Table[Symbol] > ProbScale)
+		{
+			return false;
+		}
+		Symbols[Symbol] = { uint16_t(Start), Table[Symbol] };
+		memset(SlotToSymbol + Start, int(Symbol), Table[Symbol]);
+		Start += Table[Symbol];
+	}
+	if (Start != ProbScale)
+	{
+		return false;
+	}
+
+	const uint8_t* Ptr = Data + FrequencyTableSize;
+	const uint8_t* const End = Data + Header.Size;
+
+	uint32_t States[NumStates];
+	for (uint32_t StateIndex = 0; StateIndex < NumStates; StateIndex++)
+	{
+		States[StateIndex] = uint32_t(Ptr[0]) | (uint32_t(Ptr[1]) << 8) | (uint32_t(Ptr[2]) << 16) | (uint32_t(Ptr[3]) << 24);
+		Ptr += 4;
+	}
+
+	bool bOverrun = false;
+	auto DecodeSymbol = [&](uint32_t& State) -> uint8_t
+	{
+		const uint32_t Slot = State & (ProbScale - 1);
+		const uint8_t Symbol = SlotToSymbol[Slot];
+		State = Symbols[Symbol].Freq * (State >> ProbBits) + Slot - Symbols[Symbol].Start;
+		while (State < RansLow)
+		{
+			// A corrupt stream must not read past the payload; the flag is checked once per plane.
+			bOverrun |= Ptr == End;
+			State = (State << 8) | (Ptr < End ? *Ptr++ : 0);
+		}
+		return Symbol;
+	};
+
+	uint32_t State0 = States[0];
+	uint32_t State1 = States[1];
+	uint32_t State2 = States[2];
+	uint32_t State3 = States[3];
+	uint64_t Index = 0;
+	for (; Index + NumStates <= Size; Index += NumStates)
+	{
+		Plane[Index + 0] = DecodeSymbol(State0);
+		Plane[Index + 1] = DecodeSymbol(State1);
+		Plane[Index + 2] = DecodeSymbol(State2);
+		Plane[Index + 3] = DecodeSymbol(State3);
+	}
+	uint32_t* const Tail[NumStates] = { &State0, &State1, &State2, &State3 };
+	for (; Index < Size; Index++)
+	{
+		Plane[Index] = DecodeSymbol(*Tail[Index & (NumStates - 1)]);
+	}
+	return !bOverrun;
+}
+
+#if CAPTURE_COMPRESS_SSE2
+
+/** Splits the even and odd bytes of 2 * Count registers into Count registers each. */
+template<int Count>
+inline void SplitEvenOdd(const __m128i* In, __m128i* OutEven, __m128i* OutOdd)
+{
+	const __m128i LowMask = _mm_set1_epi16(0x00FF);
+	for (int Index = 0; Index < Count; Index++)
+	{
+		const __m128i A = In[2 * Index];
+		const __m128i B = In[2 * Index + 1];
+		OutEven[Index] = _mm_packus_epi16(_mm_and_si128(A, LowMask), _mm_and_si128(B, LowMask));
+		OutOdd[Index] = _mm_packus_epi16(_mm_srli_epi16(A, 8), _mm_srli_epi16(B, 8));
+	}
+}
+
+/**
+ * Scatters 16 pixels of NumPlanes bytes each, held in NumPlanes registers, into their planes. Every split
+ * halves the byte positions left in a stream, so the planes come out in bit reversed order.
+ */
+template<int NumPlanes>
+inline void StorePlanes(const __m128i* Regs, uint8_t* Dest, uint64_t PlaneStride, uint32_t Plane, uint32_t PlaneStep)
+{
+	if constexpr (NumPlanes == 1)
+	{
+		_mm_storeu_si128((__m128i*)(Dest + Plane * PlaneStride), Regs[0]);
+	}
+	else
+	{
+		__m128i Even[NumPlanes / 2];
+		__m128i Odd[NumPlanes / 2];
+		SplitEvenOdd<NumPlanes / 2>(Regs, Even, Odd);
+		StorePlanes<NumPlanes / 2>(Even, Dest, PlaneStride, Plane, PlaneStep * 2);
+		StorePlanes<NumPlanes / 2>(Odd, Dest, PlaneStride, Plane + PlaneStep, PlaneStep * 2);
+	}
+}
+
+/** Inverse of StorePlanes(). */
+template<int NumPlanes>
+inline void LoadPlanes(const uint8_t* Src, uint64_t PlaneStride, uint32_t Plane, uint32_t PlaneStep, __m128i* Regs)
+{
+	if constexpr (NumPlanes == 1)
+	{
+		Regs[0] = _mm_loadu_si128((const __m128i*)(Src + Plane * PlaneStride));
+	}
+	else
+	{
+		__m128i Even[NumPlanes / 2];
+		__m128i Odd[NumPlanes / 2];
+		LoadPlanes<NumPlanes / 2>(Src, PlaneStride, Plane, PlaneStep * 2, Even);
+		LoadPlanes<NumPlanes / 2>(Src, PlaneStride, Plane + PlaneStep, PlaneStep * 2, Odd);
+		for (int Index = 0; Index < NumPlanes / 2; Index++)
+		{
+			Regs[2 * Index] = _mm_unpacklo_epi8(Even[Index], Odd[Index]);
+			Regs[2 * Index + 1] = _mm_unpackhi_epi8(Even[Index], Odd[Index]);
+		}
+	}
+}
+
+template<int NumPlanes>
+uint32_t ShuffleRowSSE2(const uint8_t* Src, uint32_t Width, uint8_t* Dest, uint64_t PlaneStride)
+{
+	uint32_t X = 0;
+	for (; X + 16 <= Width; X += 16)
+	{
+		__m128i Regs[NumPlanes];
+		for (int Index = 0; Index < NumPlanes; Index++)
+		{
+			Regs[Index] = _mm_loadu_si128((const __m128i*)(Src + X * NumPlanes + Index * 16));
+		}
+		StorePlanes<NumPlanes>(Regs, Dest + X, PlaneStride, 0, 1);
+	}
+	return X;
+}
+
+template<int NumPlanes>
+uint32_t UnshuffleRowSSE2(const uint8_t* Src, uint64_t PlaneStride, uint32_t Width, uint8_t* Dest)
+{
+	uint32_t X = 0;
+	for (; X + 16 <= Width; X += 16)
+	{
+		__m128i Regs[NumPlanes];
+		LoadPlanes<NumPlanes>(Src + X, PlaneStride, 0, 1, Regs);
+		for (int Index = 0; Index < NumPlanes; Index++)
+		{
+			_mm_storeu_si128((__m128i*)(Dest + X * NumPlanes + Index * 16), Regs[Index]);
+		}
+	}
+	return X;
+}
+
+#endif
+
+/** Moves byte k of every pixel of a row to plane k. Plane rows are PlaneStride bytes apart. */
+void ShuffleRow(const uint8_t* Src, uint32_t Width, uint32_t BytesPerPixel, uint8_t* Dest, uint64_t PlaneStride)
+{
+	uint32_t X = 0;
+#if CAPTURE_COMPRESS_SSE2
+	switch (BytesPerPixel)
+	{
+	case 2: X = ShuffleRowSSE2<2>(Src, Width, Dest, PlaneStride); break;
+	case 4: X = ShuffleRowSSE2<4>(Src, Width, Dest, PlaneStride); break;
+	case 8: X = ShuffleRowSSE2<8>(Src, Width, Dest, PlaneStride); break;
+	case 16: X = ShuffleRowSSE2<16>(Src, Width, Dest, PlaneStride); break;
+	default: break;
+	}
+#endif
+
+	for (; X < Width; X++)
+	{
+		for (uint32_t Plane = 0; Plane < BytesPerPixel; Plane++)
+		{
+			Dest[Plane * PlaneStride + X] = Src[X * BytesPerPixel + Plane];
+		}
+	}
+}
+
+void UnshuffleRow(const uint8_t* Src, uint64_t PlaneStride, uint32_t Width, uint32_t BytesPerPixel, uint8_t* Dest)
+{
+	uint32_t X = 0;
+#if CAPTURE_COMPRESS_SSE2
+	switch (BytesPerPixel)
+	{
+	case 2: X = UnshuffleRowSSE2<2>(Src, PlaneStride, Width, Dest); break;
+	case 4: X = UnshuffleRowSSE2<4>(Src, PlaneStride, Width, Dest); break;
+	case 8: X = UnshuffleRowSSE2<8>(Src, PlaneStride, Width, Dest); break;
+	case 16: X = UnshuffleRowSSE2<16>(Src, PlaneStride, Width, Dest); break;
+	default: break;
+	}
+#endif
+
+	for (; X < Width; X++)
+	{
+		for (uint32_t Plane = 0; Plane < BytesPerPixel; Plane++)
+		{
+			Dest[X * BytesPerPixel + Plane] = Src[Plane * PlaneStride + X];
+		}
+	}
+}
+
+/** Row -= Above, byte wise and wrapping. */
+void SubtractRow(uint8_t* Row, const uint8_t* Above, uint32_t Width)
+{
+	uint32_t X = 0;
+#if CAPTURE_COMPRESS_SSE2
+	for (; X + 16 <= Width; X += 16)
+	{
+		const __m128i Value = _mm_loadu_si128((const __m128i*)(Row + X));
+		_mm_storeu_si128((__m128i*)(Row + X), _mm_sub_epi8(Value, _mm_loadu_si128((const __m128i*)(Above + X))));
+	}
+#endif
+	for (; X < Width; X++)
+	{
+		Row[X] = uint8_t(Row[X] - Above[X]);
+	}
+}
+
+void AddRow(uint8_t* Row, const uint8_t* Above, uint32_t Width)
+{
+	uint32_t X = 0;
+#if CAPTURE_COMPRESS_SSE2
+	for (; X + 16 <= Width; X += 16)
+	{
+		const __m128i Value = _mm_loadu_si128((const __m128i*)(Row + X));
+		_mm_storeu_si128((__m128i*)(Row + X), _mm_add_epi8(Value, _mm_loadu_si128((const __m128i*)(Above + X))));
+	}
+#endif
+	for (; X < Width; X++)
+	{
+		Row[X] = uint8_t(Row[X] + Above[X]);
+	}
+}
+
+/** Plane buffer and rANS stream scratch, reused by every layer a writer thread encodes. */
+struct FCodecScratch
+{
+	std::vector<uint8_t> Planes;
+	std::vector<uint8_t> Stream;
+};
+
+FCodecScratch& GetScratch()
+{
+	thread_local FCodecScratch Scratch;
+	return Scratch;
+}
+
+} //! namespace
+
+uint64_t GetCaptureEncodedBound(int32_t Width, int32_t Height, uint32_t BytesPerPixel)
+{
+	const uint64_t PlaneSize = uint64_t(Width) * uint64_t(Height);
+	return sizeof(FPayloadHeader) + BytesPerPixel * (sizeof(FPlaneHeader) + PlaneSize);
+}
+
+bool EncodeCapturePayload(const uint8_t* Data, int32_t Width, int32_t Height, uint32_t BytesPerPixel, std::vector<uint8_t>& Out)
+{
+	CAPTURE_TRACE_SCOPE("Capture.Compress");
+	if (Width <= 0 || Height <= 0 || BytesPerPixel == 0)
+	{
+		return false;
+	}
+
+	FCodecScratch& Scratch = GetScratch();
+	const uint64_t PlaneSize = uint64_t(Width) * uint64_t(Height);
+	const uint64_t RowPitch = uint64_t(Width) * BytesPerPixel;
+	Scratch.Planes.resize(PlaneSize * BytesPerPixel);
+
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		ShuffleRow(Data + Y * RowPitch, uint32_t(Width), BytesPerPixel, Scratch.Planes.data() + uint64_t(Y) * Width, PlaneSize);
+	}
+
+	// Bottom up so every row is differenced against the original row above it.
+	for (uint32_t Plane = 0; Plane < BytesPerPixel; Plane++)
+	{
+		uint8_t* PlaneData = Scratch.Planes.data() + Plane * PlaneSize;
+		for (int32_t Y = Height - 1; Y > 0; Y--)
+		{
+			SubtractRow(PlaneData + uint64_t(Y) * Width, PlaneData + uint64_t(Y - 1) * Width, uint32_t(Width));
+		}
+	}
+
+	Out.resize(GetCaptureEncodedBound(Width, Height, BytesPerPixel));
+
+	FPayloadHeader Header;
+	Header.Magic = PayloadMagic;
+	Header.NumPlanes = BytesPerPixel;
+	Header.PlaneSize = PlaneSize;
+	memcpy(Out.data(), &Header, sizeof(Header));
+
+	uint64_t Offset = sizeof(Header);
+	for (uint32_t Plane = 0; Plane < BytesPerPixel; Plane++)
+	{
+		Offset += EncodePlane(Scratch.Planes.data() + Plane * PlaneSize, PlaneSize, Out.data() + Offset, Scratch.Stream);
+	}
+
+	Out.resize(Offset);
+	return true;
+}
+
+bool DecodeCapturePayload(const uint8_t* Data, uint64_t Size, int32_t Width, int32_t Height, uint32_t BytesPerPixel, uint8_t* Out)
+{
+	FPayloadHeader Header;
+	if (Width <= 0 || Height <= 0 || Size < sizeof(Header))
+	{
+		return false;
+	}
+
+	memcpy(&Header, Data, sizeof(Header));
+	const uint64_t PlaneSize = uint64_t(Width) * uint64_t(Height);
+	if (Header.Magic != PayloadMagic || Header.NumPlanes != BytesPerPixel || Header.PlaneSize != PlaneSize)
+	{
+		return false;
+	}
+
+	FCodecScratch& Scratch = GetScratch();
+	Scratch.Planes.resize(PlaneSize * BytesPerPixel);
+
+	uint64_t Offset = sizeof(Header);
+	for (uint32_t Plane = 0; Plane < BytesPerPixel; Plane++)
+	{
+		uint8_t* PlaneData = Scratch.Planes.data() + Plane * PlaneSize;
+
+		uint64_t Consumed = 0;
+		if (!DecodePlane(Data + Offset, Size - Offset, PlaneData, PlaneSize, Consumed))
+		{
+			return false;
+		}
+		Offset += Consumed;
+
+		for (int32_t Y = 1; Y < Height; Y++)
+		{
+			AddRow(PlaneData + uint64_t(Y) * Width, PlaneData + uint64_t(Y - 1) * Width, uint32_t(Width));
+		}
+	}
+
+	const uint64_t RowPitch = uint64_t(Width) * BytesPerPixel;
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		UnshuffleRow(Scratch.Planes.data() + uint64_t(Y) * Width, PlaneSize, uint32_t(Width), BytesPerPixel, Out + Y * RowPitch);
+	}
+	return true;
+}
+
+FCaptureCompressionGovernor::FCaptureCompressionGovernor(uint32_t InNumWriters, double InWindowSeconds, double InHeadroom)
+	: NumWriters(std::max(InNumWriters, 1u))
+	, WindowSeconds(InWindowSeconds)
+	, Headroom(InHeadroom)
+{
+}
+
+bool FCaptureCompressionGovernor::Admit(uint64_t RawBytes, std::chrono::steady_clock::time_point ArrivalTime)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	if (!bWindowStarted)
+	{
+		bWindowStarted = true;
+		WindowStart = ArrivalTime;
+	}
+	WindowArrivedBytes += RawBytes;
+	WindowMaxWaitSeconds = std::max(WindowMaxWaitSeconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - ArrivalTime).count());
+
+	const double Elapsed = std::chrono::duration<double>(ArrivalTime - WindowStart).count();
+	if (Elapsed >= WindowSeconds)
+	{
+		if (WindowEncodeSeconds > 0.0)
+		{
+			EncodeBytesPerSecond = double(WindowEncodedBytes) / WindowEncodeSeconds;
+		}
+		const double ArrivalBytesPerSecond = double(WindowArrivedBytes) / Elapsed;
+		const double Capacity = EncodeBytesPerSecond * NumWriters * Headroom;
+		const double Sustainable = Capacity > 0.0 ? std::min(Capacity / ArrivalBytesPerSecond, 1.0) : 1.0;
+
+		// A backlog means the writers are short of time the encode rate cannot show (the disk, other threads on
+		// their cores), and also holds back the arrivals, so the share is halved instead and only grows back once
+		// the queue is drained.
+		Share = WindowMaxWaitSeconds > WindowSeconds ? 0.5 * Share : std::min(Share + RecoverStep, Sustainable);
+
+		WindowStart = ArrivalTime;
+		WindowArrivedBytes = 0;
+		WindowEncodedBytes = 0;
+		WindowEncodeSeconds = 0.0;
+		WindowMaxWaitSeconds = 0.0;
+	}
+
+	// Every layer earns its share of its bytes as credit and is encoded while the credit is not in debt, which costs
+	// all of its bytes, so the encoded bytes follow the share whatever the mix of layer sizes.
+	Credit = std::min(Credit + Share * double(RawBytes), double(RawBytes));
+	if (Credit < 0.0)
+	{
+		NumBypassed++;
+		return false;
+	}
+	Credit -= double(RawBytes);
+	NumAdmitted++;
+	return true;
+}
+
+void FCaptureCompressionGovernor::AddEncode(uint64_t RawBytes, double Seconds)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	WindowEncodedBytes += RawBytes;
+	WindowEncodeSeconds += Seconds;
+}
+
+double FCaptureCompressionGovernor::GetShare() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return Share;
+}
+
+uint64_t FCaptureCompressionGovernor::GetNumAdmitted() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return NumAdmitted;
+}
+
+uint64_t FCaptureCompressionGovernor::GetNumBypassed() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return NumBypassed;
+}
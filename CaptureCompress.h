@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Lossless codec for captured layers (ECaptureCodec::ShuffleDeltaRans).
+ *
+ * Every byte of a pixel goes to its own plane, so the high bytes of half floats (sign, exponent, top of the
+ * mantissa) end up next to each other instead of interleaved with noisy low bytes. Each plane row is then
+ * replaced by its difference to the row above, and every plane is entropy coded on its own with an order-0
+ * rANS coder running four interleaved states. Planes that do not shrink are stored.
+ *
+ * The shuffle and the row delta use SSE2 when available. Encoding is meant to run on the capture writer
+ * threads; all scratch memory is thread local. Planes whose histogram says they cannot shrink are stored without
+ * running the coder.
+ *
+ * The coder is scalar and encodes 0.1 to 0.2 GB/s per thread, about a fifth of what a 60 fps 720p capture needs
+ * from two writers. FCaptureCompressionGovernor keeps the capture rate by storing the rest raw; it does not make
+ * the codec any faster.
+ */
+
+/** Largest output EncodeCapturePayload() may produce for a Width x Height layer. */
+uint64_t GetCaptureEncodedBound(int32_t Width, int32_t Height, uint32_t BytesPerPixel);
+
+/** Encodes Height tightly packed rows of Width * BytesPerPixel bytes into Out, replacing its contents. */
+bool EncodeCapturePayload(const uint8_t* Data, int32_t Width, int32_t Height, uint32_t BytesPerPixel, std::vector<uint8_t>& Out);
+
+/** Decodes a payload written by EncodeCapturePayload(). Out must hold Width * Height * BytesPerPixel bytes. */
+bool DecodeCapturePayload(const uint8_t* Data, uint64_t Size, int32_t Width, int32_t Height, uint32_t BytesPerPixel, uint8_t* Out);
+
+/**
+ * Keeps the compression stage from making the writers fall behind the capture. Once per window it compares the
+ * rate raw bytes arrive at, taken from the jobs' enqueue times, with the rate the writer pool can encode at, the
+ * measured bytes per second of encode time times the number of writers. When the pool cannot keep up, only the
+ * share of the arriving bytes it can encode with Headroom to spare is let through and the other layers are
+ * stored raw. A job that waited in the queue longer than a window halves the share, whatever the rates say; the
+ * share then grows back by RecoverStep per window while the queue stays drained. Thread safe.
+ */
+class FCaptureCompressionGovernor
+{
+public:
+	explicit FCaptureCompressionGovernor(uint32_t InNumWriters, double InWindowSeconds = 0.5, double InHeadroom = 0.8);
+
+	/** Called by a writer for every layer it may encode. Returns false when the layer should be stored raw instead. */
+	bool Admit(uint64_t RawBytes, std::chrono::steady_clock::time_point ArrivalTime);
+
+	/** Reports the encode of a layer Admit() let through. */
+	void AddEncode(uint64_t RawBytes, double Seconds);
+
+	/** Share of the arriving bytes currently encoded, 1 while the writers keep up. */
+	double GetShare() const;
+
+	uint64_t GetNumAdmitted() const;
+	uint64_t GetNumBypassed() const;
+
+private:
+	static constexpr double RecoverStep = 0.0625;
+
+	const uint32_t NumWriters;
+	const double WindowSeconds;
+	const double Headroom;
+
+	mutable std::mutex Mutex;
+	double Share = 1.0;
+	double Credit = 0.0;
+	double EncodeBytesPerSecond = 0.0;
+
+	bool bWindowStarted = false;
+	std::chrono::steady_clock::time_point WindowStart;
+	uint64_t WindowArrivedBytes = 0;
+	uint64_t WindowEncodedBytes = 0;
+	double WindowEncodeSeconds = 0.0;
+	double WindowMaxWaitSeconds = 0.0;
+
+	uint64_t NumAdmitted = 0;
+	uint64_t NumBypassed = 0;
+};
@@ -0,0 +1,709 @@
+#include "CaptureContainer.h"
+
+#include "CaptureTrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+
+/** Layers are packed into the lookup key next to the frame id. */
+constexpr uint32_t MaxCaptureLayers = 256;
+
+uint64_t MakeLookupKey(uint64_t FrameId, uint32_t LayerIndex)
+{
+	return FrameId * MaxCaptureLayers + LayerIndex;
+}
+
+void CopyLayerName(char (&Dest)[CaptureLayerNameSize], const char* Name)
+{
+	memset(Dest, 0, sizeof(Dest));
+	memcpy(Dest, Name, std::min<size_t>(strlen(Name), CaptureLayerNameSize - 1));
+}
+
+FCaptureChunkHeader MakeChunkHeader(
+	uint64_t FrameId,
+	const char* Layer,
+	int32_t Width,
+	int32_t Height,
+	uint32_t PixelFormat,
+	uint32_t BytesPerPixel,
+	uint64_t Size,
+	ECaptureCodec Codec,
+	uint64_t RawSize)
+{
+	FCaptureChunkHeader Chunk = {};
+	Chunk.Magic = CaptureChunkMagic;
+	Chunk.FrameId = FrameId;
+	Chunk.Width = Width;
+	Chunk.Height = Height;
+	Chunk.PixelFormat = PixelFormat;
+	Chunk.BytesPerPixel = BytesPerPixel;
+	Chunk.RowPitch = uint32_t(Width) * BytesPerPixel;
+	Chunk.Codec = uint16_t(Codec);
+	Chunk.PayloadSize = Size;
+	Chunk.RawSize = Codec == ECaptureCodec::Raw ? Size : RawSize;
+	CopyLayerName(Chunk.Layer, Layer ? Layer : "");
+	return Chunk;
+}
+
+} //! namespace
+
+FCaptureContainerWriter::~FCaptureContainerWriter()
+{
+	Close();
+}
+
+bool FCaptureContainerWriter::IsOpen() const
+{
+	return Handle != -1;
+}
+
+bool FCaptureContainerWriter::Open(const std::string& InPath, bool bOverwrite)
+{
+	Close();
+	CAPTURE_TRACE_SCOPE("Capture.Open");
+
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(InPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, bOverwrite ? CREATE_ALWAYS : CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	Handle = intptr_t(File);
+#else
+	const int File = open(InPath.c_str(), O_WRONLY | O_CREAT | (bOverwrite ? O_TRUNC : O_EXCL), 0644);
+	if (File < 0)
+	{
+		return false;
+	}
+	Handle = File;
+#endif
+
+	Path = InPath;
+	NextOffset = CaptureContainerAlignment;
+	Layers.clear();
+	Index.clear();
+	Frames.clear();
+
+	// Page 0 is written up front so a session that is never closed still starts with a valid header.
+	std::vector<uint8_t> Page(CaptureContainerAlignment, 0);
+	FCaptureContainerHeader Header = {};
+	Header.Magic = CaptureContainerMagic;
+	Header.Version = CaptureContainerVersion;
+	Header.Alignment = CaptureContainerAlignment;
+	memcpy(Page.data(), &Header, sizeof(Header));
+	return WriteAt(0, Page.data(), Page.size());
+}
+
+bool FCaptureContainerWriter::Close()
+{
+	if (!IsOpen())
+	{
+		return false;
+	}
+
+	CAPTURE_TRACE_SCOPE("Capture.Finalize");
+	bool bSucceeded = true;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		uint64_t TablesEnd = 0;
+		bSucceeded &= WriteTables(NextOffset, 0, TablesEnd);
+	}
+
+	{
+		// A finalized container survives a crash or power loss right after the session.
+		CAPTURE_TRACE_SCOPE("Capture.Fsync");
+#if defined(_WIN32)
+		bSucceeded &= FlushFileBuffers(HANDLE(Handle)) != 0;
+#else
+		bSucceeded &= fsync(int(Handle)) == 0;
+#endif
+	}
+
+#if defined(_WIN32)
+	CloseHandle(HANDLE(Handle));
+#else
+	close(int(Handle));
+#endif
+	Handle = -1;
+	return bSucceeded;
+}
+
+bool FCaptureContainerWriter::Flush()
+{
+	if (!IsOpen())
+	{
+		return false;
+	}
+
+	CAPTURE_TRACE_SCOPE("Capture.Finalize");
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	// The tables page lets a rebuilt index step over the tables to the records appended after them.
+	const uint64_t PageOffset = NextOffset;
+	uint64_t TablesEnd = 0;
+	if (!WriteTables(PageOffset + CaptureContainerAlignment, CaptureContainer_Flushed, TablesEnd))
+	{
+		return false;
+	}
+	NextOffset = AlignCaptureOffset(TablesEnd);
+
+	std::vector<uint8_t> Page(CaptureContainerAlignment, 0);
+	FCaptureTablesPage Tables = {};
+	Tables.Magic = CaptureTablesMagic;
+	Tables.Size = NextOffset - PageOffset;
+	memcpy(Page.data(), &Tables, sizeof(Tables));
+	return WriteAt(PageOffset, Page.data(), Page.size());
+}
+
+bool FCaptureContainerWriter::Append(
+	uint64_t FrameId,
+	const std::string& Layer,
+	int32_t Width,
+	int32_t Height,
+	uint32_t PixelFormat,
+	uint32_t BytesPerPixel,
+	const void* Data,
+	uint64_t Size,
+	ECaptureCodec Codec,
+	uint64_t RawSize)
+{
+	if (!IsOpen())
+	{
+		return false;
+	}
+
+	CAPTURE_TRACE_SCOPE("Capture.Write");
+	FCaptureChunkHeader Chunk = MakeChunkHeader(FrameId, Layer.c_str(), Width, Height, PixelFormat, BytesPerPixel, Size, Codec, RawSize);
+
+	uint64_t ChunkOffset = 0;
+	{
+		// Only the offset reservation is serialized, the payload writes of concurrent appends overlap.
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		ChunkOffset = NextOffset;
+		if (!ReserveChunk(Chunk))
+		{
+			return false;
+		}
+	}
+
+	return WriteChunk(Chunk, ChunkOffset, Data);
+}
+
+bool FCaptureContainerWriter::AppendFrame(const FCaptureFrameInfo& Info, const FCaptureLayerPayload* Payloads, uint32_t NumPayloads)
+{
+	if (!IsOpen())
+	{
+		return false;
+	}
+
+	CAPTURE_TRACE_SCOPE("Capture.Write");
+	FCaptureFrameInfo Frame = Info;
+	Frame.Magic = CaptureFrameMagic;
+	Frame.NumLayers = NumPayloads;
+
+	std::vector<FCaptureChunkHeader> Chunks(NumPayloads);
+	std::vector<uint64_t> ChunkOffsets(NumPayloads);
+	for (uint32_t PayloadIndex = 0; PayloadIndex < NumPayloads; PayloadIndex++)
+	{
+		const FCaptureLayerPayload& Payload = Payloads[PayloadIndex];
+		Chunks[PayloadIndex] = MakeChunkHeader(Info.FrameId, Payload.Layer, Payload.Width, Payload.Height, Payload.PixelFormat,
+			Payload.BytesPerPixel, Payload.Size, Payload.Codec, Payload.RawSize);
+	}
+
+	uint64_t FrameOffset = 0;
+	{
+		// The whole bundle is reserved at once so its pages are contiguous behind the frame page.
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		const uint64_t PrevNextOffset = NextOffset;
+		const size_t PrevIndexSize = Index.size();
+
+		FrameOffset = NextOffset;
+		NextOffset += CaptureContainerAlignment;
+		for (uint32_t ChunkIndex = 0; ChunkIndex < NumPayloads; ChunkIndex++)
+		{
+			ChunkOffsets[ChunkIndex] = NextOffset;
+			if (!ReserveChunk(Chunks[ChunkIndex]))
+			{
+				NextOffset = PrevNextOffset;
+				Index.resize(PrevIndexSize);
+				return false;
+			}
+		}
+		Frames.push_back(Frame);
+	}
+
+	bool bSucceeded = true;
+	for (uint32_t ChunkIndex = 0; ChunkIndex < NumPayloads; ChunkIndex++)
+	{
+		bSucceeded &= WriteChunk(Chunks[ChunkIndex], ChunkOffsets[ChunkIndex], Payloads[ChunkIndex].Data);
+	}
+
+	// Written last: until the frame page lands, recovery stops in front of the bundle instead of exposing part of it.
+	static const uint8_t Zeros[CaptureContainerAlignment] = {};
+	return bSucceeded &&
+		WriteAt(FrameOffset + sizeof(Frame), Zeros, CaptureContainerAlignment - sizeof(Frame)) &&
+		WriteAt(FrameOffset, &Frame, sizeof(Frame));
+}
+
+bool FCaptureContainerWriter::WriteTables(uint64_t TablesOffset, uint32_t Flags, uint64_t& OutEnd)
+{
+	FCaptureContainerHeader Header = {};
+	Header.Magic = CaptureContainerMagic;
+	Header.Version = CaptureContainerVersion;
+	Header.Alignment = CaptureContainerAlignment;
+	Header.Flags = Flags;
+	Header.LayerTableOffset = TablesOffset;
+	Header.LayerCount = uint32_t(Layers.size());
+	Header.IndexOffset = AlignCaptureOffset(Header.LayerTableOffset + Layers.size() * sizeof(FCaptureLayerDesc));
+	Header.IndexCount = Index.size();
+	Header.FrameTableOffset = Frames.empty() ? 0 : AlignCaptureOffset(Header.IndexOffset + Index.size() * sizeof(FCaptureChunkHeader));
+	Header.FrameCount = Frames.size();
+	OutEnd = Frames.empty() ? Header.IndexOffset + Index.size() * sizeof(FCaptureChunkHeader)
+		: Header.FrameTableOffset + Frames.size() * sizeof(FCaptureFrameInfo);
+
+	// Records land in whatever order the writer threads finish; the index is kept in frame order.
+	std::stable_sort(Index.begin(), Index.end(), [](const FCaptureChunkHeader& A, const FCaptureChunkHeader& B)
+	{
+		return A.FrameId < B.FrameId;
+	});
+	std::stable_sort(Frames.begin(), Frames.end(), [](const FCaptureFrameInfo& A, const FCaptureFrameInfo& B)
+	{
+		return A.FrameId < B.FrameId;
+	});
+
+	// The header goes last, so a reader never follows it to tables that are not there yet.
+	bool bSucceeded = true;
+	bSucceeded &= Layers.empty() || WriteAt(Header.LayerTableOffset, Layers.data(), Layers.size() * sizeof(FCaptureLayerDesc));
+	bSucceeded &= Index.empty() || WriteAt(Header.IndexOffset, Index.data(), Index.size() * sizeof(FCaptureChunkHeader));
+	bSucceeded &= Frames.empty() || WriteAt(Header.FrameTableOffset, Frames.data(), Frames.size() * sizeof(FCaptureFrameInfo));
+	return bSucceeded && WriteAt(0, &Header, sizeof(Header));
+}
+
+bool FCaptureContainerWriter::ReserveChunk(FCaptureChunkHeader& Chunk)
+{
+	uint32_t LayerIndex = 0;
+	while (LayerIndex < Layers.size() && strncmp(Layers[LayerIndex].Name, Chunk.Layer, CaptureLayerNameSize) != 0)
+	{
+		LayerIndex++;
+	}
+	if (LayerIndex == Layers.size())
+	{
+		if (Layers.size() == MaxCaptureLayers)
+		{
+			return false;
+		}
+
+		FCaptureLayerDesc Desc = {};
+		memcpy(Desc.Name, Chunk.Layer, CaptureLayerNameSize);
+		Desc.PixelFormat = Chunk.PixelFormat;
+		Desc.BytesPerPixel = Chunk.BytesPerPixel;
+		Desc.Width = Chunk.Width;
+		Desc.Height = Chunk.Height;
+		Layers.push_back(Desc);
+	}
+
+	Chunk.LayerIndex = LayerIndex;
+	Chunk.PayloadOffset = NextOffset + CaptureContainerAlignment;
+	NextOffset = AlignCaptureOffset(Chunk.PayloadOffset + Chunk.PayloadSize);
+	Index.push_back(Chunk);
+	return true;
+}
+
+bool FCaptureContainerWriter::WriteChunk(const FCaptureChunkHeader& Chunk, uint64_t ChunkOffset, const void* Data)
+{
+	static const uint8_t Zeros[CaptureContainerAlignment] = {};
+
+	// The tail is padded too so the next chunk header never has to be read past a short file.
+	const uint64_t Size = Chunk.PayloadSize;
+	const uint64_t Padding = AlignCaptureOffset(Size) - Size;
+	return WriteAt(ChunkOffset, &Chunk, sizeof(Chunk)) &&
+		WriteAt(ChunkOffset + sizeof(Chunk), Zeros, CaptureContainerAlignment - sizeof(Chunk)) &&
+		WriteAt(Chunk.PayloadOffset, Data, Size) &&
+		(Padding == 0 || WriteAt(Chunk.PayloadOffset + Size, Zeros, Padding));
+}
+
+bool FCaptureContainerWriter::WriteAt(uint64_t Offset, const void* Data, uint64_t Size)
+{
+	const uint8_t* Bytes = (const uint8_t*)Data;
+	while (Size > 0)
+	{
+		const uint32_t ChunkSize = uint32_t(std::min<uint64_t>(Size, 1u << 30));
+
+#if defined(_WIN32)
+		OVERLAPPED Overlapped = {};
+		Overlapped.Offset = DWORD(Offset);
+		Overlapped.OffsetHigh = DWORD(Offset >> 32);
+		DWORD Written = 0;
+		if (!WriteFile(HANDLE(Handle), Bytes, ChunkSize, &Written, &Overlapped) || Written == 0)
+		{
+			return false;
+		}
+#else
+		const ssize_t Written = pwrite(int(Handle), Bytes, ChunkSize, off_t(Offset));
+		if (Written <= 0)
+		{
+			return false;
+		}
+#endif
+
+		Bytes += Written;
+		Offset += Written;
+		Size -= Written;
+	}
+	return true;
+}
+
+bool FCaptureMappedFile::Open(const std::string& Path)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	HANDLE Mapping = nullptr;
+	if (GetFileSizeEx(File, &FileSize) && FileSize.QuadPart > 0)
+	{
+		Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (!Mapping)
+	{
+		CloseHandle(File);
+		return false;
+	}
+
+	Data = (const uint8_t*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	FileHandle = intptr_t(File);
+	MappingHandle = intptr_t(Mapping);
+	Size = uint64_t(FileSize.QuadPart);
+#else
+	const int File = open(Path.c_str(), O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	struct stat Stat;
+	if (fstat(File, &Stat) != 0 || Stat.st_size <= 0)
+	{
+		close(File);
+		return false;
+	}
+
+	void* Mapped = mmap(nullptr, size_t(Stat.st_size), PROT_READ, MAP_SHARED, File, 0);
+	if (Mapped == MAP_FAILED)
+	{
+		close(File);
+		return false;
+	}
+
+	Data = (const uint8_t*)Mapped;
+	FileHandle = File;
+	Size = uint64_t(Stat.st_size);
+#endif
+
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FCaptureMappedFile::Prefetch(uint64_t Offset, uint64_t Length) const
+{
+	if (!Data || Offset >= Size)
+	{
+		return;
+	}
+
+	// Madvise wants a page aligned start.
+	const uint64_t Begin = Offset & ~uint64_t(CaptureContainerAlignment - 1);
+	const uint64_t End = std::min(Offset + Length, Size);
+
+#if defined(_WIN32)
+	WIN32_MEMORY_RANGE_ENTRY Range;
+	Range.VirtualAddress = (PVOID)(Data + Begin);
+	Range.NumberOfBytes = SIZE_T(End - Begin);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+#else
+	madvise((void*)(Data + Begin), size_t(End - Begin), MADV_WILLNEED);
+#endif
+}
+
+void FCaptureMappedFile::Close()
+{
+#if defined(_WIN32)
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (MappingHandle != -1)
+	{
+		CloseHandle(HANDLE(MappingHandle));
+	}
+	if (FileHandle != -1)
+	{
+		CloseHandle(HANDLE(FileHandle));
+	}
+#else
+	if (Data)
+	{
+		munmap((void*)Data, size_t(Size));
+	}
+	if (FileHandle != -1)
+	{
+		close(int(FileHandle));
+	}
+#endif
+
+	Data = nullptr;
+	Size = 0;
+	FileHandle = -1;
+	MappingHandle = -1;
+}
+
+bool FCaptureContainerReader::Open(const std::string& Path)
+{
+	Close();
+
+	if (!File.Open(Path) || File.GetSize() < CaptureContainerAlignment)
+	{
+		Close();
+		return false;
+	}
+
+	FCaptureContainerHeader Header;
+	memcpy(&Header, File.GetData(), sizeof(Header));
+	if (Header.Magic != CaptureContainerMagic || Header.Version > CaptureContainerVersion || Header.Alignment != CaptureContainerAlignment)
+	{
+		Close();
+		return false;
+	}
+
+	// The tables of a flush only cover the records in front of them, the ones appended since are walked from its tables page.
+	const bool bFlushed = Header.IndexOffset != 0 && (Header.Flags & CaptureContainer_Flushed) != 0;
+	bFinalized = Header.IndexOffset != 0 && !bFlushed;
+	bool bIndexed = Header.IndexOffset == 0 || ReadIndex(Header);
+	if (bIndexed && !bFinalized)
+	{
+		bIndexed = RebuildIndex(bFlushed ? std::max<uint64_t>(Header.LayerTableOffset, 2 * CaptureContainerAlignment) - CaptureContainerAlignment
+			: CaptureContainerAlignment);
+	}
+	if (!bIndexed)
+	{
+		Close();
+		return false;
+	}
+
+	BuildLookup();
+	return true;
+}
+
+void FCaptureContainerReader::Close()
+{
+	File.Close();
+	bFinalized = false;
+	Layers.clear();
+	Records.clear();
+	FrameIds.clear();
+	Frames.clear();
+	Lookup.clear();
+}
+
+bool FCaptureContainerReader::ReadIndex(const FCaptureContainerHeader& Header)
+{
+	const uint64_t LayerTableEnd = Header.LayerTableOffset + uint64_t(Header.LayerCount) * sizeof(FCaptureLayerDesc);
+	const uint64_t IndexEnd = Header.IndexOffset + Header.IndexCount * sizeof(FCaptureChunkHeader);
+	const uint64_t FrameTableEnd = Header.FrameTableOffset + Header.FrameCount * sizeof(FCaptureFrameInfo);
+	if (LayerTableEnd > File.GetSize() || IndexEnd > File.GetSize() || FrameTableEnd > File.GetSize() || Header.LayerCount > MaxCaptureLayers)
+	{
+		return false;
+	}
+
+	Frames.resize(size_t(Header.FrameCount));
+	if (!Frames.empty())
+	{
+		memcpy(Frames.data(), File.GetData() + Header.FrameTableOffset, Frames.size() * sizeof(FCaptureFrameInfo));
+	}
+
+	Layers.resize(Header.LayerCount);
+	memcpy(Layers.data(), File.GetData() + Header.LayerTableOffset, Layers.size() * sizeof(FCaptureLayerDesc));
+
+	Records.resize(size_t(Header.IndexCount));
+	memcpy(Records.data(), File.GetData() + Header.IndexOffset, Records.size() * sizeof(FCaptureChunkHeader));
+	return true;
+}
+
+bool FCaptureContainerReader::RebuildIndex(uint64_t Offset)
+{
+	while (Offset + CaptureContainerAlignment <= File.GetSize())
+	{
+		uint32_t Magic;
+		memcpy(&Magic, File.GetData() + Offset, sizeof(Magic));
+		if (Magic == CaptureTablesMagic)
+		{
+			// Tables of a flush in the middle of the session, the records carry on behind them.
+			FCaptureTablesPage Tables;
+			memcpy(&Tables, File.GetData() + Offset, sizeof(Tables));
+			if (Tables.Size < CaptureContainerAlignment || Tables.Size % CaptureContainerAlignment != 0)
+			{
+				break;
+			}
+			Offset += Tables.Size;
+			continue;
+		}
+		if (Magic == CaptureFrameMagic)
+		{
+			// The layers of a committed bundle follow as ordinary records.
+			FCaptureFrameInfo Frame;
+			memcpy(&Frame, File.GetData() + Offset, sizeof(Frame));
+			Frames.push_back(Frame);
+			Offset += CaptureContainerAlignment;
+			continue;
+		}
+
+		FCaptureChunkHeader Chunk;
+		memcpy(&Chunk, File.GetData() + Offset, sizeof(Chunk));
+
+		// Stops at the first hole, i.e. a record whose writer thread had not finished when the session died.
+		if (Chunk.Magic != CaptureChunkMagic || Chunk.PayloadOffset != Offset + CaptureContainerAlignment ||
+			Chunk.PayloadOffset + Chunk.PayloadSize > File.GetSize() || Chunk.LayerIndex >= MaxCaptureLayers)
+		{
+			break;
+		}
+
+		if (Chunk.LayerIndex >= Layers.size())
+		{
+			Layers.resize(Chunk.LayerIndex + 1, FCaptureLayerDesc{});
+		}
+		FCaptureLayerDesc& Desc = Layers[Chunk.LayerIndex];
+		if (Desc.Name[0] == 0)
+		{
+			memcpy(Desc.Name, Chunk.Layer, CaptureLayerNameSize);
+			Desc.PixelFormat = Chunk.PixelFormat;
+			Desc.BytesPerPixel = Chunk.BytesPerPixel;
+			Desc.Width = Chunk.Width;
+			Desc.Height = Chunk.Height;
+		}
+
+		Records.push_back(Chunk);
+		Offset = AlignCaptureOffset(Chunk.PayloadOffset + Chunk.PayloadSize);
+	}
+
+	std::stable_sort(Records.begin(), Records.end(), [](const FCaptureChunkHeader& A, const FCaptureChunkHeader& B)
+	{
+		return A.FrameId < B.FrameId;
+	});
+	std::stable_sort(Frames.begin(), Frames.end(), [](const FCaptureFrameInfo& A, const FCaptureFrameInfo& B)
+	{
+		return A.FrameId < B.FrameId;
+	});
+	return true;
+}
+
+void FCaptureContainerReader::BuildLookup()
+{
+	Lookup.reserve(Records.size());
+	for (uint32_t RecordIndex = 0; RecordIndex < Records.size(); RecordIndex++)
+	{
+		const FCaptureChunkHeader& Record = Records[RecordIndex];
+		Lookup[MakeLookupKey(Record.FrameId, Record.LayerIndex)] = RecordIndex;
+
+		if (FrameIds.empty() || FrameIds.back() != Record.FrameId)
+		{
+			FrameIds.push_back(Record.FrameId);
+		}
+	}
+}
+
+int32_t FCaptureContainerReader::FindLayer(const char* Layer) const
+{
+	for (uint32_t LayerIndex = 0; LayerIndex < Layers.size(); LayerIndex++)
+	{
+		if (strncmp(Layers[LayerIndex].Name, Layer, CaptureLayerNameSize) == 0)
+		{
+			return int32_t(LayerIndex);
+		}
+	}
+	return -1;
+}
+
+const FCaptureFrameInfo* FCaptureContainerReader::FindFrame(uint64_t FrameId) const
+{
+	const auto It = std::lower_bound(Frames.begin(), Frames.end(), FrameId, [](const FCaptureFrameInfo& Frame, uint64_t Id)
+	{
+		return Frame.FrameId < Id;
+	});
+	return It != Frames.end() && It->FrameId == FrameId ? &*It : nullptr;
+}
+
+const FCaptureChunkHeader* FCaptureContainerReader::FindRecord(uint64_t FrameId, uint32_t LayerIndex) const
+{
+	const auto It = Lookup.find(MakeLookupKey(FrameId, LayerIndex));
+	return It != Lookup.end() ? &Records[It->second] : nullptr;
+}
+
+const FCaptureChunkHeader* FCaptureContainerReader::FindRecord(uint64_t FrameId, const char* Layer) const
+{
+	const int32_t LayerIndex = FindLayer(Layer);
+	return LayerIndex >= 0 ? FindRecord(FrameId, uint32_t(LayerIndex)) : nullptr;
+}
+
+const uint8_t* FCaptureContainerReader::GetPayload(const FCaptureChunkHeader& Record) const
+{
+	if (!IsOpen() || Record.PayloadOffset + Record.PayloadSize > File.GetSize())
+	{
+		return nullptr;
+	}
+	return File.GetData() + Record.PayloadOffset;
+}
+
+void FCaptureContainerReader::PrefetchPayload(const FCaptureChunkHeader& Record) const
+{
+	File.Prefetch(Record.PayloadOffset, Record.PayloadSize);
+}
+
+std::string MakeCaptureSessionName()
+{
+	static std::atomic<uint32_t> NumSessions(0);
+	const uint32_t SessionIndex = NumSessions++;
+
+	const std::chrono::system_clock::time_point Now = std::chrono::system_clock::now();
+	const std::time_t Seconds = std::chrono::system_clock::to_time_t(Now);
+	const int32_t Milliseconds = int32_t(std::chrono::duration_cast<std::chrono::milliseconds>(Now.time_since_epoch()).count() % 1000);
+	std::tm Local = {};
+#if defined(_WIN32)
+	localtime_s(&Local, &Seconds);
+#else
+	localtime_r(&Seconds, &Local);
+#endif
+
+	char Name[64];
+	snprintf(Name, sizeof(Name), "%02d_%02d_%02d_%02d_%02d_%03d_%u",
+		Local.tm_mon + 1, Local.tm_mday, Local.tm_hour, Local.tm_min, Local.tm_sec, Milliseconds, SessionIndex);
+	return Name;
+}
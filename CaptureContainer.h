@@ -0,0 +1,324 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Single-file capture container (.ucap).
+ *
+ * Page 0 holds FCaptureContainerHeader. Every layer of every frame is appended as one record: a 4 KiB page
+ * starting with its FCaptureChunkHeader, followed by the payload padded to the next 4 KiB boundary. Closing
+ * the writer appends the layer table and the index (a copy of every chunk header) and patches page 0 to point
+ * at them. A session that was never closed is still readable, the reader rebuilds the index by walking the
+ * chunk headers.
+ *
+ * Version 2 adds frame bundles: a page holding FCaptureFrameInfo followed by the records of every layer of
+ * that frame. The frame page is written after its layers, so a rebuilt index never shows half a frame.
+ * Closing the writer also appends the table of every frame page.
+ *
+ * Flushing the writer appends the same tables behind a tables page and patches page 0 to point at them without
+ * closing the file: readers see every record up to that point while later records keep being appended after the
+ * tables, and walking the chunk headers steps over the tables page. Page 0 is marked as flushed rather than
+ * closed, so a reader also walks on from the tables to the records appended since, e.g. after a crash.
+ */
+
+static constexpr uint32_t CaptureContainerMagic = 0x50414355; // "UCAP"
+static constexpr uint32_t CaptureChunkMagic = 0x4B4E4843; // "CHNK"
+static constexpr uint32_t CaptureFrameMagic = 0x454D5246; // "FRME"
+static constexpr uint32_t CaptureTablesMagic = 0x4C424154; // "TABL"
+static constexpr uint32_t CaptureContainerVersion = 2;
+static constexpr uint32_t CaptureContainerAlignment = 4096;
+static constexpr uint32_t CaptureLayerNameSize = 32;
+
+enum ECaptureContainerFlags : uint32_t
+{
+	/** Page 0 was last written by FCaptureContainerWriter::Flush(), records may follow the tables it points at. */
+	CaptureContainer_Flushed = 1 << 0,
+};
+
+struct FCaptureContainerHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Alignment;
+	uint32_t Flags;
+
+	/** Both are 0 until the writer has been closed. */
+	uint64_t IndexOffset;
+	uint64_t IndexCount;
+	uint64_t LayerTableOffset;
+	uint32_t LayerCount;
+	uint32_t Reserved0;
+
+	/** Table of FCaptureFrameInfo, 0 until the writer has been closed and always 0 in version 1. */
+	uint64_t FrameTableOffset;
+	uint64_t FrameCount;
+
+	uint64_t Reserved[8];
+};
+static_assert(sizeof(FCaptureContainerHeader) == 128, "FCaptureContainerHeader layout is part of the file format.");
+
+struct FCaptureLayerDesc
+{
+	char Name[CaptureLayerNameSize];
+
+	/** EPixelFormat of the source texture. */
+	uint32_t PixelFormat;
+	uint32_t BytesPerPixel;
+
+	/** Extent of the first record of this layer. */
+	int32_t Width;
+	int32_t Height;
+};
+static_assert(sizeof(FCaptureLayerDesc) == 48, "FCaptureLayerDesc layout is part of the file format.");
+
+struct FCaptureChunkHeader
+{
+	uint32_t Magic;
+	uint32_t LayerIndex;
+	uint64_t FrameId;
+
+	int32_t Width;
+	int32_t Height;
+	uint32_t PixelFormat;
+	uint32_t BytesPerPixel;
+
+	/** Distance between rows of the decoded payload in bytes. */
+	uint32_t RowPitch;
+	uint16_t Codec;
+	uint16_t Flags;
+
+	/** Absolute file offset of the payload, always a multiple of CaptureContainerAlignment. */
+	uint64_t PayloadOffset;
+
+	/** Bytes stored in the file, and bytes once decoded. Identical for raw payloads. */
+	uint64_t PayloadSize;
+	uint64_t RawSize;
+
+	char Layer[CaptureLayerNameSize];
+};
+static_assert(sizeof(FCaptureChunkHeader) == 96, "FCaptureChunkHeader layout is part of the file format.");
+
+enum ECaptureFrameFlags : uint32_t
+{
+	CaptureFrame_CameraCut = 1 << 0,
+
+	/** The rate controller shed optional layers (r.Capture.RateControl.Shed) from this frame on purpose. */
+	CaptureFrame_LayersShed = 1 << 1,
+};
+
+/** Per frame metadata, stored in the page that commits a frame bundle. */
+struct FCaptureFrameInfo
+{
+	uint32_t Magic;
+	uint32_t NumLayers;
+	uint64_t FrameId;
+
+	/** Sub-pixel offset of the projection, in input pixels. */
+	float JitterX;
+	float JitterY;
+
+	/** Scale the scene color was pre-exposed with; divide by it to get back to scene luminance. */
+	float PreExposure;
+	uint32_t Flags;
+
+	/** Layers the bundle expected but lost on the way, e.g. to a full readback ring. */
+	uint32_t NumDropped;
+
+	/** Level of the capture rate controller the frame was taken at, 0 for full rate. See CaptureRateControl.h. */
+	uint32_t RateLevel;
+
+	uint64_t Reserved[3];
+};
+static_assert(sizeof(FCaptureFrameInfo) == 64, "FCaptureFrameInfo layout is part of the file format.");
+
+/** Page in front of the tables written by FCaptureContainerWriter::Flush(). */
+struct FCaptureTablesPage
+{
+	uint32_t Magic;
+	uint32_t Reserved0;
+
+	/** Bytes from the start of this page to the next record, a multiple of CaptureContainerAlignment. */
+	uint64_t Size;
+};
+static_assert(sizeof(FCaptureTablesPage) == 16, "FCaptureTablesPage layout is part of the file format.");
+
+enum class ECaptureCodec : uint16_t
+{
+	Raw = 0,
+
+	/** Byte planes, row delta and rANS, see CaptureCompress.h. */
+	ShuffleDeltaRans = 1,
+};
+
+inline uint64_t AlignCaptureOffset(uint64_t Offset)
+{
+	return (Offset + CaptureContainerAlignment - 1) & ~uint64_t(CaptureContainerAlignment - 1);
+}
+
+/** One layer handed to FCaptureContainerWriter::AppendFrame(). */
+struct FCaptureLayerPayload
+{
+	const char* Layer = nullptr;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t PixelFormat = 0;
+	uint32_t BytesPerPixel = 0;
+
+	const void* Data = nullptr;
+	uint64_t Size = 0;
+	ECaptureCodec Codec = ECaptureCodec::Raw;
+	uint64_t RawSize = 0;
+};
+
+/** Appends records to a container. Append() and AppendFrame() may be called concurrently from every writer thread. */
+class FCaptureContainerWriter
+{
+public:
+	FCaptureContainerWriter() = default;
+	~FCaptureContainerWriter();
+
+	FCaptureContainerWriter(const FCaptureContainerWriter&) = delete;
+	FCaptureContainerWriter& operator=(const FCaptureContainerWriter&) = delete;
+
+	/**
+	 * Creates the container at InPath. Without bOverwrite an existing file is left alone and Open() fails, so a
+	 * finalized container is never truncated by a late writer of another session.
+	 */
+	bool Open(const std::string& InPath, bool bOverwrite = true);
+
+	/** Writes the layer table and the index, patches the file header and syncs the file to disk. */
+	bool Close();
+
+	/**
+	 * Writes the tables of every record appended so far and patches the file header like Close(), but keeps the
+	 * file open for more. Records still being written by other threads are indexed before their payload lands,
+	 * so the writers should be drained first.
+	 */
+	bool Flush();
+
+	bool IsOpen() const;
+	const std::string& GetPath() const { return Path; }
+
+	/** Appends one layer of one frame. Data holds Height rows of RowPitch bytes each. */
+	bool Append(
+		uint64_t FrameId,
+		const std::string& Layer,
+		int32_t Width,
+		int32_t Height,
+		uint32_t PixelFormat,
+		uint32_t BytesPerPixel,
+		const void* Data,
+		uint64_t Size,
+		ECaptureCodec Codec = ECaptureCodec::Raw,
+		uint64_t RawSize = 0);
+
+	/**
+	 * Appends every layer of one frame as a contiguous bundle. Info.Magic and Info.NumLayers are filled in;
+	 * the rest of Info is stored as given.
+	 */
+	bool AppendFrame(const FCaptureFrameInfo& Info, const FCaptureLayerPayload* Payloads, uint32_t NumPayloads);
+
+private:
+	/**
+	 * Writes the tables at TablesOffset, patches the file header with Flags (ECaptureContainerFlags) and returns
+	 * where the tables end. Mutex must be held.
+	 */
+	bool WriteTables(uint64_t TablesOffset, uint32_t Flags, uint64_t& OutEnd);
+
+	/** Resolves the layer index of Chunk and reserves its pages. Mutex must be held. */
+	bool ReserveChunk(FCaptureChunkHeader& Chunk);
+	bool WriteChunk(const FCaptureChunkHeader& Chunk, uint64_t ChunkOffset, const void* Data);
+	bool WriteAt(uint64_t Offset, const void* Data, uint64_t Size);
+
+	std::string Path;
+	intptr_t Handle = -1;
+
+	std::mutex Mutex;
+	uint64_t NextOffset = 0;
+	std::vector<FCaptureLayerDesc> Layers;
+	std::vector<FCaptureChunkHeader> Index;
+	std::vector<FCaptureFrameInfo> Frames;
+};
+
+/** Read-only view of a whole file mapped into memory. */
+class FCaptureMappedFile
+{
+public:
+	FCaptureMappedFile() = default;
+	~FCaptureMappedFile() { Close(); }
+
+	FCaptureMappedFile(const FCaptureMappedFile&) = delete;
+	FCaptureMappedFile& operator=(const FCaptureMappedFile&) = delete;
+
+	bool Open(const std::string& Path);
+	void Close();
+
+	const uint8_t* GetData() const { return Data; }
+	uint64_t GetSize() const { return Size; }
+
+	/** Asks the OS to start paging in a range that is about to be read. */
+	void Prefetch(uint64_t Offset, uint64_t Length) const;
+
+private:
+	const uint8_t* Data = nullptr;
+	uint64_t Size = 0;
+	intptr_t FileHandle = -1;
+	intptr_t MappingHandle = -1;
+};
+
+/** Opens a container with a single open() and mmap(); payloads are returned in place. */
+class FCaptureContainerReader
+{
+public:
+	bool Open(const std::string& Path);
+	void Close();
+
+	bool IsOpen() const { return File.GetData() != nullptr; }
+
+	/**
+	 * False when the writer never reached Close() and the index was rebuilt from the chunk headers, in part when
+	 * the tables of a Flush() were read and the records behind them walked.
+	 */
+	bool IsFinalized() const { return bFinalized; }
+
+	const std::vector<FCaptureLayerDesc>& GetLayers() const { return Layers; }
+	const std::vector<FCaptureChunkHeader>& GetRecords() const { return Records; }
+
+	/** Distinct frame ids in ascending order. */
+	const std::vector<uint64_t>& GetFrameIds() const { return FrameIds; }
+
+	/** Metadata of every committed frame bundle, in ascending frame order. */
+	const std::vector<FCaptureFrameInfo>& GetFrames() const { return Frames; }
+	const FCaptureFrameInfo* FindFrame(uint64_t FrameId) const;
+
+	int32_t FindLayer(const char* Layer) const;
+	const FCaptureChunkHeader* FindRecord(uint64_t FrameId, uint32_t LayerIndex) const;
+	const FCaptureChunkHeader* FindRecord(uint64_t FrameId, const char* Layer) const;
+
+	const uint8_t* GetPayload(const FCaptureChunkHeader& Record) const;
+	void PrefetchPayload(const FCaptureChunkHeader& Record) const;
+
+private:
+	bool ReadIndex(const FCaptureContainerHeader& Header);
+	bool RebuildIndex(uint64_t Offset);
+	void BuildLookup();
+
+	FCaptureMappedFile File;
+	bool bFinalized = false;
+	std::vector<FCaptureLayerDesc> Layers;
+	std::vector<FCaptureChunkHeader> Records;
+	std::vector<uint64_t> FrameIds;
+	std::vector<FCaptureFrameInfo> Frames;
+	std::unordered_map<uint64_t, uint32_t> Lookup;
+};
+
+/**
+ * Name of a new session folder: the local time to the millisecond followed by a count of the sessions this process
+ * has started, so a session restarted within the same second never shares the folder of the one before.
+ */
+std::string MakeCaptureSessionName();
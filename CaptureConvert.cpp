@@ -0,0 +1,566 @@
+/**
+ * Batch converter from capture dumps to OpenEXR, replacing save_color.py.
+ *
+ *   capture_convert [options] <input>...
+ *
+ * Inputs are .ucap containers, legacy raw dumps ({count}_{width}_{height}_{layer}.txt, optionally prefixed like
+ * map_DLSS_), or directories holding either. Every layer of every frame becomes one EXR, in a subdirectory named
+ * after the folder of its source, converted on a pool of worker threads straight from the memory-mapped source. Channel mapping follows save_color.py: RGB for color
+ * layers, R for depth, GR for velocity, all stored as half.
+ *
+ * Build: g++ -O2 -std=c++17 CaptureConvert.cpp CaptureReader.cpp CaptureContainer.cpp CaptureCompress.cpp CaptureHalf.cpp CapturePack.cpp CapturePixelFormat.cpp CaptureTrace.cpp -lOpenEXR -lImath -lpthread
+ */
+
+#include "CaptureHalf.h"
+#include "CapturePack.h"
+#include "CaptureReader.h"
+
+#include <ImfChannelList.h>
+#include <ImfCompression.h>
+#include <ImfFrameBuffer.h>
+#include <ImfHeader.h>
+#include <ImfOutputFile.h>
+#include <ImfStandardAttributes.h>
+#include <ImfThreading.h>
+#include <ImfTileDescription.h>
+#include <ImfTiledOutputFile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct FConvertOptions
+{
+	std::string OutputDir = ".";
+	std::vector<std::string> Layers;
+	Imf::Compression Compression = Imf::PIZ_COMPRESSION;
+	float DwaLevel = 45.0f;
+	bool bTiled = false;
+	int32_t TileSize = 64;
+	uint32_t NumThreads = 0;
+};
+
+/** One layer of one frame, either a record of an opened container or a legacy raw file. */
+struct FConvertJob
+{
+	const FCaptureReader* Reader = nullptr;
+	uint32_t FrameIndex = 0;
+
+	std::string SourcePath;
+	int32_t Width = 0;
+	int32_t Height = 0;
+
+	std::string Layer;
+	std::string OutputPath;
+};
+
+struct FChannelMapping
+{
+	const char* Name;
+	uint32_t Channel;
+};
+
+bool EndsWith(const std::string& Value, const char* Suffix)
+{
+	const size_t Length = strlen(Suffix);
+	return Value.size() >= Length && Value.compare(Value.size() - Length, Length, Suffix) == 0;
+}
+
+/** EXR channels written for a layer, as save_color.py did. Prefixed layers such as history_depth map like their base. */
+std::vector<FChannelMapping> GetChannelMapping(const std::string& Layer, const FCaptureView& View)
+{
+	const uint32_t NumChannels = uint32_t(View.Shape[2]);
+
+	if (EndsWith(Layer, "depth"))
+	{
+		return { { "R", 0 } };
+	}
+	else if (EndsWith(Layer, "velocity") && NumChannels >= 2)
+	{
+		return { { "G", 0 }, { "R", 1 } };
+	}
+	else if (NumChannels >= 3)
+	{
+		// Follow the memory order of the format, e.g. BGRA for B8G8R8A8.
+		const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(View.PixelFormat);
+		if (Desc && FindCaptureChannel(*Desc, 'R') >= 0 && FindCaptureChannel(*Desc, 'G') >= 0 && FindCaptureChannel(*Desc, 'B') >= 0)
+		{
+			return { { "R", uint32_t(FindCaptureChannel(*Desc, 'R')) }, { "G", uint32_t(FindCaptureChannel(*Desc, 'G')) }, { "B", uint32_t(FindCaptureChannel(*Desc, 'B')) } };
+		}
+		return { { "R", 0 }, { "G", 1 }, { "B", 2 } };
+	}
+	else if (NumChannels == 2)
+	{
+		return { { "G", 0 }, { "R", 1 } };
+	}
+	return { { "R", 0 } };
+}
+
+/**
+ * Splits a legacy dump name into frame, extent and layer. The first three consecutive numeric fields are
+ * {count}_{width}_{height}, everything after them is the layer name (which may itself contain '_'). OutFrame is
+ * the name up to and including {count}, shared by every layer of the frame.
+ */
+bool ParseLegacyName(const fs::path& Path, std::string& OutFrame, int32_t& OutWidth, int32_t& OutHeight, std::string& OutLayer)
+{
+	std::vector<std::string> Fields;
+	const std::string Stem = Path.stem().string();
+	for (size_t Begin = 0; Begin <= Stem.size();)
+	{
+		const size_t End = std::min(Stem.find('_', Begin), Stem.size());
+		Fields.push_back(Stem.substr(Begin, End - Begin));
+		Begin = End + 1;
+	}
+
+	auto IsNumber = [](const std::string& Field)
+	{
+		return !Field.empty() && std::all_of(Field.begin(), Field.end(), [](char C) { return C >= '0' && C <= '9'; });
+	};
+
+	for (size_t Index = 0; Index + 3 < Fields.size(); Index++)
+	{
+		if (IsNumber(Fields[Index]) && IsNumber(Fields[Index + 1]) && IsNumber(Fields[Index + 2]))
+		{
+			OutFrame = Fields[0];
+			for (size_t Prefix = 1; Prefix <= Index; Prefix++)
+			{
+				OutFrame += "_" + Fields[Prefix];
+			}
+			OutWidth = atoi(Fields[Index + 1].c_str());
+			OutHeight = atoi(Fields[Index + 2].c_str());
+			OutLayer = Fields[Index + 3];
+			for (size_t Rest = Index + 4; Rest < Fields.size(); Rest++)
+			{
+				OutLayer += "_" + Fields[Rest];
+			}
+			return OutWidth > 0 && OutHeight > 0;
+		}
+	}
+	return false;
+}
+
+/**
+ * Where the EXRs of Input go: the output directory plus the name of the folder Input was dumped in, so containers
+ * and dumps of different sessions, which share their file names, do not overwrite each other.
+ */
+fs::path GetOutputFolder(const FConvertOptions& Options, const fs::path& Input)
+{
+	const fs::path Session = fs::absolute(Input).parent_path().filename();
+	return Session.empty() ? fs::path(Options.OutputDir) : fs::path(Options.OutputDir) / Session;
+}
+
+/** Legacy dumps carry no format, depth was written as DepthPixel and everything else as half floats. */
+bool GetLegacyView(const FCaptureMappedFile& File, const FConvertJob& Job, FCaptureView& OutView)
+{
+	const uint64_t NumPixels = uint64_t(Job.Width) * uint64_t(Job.Height);
+	const uint64_t BytesPerPixel = File.GetSize() / NumPixels;
+	const bool bDepth = Job.Layer == "depth";
+	const uint64_t ElementSize = bDepth ? sizeof(float) : sizeof(uint16_t);
+
+	if (BytesPerPixel < ElementSize)
+	{
+		return false;
+	}
+
+	OutView.Data = File.GetData();
+	OutView.Shape[0] = Job.Height;
+	OutView.Shape[1] = Job.Width;
+	OutView.Shape[2] = bDepth ? 1 : int64_t(BytesPerPixel / ElementSize);
+	OutView.Strides[0] = int64_t(BytesPerPixel) * Job.Width;
+	OutView.Strides[1] = int64_t(BytesPerPixel);
+	OutView.Strides[2] = int64_t(ElementSize);
+	OutView.ElementType = bDepth ? ECaptureElementType::Float32 : ECaptureElementType::Float16;
+	return true;
+}
+
+/** Reads one integer element as float, normalizing the unorm types. */
+float ReadElementAsFloat(const uint8_t* Element, ECaptureElementType ElementType)
+{
+	switch (ElementType)
+	{
+	case ECaptureElementType::UInt8:	return float(*Element) * (1.0f / 255.0f);
+	case ECaptureElementType::UInt16:	{ uint16_t Value; memcpy(&Value, Element, sizeof(Value)); return float(Value) * (1.0f / 65535.0f); }
+	case ECaptureElementType::Int16:	{ int16_t Value; memcpy(&Value, Element, sizeof(Value)); return float(Value); }
+	case ECaptureElementType::UInt32:	{ uint32_t Value; memcpy(&Value, Element, sizeof(Value)); return float(Value); }
+	case ECaptureElementType::Int32:	{ int32_t Value; memcpy(&Value, Element, sizeof(Value)); return float(Value); }
+	case ECaptureElementType::UNorm24:	return CaptureUnpackUNorm24(uint32_t(Element[0]) | uint32_t(Element[1]) << 8 | uint32_t(Element[2]) << 16);
+	default:							return 0.0f;
+	}
+}
+
+/**
+ * Writes one view. Half and float sources are handed to OpenEXR in place, integer sources are widened first and
+ * FloatR11G11B10 is unpacked into R, G and B.
+ */
+uint64_t WriteExr(const FConvertOptions& Options, const FConvertJob& Job, const FCaptureView& View)
+{
+	const int32_t Width = int32_t(View.Shape[1]);
+	const int32_t Height = int32_t(View.Shape[0]);
+	const bool bR11G11B10 = View.PixelFormat == CapturePF_FloatR11G11B10 && View.Shape[2] == 1 && View.Strides[1] == sizeof(uint32_t);
+	const std::vector<FChannelMapping> Mapping = bR11G11B10 ? std::vector<FChannelMapping>{ { "R", 0 }, { "G", 1 }, { "B", 2 } }
+		: GetChannelMapping(Job.Layer, View);
+
+	Imf::Header Header(Width, Height);
+	Header.compression() = Options.Compression;
+	if (Options.Compression == Imf::DWAA_COMPRESSION)
+	{
+		Imf::addDwaCompressionLevel(Header, Options.DwaLevel);
+	}
+	if (Options.bTiled)
+	{
+		Header.setTileDescription(Imf::TileDescription(Options.TileSize, Options.TileSize, Imf::ONE_LEVEL));
+	}
+
+	const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(View.PixelFormat);
+	if (Desc && Desc->bPacked && !bR11G11B10)
+	{
+		throw std::runtime_error(std::string("packed format ") + Desc->Name + " is not supported");
+	}
+
+	const bool bWiden = View.ElementType != ECaptureElementType::Float16 && View.ElementType != ECaptureElementType::Float32;
+	std::vector<float> Widened;
+	if (bWiden)
+	{
+		Widened.resize(size_t(Width) * Height * Mapping.size());
+	}
+	if (bR11G11B10)
+	{
+		for (int32_t Y = 0; Y < Height; Y++)
+		{
+			const uint32_t* Row = reinterpret_cast<const uint32_t*>(View.Data + Y * View.Strides[0]);
+			ConvertCaptureR11G11B10ToFloat(Row, Widened.data() + size_t(Y) * Width * 3, size_t(Width));
+		}
+	}
+
+	Imf::FrameBuffer FrameBuffer;
+	for (size_t Index = 0; Index < Mapping.size(); Index++)
+	{
+		const FChannelMapping& Channel = Mapping[Index];
+		if (Channel.Channel >= View.Shape[2] && !bR11G11B10)
+		{
+			return 0;
+		}
+
+		Header.channels().insert(Channel.Name, Imf::Channel(Imf::HALF));
+
+		if (bR11G11B10)
+		{
+			FrameBuffer.insert(Channel.Name, Imf::Slice(Imf::FLOAT, (char*)(Widened.data() + Index), sizeof(float) * 3, sizeof(float) * 3 * Width));
+		}
+		else if (bWiden)
+		{
+			float* Dest = Widened.data() + Index;
+			for (int32_t Y = 0; Y < Height; Y++)
+			{
+				const uint8_t* Row = View.Data + Y * View.Strides[0] + Channel.Channel * View.Strides[2];
+				for (int32_t X = 0; X < Width; X++)
+				{
+					Dest[(size_t(Y) * Width + X) * Mapping.size()] = ReadElementAsFloat(Row + X * View.Strides[1], View.ElementType);
+				}
+			}
+			FrameBuffer.insert(Channel.Name, Imf::Slice(Imf::FLOAT, (char*)Dest,
+				sizeof(float) * Mapping.size(), sizeof(float) * Mapping.size() * Width));
+		}
+		else
+		{
+			const Imf::PixelType Type = View.ElementType == ECaptureElementType::Float16 ? Imf::HALF : Imf::FLOAT;
+			char* Base = (char*)(View.Data + Channel.Channel * View.Strides[2]);
+			FrameBuffer.insert(Channel.Name, Imf::Slice(Type, Base, size_t(View.Strides[1]), size_t(View.Strides[0])));
+		}
+	}
+
+	if (Options.bTiled)
+	{
+		Imf::TiledOutputFile File(Job.OutputPath.c_str(), Header, 1);
+		File.setFrameBuffer(FrameBuffer);
+		File.writeTiles(0, File.numXTiles() - 1, 0, File.numYTiles() - 1);
+	}
+	else
+	{
+		Imf::OutputFile File(Job.OutputPath.c_str(), Header, 1);
+		File.setFrameBuffer(FrameBuffer);
+		File.writePixels(Height);
+	}
+
+	return uint64_t(View.Shape[0]) * uint64_t(View.Strides[0]);
+}
+
+bool ParseCompression(const char* Name, Imf::Compression& OutCompression)
+{
+	if (strcmp(Name, "none") == 0)		{ OutCompression = Imf::NO_COMPRESSION; }
+	else if (strcmp(Name, "piz") == 0)	{ OutCompression = Imf::PIZ_COMPRESSION; }
+	else if (strcmp(Name, "zip") == 0)	{ OutCompression = Imf::ZIP_COMPRESSION; }
+	else if (strcmp(Name, "zips") == 0)	{ OutCompression = Imf::ZIPS_COMPRESSION; }
+	else if (strcmp(Name, "dwaa") == 0)	{ OutCompression = Imf::DWAA_COMPRESSION; }
+	else if (strcmp(Name, "dwab") == 0)	{ OutCompression = Imf::DWAB_COMPRESSION; }
+	else { return false; }
+	return true;
+}
+
+bool WantsLayer(const FConvertOptions& Options, const std::string& Layer)
+{
+	return Options.Layers.empty() || std::find(Options.Layers.begin(), Options.Layers.end(), Layer) != Options.Layers.end();
+}
+
+void PrintUsage()
+{
+	printf(
+		"usage: capture_convert [options] <file.ucap | raw dump | directory>...\n"
+		"  -o <dir>             output directory, every input's folder gets a subdirectory of its own (default .)\n"
+		"  -l <a,b,...>         only convert these layers\n"
+		"  -c <none|piz|zip|zips|dwaa|dwab>  compression (default piz)\n"
+		"  --dwa-level <n>      DWA compression level (default 45)\n"
+		"  --tiled [size]       write tiled EXR with size x size tiles (default 64)\n"
+		"  -j <n>               worker threads (default: all cores)\n");
+}
+
+} //! namespace
+
+int main(int Argc, char** Argv)
+{
+	FConvertOptions Options;
+	std::vector<fs::path> Inputs;
+
+	for (int Arg = 1; Arg < Argc; Arg++)
+	{
+		const char* Value = Argv[Arg];
+		const bool bHasNext = Arg + 1 < Argc;
+
+		if (strcmp(Value, "-o") == 0 && bHasNext)
+		{
+			Options.OutputDir = Argv[++Arg];
+		}
+		else if (strcmp(Value, "-l") == 0 && bHasNext)
+		{
+			std::string List = Argv[++Arg];
+			for (size_t Begin = 0; Begin <= List.size();)
+			{
+				const size_t End = std::min(List.find(',', Begin), List.size());
+				if (End > Begin)
+				{
+					Options.Layers.push_back(List.substr(Begin, End - Begin));
+				}
+				Begin = End + 1;
+			}
+		}
+		else if (strcmp(Value, "-c") == 0 && bHasNext)
+		{
+			if (!ParseCompression(Argv[++Arg], Options.Compression))
+			{
+				fprintf(stderr, "unknown compression %s\n", Argv[Arg]);
+				return 1;
+			}
+		}
+		else if (strcmp(Value, "--dwa-level") == 0 && bHasNext)
+		{
+			Options.DwaLevel = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--tiled") == 0)
+		{
+			Options.bTiled = true;
+			if (bHasNext && atoi(Argv[Arg + 1]) > 0)
+			{
+				Options.TileSize = atoi(Argv[++Arg]);
+			}
+		}
+		else if (strcmp(Value, "-j") == 0 && bHasNext)
+		{
+			Options.NumThreads = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (Value[0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else if (fs::is_directory(Value))
+		{
+			for (const fs::directory_entry& Entry : fs::directory_iterator(Value))
+			{
+				const fs::path Extension = Entry.path().extension();
+				if (Entry.is_regular_file() && (Extension == ".ucap" || Extension == ".txt"))
+				{
+					Inputs.push_back(Entry.path());
+				}
+			}
+		}
+		else
+		{
+			Inputs.push_back(Value);
+		}
+	}
+
+	if (Inputs.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::sort(Inputs.begin(), Inputs.end());
+	fs::create_directories(Options.OutputDir);
+
+	// Containers stay mapped for the whole run, legacy dumps are mapped by the worker that converts them.
+	std::vector<std::unique_ptr<FCaptureReader>> Readers;
+	std::vector<FConvertJob> Jobs;
+	uint64_t NumFrames = 0;
+
+	// A legacy dump holds one layer, frames are told apart by their folder and {count}.
+	std::set<fs::path> LegacyFrames;
+
+	for (const fs::path& Input : Inputs)
+	{
+		if (Input.extension() == ".ucap")
+		{
+			std::unique_ptr<FCaptureReader> Reader = std::make_unique<FCaptureReader>();
+			if (!Reader->Open(Input.string()))
+			{
+				fprintf(stderr, "cannot open %s\n", Input.string().c_str());
+				continue;
+			}
+			if (!Reader->GetContainer().IsFinalized())
+			{
+				fprintf(stderr, "%s was not closed, index rebuilt from chunk headers\n", Input.string().c_str());
+			}
+
+			const fs::path OutputFolder = GetOutputFolder(Options, Input);
+			fs::create_directories(OutputFolder);
+			const std::string Prefix = Input.stem().string();
+			for (const FCaptureChunkHeader& Record : Reader->GetContainer().GetRecords())
+			{
+				if (!WantsLayer(Options, Record.Layer))
+				{
+					continue;
+				}
+
+				const std::vector<uint64_t>& FrameIds = Reader->GetContainer().GetFrameIds();
+				FConvertJob Job;
+				Job.Reader = Reader.get();
+				Job.FrameIndex = uint32_t(std::lower_bound(FrameIds.begin(), FrameIds.end(), Record.FrameId) - FrameIds.begin());
+				Job.Layer = Record.Layer;
+				Job.OutputPath = (OutputFolder / (Prefix + "_" + std::to_string(Record.FrameId) + "_" +
+					std::to_string(Record.Width) + "_" + std::to_string(Record.Height) + "_" + Job.Layer + ".exr")).string();
+				Jobs.push_back(std::move(Job));
+			}
+			NumFrames += Reader->GetNumFrames();
+			Readers.push_back(std::move(Reader));
+		}
+		else
+		{
+			FConvertJob Job;
+			std::string Frame;
+			if (!ParseLegacyName(Input, Frame, Job.Width, Job.Height, Job.Layer))
+			{
+				fprintf(stderr, "skipping %s, name is not {count}_{width}_{height}_{layer}\n", Input.string().c_str());
+				continue;
+			}
+			if (!WantsLayer(Options, Job.Layer))
+			{
+				continue;
+			}
+			const fs::path OutputFolder = GetOutputFolder(Options, Input);
+			fs::create_directories(OutputFolder);
+			Job.SourcePath = Input.string();
+			Job.OutputPath = (OutputFolder / Input.stem()).string() + ".exr";
+			Jobs.push_back(std::move(Job));
+			LegacyFrames.insert(fs::absolute(Input).parent_path() / Frame);
+		}
+	}
+	NumFrames += LegacyFrames.size();
+
+	// Frames are spread over our own workers, so OpenEXR's internal pool would only add contention.
+	const uint32_t NumThreads = std::min<uint32_t>(
+		Options.NumThreads ? Options.NumThreads : std::max(std::thread::hardware_concurrency(), 1u),
+		std::max<uint32_t>(uint32_t(Jobs.size()), 1));
+	Imf::setGlobalThreadCount(0);
+
+	std::atomic<size_t> NextJob(0);
+	std::atomic<uint64_t> NumConverted(0);
+	std::atomic<uint64_t> NumFailed(0);
+	std::atomic<uint64_t> BytesRead(0);
+	std::atomic<uint64_t> BytesWritten(0);
+
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+
+	auto WorkerMain = [&]()
+	{
+		std::vector<uint8_t> DecodeBuffer;
+		for (size_t JobIndex = NextJob++; JobIndex < Jobs.size(); JobIndex = NextJob++)
+		{
+			const FConvertJob& Job = Jobs[JobIndex];
+			FCaptureMappedFile LegacyFile;
+			FCaptureView View;
+
+			bool bValid = false;
+			if (Job.Reader)
+			{
+				bValid = Job.Reader->GetView(Job.FrameIndex, Job.Layer.c_str(), nullptr, View, &DecodeBuffer);
+			}
+			else if (LegacyFile.Open(Job.SourcePath))
+			{
+				bValid = GetLegacyView(LegacyFile, Job, View);
+			}
+
+			uint64_t Bytes = 0;
+			if (bValid)
+			{
+				try
+				{
+					Bytes = WriteExr(Options, Job, View);
+				}
+				catch (const std::exception& Error)
+				{
+					fprintf(stderr, "%s: %s\n", Job.OutputPath.c_str(), Error.what());
+				}
+			}
+
+			if (Bytes == 0)
+			{
+				fprintf(stderr, "failed to convert %s\n", Job.OutputPath.c_str());
+				NumFailed++;
+				continue;
+			}
+
+			std::error_code Error;
+			const uintmax_t OutputSize = fs::file_size(Job.OutputPath, Error);
+			BytesRead += Bytes;
+			BytesWritten += Error ? 0 : uint64_t(OutputSize);
+			NumConverted++;
+		}
+	};
+
+	std::vector<std::thread> Workers;
+	for (uint32_t WorkerIndex = 0; WorkerIndex < NumThreads; WorkerIndex++)
+	{
+		Workers.emplace_back(WorkerMain);
+	}
+	for (std::thread& Worker : Workers)
+	{
+		Worker.join();
+	}
+
+	const double Seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count(), 1e-9);
+	const double MegaBytes = 1024.0 * 1024.0;
+
+	printf("converted %llu layers of %llu frames (%llu failed) on %u threads in %.2f s\n",
+		(unsigned long long)NumConverted.load(), (unsigned long long)NumFrames, (unsigned long long)NumFailed.load(), NumThreads, Seconds);
+	printf("  %.1f frames/s, %.1f layers/s\n", double(NumFrames) / Seconds, double(NumConverted.load()) / Seconds);
+	printf("  read %.1f MB (%.1f MB/s), wrote %.1f MB (%.1f MB/s)\n",
+		double(BytesRead.load()) / MegaBytes, double(BytesRead.load()) / MegaBytes / Seconds,
+		double(BytesWritten.load()) / MegaBytes, double(BytesWritten.load()) / MegaBytes / Seconds);
+
+	return NumFailed.load() ? 2 : 0;
+}
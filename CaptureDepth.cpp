@@ -0,0 +1,69 @@
+#include "CaptureDepth.h"
+
+#include "CapturePack.h"
+#include "CapturePixelFormat.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CAPTURE_DEPTH_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define CAPTURE_DEPTH_SSE2 0
+#endif
+
+void LinearizeCaptureDepth(float* Depth, size_t Count, const float DeviceZToWorldZ[4])
+{
+	const float Scale = DeviceZToWorldZ[0];
+	const float Bias = DeviceZToWorldZ[1];
+	const float InvScale = DeviceZToWorldZ[2];
+	const float InvBias = DeviceZToWorldZ[3];
+
+	size_t Index = 0;
+#if CAPTURE_DEPTH_SSE2
+	// Same operations in the same order as the scalar tail, so both give the same bits.
+	const __m128 ScaleV = _mm_set1_ps(Scale);
+	const __m128 BiasV = _mm_set1_ps(Bias);
+	const __m128 InvScaleV = _mm_set1_ps(InvScale);
+	const __m128 InvBiasV = _mm_set1_ps(InvBias);
+	const __m128 One = _mm_set1_ps(1.0f);
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const __m128 DeviceZ = _mm_loadu_ps(Depth + Index);
+		const __m128 Linear = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DeviceZ, ScaleV), BiasV),
+			_mm_div_ps(One, _mm_sub_ps(_mm_mul_ps(DeviceZ, InvScaleV), InvBiasV)));
+		_mm_storeu_ps(Depth + Index, Linear);
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		const float DeviceZ = Depth[Index];
+		Depth[Index] = (DeviceZ * Scale + Bias) + 1.0f / (DeviceZ * InvScale - InvBias);
+	}
+}
+
+bool LinearizeCaptureDepthPlane(std::vector<uint8_t>& Bytes, uint32_t& PixelFormat, uint32_t& BytesPerPixel, const FCaptureDepthLinearization& Linearization)
+{
+	const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(PixelFormat);
+	if (!Desc || !Desc->bDepthStencil || BytesPerPixel == 0)
+	{
+		return false;
+	}
+
+	if (PixelFormat == CapturePF_DepthStencil && BytesPerPixel < sizeof(float))
+	{
+		return false;
+	}
+
+	// Converted in place, packed planes grow into the capacity the readback reserved for them.
+	const size_t NumPixels = Bytes.size() / BytesPerPixel;
+	if (BytesPerPixel < sizeof(float))
+	{
+		Bytes.resize(NumPixels * sizeof(float));
+	}
+	UnpackCaptureDepthPlane(Bytes.data(), PixelFormat, BytesPerPixel, NumPixels, (float*)Bytes.data());
+	LinearizeCaptureDepth((float*)Bytes.data(), NumPixels, Linearization.DeviceZToWorldZ);
+	Bytes.resize(NumPixels * sizeof(float));
+
+	PixelFormat = CapturePF_R32_FLOAT;
+	BytesPerPixel = sizeof(float);
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Device to linear depth conversion of captured depth, run on the writer threads so it costs the frame nothing.
+ *
+ * The hook copies View.InvDeviceZToWorldZTransform into the request; the writer turns the depth plane, packed or not,
+ * into R32_FLOAT view space depth with the same formula as ConvertFromDeviceZ() in the shaders:
+ *
+ *	Depth = DeviceZ * T[0] + T[1] + 1 / (DeviceZ * T[2] - T[3])
+ *
+ * With reversed infinite Z the far plane (DeviceZ = 0) comes out as +inf.
+ */
+struct FCaptureDepthLinearization
+{
+	bool bEnabled = false;
+	float DeviceZToWorldZ[4] = {};
+};
+
+/** Converts Count device depths in place. Uses SSE2 when available. */
+void LinearizeCaptureDepth(float* Depth, size_t Count, const float DeviceZToWorldZ[4]);
+
+/**
+ * Replaces the tightly packed depth plane in Bytes (DepthStencil, PackedDepth16F or PackedDepth24) with linear depth and
+ * updates its layout to R32_FLOAT, in place. Packed planes grow to 4 bytes per pixel, so reserve that capacity to avoid
+ * a reallocation. Returns false, leaving everything untouched, for any other format.
+ */
+bool LinearizeCaptureDepthPlane(std::vector<uint8_t>& Bytes, uint32_t& PixelFormat, uint32_t& BytesPerPixel, const FCaptureDepthLinearization& Linearization);
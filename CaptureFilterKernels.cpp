@@ -0,0 +1,253 @@
+#include "CaptureFilterKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+/** SampleOffsets of SetupSampleWeightParameters(). */
+constexpr float SampleOffsets[9][2] =
+{
+	{ -1.0f, -1.0f }, { 0.0f, -1.0f }, { 1.0f, -1.0f },
+	{ -1.0f,  0.0f }, { 0.0f,  0.0f }, { 1.0f,  0.0f },
+	{ -1.0f,  1.0f }, { 0.0f,  1.0f }, { 1.0f,  1.0f },
+};
+constexpr int32_t PlusSamples[5] = { 1, 3, 4, 5, 7 };
+
+const char* const KernelNames[] = { "gaussian", "catmull-rom", "mitchell-netravali", "lanczos2", "lanczos3", "blackman-harris" };
+static_assert(sizeof(KernelNames) / sizeof(KernelNames[0]) == size_t(ECaptureFilterKernel::Count), "one name per kernel");
+
+/** CatmullRom() of 4.26, which extrapolated the outer cubic past 2 when the filter size was below 0.75. */
+float CatmullRom(float x)
+{
+	float ax = std::fabs(x);
+	if (ax >= 2.0f)
+		return 0.0f;
+	else if (ax > 1.0f)
+		return ((-0.5f * ax + 2.5f) * ax - 4.0f) * ax + 2.0f;
+	else
+		return (1.5f * ax - 2.5f) * ax * ax + 1.0f;
+}
+
+float MitchellNetravali(float x)
+{
+	constexpr float B = 1.0f / 3.0f;
+	constexpr float C = 1.0f / 3.0f;
+	const float ax = std::fabs(x);
+	if (ax < 1.0f)
+	{
+		return ((12.0f - 9.0f * B - 6.0f * C) * ax * ax * ax + (-18.0f + 12.0f * B + 6.0f * C) * ax * ax + (6.0f - 2.0f * B)) * (1.0f / 6.0f);
+	}
+	if (ax < 2.0f)
+	{
+		return ((-B - 6.0f * C) * ax * ax * ax + (6.0f * B + 30.0f * C) * ax * ax + (-12.0f * B - 48.0f * C) * ax + (8.0f * B + 24.0f * C)) * (1.0f / 6.0f);
+	}
+	return 0.0f;
+}
+
+float Lanczos(float x, float Lobes)
+{
+	const float ax = std::fabs(x);
+	if (ax >= Lobes)
+	{
+		return 0.0f;
+	}
+	if (ax < 1e-6f)
+	{
+		return 1.0f;
+	}
+	constexpr float Pi = 3.14159265f;
+	const float PiX = Pi * ax;
+	return Lobes * std::sin(PiX) * std::sin(PiX / Lobes) / (PiX * PiX);
+}
+
+} //! namespace
+
+const char* GetCaptureFilterKernelName(ECaptureFilterKernel Kernel)
+{
+	return Kernel < ECaptureFilterKernel::Count ? KernelNames[size_t(Kernel)] : "unknown";
+}
+
+bool ParseCaptureFilterKernel(const char* Name, ECaptureFilterKernel& OutKernel)
+{
+	for (size_t Index = 0; Index < size_t(ECaptureFilterKernel::Count); Index++)
+	{
+		if (strcmp(Name, KernelNames[Index]) == 0)
+		{
+			OutKernel = ECaptureFilterKernel(Index);
+			return true;
+		}
+	}
+	return false;
+}
+
+float EvaluateCaptureFilterKernel(ECaptureFilterKernel Kernel, float X, float Y)
+{
+	switch (Kernel)
+	{
+	case ECaptureFilterKernel::CatmullRom:
+		return CatmullRom(X) * CatmullRom(Y);
+	case ECaptureFilterKernel::MitchellNetravali:
+		return MitchellNetravali(X) * MitchellNetravali(Y);
+	case ECaptureFilterKernel::Lanczos2:
+		return Lanczos(X, 2.0f) * Lanczos(Y, 2.0f);
+	case ECaptureFilterKernel::Lanczos3:
+		return Lanczos(X, 3.0f) * Lanczos(Y, 3.0f);
+	case ECaptureFilterKernel::BlackmanHarris:
+	{
+		const float X2 = std::min(X * X + Y * Y, 1.0f);
+		return (0.905f * X2 - 1.9f) * X2 + 1.0f;
+	}
+	default:
+		// Normal distribution, Sigma = 0.47
+		return std::exp(-2.29f * (X * X + Y * Y));
+	}
+}
+
+float GetCaptureFilterKernelRadius(ECaptureFilterKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case ECaptureFilterKernel::BlackmanHarris:
+		return 1.0f;
+	case ECaptureFilterKernel::Lanczos3:
+		return 3.0f;
+	default:
+		return 2.0f;
+	}
+}
+
+void ComputeCaptureFilterWeights(ECaptureFilterKernel Kernel, float JitterX, float JitterY, float FilterSize, float OutSampleWeights[9], float OutPlusWeights[5])
+{
+	float TotalWeight = 0.0f;
+	for (int32_t i = 0; FilterSize > 0.0f && i < 9; i++)
+	{
+		float PixelOffsetX = SampleOffsets[i][0] - JitterX;
+		float PixelOffsetY = SampleOffsets[i][1] - JitterY;
+
+		PixelOffsetX /= FilterSize;
+		PixelOffsetY /= FilterSize;
+
+		OutSampleWeights[i] = EvaluateCaptureFilterKernel(Kernel, PixelOffsetX, PixelOffsetY);
+		TotalWeight += OutSampleWeights[i];
+	}
+	if (TotalWeight > 0.0f)
+	{
+		for (int32_t i = 0; i < 9; i++)
+		{
+			OutSampleWeights[i] /= TotalWeight;
+		}
+	}
+	else
+	{
+		// A filter size of 0, or every sample on a zero of a sinc: take the closest.
+		const int32_t ClosestX = std::min(std::max(int32_t(std::floor(JitterX + 0.5f)), -1), 1);
+		const int32_t ClosestY = std::min(std::max(int32_t(std::floor(JitterY + 0.5f)), -1), 1);
+		for (int32_t i = 0; i < 9; i++)
+		{
+			OutSampleWeights[i] = i == (ClosestY + 1) * 3 + ClosestX + 1 ? 1.0f : 0.0f;
+		}
+	}
+
+	float TotalWeightPlus = 0.0f;
+	for (int32_t i = 0; i < 5; i++)
+	{
+		OutPlusWeights[i] = OutSampleWeights[PlusSamples[i]];
+		TotalWeightPlus += OutPlusWeights[i];
+	}
+	for (int32_t i = 0; i < 5; i++)
+	{
+		OutPlusWeights[i] /= TotalWeightPlus;
+	}
+}
+
+FCaptureFilterWeightTable::FCaptureFilterWeightTable(ECaptureFilterKernel InKernel, float InMinFilterSize, float InMaxFilterSize, int32_t InNumFilterSizes,
+	int32_t InNumPhases)
+	: Kernel(InKernel)
+	, MinFilterSize(InMinFilterSize)
+	, MaxFilterSize(InNumFilterSizes > 1 ? InMaxFilterSize : InMinFilterSize)
+	, NumFilterSizes(std::max(InNumFilterSizes, 1))
+	, NumPhases(std::max(InNumPhases, 2))
+{
+	Weights.resize(size_t(NumFilterSizes) * NumPhases * NumPhases * EntrySize);
+	for (int32_t FilterSizeIndex = 0; FilterSizeIndex < NumFilterSizes; FilterSizeIndex++)
+	{
+		const float FilterSize = NumFilterSizes > 1
+			? MinFilterSize + (MaxFilterSize - MinFilterSize) * float(FilterSizeIndex) / float(NumFilterSizes - 1)
+			: MinFilterSize;
+		for (int32_t PhaseY = 0; PhaseY < NumPhases; PhaseY++)
+		{
+			for (int32_t PhaseX = 0; PhaseX < NumPhases; PhaseX++)
+			{
+				float* Entry = &Weights[GetEntryOffset(FilterSizeIndex, PhaseX, PhaseY)];
+				const float JitterX = float(PhaseX) / float(NumPhases - 1) - 0.5f;
+				const float JitterY = float(PhaseY) / float(NumPhases - 1) - 0.5f;
+				ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, FilterSize, Entry, Entry + 9);
+			}
+		}
+	}
+}
+
+bool FCaptureFilterWeightTable::Covers(float FilterSize) const
+{
+	return NumFilterSizes > 1 ? FilterSize >= MinFilterSize && FilterSize <= MaxFilterSize : FilterSize == MinFilterSize;
+}
+
+void FCaptureFilterWeightTable::Lookup(float JitterX, float JitterY, float FilterSize, float OutSampleWeights[9], float OutPlusWeights[5]) const
+{
+	if (!Covers(FilterSize) || !(std::fabs(JitterX) <= 0.5f) || !(std::fabs(JitterY) <= 0.5f))
+	{
+		ComputeCaptureFilterWeights(Kernel, JitterX, JitterY, FilterSize, OutSampleWeights, OutPlusWeights);
+		return;
+	}
+
+	// Cell and fraction along each axis; the last cell takes the upper bound with a fraction of 1.
+	auto Locate = [](float Position, int32_t NumSteps, int32_t& OutIndex, float& OutFraction)
+	{
+		OutIndex = std::min(int32_t(Position), std::max(NumSteps - 2, 0));
+		OutFraction = Position - float(OutIndex);
+	};
+	int32_t PhaseX, PhaseY, FilterSizeIndex;
+	float FractionX, FractionY, FractionSize;
+	Locate((JitterX + 0.5f) * float(NumPhases - 1), NumPhases, PhaseX, FractionX);
+	Locate((JitterY + 0.5f) * float(NumPhases - 1), NumPhases, PhaseY, FractionY);
+	if (NumFilterSizes > 1)
+	{
+		Locate((FilterSize - MinFilterSize) * float(NumFilterSizes - 1) / (MaxFilterSize - MinFilterSize), NumFilterSizes, FilterSizeIndex, FractionSize);
+	}
+	else
+	{
+		FilterSizeIndex = 0;
+		FractionSize = 0.0f;
+	}
+
+	// Bilinear over the jitter in one or, between two filter sizes, both slices.
+	auto Bilinear = [this, PhaseX, PhaseY, FractionX, FractionY](int32_t Slice, float* OutEntry)
+	{
+		const float* E00 = &Weights[GetEntryOffset(Slice, PhaseX, PhaseY)];
+		const float* E01 = E00 + EntrySize;
+		const float* E10 = E00 + size_t(NumPhases) * EntrySize;
+		const float* E11 = E10 + EntrySize;
+		for (int32_t i = 0; i < EntrySize; i++)
+		{
+			const float Top = E00[i] * (1.0f - FractionX) + E01[i] * FractionX;
+			const float Bottom = E10[i] * (1.0f - FractionX) + E11[i] * FractionX;
+			OutEntry[i] = Top * (1.0f - FractionY) + Bottom * FractionY;
+		}
+	};
+	float Result[EntrySize];
+	Bilinear(FilterSizeIndex, Result);
+	if (FractionSize > 0.0f)
+	{
+		float Next[EntrySize];
+		Bilinear(FilterSizeIndex + 1, Next);
+		for (int32_t i = 0; i < EntrySize; i++)
+		{
+			Result[i] = Result[i] * (1.0f - FractionSize) + Next[i] * FractionSize;
+		}
+	}
+	memcpy(OutSampleWeights, Result, 9 * sizeof(float));
+	memcpy(OutPlusWeights, Result + 9, 5 * sizeof(float));
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Reconstruction filters for the 3x3 neighborhood of the Gen4 TAA resolve, the SampleWeights and PlusWeights that
+ * SetupSampleWeightParameters() of TAA.cpp feeds to TAAStandalone.usf, shared by the engine and the CPU reference.
+ *
+ * A weight is the kernel at the offset of a neighbor from the jittered sample, divided by r.TemporalAAFilterSize,
+ * and the nine weights are normalized; the plus weights are the cross of them, normalized again. Gaussian and
+ * Catmull-Rom are the two kernels of 4.26 and give the same bits, except that Catmull-Rom now ends at 2 pixels
+ * rather than blowing up at filter sizes below 0.75. A filter size of 0, the "sharper but aliased" end of the
+ * setting, and a neighborhood the kernel gives no weight to at all take the closest sample alone.
+ *
+ * The weights only depend on the kernel, the filter size and the jitter, so FCaptureFilterWeightTable evaluates them
+ * once over a grid of jitter phases and filter sizes and a frame's setup becomes an interpolated lookup.
+ */
+enum class ECaptureFilterKernel : uint8_t
+{
+	/** exp(-2.29 r^2), a normal distribution of sigma 0.47. The default of r.TemporalAAFilterKernel. */
+	Gaussian,
+
+	/** Separable Catmull-Rom spline of radius 2, r.TemporalAACatmullRom. Sharper, with negative lobes. */
+	CatmullRom,
+
+	/** Separable Mitchell-Netravali cubic, B = C = 1/3 as ComputeMitchellNetravaliDownsample(). */
+	MitchellNetravali,
+
+	/** Separable windowed sinc of 2 and 3 lobes. */
+	Lanczos2,
+	Lanczos3,
+
+	/**
+	 * Radial Blackman-Harris of radius 1, in the polynomial form TAAStandalone.usf weights MainUpsampling with, so
+	 * Main filters like MainUpsampling at a 1:1 ratio.
+	 */
+	BlackmanHarris,
+
+	Count
+};
+
+/** Lower case name as on command lines: gaussian, catmull-rom, mitchell-netravali, lanczos2, lanczos3, blackman-harris. */
+const char* GetCaptureFilterKernelName(ECaptureFilterKernel Kernel);
+
+/** Inverse of GetCaptureFilterKernelName(); false for an unknown name. */
+bool ParseCaptureFilterKernel(const char* Name, ECaptureFilterKernel& OutKernel);
+
+/** Unnormalized weight of a sample X, Y pixels away from the filter center, at a filter size of 1. */
+float EvaluateCaptureFilterKernel(ECaptureFilterKernel Kernel, float X, float Y);
+
+/**
+ * Extent of the kernel along an axis at a filter size of 1, past which resampling drops it: 1 for Blackman-Harris
+ * (whose polynomial levels off at 0.005 there), 3 for Lanczos3, 2 for the others (the Gaussian is below 1e-4).
+ */
+float GetCaptureFilterKernelRadius(ECaptureFilterKernel Kernel);
+
+/**
+ * SetupSampleWeightParameters() with any kernel: the weights of the 3x3 neighborhood (row major, -1 to 1) and of its
+ * plus samples 1, 3, 4, 5 and 7, for a jitter in input pixels (TemporalJitterPixels / ResolutionDivisor).
+ */
+void ComputeCaptureFilterWeights(ECaptureFilterKernel Kernel, float JitterX, float JitterY, float FilterSize, float OutSampleWeights[9], float OutPlusWeights[5]);
+
+/**
+ * ComputeCaptureFilterWeights() of one kernel precomputed on NumPhases x NumPhases jitters spanning [-0.5, 0.5] and
+ * NumFilterSizes filter sizes spread evenly over [MinFilterSize, MaxFilterSize]. Lookup() interpolates linearly
+ * between them: on a grid point it returns what ComputeCaptureFilterWeights() would, between them it is off by less
+ * than 2e-3 at the default 1/32 pixel spacing (3e-2 between filter sizes 1/8 apart) and the weights still sum to
+ * one. A table of a single filter size only covers that size exactly. Jitters and sizes outside the table are
+ * evaluated directly.
+ */
+class FCaptureFilterWeightTable
+{
+public:
+	static constexpr int32_t DefaultNumPhases = 33;
+
+	FCaptureFilterWeightTable(ECaptureFilterKernel InKernel, float InMinFilterSize, float InMaxFilterSize, int32_t InNumFilterSizes,
+		int32_t InNumPhases = DefaultNumPhases);
+
+	ECaptureFilterKernel GetKernel() const { return Kernel; }
+
+	/** Whether FilterSize is within the table rather than evaluated directly. */
+	bool Covers(float FilterSize) const;
+
+	size_t GetAllocatedSize() const { return Weights.size() * sizeof(float); }
+
+	void Lookup(float JitterX, float JitterY, float FilterSize, float OutSampleWeights[9], float OutPlusWeights[5]) const;
+
+private:
+	/** Sample and plus weights of one table entry, one after the other. */
+	static constexpr int32_t EntrySize = 9 + 5;
+
+	size_t GetEntryOffset(int32_t FilterSizeIndex, int32_t PhaseX, int32_t PhaseY) const
+	{
+		return ((size_t(FilterSizeIndex) * NumPhases + PhaseY) * NumPhases + PhaseX) * EntrySize;
+	}
+
+	ECaptureFilterKernel Kernel;
+	float MinFilterSize;
+	float MaxFilterSize;
+	int32_t NumFilterSizes;
+	int32_t NumPhases;
+	std::vector<float> Weights;
+};
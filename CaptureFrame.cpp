@@ -0,0 +1,144 @@
+#include "CaptureFrame.h"
+
+#include <cassert>
+
+FCaptureFrameLayerRef::FCaptureFrameLayerRef(std::shared_ptr<FCaptureFrame> Frame, uint32_t Slot)
+	: Claim(std::make_shared<FClaim>())
+{
+	Claim->Frame = std::move(Frame);
+	Claim->Slot = Slot;
+}
+
+FCaptureFrameLayerRef::FClaim::~FClaim()
+{
+	if (!bResolved.exchange(true))
+	{
+		Frame->ResolveSlot(Slot, nullptr);
+	}
+}
+
+void FCaptureFrameLayerRef::Complete(FCaptureFrameLayer&& Layer) const
+{
+	if (Claim && !Claim->bResolved.exchange(true))
+	{
+		Claim->Frame->ResolveSlot(Claim->Slot, &Layer);
+	}
+}
+
+uint64_t FCaptureFrameLayerRef::GetFrameId() const
+{
+	return Claim ? Claim->Frame->GetFrameId() : 0;
+}
+
+FCaptureFrameLayerRef FCaptureFrameLayerRef::AddSibling(const std::string& Layer) const
+{
+	return Claim ? Claim->Frame->AddLayer(Layer) : FCaptureFrameLayerRef();
+}
+
+std::shared_ptr<FCaptureFrame> FCaptureFrame::Create(uint64_t FrameId, std::string ContainerPath, FCompleteFunction OnComplete)
+{
+	return std::shared_ptr<FCaptureFrame>(new FCaptureFrame(FrameId, std::move(ContainerPath), std::move(OnComplete)));
+}
+
+FCaptureFrame::FCaptureFrame(uint64_t FrameId, std::string InContainerPath, FCompleteFunction InOnComplete)
+	: ContainerPath(std::move(InContainerPath))
+	, OnComplete(std::move(InOnComplete))
+{
+	Info.FrameId = FrameId;
+	Info.PreExposure = 1.0f;
+}
+
+FCaptureFrameLayerRef FCaptureFrame::AddLayer(const std::string& Layer)
+{
+	if (bSealed || NumSlots == MaxLayers)
+	{
+		return FCaptureFrameLayerRef();
+	}
+
+	const uint32_t Slot = NumSlots++;
+	Slots[Slot].Layer = Layer;
+
+	// Relaxed is enough, the seal still holds the frame open and publishes the slot with its release.
+	NumPending.fetch_add(1, std::memory_order_relaxed);
+	return FCaptureFrameLayerRef(shared_from_this(), Slot);
+}
+
+void FCaptureFrame::Seal()
+{
+	assert(!bSealed);
+	bSealed = true;
+	Release();
+}
+
+void FCaptureFrame::ResolveSlot(uint32_t Slot, FCaptureFrameLayer* Layer)
+{
+	if (Layer)
+	{
+		Slots[Slot].Data = std::move(*Layer);
+		Slots[Slot].bCompleted = true;
+	}
+	else
+	{
+		NumDropped.fetch_add(1, std::memory_order_relaxed);
+	}
+	Release();
+}
+
+void FCaptureFrame::Release()
+{
+	// The acquire half makes every slot written by the other threads visible to the one that commits.
+	if (NumPending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		Info.NumDropped = NumDropped.load(std::memory_order_relaxed);
+		if (OnComplete)
+		{
+			OnComplete(shared_from_this());
+		}
+	}
+}
+
+std::vector<FCaptureLayerPayload> FCaptureFrame::GetPayloads() const
+{
+	std::vector<FCaptureLayerPayload> Payloads;
+	Payloads.reserve(NumSlots);
+
+	for (uint32_t Slot = 0; Slot < NumSlots; Slot++)
+	{
+		const FSlot& Entry = Slots[Slot];
+		if (!Entry.bCompleted)
+		{
+			continue;
+		}
+
+		FCaptureLayerPayload Payload;
+		Payload.Layer = Entry.Layer.c_str();
+		Payload.Width = Entry.Data.Width;
+		Payload.Height = Entry.Data.Height;
+		Payload.PixelFormat = Entry.Data.PixelFormat;
+		Payload.BytesPerPixel = Entry.Data.BytesPerPixel;
+		Payload.Data = Entry.Data.Bytes.data();
+		Payload.Size = Entry.Data.Bytes.size();
+		Payload.Codec = Entry.Data.Codec;
+		Payload.RawSize = Entry.Data.RawSize;
+		Payloads.push_back(Payload);
+	}
+	return Payloads;
+}
+
+uint64_t FCaptureFrame::GetPayloadBytes() const
+{
+	uint64_t NumBytes = 0;
+	for (uint32_t Slot = 0; Slot < NumSlots; Slot++)
+	{
+		NumBytes += Slots[Slot].bCompleted ? Slots[Slot].Data.Bytes.size() : 0;
+	}
+	return NumBytes;
+}
+
+void FCaptureFrame::ReleaseLayers(FCaptureBufferPool& Pool)
+{
+	for (uint32_t Slot = 0; Slot < NumSlots; Slot++)
+	{
+		Pool.Release(std::move(Slots[Slot].Data.Bytes));
+	}
+}
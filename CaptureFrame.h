@@ -0,0 +1,132 @@
+#pragma once
+
+#include "CaptureBufferPool.h"
+#include "CaptureContainer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Every layer captured for one rendered frame, committed to the container as a single bundle.
+ *
+ * The render thread creates the frame, reserves one slot per layer before the readback is queued, and seals it
+ * once no hook can add to it anymore. Readbacks land on the writer threads in any order and fill their own slot.
+ * A single atomic counter of outstanding slots (plus one for the seal) decides who commits: whichever thread
+ * brings it to zero calls the completion function, without any lock on the way.
+ */
+
+class FCaptureFrame;
+
+/** A layer once it has been read back and, optionally, encoded. */
+struct FCaptureFrameLayer
+{
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t PixelFormat = 0;
+	uint32_t BytesPerPixel = 0;
+
+	ECaptureCodec Codec = ECaptureCodec::Raw;
+	uint64_t RawSize = 0;
+	std::vector<uint8_t> Bytes;
+};
+
+/**
+ * Claim on one slot of a frame, carried by the readback request and the write job. Copies share the claim.
+ * If the last copy goes away before Complete() (the ring or the writer queue dropped the layer), the slot is
+ * abandoned so the frame still commits.
+ */
+class FCaptureFrameLayerRef
+{
+public:
+	FCaptureFrameLayerRef() = default;
+	FCaptureFrameLayerRef(std::shared_ptr<FCaptureFrame> Frame, uint32_t Slot);
+
+	explicit operator bool() const { return Claim != nullptr; }
+
+	/** Hands the layer over to its frame. Only the first call on a claim has an effect. */
+	void Complete(FCaptureFrameLayer&& Layer) const;
+
+	/** Frame the claim belongs to. */
+	uint64_t GetFrameId() const;
+
+	/** Reserves another slot in the same frame, e.g. for a plane split off this layer. Render thread only, before the seal. */
+	FCaptureFrameLayerRef AddSibling(const std::string& Layer) const;
+
+private:
+	struct FClaim
+	{
+		std::shared_ptr<FCaptureFrame> Frame;
+		uint32_t Slot = 0;
+		std::atomic<bool> bResolved{ false };
+
+		~FClaim();
+	};
+
+	std::shared_ptr<FClaim> Claim;
+};
+
+class FCaptureFrame : public std::enable_shared_from_this<FCaptureFrame>
+{
+public:
+	static constexpr uint32_t MaxLayers = 16;
+
+	/** Called once with the complete frame, on the thread that resolved its last slot or sealed it. */
+	using FCompleteFunction = std::function<void(std::shared_ptr<FCaptureFrame>)>;
+
+	static std::shared_ptr<FCaptureFrame> Create(uint64_t FrameId, std::string ContainerPath, FCompleteFunction OnComplete);
+
+	/** Metadata written with the bundle. Only modify it before Seal(). */
+	FCaptureFrameInfo& GetInfo() { return Info; }
+	const FCaptureFrameInfo& GetInfo() const { return Info; }
+
+	uint64_t GetFrameId() const { return Info.FrameId; }
+	const std::string& GetContainerPath() const { return ContainerPath; }
+
+	/** Reserves a slot for Layer. Returns an empty claim once the frame is sealed or full. Render thread only. */
+	FCaptureFrameLayerRef AddLayer(const std::string& Layer);
+
+	/** No layer is added after this. Render thread only, at most once. */
+	void Seal();
+
+	bool IsSealed() const { return bSealed; }
+
+	/** Layers that were completed, in slot order. Only valid inside and after the completion function. */
+	std::vector<FCaptureLayerPayload> GetPayloads() const;
+
+	/** Bytes the completed layers take in the bundle, encoded or raw. Same validity as GetPayloads(). */
+	uint64_t GetPayloadBytes() const;
+
+	/** Returns the storage of every layer to Pool once the bundle has been written. Invalidates GetPayloads(). */
+	void ReleaseLayers(FCaptureBufferPool& Pool);
+
+private:
+	friend class FCaptureFrameLayerRef;
+
+	FCaptureFrame(uint64_t FrameId, std::string InContainerPath, FCompleteFunction InOnComplete);
+
+	void ResolveSlot(uint32_t Slot, FCaptureFrameLayer* Layer);
+	void Release();
+
+	struct FSlot
+	{
+		std::string Layer;
+		FCaptureFrameLayer Data;
+		bool bCompleted = false;
+	};
+
+	FCaptureFrameInfo Info = {};
+	std::string ContainerPath;
+	FCompleteFunction OnComplete;
+
+	FSlot Slots[MaxLayers];
+	uint32_t NumSlots = 0;
+	bool bSealed = false;
+
+	/** Unresolved slots, plus one until the frame is sealed. */
+	std::atomic<int32_t> NumPending{ 1 };
+	std::atomic<uint32_t> NumDropped{ 0 };
+};
@@ -0,0 +1,323 @@
+#include "CaptureHalf.h"
+
+#include "CaptureSimd.h"
+
+#include <cstring>
+
+#if CAPTURE_SIMD_AVX2 && (defined(__GNUC__) || defined(__clang__)) && !defined(__F16C__)
+	// Every AVX2 CPU has F16C, which GCC and Clang only enable on their own with -mf16c.
+	#define CAPTURE_HALF_F16C __attribute__((target("f16c")))
+#else
+	#define CAPTURE_HALF_F16C
+#endif
+
+namespace
+{
+
+constexpr int32_t R11G11B10MantissaBits[3] = { 6, 6, 5 };
+constexpr float R11G11B10MaxValues[3] = { 65024.0f, 65024.0f, 64512.0f };
+constexpr int32_t R11G11B10Shifts[3] = { 0, 11, 22 };
+
+uint32_t FloatBits(float Value)
+{
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+	return Bits;
+}
+
+float BitsFloat(uint32_t Bits)
+{
+	float Value;
+	memcpy(&Value, &Bits, sizeof(Value));
+	return Value;
+}
+
+/** Rounds float bits to their upper 16, to nearest even; NaN keeps the top of its payload with the quiet bit set. */
+uint16_t FloatBitsToBFloat16(uint32_t Bits)
+{
+	if ((Bits & 0x7FFFFFFF) > 0x7F800000)
+	{
+		return uint16_t((Bits >> 16) | 0x40);
+	}
+	return uint16_t((Bits + 0x7FFF + ((Bits >> 16) & 1)) >> 16);
+}
+
+/**
+ * Packs V::Lanes pixels of interleaved RGB: each channel rounded by QuantizeCaptureFloat(), then its exponent and
+ * mantissa taken from the float bits, or the multiple of the denormal step below 2^-14.
+ */
+template <typename V>
+void PackR11G11B10Span(const float* Src, uint32_t* Dest)
+{
+	using I = typename V::FInt;
+	I Packed = I::Splat(0);
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const int32_t MantissaBits = R11G11B10MantissaBits[Channel];
+		const V Value = Gather(Src + Channel, I::Ramp() * I::Splat(3));
+		const V Quantized = QuantizeCaptureFloat(Max(Value, V::Splat(0.0f)), MantissaBits, R11G11B10MaxValues[Channel]);
+		const I Normal = ShiftRight(AsInt(Quantized), 23 - MantissaBits) - I::Splat(112 << MantissaBits);
+		const I Denormal = ToInt(Quantized * V::Splat(float(1 << (14 + MantissaBits))));
+		const I Code = Select(Quantized < V::Splat(1.0f / 16384.0f), Denormal, Normal);
+		Packed = Packed | Code * I::Splat(1 << R11G11B10Shifts[Channel]);
+	}
+	float Lanes[V::Lanes];
+	AsFloat(Packed).StorePartial(Lanes, V::Lanes);
+	memcpy(Dest, Lanes, sizeof(Lanes));
+}
+
+/** Unpacks V::Lanes pixels into interleaved RGB, exactly. */
+template <typename V>
+void UnpackR11G11B10Span(const uint32_t* Src, float* Dest)
+{
+	using I = typename V::FInt;
+	float Lanes[V::Lanes];
+	memcpy(Lanes, Src, sizeof(Lanes));
+	const I Packed = AsInt(V::Load(Lanes));
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const int32_t MantissaBits = R11G11B10MantissaBits[Channel];
+		const I Code = ShiftRight(Packed, R11G11B10Shifts[Channel]) & I::Splat((1 << (5 + MantissaBits)) - 1);
+		const V CodeValue = ToFloat(Code);
+
+		// Rebias the exponent in place, by 112 for a finite value and by 224 to reach 255 for infinity and NaN. Below
+		// the smallest normal the mantissa is a multiple of the denormal step, the code itself.
+		const I Shifted = Code * I::Splat(1 << (23 - MantissaBits));
+		const V Finite = AsFloat(Shifted + I::Splat(112 << 23));
+		const V Special = AsFloat(Shifted + I::Splat(224 << 23));
+		const V Denormal = CodeValue * V::Splat(1.0f / float(1 << (14 + MantissaBits)));
+		V Value = Select(CodeValue < V::Splat(float(1 << MantissaBits)), Denormal, Finite);
+		Value = Select(CodeValue >= V::Splat(float(31 << MantissaBits)), Special, Value);
+
+		Value.StorePartial(Lanes, V::Lanes);
+		for (int32_t Lane = 0; Lane < V::Lanes; Lane++)
+		{
+			Dest[Lane * 3 + Channel] = Lanes[Lane];
+		}
+	}
+}
+
+} //! namespace
+
+float CaptureHalfToFloat(uint16_t Half)
+{
+	const uint32_t Sign = uint32_t(Half & 0x8000) << 16;
+	uint32_t Exponent = (Half >> 10) & 0x1F;
+	uint32_t Mantissa = Half & 0x3FF;
+
+	if (Exponent == 0x1F)
+	{
+		return BitsFloat(Sign | 0x7F800000 | (Mantissa ? 0x400000 : 0) | (Mantissa << 13));
+	}
+	if (Exponent == 0)
+	{
+		if (Mantissa == 0)
+		{
+			return BitsFloat(Sign);
+		}
+
+		// Renormalize the denormal.
+		Exponent = 1;
+		while ((Mantissa & 0x400) == 0)
+		{
+			Mantissa <<= 1;
+			Exponent--;
+		}
+		Mantissa &= 0x3FF;
+	}
+	return BitsFloat(Sign | ((Exponent + 127 - 15) << 23) | (Mantissa << 13));
+}
+
+uint16_t CaptureFloatToHalf(float Value)
+{
+	const uint32_t Bits = FloatBits(Value);
+	const uint32_t Sign = (Bits >> 16) & 0x8000;
+	const uint32_t BiasedExponent = (Bits >> 23) & 0xFF;
+	const uint32_t Mantissa = Bits & 0x7FFFFF;
+
+	if (BiasedExponent == 0xFF)
+	{
+		return uint16_t(Sign | 0x7C00 | (Mantissa ? 0x200 | (Mantissa >> 13) : 0));
+	}
+
+	const int32_t Exponent = int32_t(BiasedExponent) - 127 + 15;
+	if (Exponent >= 31)
+	{
+		return uint16_t(Sign | 0x7C00);
+	}
+	if (Exponent <= 0)
+	{
+		// Below half's smallest normal, float denormals included: they are all under half of its smallest denormal.
+		if (Exponent < -10)
+		{
+			return uint16_t(Sign);
+		}
+		const uint32_t Full = Mantissa | 0x800000;
+		const uint32_t Shift = uint32_t(14 - Exponent);
+		const uint32_t Half = Full >> Shift;
+		const uint32_t Rest = Full & ((1u << Shift) - 1);
+		const uint32_t Midpoint = 1u << (Shift - 1);
+		return uint16_t(Sign | (Half + (Rest > Midpoint || (Rest == Midpoint && (Half & 1)))));
+	}
+
+	// A carry out of the mantissa rounds up to the next exponent, from the largest finite to infinity.
+	const uint32_t Half = Sign | (uint32_t(Exponent) << 10) | (Mantissa >> 13);
+	const uint32_t Rest = Mantissa & 0x1FFF;
+	return uint16_t(Half + (Rest > 0x1000 || (Rest == 0x1000 && (Half & 1))));
+}
+
+uint16_t CaptureHalfToBFloat16(uint16_t Half)
+{
+	return FloatBitsToBFloat16(FloatBits(CaptureHalfToFloat(Half)));
+}
+
+uint16_t CaptureBFloat16ToHalf(uint16_t BFloat16)
+{
+	return CaptureFloatToHalf(BitsFloat(uint32_t(BFloat16) << 16));
+}
+
+uint32_t CapturePackR11G11B10(float Red, float Green, float Blue)
+{
+	const float Pixel[3] = { Red, Green, Blue };
+	uint32_t Packed;
+	PackR11G11B10Span<FCaptureFloat1>(Pixel, &Packed);
+	return Packed;
+}
+
+void CaptureUnpackR11G11B10(uint32_t Packed, float& OutRed, float& OutGreen, float& OutBlue)
+{
+	float Pixel[3];
+	UnpackR11G11B10Span<FCaptureFloat1>(&Packed, Pixel);
+	OutRed = Pixel[0];
+	OutGreen = Pixel[1];
+	OutBlue = Pixel[2];
+}
+
+CAPTURE_HALF_F16C void ConvertCaptureHalfToFloat(const uint16_t* Src, float* Dest, size_t Count)
+{
+	size_t Index = 0;
+#if CAPTURE_SIMD_AVX2
+	for (; Index + 8 <= Count; Index += 8)
+	{
+		_mm256_storeu_ps(Dest + Index, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(Src + Index))));
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		Dest[Index] = CaptureHalfToFloat(Src[Index]);
+	}
+}
+
+CAPTURE_HALF_F16C void ConvertCaptureFloatToHalf(const float* Src, uint16_t* Dest, size_t Count)
+{
+	size_t Index = 0;
+#if CAPTURE_SIMD_AVX2
+	for (; Index + 8 <= Count; Index += 8)
+	{
+		_mm_storeu_si128((__m128i*)(Dest + Index), _mm256_cvtps_ph(_mm256_loadu_ps(Src + Index), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		Dest[Index] = CaptureFloatToHalf(Src[Index]);
+	}
+}
+
+CAPTURE_HALF_F16C void ConvertCaptureHalfToBFloat16(const uint16_t* Src, uint16_t* Dest, size_t Count)
+{
+	size_t Index = 0;
+#if CAPTURE_SIMD_AVX2
+	const __m256i Exponent = _mm256_set1_epi32(0x7F800000);
+	const __m256i Magnitude = _mm256_set1_epi32(0x7FFFFFFF);
+	const __m256i Quiet = _mm256_set1_epi32(0x400000);
+	for (; Index + 8 <= Count; Index += 8)
+	{
+		const __m256i Bits = _mm256_castps_si256(_mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(Src + Index))));
+		const __m256i Odd = _mm256_and_si256(_mm256_srli_epi32(Bits, 16), _mm256_set1_epi32(1));
+		const __m256i Rounded = _mm256_add_epi32(Bits, _mm256_add_epi32(_mm256_set1_epi32(0x7FFF), Odd));
+		const __m256i IsNaN = _mm256_cmpgt_epi32(_mm256_and_si256(Bits, Magnitude), Exponent);
+		const __m256i Upper = _mm256_srli_epi32(_mm256_blendv_epi8(Rounded, _mm256_or_si256(Bits, Quiet), IsNaN), 16);
+		const __m256i Packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(Upper, Upper), 0x08);
+		_mm_storeu_si128((__m128i*)(Dest + Index), _mm256_castsi256_si128(Packed));
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		Dest[Index] = CaptureHalfToBFloat16(Src[Index]);
+	}
+}
+
+CAPTURE_HALF_F16C void ConvertCaptureBFloat16ToHalf(const uint16_t* Src, uint16_t* Dest, size_t Count)
+{
+	size_t Index = 0;
+#if CAPTURE_SIMD_AVX2
+	for (; Index + 8 <= Count; Index += 8)
+	{
+		const __m256i Bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(Src + Index))), 16);
+		_mm_storeu_si128((__m128i*)(Dest + Index), _mm256_cvtps_ph(_mm256_castsi256_ps(Bits), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		Dest[Index] = CaptureBFloat16ToHalf(Src[Index]);
+	}
+}
+
+void ConvertCaptureFloatToR11G11B10(const float* Src, uint32_t* Dest, size_t Count)
+{
+	size_t Index = 0;
+	for (; Index + FCaptureFloat8::Lanes <= Count; Index += FCaptureFloat8::Lanes)
+	{
+		PackR11G11B10Span<FCaptureFloat8>(Src + Index * 3, Dest + Index);
+	}
+	for (; Index < Count; Index++)
+	{
+		PackR11G11B10Span<FCaptureFloat1>(Src + Index * 3, Dest + Index);
+	}
+}
+
+void ConvertCaptureR11G11B10ToFloat(const uint32_t* Src, float* Dest, size_t Count)
+{
+	size_t Index = 0;
+	for (; Index + FCaptureFloat8::Lanes <= Count; Index += FCaptureFloat8::Lanes)
+	{
+		UnpackR11G11B10Span<FCaptureFloat8>(Src + Index, Dest + Index * 3);
+	}
+	for (; Index < Count; Index++)
+	{
+		UnpackR11G11B10Span<FCaptureFloat1>(Src + Index, Dest + Index * 3);
+	}
+}
+
+CAPTURE_HALF_F16C void ConvertCaptureHalfToFloatPlanes(const uint16_t* Src, int32_t PixelStride, int32_t NumChannels, size_t Count, float* const* DestPlanes)
+{
+	if (PixelStride == 1)
+	{
+		ConvertCaptureHalfToFloat(Src, DestPlanes[0], Count);
+		return;
+	}
+
+	size_t Index = 0;
+#if CAPTURE_SIMD_AVX2
+	// Each lane gathers the 32 bits at its half, so the last pixel is left to the scalar loop to not read past Src.
+	const __m256i Offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(PixelStride));
+	for (; Index + 8 < Count; Index += 8)
+	{
+		const uint16_t* Pixels = Src + Index * PixelStride;
+		for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+		{
+			const __m256i Words = _mm256_i32gather_epi32((const int*)(Pixels + Channel), Offsets, 2);
+			const __m256i Halves = _mm256_and_si256(Words, _mm256_set1_epi32(0xFFFF));
+			const __m128i Packed = _mm_packus_epi32(_mm256_castsi256_si128(Halves), _mm256_extracti128_si256(Halves, 1));
+			_mm256_storeu_ps(DestPlanes[Channel] + Index, _mm256_cvtph_ps(Packed));
+		}
+	}
+#endif
+	for (; Index < Count; Index++)
+	{
+		for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+		{
+			DestPlanes[Channel][Index] = CaptureHalfToFloat(Src[Index * PixelStride + Channel]);
+		}
+	}
+}
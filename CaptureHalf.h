@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Conversions between the float formats of the captured layers, shared by the loader (ConvertCaptureView()), the
+ * converter, the depth unpacking and the tools on top of them:
+ *
+ *   half      <-> float     exact one way, round to nearest even the other
+ *   half      <-> bfloat16  round to nearest even both ways, through the exact float
+ *   R11G11B10 <-> float     PF_FloatR11G11B10: red and green 6 bit mantissas in bits 0-10 and 11-21, blue a 5 bit one
+ *                           in bits 22-31, all with the 5 bit exponent of a half and no sign
+ *
+ * The element functions are the scalar definitions. The array ones convert eight elements at a time with F16C and
+ * AVX2 when the file is built with AVX2 (every AVX2 CPU has F16C), and give the same bits as the element functions
+ * for every input, NaNs included: a NaN stays a NaN with its quiet bit set and the top bits of its payload, as F16C
+ * converts them. Arrays must not overlap.
+ *
+ * Rounding to a narrower format is to nearest even, infinities stay infinities and overflow becomes one, like the
+ * GPU's float to half. Narrowing to R11G11B10 follows QuantizeCaptureFloat() of CaptureSimd.h instead, the rounding
+ * the TAA references store those textures with: negatives and NaN become 0, overflow and +infinity the largest
+ * finite value (65024 for red and green, 64512 for blue).
+ */
+
+float CaptureHalfToFloat(uint16_t Half);
+uint16_t CaptureFloatToHalf(float Value);
+
+/** bfloat16 is the upper half of a float. */
+uint16_t CaptureHalfToBFloat16(uint16_t Half);
+uint16_t CaptureBFloat16ToHalf(uint16_t BFloat16);
+
+uint32_t CapturePackR11G11B10(float Red, float Green, float Blue);
+void CaptureUnpackR11G11B10(uint32_t Packed, float& OutRed, float& OutGreen, float& OutBlue);
+
+void ConvertCaptureHalfToFloat(const uint16_t* Src, float* Dest, size_t Count);
+void ConvertCaptureFloatToHalf(const float* Src, uint16_t* Dest, size_t Count);
+void ConvertCaptureHalfToBFloat16(const uint16_t* Src, uint16_t* Dest, size_t Count);
+void ConvertCaptureBFloat16ToHalf(const uint16_t* Src, uint16_t* Dest, size_t Count);
+
+/** Count pixels of interleaved RGB floats to and from packed R11G11B10. */
+void ConvertCaptureFloatToR11G11B10(const float* Src, uint32_t* Dest, size_t Count);
+void ConvertCaptureR11G11B10ToFloat(const uint32_t* Src, float* Dest, size_t Count);
+
+/**
+ * Count pixels PixelStride halves apart into one float plane for each of their first NumChannels halves, the layout
+ * of FCaptureImage: the planes of a row of PackedFloat16RGB, or of the RGB of FloatRGBA.
+ */
+void ConvertCaptureHalfToFloatPlanes(const uint16_t* Src, int32_t PixelStride, int32_t NumChannels, size_t Count, float* const* DestPlanes);
@@ -0,0 +1,149 @@
+#include "CaptureImage.h"
+
+#include "CaptureHalf.h"
+#include "CapturePack.h"
+#include "CapturePixelFormat.h"
+#include "CaptureReader.h"
+
+#include <cstring>
+
+void FCaptureImage::Resize(int32_t InWidth, int32_t InHeight, int32_t InNumChannels)
+{
+	Width = InWidth;
+	Height = InHeight;
+	NumChannels = InNumChannels;
+	const size_t Size = GetPlaneSize() * size_t(NumChannels) + ImagePadding;
+	if (Data.size() < Size)
+	{
+		Data.resize(Size);
+	}
+}
+
+int32_t GetCaptureViewNumPlanes(const FCaptureView& View)
+{
+	const bool bPackedR11G11B10 = View.PixelFormat == CapturePF_FloatR11G11B10 && View.ElementType == ECaptureElementType::UInt32 && View.Shape[2] == 1;
+	return bPackedR11G11B10 ? 3 : int32_t(View.Shape[2]);
+}
+
+bool ConvertCaptureViewToPlanes(const FCaptureView& View, float* Dest)
+{
+	const int32_t Height = int32_t(View.Shape[0]);
+	const int32_t Width = int32_t(View.Shape[1]);
+	const int32_t NumChannels = int32_t(View.Shape[2]);
+	const size_t PlaneSize = size_t(Width) * size_t(Height);
+
+	if (GetCaptureViewNumPlanes(View) != NumChannels)
+	{
+		for (int32_t Y = 0; Y < Height; Y++)
+		{
+			const uint8_t* Row = View.Data + Y * View.Strides[0];
+			const size_t Offset = size_t(Y) * Width;
+			for (int32_t X = 0; X < Width; X++)
+			{
+				uint32_t Packed;
+				memcpy(&Packed, Row + X * View.Strides[1], sizeof(Packed));
+				CaptureUnpackR11G11B10(Packed, Dest[Offset + X], Dest[PlaneSize + Offset + X], Dest[2 * PlaneSize + Offset + X]);
+			}
+		}
+		return true;
+	}
+
+	// Rows of halves whose channels are in memory order go through the SIMD conversion in one pass.
+	if (View.ElementType == ECaptureElementType::Float16 && View.Strides[2] == 2 && View.Strides[1] % 2 == 0)
+	{
+		std::vector<float*> Planes(NumChannels);
+		for (int32_t Y = 0; Y < Height; Y++)
+		{
+			for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+			{
+				Planes[Channel] = Dest + Channel * PlaneSize + size_t(Y) * Width;
+			}
+			const uint16_t* Row = reinterpret_cast<const uint16_t*>(View.Data + Y * View.Strides[0]);
+			ConvertCaptureHalfToFloatPlanes(Row, int32_t(View.Strides[1] / 2), NumChannels, size_t(Width), Planes.data());
+		}
+		return true;
+	}
+
+	for (int32_t Channel = 0; Channel < NumChannels; Channel++)
+	{
+		float* Plane = Dest + Channel * PlaneSize;
+		for (int32_t Y = 0; Y < Height; Y++)
+		{
+			const uint8_t* Row = View.Data + Y * View.Strides[0] + Channel * View.Strides[2];
+			float* RowDest = Plane + size_t(Y) * Width;
+			for (int32_t X = 0; X < Width; X++)
+			{
+				const uint8_t* Element = Row + X * View.Strides[1];
+				switch (View.ElementType)
+				{
+				case ECaptureElementType::Float16:
+				{
+					uint16_t Half;
+					memcpy(&Half, Element, sizeof(Half));
+					RowDest[X] = CaptureHalfToFloat(Half);
+					break;
+				}
+				case ECaptureElementType::Float32:
+					memcpy(&RowDest[X], Element, sizeof(float));
+					break;
+				case ECaptureElementType::UInt8:
+					RowDest[X] = float(*Element) * (1.0f / 255.0f);
+					break;
+				case ECaptureElementType::UInt16:
+				{
+					uint16_t Value;
+					memcpy(&Value, Element, sizeof(Value));
+					RowDest[X] = float(Value) * (1.0f / 65535.0f);
+					break;
+				}
+				case ECaptureElementType::UNorm24:
+					RowDest[X] = CaptureUnpackUNorm24(uint32_t(Element[0]) | uint32_t(Element[1]) << 8 | uint32_t(Element[2]) << 16);
+					break;
+				default:
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool ConvertCaptureView(const FCaptureView& View, FCaptureImage& OutImage)
+{
+	OutImage.Resize(int32_t(View.Shape[1]), int32_t(View.Shape[0]), GetCaptureViewNumPlanes(View));
+	return ConvertCaptureViewToPlanes(View, OutImage.Data.data());
+}
+
+bool LoadCaptureImage(const FCaptureReader& Reader, uint32_t FrameIndex, const char* Layer, const char* Component,
+	FCaptureImage& OutImage, std::vector<uint8_t>& DecodeBuffer)
+{
+	FCaptureView View;
+	return Reader.GetView(FrameIndex, Layer, Component, View, &DecodeBuffer) && ConvertCaptureView(View, OutImage);
+}
+
+namespace
+{
+
+FCaptureView MakeCaptureView(const FCaptureViewC& ViewC)
+{
+	FCaptureView View;
+	View.Data = (const uint8_t*)ViewC.Data;
+	memcpy(View.Shape, ViewC.Shape, sizeof(View.Shape));
+	memcpy(View.Strides, ViewC.Strides, sizeof(View.Strides));
+	View.ElementType = ECaptureElementType(ViewC.ElementType);
+	View.FrameId = ViewC.FrameId;
+	View.PixelFormat = ViewC.PixelFormat;
+	return View;
+}
+
+} //! namespace
+
+CAPTURE_READER_API int32_t CaptureReaderNumFloatPlanes(const FCaptureViewC* View)
+{
+	return GetCaptureViewNumPlanes(MakeCaptureView(*View));
+}
+
+CAPTURE_READER_API int32_t CaptureReaderConvertToFloat(const FCaptureViewC* View, float* Dest)
+{
+	return ConvertCaptureViewToPlanes(MakeCaptureView(*View), Dest) ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FCaptureReader;
+struct FCaptureView;
+
+/**
+ * Planar float image for the offline CPU kernels: every channel is a Width * Height plane, one after the other, so
+ * a row of any channel is contiguous for SIMD loads and gathers index one plane with one offset. Data holds
+ * ImagePadding spare floats past the last plane so eight lane loads starting anywhere in it stay inside.
+ */
+struct FCaptureImage
+{
+	static constexpr size_t ImagePadding = 8;
+
+	int32_t Width = 0;
+	int32_t Height = 0;
+	int32_t NumChannels = 0;
+	std::vector<float> Data;
+
+	/** Reallocates only when the size grows; the contents are left as they are. */
+	void Resize(int32_t InWidth, int32_t InHeight, int32_t InNumChannels);
+
+	bool IsEmpty() const { return Width <= 0 || Height <= 0 || NumChannels <= 0; }
+	size_t GetPlaneSize() const { return size_t(Width) * size_t(Height); }
+
+	float* GetPlane(int32_t Channel) { return Data.data() + size_t(Channel) * GetPlaneSize(); }
+	const float* GetPlane(int32_t Channel) const { return Data.data() + size_t(Channel) * GetPlaneSize(); }
+};
+
+/** Planes a view converts to: its channels, or red, green and blue for a FloatR11G11B10 view. */
+int32_t GetCaptureViewNumPlanes(const FCaptureView& View);
+
+/**
+ * Converts a view into GetCaptureViewNumPlanes() planes of Width * Height floats, one after the other at Dest. Half
+ * and float elements are taken as they are (halves through CaptureHalf.h), unsigned normalized ones (UInt8, UInt16
+ * as in G16R16 velocity, UNorm24 depth) are scaled to [0, 1], and a FloatR11G11B10 view is unpacked into red,
+ * green and blue. Returns false for an element type with no float meaning.
+ */
+bool ConvertCaptureViewToPlanes(const FCaptureView& View, float* Dest);
+
+/** ConvertCaptureViewToPlanes() into OutImage, one plane per channel. */
+bool ConvertCaptureView(const FCaptureView& View, FCaptureImage& OutImage);
+
+/** GetView() followed by ConvertCaptureView(). False when the frame has no such layer. */
+bool LoadCaptureImage(const FCaptureReader& Reader, uint32_t FrameIndex, const char* Layer, const char* Component,
+	FCaptureImage& OutImage, std::vector<uint8_t>& DecodeBuffer);
@@ -0,0 +1,783 @@
+#include "CaptureMetrics.h"
+
+#include "CaptureSimd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+
+/** DecodeVelocityFromTexture() of 4.26, in its MAD form, as in CaptureTAAGen4.cpp. */
+constexpr float VelocityScale = 1.0f / (0.499f * 0.5f);
+constexpr float VelocityBias = 32767.0f / 65535.0f * VelocityScale;
+
+/** Planes of one image in FCaptureMetrics::Tonemapped; the reference's follow the test's. */
+enum ETonemappedPlane : int32_t
+{
+	/** Y of XYZ, which the achromatic channel of YCxCz, 116 Y - 16, only scales. */
+	Plane_Luminance,
+	Plane_OpponentCx,
+	Plane_OpponentCz,
+	Plane_Count
+};
+
+/** Linear sRGB (Rec. 709 primaries, D65) to XYZ, and back. */
+constexpr float RGBToXYZ[3][3] =
+{
+	{ 0.4124564f, 0.3575761f, 0.1804375f },
+	{ 0.2126729f, 0.7151522f, 0.0721750f },
+	{ 0.0193339f, 0.1191920f, 0.9503041f },
+};
+constexpr float XYZToRGB[3][3] =
+{
+	{ 3.2404542f, -1.5371385f, -0.4985314f },
+	{ -0.9692660f, 1.8760108f, 0.0415560f },
+	{ 0.0556434f, -0.2040259f, 1.0572252f },
+};
+
+/** D65 reference white of the opponent and L*a*b* spaces. */
+constexpr float WhiteX = 0.950428545f;
+constexpr float WhiteZ = 1.088900371f;
+
+/** MS-SSIM weights of the five scales and the stabilizing constants for a dynamic range of 1. */
+constexpr double SsimScaleWeights[5] = { 0.0448, 0.2856, 0.3001, 0.2363, 0.1333 };
+constexpr float SsimC1 = 0.01f * 0.01f;
+constexpr float SsimC2 = 0.03f * 0.03f;
+constexpr float SsimSigma = 1.5f;
+constexpr int32_t SsimRadius = 5;
+
+/** FLIP's color error remapping and feature exponent. */
+constexpr float FlipColorExponent = 0.7f;
+constexpr float FlipColorCutoff = 0.4f;
+constexpr float FlipColorThreshold = 0.95f;
+constexpr float FlipFeatureExponent = 0.5f;
+
+/** Calls Function(Lanes, X) over [0, Width): eight pixels at a time then one, Lanes being an FCaptureFloat8 or 1. */
+template <typename FFunction>
+void ForEachSpan(int32_t Width, bool bScalar, FFunction&& Function)
+{
+	int32_t X = 0;
+	if (!bScalar)
+	{
+		for (; X + FCaptureFloat8::Lanes <= Width; X += FCaptureFloat8::Lanes)
+		{
+			Function(FCaptureFloat8(), X);
+		}
+	}
+	for (; X < Width; X++)
+	{
+		Function(FCaptureFloat1(), X);
+	}
+}
+
+/** Adds the lanes to Sum one after the other, so that eight lanes sum like eight single pixels. */
+template <typename V>
+void AddLanes(double& Sum, V Value)
+{
+	float Values[8];
+	Value.StorePartial(Values, V::Lanes);
+	for (int32_t Lane = 0; Lane < V::Lanes; Lane++)
+	{
+		Sum += Values[Lane];
+	}
+}
+
+/** Runs Function(Row, Sums) over every row and adds each row's NumSums sums up in row order into OutTotals. */
+template <typename FFunction>
+void SumRows(FCaptureParallelPool& Pool, std::vector<double>& RowSums, int32_t Height, int32_t NumSums, double* OutTotals, FFunction&& Function)
+{
+	RowSums.assign(size_t(Height) * NumSums, 0.0);
+	Pool.ParallelFor(uint32_t(Height), [&](uint32_t Row)
+	{
+		Function(int32_t(Row), RowSums.data() + size_t(Row) * NumSums);
+	});
+	for (int32_t Sum = 0; Sum < NumSums; Sum++)
+	{
+		OutTotals[Sum] = 0.0;
+	}
+	for (int32_t Row = 0; Row < Height; Row++)
+	{
+		for (int32_t Sum = 0; Sum < NumSums; Sum++)
+		{
+			OutTotals[Sum] += RowSums[size_t(Row) * NumSums + Sum];
+		}
+	}
+}
+
+/** Normalized Gaussian of Sigma pixels over 3 sigma. */
+std::vector<float> MakeGaussianTaps(float Sigma)
+{
+	const int32_t Radius = std::max(int32_t(std::ceil(3.0f * Sigma)), 1);
+	std::vector<float> Taps(size_t(2 * Radius + 1));
+	double Sum = 0.0;
+	for (int32_t Offset = -Radius; Offset <= Radius; Offset++)
+	{
+		Taps[size_t(Offset + Radius)] = std::exp(-float(Offset * Offset) / (2.0f * Sigma * Sigma));
+		Sum += Taps[size_t(Offset + Radius)];
+	}
+	for (float& Tap : Taps)
+	{
+		Tap = float(Tap / Sum);
+	}
+	return Taps;
+}
+
+/**
+ * First (Order 1) or second (Order 2) derivative of a Gaussian of Sigma pixels, FLIP's edge and point detectors:
+ * the positive taps sum to 1 and the negative ones to -1.
+ */
+std::vector<float> MakeGaussianDerivativeTaps(float Sigma, int32_t Order)
+{
+	const int32_t Radius = std::max(int32_t(std::ceil(3.0f * Sigma)), 1);
+	std::vector<float> Taps(size_t(2 * Radius + 1));
+	double Positive = 0.0;
+	double Negative = 0.0;
+	for (int32_t Offset = -Radius; Offset <= Radius; Offset++)
+	{
+		const float X = float(Offset);
+		const float Gaussian = std::exp(-X * X / (2.0f * Sigma * Sigma));
+		const float Tap = Order == 1 ? -X * Gaussian : (X * X / (Sigma * Sigma) - 1.0f) * Gaussian;
+		Taps[size_t(Offset + Radius)] = Tap;
+		(Tap > 0.0f ? Positive : Negative) += Tap;
+	}
+	for (float& Tap : Taps)
+	{
+		Tap = Tap > 0.0f ? float(Tap / Positive) : Tap < 0.0f ? float(Tap / -Negative) : 0.0f;
+	}
+	return Taps;
+}
+
+/**
+ * Approximations of log2 and exp2 for the transcendental parts of FLIP, within 1e-6 relative: a series of the
+ * mantissa for one, a polynomial of the fraction for the other. The same arithmetic in both widths, so one and
+ * eight lanes still give the same bits. Log2 takes positive normal floats, 0 and denormals come out near -127.
+ */
+template <typename V>
+V Log2(V X)
+{
+	using I = typename V::FInt;
+	const I Bits = AsInt(X);
+	const V Exponent = ToFloat((ShiftRight(Bits, 23) & I::Splat(255)) - I::Splat(127));
+	const V Mantissa = AsFloat((Bits & I::Splat(0x007FFFFF)) | I::Splat(0x3F800000));
+
+	// ln(m) = 2 atanh((m - 1) / (m + 1)), t below 1/3.
+	const V T = (Mantissa - V::Splat(1.0f)) / (Mantissa + V::Splat(1.0f));
+	const V T2 = T * T;
+	V Series = V::Splat(1.0f / 11.0f);
+	Series = Series * T2 + V::Splat(1.0f / 9.0f);
+	Series = Series * T2 + V::Splat(1.0f / 7.0f);
+	Series = Series * T2 + V::Splat(1.0f / 5.0f);
+	Series = Series * T2 + V::Splat(1.0f / 3.0f);
+	Series = Series * T2 + V::Splat(1.0f);
+	return Exponent + Series * T * V::Splat(2.0f / 0.693147181f);
+}
+
+template <typename V>
+V Exp2(V X)
+{
+	using I = typename V::FInt;
+	X = Clamp(X, V::Splat(-126.0f), V::Splat(127.0f));
+	const V Whole = Floor(X + V::Splat(0.5f));
+	const V Fraction = (X - Whole) * V::Splat(0.693147181f);
+
+	// e^f for f within +-ln(2) / 2.
+	V Poly = V::Splat(1.0f / 720.0f);
+	Poly = Poly * Fraction + V::Splat(1.0f / 120.0f);
+	Poly = Poly * Fraction + V::Splat(1.0f / 24.0f);
+	Poly = Poly * Fraction + V::Splat(1.0f / 6.0f);
+	Poly = Poly * Fraction + V::Splat(0.5f);
+	Poly = Poly * Fraction + V::Splat(1.0f);
+	Poly = Poly * Fraction + V::Splat(1.0f);
+	return Poly * AsFloat((ToInt(Whole) + I::Splat(127)) * I::Splat(1 << 23));
+}
+
+/** Base raised to Exponent for Base >= 0, 0 for a base of 0. */
+template <typename V>
+V Pow(V Base, V Exponent)
+{
+	const V Zero = V::Splat(0.0f);
+	return Select(Base > Zero, Exp2(Exponent * Log2(Base)), Zero);
+}
+
+/** The f() of CIE L*a*b*. */
+template <typename V>
+V LabCurve(V T)
+{
+	constexpr float Delta = 6.0f / 29.0f;
+	const V Cube = Exp2(Log2(T) * V::Splat(1.0f / 3.0f));
+	return Select(T > V::Splat(Delta * Delta * Delta), Cube, T * V::Splat(1.0f / (3.0f * Delta * Delta)) + V::Splat(4.0f / 29.0f));
+}
+
+template <typename V>
+void LinearRGBToLab(const V RGB[3], V OutLab[3])
+{
+	V XYZ[3];
+	for (int32_t Row = 0; Row < 3; Row++)
+	{
+		XYZ[Row] = V::Splat(RGBToXYZ[Row][0]) * RGB[0] + V::Splat(RGBToXYZ[Row][1]) * RGB[1] + V::Splat(RGBToXYZ[Row][2]) * RGB[2];
+	}
+	const V FX = LabCurve(XYZ[0] * V::Splat(1.0f / WhiteX));
+	const V FY = LabCurve(XYZ[1]);
+	const V FZ = LabCurve(XYZ[2] * V::Splat(1.0f / WhiteZ));
+	OutLab[0] = V::Splat(116.0f) * FY - V::Splat(16.0f);
+	OutLab[1] = V::Splat(500.0f) * (FX - FY);
+	OutLab[2] = V::Splat(200.0f) * (FY - FZ);
+}
+
+/** Clamped linear RGB of a filtered YCxCz color, its achromatic channel as luminance, in L*a*b*. */
+template <typename V>
+void OpponentToLab(V Luminance, V Cx, V Cz, V OutLab[3])
+{
+	const V XYZ[3] = { V::Splat(WhiteX) * (Cx * V::Splat(1.0f / 500.0f) + Luminance), Luminance, V::Splat(WhiteZ) * (Luminance - Cz * V::Splat(1.0f / 200.0f)) };
+	V RGB[3];
+	for (int32_t Row = 0; Row < 3; Row++)
+	{
+		RGB[Row] = Clamp(V::Splat(XYZToRGB[Row][0]) * XYZ[0] + V::Splat(XYZToRGB[Row][1]) * XYZ[1] + V::Splat(XYZToRGB[Row][2]) * XYZ[2],
+			V::Splat(0.0f), V::Splat(1.0f));
+	}
+	LinearRGBToLab(RGB, OutLab);
+}
+
+template <typename V>
+V HyAB(const V A[3], const V B[3])
+{
+	const V DA = A[1] - B[1];
+	const V DB = A[2] - B[2];
+	return Abs(A[0] - B[0]) + Sqrt(DA * DA + DB * DB);
+}
+
+/** Everything the FLIP error of a span needs, set up once per frame. */
+struct FFlipContext
+{
+	/** Filtered luminance, Cx and Cz, then edge X, edge Y, point X and point Y, of the test and of the reference. */
+	const float* Opponent[2][3] = {};
+	const float* Features[2][4] = {};
+	float MaxError = 1.0f;
+	float* Map = nullptr;
+};
+
+template <typename V>
+void FlipSpan(const FFlipContext& C, size_t Index, double* Sums)
+{
+	V Lab[2][3];
+	V Edges[2];
+	V Points[2];
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		OpponentToLab(V::Load(C.Opponent[Image][0] + Index), V::Load(C.Opponent[Image][1] + Index), V::Load(C.Opponent[Image][2] + Index), Lab[Image]);
+		const V EdgeX = V::Load(C.Features[Image][0] + Index);
+		const V EdgeY = V::Load(C.Features[Image][1] + Index);
+		const V PointX = V::Load(C.Features[Image][2] + Index);
+		const V PointY = V::Load(C.Features[Image][3] + Index);
+		Edges[Image] = Sqrt(EdgeX * EdgeX + EdgeY * EdgeY);
+		Points[Image] = Sqrt(PointX * PointX + PointY * PointY);
+	}
+
+	// HyAB^0.7 remapped: linear up to FlipColorThreshold at FlipColorCutoff of the largest error, compressed above.
+	const V One = V::Splat(1.0f);
+	const V Cutoff = V::Splat(FlipColorCutoff * C.MaxError);
+	const V Power = Pow(HyAB(Lab[0], Lab[1]), V::Splat(FlipColorExponent));
+	const V Low = Power * V::Splat(FlipColorThreshold / (FlipColorCutoff * C.MaxError));
+	const V High = V::Splat(FlipColorThreshold) + (Power - Cutoff) * V::Splat((1.0f - FlipColorThreshold) / (C.MaxError - FlipColorCutoff * C.MaxError));
+	const V ColorError = Min(Select(Power < Cutoff, Low, High), One);
+
+	const V FeatureDifference = Max(Abs(Edges[0] - Edges[1]), Abs(Points[0] - Points[1]));
+	const V FeatureError = Min(Pow(FeatureDifference * V::Splat(0.707106781f), V::Splat(FlipFeatureExponent)), One);
+
+	const V Flip = Pow(ColorError, One - FeatureError);
+	Flip.Store(C.Map + Index);
+	AddLanes(Sums[0], Flip);
+}
+
+/** Tonemaps a span of both images into luminance, Cx and Cz; sums the RGB errors. */
+template <typename V>
+void TonemapSpan(const FCaptureImage& Test, const FCaptureImage& Reference, FCaptureImage& Tonemapped, float Exposure, size_t Index, double* Sums)
+{
+	const V Zero = V::Splat(0.0f);
+	const V One = V::Splat(1.0f);
+	V Colors[2][3];
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		const FCaptureImage& Source = Image ? Reference : Test;
+		float* const Base = Tonemapped.GetPlane(Image * Plane_Count);
+		const size_t PlaneSize = Tonemapped.GetPlaneSize();
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			// NaN goes to 0 through Max, infinities to 1 through Min.
+			const V Value = Min(Max(V::Load(Source.GetPlane(Channel) + Index) * V::Splat(Exposure), Zero), V::Splat(FLT_MAX));
+			Colors[Image][Channel] = Value / (One + Value);
+		}
+
+		V XYZ[3];
+		for (int32_t Row = 0; Row < 3; Row++)
+		{
+			XYZ[Row] = V::Splat(RGBToXYZ[Row][0]) * Colors[Image][0] + V::Splat(RGBToXYZ[Row][1]) * Colors[Image][1] + V::Splat(RGBToXYZ[Row][2]) * Colors[Image][2];
+		}
+		XYZ[1].Store(Base + Plane_Luminance * PlaneSize + Index);
+		(V::Splat(500.0f) * (XYZ[0] / V::Splat(WhiteX) - XYZ[1])).Store(Base + Plane_OpponentCx * PlaneSize + Index);
+		(V::Splat(200.0f) * (XYZ[1] - XYZ[2] / V::Splat(WhiteZ))).Store(Base + Plane_OpponentCz * PlaneSize + Index);
+	}
+
+	// A sum per channel, so that every sum takes the pixels in order with any number of lanes.
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const V Difference = Colors[0][Channel] - Colors[1][Channel];
+		AddLanes(Sums[Channel], Abs(Difference));
+		AddLanes(Sums[3 + Channel], Difference * Difference);
+	}
+}
+
+/** Horizontal pass of a separable filter over a row; the borders clamp. */
+template <typename V>
+void FilterSpanHorizontal(const float* Source, float* Dest, int32_t Width, int32_t X, const std::vector<float>& Taps)
+{
+	const int32_t Radius = int32_t(Taps.size() / 2);
+	V Sum = V::Splat(0.0f);
+	if (X >= Radius && X + V::Lanes + Radius <= Width)
+	{
+		for (int32_t Tap = 0; Tap < int32_t(Taps.size()); Tap++)
+		{
+			Sum = Sum + V::Splat(Taps[size_t(Tap)]) * V::Load(Source + X + Tap - Radius);
+		}
+	}
+	else
+	{
+		float Values[8];
+		for (int32_t Tap = 0; Tap < int32_t(Taps.size()); Tap++)
+		{
+			for (int32_t Lane = 0; Lane < V::Lanes; Lane++)
+			{
+				Values[Lane] = Source[std::min(std::max(X + Lane + Tap - Radius, 0), Width - 1)];
+			}
+			Sum = Sum + V::Splat(Taps[size_t(Tap)]) * V::Load(Values);
+		}
+	}
+	Sum.Store(Dest + X);
+}
+
+/** Vertical pass of a separable filter over a row; the borders clamp. */
+template <typename V>
+void FilterSpanVertical(const float* Source, float* Dest, int32_t Width, int32_t Height, int32_t Y, int32_t X, const std::vector<float>& Taps)
+{
+	const int32_t Radius = int32_t(Taps.size() / 2);
+	V Sum = V::Splat(0.0f);
+	for (int32_t Tap = 0; Tap < int32_t(Taps.size()); Tap++)
+	{
+		const int32_t SourceY = std::min(std::max(Y + Tap - Radius, 0), Height - 1);
+		Sum = Sum + V::Splat(Taps[size_t(Tap)]) * V::Load(Source + size_t(SourceY) * Width + X);
+	}
+	Sum.Store(Dest + size_t(Y) * Width + X);
+}
+
+/** SSIM of a span from the filtered moments; sums cs and l * cs, and writes the DSSIM map when there is one. */
+template <typename V>
+void SsimSpan(const float* const* Moments, size_t Index, float* DssimMap, double* Sums)
+{
+	const V MeanX = V::Load(Moments[0] + Index);
+	const V MeanY = V::Load(Moments[1] + Index);
+	const V VarianceX = V::Load(Moments[2] + Index) - MeanX * MeanX;
+	const V VarianceY = V::Load(Moments[3] + Index) - MeanY * MeanY;
+	const V Covariance = V::Load(Moments[4] + Index) - MeanX * MeanY;
+	const V Two = V::Splat(2.0f);
+	const V Luminance = (Two * MeanX * MeanY + V::Splat(SsimC1)) / (MeanX * MeanX + MeanY * MeanY + V::Splat(SsimC1));
+	const V ContrastStructure = (Two * Covariance + V::Splat(SsimC2)) / (VarianceX + VarianceY + V::Splat(SsimC2));
+	const V Ssim = Luminance * ContrastStructure;
+	AddLanes(Sums[0], ContrastStructure);
+	AddLanes(Sums[1], Ssim);
+	if (DssimMap)
+	{
+		((V::Splat(1.0f) - Ssim) * V::Splat(0.5f)).Store(DssimMap + Index);
+	}
+}
+
+/** Everything the flicker of a span needs, set up once per frame. */
+struct FFlickerContext
+{
+	const float* Current[2] = {};
+	const float* Previous[2] = {};
+	const float* Velocity[2] = {};
+	int32_t VelocityWidth = 0;
+	int32_t VelocityHeight = 0;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	float* Map = nullptr;
+};
+
+/** Bilinear sample of a plane at pixel coordinates already clamped to [0, Size - 1]. */
+template <typename V>
+V SampleBilinear(const float* Plane, int32_t Width, typename V::FInt X0, typename V::FInt Y0, V FracX, V FracY)
+{
+	using I = typename V::FInt;
+	const I Index = Y0 * I::Splat(Width) + X0;
+	const V Top00 = GatherNear(Plane, Index);
+	const V Top10 = GatherNear(Plane, Index + I::Splat(1));
+	const V Bottom01 = GatherNear(Plane, Index + I::Splat(Width));
+	const V Bottom11 = GatherNear(Plane, Index + I::Splat(Width + 1));
+	const V Top = Top00 + (Top10 - Top00) * FracX;
+	const V Bottom = Bottom01 + (Bottom11 - Bottom01) * FracX;
+	return Top + (Bottom - Top) * FracY;
+}
+
+template <typename V>
+void FlickerSpan(const FFlickerContext& C, int32_t Y, int32_t X, double* Sums)
+{
+	using I = typename V::FInt;
+	const V Zero = V::Splat(0.0f);
+	const V Half = V::Splat(0.5f);
+	const V PixelX = ToFloat(I::Splat(X) + I::Ramp()) + Half;
+	const V PixelY = V::Splat(float(Y) + 0.5f);
+
+	V VelocityX = Zero;
+	V VelocityY = Zero;
+	if (C.Velocity[0])
+	{
+		const I VelocityPixelX = Min(ToInt(PixelX * V::Splat(float(C.VelocityWidth) / float(C.Width))), I::Splat(C.VelocityWidth - 1));
+		const int32_t VelocityPixelY = std::min(int32_t((float(Y) + 0.5f) * float(C.VelocityHeight) / float(C.Height)), C.VelocityHeight - 1);
+		const I Index = I::Splat(VelocityPixelY * C.VelocityWidth) + VelocityPixelX;
+		const V EncodedX = GatherNear(C.Velocity[0], Index);
+		const V EncodedY = GatherNear(C.Velocity[1], Index);
+		const typename V::FMask bHasVelocity = EncodedX > Zero;
+		VelocityX = Select(bHasVelocity, EncodedX * V::Splat(VelocityScale) - V::Splat(VelocityBias), Zero);
+		VelocityY = Select(bHasVelocity, EncodedY * V::Splat(VelocityScale) - V::Splat(VelocityBias), Zero);
+	}
+
+	// Screen position to the previous frame's pixel coordinates, Y up on screen and down in the image.
+	const V Width = V::Splat(float(C.Width));
+	const V Height = V::Splat(float(C.Height));
+	const V PreviousX = PixelX - VelocityX * Half * Width - Half;
+	const V PreviousY = PixelY + VelocityY * Half * Height - Half;
+	const typename V::FMask bOnScreen = PreviousX >= V::Splat(-0.5f) && V::Splat(float(C.Width) - 0.5f) >= PreviousX
+		&& PreviousY >= V::Splat(-0.5f) && V::Splat(float(C.Height) - 0.5f) >= PreviousY;
+
+	const V ClampedX = Clamp(PreviousX, Zero, V::Splat(float(C.Width - 1)));
+	const V ClampedY = Clamp(PreviousY, Zero, V::Splat(float(C.Height - 1)));
+	const I X0 = Min(ToInt(ClampedX), I::Splat(C.Width - 2));
+	const I Y0 = Min(ToInt(ClampedY), I::Splat(C.Height - 2));
+	const V FracX = ClampedX - ToFloat(X0);
+	const V FracY = ClampedY - ToFloat(Y0);
+
+	const size_t Index = size_t(Y) * C.Width + X;
+	V Changes[2];
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		const V Previous = SampleBilinear<V>(C.Previous[Image], C.Width, X0, Y0, FracX, FracY);
+		Changes[Image] = Select(bOnScreen, Abs(V::Load(C.Current[Image] + Index) - Previous), Zero);
+	}
+	const V Excess = Max(Changes[0] - Changes[1], Zero);
+	Excess.Store(C.Map + Index);
+
+	AddLanes(Sums[0], Select(bOnScreen, V::Splat(1.0f), Zero));
+	AddLanes(Sums[1], Changes[0]);
+	AddLanes(Sums[2], Changes[1]);
+	AddLanes(Sums[3], Excess);
+}
+
+} //! namespace
+
+FCaptureMetrics::FCaptureMetrics(const FCaptureMetricsSettings& InSettings)
+	: Settings(InSettings)
+	, Pool(new FCaptureParallelPool(InSettings.NumThreads))
+{
+}
+
+void FCaptureMetrics::Reset()
+{
+	bHasPrevious = false;
+}
+
+void FCaptureMetrics::FilterRows(const float* const* Sources, float* Dest, int32_t Count, int32_t Width, int32_t Height, const std::vector<float>& Taps)
+{
+	const size_t PlaneSize = size_t(Width) * Height;
+	const bool bScalar = Settings.bScalar;
+	Pool->ParallelFor(uint32_t(Count * Height), [&](uint32_t Item)
+	{
+		const int32_t Plane = int32_t(Item) / Height;
+		const int32_t Y = int32_t(Item) % Height;
+		const float* SourceRow = Sources[Plane] + size_t(Y) * Width;
+		float* DestRow = Dest + Plane * PlaneSize + size_t(Y) * Width;
+		ForEachSpan(Width, bScalar, [&](auto Lanes, int32_t X)
+		{
+			FilterSpanHorizontal<decltype(Lanes)>(SourceRow, DestRow, Width, X, Taps);
+		});
+	});
+}
+
+void FCaptureMetrics::FilterColumns(const float* Source, float* const* Dests, int32_t Count, int32_t Width, int32_t Height, const std::vector<float>& Taps)
+{
+	const size_t PlaneSize = size_t(Width) * Height;
+	const bool bScalar = Settings.bScalar;
+	Pool->ParallelFor(uint32_t(Count * Height), [&](uint32_t Item)
+	{
+		const int32_t Plane = int32_t(Item) / Height;
+		const int32_t Y = int32_t(Item) % Height;
+		ForEachSpan(Width, bScalar, [&](auto Lanes, int32_t X)
+		{
+			FilterSpanVertical<decltype(Lanes)>(Source + Plane * PlaneSize, Dests[Plane], Width, Height, Y, X, Taps);
+		});
+	});
+}
+
+bool FCaptureMetrics::Compare(const FCaptureImage& Test, const FCaptureImage& Reference, const FCaptureImage* Velocity, bool bCameraCut,
+	FCaptureFrameMetrics& OutMetrics)
+{
+	if (Test.IsEmpty() || Test.NumChannels < 3 || Reference.NumChannels < 3 || Test.Width != Reference.Width || Test.Height != Reference.Height)
+	{
+		return false;
+	}
+
+	const int32_t Width = Test.Width;
+	const int32_t Height = Test.Height;
+	OutMetrics = FCaptureFrameMetrics();
+
+	Tonemapped.Resize(Width, Height, 2 * Plane_Count);
+	const float Exposure = Settings.Exposure;
+	const bool bScalar = Settings.bScalar;
+	double ErrorSums[6];
+	SumRows(*Pool, RowSums, Height, 6, ErrorSums, [&](int32_t Y, double* Sums)
+	{
+		ForEachSpan(Width, bScalar, [&](auto Lanes, int32_t X)
+		{
+			TonemapSpan<decltype(Lanes)>(Test, Reference, Tonemapped, Exposure, size_t(Y) * Width + X, Sums);
+		});
+	});
+	const double Count = double(Test.GetPlaneSize()) * 3.0;
+	const double SumAbs = ErrorSums[0] + ErrorSums[1] + ErrorSums[2];
+	const double SumSquares = ErrorSums[3] + ErrorSums[4] + ErrorSums[5];
+	OutMetrics.MeanError = SumAbs / Count;
+	OutMetrics.Psnr = SumSquares > 0.0 ? 10.0 * std::log10(Count / SumSquares) : INFINITY;
+
+	ComputeFlip(Width, Height, OutMetrics);
+	ComputeMsSsim(Width, Height, OutMetrics);
+
+	const bool bTemporal = !bCameraCut && bHasPrevious && Previous.Width == Width && Previous.Height == Height && Width > 1 && Height > 1;
+	Maps.Flicker.Resize(Width, Height, 1);
+	if (bTemporal)
+	{
+		ComputeFlicker(Velocity, Width, Height, OutMetrics);
+	}
+	else
+	{
+		std::fill(Maps.Flicker.Data.begin(), Maps.Flicker.Data.begin() + Maps.Flicker.GetPlaneSize(), 0.0f);
+	}
+
+	Previous.Resize(Width, Height, 2);
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		const float* Luminance = Tonemapped.GetPlane(Image * Plane_Count + Plane_Luminance);
+		std::copy(Luminance, Luminance + Tonemapped.GetPlaneSize(), Previous.GetPlane(Image));
+	}
+	bHasPrevious = true;
+	return true;
+}
+
+void FCaptureMetrics::ComputeFlip(int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics)
+{
+	const size_t PlaneSize = size_t(Width) * Height;
+	const float PixelsPerDegree = Settings.PixelsPerDegree;
+
+	// Contrast sensitivity of each opponent channel as a Gaussian a * sqrt(pi / b) * exp(-pi^2 x^2 / b) over degrees:
+	// sigma = sqrt(b / 2) / pi, with the b of FLIP's achromatic, red-green and main blue-yellow terms.
+	const float CsfB[3] = { 0.0047f, 0.0053f, 0.04f };
+	const float Pi = 3.14159265f;
+
+	// Scratch: the filtered opponent planes of both images, then the edges and points of both luminances.
+	Scratch.Resize(Width, Height, 14);
+	FilterTemp.Resize(Width, Height, 6);
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const std::vector<float> Taps = MakeGaussianTaps(std::sqrt(CsfB[Channel] / 2.0f) / Pi * PixelsPerDegree);
+		const float* Sources[2] = { Tonemapped.GetPlane(Channel), Tonemapped.GetPlane(Plane_Count + Channel) };
+		float* Dests[2] = { Scratch.GetPlane(Channel), Scratch.GetPlane(3 + Channel) };
+		FilterRows(Sources, FilterTemp.GetPlane(0), 2, Width, Height, Taps);
+		FilterColumns(FilterTemp.GetPlane(0), Dests, 2, Width, Height, Taps);
+	}
+
+	// Edges and points: first and second Gaussian derivatives along each axis, smoothed across it. The three
+	// horizontal passes of both luminances are shared by the four vertical ones.
+	const float FeatureSigma = 0.5f * 0.082f * PixelsPerDegree;
+	const std::vector<float> Smooth = MakeGaussianTaps(FeatureSigma);
+	const std::vector<float> Edge = MakeGaussianDerivativeTaps(FeatureSigma, 1);
+	const std::vector<float> Point = MakeGaussianDerivativeTaps(FeatureSigma, 2);
+	const float* Luminances[2] = { Tonemapped.GetPlane(Plane_Luminance), Tonemapped.GetPlane(Plane_Count + Plane_Luminance) };
+	FilterRows(Luminances, FilterTemp.GetPlane(0), 2, Width, Height, Smooth);
+	FilterRows(Luminances, FilterTemp.GetPlane(2), 2, Width, Height, Edge);
+	FilterRows(Luminances, FilterTemp.GetPlane(4), 2, Width, Height, Point);
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		// Edge X, edge Y, point X and point Y of each image.
+		float* EdgeX[1] = { Scratch.GetPlane(6 + 4 * Image) };
+		float* EdgeY[1] = { Scratch.GetPlane(7 + 4 * Image) };
+		float* PointX[1] = { Scratch.GetPlane(8 + 4 * Image) };
+		float* PointY[1] = { Scratch.GetPlane(9 + 4 * Image) };
+		FilterColumns(FilterTemp.GetPlane(2 + Image), EdgeX, 1, Width, Height, Smooth);
+		FilterColumns(FilterTemp.GetPlane(Image), EdgeY, 1, Width, Height, Edge);
+		FilterColumns(FilterTemp.GetPlane(4 + Image), PointX, 1, Width, Height, Smooth);
+		FilterColumns(FilterTemp.GetPlane(Image), PointY, 1, Width, Height, Point);
+	}
+
+	// The largest color difference, green against blue, normalizes the HyAB distance.
+	FCaptureFloat1 GreenLab[3];
+	FCaptureFloat1 BlueLab[3];
+	const FCaptureFloat1 Green[3] = { { 0.0f }, { 1.0f }, { 0.0f } };
+	const FCaptureFloat1 Blue[3] = { { 0.0f }, { 0.0f }, { 1.0f } };
+	LinearRGBToLab(Green, GreenLab);
+	LinearRGBToLab(Blue, BlueLab);
+
+	FFlipContext C;
+	C.MaxError = Pow(HyAB(GreenLab, BlueLab), FCaptureFloat1::Splat(FlipColorExponent)).V;
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			C.Opponent[Image][Channel] = Scratch.GetPlane(3 * Image + Channel);
+		}
+		for (int32_t Feature = 0; Feature < 4; Feature++)
+		{
+			C.Features[Image][Feature] = Scratch.GetPlane(6 + 4 * Image + Feature);
+		}
+	}
+	Maps.Flip.Resize(Width, Height, 1);
+	C.Map = Maps.Flip.Data.data();
+
+	const bool bScalar = Settings.bScalar;
+	double FlipSum;
+	SumRows(*Pool, RowSums, Height, 1, &FlipSum, [&](int32_t Y, double* Sums)
+	{
+		ForEachSpan(Width, bScalar, [&](auto Lanes, int32_t X)
+		{
+			FlipSpan<decltype(Lanes)>(C, size_t(Y) * Width + X, Sums);
+		});
+	});
+	OutMetrics.Flip = FlipSum / double(PlaneSize);
+}
+
+void FCaptureMetrics::ComputeMsSsim(int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics)
+{
+	const std::vector<float> Taps = MakeGaussianTaps(SsimSigma);
+	const int32_t FilterSize = 2 * SsimRadius + 1;
+	int32_t NumScales = 1;
+	while (NumScales < std::min(Settings.NumSsimScales, 5) && std::min(Width >> NumScales, Height >> NumScales) >= FilterSize)
+	{
+		NumScales++;
+	}
+
+	// Scratch: the luminances of the scale, their products, then the five filtered moments.
+	const size_t FullPlaneSize = size_t(Width) * Height;
+	Scratch.Resize(Width, Height, 10);
+	std::copy(Tonemapped.GetPlane(Plane_Luminance), Tonemapped.GetPlane(Plane_Luminance) + FullPlaneSize, Scratch.GetPlane(0));
+	std::copy(Tonemapped.GetPlane(Plane_Count + Plane_Luminance), Tonemapped.GetPlane(Plane_Count + Plane_Luminance) + FullPlaneSize, Scratch.GetPlane(1));
+	Maps.Dssim.Resize(Width, Height, 1);
+
+	double WeightSum = 0.0;
+	for (int32_t Scale = 0; Scale < NumScales; Scale++)
+	{
+		WeightSum += SsimScaleWeights[Scale];
+	}
+
+	const bool bScalar = Settings.bScalar;
+	double LogMsSsim = 0.0;
+	bool bNonPositive = false;
+	int32_t ScaleWidth = Width;
+	int32_t ScaleHeight = Height;
+	for (int32_t Scale = 0; Scale < NumScales; Scale++)
+	{
+		float* const Base = Scratch.Data.data();
+		const size_t PlaneSize = size_t(ScaleWidth) * ScaleHeight;
+		float* Planes[10];
+		for (int32_t Plane = 0; Plane < 10; Plane++)
+		{
+			Planes[Plane] = Base + Plane * FullPlaneSize;
+		}
+
+		Pool->ParallelFor(uint32_t(ScaleHeight), [&](uint32_t Row)
+		{
+			const size_t Begin = size_t(Row) * ScaleWidth;
+			for (size_t Index = Begin; Index < Begin + ScaleWidth; Index++)
+			{
+				Planes[2][Index] = Planes[0][Index] * Planes[0][Index];
+				Planes[3][Index] = Planes[1][Index] * Planes[1][Index];
+				Planes[4][Index] = Planes[0][Index] * Planes[1][Index];
+			}
+		});
+		FilterTemp.Resize(ScaleWidth, ScaleHeight, 5);
+		FilterRows(Planes, FilterTemp.GetPlane(0), 5, ScaleWidth, ScaleHeight, Taps);
+		FilterColumns(FilterTemp.GetPlane(0), Planes + 5, 5, ScaleWidth, ScaleHeight, Taps);
+
+		float* DssimMap = Scale == 0 ? Maps.Dssim.Data.data() : nullptr;
+		double Sums[2];
+		SumRows(*Pool, RowSums, ScaleHeight, 2, Sums, [&](int32_t Y, double* RowSum)
+		{
+			ForEachSpan(ScaleWidth, bScalar, [&](auto Lanes, int32_t X)
+			{
+				SsimSpan<decltype(Lanes)>(Planes + 5, size_t(Y) * ScaleWidth + X, DssimMap, RowSum);
+			});
+		});
+
+		// Contrast and structure at every scale but the last, which takes the whole SSIM.
+		const double Value = (Scale + 1 < NumScales ? Sums[0] : Sums[1]) / double(PlaneSize);
+		bNonPositive |= Value <= 0.0;
+		LogMsSsim += SsimScaleWeights[Scale] / WeightSum * std::log(std::max(Value, DBL_MIN));
+
+		if (Scale + 1 < NumScales)
+		{
+			// 2x2 box down to the next scale, in place since the destination never passes the source.
+			const int32_t NextWidth = ScaleWidth / 2;
+			const int32_t NextHeight = ScaleHeight / 2;
+			for (int32_t Image = 0; Image < 2; Image++)
+			{
+				float* Plane = Planes[Image];
+				for (int32_t Y = 0; Y < NextHeight; Y++)
+				{
+					for (int32_t X = 0; X < NextWidth; X++)
+					{
+						const float* Source = Plane + size_t(2 * Y) * ScaleWidth + 2 * X;
+						Plane[size_t(Y) * NextWidth + X] = (Source[0] + Source[1] + Source[ScaleWidth] + Source[ScaleWidth + 1]) * 0.25f;
+					}
+				}
+			}
+			ScaleWidth = NextWidth;
+			ScaleHeight = NextHeight;
+		}
+	}
+	OutMetrics.MsSsim = bNonPositive ? 0.0 : std::exp(LogMsSsim);
+}
+
+void FCaptureMetrics::ComputeFlicker(const FCaptureImage* Velocity, int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics)
+{
+	FFlickerContext C;
+	for (int32_t Image = 0; Image < 2; Image++)
+	{
+		C.Current[Image] = Tonemapped.GetPlane(Image * Plane_Count + Plane_Luminance);
+		C.Previous[Image] = Previous.GetPlane(Image);
+	}
+	if (Velocity && !Velocity->IsEmpty() && Velocity->NumChannels >= 2)
+	{
+		C.Velocity[0] = Velocity->GetPlane(0);
+		C.Velocity[1] = Velocity->GetPlane(1);
+		C.VelocityWidth = Velocity->Width;
+		C.VelocityHeight = Velocity->Height;
+	}
+	C.Width = Width;
+	C.Height = Height;
+	C.Map = Maps.Flicker.Data.data();
+
+	const bool bScalar = Settings.bScalar;
+	double Sums[4];
+	SumRows(*Pool, RowSums, Height, 4, Sums, [&](int32_t Y, double* RowSum)
+	{
+		ForEachSpan(Width, bScalar, [&](auto Lanes, int32_t X)
+		{
+			FlickerSpan<decltype(Lanes)>(C, Y, X, RowSum);
+		});
+	});
+
+	OutMetrics.bHasTemporal = Sums[0] > 0.0;
+	if (OutMetrics.bHasTemporal)
+	{
+		OutMetrics.TestFlicker = Sums[1] / Sums[0];
+		OutMetrics.ReferenceFlicker = Sums[2] / Sums[0];
+		OutMetrics.Flicker = Sums[3] / Sums[0];
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "CaptureImage.h"
+#include "CaptureParallel.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Image quality metrics of an upscaled or anti-aliased sequence (the TAA or DLSS "output" layers) against a
+ * reference, frame by frame:
+ *
+ *   PSNR        of the RGB, peak 1
+ *   MS-SSIM     of the luminance, 5 scales with the weights of Wang et al. 2003, 11 tap Gaussian of sigma 1.5
+ *   FLIP        a FLIP-like perceptual difference (Andersson et al. 2020): both images filtered in the YCxCz opponent
+ *               space by the contrast sensitivity of each channel, the HyAB distance of their L*a*b* colors remapped
+ *               to [0, 1], raised to 1 minus the difference of their edges and points
+ *   flicker     the change of each image from its previous frame reprojected with the captured velocity, and how much
+ *               the test changes beyond the reference does: shimmering, with disocclusions and shading changes that
+ *               the reference has too cancelled out
+ *
+ * Captures are HDR, so every metric works on x / (1 + x) tonemapped colors after Exposure. The filters clamp at
+ * the image borders and average over every pixel, where the published metrics drop the borders: the numbers are
+ * close to theirs, not equal. FLIP keeps the main Gaussian of its blue-yellow contrast sensitivity and skips the
+ * Hunt adjustment of the color error.
+ *
+ * Every pass is a row parallel kernel over an FCaptureParallelPool, eight lanes wide (CaptureSimd.h) where it is
+ * not transcendental. Sums are taken per row and added up in row order, so the results have the same bits on any
+ * number of threads, and with bScalar one pixel at a time.
+ */
+
+struct FCaptureMetricsSettings
+{
+	/** Scale of the colors before they are tonemapped, the eye adaptation exposure of the capture. */
+	float Exposure = 1.0f;
+
+	/** Viewing condition of the FLIP metric: 67 is a 0.7 m away 24" 4K monitor, FLIP's default. */
+	float PixelsPerDegree = 67.0f;
+
+	/** MS-SSIM scales, fewer when the image is too small for them. */
+	int32_t NumSsimScales = 5;
+
+	/** Worker threads including the caller, 0 for one per hardware thread. */
+	uint32_t NumThreads = 0;
+
+	/** One pixel at a time instead of eight lanes, for checking the SIMD path. */
+	bool bScalar = false;
+};
+
+/** Metrics of one frame. */
+struct FCaptureFrameMetrics
+{
+	/** Mean absolute difference of the tonemapped RGB, and its PSNR (infinite for equal images). */
+	double MeanError = 0.0;
+	double Psnr = 0.0;
+
+	double MsSsim = 0.0;
+
+	/** Mean of the FLIP map, 0 for equal images and up to 1. */
+	double Flip = 0.0;
+
+	/**
+	 * Temporal metrics, only with a previous frame of the same size that is not a camera cut. Mean absolute change of
+	 * the tonemapped luminance from the reprojected previous frame, of the test and of the reference, and mean of the
+	 * test's change beyond the reference's. Over the pixels whose previous position is on screen.
+	 */
+	bool bHasTemporal = false;
+	double TestFlicker = 0.0;
+	double ReferenceFlicker = 0.0;
+	double Flicker = 0.0;
+};
+
+/** Per pixel maps of the last Compare(), one channel at the size of the images, for heatmaps. */
+struct FCaptureMetricsMaps
+{
+	FCaptureImage Flip;
+
+	/** (1 - SSIM) / 2 at the first scale. */
+	FCaptureImage Dssim;
+
+	/** The test's change beyond the reference's, 0 without temporal metrics. */
+	FCaptureImage Flicker;
+};
+
+class FCaptureMetrics
+{
+public:
+	explicit FCaptureMetrics(const FCaptureMetricsSettings& InSettings);
+
+	const FCaptureMetricsSettings& GetSettings() const { return Settings; }
+
+	/**
+	 * Scores a frame of Test, at least three channels of linear RGB, against Reference of the same size. Velocity is
+	 * the frame's encoded G16R16 velocity as [0, 1] pairs at any size (typically the input's), Null for a static
+	 * scene. The frame becomes the previous one of the next call. False when the images cannot be compared.
+	 */
+	bool Compare(const FCaptureImage& Test, const FCaptureImage& Reference, const FCaptureImage* Velocity, bool bCameraCut, FCaptureFrameMetrics& OutMetrics);
+
+	/** Forgets the previous frame. */
+	void Reset();
+
+	const FCaptureMetricsMaps& GetMaps() const { return Maps; }
+
+private:
+	void ComputeFlip(int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics);
+	void ComputeMsSsim(int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics);
+	void ComputeFlicker(const FCaptureImage* Velocity, int32_t Width, int32_t Height, FCaptureFrameMetrics& OutMetrics);
+
+	/**
+	 * The two passes of a separable filter over Count planes of Width x Height, clamping at the borders: rows of
+	 * Sources[i] into the i-th plane of Dest, columns of the i-th plane of Source into Dests[i].
+	 */
+	void FilterRows(const float* const* Sources, float* Dest, int32_t Count, int32_t Width, int32_t Height, const std::vector<float>& Taps);
+	void FilterColumns(const float* Source, float* const* Dests, int32_t Count, int32_t Width, int32_t Height, const std::vector<float>& Taps);
+
+	FCaptureMetricsSettings Settings;
+	std::unique_ptr<FCaptureParallelPool> Pool;
+
+	/** Tonemapped luminance, Cx and Cz of the test then the reference. */
+	FCaptureImage Tonemapped;
+
+	/** Working planes of FLIP and of the MS-SSIM scales, and the horizontally filtered planes. */
+	FCaptureImage Scratch;
+	FCaptureImage FilterTemp;
+
+	/** Tonemapped luminance of the previous test and reference frames. */
+	FCaptureImage Previous;
+	bool bHasPrevious = false;
+
+	/** Per row partial sums of the current pass. */
+	std::vector<double> RowSums;
+
+	FCaptureMetricsMaps Maps;
+};
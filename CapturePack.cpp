@@ -0,0 +1,175 @@
+#include "CapturePack.h"
+
+#include "CaptureHalf.h"
+#include "CapturePixelFormat.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+constexpr float UNorm24Scale = 16777216.0f;
+constexpr uint32_t UNorm24Max = 0xFFFFFF;
+
+void PutUNorm24(uint8_t* Dest, uint32_t Value)
+{
+	Dest[0] = uint8_t(Value);
+	Dest[1] = uint8_t(Value >> 8);
+	Dest[2] = uint8_t(Value >> 16);
+}
+
+} //! namespace
+
+uint32_t GetCaptureDepthPackFormat(ECaptureDepthPack Mode)
+{
+	switch (Mode)
+	{
+	case ECaptureDepthPack::Float16:	return CapturePF_PackedDepth16F;
+	case ECaptureDepthPack::UNorm24:	return CapturePF_PackedDepth24;
+	default:							return CapturePF_DepthStencil;
+	}
+}
+
+uint32_t GetCaptureDepthPackBytes(ECaptureDepthPack Mode)
+{
+	switch (Mode)
+	{
+	case ECaptureDepthPack::Float16:	return 2;
+	case ECaptureDepthPack::UNorm24:	return 3;
+	default:							return 4;
+	}
+}
+
+uint32_t CapturePackDepthToUNorm24(float Depth)
+{
+	// Scaling by a power of two never rounds, and the conversion truncates, so the GPU gets the same result.
+	const float Scaled = Depth * UNorm24Scale;
+	if (!(Scaled > 0.0f))
+	{
+		return 0;
+	}
+	return Scaled >= float(UNorm24Max) ? UNorm24Max : uint32_t(Scaled);
+}
+
+float CaptureUnpackUNorm24(uint32_t Value)
+{
+	return (float(Value & UNorm24Max) + 0.5f) / UNorm24Scale;
+}
+
+void PackCaptureColor(const uint8_t* Src, uint64_t SrcRowPitch, int32_t Width, int32_t Height, uint8_t* Dest)
+{
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcRowPitch;
+		uint8_t* DestRow = Dest + size_t(Y) * Width * 6;
+		for (int32_t X = 0; X < Width; X++)
+		{
+			memcpy(DestRow + X * 6, SrcRow + X * 8, 6);
+		}
+	}
+}
+
+void PackCaptureDepth(const uint8_t* Src, uint64_t SrcRowPitch, uint32_t SrcBytesPerPixel, int32_t Width, int32_t Height,
+	ECaptureDepthPack Mode, uint8_t* DestDepth, uint8_t* DestStencil)
+{
+	const uint32_t DepthBytes = GetCaptureDepthPackBytes(Mode);
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcRowPitch;
+		uint8_t* DepthRow = DestDepth + size_t(Y) * Width * DepthBytes;
+		for (int32_t X = 0; X < Width; X++)
+		{
+			const uint8_t* Pixel = SrcRow + size_t(X) * SrcBytesPerPixel;
+			uint32_t Bits;
+			memcpy(&Bits, Pixel, sizeof(Bits));
+
+			if (Mode == ECaptureDepthPack::Float16)
+			{
+				float Depth;
+				memcpy(&Depth, &Bits, sizeof(Depth));
+				const uint16_t Half = CaptureFloatToHalf(Depth);
+				memcpy(DepthRow + X * 2, &Half, sizeof(Half));
+			}
+			else if (Mode == ECaptureDepthPack::UNorm24)
+			{
+				float Depth;
+				memcpy(&Depth, &Bits, sizeof(Depth));
+				PutUNorm24(DepthRow + X * 3, CapturePackDepthToUNorm24(Depth));
+			}
+			else
+			{
+				memcpy(DepthRow + X * 4, &Bits, sizeof(Bits));
+			}
+
+			if (DestStencil)
+			{
+				DestStencil[size_t(Y) * Width + X] = SrcBytesPerPixel > 4 ? Pixel[4] : 0;
+			}
+		}
+	}
+}
+
+void UnpackCaptureColor(const uint8_t* Src, int32_t Width, int32_t Height, uint8_t* Dest)
+{
+	const uint16_t One = 0x3C00;
+	const size_t NumPixels = size_t(Width) * Height;
+	for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+	{
+		memcpy(Dest + Pixel * 8, Src + Pixel * 6, 6);
+		memcpy(Dest + Pixel * 8 + 6, &One, sizeof(One));
+	}
+}
+
+bool UnpackCaptureDepthPlane(const uint8_t* Src, uint32_t PixelFormat, uint32_t BytesPerPixel, size_t NumPixels, float* Dest)
+{
+	// Packed depths are expanded back to front, so Dest may start at Src.
+	if (PixelFormat == CapturePF_PackedDepth16F)
+	{
+		for (size_t Pixel = NumPixels; Pixel-- > 0;)
+		{
+			uint16_t Half;
+			memcpy(&Half, Src + Pixel * 2, sizeof(Half));
+			Dest[Pixel] = CaptureHalfToFloat(Half);
+		}
+	}
+	else if (PixelFormat == CapturePF_PackedDepth24)
+	{
+		for (size_t Pixel = NumPixels; Pixel-- > 0;)
+		{
+			const uint8_t* Packed = Src + Pixel * 3;
+			Dest[Pixel] = CaptureUnpackUNorm24(uint32_t(Packed[0]) | uint32_t(Packed[1]) << 8 | uint32_t(Packed[2]) << 16);
+		}
+	}
+	else if (PixelFormat == CapturePF_DepthStencil && BytesPerPixel >= 4)
+	{
+		for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+		{
+			memmove(Dest + Pixel, Src + Pixel * BytesPerPixel, sizeof(float));
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+bool UnpackCaptureDepth(const uint8_t* SrcDepth, uint32_t PixelFormat, const uint8_t* SrcStencil, int32_t Width, int32_t Height, uint8_t* Dest)
+{
+	const size_t NumPixels = size_t(Width) * Height;
+	std::vector<float> Depth(NumPixels);
+	if (!UnpackCaptureDepthPlane(SrcDepth, PixelFormat, GetCaptureDepthPackBytes(ECaptureDepthPack::Float32), NumPixels, Depth.data()))
+	{
+		return false;
+	}
+
+	for (size_t Pixel = 0; Pixel < NumPixels; Pixel++)
+	{
+		uint8_t* DepthPixel = Dest + Pixel * 8;
+		memcpy(DepthPixel, &Depth[Pixel], sizeof(float));
+		DepthPixel[4] = SrcStencil ? SrcStencil[Pixel] : 0;
+		DepthPixel[5] = DepthPixel[6] = DepthPixel[7] = 0;
+	}
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Pack stage run on the GPU before readback (CapturePack.usf) and its bit exact CPU reference.
+ *
+ *  - FloatRGBA scene color drops its alpha: 8 -> 6 bytes per pixel (PackedFloat16RGB).
+ *  - Depth/stencil is split into a depth plane and an optional 1 byte stencil plane (R8_UINT), with depth kept
+ *    as float (4 bytes, DepthStencil), converted to half (2 bytes, PackedDepth16F) or to 24 bit fixed point
+ *    (3 bytes, PackedDepth24) instead of the 8 byte DepthPixel of an unpacked readback.
+ *
+ * Every conversion is integer arithmetic or an exact power of two scale, so the shader and these functions agree
+ * on every bit whatever the GPU's float rounding and denormal handling. Half depth is CaptureFloatToHalf() of
+ * CaptureHalf.h, which the shader mirrors line by line.
+ */
+
+enum class ECaptureDepthPack : uint8_t
+{
+	Float32 = 0,
+	Float16 = 1,
+	UNorm24 = 2,
+};
+
+/** Record layout of a packed depth plane. */
+uint32_t GetCaptureDepthPackFormat(ECaptureDepthPack Mode);
+uint32_t GetCaptureDepthPackBytes(ECaptureDepthPack Mode);
+
+/** floor(Depth * 2^24), clamped to [0, 2^24 - 1]. NaN packs to 0. */
+uint32_t CapturePackDepthToUNorm24(float Depth);
+
+/** Center of the 24 bit fixed point step, (Value + 0.5) / 2^24. */
+float CaptureUnpackUNorm24(uint32_t Value);
+
+/** Packs FloatRGBA rows into PackedFloat16RGB rows of Width * 6 bytes. */
+void PackCaptureColor(const uint8_t* Src, uint64_t SrcRowPitch, int32_t Width, int32_t Height, uint8_t* Dest);
+
+/**
+ * Packs depth/stencil rows with SrcBytesPerPixel bytes per pixel (4 for float depth, 8 for DepthPixel) into a depth
+ * plane of GetCaptureDepthPackBytes(Mode) bytes per pixel and, when DestStencil is set, a 1 byte stencil plane.
+ * The stencil of a source without one is 0.
+ */
+void PackCaptureDepth(const uint8_t* Src, uint64_t SrcRowPitch, uint32_t SrcBytesPerPixel, int32_t Width, int32_t Height,
+	ECaptureDepthPack Mode, uint8_t* DestDepth, uint8_t* DestStencil);
+
+/** Expands PackedFloat16RGB back to FloatRGBA with an alpha of one. */
+void UnpackCaptureColor(const uint8_t* Src, int32_t Width, int32_t Height, uint8_t* Dest);
+
+/**
+ * Reads NumPixels depths of a depth record as float: DepthStencil with BytesPerPixel 4 or 8 (DepthPixel), PackedDepth16F
+ * or PackedDepth24. Dest may point at Src to convert in place. Returns false for a format that is not depth.
+ */
+bool UnpackCaptureDepthPlane(const uint8_t* Src, uint32_t PixelFormat, uint32_t BytesPerPixel, size_t NumPixels, float* Dest);
+
+/**
+ * Expands a packed depth plane of PixelFormat and an optional stencil plane back to DepthPixel (8 bytes per pixel).
+ * Returns false for a format that is not a depth plane.
+ */
+bool UnpackCaptureDepth(const uint8_t* SrcDepth, uint32_t PixelFormat, const uint8_t* SrcStencil, int32_t Width, int32_t Height, uint8_t* Dest);
@@ -0,0 +1,89 @@
+#include "CaptureParallel.h"
+
+#include <algorithm>
+
+FCaptureParallelPool::FCaptureParallelPool(uint32_t NumThreads)
+{
+	if (NumThreads == 0)
+	{
+		NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	for (uint32_t Index = 1; Index < NumThreads; Index++)
+	{
+		Workers.emplace_back(&FCaptureParallelPool::WorkerLoop, this);
+	}
+}
+
+FCaptureParallelPool::~FCaptureParallelPool()
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		bStopping = true;
+	}
+	WakeUp.notify_all();
+	for (std::thread& Worker : Workers)
+	{
+		Worker.join();
+	}
+}
+
+void FCaptureParallelPool::ParallelFor(uint32_t Count, const std::function<void(uint32_t)>& Function)
+{
+	if (Workers.empty() || Count <= 1)
+	{
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			Function(Index);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Job = &Function;
+		JobCount = Count;
+		NextItem.store(0, std::memory_order_relaxed);
+		NumBusy = uint32_t(Workers.size());
+		Generation++;
+	}
+	WakeUp.notify_all();
+
+	RunItems();
+
+	std::unique_lock<std::mutex> Lock(Mutex);
+	Done.wait(Lock, [this] { return NumBusy == 0; });
+	Job = nullptr;
+}
+
+void FCaptureParallelPool::RunItems()
+{
+	for (uint32_t Index = NextItem.fetch_add(1, std::memory_order_relaxed); Index < JobCount; Index = NextItem.fetch_add(1, std::memory_order_relaxed))
+	{
+		(*Job)(Index);
+	}
+}
+
+void FCaptureParallelPool::WorkerLoop()
+{
+	uint64_t SeenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			WakeUp.wait(Lock, [&] { return bStopping || Generation != SeenGeneration; });
+			if (bStopping)
+			{
+				return;
+			}
+			SeenGeneration = Generation;
+		}
+
+		RunItems();
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+		if (--NumBusy == 0)
+		{
+			Done.notify_one();
+		}
+	}
+}
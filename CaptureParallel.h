@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent worker threads for the offline CPU kernels. ParallelFor hands out indices one at a time through an
+ * atomic counter, so items should be coarse (a tile, a row of tiles) and results must not depend on which thread
+ * ran them. The calling thread works too; a pool of one thread runs everything inline.
+ */
+class FCaptureParallelPool
+{
+public:
+	/** NumThreads counts the calling thread, 0 for one per hardware thread. */
+	explicit FCaptureParallelPool(uint32_t NumThreads = 0);
+	~FCaptureParallelPool();
+
+	FCaptureParallelPool(const FCaptureParallelPool&) = delete;
+	FCaptureParallelPool& operator=(const FCaptureParallelPool&) = delete;
+
+	uint32_t GetNumThreads() const { return uint32_t(Workers.size()) + 1; }
+
+	/** Runs Function(Index) for every Index in [0, Count) and returns once all of them did. Not reentrant. */
+	void ParallelFor(uint32_t Count, const std::function<void(uint32_t)>& Function);
+
+private:
+	void WorkerLoop();
+	void RunItems();
+
+	std::vector<std::thread> Workers;
+
+	std::mutex Mutex;
+	std::condition_variable WakeUp;
+	std::condition_variable Done;
+	uint64_t Generation = 0;
+	uint32_t NumBusy = 0;
+	bool bStopping = false;
+
+	const std::function<void(uint32_t)>* Job = nullptr;
+	uint32_t JobCount = 0;
+	std::atomic<uint32_t> NextItem{ 0 };
+};
@@ -0,0 +1,155 @@
+#include "CapturePixelFormat.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CAPTURE_PIXEL_FORMAT_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define CAPTURE_PIXEL_FORMAT_SSE2 0
+#endif
+
+namespace
+{
+
+using EType = ECaptureElementType;
+
+const FCapturePixelFormatDesc PixelFormats[] =
+{
+	// PixelFormat						Name						Bpp	Ch	ElementType		Channels	Packed	DepthStencil
+	{ CapturePF_A32B32G32R32F,			"A32B32G32R32F",			16,	4,	EType::Float32,	"RGBA",		false,	false },
+	{ CapturePF_B8G8R8A8,				"B8G8R8A8",					4,	4,	EType::UInt8,	"BGRA",		false,	false },
+	{ CapturePF_G8,						"G8",						1,	1,	EType::UInt8,	"R",		false,	false },
+	{ CapturePF_G16,					"G16",						2,	1,	EType::UInt16,	"R",		false,	false },
+	{ CapturePF_FloatRGB,				"FloatRGB",					4,	1,	EType::UInt32,	"P",		true,	false },
+	{ CapturePF_FloatRGBA,				"FloatRGBA",				8,	4,	EType::Float16,	"RGBA",		false,	false },
+	{ CapturePF_DepthStencil,			"DepthStencil",				4,	1,	EType::Float32,	"D",		false,	true },
+	{ CapturePF_ShadowDepth,			"ShadowDepth",				4,	1,	EType::Float32,	"D",		false,	true },
+	{ CapturePF_R32_FLOAT,				"R32_FLOAT",				4,	1,	EType::Float32,	"R",		false,	false },
+	{ CapturePF_G16R16,					"G16R16",					4,	2,	EType::UInt16,	"RG",		false,	false },
+	{ CapturePF_G16R16F,				"G16R16F",					4,	2,	EType::Float16,	"RG",		false,	false },
+	{ CapturePF_G16R16F_FILTER,			"G16R16F_FILTER",			4,	2,	EType::Float16,	"RG",		false,	false },
+	{ CapturePF_G32R32F,				"G32R32F",					8,	2,	EType::Float32,	"RG",		false,	false },
+	{ CapturePF_A2B10G10R10,			"A2B10G10R10",				4,	1,	EType::UInt32,	"P",		true,	false },
+	{ CapturePF_A16B16G16R16,			"A16B16G16R16",				8,	4,	EType::UInt16,	"RGBA",		false,	false },
+	{ CapturePF_D24,					"D24",						4,	1,	EType::Float32,	"D",		false,	true },
+	{ CapturePF_R16F,					"R16F",						2,	1,	EType::Float16,	"R",		false,	false },
+	{ CapturePF_R16F_FILTER,			"R16F_FILTER",				2,	1,	EType::Float16,	"R",		false,	false },
+	{ CapturePF_FloatR11G11B10,			"FloatR11G11B10",			4,	1,	EType::UInt32,	"P",		true,	false },
+	{ CapturePF_A8,						"A8",						1,	1,	EType::UInt8,	"A",		false,	false },
+	{ CapturePF_R32_UINT,				"R32_UINT",					4,	1,	EType::UInt32,	"R",		false,	false },
+	{ CapturePF_R32_SINT,				"R32_SINT",					4,	1,	EType::Int32,	"R",		false,	false },
+	{ CapturePF_R16_UINT,				"R16_UINT",					2,	1,	EType::UInt16,	"R",		false,	false },
+	{ CapturePF_R16_SINT,				"R16_SINT",					2,	1,	EType::Int16,	"R",		false,	false },
+	{ CapturePF_R16G16B16A16_UINT,		"R16G16B16A16_UINT",		8,	4,	EType::UInt16,	"RGBA",		false,	false },
+	{ CapturePF_R16G16B16A16_SINT,		"R16G16B16A16_SINT",		8,	4,	EType::Int16,	"RGBA",		false,	false },
+	{ CapturePF_R8G8B8A8,				"R8G8B8A8",					4,	4,	EType::UInt8,	"RGBA",		false,	false },
+	{ CapturePF_A8R8G8B8,				"A8R8G8B8",					4,	4,	EType::UInt8,	"ARGB",		false,	false },
+	{ CapturePF_R8G8,					"R8G8",						2,	2,	EType::UInt8,	"RG",		false,	false },
+	{ CapturePF_R8_UINT,				"R8_UINT",					1,	1,	EType::UInt8,	"R",		false,	false },
+	{ CapturePF_R8,						"R8",						1,	1,	EType::UInt8,	"R",		false,	false },
+	{ CapturePF_PackedFloat16RGB,		"PackedFloat16RGB",			6,	3,	EType::Float16,	"RGB",		false,	false },
+	{ CapturePF_PackedDepth16F,			"PackedDepth16F",			2,	1,	EType::Float16,	"D",		false,	true },
+	{ CapturePF_PackedDepth24,			"PackedDepth24",			3,	1,	EType::UNorm24,	"D",		false,	true },
+};
+
+constexpr uint32_t NumPixelFormats = sizeof(PixelFormats) / sizeof(PixelFormats[0]);
+
+/** Direct lookup by EPixelFormat value, built once from the table. */
+struct FPixelFormatLookup
+{
+	static constexpr uint32_t Size = 128;
+	const FCapturePixelFormatDesc* Entries[Size] = {};
+
+	FPixelFormatLookup()
+	{
+		for (const FCapturePixelFormatDesc& Desc : PixelFormats)
+		{
+			Entries[Desc.PixelFormat] = &Desc;
+		}
+	}
+};
+
+void CopyRow(uint8_t* Dest, const uint8_t* Src, uint64_t RowBytes)
+{
+	uint64_t Offset = 0;
+#if CAPTURE_PIXEL_FORMAT_SSE2
+	// Staging rows are only guaranteed to be pitch aligned, so both sides use unaligned access.
+	for (; Offset + 64 <= RowBytes; Offset += 64)
+	{
+		const __m128i A = _mm_loadu_si128((const __m128i*)(Src + Offset));
+		const __m128i B = _mm_loadu_si128((const __m128i*)(Src + Offset + 16));
+		const __m128i C = _mm_loadu_si128((const __m128i*)(Src + Offset + 32));
+		const __m128i D = _mm_loadu_si128((const __m128i*)(Src + Offset + 48));
+		_mm_storeu_si128((__m128i*)(Dest + Offset), A);
+		_mm_storeu_si128((__m128i*)(Dest + Offset + 16), B);
+		_mm_storeu_si128((__m128i*)(Dest + Offset + 32), C);
+		_mm_storeu_si128((__m128i*)(Dest + Offset + 48), D);
+	}
+	for (; Offset + 16 <= RowBytes; Offset += 16)
+	{
+		_mm_storeu_si128((__m128i*)(Dest + Offset), _mm_loadu_si128((const __m128i*)(Src + Offset)));
+	}
+#endif
+	memcpy(Dest + Offset, Src + Offset, size_t(RowBytes - Offset));
+}
+
+} //! namespace
+
+const FCapturePixelFormatDesc* FindCapturePixelFormat(uint32_t PixelFormat)
+{
+	static const FPixelFormatLookup Lookup;
+	return PixelFormat < FPixelFormatLookup::Size ? Lookup.Entries[PixelFormat] : nullptr;
+}
+
+const FCapturePixelFormatDesc* GetCapturePixelFormats(uint32_t& OutCount)
+{
+	OutCount = NumPixelFormats;
+	return PixelFormats;
+}
+
+uint32_t GetCaptureElementSize(ECaptureElementType ElementType)
+{
+	switch (ElementType)
+	{
+	case ECaptureElementType::UInt8:	return 1;
+	case ECaptureElementType::Float16:	return 2;
+	case ECaptureElementType::UInt16:	return 2;
+	case ECaptureElementType::Int16:	return 2;
+	case ECaptureElementType::UNorm24:	return 3;
+	default:							return 4;
+	}
+}
+
+int32_t FindCaptureChannel(const FCapturePixelFormatDesc& Desc, char Channel)
+{
+	const char* Found = strchr(Desc.Channels, Channel);
+	return Found && Channel ? int32_t(Found - Desc.Channels) : -1;
+}
+
+void CopyCaptureRows(uint8_t* Dest, uint64_t DestRowPitch, const uint8_t* Src, uint64_t SrcRowPitch, uint64_t RowBytes, uint32_t NumRows)
+{
+	if (DestRowPitch == RowBytes && SrcRowPitch == RowBytes)
+	{
+		memcpy(Dest, Src, size_t(RowBytes * NumRows));
+		return;
+	}
+
+	for (uint32_t Row = 0; Row < NumRows; Row++)
+	{
+		CopyRow(Dest + Row * DestRowPitch, Src + Row * SrcRowPitch, RowBytes);
+	}
+}
+
+bool PackCaptureSurface(const void* Src, uint64_t SrcRowPitch, int32_t Width, int32_t Height, uint32_t BytesPerPixel, std::vector<uint8_t>& OutBytes)
+{
+	const uint64_t RowBytes = uint64_t(Width) * BytesPerPixel;
+	if (!Src || Width <= 0 || Height <= 0 || BytesPerPixel == 0 || SrcRowPitch < RowBytes)
+	{
+		return false;
+	}
+
+	OutBytes.resize(size_t(RowBytes * uint64_t(Height)));
+	CopyCaptureRows(OutBytes.data(), RowBytes, (const uint8_t*)Src, SrcRowPitch, RowBytes, uint32_t(Height));
+	return true;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Layout of the pixel formats the capture hooks can read back, shared by the engine side and the offline
+ * tools. Values are EPixelFormat so records stay readable without the engine headers.
+ */
+
+enum class ECaptureElementType : int32_t
+{
+	UInt8 = 0,
+	Float16 = 1,
+	Float32 = 2,
+	UInt16 = 3,
+	Int16 = 4,
+	UInt32 = 5,
+	Int32 = 6,
+
+	/** Little endian 24 bit fixed point in [0, 1), see CapturePack.h. */
+	UNorm24 = 7,
+};
+
+enum ECapturePixelFormat : uint32_t
+{
+	CapturePF_A32B32G32R32F = 1,
+	CapturePF_B8G8R8A8 = 2,
+	CapturePF_G8 = 3,
+	CapturePF_G16 = 4,
+	CapturePF_FloatRGB = 9,
+	CapturePF_FloatRGBA = 10,
+	CapturePF_DepthStencil = 11,
+	CapturePF_ShadowDepth = 12,
+	CapturePF_R32_FLOAT = 13,
+	CapturePF_G16R16 = 14,
+	CapturePF_G16R16F = 15,
+	CapturePF_G16R16F_FILTER = 16,
+	CapturePF_G32R32F = 17,
+	CapturePF_A2B10G10R10 = 18,
+	CapturePF_A16B16G16R16 = 19,
+	CapturePF_D24 = 20,
+	CapturePF_R16F = 21,
+	CapturePF_R16F_FILTER = 22,
+	CapturePF_FloatR11G11B10 = 26,
+	CapturePF_A8 = 27,
+	CapturePF_R32_UINT = 28,
+	CapturePF_R32_SINT = 29,
+	CapturePF_R16_UINT = 32,
+	CapturePF_R16_SINT = 33,
+	CapturePF_R16G16B16A16_UINT = 34,
+	CapturePF_R16G16B16A16_SINT = 35,
+	CapturePF_R8G8B8A8 = 37,
+	CapturePF_A8R8G8B8 = 38,
+	CapturePF_R8G8 = 40,
+	CapturePF_R8_UINT = 57,
+	CapturePF_R8 = 71,
+
+	// Layouts produced by the pack stage before readback (CapturePack.h), above any EPixelFormat value.
+	CapturePF_PackedFloat16RGB = 96,
+	CapturePF_PackedDepth16F = 97,
+	CapturePF_PackedDepth24 = 98,
+};
+
+struct FCapturePixelFormatDesc
+{
+	uint32_t PixelFormat;
+	const char* Name;
+
+	/** Bytes of one texel as laid out by the RHI. Depth/stencil readbacks may be wider, see below. */
+	uint32_t BytesPerPixel;
+	uint32_t NumChannels;
+	ECaptureElementType ElementType;
+
+	/** Channel letters in memory order, e.g. "BGRA". Packed formats are exposed as one 32 bit element. */
+	const char* Channels;
+	bool bPacked;
+
+	/**
+	 * Depth/stencil readbacks are depth optionally followed by the stencil byte (8 byte DepthPixel),
+	 * so the record's BytesPerPixel decides whether a stencil is present. Packed depth never carries one.
+	 */
+	bool bDepthStencil;
+};
+
+/** Returns the descriptor of an EPixelFormat, or nullptr for formats the capture path does not understand. */
+const FCapturePixelFormatDesc* FindCapturePixelFormat(uint32_t PixelFormat);
+
+/** Every known descriptor, ordered by EPixelFormat. */
+const FCapturePixelFormatDesc* GetCapturePixelFormats(uint32_t& OutCount);
+
+uint32_t GetCaptureElementSize(ECaptureElementType ElementType);
+
+/** Memory position of a channel letter in a descriptor, or -1. */
+int32_t FindCaptureChannel(const FCapturePixelFormatDesc& Desc, char Channel);
+
+/**
+ * Copies NumRows rows of RowBytes each between surfaces with different row pitches, e.g. from a padded
+ * staging buffer into a tightly packed job. Uses SSE2 for the row body when available.
+ */
+void CopyCaptureRows(uint8_t* Dest, uint64_t DestRowPitch, const uint8_t* Src, uint64_t SrcRowPitch, uint64_t RowBytes, uint32_t NumRows);
+
+/** Packs a Width x Height surface with SrcRowPitch bytes per row into Width * BytesPerPixel bytes per row. */
+bool PackCaptureSurface(const void* Src, uint64_t SrcRowPitch, int32_t Width, int32_t Height, uint32_t BytesPerPixel, std::vector<uint8_t>& OutBytes);
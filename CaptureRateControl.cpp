@@ -0,0 +1,225 @@
+#include "CaptureRateControl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace
+{
+
+/** Time constant of the write bandwidth average, long enough to span several jobs of a slow disk. */
+constexpr double BandwidthSeconds = 2.0;
+
+/** Seconds until the disk reaches MinFreeDiskBytes at BytesPerSecond, infinite when unknown or not filling. */
+double SecondsToFull(uint64_t FreeDiskBytes, uint64_t MinFreeDiskBytes, double BytesPerSecond)
+{
+	if (FreeDiskBytes == ~0ull || BytesPerSecond <= 0.0)
+	{
+		return INFINITY;
+	}
+	return FreeDiskBytes > MinFreeDiskBytes ? double(FreeDiskBytes - MinFreeDiskBytes) / BytesPerSecond : 0.0;
+}
+
+} //! namespace
+
+FCaptureRateController::FCaptureRateController(const FCaptureRateConfig& InConfig)
+	: Config(InConfig)
+{
+	ShedFilter.Parse(Config.ShedLayers);
+	for (uint32_t Interval = 1; Interval < std::max(Config.MaxInterval, 1u); Interval *= 2)
+	{
+		NumIntervalLevels++;
+	}
+	RecoverSeconds = Config.RecoverSeconds;
+}
+
+uint32_t FCaptureRateController::GetMaxLevel() const
+{
+	return uint32_t(ShedFilter.GetPatterns().size()) + NumIntervalLevels;
+}
+
+uint32_t FCaptureRateController::GetNumShedPatterns() const
+{
+	return std::min(Level, uint32_t(ShedFilter.GetPatterns().size()));
+}
+
+uint32_t FCaptureRateController::GetInterval() const
+{
+	return 1u << (Level - GetNumShedPatterns());
+}
+
+bool FCaptureRateController::Update(const FCaptureRateSample& Sample)
+{
+	uint64_t NewOverflows = 0;
+	if (bHasSample)
+	{
+		const double DeltaTime = Sample.Time - LastTime;
+		if (DeltaTime > 0.0)
+		{
+			const double Rate = double(Sample.BytesWritten - std::min(LastBytesWritten, Sample.BytesWritten)) / DeltaTime;
+			WriteBytesPerSecond += (Rate - WriteBytesPerSecond) * (1.0 - std::exp(-DeltaTime / BandwidthSeconds));
+		}
+		// Counters may restart, e.g. when the readback ring is resized.
+		NewOverflows = Sample.Overflows - std::min(LastOverflows, Sample.Overflows);
+	}
+	else
+	{
+		CalmSince = Sample.Time;
+		bHasSample = true;
+	}
+	LastTime = Sample.Time;
+	LastBytesWritten = Sample.BytesWritten;
+	LastOverflows = Sample.Overflows;
+	QueueFill = float(Sample.QueueDepth) / float(std::max(Sample.QueueCapacity, 1u));
+
+	// Running out of disk beats everything else: stop writing, keep the level for when space comes back.
+	if (Sample.FreeDiskBytes != ~0ull)
+	{
+		if (!bPaused && Sample.FreeDiskBytes < Config.MinFreeDiskBytes)
+		{
+			SetLevel(Sample, Level, true, "disk_full");
+			return true;
+		}
+		if (bPaused && Sample.FreeDiskBytes >= Config.MinFreeDiskBytes + Config.MinFreeDiskBytes / 2)
+		{
+			SetLevel(Sample, Level, false, "disk_freed");
+			CalmSince = Sample.Time;
+			return true;
+		}
+	}
+	if (bPaused)
+	{
+		return false;
+	}
+
+	const double ToFull = SecondsToFull(Sample.FreeDiskBytes, Config.MinFreeDiskBytes, WriteBytesPerSecond);
+	const char* Pressure = nullptr;
+	if (NewOverflows)
+	{
+		Pressure = "overflow";
+	}
+	else if (QueueFill > Config.HighWater)
+	{
+		Pressure = "queue_full";
+	}
+	else if (ToFull < Config.MinSecondsToFull)
+	{
+		Pressure = "disk_filling";
+	}
+
+	const bool bDwelled = Sample.Time - LastChangeTime >= Config.MinDwellSeconds;
+	if (Pressure)
+	{
+		CalmSince = Sample.Time;
+		if (Level < GetMaxLevel() && bDwelled)
+		{
+			// A step up that did not hold means the disk sits between two levels: probe it less and less often.
+			RecoverSeconds = Sample.Time - LastStepUpTime < 2.0 * RecoverSeconds ? std::min(RecoverSeconds * 2.0, Config.MaxRecoverSeconds) : Config.RecoverSeconds;
+			LastStepDownTime = Sample.Time;
+			SetLevel(Sample, Level + 1, false, Pressure);
+			return true;
+		}
+		return false;
+	}
+
+	// Going up doubles the bytes per second at worst, the disk has to have room for that too.
+	const bool bCalm = QueueFill <= Config.LowWater && ToFull >= 2.0 * Config.MinSecondsToFull;
+	if (!bCalm)
+	{
+		CalmSince = Sample.Time;
+	}
+	else if (Level > 0 && bDwelled && Sample.Time - CalmSince >= RecoverSeconds)
+	{
+		if (LastStepUpTime > LastStepDownTime)
+		{
+			// The last step up held, the disk got faster: climb back at the normal pace.
+			RecoverSeconds = Config.RecoverSeconds;
+		}
+		LastStepUpTime = Sample.Time;
+		CalmSince = Sample.Time;
+		SetLevel(Sample, Level - 1, false, "recovered");
+		return true;
+	}
+	return false;
+}
+
+void FCaptureRateController::SetLevel(const FCaptureRateSample& Sample, uint32_t NewLevel, bool bNewPaused, const char* Reason)
+{
+	FCaptureRateDecision Decision;
+	Decision.Time = Sample.Time;
+	Decision.FrameId = Sample.FrameId;
+	Decision.FromLevel = Level;
+	Decision.Reason = Reason;
+	Decision.QueueFill = QueueFill;
+	Decision.WriteBytesPerSecond = WriteBytesPerSecond;
+	Decision.FreeDiskBytes = Sample.FreeDiskBytes;
+
+	Level = NewLevel;
+	bPaused = bNewPaused;
+	LastChangeTime = Sample.Time;
+	NumOffered = 0;
+
+	Decision.Level = Level;
+	Decision.Interval = GetInterval();
+	Decision.NumShedPatterns = GetNumShedPatterns();
+	Decision.bPaused = bPaused;
+	Decisions.push_back(Decision);
+}
+
+bool FCaptureRateController::AdmitFrame(uint64_t FrameId)
+{
+	const bool bAdmit = !bPaused && NumOffered % GetInterval() == 0;
+	NumOffered++;
+	if (!bAdmit)
+	{
+		// Consecutive offers merge into one range, even when the session interval leaves gaps between their ids.
+		if (bLastOfferSkipped && !SkippedRanges.empty() && LastOfferedId == SkippedRanges.back().second)
+		{
+			SkippedRanges.back().second = FrameId;
+		}
+		else
+		{
+			SkippedRanges.emplace_back(FrameId, FrameId);
+		}
+		NumSkipped++;
+	}
+	LastOfferedId = FrameId;
+	bLastOfferSkipped = !bAdmit;
+	return bAdmit;
+}
+
+bool FCaptureRateController::IsLayerShed(const char* Layer) const
+{
+	const int32_t Pattern = ShedFilter.Match(Layer);
+	return Pattern >= 0 && uint32_t(Pattern) < GetNumShedPatterns();
+}
+
+std::string FormatCaptureRateDecision(const FCaptureRateDecision& Decision, const FCaptureRateController& Controller)
+{
+	std::string Shed;
+	const std::vector<std::string>& Patterns = Controller.GetShedFilter().GetPatterns();
+	for (uint32_t Index = 0; Index < Decision.NumShedPatterns && Index < Patterns.size(); Index++)
+	{
+		Shed += (Index ? ",\"" : "\"") + Patterns[Index] + "\"";
+	}
+
+	char Line[512];
+	snprintf(Line, sizeof(Line),
+		"{\"time\":%.3f,\"frame\":%llu,\"from_level\":%u,\"level\":%u,\"interval\":%u,\"shed\":[%s],\"paused\":%s,\"reason\":\"%s\","
+		"\"queue_fill\":%.2f,\"write_mb_per_s\":%.1f,\"free_disk_mb\":%.0f}",
+		Decision.Time, (unsigned long long)Decision.FrameId, Decision.FromLevel, Decision.Level, Decision.Interval, Shed.c_str(),
+		Decision.bPaused ? "true" : "false", Decision.Reason, Decision.QueueFill, Decision.WriteBytesPerSecond / 1e6,
+		Decision.FreeDiskBytes == ~0ull ? -1.0 : double(Decision.FreeDiskBytes) / 1e6);
+	return Line;
+}
+
+std::string FormatCaptureRateSummary(const FCaptureRateController& Controller)
+{
+	std::string Ranges;
+	for (const std::pair<uint64_t, uint64_t>& Range : Controller.GetSkippedRanges())
+	{
+		Ranges += (Ranges.empty() ? "[" : ",[") + std::to_string(Range.first) + "," + std::to_string(Range.second) + "]";
+	}
+	return "{\"summary\":true,\"decisions\":" + std::to_string(Controller.GetDecisions().size()) + ",\"level\":" + std::to_string(Controller.GetLevel()) +
+		",\"skipped_frames\":" + std::to_string(Controller.GetNumSkipped()) + ",\"skipped_ranges\":[" + Ranges + "]}";
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "CaptureTap.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Adaptive capture rate: keeps a long capture at the game's frame rate when the disk cannot take every layer of
+ * every frame, instead of stalling the game or losing frames at random.
+ *
+ * The controller is fed the writer queue depth, the bytes written, the overflows so far and the free disk space once
+ * per frame, and walks a ladder of levels. Level 0 captures everything. Each of the next levels sheds one more
+ * optional layer pattern (r.Capture.RateControl.Shed, e.g. input_post), and past those every level doubles the
+ * capture interval up to MaxInterval. It steps down one level at a time, at most once per MinDwellSeconds, when the
+ * pipeline overflows, the queue fills past HighWater or the disk would fill up within MinSecondsToFull. It steps back up once
+ * the queue stayed below LowWater for a recovery period, which doubles every time a step up has to be taken back.
+ * Below MinFreeDiskBytes capture pauses until the free space is back above one and a half times that.
+ *
+ * Every change is kept as an FCaptureRateDecision, and every offered frame the controller refused is kept in
+ * ranges, so a dataset can say which frames are missing and why. Plain C++, one instance per capture session.
+ */
+
+struct FCaptureRateConfig
+{
+	/** Optional layers to shed, most expendable first, in the pattern syntax of r.Capture.Taps. */
+	std::string ShedLayers = "input_post";
+
+	/** Largest capture interval the controller falls back to; a power of two. */
+	uint32_t MaxInterval = 8;
+
+	/** Writer queue fill, as a fraction of its capacity, above which the rate goes down and below which it may go up. */
+	float HighWater = 0.75f;
+	float LowWater = 0.25f;
+
+	double MinDwellSeconds = 1.0;
+	double RecoverSeconds = 5.0;
+	double MaxRecoverSeconds = 60.0;
+
+	/** Capture pauses below this much free disk space, and slows down when it would be reached sooner than MinSecondsToFull. */
+	uint64_t MinFreeDiskBytes = 2ull << 30;
+	double MinSecondsToFull = 300.0;
+};
+
+/** What the pipeline looked like on one frame. Counters are totals since the session started. */
+struct FCaptureRateSample
+{
+	double Time = 0.0;
+	uint64_t FrameId = 0;
+
+	uint32_t QueueDepth = 0;
+	uint32_t QueueCapacity = 1;
+	uint64_t BytesWritten = 0;
+
+	/** Readbacks or writes the pipeline dropped, coalesced away or blocked the render thread on. */
+	uint64_t Overflows = 0;
+
+	/** ~0 when unknown. */
+	uint64_t FreeDiskBytes = ~0ull;
+};
+
+struct FCaptureRateDecision
+{
+	double Time = 0.0;
+
+	/** First frame the new setting applies to. */
+	uint64_t FrameId = 0;
+
+	uint32_t FromLevel = 0;
+	uint32_t Level = 0;
+	uint32_t Interval = 1;
+	uint32_t NumShedPatterns = 0;
+	bool bPaused = false;
+	const char* Reason = "";
+
+	/** Inputs the decision was taken on. */
+	float QueueFill = 0.0f;
+	double WriteBytesPerSecond = 0.0;
+	uint64_t FreeDiskBytes = ~0ull;
+};
+
+class FCaptureRateController
+{
+public:
+	explicit FCaptureRateController(const FCaptureRateConfig& InConfig = FCaptureRateConfig());
+
+	/** Takes the pipeline state of a frame. Returns true when the level or the pause state changed. */
+	bool Update(const FCaptureRateSample& Sample);
+
+	/**
+	 * Called for every frame the session would capture at full rate. Returns false if the current interval or a
+	 * pause skips it, and records the skip.
+	 */
+	bool AdmitFrame(uint64_t FrameId);
+
+	/** True when Layer matches one of the patterns the current level sheds. */
+	bool IsLayerShed(const char* Layer) const;
+
+	uint32_t GetLevel() const { return Level; }
+	uint32_t GetMaxLevel() const;
+	uint32_t GetInterval() const;
+	uint32_t GetNumShedPatterns() const;
+	bool IsPaused() const { return bPaused; }
+	double GetWriteBytesPerSecond() const { return WriteBytesPerSecond; }
+
+	const FCaptureTapFilter& GetShedFilter() const { return ShedFilter; }
+	const std::vector<FCaptureRateDecision>& GetDecisions() const { return Decisions; }
+
+	/** Inclusive frame id ranges of offered frames that were skipped, in order. */
+	const std::vector<std::pair<uint64_t, uint64_t>>& GetSkippedRanges() const { return SkippedRanges; }
+	uint64_t GetNumSkipped() const { return NumSkipped; }
+
+private:
+	void SetLevel(const FCaptureRateSample& Sample, uint32_t NewLevel, bool bNewPaused, const char* Reason);
+
+	FCaptureRateConfig Config;
+	FCaptureTapFilter ShedFilter;
+	uint32_t NumIntervalLevels = 0;
+
+	uint32_t Level = 0;
+	bool bPaused = false;
+
+	bool bHasSample = false;
+	double LastTime = 0.0;
+	uint64_t LastBytesWritten = 0;
+	uint64_t LastOverflows = 0;
+	double WriteBytesPerSecond = 0.0;
+
+	double LastChangeTime = -1e30;
+	double LastStepDownTime = -1e30;
+	double LastStepUpTime = -1e30;
+	double CalmSince = 0.0;
+	double RecoverSeconds = 0.0;
+	float QueueFill = 0.0f;
+
+	/** Frames offered since the last change; every Interval-th one is admitted. */
+	uint64_t NumOffered = 0;
+	uint64_t LastOfferedId = ~0ull;
+	bool bLastOfferSkipped = false;
+	uint64_t NumSkipped = 0;
+
+	std::vector<FCaptureRateDecision> Decisions;
+	std::vector<std::pair<uint64_t, uint64_t>> SkippedRanges;
+};
+
+/** One decision as a line of JSON, for the capture_rate.jsonl file next to a session's container. */
+std::string FormatCaptureRateDecision(const FCaptureRateDecision& Decision, const FCaptureRateController& Controller);
+
+/** Closing line of that file: totals and the skipped frame ranges. */
+std::string FormatCaptureRateSummary(const FCaptureRateController& Controller);
@@ -0,0 +1,236 @@
+#include "CaptureReadback.h"
+
+#include "CaptureTrace.h"
+
+#include <cassert>
+#include <cstring>
+
+FCaptureReadbackRing::FCaptureReadbackRing(
+	ICaptureReadbackBackend& InBackend,
+	uint32_t InNumSlots,
+	uint32_t InMinLatencyFrames,
+	ECaptureBackPressure InBackPressure,
+	FConsumer InConsumer)
+	: Backend(InBackend)
+	, Slots(InNumSlots > 0 ? InNumSlots : 1)
+	, MinLatencyFrames(InMinLatencyFrames)
+	, BackPressure(InBackPressure)
+	, Consumer(std::move(InConsumer))
+{
+}
+
+void FCaptureReadbackRing::BeginFrame(uint64_t FrameNumber)
+{
+	assert(FrameNumber >= CurrentFrame);
+	CurrentFrame = FrameNumber;
+}
+
+int32_t FCaptureReadbackRing::Acquire(FCaptureReadbackRequest Request)
+{
+	const uint32_t NumSlots = GetNumSlots();
+
+	if (NumInFlight == NumSlots)
+	{
+		// Every slot is still in flight: try to make room before applying the back pressure policy.
+		Poll();
+	}
+
+	if (NumInFlight == NumSlots)
+	{
+		const uint32_t Oldest = (Head + NumSlots - NumInFlight) % NumSlots;
+		if (BackPressure == ECaptureBackPressure::DropNewest || Slots[Oldest].SubmitFrame == CurrentFrame)
+		{
+			Stats.Dropped++;
+			return -1;
+		}
+
+		Stats.Stalls++;
+		{
+			CAPTURE_TRACE_SCOPE("Capture.Stall");
+			Backend.WaitUntilReady(Oldest);
+		}
+		Retire(Oldest);
+	}
+
+	const uint32_t Slot = Head;
+	Slots[Slot].Request = std::move(Request);
+	Slots[Slot].SubmitFrame = CurrentFrame;
+	Slots[Slot].SubmitTime = CAPTURE_TRACE_NOW();
+
+	Head = (Head + 1) % NumSlots;
+	NumInFlight++;
+	Stats.Submitted++;
+	CAPTURE_TRACE_COUNTER("Capture.InFlight", NumInFlight);
+	return int32_t(Slot);
+}
+
+bool FCaptureReadbackRing::Reserve(uint32_t NumRequests)
+{
+	const uint32_t NumSlots = GetNumSlots();
+	if (NumRequests > NumSlots)
+	{
+		Stats.Dropped += NumRequests;
+		return false;
+	}
+
+	if (NumSlots - NumInFlight < NumRequests)
+	{
+		Poll();
+	}
+
+	if (NumSlots - NumInFlight < NumRequests)
+	{
+		if (BackPressure == ECaptureBackPressure::DropNewest)
+		{
+			Stats.Dropped += NumRequests;
+			return false;
+		}
+
+		// The slots the batch would have to wait for, oldest first; a copy submitted this frame has not run yet.
+		for (uint32_t Index = 0; Index < NumRequests - (NumSlots - NumInFlight); Index++)
+		{
+			if (Slots[(Head + NumSlots - NumInFlight + Index) % NumSlots].SubmitFrame == CurrentFrame)
+			{
+				Stats.Dropped += NumRequests;
+				return false;
+			}
+		}
+
+		while (NumSlots - NumInFlight < NumRequests)
+		{
+			const uint32_t Oldest = (Head + NumSlots - NumInFlight) % NumSlots;
+			Stats.Stalls++;
+			{
+				CAPTURE_TRACE_SCOPE("Capture.Stall");
+				Backend.WaitUntilReady(Oldest);
+			}
+			Retire(Oldest);
+		}
+	}
+	return true;
+}
+
+uint32_t FCaptureReadbackRing::Poll()
+{
+	const uint32_t NumSlots = GetNumSlots();
+	uint32_t NumDelivered = 0;
+
+	while (NumInFlight > 0)
+	{
+		const uint32_t Oldest = (Head + NumSlots - NumInFlight) % NumSlots;
+
+		// Younger slots were submitted later, so there is no point looking past the oldest one.
+		if (CurrentFrame - Slots[Oldest].SubmitFrame < MinLatencyFrames || !Backend.IsReady(Oldest))
+		{
+			break;
+		}
+
+		Retire(Oldest);
+		NumDelivered++;
+	}
+
+	return NumDelivered;
+}
+
+uint32_t FCaptureReadbackRing::Flush()
+{
+	CAPTURE_TRACE_SCOPE("Capture.Flush");
+	const uint32_t NumSlots = GetNumSlots();
+	uint32_t NumDelivered = 0;
+
+	while (NumInFlight > 0)
+	{
+		const uint32_t Oldest = (Head + NumSlots - NumInFlight) % NumSlots;
+		Backend.WaitUntilReady(Oldest);
+		Retire(Oldest);
+		NumDelivered++;
+	}
+
+	return NumDelivered;
+}
+
+void FCaptureReadbackRing::Retire(uint32_t Slot)
+{
+	// From the copy being recorded to the render thread finding it landed.
+	CAPTURE_TRACE_SPAN("Capture.GpuReady", Slots[Slot].SubmitTime);
+
+	FCaptureMappedSurface Surface;
+	if (Backend.Map(Slot, Surface))
+	{
+		if (Consumer)
+		{
+			CAPTURE_TRACE_SCOPE("Capture.Copy");
+			Consumer(Slots[Slot].Request, Surface);
+		}
+		Backend.Unmap(Slot);
+		Stats.Delivered++;
+	}
+	else
+	{
+		Stats.Dropped++;
+	}
+
+	Slots[Slot].Request = FCaptureReadbackRequest();
+	NumInFlight--;
+}
+
+FCaptureMockReadbackBackend::FCaptureMockReadbackBackend(uint32_t NumSlots, uint32_t InLatencyFrames, uint32_t InRowPitchAlignment)
+	: Staging(NumSlots)
+	, LatencyFrames(InLatencyFrames)
+	, RowPitchAlignment(InRowPitchAlignment > 0 ? InRowPitchAlignment : 1)
+{
+}
+
+void FCaptureMockReadbackBackend::EnqueueCopy(uint32_t Slot, const void* Pixels, int32_t Width, int32_t Height, uint32_t BytesPerPixel)
+{
+	FStaging& Entry = Staging[Slot];
+	assert(!Entry.bPending && !Entry.bMapped);
+
+	const uint32_t PackedPitch = uint32_t(Width) * BytesPerPixel;
+	Entry.RowPitch = (PackedPitch + RowPitchAlignment - 1) / RowPitchAlignment * RowPitchAlignment;
+
+	// Padding bytes are filled with garbage on purpose so consumers that ignore the pitch get caught.
+	Entry.Bytes.assign(size_t(Entry.RowPitch) * Height, 0xCD);
+	for (int32_t Y = 0; Y < Height; Y++)
+	{
+		memcpy(Entry.Bytes.data() + size_t(Y) * Entry.RowPitch, (const uint8_t*)Pixels + size_t(Y) * PackedPitch, PackedPitch);
+	}
+
+	Entry.ReadyFrame = CurrentFrame + LatencyFrames;
+	Entry.bPending = true;
+}
+
+bool FCaptureMockReadbackBackend::IsReady(uint32_t Slot)
+{
+	return Staging[Slot].bPending && CurrentFrame >= Staging[Slot].ReadyFrame;
+}
+
+void FCaptureMockReadbackBackend::WaitUntilReady(uint32_t Slot)
+{
+	// Emulates the GPU flush a real backend would have to do.
+	if (!IsReady(Slot))
+	{
+		NumWaits++;
+		Staging[Slot].ReadyFrame = CurrentFrame;
+	}
+}
+
+bool FCaptureMockReadbackBackend::Map(uint32_t Slot, FCaptureMappedSurface& OutSurface)
+{
+	FStaging& Entry = Staging[Slot];
+	if (!Entry.bPending)
+	{
+		return false;
+	}
+
+	Entry.bMapped = true;
+	OutSurface.Data = Entry.Bytes.data();
+	OutSurface.RowPitch = Entry.RowPitch;
+	return true;
+}
+
+void FCaptureMockReadbackBackend::Unmap(uint32_t Slot)
+{
+	Staging[Slot].bMapped = false;
+	Staging[Slot].bPending = false;
+}
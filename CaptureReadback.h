@@ -0,0 +1,176 @@
+#pragma once
+
+#include "CaptureDepth.h"
+#include "CaptureFrame.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Ring of staging slots used to read captured textures back without stalling the render thread.
+ *
+ * A hook acquires a slot, the backend records a GPU copy into it, and the slot is polled a few frames
+ * later. Slots retire strictly in submission order so the consumer always sees frames in order.
+ * The ring is not thread safe: acquire, poll and flush all happen on the render thread.
+ */
+
+/** Identifies one layer of one captured frame while it is in flight. */
+struct FCaptureReadbackRequest
+{
+	uint64_t FrameId = 0;
+	std::string Layer;
+	int32_t Width = 0;
+	int32_t Height = 0;
+
+	/** EPixelFormat of the source texture. */
+	uint32_t PixelFormat = 0;
+	uint32_t BytesPerPixel = 0;
+
+	/** Capture container the layer is appended to. */
+	std::string ContainerPath;
+
+	/** Slot of the frame bundle the layer belongs to; empty for a standalone record. */
+	FCaptureFrameLayerRef FrameLayer;
+
+	/** Set on scene depth layers that the writer converts to linear depth. */
+	FCaptureDepthLinearization DepthLinearization;
+};
+
+/** CPU view of a staging slot whose copy has landed. */
+struct FCaptureMappedSurface
+{
+	const uint8_t* Data = nullptr;
+
+	/** Distance between rows in bytes, may be larger than Width * BytesPerPixel. */
+	uint32_t RowPitch = 0;
+};
+
+enum class ECaptureBackPressure : uint8_t
+{
+	/** Refuse the new request when every slot is in flight. */
+	DropNewest,
+
+	/**
+	 * Block on the oldest in-flight slot and retire it to make room. A slot submitted in the current frame is never
+	 * waited on, its copy is recorded in a graph that has not run yet; the new request is dropped instead.
+	 */
+	WaitOldest,
+};
+
+struct FCaptureReadbackStats
+{
+	uint64_t Submitted = 0;
+	uint64_t Delivered = 0;
+	uint64_t Dropped = 0;
+	uint64_t Stalls = 0;
+};
+
+/** Staging storage the ring hands slots out of; the GPU copy itself is recorded by the concrete backend. */
+class ICaptureReadbackBackend
+{
+public:
+	virtual ~ICaptureReadbackBackend() {}
+
+	virtual bool IsReady(uint32_t Slot) = 0;
+	virtual void WaitUntilReady(uint32_t Slot) = 0;
+	virtual bool Map(uint32_t Slot, FCaptureMappedSurface& OutSurface) = 0;
+	virtual void Unmap(uint32_t Slot) = 0;
+};
+
+class FCaptureReadbackRing
+{
+public:
+	using FConsumer = std::function<void(const FCaptureReadbackRequest&, const FCaptureMappedSurface&)>;
+
+	FCaptureReadbackRing(
+		ICaptureReadbackBackend& InBackend,
+		uint32_t InNumSlots,
+		uint32_t InMinLatencyFrames,
+		ECaptureBackPressure InBackPressure,
+		FConsumer InConsumer);
+
+	/** Advances the frame clock used to decide when in-flight slots are worth polling. */
+	void BeginFrame(uint64_t FrameNumber);
+
+	/** Returns the slot the caller must copy into, or -1 when the request was dropped. */
+	int32_t Acquire(FCaptureReadbackRequest Request);
+
+	/**
+	 * Makes room for NumRequests acquisitions at once, applying the back pressure policy to the whole batch, so
+	 * the next NumRequests calls to Acquire() succeed. Returns false, counting every request as dropped, when
+	 * the batch does not fit, or would only fit by waiting on a slot submitted in the current frame.
+	 */
+	bool Reserve(uint32_t NumRequests);
+
+	/** Retires every slot that is ready, oldest first, and returns how many were delivered. */
+	uint32_t Poll();
+
+	/** Blocks until every in-flight slot has been delivered. */
+	uint32_t Flush();
+
+	uint32_t GetNumSlots() const { return uint32_t(Slots.size()); }
+	uint32_t GetNumInFlight() const { return NumInFlight; }
+	const FCaptureReadbackStats& GetStats() const { return Stats; }
+
+private:
+	struct FSlot
+	{
+		FCaptureReadbackRequest Request;
+		uint64_t SubmitFrame = 0;
+
+		/** Trace clock at Acquire(), 0 while tracing is off. */
+		uint64_t SubmitTime = 0;
+	};
+
+	void Retire(uint32_t Slot);
+
+	ICaptureReadbackBackend& Backend;
+	std::vector<FSlot> Slots;
+	uint32_t MinLatencyFrames;
+	ECaptureBackPressure BackPressure;
+	FConsumer Consumer;
+
+	uint64_t CurrentFrame = 0;
+	uint32_t Head = 0;
+	uint32_t NumInFlight = 0;
+	FCaptureReadbackStats Stats;
+};
+
+/**
+ * CPU stand-in for the GPU staging buffers. A copy becomes ready LatencyFrames after it was enqueued,
+ * and rows are padded to RowPitchAlignment the way D3D12 staging textures are.
+ */
+class FCaptureMockReadbackBackend : public ICaptureReadbackBackend
+{
+public:
+	FCaptureMockReadbackBackend(uint32_t NumSlots, uint32_t InLatencyFrames, uint32_t InRowPitchAlignment = 256);
+
+	void SetFrame(uint64_t FrameNumber) { CurrentFrame = FrameNumber; }
+	void EnqueueCopy(uint32_t Slot, const void* Pixels, int32_t Width, int32_t Height, uint32_t BytesPerPixel);
+
+	uint64_t GetNumWaits() const { return NumWaits; }
+
+	// ICaptureReadbackBackend
+	virtual bool IsReady(uint32_t Slot) override;
+	virtual void WaitUntilReady(uint32_t Slot) override;
+	virtual bool Map(uint32_t Slot, FCaptureMappedSurface& OutSurface) override;
+	virtual void Unmap(uint32_t Slot) override;
+
+private:
+	struct FStaging
+	{
+		std::vector<uint8_t> Bytes;
+		uint32_t RowPitch = 0;
+		uint64_t ReadyFrame = 0;
+		bool bPending = false;
+		bool bMapped = false;
+	};
+
+	std::vector<FStaging> Staging;
+	uint32_t LatencyFrames;
+	uint32_t RowPitchAlignment;
+	uint64_t CurrentFrame = 0;
+	uint64_t NumWaits = 0;
+};
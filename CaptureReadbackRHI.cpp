@@ -0,0 +1,405 @@
+#include "CaptureReadbackRHI.h"
+
+#include "GlobalShader.h"
+#include "RenderGraphUtils.h"
+#include "RenderingThread.h"
+#include "ShaderParameterStruct.h"
+
+#include "CapturePack.h"
+#include "CapturePixelFormat.h"
+#include "CaptureSubsystem.h"
+#include "CaptureTrace.h"
+
+namespace
+{
+
+TAutoConsoleVariable<int32> CVarCaptureReadbackRingSize(
+	TEXT("r.Capture.ReadbackRingSize"),
+	16,
+	TEXT("Number of staging buffers the capture readback ring cycles through. Only applied while no readback is in flight."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureReadbackLatency(
+	TEXT("r.Capture.ReadbackLatency"),
+	2,
+	TEXT("Number of frames to wait before a capture readback is polled for readiness (minimum 1)."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureReadbackBackPressure(
+	TEXT("r.Capture.ReadbackBackPressure"),
+	0,
+	TEXT("What to do when every capture staging buffer is in flight.\n")
+	TEXT(" 0: drop the new capture (default);\n")
+	TEXT(" 1: stall on the oldest readback so no frame is lost."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCapturePackColor(
+	TEXT("r.Capture.Pack.Color"),
+	1,
+	TEXT("Drop the unused alpha of FloatRGBA captures on the GPU before readback, 8 -> 6 bytes per pixel."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCapturePackDepth(
+	TEXT("r.Capture.Pack.Depth"),
+	0,
+	TEXT("Depth plane layout of depth/stencil captures, packed on the GPU before readback.\n")
+	TEXT(" 0: float, 4 bytes per pixel (default);\n")
+	TEXT(" 1: half float, 2 bytes per pixel;\n")
+	TEXT(" 2: 24 bit fixed point, 3 bytes per pixel."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCapturePackStencil(
+	TEXT("r.Capture.Pack.Stencil"),
+	1,
+	TEXT("Read the stencil of depth/stencil captures back as its own 1 byte per pixel layer next to the depth, 0 to skip it."),
+	ECVF_RenderThreadSafe);
+
+class FCapturePackCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FCapturePackCS);
+	SHADER_USE_PARAMETER_STRUCT(FCapturePackCS, FGlobalShader);
+
+	class FModeDim : SHADER_PERMUTATION_INT("CAPTURE_PACK_MODE", 4);
+	class FStencilDim : SHADER_PERMUTATION_BOOL("CAPTURE_PACK_STENCIL");
+	using FPermutationDomain = TShaderPermutationDomain<FModeDim, FStencilDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(FIntPoint, SourceMin)
+		SHADER_PARAMETER(FIntPoint, PackSize)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, ColorTexture)
+		SHADER_PARAMETER_RDG_TEXTURE(Texture2D, DepthTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_SRV(Texture2D<uint2>, StencilTexture)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, PackedOutput)
+		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, StencilOutput)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		// Color has no stencil to split.
+		const FPermutationDomain PermutationVector(Parameters.PermutationId);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5)
+			&& !(PermutationVector.Get<FModeDim>() == 0 && PermutationVector.Get<FStencilDim>());
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FCapturePackCS, "/Engine/Private/Capture/CapturePack.usf", "MainCS", SF_Compute);
+
+/** Layer name of the stencil plane split off a depth layer: "depth" -> "stencil", "history_depth" -> "history_stencil". */
+std::string GetStencilLayerName(const std::string& DepthLayer)
+{
+	const std::string Suffix = "depth";
+	if (DepthLayer.size() >= Suffix.size() && DepthLayer.compare(DepthLayer.size() - Suffix.size(), Suffix.size(), Suffix) == 0)
+	{
+		return DepthLayer.substr(0, DepthLayer.size() - Suffix.size()) + "stencil";
+	}
+	return DepthLayer + "_stencil";
+}
+
+void EnqueueReadbackWrite(const FCaptureReadbackRequest& Request, const FCaptureMappedSurface& Surface)
+{
+	const size_t PackedPitch = size_t(Request.Width) * Request.BytesPerPixel;
+
+	FCaptureSink::FCaptureJobPtr Job = std::make_unique<FCaptureWriteJob>();
+	Job->FrameId = Request.FrameId;
+	Job->Layer = Request.Layer;
+	Job->ContainerPath = Request.ContainerPath;
+	Job->Width = Request.Width;
+	Job->Height = Request.Height;
+	Job->PixelFormat = Request.PixelFormat;
+	Job->BytesPerPixel = Request.BytesPerPixel;
+	Job->FrameLayer = Request.FrameLayer;
+	Job->DepthLinearization = Request.DepthLinearization;
+
+	// The staging buffer goes back to the ring as soon as this returns, so the rows are packed into the job.
+	// Depth that is linearized later grows to 4 bytes per pixel on the writer, which the reserve covers.
+	const size_t LinearBytes = Request.DepthLinearization.bEnabled ? size_t(Request.Width) * Request.Height * sizeof(float) : 0;
+	Job->Bytes = GetCaptureBufferPool().Acquire(PackedPitch * Request.Height, LinearBytes);
+	CopyCaptureRows(Job->Bytes.data(), PackedPitch, Surface.Data, Surface.RowPitch, PackedPitch, uint32(Request.Height));
+
+	GetCaptureSink().Enqueue(MoveTemp(Job));
+}
+
+} //! namespace
+
+FCaptureReadbackRHI& FCaptureReadbackRHI::Get()
+{
+	static FCaptureReadbackRHI Instance;
+	return Instance;
+}
+
+void FCaptureReadbackRHI::BeginFrame()
+{
+	check(IsInRenderingThread());
+
+	if (LastFrameCounter == GFrameCounterRenderThread)
+	{
+		return;
+	}
+	LastFrameCounter = GFrameCounterRenderThread;
+
+	const int32 NumSlots = FMath::Max(CVarCaptureReadbackRingSize.GetValueOnRenderThread(), 1);
+	if (!Ring || (Ring->GetNumInFlight() == 0 && Ring->GetNumSlots() != uint32(NumSlots)))
+	{
+		Staging.Reset();
+		Staging.SetNum(NumSlots);
+		for (int32 SlotIndex = 0; SlotIndex < NumSlots; SlotIndex++)
+		{
+			Staging[SlotIndex].Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("CaptureReadback"));
+		}
+
+		// Polling the fence before the graph has executed the copy is not reliable, hence the minimum of one frame.
+		const uint32 MinLatencyFrames = FMath::Max(CVarCaptureReadbackLatency.GetValueOnRenderThread(), 1);
+		const ECaptureBackPressure BackPressure = CVarCaptureReadbackBackPressure.GetValueOnRenderThread() != 0
+			? ECaptureBackPressure::WaitOldest
+			: ECaptureBackPressure::DropNewest;
+
+		Ring = MakeUnique<FCaptureReadbackRing>(*this, NumSlots, MinLatencyFrames, BackPressure, &EnqueueReadbackWrite);
+		SetCaptureTraceThreadName("Render thread");
+	}
+
+	Ring->BeginFrame(GFrameCounterRenderThread);
+	Ring->Poll();
+}
+
+bool FCaptureReadbackRHI::AddReadbackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request)
+{
+	check(Texture);
+	BeginFrame();
+	CAPTURE_TRACE_SCOPE("Capture.Submit");
+
+	const EPixelFormat Format = Texture->Desc.Format;
+	if (Format == PF_DepthStencil)
+	{
+		return AddDepthReadbackPasses(GraphBuilder, Texture, Rect, MoveTemp(Request));
+	}
+	if (Format == PF_FloatRGBA && CVarCapturePackColor.GetValueOnRenderThread() != 0)
+	{
+		return AddColorReadbackPass(GraphBuilder, Texture, Rect, MoveTemp(Request));
+	}
+
+	if (!FindCapturePixelFormat(uint32(Format)) || GPixelFormats[Format].BlockSizeX != 1)
+	{
+		return false;
+	}
+
+	Request.Width = Rect.Width();
+	Request.Height = Rect.Height();
+	Request.PixelFormat = uint32(Format);
+	Request.BytesPerPixel = GPixelFormats[Format].BlockBytes;
+	return AddCopyPass(GraphBuilder, Texture, Rect, Request.BytesPerPixel, MoveTemp(Request));
+}
+
+bool FCaptureReadbackRHI::AddBatchedReadbackPasses(FRDGBuilder& GraphBuilder, TArrayView<FCaptureReadbackBatchItem> Items)
+{
+	BeginFrame();
+
+	uint32 NumSlots = 0;
+	for (const FCaptureReadbackBatchItem& Item : Items)
+	{
+		NumSlots += GetNumSlotsFor(Item.Texture);
+	}
+	if (NumSlots == 0 || !Ring->Reserve(NumSlots))
+	{
+		return false;
+	}
+
+	bool bQueued = true;
+	for (FCaptureReadbackBatchItem& Item : Items)
+	{
+		if (GetNumSlotsFor(Item.Texture))
+		{
+			bQueued &= AddReadbackPass(GraphBuilder, Item.Texture, Item.Rect, MoveTemp(Item.Request));
+		}
+	}
+	return bQueued;
+}
+
+uint32 FCaptureReadbackRHI::GetNumSlotsFor(FRDGTextureRef Texture) const
+{
+	if (!Texture)
+	{
+		return 0;
+	}
+
+	const EPixelFormat Format = Texture->Desc.Format;
+	if (Format == PF_DepthStencil)
+	{
+		return CVarCapturePackStencil.GetValueOnRenderThread() != 0 ? 2 : 1;
+	}
+	if (Format == PF_FloatRGBA)
+	{
+		return 1;
+	}
+	return FindCapturePixelFormat(uint32(Format)) && GPixelFormats[Format].BlockSizeX == 1 ? 1 : 0;
+}
+
+bool FCaptureReadbackRHI::AddColorReadbackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request)
+{
+	const FIntPoint Size = Rect.Size();
+	FRDGTextureRef Packed = AddPackPass(GraphBuilder, Texture, Rect, /* Mode = */ 0, FIntPoint(Size.X * 3, Size.Y), PF_R16_UINT, nullptr);
+
+	Request.Width = Size.X;
+	Request.Height = Size.Y;
+	Request.PixelFormat = CapturePF_PackedFloat16RGB;
+	Request.BytesPerPixel = 6;
+	return AddCopyPass(GraphBuilder, Packed, FIntRect(FIntPoint::ZeroValue, Packed->Desc.Extent), sizeof(uint16), MoveTemp(Request));
+}
+
+bool FCaptureReadbackRHI::AddDepthReadbackPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request)
+{
+	const ECaptureDepthPack Mode = ECaptureDepthPack(FMath::Clamp(CVarCapturePackDepth.GetValueOnRenderThread(), 0, 2));
+	const bool bStencil = CVarCapturePackStencil.GetValueOnRenderThread() != 0;
+	const FIntPoint Size = Rect.Size();
+
+	FIntPoint PackedExtent = Size;
+	EPixelFormat PackedFormat = PF_R32_UINT;
+	if (Mode == ECaptureDepthPack::Float16)
+	{
+		PackedFormat = PF_R16_UINT;
+	}
+	else if (Mode == ECaptureDepthPack::UNorm24)
+	{
+		PackedExtent.X *= 3;
+		PackedFormat = PF_R8_UINT;
+	}
+
+	FRDGTextureRef Stencil = nullptr;
+	FRDGTextureRef Packed = AddPackPass(GraphBuilder, Texture, Rect, 1 + int32(Mode), PackedExtent, PackedFormat, bStencil ? &Stencil : nullptr);
+
+	// The stencil plane takes its own slot in the frame bundle, reserved before the depth request moves on.
+	FCaptureReadbackRequest StencilRequest;
+	if (Stencil)
+	{
+		StencilRequest.FrameId = Request.FrameId;
+		StencilRequest.Layer = GetStencilLayerName(Request.Layer);
+		StencilRequest.ContainerPath = Request.ContainerPath;
+		StencilRequest.FrameLayer = Request.FrameLayer.AddSibling(StencilRequest.Layer);
+		StencilRequest.Width = Size.X;
+		StencilRequest.Height = Size.Y;
+		StencilRequest.PixelFormat = CapturePF_R8_UINT;
+		StencilRequest.BytesPerPixel = 1;
+	}
+
+	Request.Width = Size.X;
+	Request.Height = Size.Y;
+	Request.PixelFormat = GetCaptureDepthPackFormat(Mode);
+	Request.BytesPerPixel = GetCaptureDepthPackBytes(Mode);
+	const bool bQueued = AddCopyPass(GraphBuilder, Packed, FIntRect(FIntPoint::ZeroValue, PackedExtent), GPixelFormats[PackedFormat].BlockBytes, MoveTemp(Request));
+
+	if (Stencil)
+	{
+		AddCopyPass(GraphBuilder, Stencil, FIntRect(FIntPoint::ZeroValue, Size), 1, MoveTemp(StencilRequest));
+	}
+	return bQueued;
+}
+
+FRDGTextureRef FCaptureReadbackRHI::AddPackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, int32 Mode,
+	FIntPoint PackedExtent, EPixelFormat PackedFormat, FRDGTextureRef* OutStencil)
+{
+	const FRDGTextureDesc PackedDesc = FRDGTextureDesc::Create2D(PackedExtent, PackedFormat, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV);
+	FRDGTextureRef Packed = GraphBuilder.CreateTexture(PackedDesc, TEXT("Capture.Packed"));
+
+	FCapturePackCS::FParameters* PassParameters = GraphBuilder.AllocParameters<FCapturePackCS::FParameters>();
+	PassParameters->SourceMin = Rect.Min;
+	PassParameters->PackSize = Rect.Size();
+	PassParameters->PackedOutput = GraphBuilder.CreateUAV(Packed);
+
+	if (Mode == 0)
+	{
+		PassParameters->ColorTexture = Texture;
+	}
+	else
+	{
+		PassParameters->DepthTexture = Texture;
+	}
+
+	if (OutStencil)
+	{
+		const FRDGTextureDesc StencilDesc = FRDGTextureDesc::Create2D(Rect.Size(), PF_R8_UINT, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV);
+		*OutStencil = GraphBuilder.CreateTexture(StencilDesc, TEXT("Capture.PackedStencil"));
+
+		PassParameters->StencilTexture = GraphBuilder.CreateSRV(FRDGTextureSRVDesc::CreateWithPixelFormat(Texture, PF_X24_G8));
+		PassParameters->StencilOutput = GraphBuilder.CreateUAV(*OutStencil);
+	}
+
+	FCapturePackCS::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FCapturePackCS::FModeDim>(Mode);
+	PermutationVector.Set<FCapturePackCS::FStencilDim>(OutStencil != nullptr);
+	TShaderMapRef<FCapturePackCS> ComputeShader(GetGlobalShaderMap(GMaxRHIFeatureLevel), PermutationVector);
+
+	FComputeShaderUtils::AddPass(
+		GraphBuilder,
+		RDG_EVENT_NAME("CapturePack %dx%d", Rect.Width(), Rect.Height()),
+		ComputeShader,
+		PassParameters,
+		FComputeShaderUtils::GetGroupCount(Rect.Size(), 8));
+
+	return Packed;
+}
+
+bool FCaptureReadbackRHI::AddCopyPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, uint32 TexelBytes, FCaptureReadbackRequest&& Request)
+{
+	const int32 Slot = Ring->Acquire(MoveTemp(Request));
+	if (Slot < 0)
+	{
+		return false;
+	}
+
+	Staging[Slot].Rect = Rect;
+	Staging[Slot].BytesPerPixel = TexelBytes;
+	AddEnqueueCopyPass(GraphBuilder, Staging[Slot].Readback.Get(), Texture);
+	return true;
+}
+
+void FCaptureReadbackRHI::Flush()
+{
+	check(IsInRenderingThread());
+	if (Ring)
+	{
+		Ring->Flush();
+	}
+}
+
+FCaptureReadbackStats FCaptureReadbackRHI::GetStats() const
+{
+	check(IsInRenderingThread());
+	return Ring ? Ring->GetStats() : FCaptureReadbackStats();
+}
+
+bool FCaptureReadbackRHI::IsReady(uint32 Slot)
+{
+	return Staging[Slot].Readback->IsReady();
+}
+
+void FCaptureReadbackRHI::WaitUntilReady(uint32 Slot)
+{
+	FRHIGPUTextureReadback* Readback = Staging[Slot].Readback.Get();
+	if (!Readback->IsReady())
+	{
+		FRHICommandListExecutor::GetImmediateCommandList().BlockUntilGPUIdle();
+	}
+}
+
+bool FCaptureReadbackRHI::Map(uint32 Slot, FCaptureMappedSurface& OutSurface)
+{
+	FStaging& Entry = Staging[Slot];
+
+	void* Data = nullptr;
+	int32 RowPitchInPixels = 0;
+	Entry.Readback->LockTexture(FRHICommandListExecutor::GetImmediateCommandList(), Data, RowPitchInPixels);
+	if (!Data)
+	{
+		return false;
+	}
+
+	// The staging texture mirrors the whole source extent, so the view rect is addressed from its min corner.
+	OutSurface.RowPitch = uint32(RowPitchInPixels) * Entry.BytesPerPixel;
+	OutSurface.Data = (const uint8*)Data + size_t(Entry.Rect.Min.Y) * OutSurface.RowPitch + size_t(Entry.Rect.Min.X) * Entry.BytesPerPixel;
+	return true;
+}
+
+void FCaptureReadbackRHI::Unmap(uint32 Slot)
+{
+	Staging[Slot].Readback->Unlock();
+}
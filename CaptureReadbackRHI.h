@@ -0,0 +1,85 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphBuilder.h"
+#include "RHIGPUReadback.h"
+
+#include "CaptureReadback.h"
+
+/** One texture of a batched readback. */
+struct FCaptureReadbackBatchItem
+{
+	FRDGTextureRef Texture = nullptr;
+	FIntRect Rect;
+	FCaptureReadbackRequest Request;
+};
+
+/**
+ * GPU backend of the capture readback ring. Hooks call AddReadbackPass() from the render thread while
+ * setting up their graph; the copy lands in an FRHIGPUTextureReadback and is polled on later frames
+ * instead of flushing the GPU the way ReadSurfaceFloatData does.
+ */
+class FCaptureReadbackRHI : public ICaptureReadbackBackend
+{
+public:
+	static FCaptureReadbackRHI& Get();
+
+	/**
+	 * Queues an async copy of Rect from Texture. FloatRGBA and depth/stencil textures are packed on the GPU first
+	 * (r.Capture.Pack.*, see CapturePack.h). Returns false if the ring dropped the request or the format is not capturable.
+	 */
+	bool AddReadbackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request);
+
+	/**
+	 * Queues the copies of several textures as one request: the ring makes room for all of them up front, so either
+	 * every item is read back or none is. Items without a texture or with a format that is not capturable are skipped.
+	 * Moves the requests out.
+	 */
+	bool AddBatchedReadbackPasses(FRDGBuilder& GraphBuilder, TArrayView<FCaptureReadbackBatchItem> Items);
+
+	/** Blocks until every pending readback has been delivered, e.g. when a capture session stops. */
+	void Flush();
+
+	/** Counters of the ring since it was created, zero before the first readback. Render thread. */
+	FCaptureReadbackStats GetStats() const;
+
+	// ICaptureReadbackBackend
+	virtual bool IsReady(uint32 Slot) override;
+	virtual void WaitUntilReady(uint32 Slot) override;
+	virtual bool Map(uint32 Slot, FCaptureMappedSurface& OutSurface) override;
+	virtual void Unmap(uint32 Slot) override;
+
+private:
+	FCaptureReadbackRHI() = default;
+
+	void BeginFrame();
+
+	/** Ring slots AddReadbackPass() takes for a texture, 0 if it cannot be captured. */
+	uint32 GetNumSlotsFor(FRDGTextureRef Texture) const;
+
+	/** Packs FloatRGBA to three halves per pixel before the copy. */
+	bool AddColorReadbackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request);
+
+	/** Packs the depth plane as r.Capture.Pack.Depth asks and splits off the stencil as a layer of its own. */
+	bool AddDepthReadbackPasses(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, FCaptureReadbackRequest&& Request);
+
+	/** Runs CapturePack.usf over Rect into a new UINT texture, and into a stencil plane when OutStencil is set. */
+	FRDGTextureRef AddPackPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, int32 Mode,
+		FIntPoint PackedExtent, EPixelFormat PackedFormat, FRDGTextureRef* OutStencil);
+
+	/** Acquires a ring slot for Request and copies Texture into it. Rect and TexelBytes address the staging texture. */
+	bool AddCopyPass(FRDGBuilder& GraphBuilder, FRDGTextureRef Texture, FIntRect Rect, uint32 TexelBytes, FCaptureReadbackRequest&& Request);
+
+	struct FStaging
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		FIntRect Rect;
+
+		/** Bytes of one texel of the copied texture, which differ from the record's for packed layers. */
+		uint32 BytesPerPixel = 0;
+	};
+
+	TArray<FStaging> Staging;
+	TUniquePtr<FCaptureReadbackRing> Ring;
+	uint64 LastFrameCounter = ~0ull;
+};
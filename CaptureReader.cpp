@@ -0,0 +1,266 @@
+#include "CaptureReader.h"
+
+#include "CaptureCompress.h"
+#include "CapturePixelFormat.h"
+
+#include <cstring>
+
+namespace
+{
+
+struct FCaptureLayout
+{
+	ECaptureElementType ElementType;
+	uint32_t Channels;
+	uint32_t ElementSize;
+};
+
+FCaptureLayout GetLayout(uint32_t PixelFormat, uint32_t BytesPerPixel)
+{
+	if (const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(PixelFormat))
+	{
+		return { Desc->ElementType, Desc->NumChannels, GetCaptureElementSize(Desc->ElementType) };
+	}
+
+	// Unknown formats are still viewable as raw bytes.
+	return { ECaptureElementType::UInt8, BytesPerPixel, 1 };
+}
+
+} //! namespace
+
+bool FCaptureReader::Open(const std::string& Path)
+{
+	return Container.Open(Path);
+}
+
+void FCaptureReader::Close()
+{
+	Container.Close();
+}
+
+bool FCaptureReader::GetView(uint32_t FrameIndex, const char* Layer, const char* Component, FCaptureView& OutView, std::vector<uint8_t>* DecodeBuffer) const
+{
+	if (FrameIndex >= GetNumFrames())
+	{
+		return false;
+	}
+
+	const FCaptureChunkHeader* Record = Container.FindRecord(GetFrameId(FrameIndex), Layer);
+	if (!Record)
+	{
+		return false;
+	}
+
+	const uint8_t* Payload = Container.GetPayload(*Record);
+	if (!Payload)
+	{
+		return false;
+	}
+
+	// Encoded payloads cannot be viewed in place, they are decoded into the caller's buffer.
+	if (Record->Codec != uint16_t(ECaptureCodec::Raw))
+	{
+		if (!DecodeBuffer || !DecodePayload(*Record, Payload, *DecodeBuffer))
+		{
+			return false;
+		}
+		Payload = DecodeBuffer->data();
+	}
+
+	const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(Record->PixelFormat);
+	const FCaptureLayout Layout = GetLayout(Record->PixelFormat, Record->BytesPerPixel);
+
+	OutView.Data = Payload;
+	OutView.Shape[0] = Record->Height;
+	OutView.Shape[1] = Record->Width;
+	OutView.Shape[2] = Layout.Channels;
+	OutView.Strides[0] = Record->RowPitch;
+	OutView.Strides[1] = Record->BytesPerPixel;
+	OutView.Strides[2] = Layout.ElementSize;
+	OutView.ElementType = Layout.ElementType;
+	OutView.FrameId = Record->FrameId;
+	OutView.PixelFormat = Record->PixelFormat;
+
+	if (!Component || !Component[0])
+	{
+		return true;
+	}
+	else if (strcmp(Component, "rgb") == 0 && Record->PixelFormat == CapturePF_FloatR11G11B10)
+	{
+		// Red, green and blue are all in the packed element: the view stays whole for ConvertCaptureView() to unpack.
+		return true;
+	}
+	else if (strcmp(Component, "rgb") == 0 && Desc && !Desc->bPacked)
+	{
+		const int32_t Red = FindCaptureChannel(*Desc, 'R');
+		const int32_t Green = FindCaptureChannel(*Desc, 'G');
+		const int32_t Blue = FindCaptureChannel(*Desc, 'B');
+
+		// RGB and BGR orders are both a fixed channel stride away, BGR simply walks backwards from red.
+		const int32_t Step = Green - Red;
+		if (Red < 0 || Green < 0 || Blue < 0 || (Step != 1 && Step != -1) || Blue - Green != Step)
+		{
+			return false;
+		}
+
+		OutView.Data = Payload + Red * Layout.ElementSize;
+		OutView.Shape[2] = 3;
+		OutView.Strides[2] = Step * int64_t(Layout.ElementSize);
+		return true;
+	}
+	else if (strcmp(Component, "depth") == 0 && Desc && Desc->bDepthStencil)
+	{
+		OutView.Shape[2] = 1;
+		return true;
+	}
+	else if (strcmp(Component, "stencil") == 0 && Desc && Desc->bDepthStencil && Record->BytesPerPixel >= 5)
+	{
+		// 8 byte depth/stencil readback: float depth followed by the stencil byte.
+		OutView.Data = Payload + sizeof(float);
+		OutView.Shape[2] = 1;
+		OutView.Strides[2] = 1;
+		OutView.ElementType = ECaptureElementType::UInt8;
+		return true;
+	}
+
+	return false;
+}
+
+bool FCaptureReader::DecodePayload(const FCaptureChunkHeader& Record, const uint8_t* Payload, std::vector<uint8_t>& OutBytes)
+{
+	if (Record.Codec != uint16_t(ECaptureCodec::ShuffleDeltaRans) || Record.RawSize != uint64_t(Record.RowPitch) * uint64_t(Record.Height))
+	{
+		return false;
+	}
+
+	OutBytes.resize(Record.RawSize);
+	return DecodeCapturePayload(Payload, Record.PayloadSize, Record.Width, Record.Height, Record.BytesPerPixel, OutBytes.data());
+}
+
+void FCaptureReader::Prefetch(uint32_t FrameIndex) const
+{
+	if (FrameIndex >= GetNumFrames())
+	{
+		return;
+	}
+
+	const uint64_t FrameId = GetFrameId(FrameIndex);
+	for (uint32_t LayerIndex = 0; LayerIndex < Container.GetLayers().size(); LayerIndex++)
+	{
+		if (const FCaptureChunkHeader* Record = Container.FindRecord(FrameId, LayerIndex))
+		{
+			Container.PrefetchPayload(*Record);
+		}
+	}
+}
+
+CAPTURE_READER_API void* CaptureReaderOpen(const char* Path)
+{
+	FCaptureReader* Reader = new FCaptureReader();
+	if (!Reader->Open(Path))
+	{
+		delete Reader;
+		return nullptr;
+	}
+	return Reader;
+}
+
+CAPTURE_READER_API void CaptureReaderClose(void* Reader)
+{
+	delete (FCaptureReader*)Reader;
+}
+
+CAPTURE_READER_API uint32_t CaptureReaderNumFrames(void* Reader)
+{
+	return ((FCaptureReader*)Reader)->GetNumFrames();
+}
+
+CAPTURE_READER_API uint64_t CaptureReaderFrameId(void* Reader, uint32_t FrameIndex)
+{
+	const FCaptureReader* Self = (FCaptureReader*)Reader;
+	return FrameIndex < Self->GetNumFrames() ? Self->GetFrameId(FrameIndex) : ~0ull;
+}
+
+CAPTURE_READER_API uint32_t CaptureReaderNumLayers(void* Reader)
+{
+	return uint32_t(((FCaptureReader*)Reader)->GetContainer().GetLayers().size());
+}
+
+CAPTURE_READER_API const char* CaptureReaderLayerName(void* Reader, uint32_t LayerIndex)
+{
+	const std::vector<FCaptureLayerDesc>& Layers = ((FCaptureReader*)Reader)->GetContainer().GetLayers();
+	return LayerIndex < Layers.size() ? Layers[LayerIndex].Name : nullptr;
+}
+
+CAPTURE_READER_API int32_t CaptureReaderGetView(void* Reader, uint32_t FrameIndex, const char* Layer, const char* Component, FCaptureViewC* OutView)
+{
+	FCaptureView View;
+	if (!((FCaptureReader*)Reader)->GetView(FrameIndex, Layer, Component, View))
+	{
+		return 0;
+	}
+
+	OutView->Data = View.Data;
+	memcpy(OutView->Shape, View.Shape, sizeof(View.Shape));
+	memcpy(OutView->Strides, View.Strides, sizeof(View.Strides));
+	OutView->ElementType = int32_t(View.ElementType);
+	OutView->PixelFormat = View.PixelFormat;
+	OutView->FrameId = View.FrameId;
+	return 1;
+}
+
+CAPTURE_READER_API uint64_t CaptureReaderDecodedSize(void* Reader, uint32_t FrameIndex, const char* Layer)
+{
+	const FCaptureReader* Self = (FCaptureReader*)Reader;
+	if (FrameIndex >= Self->GetNumFrames())
+	{
+		return 0;
+	}
+
+	const FCaptureChunkHeader* Record = Self->GetContainer().FindRecord(Self->GetFrameId(FrameIndex), Layer);
+	return Record ? Record->RawSize : 0;
+}
+
+CAPTURE_READER_API int32_t CaptureReaderDecodeView(void* Reader, uint32_t FrameIndex, const char* Layer, const char* Component, void* Buffer, uint64_t BufferSize, FCaptureViewC* OutView)
+{
+	FCaptureView View;
+	std::vector<uint8_t> Decoded;
+	if (!((FCaptureReader*)Reader)->GetView(FrameIndex, Layer, Component, View, &Decoded) || Decoded.size() > BufferSize)
+	{
+		return 0;
+	}
+
+	// Rebase the view onto the caller's buffer so Python owns the decoded pixels.
+	memcpy(Buffer, Decoded.data(), Decoded.size());
+	OutView->Data = (const uint8_t*)Buffer + (View.Data - Decoded.data());
+	memcpy(OutView->Shape, View.Shape, sizeof(View.Shape));
+	memcpy(OutView->Strides, View.Strides, sizeof(View.Strides));
+	OutView->ElementType = int32_t(View.ElementType);
+	OutView->PixelFormat = View.PixelFormat;
+	OutView->FrameId = View.FrameId;
+	return 1;
+}
+
+CAPTURE_READER_API void CaptureReaderPrefetch(void* Reader, uint32_t FrameIndex)
+{
+	((FCaptureReader*)Reader)->Prefetch(FrameIndex);
+}
+
+CAPTURE_READER_API int32_t CaptureReaderFrameInfo(void* Reader, uint32_t FrameIndex, FCaptureFrameInfoC* OutInfo)
+{
+	const FCaptureReader* Self = (FCaptureReader*)Reader;
+	const FCaptureFrameInfo* Info = FrameIndex < Self->GetNumFrames() ? Self->GetContainer().FindFrame(Self->GetFrameId(FrameIndex)) : nullptr;
+	if (!Info)
+	{
+		return 0;
+	}
+
+	OutInfo->JitterX = Info->JitterX;
+	OutInfo->JitterY = Info->JitterY;
+	OutInfo->PreExposure = Info->PreExposure;
+	OutInfo->Flags = Info->Flags;
+	OutInfo->NumLayers = Info->NumLayers;
+	OutInfo->NumDropped = Info->NumDropped;
+	OutInfo->RateLevel = Info->RateLevel;
+	return 1;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "CaptureContainer.h"
+#include "CapturePixelFormat.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Zero-copy access to a capture container for training data loaders. Views point straight into the mapped
+ * file and stay valid until the reader is closed.
+ */
+
+/** Strided {Height, Width, Channels} view over one layer of one frame. Strides are in bytes. */
+struct FCaptureView
+{
+	const uint8_t* Data = nullptr;
+	int64_t Shape[3] = {};
+	int64_t Strides[3] = {};
+	ECaptureElementType ElementType = ECaptureElementType::UInt8;
+
+	uint64_t FrameId = 0;
+	uint32_t PixelFormat = 0;
+};
+
+class FCaptureReader
+{
+public:
+	bool Open(const std::string& Path);
+	void Close();
+
+	bool IsOpen() const { return Container.IsOpen(); }
+	const FCaptureContainerReader& GetContainer() const { return Container; }
+
+	uint32_t GetNumFrames() const { return uint32_t(Container.GetFrameIds().size()); }
+	uint64_t GetFrameId(uint32_t FrameIndex) const { return Container.GetFrameIds()[FrameIndex]; }
+
+	/**
+	 * Returns the view of Layer at FrameIndex. Component narrows it without copying:
+	 *  nullptr or "" - every channel of the format (RGBA for FFloat16Color, GR for G16R16F, depth for depth/stencil);
+	 *  "rgb"         - red, green and blue of a color layer, in that order whatever the memory order (FloatR11G11B10
+	 *                  stays one packed element);
+	 *  "depth"       - float depth of a depth/stencil layer;
+	 *  "stencil"     - stencil byte of a depth/stencil layer.
+	 * Compressed records are only readable with a DecodeBuffer; the view then points into it.
+	 */
+	bool GetView(uint32_t FrameIndex, const char* Layer, const char* Component, FCaptureView& OutView, std::vector<uint8_t>* DecodeBuffer = nullptr) const;
+
+	/** Decodes a compressed record into OutBytes, Height rows of RowPitch bytes. */
+	static bool DecodePayload(const FCaptureChunkHeader& Record, const uint8_t* Payload, std::vector<uint8_t>& OutBytes);
+
+	/** Starts paging in every layer of a frame, typically called a few frames ahead of the consumer. */
+	void Prefetch(uint32_t FrameIndex) const;
+
+private:
+	FCaptureContainerReader Container;
+};
+
+/** C interface used by capture_reader.py through ctypes. */
+#if defined(_WIN32)
+	#define CAPTURE_READER_API extern "C" __declspec(dllexport)
+#else
+	#define CAPTURE_READER_API extern "C" __attribute__((visibility("default")))
+#endif
+
+struct FCaptureViewC
+{
+	const void* Data;
+	int64_t Shape[3];
+	int64_t Strides[3];
+	int32_t ElementType;
+	uint32_t PixelFormat;
+	uint64_t FrameId;
+};
+
+struct FCaptureFrameInfoC
+{
+	float JitterX;
+	float JitterY;
+	float PreExposure;
+	uint32_t Flags;
+	uint32_t NumLayers;
+	uint32_t NumDropped;
+	uint32_t RateLevel;
+};
+
+CAPTURE_READER_API void* CaptureReaderOpen(const char* Path);
+CAPTURE_READER_API void CaptureReaderClose(void* Reader);
+CAPTURE_READER_API uint32_t CaptureReaderNumFrames(void* Reader);
+CAPTURE_READER_API uint64_t CaptureReaderFrameId(void* Reader, uint32_t FrameIndex);
+CAPTURE_READER_API uint32_t CaptureReaderNumLayers(void* Reader);
+CAPTURE_READER_API const char* CaptureReaderLayerName(void* Reader, uint32_t LayerIndex);
+CAPTURE_READER_API int32_t CaptureReaderGetView(void* Reader, uint32_t FrameIndex, const char* Layer, const char* Component, FCaptureViewC* OutView);
+CAPTURE_READER_API uint64_t CaptureReaderDecodedSize(void* Reader, uint32_t FrameIndex, const char* Layer);
+CAPTURE_READER_API int32_t CaptureReaderDecodeView(void* Reader, uint32_t FrameIndex, const char* Layer, const char* Component, void* Buffer, uint64_t BufferSize, FCaptureViewC* OutView);
+CAPTURE_READER_API void CaptureReaderPrefetch(void* Reader, uint32_t FrameIndex);
+
+/** Returns 0 for frames that were not written as a bundle and carry no metadata. */
+CAPTURE_READER_API int32_t CaptureReaderFrameInfo(void* Reader, uint32_t FrameIndex, FCaptureFrameInfoC* OutInfo);
+
+/**
+ * ConvertCaptureViewToPlanes() of a view returned above, defined in CaptureImage.cpp: the number of float planes it
+ * converts to, then the planes of Shape[0] * Shape[1] floats each into Dest. Returns 0 for an element type with no
+ * float meaning.
+ */
+CAPTURE_READER_API int32_t CaptureReaderNumFloatPlanes(const FCaptureViewC* View);
+CAPTURE_READER_API int32_t CaptureReaderConvertToFloat(const FCaptureViewC* View, float* Dest);
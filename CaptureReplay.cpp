@@ -0,0 +1,323 @@
+/**
+ * Replays a captured sequence through the CPU reference of the Gen4 TAA resolve (CaptureTAAGen4.h), or with --gen5
+ * of the Gen5 TAAU chain (CaptureTAAGen5.h), whose time per pass is reported at the end.
+ *
+ *   capture_replay [options] <input.ucap>
+ *
+ * Every frame's "input", "velocity" and "depth" layers go through the resolve with the frame's jitter, pre-exposure
+ * and camera cut, at the size of the captured "output" layer (MainUpsampling when it is larger than the input) or
+ * at --size. When the capture has an "output" layer of that size the resolve is compared against it, frame by frame.
+ * With --output the resolved frames are written to a new container as "output" layers of PackedFloat16RGB,
+ * carrying the frame metadata of the source.
+ *
+ * Build: g++ -O2 -std=c++17 -mavx2 CaptureReplay.cpp CaptureTAAGen4.cpp CaptureTAAGen5.cpp CaptureResample.cpp CaptureFilterKernels.cpp
+ *        CaptureImage.cpp CaptureParallel.cpp CaptureReader.cpp CaptureContainer.cpp CaptureCompress.cpp CaptureHalf.cpp CapturePack.cpp CapturePixelFormat.cpp
+ *        CaptureTrace.cpp -lpthread
+ */
+
+#include "CaptureHalf.h"
+#include "CaptureImage.h"
+#include "CaptureReader.h"
+#include "CaptureSimd.h"
+#include "CaptureTAAGen4.h"
+#include "CaptureTAAGen5.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct FReplayOptions
+{
+	std::string InputPath;
+	std::string OutputPath;
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t NumFrames = ~0u;
+	FCaptureTAAGen4Settings Settings;
+	bool bGen5 = false;
+	FCaptureTAAGen5Settings Gen5Settings;
+};
+
+void PrintUsage()
+{
+	printf(
+		"usage: capture_replay [options] <input.ucap>\n"
+		"  --output file.ucap            write the resolved frames to a new container\n"
+		"  --size WxH                    output size (default: the captured output, else the input)\n"
+		"  --frames N                    replay the first N frames\n"
+		"  --threads N                   resolve threads (default: one per hardware thread)\n"
+		"  --current-frame-weight F      r.TemporalAACurrentFrameWeight (default 0.04)\n"
+		"  --filter-size F               r.TemporalAAFilterSize (default 1)\n"
+		"  --kernel NAME                 r.TemporalAAFilterKernel: gaussian (default), catmull-rom, mitchell-netravali,\n"
+		"                                lanczos2, lanczos3 or blackman-harris\n"
+		"  --catmull-rom                 r.TemporalAACatmullRom 1, same as --kernel catmull-rom\n"
+		"  --no-upsample-filter          r.TemporalAAUpsampleFiltered 0\n"
+		"  --fast                        low quality TAA (plus neighborhood, bilinear history)\n"
+		"  --r11g11b10                   r.TemporalAA.R11G11B10History 1, fast only as in the engine\n"
+		"  --exposure F                  eye adaptation exposure of the HDR weights (default 1)\n"
+		"  --scalar                      one pixel at a time instead of eight lanes\n"
+		"  --gen5                        r.TemporalAA.Algorithm 1, the Gen5 TAAU chain; of the options above only --threads\n"
+		"                                and --r11g11b10 apply to it\n"
+		"  --history-screen-percentage F gen5: r.TemporalAA.HistoryScreenPercentage (default 100)\n"
+		"  --max-sample-count F          gen5: samples the history accumulates at most (default 16)\n");
+}
+
+bool ParseOptions(int Argc, char** Argv, FReplayOptions& Options)
+{
+	for (int Arg = 1; Arg < Argc; Arg++)
+	{
+		const char* Value = Argv[Arg];
+		const bool bHasNext = Arg + 1 < Argc;
+
+		if (strcmp(Value, "--output") == 0 && bHasNext)
+		{
+			Options.OutputPath = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--size") == 0 && bHasNext)
+		{
+			if (sscanf(Argv[++Arg], "%dx%d", &Options.Width, &Options.Height) != 2 || Options.Width <= 0 || Options.Height <= 0)
+			{
+				return false;
+			}
+		}
+		else if (strcmp(Value, "--frames") == 0 && bHasNext)
+		{
+			Options.NumFrames = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--threads") == 0 && bHasNext)
+		{
+			Options.Settings.NumThreads = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+			Options.Gen5Settings.NumThreads = Options.Settings.NumThreads;
+		}
+		else if (strcmp(Value, "--current-frame-weight") == 0 && bHasNext)
+		{
+			Options.Settings.CurrentFrameWeight = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--filter-size") == 0 && bHasNext)
+		{
+			Options.Settings.FilterSize = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--kernel") == 0 && bHasNext)
+		{
+			if (!ParseCaptureFilterKernel(Argv[++Arg], Options.Settings.FilterKernel))
+			{
+				return false;
+			}
+		}
+		else if (strcmp(Value, "--catmull-rom") == 0)
+		{
+			Options.Settings.FilterKernel = ECaptureFilterKernel::CatmullRom;
+		}
+		else if (strcmp(Value, "--no-upsample-filter") == 0)
+		{
+			Options.Settings.bUpsampleFiltered = false;
+		}
+		else if (strcmp(Value, "--fast") == 0)
+		{
+			Options.Settings.bFast = true;
+		}
+		else if (strcmp(Value, "--r11g11b10") == 0)
+		{
+			Options.Settings.bR11G11B10History = true;
+			Options.Gen5Settings.bR11G11B10History = true;
+		}
+		else if (strcmp(Value, "--exposure") == 0 && bHasNext)
+		{
+			Options.Settings.ExposureScale = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--scalar") == 0)
+		{
+			Options.Settings.bScalar = true;
+		}
+		else if (strcmp(Value, "--gen5") == 0)
+		{
+			Options.bGen5 = true;
+		}
+		else if (strcmp(Value, "--history-screen-percentage") == 0 && bHasNext)
+		{
+			Options.Gen5Settings.HistoryScreenPercentage = float(atof(Argv[++Arg]));
+		}
+		else if (strcmp(Value, "--max-sample-count") == 0 && bHasNext)
+		{
+			Options.Gen5Settings.MaxSampleCount = float(atof(Argv[++Arg]));
+		}
+		else if (Value[0] != '-' && Options.InputPath.empty())
+		{
+			Options.InputPath = Value;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return !Options.InputPath.empty() && Options.Settings.FilterSize > 0.0f;
+}
+
+/** Mean absolute difference and PSNR of two RGB images after x / (1 + x), so HDR highlights do not dominate. */
+void CompareTonemapped(const FCaptureImage& A, const FCaptureImage& B, double& OutMeanError, double& OutPsnr)
+{
+	double SumAbs = 0.0;
+	double SumSquares = 0.0;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const float* PlaneA = A.GetPlane(Channel);
+		const float* PlaneB = B.GetPlane(std::min(Channel, B.NumChannels - 1));
+		for (size_t Pixel = 0; Pixel < A.GetPlaneSize(); Pixel++)
+		{
+			const double ValueA = std::max(PlaneA[Pixel], 0.0f);
+			const double ValueB = std::max(PlaneB[Pixel], 0.0f);
+			const double Difference = ValueA / (1.0 + ValueA) - ValueB / (1.0 + ValueB);
+			SumAbs += std::fabs(Difference);
+			SumSquares += Difference * Difference;
+		}
+	}
+	const double Count = double(A.GetPlaneSize() * 3);
+	OutMeanError = SumAbs / Count;
+	OutPsnr = SumSquares > 0.0 ? 10.0 * std::log10(Count / SumSquares) : INFINITY;
+}
+
+} //! namespace
+
+int main(int Argc, char** Argv)
+{
+	FReplayOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FCaptureReader Reader;
+	if (!Reader.Open(Options.InputPath))
+	{
+		fprintf(stderr, "cannot open %s\n", Options.InputPath.c_str());
+		return 1;
+	}
+
+	FCaptureContainerWriter Writer;
+	if (!Options.OutputPath.empty() && !Writer.Open(Options.OutputPath))
+	{
+		fprintf(stderr, "cannot create %s\n", Options.OutputPath.c_str());
+		return 1;
+	}
+
+	FCaptureTAAGen4 TAA(Options.Settings);
+	std::unique_ptr<FCaptureTAAGen5> Gen5(Options.bGen5 ? new FCaptureTAAGen5(Options.Gen5Settings) : nullptr);
+	FCaptureTAAGen4FrameImages Images;
+	FCaptureImage Captured, Output;
+	std::vector<uint8_t> DecodeBuffer;
+	std::vector<float> Interleaved;
+	std::vector<uint8_t> Packed;
+
+	const uint32_t NumFrames = std::min(Options.NumFrames, Reader.GetNumFrames());
+	uint32_t NumResolved = 0;
+	uint32_t NumCompared = 0;
+	double ResolveSeconds = 0.0;
+	double SumError = 0.0;
+	double SumPsnr = 0.0;
+	const auto Start = std::chrono::steady_clock::now();
+	for (uint32_t FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+	{
+		FCaptureTAAGen4Frame Frame;
+		if (!LoadCaptureTAAGen4Frame(Reader, FrameIndex, Images, Frame, DecodeBuffer))
+		{
+			continue;
+		}
+		const uint64_t FrameId = Reader.GetFrameId(FrameIndex);
+		const FCaptureFrameInfo* Info = Reader.GetContainer().FindFrame(FrameId);
+
+		const bool bHasCaptured = LoadCaptureImage(Reader, FrameIndex, "output", "rgb", Captured, DecodeBuffer);
+		const int32_t Width = Options.Width ? Options.Width : bHasCaptured ? Captured.Width : Images.Color.Width;
+		const int32_t Height = Options.Height ? Options.Height : bHasCaptured ? Captured.Height : Images.Color.Height;
+
+		const auto ResolveStart = std::chrono::steady_clock::now();
+		if (Gen5)
+		{
+			Gen5->Resolve(Frame, Width, Height, Output);
+		}
+		else
+		{
+			TAA.Resolve(Frame, Width, Height, Output);
+		}
+		ResolveSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - ResolveStart).count();
+		NumResolved++;
+
+		if (bHasCaptured && Captured.Width == Width && Captured.Height == Height)
+		{
+			double MeanError, Psnr;
+			CompareTonemapped(Output, Captured, MeanError, Psnr);
+			printf("frame %llu: mean error %.5f, psnr %.2f dB against the captured output\n", (unsigned long long)FrameId, MeanError, Psnr);
+			SumError += MeanError;
+			SumPsnr += std::min(Psnr, 100.0);
+			NumCompared++;
+		}
+
+		if (!Options.OutputPath.empty())
+		{
+			Interleaved.resize(Output.GetPlaneSize() * 3);
+			for (size_t Pixel = 0; Pixel < Output.GetPlaneSize(); Pixel++)
+			{
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Interleaved[Pixel * 3 + Channel] = Output.GetPlane(Channel)[Pixel];
+				}
+			}
+			Packed.resize(size_t(Width) * Height * 6);
+			ConvertCaptureFloatToHalf(Interleaved.data(), reinterpret_cast<uint16_t*>(Packed.data()), Interleaved.size());
+
+			FCaptureFrameInfo OutInfo = {};
+			if (Info)
+			{
+				OutInfo = *Info;
+			}
+			OutInfo.FrameId = FrameId;
+			FCaptureLayerPayload Payload;
+			Payload.Layer = "output";
+			Payload.Width = Width;
+			Payload.Height = Height;
+			Payload.PixelFormat = CapturePF_PackedFloat16RGB;
+			Payload.BytesPerPixel = 6;
+			Payload.Data = Packed.data();
+			Payload.Size = Packed.size();
+			Payload.RawSize = Packed.size();
+			if (!Writer.AppendFrame(OutInfo, &Payload, 1))
+			{
+				fprintf(stderr, "cannot write frame %llu to %s\n", (unsigned long long)FrameId, Options.OutputPath.c_str());
+				return 1;
+			}
+		}
+	}
+	const double TotalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+	if (!Options.OutputPath.empty() && !Writer.Close())
+	{
+		fprintf(stderr, "cannot finalize %s\n", Options.OutputPath.c_str());
+		return 1;
+	}
+
+	const uint32_t NumThreads = Options.Settings.NumThreads ? Options.Settings.NumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	printf("%u frames resolved on %u thread%s%s: %.1f ms per frame (%.1f fps), %.1f fps including loading\n", NumResolved, NumThreads, NumThreads > 1 ? "s" : "",
+		Gen5 ? ", gen5" : Options.Settings.bScalar ? ", scalar" : CAPTURE_SIMD_AVX2 ? ", avx2" : "",
+		NumResolved ? ResolveSeconds * 1e3 / NumResolved : 0.0, ResolveSeconds > 0.0 ? NumResolved / ResolveSeconds : 0.0,
+		TotalSeconds > 0.0 ? NumResolved / TotalSeconds : 0.0);
+	for (uint32_t Pass = 0; Gen5 && NumResolved && Pass < uint32_t(ECaptureTAAGen5Pass::Count); Pass++)
+	{
+		printf("  %-20s %7.2f ms per frame\n", GetCaptureTAAGen5PassName(ECaptureTAAGen5Pass(Pass)),
+			Gen5->GetPassSeconds(ECaptureTAAGen5Pass(Pass)) * 1e3 / NumResolved);
+	}
+	if (NumCompared)
+	{
+		printf("against the captured output: mean error %.5f, mean psnr %.2f dB over %u frames\n", SumError / NumCompared, SumPsnr / NumCompared, NumCompared);
+	}
+	return NumResolved ? 0 : 1;
+}
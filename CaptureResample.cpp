@@ -0,0 +1,152 @@
+#include "CaptureResample.h"
+
+#include "CaptureSimd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+/** Calls Function(Lanes, X) over [0, Width): eight texels at a time then one, Lanes being an FCaptureFloat8 or 1. */
+template <typename FFunction>
+void ForEachSpan(int32_t Width, bool bScalar, FFunction&& Function)
+{
+	int32_t X = 0;
+	if (!bScalar)
+	{
+		for (; X + FCaptureFloat8::Lanes <= Width; X += FCaptureFloat8::Lanes)
+		{
+			Function(FCaptureFloat8(), X);
+		}
+	}
+	for (; X < Width; X++)
+	{
+		Function(FCaptureFloat1(), X);
+	}
+}
+
+/** Resamples V::Lanes texels of a row from X. */
+template <typename V>
+void ResampleSpanHorizontal(const float* SourceRow, float* DestRow, const FCaptureResampleTaps& Taps, int32_t X)
+{
+	using I = typename V::FInt;
+	const I First = ToInt(V::Load(&Taps.First[X]));
+	const I Last = I::Splat(Taps.SourceSize - 1);
+	V Sum = V::Splat(0.0f);
+	for (int32_t Tap = 0; Tap < Taps.NumTaps; Tap++)
+	{
+		const I Index = Clamp(First + I::Splat(Tap), I::Splat(0), Last);
+		Sum = Sum + GatherNear(SourceRow, Index) * V::Load(&Taps.Weights[size_t(Tap) * Taps.DestSize + X]);
+	}
+	Sum.Store(DestRow + X);
+}
+
+/** Resamples V::Lanes texels of row Y from X, the columns of Source. */
+template <typename V>
+void ResampleSpanVertical(const float* Source, float* DestRow, int32_t Width, const FCaptureResampleTaps& Taps, int32_t Y, int32_t X)
+{
+	const int32_t First = int32_t(Taps.First[Y]);
+	V Sum = V::Splat(0.0f);
+	for (int32_t Tap = 0; Tap < Taps.NumTaps; Tap++)
+	{
+		const int32_t SourceY = std::min(std::max(First + Tap, 0), Taps.SourceSize - 1);
+		Sum = Sum + V::Load(Source + size_t(SourceY) * Width + X) * V::Splat(Taps.Weights[size_t(Tap) * Taps.DestSize + Y]);
+	}
+	Sum.Store(DestRow + X);
+}
+
+} //! namespace
+
+void ComputeCaptureResampleTaps(ECaptureFilterKernel Kernel, int32_t SourceSize, int32_t DestSize, FCaptureResampleTaps& OutTaps)
+{
+	const float Ratio = float(SourceSize) / float(DestSize);
+	const float Scale = std::max(Ratio, 1.0f);
+	const float Radius = GetCaptureFilterKernelRadius(Kernel);
+	const float Support = Radius * Scale;
+	OutTaps.SourceSize = SourceSize;
+	OutTaps.DestSize = DestSize;
+	OutTaps.NumTaps = int32_t(std::ceil(2.0f * Support)) + 1;
+	OutTaps.First.resize(DestSize);
+	OutTaps.Weights.assign(size_t(DestSize) * OutTaps.NumTaps, 0.0f);
+
+	std::vector<float> Weights(OutTaps.NumTaps);
+	for (int32_t Dest = 0; Dest < DestSize; Dest++)
+	{
+		const float Center = (float(Dest) + 0.5f) * Ratio - 0.5f;
+		const int32_t First = int32_t(std::ceil(Center - Support));
+		float TotalWeight = 0.0f;
+		for (int32_t Tap = 0; Tap < OutTaps.NumTaps; Tap++)
+		{
+			const float Offset = (float(First + Tap) - Center) / Scale;
+			Weights[Tap] = std::fabs(Offset) < Radius ? EvaluateCaptureFilterKernel(Kernel, Offset, 0.0f) : 0.0f;
+			TotalWeight += Weights[Tap];
+		}
+		if (TotalWeight > 0.0f)
+		{
+			for (int32_t Tap = 0; Tap < OutTaps.NumTaps; Tap++)
+			{
+				OutTaps.Weights[size_t(Tap) * DestSize + Dest] = Weights[Tap] / TotalWeight;
+			}
+		}
+		else
+		{
+			// Every tap on a zero of the kernel: take the closest.
+			const int32_t Closest = std::min(std::max(int32_t(std::floor(Center + 0.5f)) - First, 0), OutTaps.NumTaps - 1);
+			OutTaps.Weights[size_t(Closest) * DestSize + Dest] = 1.0f;
+		}
+		OutTaps.First[Dest] = float(First);
+	}
+}
+
+FCaptureResampler::FCaptureResampler(const FCaptureResampleSettings& InSettings, FCaptureParallelPool* SharedPool)
+	: Settings(InSettings)
+	, OwnedPool(SharedPool ? nullptr : new FCaptureParallelPool(InSettings.NumThreads))
+	, Pool(SharedPool ? SharedPool : OwnedPool.get())
+{
+}
+
+void FCaptureResampler::Resample(const FCaptureImage& Source, int32_t DestWidth, int32_t DestHeight, FCaptureImage& Dest)
+{
+	const int32_t SourceWidth = Source.Width;
+	const int32_t SourceHeight = Source.Height;
+	const int32_t NumChannels = Source.NumChannels;
+	Dest.Resize(DestWidth, DestHeight, NumChannels);
+	if (Source.IsEmpty() || DestWidth <= 0 || DestHeight <= 0)
+	{
+		return;
+	}
+	if (TapsX.SourceSize != SourceWidth || TapsX.DestSize != DestWidth)
+	{
+		ComputeCaptureResampleTaps(Settings.Kernel, SourceWidth, DestWidth, TapsX);
+	}
+	if (TapsY.SourceSize != SourceHeight || TapsY.DestSize != DestHeight)
+	{
+		ComputeCaptureResampleTaps(Settings.Kernel, SourceHeight, DestHeight, TapsY);
+	}
+
+	const bool bScalar = Settings.bScalar;
+	Horizontal.Resize(DestWidth, SourceHeight, NumChannels);
+	Pool->ParallelFor(uint32_t(NumChannels * SourceHeight), [&](uint32_t Item)
+	{
+		const int32_t Channel = int32_t(Item) / SourceHeight;
+		const int32_t Y = int32_t(Item) % SourceHeight;
+		const float* SourceRow = Source.GetPlane(Channel) + size_t(Y) * SourceWidth;
+		float* DestRow = Horizontal.GetPlane(Channel) + size_t(Y) * DestWidth;
+		ForEachSpan(DestWidth, bScalar, [&](auto Lanes, int32_t X)
+		{
+			ResampleSpanHorizontal<decltype(Lanes)>(SourceRow, DestRow, TapsX, X);
+		});
+	});
+	Pool->ParallelFor(uint32_t(NumChannels * DestHeight), [&](uint32_t Item)
+	{
+		const int32_t Channel = int32_t(Item) / DestHeight;
+		const int32_t Y = int32_t(Item) % DestHeight;
+		const float* Columns = Horizontal.GetPlane(Channel);
+		float* DestRow = Dest.GetPlane(Channel) + size_t(Y) * DestWidth;
+		ForEachSpan(DestWidth, bScalar, [&](auto Lanes, int32_t X)
+		{
+			ResampleSpanVertical<decltype(Lanes)>(Columns, DestRow, DestWidth, TapsY, Y, X);
+		});
+	});
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CaptureFilterKernels.h"
+#include "CaptureImage.h"
+#include "CaptureParallel.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Separable resampling of captured images to any size with the kernels of CaptureFilterKernels.h, for the history
+ * downsample of r.TemporalAA.HistoryScreenPercentage (ComputeMitchellNetravaliDownsample()) and for bringing a
+ * supersampled ground truth down to the size of the output it judges.
+ *
+ * Along each axis a destination texel centered at (D + 0.5) * Ratio - 0.5 in the source, Ratio = source / dest,
+ * weighs the source texels within the kernel radius stretched by the ratio when it is above 1 (a downsample
+ * filters, an upsample interpolates), normalized to sum to one; texels past the border clamp to it. Rows are
+ * filtered first into a dest width x source height image, then columns, every pass a row parallel kernel over an
+ * FCaptureParallelPool, eight lanes wide (CaptureSimd.h). Each texel sums its taps in order from 0, so the result has
+ * the same bits on any number of threads and with bScalar.
+ */
+
+struct FCaptureResampleSettings
+{
+	ECaptureFilterKernel Kernel = ECaptureFilterKernel::MitchellNetravali;
+
+	/** Worker threads including the caller, 0 for one per hardware thread. Unused on a shared pool. */
+	uint32_t NumThreads = 0;
+
+	/** One texel at a time instead of eight lanes, for checking the SIMD path. */
+	bool bScalar = false;
+};
+
+/** Source taps of a resample along one axis: for every destination texel, its first source texel and NumTaps weights. */
+struct FCaptureResampleTaps
+{
+	int32_t SourceSize = 0;
+	int32_t DestSize = 0;
+	int32_t NumTaps = 0;
+
+	/** First source texel of each destination texel, unclamped, as floats for the lanes to load. */
+	std::vector<float> First;
+
+	/** Tap major: the weights of tap T of every destination texel start at T * DestSize. */
+	std::vector<float> Weights;
+};
+
+/** Fills OutTaps for resampling SourceSize texels to DestSize with Kernel. */
+void ComputeCaptureResampleTaps(ECaptureFilterKernel Kernel, int32_t SourceSize, int32_t DestSize, FCaptureResampleTaps& OutTaps);
+
+class FCaptureResampler
+{
+public:
+	/** Runs on SharedPool when given, which must outlive the resampler, else on a pool of its own. */
+	explicit FCaptureResampler(const FCaptureResampleSettings& InSettings, FCaptureParallelPool* SharedPool = nullptr);
+
+	const FCaptureResampleSettings& GetSettings() const { return Settings; }
+
+	/** Resamples every channel of Source into Dest, DestWidth x DestHeight. Source and Dest must differ. */
+	void Resample(const FCaptureImage& Source, int32_t DestWidth, int32_t DestHeight, FCaptureImage& Dest);
+
+private:
+	FCaptureResampleSettings Settings;
+	std::unique_ptr<FCaptureParallelPool> OwnedPool;
+	FCaptureParallelPool* Pool;
+
+	/** Taps of the last sizes, recomputed when they change. */
+	FCaptureResampleTaps TapsX;
+	FCaptureResampleTaps TapsY;
+
+	/** Rows resampled, dest width x source height. */
+	FCaptureImage Horizontal;
+};
@@ -0,0 +1,462 @@
+#include "CaptureSession.h"
+
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "SceneRendering.h"
+
+#include "CaptureContainer.h"
+#include "CaptureReadbackRHI.h"
+#include "CaptureSubsystem.h"
+#include "CaptureTrace.h"
+
+namespace
+{
+
+TAutoConsoleVariable<int32> CVarCaptureAutoStart(
+	TEXT("r.Capture.AutoStart"),
+	1,
+	TEXT("Start a capture session with the first rendered frame, without waiting for r.Capture.Start."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<FString> CVarCaptureOutputRoot(
+	TEXT("r.Capture.OutputRoot"),
+	TEXT("E:/DLSS/data/TAA/raw/"),
+	TEXT("Folder under which every capture session creates its own time stamped folder. Read when a session starts."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureFirstFrame(
+	TEXT("r.Capture.FirstFrame"),
+	0,
+	TEXT("Number of frames to skip after a session starts before the first capture."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureFrameCount(
+	TEXT("r.Capture.FrameCount"),
+	0,
+	TEXT("Number of frames to capture before the session stops by itself, 0 for no limit."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureInterval(
+	TEXT("r.Capture.Interval"),
+	1,
+	TEXT("Capture every Nth frame of the session, counted from r.Capture.FirstFrame."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureViewIndex(
+	TEXT("r.Capture.ViewIndex"),
+	0,
+	TEXT("Index of the view to capture within its view family, -1 to capture every view. Scene captures are never captured.\n")
+	TEXT("With -1 and several views in the family, every layer name gets the index of its view, e.g. output_view1."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<FString> CVarCaptureWidths(
+	TEXT("r.Capture.Widths"),
+	TEXT(""),
+	TEXT("Comma separated view rect widths to capture, empty to accept any width."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<FString> CVarCaptureHeights(
+	TEXT("r.Capture.Heights"),
+	TEXT("360,720"),
+	TEXT("Comma separated view rect heights to capture, empty to accept any height."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureDepthLinear(
+	TEXT("r.Capture.Depth.Linear"),
+	0,
+	TEXT("Convert captured scene depth from device Z to linear view space depth (R32_FLOAT, world units) on the writer threads."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureTrace(
+	TEXT("r.Capture.Trace"),
+	0,
+	TEXT("Record a timeline of the capture pipeline while a session runs. When the session stops it is written next to the\n")
+	TEXT("container as capture_trace.json (chrome://tracing or ui.perfetto.dev) and summarized in the log. Read when a session starts."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureRateControl(
+	TEXT("r.Capture.RateControl"),
+	1,
+	TEXT("Adapt the capture to the writer queue, the write bandwidth and the free disk space instead of losing frames at random:\n")
+	TEXT("shed the r.Capture.RateControl.Shed layers first, then capture every 2nd, 4th, ... frame, and pause short of a full disk.\n")
+	TEXT("Every change and the skipped frames are logged to capture_rate.jsonl next to the container. Read when a session starts."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<FString> CVarCaptureRateControlShed(
+	TEXT("r.Capture.RateControl.Shed"),
+	TEXT("input_post"),
+	TEXT("Optional layers the rate controller sheds, most expendable first, one level per pattern. Same syntax as r.Capture.Taps."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureRateControlMaxInterval(
+	TEXT("r.Capture.RateControl.MaxInterval"),
+	8,
+	TEXT("Largest interval between captured frames the rate controller falls back to, rounded up to a power of two."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<float> CVarCaptureRateControlMinFreeGB(
+	TEXT("r.Capture.RateControl.MinFreeGB"),
+	2.0f,
+	TEXT("Free disk space, in GB, the rate controller pauses the capture at. It resumes once half as much again is free."),
+	ECVF_RenderThreadSafe);
+
+FAutoConsoleCommand CaptureStartCommand(
+	TEXT("r.Capture.Start"),
+	TEXT("Starts a new capture session in a new folder under r.Capture.OutputRoot, ending the active one first."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FCaptureSession::Get().RequestStart();
+	}));
+
+FAutoConsoleCommand CaptureStopCommand(
+	TEXT("r.Capture.Stop"),
+	TEXT("Stops the active capture session and finalizes its container."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FCaptureSession::Get().RequestStop();
+	}));
+
+void ParseExtentList(const FString& List, TArray<int32>& OutValues)
+{
+	OutValues.Reset();
+
+	TArray<FString> Tokens;
+	List.ParseIntoArray(Tokens, TEXT(","));
+	for (const FString& Token : Tokens)
+	{
+		const int32 Value = FCString::Atoi(*Token.TrimStartAndEnd());
+		if (Value > 0)
+		{
+			OutValues.Add(Value);
+		}
+	}
+}
+
+} //! namespace
+
+FCaptureSession& FCaptureSession::Get()
+{
+	static FCaptureSession Instance;
+	return Instance;
+}
+
+void FCaptureSession::RequestStart()
+{
+	bStartRequested = true;
+}
+
+void FCaptureSession::RequestStop()
+{
+	bStopRequested = true;
+}
+
+void FCaptureSession::BeginFrame()
+{
+	check(IsInRenderingThread());
+
+	if (LastFrameCounter == GFrameCounterRenderThread)
+	{
+		return;
+	}
+	LastFrameCounter = GFrameCounterRenderThread;
+
+	SealFrame();
+
+	const int32 FrameCount = CVarCaptureFrameCount.GetValueOnRenderThread();
+	const bool bQuotaReached = FrameCount > 0 && NumFramesCaptured >= uint64(FrameCount);
+	const bool bRestart = bStartRequested.exchange(false);
+	if (bActive && (bStopRequested.exchange(false) || bQuotaReached || bRestart))
+	{
+		StopSession();
+	}
+
+	// Auto start only fires once, so a session that ran out of frames is not restarted behind the user's back.
+	if (!bActive && (bRestart || (!bAutoStarted && CVarCaptureAutoStart.GetValueOnRenderThread() != 0)))
+	{
+		bAutoStarted = true;
+		StartSession();
+	}
+
+	bFrameSampled = false;
+	bFrameCounted = false;
+	if (!bActive)
+	{
+		return;
+	}
+
+	const uint64 SessionFrame = NumFramesSeen++;
+	const uint64 FirstFrame = uint64(FMath::Max(CVarCaptureFirstFrame.GetValueOnRenderThread(), 0));
+	const uint64 Interval = uint64(FMath::Max(CVarCaptureInterval.GetValueOnRenderThread(), 1));
+
+	FrameId = SessionFrame;
+	bFrameSampled = SessionFrame >= FirstFrame && (SessionFrame - FirstFrame) % Interval == 0;
+	if (RateController)
+	{
+		UpdateRateControl();
+		bFrameSampled = bFrameSampled && RateController->AdmitFrame(FrameId);
+	}
+	if (bFrameSampled)
+	{
+		ParseExtentList(CVarCaptureWidths.GetValueOnRenderThread(), AllowedWidths);
+		ParseExtentList(CVarCaptureHeights.GetValueOnRenderThread(), AllowedHeights);
+	}
+}
+
+void FCaptureSession::StartSession()
+{
+	FString Folder = CVarCaptureOutputRoot.GetValueOnRenderThread();
+	if (!Folder.IsEmpty() && !Folder.EndsWith(TEXT("/")) && !Folder.EndsWith(TEXT("\\")))
+	{
+		Folder += TEXT("/");
+	}
+	Folder += UTF8_TO_TCHAR(MakeCaptureSessionName().c_str());
+
+	if (IFileManager::Get().DirectoryExists(*Folder))
+	{
+		UE_LOG(LogCapture, Error, TEXT("Capture folder %s already exists, capture session not started"), *Folder);
+		return;
+	}
+	if (!IFileManager::Get().MakeDirectory(*Folder, true))
+	{
+		UE_LOG(LogCapture, Error, TEXT("Failed to create capture folder %s, capture session not started"), *Folder);
+		return;
+	}
+
+	ContainerPath = TCHAR_TO_UTF8(*(Folder / TEXT("capture.ucap")));
+	NumFramesSeen = 0;
+	NumFramesCaptured = 0;
+	bActive = true;
+
+	if (CVarCaptureTrace.GetValueOnRenderThread() != 0)
+	{
+		ResetCaptureTrace();
+		SetCaptureTraceEnabled(true);
+	}
+
+	RateController.reset();
+	if (CVarCaptureRateControl.GetValueOnRenderThread() != 0)
+	{
+		FCaptureRateConfig Config;
+		Config.ShedLayers = TCHAR_TO_UTF8(*CVarCaptureRateControlShed.GetValueOnRenderThread());
+		Config.MaxInterval = FMath::RoundUpToPowerOfTwo(uint32(FMath::Max(CVarCaptureRateControlMaxInterval.GetValueOnRenderThread(), 1)));
+		Config.MinFreeDiskBytes = uint64(FMath::Max(CVarCaptureRateControlMinFreeGB.GetValueOnRenderThread(), 0.0f) * double(1ull << 30));
+		RateController = std::make_unique<FCaptureRateController>(Config);
+		RateLogPath = Folder / TEXT("capture_rate.jsonl");
+		NextDiskQueryTime = 0.0;
+		FreeDiskBytes = ~0ull;
+	}
+
+	UE_LOG(LogCapture, Display, TEXT("Capture session started in %s"), *Folder);
+}
+
+void FCaptureSession::StopSession()
+{
+	SealFrame();
+
+	// StopSession() runs from a hook while the frame's graph is being set up, where neither waiting for the GPU nor
+	// for the writers is allowed; the container is finalized once the frame has been rendered.
+	PendingClosePaths.Add(ContainerPath);
+	if (!EndFrameHandle.IsValid())
+	{
+		EndFrameHandle = FCoreDelegates::OnEndFrameRT.AddRaw(this, &FCaptureSession::EndFrame);
+	}
+
+	bActive = false;
+	bFrameSampled = false;
+
+	if (IsCaptureTraceEnabled())
+	{
+		SetCaptureTraceEnabled(false);
+		WriteTrace();
+	}
+
+	if (RateController)
+	{
+		AppendRateLog(FormatCaptureRateSummary(*RateController));
+		if (RateController->GetNumSkipped())
+		{
+			UE_LOG(LogCapture, Display, TEXT("Capture rate control skipped %llu frames in %d ranges, %d decisions logged to %s"),
+				RateController->GetNumSkipped(), int32(RateController->GetSkippedRanges().size()), int32(RateController->GetDecisions().size()), *RateLogPath);
+		}
+		RateController.reset();
+	}
+
+	UE_LOG(LogCapture, Display, TEXT("Capture session stopped after %llu frames, %llu captured, in %s"),
+		NumFramesSeen, NumFramesCaptured, UTF8_TO_TCHAR(ContainerPath.c_str()));
+}
+
+void FCaptureSession::EndFrame()
+{
+	check(IsInRenderingThread());
+	if (PendingClosePaths.Num() == 0)
+	{
+		return;
+	}
+
+	// Every readback of a stopped session has to reach the writers before its container index is written. The
+	// flush may deliver readbacks of a session that started this frame too; their container stays open.
+	FCaptureReadbackRHI::Get().Flush();
+	for (const std::string& Path : PendingClosePaths)
+	{
+		CloseCaptureContainer(Path);
+	}
+	PendingClosePaths.Reset();
+}
+
+void FCaptureSession::WriteTrace() const
+{
+	const FString TracePath = FPaths::GetPath(UTF8_TO_TCHAR(ContainerPath.c_str())) / TEXT("capture_trace.json");
+	if (!WriteCaptureTrace(TCHAR_TO_UTF8(*TracePath)))
+	{
+		UE_LOG(LogCapture, Error, TEXT("Failed to write the capture trace %s"), *TracePath);
+		return;
+	}
+
+	TArray<FString> Lines;
+	FString(UTF8_TO_TCHAR(FormatCaptureTraceSummary(SummarizeCaptureTrace()).c_str())).ParseIntoArrayLines(Lines);
+	UE_LOG(LogCapture, Display, TEXT("Capture trace written to %s"), *TracePath);
+	for (const FString& Line : Lines)
+	{
+		UE_LOG(LogCapture, Display, TEXT("  %s"), *Line);
+	}
+}
+
+void FCaptureSession::UpdateRateControl()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now >= NextDiskQueryTime)
+	{
+		// A file system call, a couple of times a second is plenty to see the disk fill up.
+		NextDiskQueryTime = Now + 0.5;
+		uint64 TotalBytes = 0;
+		uint64 FreeBytes = 0;
+		FreeDiskBytes = FPlatformMisc::GetDiskTotalAndFreeSpace(FPaths::GetPath(RateLogPath), TotalBytes, FreeBytes) ? FreeBytes : ~0ull;
+	}
+
+	const FCaptureSinkStats SinkStats = GetCaptureSink().GetStats();
+	const FCaptureReadbackStats ReadbackStats = FCaptureReadbackRHI::Get().GetStats();
+
+	FCaptureRateSample Sample;
+	Sample.Time = Now;
+	Sample.FrameId = FrameId;
+	Sample.QueueDepth = SinkStats.QueueDepth;
+	Sample.QueueCapacity = GetCaptureSink().GetConfig().QueueCapacity;
+	Sample.BytesWritten = SinkStats.BytesWritten;
+	Sample.Overflows = SinkStats.Dropped + SinkStats.Coalesced + SinkStats.Blocked + ReadbackStats.Dropped + ReadbackStats.Stalls;
+	Sample.FreeDiskBytes = FreeDiskBytes;
+	if (!RateController->Update(Sample))
+	{
+		return;
+	}
+
+	const FCaptureRateDecision& Decision = RateController->GetDecisions().back();
+	UE_LOG(LogCapture, Display, TEXT("Capture rate level %u -> %u at frame %llu (%s): every %u frame(s), %u layer pattern(s) shed%s"),
+		Decision.FromLevel, Decision.Level, Decision.FrameId, UTF8_TO_TCHAR(Decision.Reason), Decision.Interval, Decision.NumShedPatterns,
+		Decision.bPaused ? TEXT(", paused") : TEXT(""));
+	AppendRateLog(FormatCaptureRateDecision(Decision, *RateController));
+}
+
+void FCaptureSession::AppendRateLog(const std::string& Line) const
+{
+	const FString Text = FString(UTF8_TO_TCHAR(Line.c_str())) + TEXT("\n");
+	if (!FFileHelper::SaveStringToFile(Text, *RateLogPath, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append))
+	{
+		UE_LOG(LogCapture, Warning, TEXT("Failed to append to %s"), *RateLogPath);
+	}
+}
+
+void FCaptureSession::SealFrame()
+{
+	if (Frame)
+	{
+		Frame->Seal();
+		Frame.reset();
+	}
+}
+
+bool FCaptureSession::ShouldCapture(const FViewInfo& View, const FIntRect& ViewRect)
+{
+	BeginFrame();
+
+	if (!bFrameSampled || View.bIsSceneCapture || View.bIsReflectionCapture || View.bIsPlanarReflection)
+	{
+		return false;
+	}
+
+	const int32 ViewIndex = CVarCaptureViewIndex.GetValueOnRenderThread();
+	if (ViewIndex >= 0 && (!View.Family || View.Family->Views.IndexOfByKey(&View) != ViewIndex))
+	{
+		return false;
+	}
+
+	if ((AllowedWidths.Num() && !AllowedWidths.Contains(ViewRect.Width()))
+		|| (AllowedHeights.Num() && !AllowedHeights.Contains(ViewRect.Height())))
+	{
+		return false;
+	}
+
+	ViewSuffix.clear();
+	if (ViewIndex < 0 && View.Family && View.Family->Views.Num() > 1)
+	{
+		ViewSuffix = "_view" + std::to_string(View.Family->Views.IndexOfByKey(&View));
+	}
+
+	if (!bFrameCounted)
+	{
+		bFrameCounted = true;
+		NumFramesCaptured++;
+
+		// The first view that passes describes the frame.
+		Frame = CreateCaptureFrame(FrameId, ContainerPath);
+		FCaptureFrameInfo& Info = Frame->GetInfo();
+		Info.JitterX = View.TemporalJitterPixels.X;
+		Info.JitterY = View.TemporalJitterPixels.Y;
+		Info.PreExposure = View.PreExposure;
+		Info.Flags = View.bCameraCut ? CaptureFrame_CameraCut : 0;
+		if (RateController)
+		{
+			Info.RateLevel = RateController->GetLevel();
+			Info.Flags |= RateController->GetNumShedPatterns() ? CaptureFrame_LayersShed : 0;
+		}
+	}
+	return true;
+}
+
+bool FCaptureSession::ShouldCaptureLayer(const char* Layer) const
+{
+	return !RateController || !RateController->IsLayerShed(Layer);
+}
+
+FCaptureReadbackRequest FCaptureSession::MakeRequest(const char* Layer)
+{
+	FCaptureReadbackRequest Request;
+	Request.FrameId = FrameId;
+	Request.Layer = Layer;
+	Request.Layer += ViewSuffix;
+	Request.ContainerPath = ContainerPath;
+	if (Frame)
+	{
+		Request.FrameLayer = Frame->AddLayer(Request.Layer);
+	}
+	return Request;
+}
+
+FCaptureReadbackRequest FCaptureSession::MakeDepthRequest(const FViewInfo& View, const char* Layer)
+{
+	FCaptureReadbackRequest Request = MakeRequest(Layer);
+	if (CVarCaptureDepthLinear.GetValueOnRenderThread() != 0)
+	{
+		Request.DepthLinearization.bEnabled = true;
+		for (int32 Index = 0; Index < 4; Index++)
+		{
+			Request.DepthLinearization.DeviceZToWorldZ[Index] = View.InvDeviceZToWorldZTransform[Index];
+		}
+	}
+	return Request;
+}
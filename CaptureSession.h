@@ -0,0 +1,116 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "CaptureFrame.h"
+#include "CaptureRateControl.h"
+#include "CaptureReadback.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+class FViewInfo;
+
+/**
+ * Decides which frames and views the capture hooks read back, and where they go.
+ *
+ * A session owns one output folder under r.Capture.OutputRoot and one container in it that every hook
+ * appends to. Frames are numbered from the start of the session and every layer the hooks read back for a frame
+ * joins that frame's FCaptureFrame, which is committed as one bundle along with the view's jitter, pre-exposure
+ * and camera cut. A frame is sealed when the next one begins or the session stops. Sampling is driven by the r.Capture.* console variables and the
+ * r.Capture.Start / r.Capture.Stop commands; everything else runs on the render thread.
+ *
+ * With r.Capture.RateControl the sampled frames and layers are thinned out further whenever the writers or the disk
+ * fall behind (see CaptureRateControl.h); every change is logged to capture_rate.jsonl next to the container.
+ */
+class FCaptureSession
+{
+public:
+	static FCaptureSession& Get();
+
+	/** Asks for a new session, it begins on the next rendered frame. Any thread. */
+	void RequestStart();
+
+	/** Asks the active session to end with the next rendered frame, at the end of which its readbacks are flushed and its container finalized. Any thread. */
+	void RequestStop();
+
+	/**
+	 * True when the current frame is sampled and View with ViewRect passes the view and extent filters.
+	 * Hooks call it before queuing any readback so filtered frames cost nothing.
+	 */
+	bool ShouldCapture(const FViewInfo& View, const FIntRect& ViewRect);
+
+	/**
+	 * False while the rate controller sheds Layer. Hooks ask before reading back an optional layer such as input_post;
+	 * the layers every dataset needs skip the question.
+	 */
+	bool ShouldCaptureLayer(const char* Layer) const;
+
+	/**
+	 * Readback request for Layer of the current frame, holding a slot of its bundle. Call after ShouldCapture(), for
+	 * the view it passed: when r.Capture.ViewIndex is -1 and the family has several views, the layer is named after
+	 * that view, e.g. output_view1, so the views do not overwrite each other in the bundle.
+	 */
+	FCaptureReadbackRequest MakeRequest(const char* Layer);
+
+	/** Same for a scene depth layer, linearized with View's projection on the writers when r.Capture.Depth.Linear is set. */
+	FCaptureReadbackRequest MakeDepthRequest(const FViewInfo& View, const char* Layer);
+
+	bool IsActive() const { return bActive; }
+	uint64 GetFrameId() const { return FrameId; }
+	const std::string& GetContainerPath() const { return ContainerPath; }
+
+private:
+	FCaptureSession() = default;
+
+	void BeginFrame();
+	void StartSession();
+	void StopSession();
+	void SealFrame();
+
+	/** End of frame on the render thread: flushes the readbacks and finalizes the containers of sessions stopped during the frame. */
+	void EndFrame();
+
+	/** Feeds the rate controller the writer and disk state of this frame and logs what it decides. */
+	void UpdateRateControl();
+
+	/** Appends a line to the capture_rate.jsonl of the session. */
+	void AppendRateLog(const std::string& Line) const;
+
+	/** Writes the r.Capture.Trace timeline of the session next to its container and logs its summary. */
+	void WriteTrace() const;
+
+	std::atomic<bool> bStartRequested{ false };
+	std::atomic<bool> bStopRequested{ false };
+
+	bool bActive = false;
+	bool bAutoStarted = false;
+	std::string ContainerPath;
+
+	/** Containers of sessions stopped this frame, finalized by EndFrame(). */
+	TArray<std::string> PendingClosePaths;
+	FDelegateHandle EndFrameHandle;
+
+	uint64 LastFrameCounter = ~0ull;
+	uint64 FrameId = 0;
+	uint64 NumFramesSeen = 0;
+	uint64 NumFramesCaptured = 0;
+
+	/** Whether the current frame is sampled, and whether a hook already counted it as captured. */
+	bool bFrameSampled = false;
+	bool bFrameCounted = false;
+	std::shared_ptr<FCaptureFrame> Frame;
+
+	/** Appended to every layer name of the view that last passed ShouldCapture(), empty unless several views are captured. */
+	std::string ViewSuffix;
+
+	TArray<int32> AllowedWidths;
+	TArray<int32> AllowedHeights;
+
+	/** Null unless r.Capture.RateControl was set when the session started. */
+	std::unique_ptr<FCaptureRateController> RateController;
+	FString RateLogPath;
+	double NextDiskQueryTime = 0.0;
+	uint64 FreeDiskBytes = ~0ull;
+};
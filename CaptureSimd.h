@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Lanes for the offline CPU kernels (TAA reference, metrics, resampling). A kernel is a template written once
+ * against FCaptureFloat1, one float, and FCaptureFloat8, eight of them: AVX2 registers when the file is built with
+ * AVX2 (-mavx2, /arch:AVX2), a plain array otherwise.
+ *
+ * Every operation is the plain IEEE one in both widths: no FMA, no approximate reciprocal, Min and Max pick their
+ * second operand when the first is NaN like minps/maxps. Built without FMA contraction (-ffp-contract=off), both
+ * widths give the same bits, so the one lane instantiation doubles as the reference of the eight lane one.
+ */
+
+#if defined(__AVX2__)
+	#define CAPTURE_SIMD_AVX2 1
+	#include <immintrin.h>
+#else
+	#define CAPTURE_SIMD_AVX2 0
+#endif
+
+/*
+ * Gather() reads any lanes. GatherNear() is for lanes that usually sit close together, like the neighbors of eight
+ * adjacent pixels: when all of them fall within eight elements of the first lane it does one load and a permute
+ * instead, so Base must stay readable for eight elements past every index (FCaptureImage pads its planes for it).
+ */
+
+struct FCaptureInt1
+{
+	int32_t V;
+
+	static FCaptureInt1 Splat(int32_t Value) { return { Value }; }
+	static FCaptureInt1 Ramp() { return { 0 }; }
+};
+
+struct FCaptureFloat1
+{
+	using FInt = FCaptureInt1;
+	using FMask = bool;
+	static constexpr int32_t Lanes = 1;
+
+	float V;
+
+	static FCaptureFloat1 Splat(float Value) { return { Value }; }
+	static FCaptureFloat1 Load(const float* Source) { return { *Source }; }
+	void Store(float* Dest) const { *Dest = V; }
+	void StorePartial(float* Dest, int32_t Count) const { if (Count > 0) { *Dest = V; } }
+};
+
+inline FCaptureFloat1 operator+(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V + B.V }; }
+inline FCaptureFloat1 operator-(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V - B.V }; }
+inline FCaptureFloat1 operator*(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V * B.V }; }
+inline FCaptureFloat1 operator/(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V / B.V }; }
+inline bool operator<(FCaptureFloat1 A, FCaptureFloat1 B) { return A.V < B.V; }
+inline bool operator>(FCaptureFloat1 A, FCaptureFloat1 B) { return A.V > B.V; }
+inline bool operator>=(FCaptureFloat1 A, FCaptureFloat1 B) { return A.V >= B.V; }
+inline FCaptureFloat1 Min(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V < B.V ? A.V : B.V }; }
+inline FCaptureFloat1 Max(FCaptureFloat1 A, FCaptureFloat1 B) { return { A.V > B.V ? A.V : B.V }; }
+inline FCaptureFloat1 Abs(FCaptureFloat1 A) { return { std::fabs(A.V) }; }
+inline FCaptureFloat1 Floor(FCaptureFloat1 A) { return { std::floor(A.V) }; }
+inline FCaptureFloat1 Sqrt(FCaptureFloat1 A) { return { std::sqrt(A.V) }; }
+inline FCaptureFloat1 Select(bool Mask, FCaptureFloat1 A, FCaptureFloat1 B) { return Mask ? A : B; }
+inline FCaptureInt1 Select(bool Mask, FCaptureInt1 A, FCaptureInt1 B) { return Mask ? A : B; }
+inline bool AnyOf(bool Mask) { return Mask; }
+inline bool AllOf(bool Mask) { return Mask; }
+
+inline FCaptureInt1 operator+(FCaptureInt1 A, FCaptureInt1 B) { return { int32_t(uint32_t(A.V) + uint32_t(B.V)) }; }
+inline FCaptureInt1 operator-(FCaptureInt1 A, FCaptureInt1 B) { return { int32_t(uint32_t(A.V) - uint32_t(B.V)) }; }
+inline FCaptureInt1 operator*(FCaptureInt1 A, FCaptureInt1 B) { return { int32_t(uint32_t(A.V) * uint32_t(B.V)) }; }
+inline FCaptureInt1 operator&(FCaptureInt1 A, FCaptureInt1 B) { return { A.V & B.V }; }
+inline FCaptureInt1 operator|(FCaptureInt1 A, FCaptureInt1 B) { return { A.V | B.V }; }
+inline FCaptureInt1 ShiftRight(FCaptureInt1 A, int32_t Bits) { return { int32_t(uint32_t(A.V) >> Bits) }; }
+inline FCaptureInt1 Min(FCaptureInt1 A, FCaptureInt1 B) { return { A.V < B.V ? A.V : B.V }; }
+inline FCaptureInt1 Max(FCaptureInt1 A, FCaptureInt1 B) { return { A.V > B.V ? A.V : B.V }; }
+
+/** Truncates towards zero. */
+inline FCaptureInt1 ToInt(FCaptureFloat1 A) { return { int32_t(A.V) }; }
+inline FCaptureFloat1 ToFloat(FCaptureInt1 A) { return { float(A.V) }; }
+inline FCaptureInt1 AsInt(FCaptureFloat1 A) { int32_t Bits; memcpy(&Bits, &A.V, sizeof(Bits)); return { Bits }; }
+inline FCaptureFloat1 AsFloat(FCaptureInt1 A) { float Value; memcpy(&Value, &A.V, sizeof(Value)); return { Value }; }
+inline FCaptureFloat1 Gather(const float* Base, FCaptureInt1 Index) { return { Base[Index.V] }; }
+inline FCaptureFloat1 GatherNear(const float* Base, FCaptureInt1 Index) { return { Base[Index.V] }; }
+
+#if CAPTURE_SIMD_AVX2
+
+struct FCaptureMask8
+{
+	__m256 V;
+};
+
+struct FCaptureInt8
+{
+	__m256i V;
+
+	static FCaptureInt8 Splat(int32_t Value) { return { _mm256_set1_epi32(Value) }; }
+	static FCaptureInt8 Ramp() { return { _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7) }; }
+};
+
+struct FCaptureFloat8
+{
+	using FInt = FCaptureInt8;
+	using FMask = FCaptureMask8;
+	static constexpr int32_t Lanes = 8;
+
+	__m256 V;
+
+	static FCaptureFloat8 Splat(float Value) { return { _mm256_set1_ps(Value) }; }
+	static FCaptureFloat8 Load(const float* Source) { return { _mm256_loadu_ps(Source) }; }
+	void Store(float* Dest) const { _mm256_storeu_ps(Dest, V); }
+
+	void StorePartial(float* Dest, int32_t Count) const
+	{
+		alignas(32) float Values[8];
+		_mm256_store_ps(Values, V);
+		for (int32_t Lane = 0; Lane < Count && Lane < 8; Lane++)
+		{
+			Dest[Lane] = Values[Lane];
+		}
+	}
+};
+
+inline FCaptureFloat8 operator+(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_add_ps(A.V, B.V) }; }
+inline FCaptureFloat8 operator-(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_sub_ps(A.V, B.V) }; }
+inline FCaptureFloat8 operator*(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_mul_ps(A.V, B.V) }; }
+inline FCaptureFloat8 operator/(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_div_ps(A.V, B.V) }; }
+inline FCaptureMask8 operator<(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_LT_OQ) }; }
+inline FCaptureMask8 operator>(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_GT_OQ) }; }
+inline FCaptureMask8 operator>=(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_cmp_ps(A.V, B.V, _CMP_GE_OQ) }; }
+inline FCaptureMask8 operator&&(FCaptureMask8 A, FCaptureMask8 B) { return { _mm256_and_ps(A.V, B.V) }; }
+inline FCaptureMask8 operator||(FCaptureMask8 A, FCaptureMask8 B) { return { _mm256_or_ps(A.V, B.V) }; }
+inline FCaptureMask8 operator!(FCaptureMask8 A) { return { _mm256_xor_ps(A.V, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) }; }
+inline FCaptureFloat8 Min(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_min_ps(A.V, B.V) }; }
+inline FCaptureFloat8 Max(FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_max_ps(A.V, B.V) }; }
+inline FCaptureFloat8 Abs(FCaptureFloat8 A) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), A.V) }; }
+inline FCaptureFloat8 Floor(FCaptureFloat8 A) { return { _mm256_floor_ps(A.V) }; }
+inline FCaptureFloat8 Sqrt(FCaptureFloat8 A) { return { _mm256_sqrt_ps(A.V) }; }
+inline FCaptureFloat8 Select(FCaptureMask8 Mask, FCaptureFloat8 A, FCaptureFloat8 B) { return { _mm256_blendv_ps(B.V, A.V, Mask.V) }; }
+inline FCaptureInt8 Select(FCaptureMask8 Mask, FCaptureInt8 A, FCaptureInt8 B)
+{
+	return { _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(B.V), _mm256_castsi256_ps(A.V), Mask.V)) };
+}
+inline bool AnyOf(FCaptureMask8 Mask) { return _mm256_movemask_ps(Mask.V) != 0; }
+inline bool AllOf(FCaptureMask8 Mask) { return _mm256_movemask_ps(Mask.V) == 0xff; }
+
+inline FCaptureInt8 operator+(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_add_epi32(A.V, B.V) }; }
+inline FCaptureInt8 operator-(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_sub_epi32(A.V, B.V) }; }
+inline FCaptureInt8 operator*(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_mullo_epi32(A.V, B.V) }; }
+inline FCaptureInt8 operator&(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_and_si256(A.V, B.V) }; }
+inline FCaptureInt8 operator|(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_or_si256(A.V, B.V) }; }
+inline FCaptureInt8 ShiftRight(FCaptureInt8 A, int32_t Bits) { return { _mm256_srli_epi32(A.V, Bits) }; }
+inline FCaptureInt8 Min(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_min_epi32(A.V, B.V) }; }
+inline FCaptureInt8 Max(FCaptureInt8 A, FCaptureInt8 B) { return { _mm256_max_epi32(A.V, B.V) }; }
+
+inline FCaptureInt8 ToInt(FCaptureFloat8 A) { return { _mm256_cvttps_epi32(A.V) }; }
+inline FCaptureFloat8 ToFloat(FCaptureInt8 A) { return { _mm256_cvtepi32_ps(A.V) }; }
+inline FCaptureInt8 AsInt(FCaptureFloat8 A) { return { _mm256_castps_si256(A.V) }; }
+inline FCaptureFloat8 AsFloat(FCaptureInt8 A) { return { _mm256_castsi256_ps(A.V) }; }
+inline FCaptureFloat8 Gather(const float* Base, FCaptureInt8 Index) { return { _mm256_i32gather_ps(Base, Index.V, 4) }; }
+
+inline FCaptureFloat8 GatherNear(const float* Base, FCaptureInt8 Index)
+{
+	const int32_t First = _mm256_cvtsi256_si32(Index.V);
+	const __m256i Offset = _mm256_sub_epi32(Index.V, _mm256_set1_epi32(First));
+	if (_mm256_testz_si256(Offset, _mm256_set1_epi32(~7)))
+	{
+		return { _mm256_permutevar8x32_ps(_mm256_loadu_ps(Base + First), Offset) };
+	}
+	return { _mm256_i32gather_ps(Base, Index.V, 4) };
+}
+
+#else
+
+struct FCaptureMask8
+{
+	bool V[8];
+};
+
+struct FCaptureInt8
+{
+	int32_t V[8];
+
+	static FCaptureInt8 Splat(int32_t Value) { FCaptureInt8 R; for (int32_t& Lane : R.V) { Lane = Value; } return R; }
+	static FCaptureInt8 Ramp() { return { { 0, 1, 2, 3, 4, 5, 6, 7 } }; }
+};
+
+struct FCaptureFloat8
+{
+	using FInt = FCaptureInt8;
+	using FMask = FCaptureMask8;
+	static constexpr int32_t Lanes = 8;
+
+	float V[8];
+
+	static FCaptureFloat8 Splat(float Value) { FCaptureFloat8 R; for (float& Lane : R.V) { Lane = Value; } return R; }
+	static FCaptureFloat8 Load(const float* Source) { FCaptureFloat8 R; memcpy(R.V, Source, sizeof(R.V)); return R; }
+	void Store(float* Dest) const { memcpy(Dest, V, sizeof(V)); }
+	void StorePartial(float* Dest, int32_t Count) const { for (int32_t Lane = 0; Lane < Count && Lane < 8; Lane++) { Dest[Lane] = V[Lane]; } }
+};
+
+#define CAPTURE_SIMD_LANES(Type, Expression) Type R; for (int32_t Lane = 0; Lane < 8; Lane++) { R.V[Lane] = Expression; } return R
+
+inline FCaptureFloat8 operator+(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] + B.V[Lane]); }
+inline FCaptureFloat8 operator-(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] - B.V[Lane]); }
+inline FCaptureFloat8 operator*(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] * B.V[Lane]); }
+inline FCaptureFloat8 operator/(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] / B.V[Lane]); }
+inline FCaptureMask8 operator<(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureMask8, A.V[Lane] < B.V[Lane]); }
+inline FCaptureMask8 operator>(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureMask8, A.V[Lane] > B.V[Lane]); }
+inline FCaptureMask8 operator>=(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureMask8, A.V[Lane] >= B.V[Lane]); }
+inline FCaptureMask8 operator&&(FCaptureMask8 A, FCaptureMask8 B) { CAPTURE_SIMD_LANES(FCaptureMask8, A.V[Lane] && B.V[Lane]); }
+inline FCaptureMask8 operator||(FCaptureMask8 A, FCaptureMask8 B) { CAPTURE_SIMD_LANES(FCaptureMask8, A.V[Lane] || B.V[Lane]); }
+inline FCaptureMask8 operator!(FCaptureMask8 A) { CAPTURE_SIMD_LANES(FCaptureMask8, !A.V[Lane]); }
+inline FCaptureFloat8 Min(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] < B.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+inline FCaptureFloat8 Max(FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, A.V[Lane] > B.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+inline FCaptureFloat8 Abs(FCaptureFloat8 A) { CAPTURE_SIMD_LANES(FCaptureFloat8, std::fabs(A.V[Lane])); }
+inline FCaptureFloat8 Floor(FCaptureFloat8 A) { CAPTURE_SIMD_LANES(FCaptureFloat8, std::floor(A.V[Lane])); }
+inline FCaptureFloat8 Sqrt(FCaptureFloat8 A) { CAPTURE_SIMD_LANES(FCaptureFloat8, std::sqrt(A.V[Lane])); }
+inline FCaptureFloat8 Select(FCaptureMask8 Mask, FCaptureFloat8 A, FCaptureFloat8 B) { CAPTURE_SIMD_LANES(FCaptureFloat8, Mask.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+inline FCaptureInt8 Select(FCaptureMask8 Mask, FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, Mask.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+inline bool AnyOf(FCaptureMask8 Mask) { for (bool Lane : Mask.V) { if (Lane) { return true; } } return false; }
+inline bool AllOf(FCaptureMask8 Mask) { for (bool Lane : Mask.V) { if (!Lane) { return false; } } return true; }
+
+inline FCaptureInt8 operator+(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, int32_t(uint32_t(A.V[Lane]) + uint32_t(B.V[Lane]))); }
+inline FCaptureInt8 operator-(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, int32_t(uint32_t(A.V[Lane]) - uint32_t(B.V[Lane]))); }
+inline FCaptureInt8 operator*(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, int32_t(uint32_t(A.V[Lane]) * uint32_t(B.V[Lane]))); }
+inline FCaptureInt8 operator&(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, A.V[Lane] & B.V[Lane]); }
+inline FCaptureInt8 operator|(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, A.V[Lane] | B.V[Lane]); }
+inline FCaptureInt8 ShiftRight(FCaptureInt8 A, int32_t Bits) { CAPTURE_SIMD_LANES(FCaptureInt8, int32_t(uint32_t(A.V[Lane]) >> Bits)); }
+inline FCaptureInt8 Min(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, A.V[Lane] < B.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+inline FCaptureInt8 Max(FCaptureInt8 A, FCaptureInt8 B) { CAPTURE_SIMD_LANES(FCaptureInt8, A.V[Lane] > B.V[Lane] ? A.V[Lane] : B.V[Lane]); }
+
+inline FCaptureInt8 ToInt(FCaptureFloat8 A) { CAPTURE_SIMD_LANES(FCaptureInt8, int32_t(A.V[Lane])); }
+inline FCaptureFloat8 ToFloat(FCaptureInt8 A) { CAPTURE_SIMD_LANES(FCaptureFloat8, float(A.V[Lane])); }
+inline FCaptureInt8 AsInt(FCaptureFloat8 A) { FCaptureInt8 R; memcpy(R.V, A.V, sizeof(R.V)); return R; }
+inline FCaptureFloat8 AsFloat(FCaptureInt8 A) { FCaptureFloat8 R; memcpy(R.V, A.V, sizeof(R.V)); return R; }
+inline FCaptureFloat8 Gather(const float* Base, FCaptureInt8 Index) { CAPTURE_SIMD_LANES(FCaptureFloat8, Base[Index.V[Lane]]); }
+inline FCaptureFloat8 GatherNear(const float* Base, FCaptureInt8 Index) { return Gather(Base, Index); }
+
+#undef CAPTURE_SIMD_LANES
+
+#endif
+
+/** Clamps every lane of Value to [Lo, Hi]. */
+template <typename T>
+inline T Clamp(T Value, T Lo, T Hi)
+{
+	return Min(Max(Value, Lo), Hi);
+}
+
+/**
+ * Rounds every lane to the nearest value, ties to even, of an unsigned or signed float with MantissaBits bits of
+ * mantissa and the 5 bit exponent of a half, e.g. 10 for half, 6 and 5 for R11G11B10. Values past the largest
+ * finite one become MaxValue. Lanes must not be NaN.
+ */
+template <typename V>
+inline V QuantizeCaptureFloat(V Value, int32_t MantissaBits, float MaxValue)
+{
+	using I = typename V::FInt;
+
+	const V Magnitude = Abs(Value);
+	const I Bits = AsInt(Magnitude);
+
+	// Normal range: round the dropped mantissa bits to even in the integer domain.
+	const int32_t DroppedBits = 23 - MantissaBits;
+	const I Odd = ShiftRight(Bits, DroppedBits) & I::Splat(1);
+	const I Rounded = (Bits + I::Splat((1 << (DroppedBits - 1)) - 1) + Odd) & I::Splat(~((1 << DroppedBits) - 1));
+
+	// Below 2^-14 the target has a fixed step of 2^(-14 - MantissaBits): adding a float whose ulp is that step rounds to it.
+	const V Magic = AsFloat(I::Splat((127 + 9 - MantissaBits) << 23));
+	const V Denormal = (Magnitude + Magic) - Magic;
+
+	V Result = Select(Magnitude < V::Splat(1.0f / 16384.0f), Denormal, AsFloat(Rounded));
+	Result = Min(Result, V::Splat(MaxValue));
+	return Select(Value < V::Splat(0.0f), V::Splat(0.0f) - Result, Result);
+}
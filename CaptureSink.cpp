@@ -0,0 +1,198 @@
+#include "CaptureSink.h"
+
+#include "CaptureTrace.h"
+
+#include <algorithm>
+
+FCaptureSink::FCaptureSink(const FCaptureSinkConfig& InConfig, FWriteFunction InWriteFunction)
+	: Config(InConfig)
+	, WriteFunction(std::move(InWriteFunction))
+	, Queue(std::max<uint32_t>(InConfig.QueueCapacity, 2))
+{
+	Config.QueueCapacity = Queue.GetCapacity();
+	Config.NumWriters = std::max<uint32_t>(Config.NumWriters, 1);
+
+	for (uint32_t WriterIndex = 0; WriterIndex < Config.NumWriters; WriterIndex++)
+	{
+		Writers.emplace_back(&FCaptureSink::WriterMain, this);
+	}
+}
+
+FCaptureSink::~FCaptureSink()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> Lock(WakeMutex);
+		bStopping = true;
+	}
+	WakeWriters.notify_all();
+
+	for (std::thread& Writer : Writers)
+	{
+		Writer.join();
+	}
+}
+
+bool FCaptureSink::Enqueue(FCaptureJobPtr Job)
+{
+	if (!Job)
+	{
+		return false;
+	}
+
+	Job->EnqueueTime = std::chrono::steady_clock::now();
+	NumPending++;
+
+	bool bEnqueued = Queue.TryEnqueue(Job);
+	if (!bEnqueued)
+	{
+		if (Config.Overflow == ECaptureOverflow::Drop)
+		{
+			NumPending--;
+			NumDropped++;
+			Recycle(*Job);
+			return false;
+		}
+		else if (Config.Overflow == ECaptureOverflow::Coalesce)
+		{
+			while (!bEnqueued)
+			{
+				FCaptureJobPtr Evicted;
+				if (Queue.TryDequeue(Evicted))
+				{
+					NumPending--;
+					NumCoalesced++;
+					Recycle(*Evicted);
+				}
+				bEnqueued = Queue.TryEnqueue(Job);
+			}
+		}
+		else
+		{
+			CAPTURE_TRACE_SCOPE("Capture.Blocked");
+			NumBlocked++;
+			std::unique_lock<std::mutex> Lock(WakeMutex);
+			while (!bEnqueued)
+			{
+				WakeProducers.wait_for(Lock, std::chrono::milliseconds(1));
+				bEnqueued = Queue.TryEnqueue(Job);
+			}
+		}
+	}
+
+	NumEnqueued++;
+
+	const uint32_t Depth = Queue.Num();
+	CAPTURE_TRACE_COUNTER("Capture.QueueDepth", Depth);
+	uint32_t PrevMax = MaxQueueDepth.load(std::memory_order_relaxed);
+	while (Depth > PrevMax && !MaxQueueDepth.compare_exchange_weak(PrevMax, Depth, std::memory_order_relaxed))
+	{
+	}
+
+	WakeWriters.notify_one();
+	return true;
+}
+
+void FCaptureSink::Flush()
+{
+	std::unique_lock<std::mutex> Lock(WakeMutex);
+	while (NumPending.load() != 0)
+	{
+		WakeProducers.wait_for(Lock, std::chrono::milliseconds(1));
+	}
+}
+
+FCaptureSinkStats FCaptureSink::GetStats() const
+{
+	FCaptureSinkStats Stats;
+	Stats.Enqueued = NumEnqueued.load();
+	Stats.Written = NumWritten.load();
+	Stats.Failed = NumFailed.load();
+	Stats.Dropped = NumDropped.load();
+	Stats.Coalesced = NumCoalesced.load();
+	Stats.Blocked = NumBlocked.load();
+	Stats.BytesWritten = NumBytesWritten.load();
+	Stats.QueueDepth = Queue.Num();
+	Stats.MaxQueueDepth = MaxQueueDepth.load();
+
+	const uint64_t NumCompleted = Stats.Written + Stats.Failed;
+	Stats.AverageLatencyUs = NumCompleted ? double(TotalLatencyUs.load()) / double(NumCompleted) : 0.0;
+	Stats.MaxLatencyUs = double(MaxLatencyUs.load());
+	return Stats;
+}
+
+void FCaptureSink::WriterMain()
+{
+	SetCaptureTraceThreadName("Capture writer");
+	for (;;)
+	{
+		FCaptureJobPtr Job;
+		if (Queue.TryDequeue(Job))
+		{
+			// A cell just freed up for a blocked producer.
+			WakeProducers.notify_all();
+			CAPTURE_TRACE_SPAN("Capture.Queued", uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(Job->EnqueueTime.time_since_epoch()).count()));
+			CAPTURE_TRACE_SCOPE("Capture.Job");
+
+			// A layer bound for a bundle is counted when the bundle is written, and a bundle commit has no bytes of its own.
+			const uint64_t NumBytes = Job->Frame ? Job->Frame->GetPayloadBytes() : Job->FrameLayer ? 0 : Job->Bytes.size();
+			const bool bSucceeded = WriteFunction(*Job);
+			Recycle(*Job);
+			Complete(*Job, bSucceeded, NumBytes);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> Lock(WakeMutex);
+		if (bStopping && Queue.Num() == 0)
+		{
+			return;
+		}
+
+		// Producers notify without taking the lock, so the timeout bounds a missed wake up.
+		WakeWriters.wait_for(Lock, std::chrono::milliseconds(2));
+	}
+}
+
+void FCaptureSink::AddBytesWritten(uint64_t NumBytes)
+{
+	NumBytesWritten += NumBytes;
+}
+
+void FCaptureSink::Complete(const FCaptureWriteJob& Job, bool bSucceeded, uint64_t NumBytes)
+{
+	const uint64_t LatencyUs = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - Job.EnqueueTime).count());
+
+	TotalLatencyUs += LatencyUs;
+	uint64_t PrevMax = MaxLatencyUs.load(std::memory_order_relaxed);
+	while (LatencyUs > PrevMax && !MaxLatencyUs.compare_exchange_weak(PrevMax, LatencyUs, std::memory_order_relaxed))
+	{
+	}
+
+	if (bSucceeded)
+	{
+		NumWritten++;
+		NumBytesWritten += NumBytes;
+	}
+	else
+	{
+		NumFailed++;
+	}
+
+	NumPending--;
+	WakeProducers.notify_all();
+}
+
+void FCaptureSink::Recycle(FCaptureWriteJob& Job)
+{
+	if (Config.BufferPool)
+	{
+		Config.BufferPool->Release(std::move(Job.Bytes));
+		if (Job.Frame)
+		{
+			// Only left with layers when the bundle itself was discarded.
+			Job.Frame->ReleaseLayers(*Config.BufferPool);
+		}
+	}
+}
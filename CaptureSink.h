@@ -0,0 +1,246 @@
+#pragma once
+
+#include "CaptureBufferPool.h"
+#include "CaptureDepth.h"
+#include "CaptureFrame.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Background writer for captured frames. The render thread only moves a filled job into a bounded
+ * lock-free queue; a pool of writer threads owns every file operation.
+ */
+
+/** One packed layer waiting to be written. */
+struct FCaptureWriteJob
+{
+	uint64_t FrameId = 0;
+	std::string Layer;
+	std::string ContainerPath;
+
+	int32_t Width = 0;
+	int32_t Height = 0;
+	uint32_t PixelFormat = 0;
+	uint32_t BytesPerPixel = 0;
+
+	/** Tightly packed rows, Width * BytesPerPixel bytes each. */
+	std::vector<uint8_t> Bytes;
+
+	/** Set when the layer goes into a frame bundle instead of its own record. */
+	FCaptureFrameLayerRef FrameLayer;
+
+	/** Set on the job that writes a completed bundle; the job carries no layer of its own then. */
+	std::shared_ptr<FCaptureFrame> Frame;
+
+	/** Depth conversion the writer applies before encoding. */
+	FCaptureDepthLinearization DepthLinearization;
+
+	std::chrono::steady_clock::time_point EnqueueTime;
+};
+
+enum class ECaptureOverflow : uint8_t
+{
+	/** Discard the new job when the queue is full. */
+	Drop,
+
+	/** Wait on the producer side until a writer frees a cell. */
+	Block,
+
+	/** Evict the oldest queued job so the newest frame always makes it to disk. */
+	Coalesce,
+};
+
+/**
+ * Bounded multi-producer multi-consumer queue (Vyukov). Every cell carries a sequence number so
+ * producers and consumers only contend on their own cursor.
+ */
+template<typename T>
+class TCaptureBoundedQueue
+{
+public:
+	explicit TCaptureBoundedQueue(uint32_t MinCapacity)
+	{
+		uint32_t Capacity = 2;
+		while (Capacity < MinCapacity)
+		{
+			Capacity <<= 1;
+		}
+
+		Cells = std::unique_ptr<FCell[]>(new FCell[Capacity]);
+		Mask = Capacity - 1;
+		for (uint32_t Index = 0; Index < Capacity; Index++)
+		{
+			Cells[Index].Sequence.store(Index, std::memory_order_relaxed);
+		}
+	}
+
+	uint32_t GetCapacity() const { return Mask + 1; }
+
+	uint32_t Num() const
+	{
+		const uint64_t Tail = DequeuePos.load(std::memory_order_relaxed);
+		const uint64_t Head = EnqueuePos.load(std::memory_order_relaxed);
+		return Head > Tail ? uint32_t(Head - Tail) : 0;
+	}
+
+	bool TryEnqueue(T& Item)
+	{
+		uint64_t Pos = EnqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			FCell& Cell = Cells[Pos & Mask];
+			const uint64_t Sequence = Cell.Sequence.load(std::memory_order_acquire);
+			const int64_t Diff = int64_t(Sequence) - int64_t(Pos);
+			if (Diff == 0)
+			{
+				if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				{
+					Cell.Item = std::move(Item);
+					Cell.Sequence.store(Pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool TryDequeue(T& OutItem)
+	{
+		uint64_t Pos = DequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			FCell& Cell = Cells[Pos & Mask];
+			const uint64_t Sequence = Cell.Sequence.load(std::memory_order_acquire);
+			const int64_t Diff = int64_t(Sequence) - int64_t(Pos + 1);
+			if (Diff == 0)
+			{
+				if (DequeuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+				{
+					OutItem = std::move(Cell.Item);
+					Cell.Sequence.store(Pos + Mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (Diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				Pos = DequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct FCell
+	{
+		std::atomic<uint64_t> Sequence;
+		T Item;
+	};
+
+	std::unique_ptr<FCell[]> Cells;
+	uint64_t Mask = 0;
+
+	alignas(64) std::atomic<uint64_t> EnqueuePos{ 0 };
+	alignas(64) std::atomic<uint64_t> DequeuePos{ 0 };
+};
+
+struct FCaptureSinkConfig
+{
+	uint32_t QueueCapacity = 64;
+	uint32_t NumWriters = 2;
+	ECaptureOverflow Overflow = ECaptureOverflow::Drop;
+
+	/** Takes back the bytes of every job once it is written or discarded, unless the write function kept them. */
+	FCaptureBufferPool* BufferPool = nullptr;
+};
+
+struct FCaptureSinkStats
+{
+	uint64_t Enqueued = 0;
+	uint64_t Written = 0;
+	uint64_t Failed = 0;
+	uint64_t Dropped = 0;
+	uint64_t Coalesced = 0;
+	uint64_t Blocked = 0;
+	uint64_t BytesWritten = 0;
+
+	uint32_t QueueDepth = 0;
+	uint32_t MaxQueueDepth = 0;
+
+	/** Time from Enqueue() to the end of the write, in microseconds. */
+	double AverageLatencyUs = 0.0;
+	double MaxLatencyUs = 0.0;
+};
+
+class FCaptureSink
+{
+public:
+	using FCaptureJobPtr = std::unique_ptr<FCaptureWriteJob>;
+
+	/** Returns false on I/O failure. Called concurrently from every writer thread, may move the payload out of the job. */
+	using FWriteFunction = std::function<bool(FCaptureWriteJob&)>;
+
+	FCaptureSink(const FCaptureSinkConfig& InConfig, FWriteFunction InWriteFunction);
+	~FCaptureSink();
+
+	FCaptureSink(const FCaptureSink&) = delete;
+	FCaptureSink& operator=(const FCaptureSink&) = delete;
+
+	/** Hands a job over to the writers. Returns false if the overflow policy discarded it. */
+	bool Enqueue(FCaptureJobPtr Job);
+
+	/** Waits until every queued job has been written. */
+	void Flush();
+
+	/** Counts bytes written outside a job of their own, such as a bundle committed by the writer that delivered its last layer. */
+	void AddBytesWritten(uint64_t NumBytes);
+
+	const FCaptureSinkConfig& GetConfig() const { return Config; }
+	FCaptureSinkStats GetStats() const;
+
+private:
+	void WriterMain();
+	void Complete(const FCaptureWriteJob& Job, bool bSucceeded, uint64_t NumBytes);
+	void Recycle(FCaptureWriteJob& Job);
+
+	FCaptureSinkConfig Config;
+	FWriteFunction WriteFunction;
+	TCaptureBoundedQueue<FCaptureJobPtr> Queue;
+	std::vector<std::thread> Writers;
+
+	std::mutex WakeMutex;
+	std::condition_variable WakeWriters;
+	std::condition_variable WakeProducers;
+	std::atomic<bool> bStopping{ false };
+
+	std::atomic<uint32_t> NumPending{ 0 };
+
+	std::atomic<uint64_t> NumEnqueued{ 0 };
+	std::atomic<uint64_t> NumWritten{ 0 };
+	std::atomic<uint64_t> NumFailed{ 0 };
+	std::atomic<uint64_t> NumDropped{ 0 };
+	std::atomic<uint64_t> NumCoalesced{ 0 };
+	std::atomic<uint64_t> NumBlocked{ 0 };
+	std::atomic<uint64_t> NumBytesWritten{ 0 };
+	std::atomic<uint32_t> MaxQueueDepth{ 0 };
+	std::atomic<uint64_t> TotalLatencyUs{ 0 };
+	std::atomic<uint64_t> MaxLatencyUs{ 0 };
+};
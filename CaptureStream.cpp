@@ -0,0 +1,362 @@
+#include "CaptureStream.h"
+
+#include "CaptureTrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+
+uint64_t AlignUp(uint64_t Value, uint64_t Alignment)
+{
+	return (Value + Alignment - 1) / Alignment * Alignment;
+}
+
+#if defined(_WIN32)
+std::string GetMappingName(const std::string& Name)
+{
+	return "Local\\" + Name;
+}
+#else
+std::string GetMappingName(const std::string& Name)
+{
+	return Name.empty() || Name[0] != '/' ? "/" + Name : Name;
+}
+#endif
+
+/** Maps Size bytes of the mapping Name, creating it when bCreate is set. Returns nullptr on failure. */
+void* MapRegion(const std::string& Name, uint64_t& InOutSize, bool bCreate, intptr_t& OutHandle)
+{
+	const std::string MappingName = GetMappingName(Name);
+#if defined(_WIN32)
+	HANDLE Mapping = bCreate
+		? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(InOutSize >> 32), DWORD(InOutSize), MappingName.c_str())
+		: OpenFileMappingA(FILE_MAP_READ, FALSE, MappingName.c_str());
+	if (!Mapping)
+	{
+		return nullptr;
+	}
+
+	void* Data = MapViewOfFile(Mapping, bCreate ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+	if (!Data)
+	{
+		CloseHandle(Mapping);
+		return nullptr;
+	}
+	if (!bCreate)
+	{
+		MEMORY_BASIC_INFORMATION Info = {};
+		VirtualQuery(Data, &Info, sizeof(Info));
+		InOutSize = uint64_t(Info.RegionSize);
+	}
+	OutHandle = intptr_t(Mapping);
+	return Data;
+#else
+	if (bCreate)
+	{
+		// A stale ring of a crashed session would otherwise keep its old size.
+		shm_unlink(MappingName.c_str());
+	}
+	const int File = bCreate ? shm_open(MappingName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600) : shm_open(MappingName.c_str(), O_RDONLY, 0);
+	if (File < 0)
+	{
+		return nullptr;
+	}
+
+	if (bCreate && ftruncate(File, off_t(InOutSize)) != 0)
+	{
+		close(File);
+		shm_unlink(MappingName.c_str());
+		return nullptr;
+	}
+	if (!bCreate)
+	{
+		struct stat Stat = {};
+		if (fstat(File, &Stat) != 0)
+		{
+			close(File);
+			return nullptr;
+		}
+		InOutSize = uint64_t(Stat.st_size);
+	}
+
+	void* Data = InOutSize ? mmap(nullptr, size_t(InOutSize), bCreate ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, File, 0) : MAP_FAILED;
+	if (Data == MAP_FAILED)
+	{
+		close(File);
+		if (bCreate)
+		{
+			shm_unlink(MappingName.c_str());
+		}
+		return nullptr;
+	}
+	OutHandle = intptr_t(File);
+	return Data;
+#endif
+}
+
+void UnmapRegion(const void* Data, uint64_t Size, intptr_t Handle)
+{
+#if defined(_WIN32)
+	(void)Size;
+	UnmapViewOfFile(Data);
+	CloseHandle(HANDLE(Handle));
+#else
+	munmap(const_cast<void*>(Data), size_t(Size));
+	close(int(Handle));
+#endif
+}
+
+} //! namespace
+
+FCaptureStreamWriter::~FCaptureStreamWriter()
+{
+	Close();
+}
+
+bool FCaptureStreamWriter::Open(const std::string& InName, uint32_t NumSlots, uint64_t SlotBytes)
+{
+	Close();
+
+	NumSlots = std::max<uint32_t>(NumSlots, 2);
+	const uint64_t SlotSize = AlignUp(std::max<uint64_t>(SlotBytes, CaptureContainerAlignment * 2), CaptureContainerAlignment);
+	uint64_t Size = CaptureContainerAlignment + SlotSize * NumSlots;
+
+	intptr_t NewHandle = -1;
+	uint8_t* Data = (uint8_t*)MapRegion(InName, Size, /* bCreate = */ true, NewHandle);
+	if (!Data)
+	{
+		return false;
+	}
+
+	// The mapping starts zeroed, so every slot has an even sequence and no frame is published.
+	FCaptureStreamHeader* NewHeader = (FCaptureStreamHeader*)Data;
+	NewHeader->Version = CaptureStreamVersion;
+	NewHeader->NumSlots = NumSlots;
+	NewHeader->SlotSize = SlotSize;
+	NewHeader->SlotsOffset = CaptureContainerAlignment;
+	NewHeader->Flags.store(0, std::memory_order_relaxed);
+	NewHeader->PublishedFrames.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	NewHeader->Magic = CaptureStreamMagic;
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+	Name = InName;
+	Header = NewHeader;
+	Base = Data;
+	MappedSize = Size;
+	Handle = NewHandle;
+	NextEpoch = 0;
+	return true;
+}
+
+void FCaptureStreamWriter::Close()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	if (!Header)
+	{
+		return;
+	}
+
+	Header->Flags.fetch_or(CaptureStream_Closed, std::memory_order_release);
+	UnmapRegion(Base, MappedSize, Handle);
+#if !defined(_WIN32)
+	shm_unlink(GetMappingName(Name).c_str());
+#endif
+
+	Header = nullptr;
+	Base = nullptr;
+	MappedSize = 0;
+	Handle = -1;
+}
+
+bool FCaptureStreamWriter::Publish(const FCaptureFrameInfo& Info, const FCaptureLayerPayload* Payloads, uint32_t NumPayloads)
+{
+	CAPTURE_TRACE_SCOPE("Capture.Publish");
+	std::lock_guard<std::mutex> Lock(Mutex);
+	if (!Header)
+	{
+		return false;
+	}
+
+	// Lay the frame out first so a frame that does not fit never touches a slot.
+	uint64_t Offsets[CaptureStreamMaxLayers];
+	uint64_t End = CaptureContainerAlignment;
+	for (uint32_t Index = 0; Index < NumPayloads && Index < CaptureStreamMaxLayers; Index++)
+	{
+		Offsets[Index] = AlignUp(End, CaptureStreamPayloadAlignment);
+		End = Offsets[Index] + Payloads[Index].Size;
+	}
+	if (NumPayloads > CaptureStreamMaxLayers || End > Header->SlotSize)
+	{
+		NumOversized++;
+		return false;
+	}
+
+	const uint64_t Epoch = NextEpoch++;
+	uint8_t* SlotData = Base + Header->SlotsOffset + (Epoch % Header->NumSlots) * Header->SlotSize;
+	FCaptureStreamSlot* Slot = (FCaptureStreamSlot*)SlotData;
+
+	// Odd sequence first; the fence keeps the copies below from becoming visible before it.
+	const uint64_t Sequence = Slot->Sequence.load(std::memory_order_relaxed);
+	Slot->Sequence.store(Sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	Slot->Epoch = Epoch;
+	Slot->Info = Info;
+	Slot->Info.Magic = CaptureFrameMagic;
+	Slot->Info.NumLayers = NumPayloads;
+	for (uint32_t Index = 0; Index < NumPayloads; Index++)
+	{
+		const FCaptureLayerPayload& Payload = Payloads[Index];
+		FCaptureStreamLayer& Layer = Slot->Layers[Index];
+		memset(&Layer, 0, sizeof(Layer));
+		memcpy(Layer.Name, Payload.Layer, std::min<size_t>(strlen(Payload.Layer), CaptureLayerNameSize - 1));
+		Layer.Width = Payload.Width;
+		Layer.Height = Payload.Height;
+		Layer.PixelFormat = Payload.PixelFormat;
+		Layer.BytesPerPixel = Payload.BytesPerPixel;
+		Layer.Codec = uint16_t(Payload.Codec);
+		Layer.Offset = Offsets[Index];
+		Layer.Size = Payload.Size;
+		Layer.RawSize = Payload.Codec == ECaptureCodec::Raw ? Payload.Size : Payload.RawSize;
+		memcpy(SlotData + Offsets[Index], Payload.Data, size_t(Payload.Size));
+	}
+
+	Slot->Sequence.store(Sequence + 2, std::memory_order_release);
+	Header->PublishedFrames.store(Epoch + 1, std::memory_order_release);
+	NumPublished++;
+	return true;
+}
+
+FCaptureStreamStats FCaptureStreamWriter::GetStats() const
+{
+	FCaptureStreamStats Stats;
+	Stats.Published = NumPublished.load(std::memory_order_relaxed);
+	Stats.Oversized = NumOversized.load(std::memory_order_relaxed);
+	return Stats;
+}
+
+FCaptureStreamReader::~FCaptureStreamReader()
+{
+	Close();
+}
+
+bool FCaptureStreamReader::Open(const std::string& Name)
+{
+	Close();
+
+	uint64_t Size = 0;
+	intptr_t NewHandle = -1;
+	const uint8_t* Data = (const uint8_t*)MapRegion(Name, Size, /* bCreate = */ false, NewHandle);
+	if (!Data)
+	{
+		return false;
+	}
+
+	const FCaptureStreamHeader* NewHeader = (const FCaptureStreamHeader*)Data;
+	const bool bValid = Size >= sizeof(FCaptureStreamHeader)
+		&& NewHeader->Magic == CaptureStreamMagic
+		&& NewHeader->Version == CaptureStreamVersion
+		&& NewHeader->NumSlots > 0
+		&& NewHeader->SlotsOffset + NewHeader->SlotSize * NewHeader->NumSlots <= Size;
+	if (!bValid)
+	{
+		UnmapRegion(Data, Size, NewHandle);
+		return false;
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	Header = NewHeader;
+	Base = Data;
+	MappedSize = Size;
+	Handle = NewHandle;
+
+	const uint64_t Published = Header->PublishedFrames.load(std::memory_order_acquire);
+	NextEpoch = Published ? Published - 1 : 0;
+	Stats = FCaptureStreamReaderStats();
+	return true;
+}
+
+void FCaptureStreamReader::Close()
+{
+	if (Header)
+	{
+		UnmapRegion(Base, MappedSize, Handle);
+		Header = nullptr;
+		Base = nullptr;
+		MappedSize = 0;
+		Handle = -1;
+	}
+}
+
+ECaptureStreamRead FCaptureStreamReader::BeginRead(FCaptureStreamFrameView& OutFrame)
+{
+	if (!Header)
+	{
+		return ECaptureStreamRead::Closed;
+	}
+
+	const uint64_t NumSlots = Header->NumSlots;
+	for (;;)
+	{
+		const uint64_t Published = Header->PublishedFrames.load(std::memory_order_acquire);
+		if (NextEpoch >= Published)
+		{
+			return (Header->Flags.load(std::memory_order_acquire) & CaptureStream_Closed) ? ECaptureStreamRead::Closed : ECaptureStreamRead::NoFrame;
+		}
+
+		// The slot of the oldest frame in the ring is the one the writer fills next, so a lagging reader resumes after it.
+		const uint64_t Oldest = Published >= NumSlots ? Published - NumSlots + 1 : 0;
+		if (NextEpoch < Oldest)
+		{
+			Stats.Skipped += Oldest - NextEpoch;
+			NextEpoch = Oldest;
+		}
+
+		const uint8_t* SlotData = Base + Header->SlotsOffset + (NextEpoch % NumSlots) * Header->SlotSize;
+		const FCaptureStreamSlot* Slot = (const FCaptureStreamSlot*)SlotData;
+		const uint64_t Sequence = Slot->Sequence.load(std::memory_order_acquire);
+		if ((Sequence & 1) || Slot->Epoch != NextEpoch)
+		{
+			// Overwritten since PublishedFrames was read.
+			Stats.Skipped++;
+			NextEpoch++;
+			continue;
+		}
+
+		OutFrame.Epoch = NextEpoch;
+		OutFrame.Info = Slot->Info;
+		OutFrame.Info.NumLayers = std::min<uint32_t>(OutFrame.Info.NumLayers, CaptureStreamMaxLayers);
+		OutFrame.Layers = Slot->Layers;
+		OutFrame.Slot = SlotData;
+		OutFrame.Sequence = Sequence;
+		NextEpoch++;
+		return ECaptureStreamRead::Frame;
+	}
+}
+
+bool FCaptureStreamReader::EndRead(const FCaptureStreamFrameView& Frame)
+{
+	// Everything read from the slot happens before the sequence is checked again.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const FCaptureStreamSlot* Slot = (const FCaptureStreamSlot*)Frame.Slot;
+	if (Slot->Sequence.load(std::memory_order_relaxed) != Frame.Sequence)
+	{
+		Stats.Torn++;
+		return false;
+	}
+	Stats.Read++;
+	return true;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "CaptureContainer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * Live stream of committed frame bundles through a shared memory ring, for a training or inspection process on
+ * the same machine. The ring lives in a named mapping (POSIX shm_open, or a named file mapping on Windows).
+ *
+ * The region starts with FCaptureStreamHeader; NumSlots slots of SlotSize bytes follow, each holding one frame:
+ * FCaptureStreamSlot, then the layer payloads from CaptureContainerAlignment on, every payload 64 byte aligned.
+ *
+ * Frame N goes to slot N % NumSlots under a seqlock. The writer makes the slot's Sequence odd, copies the frame
+ * in, makes it even again, then bumps PublishedFrames. It never waits for readers: a reader that falls more than
+ * NumSlots frames behind skips ahead, and one that was overtaken while it looked at a slot sees a different
+ * Sequence when it is done and drops the frame. Readers map the region read only and use the payloads in place.
+ */
+
+static constexpr uint32_t CaptureStreamMagic = 0x54534355; // "UCST"
+static constexpr uint32_t CaptureStreamVersion = 1;
+static constexpr uint32_t CaptureStreamMaxLayers = 16;
+static constexpr uint32_t CaptureStreamPayloadAlignment = 64;
+
+enum ECaptureStreamFlags : uint32_t
+{
+	/** Set when the writer shut down; nothing is published after it. */
+	CaptureStream_Closed = 1 << 0,
+};
+
+struct FCaptureStreamHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t NumSlots;
+	std::atomic<uint32_t> Flags;
+
+	/** Bytes of every slot, header included, and offset of the first slot. Both multiples of CaptureContainerAlignment. */
+	uint64_t SlotSize;
+	uint64_t SlotsOffset;
+
+	/** Frames published so far; frame N is complete once this exceeds N. */
+	std::atomic<uint64_t> PublishedFrames;
+
+	uint64_t Reserved[11];
+};
+static_assert(sizeof(FCaptureStreamHeader) == 128, "FCaptureStreamHeader layout is shared with the consumers.");
+
+struct FCaptureStreamLayer
+{
+	char Name[CaptureLayerNameSize];
+	int32_t Width;
+	int32_t Height;
+	uint32_t PixelFormat;
+	uint32_t BytesPerPixel;
+	uint16_t Codec;
+	uint16_t Flags;
+	uint32_t Reserved0;
+
+	/** Offset of the payload from the start of the slot, its size and its size once decoded. */
+	uint64_t Offset;
+	uint64_t Size;
+	uint64_t RawSize;
+};
+static_assert(sizeof(FCaptureStreamLayer) == 80, "FCaptureStreamLayer layout is shared with the consumers.");
+
+struct FCaptureStreamSlot
+{
+	/** Odd while the writer fills the slot. */
+	std::atomic<uint64_t> Sequence;
+
+	/** Index of the frame in the stream, which PublishedFrames counts. */
+	uint64_t Epoch;
+
+	/** Frame id, jitter, pre-exposure and camera cut as in the container. Info.NumLayers entries of Layers are set. */
+	FCaptureFrameInfo Info;
+	FCaptureStreamLayer Layers[CaptureStreamMaxLayers];
+};
+static_assert(sizeof(FCaptureStreamSlot) <= CaptureContainerAlignment, "The slot header has to fit the first page of the slot.");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The seqlock needs address free atomics.");
+
+struct FCaptureStreamStats
+{
+	uint64_t Published = 0;
+
+	/** Frames that did not fit a slot. */
+	uint64_t Oversized = 0;
+};
+
+/** Owner of the ring. Publish() may be called from every writer thread. */
+class FCaptureStreamWriter
+{
+public:
+	FCaptureStreamWriter() = default;
+	~FCaptureStreamWriter();
+
+	FCaptureStreamWriter(const FCaptureStreamWriter&) = delete;
+	FCaptureStreamWriter& operator=(const FCaptureStreamWriter&) = delete;
+
+	/** Creates (or recreates) the mapping Name with NumSlots slots of at least SlotBytes each. */
+	bool Open(const std::string& Name, uint32_t NumSlots, uint64_t SlotBytes);
+
+	/** Marks the stream closed and removes the name; readers that have it mapped keep their view. */
+	void Close();
+
+	bool IsOpen() const { return Header != nullptr; }
+	const std::string& GetName() const { return Name; }
+
+	/** Copies one frame into the next slot. Returns false if the writer is closed or the frame does not fit a slot. */
+	bool Publish(const FCaptureFrameInfo& Info, const FCaptureLayerPayload* Payloads, uint32_t NumPayloads);
+
+	FCaptureStreamStats GetStats() const;
+
+private:
+	std::string Name;
+	FCaptureStreamHeader* Header = nullptr;
+	uint8_t* Base = nullptr;
+	uint64_t MappedSize = 0;
+	intptr_t Handle = -1;
+
+	std::mutex Mutex;
+	uint64_t NextEpoch = 0;
+	std::atomic<uint64_t> NumPublished{ 0 };
+	std::atomic<uint64_t> NumOversized{ 0 };
+};
+
+/** Frame a reader is looking at. Pointers alias the mapping and are only trustworthy once EndRead() agrees. */
+struct FCaptureStreamFrameView
+{
+	uint64_t Epoch = 0;
+	FCaptureFrameInfo Info = {};
+	const FCaptureStreamLayer* Layers = nullptr;
+	const uint8_t* Slot = nullptr;
+
+	const uint8_t* GetPayload(uint32_t Layer) const { return Slot + Layers[Layer].Offset; }
+
+private:
+	friend class FCaptureStreamReader;
+	uint64_t Sequence = 0;
+};
+
+struct FCaptureStreamReaderStats
+{
+	uint64_t Read = 0;
+
+	/** Frames the writer overwrote before the reader got to them, and frames overwritten while being read. */
+	uint64_t Skipped = 0;
+	uint64_t Torn = 0;
+};
+
+enum class ECaptureStreamRead : uint8_t
+{
+	Frame,
+	NoFrame,
+	Closed,
+};
+
+/** Reference consumer; one instance per reading thread. */
+class FCaptureStreamReader
+{
+public:
+	FCaptureStreamReader() = default;
+	~FCaptureStreamReader();
+
+	FCaptureStreamReader(const FCaptureStreamReader&) = delete;
+	FCaptureStreamReader& operator=(const FCaptureStreamReader&) = delete;
+
+	/** Maps the ring read only. Reading starts at the newest published frame. */
+	bool Open(const std::string& Name);
+	void Close();
+
+	/** Starts reading the next frame in stream order, skipping what the writer already overwrote. Never blocks. */
+	ECaptureStreamRead BeginRead(FCaptureStreamFrameView& OutFrame);
+
+	/** True when the slot was not touched while OutFrame was in use; otherwise whatever was read from it is garbage. */
+	bool EndRead(const FCaptureStreamFrameView& Frame);
+
+	const FCaptureStreamReaderStats& GetStats() const { return Stats; }
+
+private:
+	const FCaptureStreamHeader* Header = nullptr;
+	const uint8_t* Base = nullptr;
+	uint64_t MappedSize = 0;
+	intptr_t Handle = -1;
+
+	uint64_t NextEpoch = 0;
+	FCaptureStreamReaderStats Stats;
+};
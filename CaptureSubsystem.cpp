@@ -0,0 +1,428 @@
+#include "CaptureSubsystem.h"
+
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+
+#include "CaptureCompress.h"
+#include "CaptureContainer.h"
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+DEFINE_LOG_CATEGORY(LogCapture);
+
+namespace
+{
+
+TAutoConsoleVariable<int32> CVarCaptureWriterThreads(
+	TEXT("r.Capture.WriterThreads"),
+	2,
+	TEXT("Number of background threads writing captured frames to disk. Read when the first frame is captured."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCaptureWriterQueueSize(
+	TEXT("r.Capture.WriterQueueSize"),
+	64,
+	TEXT("Number of captured layers that may wait for a writer thread. Read when the first frame is captured."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCaptureWriterOverflow(
+	TEXT("r.Capture.WriterOverflow"),
+	0,
+	TEXT("What to do when the writer queue is full. Read when the first frame is captured.\n")
+	TEXT(" 0: drop the new layer (default);\n")
+	TEXT(" 1: block the render thread until a writer catches up;\n")
+	TEXT(" 2: evict the oldest queued layer in favor of the new one."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCapturePoolMaxMegabytes(
+	TEXT("r.Capture.Pool.MaxMegabytes"),
+	512,
+	TEXT("Megabytes of free layer buffers kept for reuse by the capture path, 0 for no limit. Buffers released longest ago\n")
+	TEXT("are freed first once the pool holds more. Read when the first frame is captured."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCaptureCompression(
+	TEXT("r.Capture.Compression"),
+	0,
+	TEXT("Lossless compression of captured layers, applied on the writer threads.\n")
+	TEXT(" 0: store raw rows (default);\n")
+	TEXT(" 1: byte planes, row delta and rANS entropy coding, for as many layers as the writers can encode while keeping up with\n")
+	TEXT("    the capture; the others are stored raw;\n")
+	TEXT(" 2: the same for every layer, even when the writers fall behind.\n")
+	TEXT("The coder encodes 0.1 to 0.2 GB/s per writer thread, so it cannot keep up with a 720p capture of color, velocity and\n")
+	TEXT("depth above 11 to 18 frames/s on two writers (capture_bench compress). At 60 fps mode 1 stores most layers raw and\n")
+	TEXT("saves little space, and mode 2 makes the writers fall behind and drop or block frames."),
+	ECVF_Default);
+
+TAutoConsoleVariable<int32> CVarCaptureStream(
+	TEXT("r.Capture.Stream"),
+	0,
+	TEXT("Publish every committed frame bundle to a shared memory ring a local process can map (see CaptureStream.h).\n")
+	TEXT(" 0: off (default);\n")
+	TEXT(" 1: stream and write the container;\n")
+	TEXT(" 2: stream only, frame bundles are not written to disk."),
+	ECVF_Default);
+
+TAutoConsoleVariable<FString> CVarCaptureStreamName(
+	TEXT("r.Capture.Stream.Name"),
+	TEXT("ue_capture"),
+	TEXT("Name of the shared memory ring, /dev/shm/<name> on Linux and Local\\<name> on Windows. Read when the first frame is streamed."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCaptureStreamSlots(
+	TEXT("r.Capture.Stream.Slots"),
+	4,
+	TEXT("Frames the shared memory ring holds; a reader further behind skips ahead. Read when the first frame is streamed."),
+	ECVF_ReadOnly);
+
+TAutoConsoleVariable<int32> CVarCaptureStreamSlotMegabytes(
+	TEXT("r.Capture.Stream.SlotMegabytes"),
+	128,
+	TEXT("Size of one ring slot; frames with more layer bytes are not streamed. Read when the first frame is streamed."),
+	ECVF_ReadOnly);
+
+/** Totals of the compression stage, summed over every writer thread. */
+struct FCaptureCompressionStats
+{
+	std::atomic<uint64_t> NumLayers{ 0 };
+	std::atomic<uint64_t> RawBytes{ 0 };
+	std::atomic<uint64_t> EncodedBytes{ 0 };
+	std::atomic<uint64_t> EncodeMicroseconds{ 0 };
+};
+
+FCaptureCompressionStats GCaptureCompressionStats;
+
+/** Decides which layers r.Capture.Compression 1 encodes; sized for the writer pool when first used. */
+FCaptureCompressionGovernor& GetCompressionGovernor()
+{
+	static FCaptureCompressionGovernor Governor(GetCaptureSink().GetConfig().NumWriters);
+	return Governor;
+}
+
+struct FCaptureFrameStats
+{
+	std::atomic<uint64_t> NumCommitted{ 0 };
+	std::atomic<uint64_t> NumLayers{ 0 };
+	std::atomic<uint64_t> NumDroppedLayers{ 0 };
+};
+
+FCaptureFrameStats GCaptureFrameStats;
+
+FAutoConsoleCommand CaptureStatsCommand(
+	TEXT("r.Capture.Stats"),
+	TEXT("Prints the capture writer counters."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		const FCaptureSinkStats Stats = GetCaptureSink().GetStats();
+		UE_LOG(LogCapture, Display, TEXT("Capture writer: %llu enqueued, %llu written (%.1f MB), %llu failed, %llu dropped, %llu coalesced, %llu blocked"),
+			Stats.Enqueued, Stats.Written, double(Stats.BytesWritten) / (1024.0 * 1024.0), Stats.Failed, Stats.Dropped, Stats.Coalesced, Stats.Blocked);
+		UE_LOG(LogCapture, Display, TEXT("Capture writer: queue depth %u (max %u), latency avg %.2f ms, max %.2f ms"),
+			Stats.QueueDepth, Stats.MaxQueueDepth, Stats.AverageLatencyUs / 1000.0, Stats.MaxLatencyUs / 1000.0);
+
+		const uint64_t RawBytes = GCaptureCompressionStats.RawBytes.load();
+		const uint64_t EncodedBytes = GCaptureCompressionStats.EncodedBytes.load();
+		const uint64_t EncodeMicroseconds = GCaptureCompressionStats.EncodeMicroseconds.load();
+		if (RawBytes)
+		{
+			UE_LOG(LogCapture, Display, TEXT("Capture compression: %llu layers, ratio %.2f, %.2f GB/s per writer thread"),
+				GCaptureCompressionStats.NumLayers.load(), double(RawBytes) / double(FMath::Max<uint64_t>(EncodedBytes, 1)),
+				double(RawBytes) / double(FMath::Max<uint64_t>(EncodeMicroseconds, 1)) / 1000.0);
+		}
+		if (CVarCaptureCompression.GetValueOnAnyThread() == 1 && GetCompressionGovernor().GetNumBypassed())
+		{
+			UE_LOG(LogCapture, Display, TEXT("Capture compression: %llu layers stored raw to keep up with the capture, %.0f%% of the bytes encoded now"),
+				GetCompressionGovernor().GetNumBypassed(), 100.0 * GetCompressionGovernor().GetShare());
+		}
+
+		const FCaptureBufferPoolStats PoolStats = GetCaptureBufferPool().GetStats();
+		if (PoolStats.NumAcquired)
+		{
+			UE_LOG(LogCapture, Display, TEXT("Capture buffers: %llu acquired, %.1f%% hit rate, %u pooled (%.1f MB), %.1f MB resident (peak %.1f MB), %llu trimmed"),
+				PoolStats.NumAcquired, 100.0 * PoolStats.GetHitRate(), PoolStats.NumPooled, double(PoolStats.PooledBytes) / (1024.0 * 1024.0),
+				double(PoolStats.ResidentBytes) / (1024.0 * 1024.0), double(PoolStats.PeakResidentBytes) / (1024.0 * 1024.0), PoolStats.NumTrimmed);
+		}
+
+		if (CVarCaptureStream.GetValueOnAnyThread() != 0)
+		{
+			const FCaptureStreamStats StreamStats = GetCaptureStream().GetStats();
+			UE_LOG(LogCapture, Display, TEXT("Capture stream: %llu frames published, %llu too large for a slot"), StreamStats.Published, StreamStats.Oversized);
+		}
+
+		if (const uint64_t NumCommitted = GCaptureFrameStats.NumCommitted.load())
+		{
+			UE_LOG(LogCapture, Display, TEXT("Capture frames: %llu committed, %.1f layers per frame, %llu layers dropped"),
+				NumCommitted, double(GCaptureFrameStats.NumLayers.load()) / double(NumCommitted), GCaptureFrameStats.NumDroppedLayers.load());
+		}
+	}));
+
+FAutoConsoleCommand CaptureCloseContainersCommand(
+	TEXT("r.Capture.CloseContainers"),
+	TEXT("Writes the index of every open capture container so it can be read while the game keeps running. The containers stay open and capturing appends to them."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		ENQUEUE_RENDER_COMMAND(CaptureFlushContainers)([](FRHICommandListImmediate&)
+		{
+			FlushCaptureContainers();
+		});
+	}));
+
+/** Writers of every container a hook has appended to, keyed by path. */
+struct FCaptureContainerRegistry
+{
+	std::mutex Mutex;
+	std::map<std::string, std::unique_ptr<FCaptureContainerWriter>> Writers;
+
+	FCaptureContainerWriter* FindOrOpen(const std::string& Path)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		std::unique_ptr<FCaptureContainerWriter>& Writer = Writers[Path];
+		if (!Writer)
+		{
+			Writer = std::make_unique<FCaptureContainerWriter>();
+			if (!Writer->Open(Path, false))
+			{
+				UE_LOG(LogCapture, Error, TEXT("Failed to create capture container %s"), UTF8_TO_TCHAR(Path.c_str()));
+			}
+		}
+		return Writer->IsOpen() ? Writer.get() : nullptr;
+	}
+
+	void FlushAll()
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (auto& Pair : Writers)
+		{
+			if (!Pair.second->Flush())
+			{
+				UE_LOG(LogCapture, Error, TEXT("Failed to write the index of capture container %s"), UTF8_TO_TCHAR(Pair.first.c_str()));
+			}
+		}
+	}
+
+	void Close(const std::string& Path)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		const auto Found = Writers.find(Path);
+		if (Found != Writers.end())
+		{
+			Found->second->Close();
+			Writers.erase(Found);
+		}
+	}
+};
+
+FCaptureContainerRegistry& GetContainerRegistry()
+{
+	static FCaptureContainerRegistry Registry;
+	return Registry;
+}
+
+/** True if r.Capture.Compression asks for the job to be encoded and, in the adaptive mode, the writers have time for it. */
+bool ShouldEncodeLayer(const FCaptureWriteJob& Job)
+{
+	const int32 Mode = CVarCaptureCompression.GetValueOnAnyThread();
+	return Mode == 2 || (Mode == 1 && GetCompressionGovernor().Admit(Job.Bytes.size(), Job.EnqueueTime));
+}
+
+/** Runs the compression stage on a job ShouldEncodeLayer() let through. */
+bool EncodeLayer(const FCaptureWriteJob& Job, std::vector<uint8_t>& OutEncoded)
+{
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	const bool bEncoded = EncodeCapturePayload(Job.Bytes.data(), Job.Width, Job.Height, Job.BytesPerPixel, OutEncoded);
+	const std::chrono::microseconds Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - StartTime);
+	GCaptureCompressionStats.EncodeMicroseconds += uint64_t(Elapsed.count());
+	GetCompressionGovernor().AddEncode(Job.Bytes.size(), double(Elapsed.count()) * 1e-6);
+
+	if (bEncoded)
+	{
+		GCaptureCompressionStats.NumLayers++;
+		GCaptureCompressionStats.RawBytes += Job.Bytes.size();
+		GCaptureCompressionStats.EncodedBytes += OutEncoded.size();
+	}
+	return bEncoded;
+}
+
+bool WriteCaptureFrame(FCaptureFrame& Frame)
+{
+	const int32 StreamMode = CVarCaptureStream.GetValueOnAnyThread();
+	const std::vector<FCaptureLayerPayload> Payloads = Frame.GetPayloads();
+	GCaptureFrameStats.NumCommitted++;
+	GCaptureFrameStats.NumLayers += Payloads.size();
+	GCaptureFrameStats.NumDroppedLayers += Frame.GetInfo().NumDropped;
+
+	if (StreamMode != 0)
+	{
+		GetCaptureStream().Publish(Frame.GetInfo(), Payloads.data(), uint32_t(Payloads.size()));
+	}
+
+	bool bWritten = true;
+	if (StreamMode != 2)
+	{
+		FCaptureContainerWriter* Writer = GetContainerRegistry().FindOrOpen(Frame.GetContainerPath());
+		bWritten = Writer && Writer->AppendFrame(Frame.GetInfo(), Payloads.data(), uint32_t(Payloads.size()));
+	}
+
+	Frame.ReleaseLayers(GetCaptureBufferPool());
+	return bWritten;
+}
+
+bool AppendToContainer(FCaptureWriteJob& Job)
+{
+	if (Job.Frame)
+	{
+		return WriteCaptureFrame(*Job.Frame);
+	}
+
+	if (Job.DepthLinearization.bEnabled)
+	{
+		LinearizeCaptureDepthPlane(Job.Bytes, Job.PixelFormat, Job.BytesPerPixel, Job.DepthLinearization);
+	}
+
+	if (Job.FrameLayer)
+	{
+		// The layer waits in its frame until the rest of the bundle has arrived.
+		FCaptureFrameLayer Layer;
+		Layer.Width = Job.Width;
+		Layer.Height = Job.Height;
+		Layer.PixelFormat = Job.PixelFormat;
+		Layer.BytesPerPixel = Job.BytesPerPixel;
+		Layer.RawSize = Job.Bytes.size();
+		const bool bEncode = ShouldEncodeLayer(Job);
+		if (bEncode)
+		{
+			Layer.Bytes = GetCaptureBufferPool().Acquire(0, size_t(GetCaptureEncodedBound(Job.Width, Job.Height, Job.BytesPerPixel)));
+		}
+		if (bEncode && EncodeLayer(Job, Layer.Bytes))
+		{
+			Layer.Codec = ECaptureCodec::ShuffleDeltaRans;
+		}
+		else
+		{
+			GetCaptureBufferPool().Release(MoveTemp(Layer.Bytes));
+			Layer.Bytes = MoveTemp(Job.Bytes);
+		}
+
+		Job.FrameLayer.Complete(MoveTemp(Layer));
+		return true;
+	}
+
+	FCaptureContainerWriter* Writer = GetContainerRegistry().FindOrOpen(Job.ContainerPath);
+	if (!Writer)
+	{
+		return false;
+	}
+
+	thread_local std::vector<uint8_t> Encoded;
+	if (ShouldEncodeLayer(Job) && EncodeLayer(Job, Encoded))
+	{
+		return Writer->Append(
+			Job.FrameId,
+			Job.Layer,
+			Job.Width,
+			Job.Height,
+			Job.PixelFormat,
+			Job.BytesPerPixel,
+			Encoded.data(),
+			Encoded.size(),
+			ECaptureCodec::ShuffleDeltaRans,
+			Job.Bytes.size());
+	}
+
+	return Writer->Append(
+		Job.FrameId,
+		Job.Layer,
+		Job.Width,
+		Job.Height,
+		Job.PixelFormat,
+		Job.BytesPerPixel,
+		Job.Bytes.data(),
+		Job.Bytes.size());
+}
+
+} //! namespace
+
+FCaptureSink& GetCaptureSink()
+{
+	// The registry and the buffer pool have to outlive the writer threads, so they are constructed first.
+	GetContainerRegistry();
+	GetCaptureBufferPool();
+
+	static FCaptureSink Sink([]()
+	{
+		FCaptureSinkConfig Config;
+		Config.NumWriters = FMath::Max(CVarCaptureWriterThreads.GetValueOnAnyThread(), 1);
+		Config.QueueCapacity = FMath::Max(CVarCaptureWriterQueueSize.GetValueOnAnyThread(), 2);
+		Config.Overflow = ECaptureOverflow(FMath::Clamp(CVarCaptureWriterOverflow.GetValueOnAnyThread(), 0, 2));
+		Config.BufferPool = &GetCaptureBufferPool();
+		return Config;
+	}(), &AppendToContainer);
+
+	return Sink;
+}
+
+FCaptureStreamWriter& GetCaptureStream()
+{
+	static FCaptureStreamWriter Stream;
+	static std::once_flag OpenFlag;
+	std::call_once(OpenFlag, []()
+	{
+		const std::string Name = TCHAR_TO_UTF8(*CVarCaptureStreamName.GetValueOnAnyThread());
+		const uint32 NumSlots = uint32(FMath::Max(CVarCaptureStreamSlots.GetValueOnAnyThread(), 2));
+		const uint64 SlotBytes = uint64(FMath::Max(CVarCaptureStreamSlotMegabytes.GetValueOnAnyThread(), 1)) * 1024 * 1024;
+		if (Stream.Open(Name, NumSlots, SlotBytes))
+		{
+			UE_LOG(LogCapture, Log, TEXT("Streaming captured frames to shared memory %s, %u slots of %llu MB"), UTF8_TO_TCHAR(Name.c_str()), NumSlots, SlotBytes >> 20);
+		}
+		else
+		{
+			UE_LOG(LogCapture, Error, TEXT("Failed to create the capture stream %s"), UTF8_TO_TCHAR(Name.c_str()));
+		}
+	});
+	return Stream;
+}
+
+FCaptureBufferPool& GetCaptureBufferPool()
+{
+	static FCaptureBufferPool Pool(uint64(FMath::Max(CVarCapturePoolMaxMegabytes.GetValueOnAnyThread(), 0)) * 1024 * 1024);
+	return Pool;
+}
+
+void CloseCaptureContainer(const std::string& Path)
+{
+	GetCaptureSink().Flush();
+	GetContainerRegistry().Close(Path);
+}
+
+void FlushCaptureContainers()
+{
+	GetCaptureSink().Flush();
+	GetContainerRegistry().FlushAll();
+}
+
+std::shared_ptr<FCaptureFrame> CreateCaptureFrame(uint64 FrameId, const std::string& ContainerPath)
+{
+	return FCaptureFrame::Create(FrameId, ContainerPath, [](std::shared_ptr<FCaptureFrame> Frame)
+	{
+		if (IsInRenderingThread() || IsInGameThread())
+		{
+			FCaptureSink::FCaptureJobPtr Job = std::make_unique<FCaptureWriteJob>();
+			Job->FrameId = Frame->GetFrameId();
+			Job->ContainerPath = Frame->GetContainerPath();
+			Job->Frame = MoveTemp(Frame);
+			GetCaptureSink().Enqueue(MoveTemp(Job));
+		}
+		else
+		{
+			const uint64_t NumBytes = Frame->GetPayloadBytes();
+			if (WriteCaptureFrame(*Frame))
+			{
+				GetCaptureSink().AddBytesWritten(NumBytes);
+			}
+		}
+	});
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include "CaptureSink.h"
+#include "CaptureStream.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogCapture, Log, All);
+
+/** Engine-side owner of the capture writer pool, configured through the r.Capture.Writer* console variables. */
+FCaptureSink& GetCaptureSink();
+
+/**
+ * Shared memory ring committed frame bundles are published to when r.Capture.Stream is set, created on first use
+ * from the r.Capture.Stream.* console variables. Stays closed if the mapping could not be created.
+ */
+FCaptureStreamWriter& GetCaptureStream();
+
+/** Buffers captured layers are read back into; the writers return them once the layer is written or dropped. */
+FCaptureBufferPool& GetCaptureBufferPool();
+
+/** Waits for the writers, then finalizes the index of the capture container at Path. Capturing to it again starts a new file. */
+void CloseCaptureContainer(const std::string& Path);
+
+/** Waits for the writers, then writes the index of every open capture container, leaving them open for more frames. */
+void FlushCaptureContainers();
+
+/**
+ * Creates an empty frame bundle appended to ContainerPath once it is sealed and all its layers are resolved.
+ * The commit runs on the writer thread that delivers the last layer, or is queued to the writers if the
+ * render thread or the game thread completes the frame.
+ */
+std::shared_ptr<FCaptureFrame> CreateCaptureFrame(uint64 FrameId, const std::string& ContainerPath);
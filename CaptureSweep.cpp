@@ -0,0 +1,238 @@
+/**
+ * Sweeps the r.TemporalAA* settings over a captured sequence with the CPU TAA references (CaptureTAASweep.h).
+ *
+ *   capture_sweep [options] <input.ucap>
+ *
+ * Every option takes a comma separated list and the sweep runs every combination of them, each frame decoded once
+ * for all. A setting's output is compared against the captured "output" layer (or --reference) of the frames that
+ * have one and against its own previous output, then the settings are listed with their error, PSNR, frame to
+ * frame change and resolve time, and written to --csv.
+ *
+ *   capture_sweep --algorithm 0,1 --current-frame-weight 0.02,0.04,0.1 --filter-size 0.5,1,1.5 --catmull-rom 0,1 seq.ucap
+ *
+ * Build: g++ -O2 -std=c++17 -mavx2 CaptureSweep.cpp CaptureTAASweep.cpp CaptureTAAGen4.cpp CaptureTAAGen5.cpp CaptureResample.cpp
+ *        CaptureFilterKernels.cpp CaptureImage.cpp CaptureParallel.cpp CaptureReader.cpp CaptureContainer.cpp CaptureCompress.cpp CaptureHalf.cpp
+ *        CapturePack.cpp CapturePixelFormat.cpp CaptureTrace.cpp -lpthread
+ */
+
+#include "CaptureReader.h"
+#include "CaptureTAASweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+struct FSweepOptions
+{
+	std::string InputPath;
+	std::string CsvPath;
+	std::string ReferenceLayer = "output";
+	FCaptureTAASweepGrid Grid;
+	FCaptureTAASweepOptions Sweep;
+};
+
+void PrintUsage()
+{
+	printf(
+		"usage: capture_sweep [options] <input.ucap>\n"
+		"settings, each a comma separated list swept in every combination:\n"
+		"  --algorithm LIST                 r.TemporalAA.Algorithm, 0 for Gen4 and 1 for Gen5 (default 0)\n"
+		"  --current-frame-weight LIST      r.TemporalAACurrentFrameWeight, 1 / max sample count for Gen5 (default 0.04)\n"
+		"  --filter-size LIST               r.TemporalAAFilterSize, Gen4 (default 1)\n"
+		"  --catmull-rom LIST               r.TemporalAACatmullRom 0 or 1, Gen4 (default 0)\n"
+		"  --history-screen-percentage LIST r.TemporalAA.HistoryScreenPercentage, Gen5 (default 100)\n"
+		"  --r11g11b10 LIST                 r.TemporalAA.R11G11B10History 0 or 1, Gen5 and fast Gen4 (default 0)\n"
+		"  --fast LIST                      Gen4 low quality TAA 0 or 1 (default 0)\n"
+		"options:\n"
+		"  --size WxH                       output size (default: the reference, else the input)\n"
+		"  --frames N                       sweep the first N frames\n"
+		"  --threads N                      threads of the whole sweep (default: one per hardware thread)\n"
+		"  --reference LAYER                layer to compare against (default output)\n"
+		"  --csv file.csv                   write one line per setting\n");
+}
+
+/** Parses "a,b,c" into Values; false when an element is not a number. */
+template <typename T>
+bool ParseList(const char* Text, std::vector<T>& Values)
+{
+	Values.clear();
+	for (const char* Element = Text; *Element;)
+	{
+		char* End;
+		const double Value = strtod(Element, &End);
+		if (End == Element || (*End && *End != ','))
+		{
+			return false;
+		}
+		Values.push_back(T(Value));
+		Element = *End ? End + 1 : End;
+	}
+	return !Values.empty();
+}
+
+bool ParseOptions(int Argc, char** Argv, FSweepOptions& Options)
+{
+	Options.Sweep.NumFrames = ~0u;
+	for (int Arg = 1; Arg < Argc; Arg++)
+	{
+		const char* Value = Argv[Arg];
+		const bool bHasNext = Arg + 1 < Argc;
+
+		bool bParsed = true;
+		if (strcmp(Value, "--algorithm") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.Algorithms);
+		}
+		else if (strcmp(Value, "--current-frame-weight") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.CurrentFrameWeights);
+		}
+		else if (strcmp(Value, "--filter-size") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.FilterSizes)
+				&& std::all_of(Options.Grid.FilterSizes.begin(), Options.Grid.FilterSizes.end(), [](float Size) { return Size > 0.0f; });
+		}
+		else if (strcmp(Value, "--catmull-rom") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.CatmullRoms);
+		}
+		else if (strcmp(Value, "--history-screen-percentage") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.HistoryScreenPercentages);
+		}
+		else if (strcmp(Value, "--r11g11b10") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.R11G11B10Histories);
+		}
+		else if (strcmp(Value, "--fast") == 0 && bHasNext)
+		{
+			bParsed = ParseList(Argv[++Arg], Options.Grid.Fasts);
+		}
+		else if (strcmp(Value, "--size") == 0 && bHasNext)
+		{
+			bParsed = sscanf(Argv[++Arg], "%dx%d", &Options.Sweep.OutputWidth, &Options.Sweep.OutputHeight) == 2 && Options.Sweep.OutputWidth > 0
+				&& Options.Sweep.OutputHeight > 0;
+		}
+		else if (strcmp(Value, "--frames") == 0 && bHasNext)
+		{
+			Options.Sweep.NumFrames = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--threads") == 0 && bHasNext)
+		{
+			Options.Sweep.NumThreads = uint32_t(std::max(atoi(Argv[++Arg]), 1));
+		}
+		else if (strcmp(Value, "--reference") == 0 && bHasNext)
+		{
+			Options.ReferenceLayer = Argv[++Arg];
+		}
+		else if (strcmp(Value, "--csv") == 0 && bHasNext)
+		{
+			Options.CsvPath = Argv[++Arg];
+		}
+		else if (Value[0] != '-' && Options.InputPath.empty())
+		{
+			Options.InputPath = Value;
+		}
+		else
+		{
+			bParsed = false;
+		}
+		if (!bParsed)
+		{
+			return false;
+		}
+	}
+	return !Options.InputPath.empty() && std::all_of(Options.Grid.Algorithms.begin(), Options.Grid.Algorithms.end(), [](int32_t Algorithm)
+	{
+		return Algorithm == 0 || Algorithm == 1;
+	});
+}
+
+} //! namespace
+
+int main(int Argc, char** Argv)
+{
+	FSweepOptions Options;
+	if (!ParseOptions(Argc, Argv, Options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	FCaptureReader Reader;
+	if (!Reader.Open(Options.InputPath))
+	{
+		fprintf(stderr, "cannot open %s\n", Options.InputPath.c_str());
+		return 1;
+	}
+
+	const std::vector<FCaptureTAASweepConfig> Configs = ExpandCaptureTAASweepGrid(Options.Grid);
+	Options.Sweep.NumFrames = std::min(Options.Sweep.NumFrames, Reader.GetNumFrames());
+	const uint32_t NumThreads = Options.Sweep.NumThreads ? Options.Sweep.NumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	printf("%zu settings over %u frames of %s on %u thread%s\n", Configs.size(), Options.Sweep.NumFrames, Options.InputPath.c_str(), NumThreads,
+		NumThreads > 1 ? "s" : "");
+
+	const char* ReferenceLayer = Options.ReferenceLayer.c_str();
+	std::vector<FCaptureTAASweepResult> Results;
+	const auto Start = std::chrono::steady_clock::now();
+	const bool bSwept = RunCaptureTAASweep(Configs, Options.Sweep, [&Reader, ReferenceLayer](uint32_t FrameIndex, FCaptureTAASweepFrame& OutFrame)
+	{
+		return LoadCaptureTAASweepFrame(Reader, FrameIndex, ReferenceLayer, OutFrame);
+	}, Results);
+	const double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	if (!bSwept)
+	{
+		fprintf(stderr, "%s has no frames with an input layer\n", Options.InputPath.c_str());
+		return 1;
+	}
+
+	FILE* Csv = nullptr;
+	if (!Options.CsvPath.empty())
+	{
+		Csv = fopen(Options.CsvPath.c_str(), "w");
+		if (!Csv)
+		{
+			fprintf(stderr, "cannot create %s\n", Options.CsvPath.c_str());
+			return 1;
+		}
+		fprintf(Csv, "setting,frames,compared,mean_error,mean_psnr_db,mean_change,ms_per_frame\n");
+	}
+
+	printf("  %-10s %-9s %-9s %-9s  setting\n", "error", "psnr dB", "change", "ms/frame");
+	for (size_t Index = 0; Index < Configs.size(); Index++)
+	{
+		const FCaptureTAASweepResult& Result = Results[Index];
+		const double Milliseconds = Result.NumResolved ? Result.ResolveSeconds * 1e3 / Result.NumResolved : 0.0;
+		if (Result.NumCompared)
+		{
+			printf("  %-10.5f %-9.2f %-9.5f %-9.1f  %s\n", Result.MeanError, Result.MeanPsnr, Result.MeanChange, Milliseconds, Configs[Index].Name.c_str());
+		}
+		else
+		{
+			printf("  %-10s %-9s %-9.5f %-9.1f  %s\n", "-", "-", Result.MeanChange, Milliseconds, Configs[Index].Name.c_str());
+		}
+		if (Csv)
+		{
+			fprintf(Csv, "%s,%u,%u,%.6f,%.3f,%.6f,%.3f\n", Configs[Index].Name.c_str(), Result.NumResolved, Result.NumCompared, Result.MeanError,
+				Result.MeanPsnr, Result.MeanChange, Milliseconds);
+		}
+	}
+	if (Csv && fclose(Csv) != 0)
+	{
+		fprintf(stderr, "cannot write %s\n", Options.CsvPath.c_str());
+		return 1;
+	}
+
+	const uint32_t NumResolved = Results.empty() ? 0 : Results[0].NumResolved;
+	printf("%zu settings x %u frames in %.1f s, %.1f setting frames per second\n", Configs.size(), NumResolved, Seconds,
+		Seconds > 0.0 ? double(Configs.size() * NumResolved) / Seconds : 0.0);
+	return 0;
+}
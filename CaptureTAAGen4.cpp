@@ -0,0 +1,582 @@
+#include "CaptureTAAGen4.h"
+
+#include "CaptureReader.h"
+#include "CaptureSimd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+constexpr int32_t TileSize = 8;
+
+/** SampleOffsets of SetupSampleWeightParameters(), the plus samples are 1, 3, 4, 5 and 7. */
+constexpr int32_t SampleOffsets[9][2] =
+{
+	{ -1, -1 }, { 0, -1 }, { 1, -1 },
+	{ -1,  0 }, { 0,  0 }, { 1,  0 },
+	{ -1,  1 }, { 0,  1 }, { 1,  1 },
+};
+constexpr int32_t PlusSamples[5] = { 1, 3, 4, 5, 7 };
+
+/** Where the closest depth is looked for: the pixel itself and its diagonals. */
+constexpr int32_t VelocityOffsets[4][2] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+
+/** DecodeVelocityFromTexture() of 4.26, in its MAD form. */
+constexpr float VelocityScale = 1.0f / (0.499f * 0.5f);
+constexpr float VelocityBias = 32767.0f / 65535.0f * VelocityScale;
+
+/** Everything a span needs, set up once per frame. */
+struct FResolveContext
+{
+	const float* Color[3] = {};
+
+	/** Y, Co, Cg and HDR weight of every input pixel, like the neighborhood cache the shader keeps in LDS. */
+	float* Neighborhood[4] = {};
+	const float* Depth = nullptr;
+	const float* Velocity[2] = {};
+	int32_t InputWidth = 0;
+	int32_t InputHeight = 0;
+
+	const float* History[3] = {};
+	int32_t HistoryWidth = 0;
+	int32_t HistoryHeight = 0;
+
+	float* Output[3] = {};
+	int32_t OutputWidth = 0;
+	int32_t OutputHeight = 0;
+
+	bool bUpsampling = false;
+	bool bUpsampleFiltered = true;
+	bool bFast = false;
+	bool bCameraCut = false;
+
+	float SampleWeights[9] = {};
+	float PlusWeights[5] = {};
+	float JitterX = 0.0f;
+	float JitterY = 0.0f;
+	float UpscaleFactor = 1.0f;
+
+	float CurrentFrameWeight = 0.04f;
+	float ExposureScale = 1.0f;
+	float HistoryPreExposureCorrection = 1.0f;
+	float ScreenPosAbsMax[2] = {};
+	float HistoryBufferUVMinMax[4] = {};
+	const float* ClipToPrevClip = nullptr;
+
+	int32_t MantissaBits[3] = {};
+	float MaxValue[3] = {};
+};
+
+template <typename V>
+struct TColor
+{
+	V Y, Co, Cg;
+};
+
+template <typename V>
+TColor<V> RGBToYCoCg(V R, V G, V B)
+{
+	const V Quarter = V::Splat(0.25f);
+	const V Half = V::Splat(0.5f);
+	return { R * Quarter + G * Half + B * Quarter, R * Half - B * Half, G * Half - R * Quarter - B * Quarter };
+}
+
+/** Fills the neighborhood cache for V::Lanes input pixels from (X, Y). */
+template <typename V>
+void CacheNeighborhoodSpan(const FResolveContext& C, int32_t X, int32_t Y)
+{
+	using I = typename V::FInt;
+
+	const I Index = I::Splat(Y * C.InputWidth) + Min(I::Splat(X) + I::Ramp(), I::Splat(C.InputWidth - 1));
+	const TColor<V> Color = RGBToYCoCg(GatherNear(C.Color[0], Index), GatherNear(C.Color[1], Index), GatherNear(C.Color[2], Index));
+	const V HdrWeight = V::Splat(1.0f) / (Color.Y * V::Splat(C.ExposureScale) + V::Splat(4.0f));
+
+	const size_t Offset = size_t(Y) * C.InputWidth + X;
+	const int32_t Count = std::min(V::Lanes, C.InputWidth - X);
+	Color.Y.StorePartial(C.Neighborhood[0] + Offset, Count);
+	Color.Co.StorePartial(C.Neighborhood[1] + Offset, Count);
+	Color.Cg.StorePartial(C.Neighborhood[2] + Offset, Count);
+	HdrWeight.StorePartial(C.Neighborhood[3] + Offset, Count);
+}
+
+template <typename V>
+void CacheNeighborhoodRow(const FResolveContext& C, int32_t Y)
+{
+	for (int32_t X = 0; X < C.InputWidth; X += V::Lanes)
+	{
+		CacheNeighborhoodSpan<V>(C, X, Y);
+	}
+}
+
+/** Bilinear fetch of the history at a position in texels, integers at texel centers, clamped to the buffer. */
+template <typename V>
+TColor<V> SampleHistoryBilinear(const FResolveContext& C, V PX, V PY)
+{
+	using I = typename V::FInt;
+
+	const V FloorX = Floor(PX);
+	const V FloorY = Floor(PY);
+	const V FracX = PX - FloorX;
+	const V FracY = PY - FloorY;
+	const I Zero = I::Splat(0);
+	const I MaxX = I::Splat(C.HistoryWidth - 1);
+	const I MaxY = I::Splat(C.HistoryHeight - 1);
+	const I X0 = Clamp(ToInt(FloorX), Zero, MaxX);
+	const I X1 = Clamp(ToInt(FloorX) + I::Splat(1), Zero, MaxX);
+	const I Row0 = Clamp(ToInt(FloorY), Zero, MaxY) * I::Splat(C.HistoryWidth);
+	const I Row1 = Clamp(ToInt(FloorY) + I::Splat(1), Zero, MaxY) * I::Splat(C.HistoryWidth);
+
+	const V One = V::Splat(1.0f);
+	V Channels[3];
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const float* Plane = C.History[Channel];
+		const V Top = GatherNear(Plane, Row0 + X0) * (One - FracX) + GatherNear(Plane, Row0 + X1) * FracX;
+		const V Bottom = GatherNear(Plane, Row1 + X0) * (One - FracX) + GatherNear(Plane, Row1 + X1) * FracX;
+		Channels[Channel] = Top * (One - FracY) + Bottom * FracY;
+	}
+	return { Channels[0], Channels[1], Channels[2] };
+}
+
+/** Catmull-Rom history fetch in 5 bilinear taps, the corners of the 4x4 footprint dropped and the rest renormalized. */
+template <typename V>
+TColor<V> SampleHistoryCatmullRom(const FResolveContext& C, V PX, V PY)
+{
+	const V FloorX = Floor(PX);
+	const V FloorY = Floor(PY);
+	const V FX = PX - FloorX;
+	const V FY = PY - FloorY;
+
+	const V One = V::Splat(1.0f);
+	const V Half = V::Splat(0.5f);
+	const V W0X = FX * (V::Splat(-0.5f) + FX * (One - Half * FX));
+	const V W1X = One + FX * FX * (V::Splat(-2.5f) + V::Splat(1.5f) * FX);
+	const V W2X = FX * (Half + FX * (V::Splat(2.0f) - V::Splat(1.5f) * FX));
+	const V W3X = FX * FX * (V::Splat(-0.5f) + Half * FX);
+	const V W0Y = FY * (V::Splat(-0.5f) + FY * (One - Half * FY));
+	const V W1Y = One + FY * FY * (V::Splat(-2.5f) + V::Splat(1.5f) * FY);
+	const V W2Y = FY * (Half + FY * (V::Splat(2.0f) - V::Splat(1.5f) * FY));
+	const V W3Y = FY * FY * (V::Splat(-0.5f) + Half * FY);
+
+	const V W12X = W1X + W2X;
+	const V W12Y = W1Y + W2Y;
+	const V CenterX = FloorX + W2X / W12X;
+	const V CenterY = FloorY + W2Y / W12Y;
+
+	const V Weights[5] = { W12X * W12Y, W0X * W12Y, W3X * W12Y, W12X * W0Y, W12X * W3Y };
+	const TColor<V> Taps[5] =
+	{
+		SampleHistoryBilinear(C, CenterX, CenterY),
+		SampleHistoryBilinear(C, FloorX - One, CenterY),
+		SampleHistoryBilinear(C, FloorX + V::Splat(2.0f), CenterY),
+		SampleHistoryBilinear(C, CenterX, FloorY - One),
+		SampleHistoryBilinear(C, CenterX, FloorY + V::Splat(2.0f)),
+	};
+
+	TColor<V> Sum = { V::Splat(0.0f), V::Splat(0.0f), V::Splat(0.0f) };
+	V WeightSum = V::Splat(0.0f);
+	for (int32_t Tap = 0; Tap < 5; Tap++)
+	{
+		Sum.Y = Sum.Y + Taps[Tap].Y * Weights[Tap];
+		Sum.Co = Sum.Co + Taps[Tap].Co * Weights[Tap];
+		Sum.Cg = Sum.Cg + Taps[Tap].Cg * Weights[Tap];
+		WeightSum = WeightSum + Weights[Tap];
+	}
+	const V InvWeightSum = One / WeightSum;
+	return { Sum.Y * InvWeightSum, Sum.Co * InvWeightSum, Sum.Cg * InvWeightSum };
+}
+
+/** Resolves V::Lanes output pixels from (X, Y); lanes past the right edge repeat the last pixel and are not stored. */
+template <typename V>
+void ResolveSpan(const FResolveContext& C, int32_t X, int32_t Y)
+{
+	using I = typename V::FInt;
+
+	const V Zero = V::Splat(0.0f);
+	const V One = V::Splat(1.0f);
+	const V Half = V::Splat(0.5f);
+
+	const I PixelX = Min(I::Splat(X) + I::Ramp(), I::Splat(C.OutputWidth - 1));
+	const V ViewportU = (ToFloat(PixelX) + Half) / V::Splat(float(C.OutputWidth));
+	const V ViewportV = V::Splat((float(Y) + 0.5f) / float(C.OutputHeight));
+	const V ScreenPosX = ViewportU * V::Splat(2.0f) - One;
+	const V ScreenPosY = One - ViewportV * V::Splat(2.0f);
+
+	// Input pixel of the output pixel, and for upsampling the offset of the output pixel from its center.
+	I InputX = PixelX;
+	I InputY = I::Splat(Y);
+	V KernelX = Zero;
+	V KernelY = Zero;
+	if (C.bUpsampling)
+	{
+		const V PPCoX = ViewportU * V::Splat(float(C.InputWidth)) + V::Splat(C.JitterX);
+		const V PPCoY = ViewportV * V::Splat(float(C.InputHeight)) + V::Splat(C.JitterY);
+		const V FloorX = Floor(PPCoX);
+		const V FloorY = Floor(PPCoY);
+		KernelX = PPCoX - (FloorX + Half);
+		KernelY = PPCoY - (FloorY + Half);
+		InputX = ToInt(FloorX);
+		InputY = ToInt(FloorY);
+	}
+
+	// Neighborhood: HDR weighted filter, plus shaped color box.
+	const V Exposure = V::Splat(C.ExposureScale);
+	const V Four = V::Splat(4.0f);
+	const I MaxInputX = I::Splat(C.InputWidth - 1);
+	const I MaxInputY = I::Splat(C.InputHeight - 1);
+
+	TColor<V> Filtered = { Zero, Zero, Zero };
+	V FilteredWeight = Zero;
+	TColor<V> Center = { Zero, Zero, Zero };
+	TColor<V> NeighborMin = { V::Splat(INFINITY), V::Splat(INFINITY), V::Splat(INFINITY) };
+	TColor<V> NeighborMax = { V::Splat(-INFINITY), V::Splat(-INFINITY), V::Splat(-INFINITY) };
+
+	for (int32_t Sample = 0; Sample < 9; Sample++)
+	{
+		const bool bPlus = (Sample & 1) || Sample == 4;
+		if (C.bFast && !bPlus)
+		{
+			continue;
+		}
+
+		const I SampleX = Clamp(InputX + I::Splat(SampleOffsets[Sample][0]), I::Splat(0), MaxInputX);
+		const I SampleY = Clamp(InputY + I::Splat(SampleOffsets[Sample][1]), I::Splat(0), MaxInputY);
+		const I Index = SampleY * I::Splat(C.InputWidth) + SampleX;
+		const TColor<V> Color = { GatherNear(C.Neighborhood[0], Index), GatherNear(C.Neighborhood[1], Index), GatherNear(C.Neighborhood[2], Index) };
+
+		V SpatialWeight;
+		if (C.bUpsampling)
+		{
+			// Blackman-Harris approximation over the distance in output pixels.
+			const V DX = V::Splat(float(SampleOffsets[Sample][0])) - KernelX;
+			const V DY = V::Splat(float(SampleOffsets[Sample][1])) - KernelY;
+			const V X2 = Min(V::Splat(C.UpscaleFactor * C.UpscaleFactor) * (DX * DX + DY * DY), One);
+			SpatialWeight = (V::Splat(0.905f) * X2 - V::Splat(1.9f)) * X2 + One;
+		}
+		else if (C.bFast)
+		{
+			SpatialWeight = V::Splat(C.PlusWeights[std::find(PlusSamples, PlusSamples + 5, Sample) - PlusSamples]);
+		}
+		else
+		{
+			SpatialWeight = V::Splat(C.SampleWeights[Sample]);
+		}
+
+		const V Weight = SpatialWeight * GatherNear(C.Neighborhood[3], Index);
+		Filtered.Y = Filtered.Y + Color.Y * Weight;
+		Filtered.Co = Filtered.Co + Color.Co * Weight;
+		Filtered.Cg = Filtered.Cg + Color.Cg * Weight;
+		FilteredWeight = FilteredWeight + Weight;
+
+		if (bPlus)
+		{
+			NeighborMin = { Min(NeighborMin.Y, Color.Y), Min(NeighborMin.Co, Color.Co), Min(NeighborMin.Cg, Color.Cg) };
+			NeighborMax = { Max(NeighborMax.Y, Color.Y), Max(NeighborMax.Co, Color.Co), Max(NeighborMax.Cg, Color.Cg) };
+		}
+		if (Sample == 4)
+		{
+			Center = Color;
+		}
+	}
+
+	const V InvFilteredWeight = One / FilteredWeight;
+	Filtered = { Filtered.Y * InvFilteredWeight, Filtered.Co * InvFilteredWeight, Filtered.Cg * InvFilteredWeight };
+	if (C.bUpsampling && !C.bUpsampleFiltered)
+	{
+		Filtered = Center;
+	}
+
+	TColor<V> Result = Filtered;
+	if (!C.bCameraCut)
+	{
+		// Velocity of the closest depth around the pixel.
+		const I CenterIndex = Clamp(InputY, I::Splat(0), MaxInputY) * I::Splat(C.InputWidth) + Clamp(InputX, I::Splat(0), MaxInputX);
+		I VelocityIndex = CenterIndex;
+		V DeviceZ = Zero;
+		if (C.Depth)
+		{
+			DeviceZ = GatherNear(C.Depth, CenterIndex);
+			for (const int32_t* Offset : VelocityOffsets)
+			{
+				const I SampleX = Clamp(InputX + I::Splat(Offset[0]), I::Splat(0), MaxInputX);
+				const I SampleY = Clamp(InputY + I::Splat(Offset[1]), I::Splat(0), MaxInputY);
+				const I Index = SampleY * I::Splat(C.InputWidth) + SampleX;
+				const V SampleZ = GatherNear(C.Depth, Index);
+				const typename V::FMask bCloser = SampleZ > DeviceZ;
+				DeviceZ = Select(bCloser, SampleZ, DeviceZ);
+				VelocityIndex = Select(bCloser, Index, VelocityIndex);
+			}
+		}
+
+		V VelocityX = Zero;
+		V VelocityY = Zero;
+		if (C.ClipToPrevClip)
+		{
+			const float* M = C.ClipToPrevClip;
+			const V PrevX = ScreenPosX * V::Splat(M[0]) + ScreenPosY * V::Splat(M[4]) + DeviceZ * V::Splat(M[8]) + V::Splat(M[12]);
+			const V PrevY = ScreenPosX * V::Splat(M[1]) + ScreenPosY * V::Splat(M[5]) + DeviceZ * V::Splat(M[9]) + V::Splat(M[13]);
+			const V PrevW = ScreenPosX * V::Splat(M[3]) + ScreenPosY * V::Splat(M[7]) + DeviceZ * V::Splat(M[11]) + V::Splat(M[15]);
+			VelocityX = ScreenPosX - PrevX / PrevW;
+			VelocityY = ScreenPosY - PrevY / PrevW;
+		}
+		if (C.Velocity[0])
+		{
+			const V EncodedX = GatherNear(C.Velocity[0], VelocityIndex);
+			const V EncodedY = GatherNear(C.Velocity[1], VelocityIndex);
+			const typename V::FMask bHasVelocity = EncodedX > Zero;
+			VelocityX = Select(bHasVelocity, EncodedX * V::Splat(VelocityScale) - V::Splat(VelocityBias), VelocityX);
+			VelocityY = Select(bHasVelocity, EncodedY * V::Splat(VelocityScale) - V::Splat(VelocityBias), VelocityY);
+		}
+
+		// History.
+		V HistoryScreenX = ScreenPosX - VelocityX;
+		V HistoryScreenY = ScreenPosY - VelocityY;
+		const typename V::FMask bOffScreen = Max(Abs(HistoryScreenX), Abs(HistoryScreenY)) >= One;
+		HistoryScreenX = Clamp(HistoryScreenX, V::Splat(-C.ScreenPosAbsMax[0]), V::Splat(C.ScreenPosAbsMax[0]));
+		HistoryScreenY = Clamp(HistoryScreenY, V::Splat(-C.ScreenPosAbsMax[1]), V::Splat(C.ScreenPosAbsMax[1]));
+		const V HistoryU = Clamp(HistoryScreenX * Half + Half, V::Splat(C.HistoryBufferUVMinMax[0]), V::Splat(C.HistoryBufferUVMinMax[2]));
+		const V HistoryV = Clamp(Half - HistoryScreenY * Half, V::Splat(C.HistoryBufferUVMinMax[1]), V::Splat(C.HistoryBufferUVMinMax[3]));
+		const V HistoryPX = HistoryU * V::Splat(float(C.HistoryWidth)) - Half;
+		const V HistoryPY = HistoryV * V::Splat(float(C.HistoryHeight)) - Half;
+
+		const TColor<V> HistoryRGB = C.bFast ? SampleHistoryBilinear(C, HistoryPX, HistoryPY) : SampleHistoryCatmullRom(C, HistoryPX, HistoryPY);
+		const V PreExposureCorrection = V::Splat(C.HistoryPreExposureCorrection);
+		TColor<V> History = RGBToYCoCg(HistoryRGB.Y * PreExposureCorrection, HistoryRGB.Co * PreExposureCorrection, HistoryRGB.Cg * PreExposureCorrection);
+
+		// Clip the history towards the filtered color where it leaves the neighborhood's box.
+		{
+			const V MinRayDir = V::Splat(1.0f / 65536.0f);
+			const V RayY = Filtered.Y - History.Y;
+			const V RayCo = Filtered.Co - History.Co;
+			const V RayCg = Filtered.Cg - History.Cg;
+			const V InvRayY = One / Select(Abs(RayY) < MinRayDir, MinRayDir, RayY);
+			const V InvRayCo = One / Select(Abs(RayCo) < MinRayDir, MinRayDir, RayCo);
+			const V InvRayCg = One / Select(Abs(RayCg) < MinRayDir, MinRayDir, RayCg);
+			const V EnterY = Min((NeighborMin.Y - History.Y) * InvRayY, (NeighborMax.Y - History.Y) * InvRayY);
+			const V EnterCo = Min((NeighborMin.Co - History.Co) * InvRayCo, (NeighborMax.Co - History.Co) * InvRayCo);
+			const V EnterCg = Min((NeighborMin.Cg - History.Cg) * InvRayCg, (NeighborMax.Cg - History.Cg) * InvRayCg);
+			const V ClipBlend = Clamp(Max(Max(EnterY, EnterCo), EnterCg), Zero, One);
+			History = { History.Y + RayY * ClipBlend, History.Co + RayCo * ClipBlend, History.Cg + RayCg * ClipBlend };
+		}
+
+		// Blend factor of the current frame.
+		const V OutputVelocityX = VelocityX * V::Splat(0.5f * float(C.OutputWidth));
+		const V OutputVelocityY = VelocityY * V::Splat(0.5f * float(C.OutputHeight));
+		const V OutputVelocity = Sqrt(OutputVelocityX * OutputVelocityX + OutputVelocityY * OutputVelocityY);
+		V BlendFinal = V::Splat(C.CurrentFrameWeight);
+		BlendFinal = BlendFinal + (V::Splat(0.2f) - BlendFinal) * Clamp(OutputVelocity / V::Splat(40.0f), Zero, One);
+		BlendFinal = Max(BlendFinal, Clamp(V::Splat(0.01f) * History.Y / Abs(Filtered.Y - History.Y), Zero, One));
+		BlendFinal = Select(bOffScreen, One, BlendFinal);
+
+		// Lerp of the HDR weighted colors.
+		const V FilteredHdrWeight = One / (Filtered.Y * Exposure + Four);
+		const V HistoryHdrWeight = One / (History.Y * Exposure + Four);
+		V HistoryBlend = (One - BlendFinal) * HistoryHdrWeight;
+		V FilteredBlend = BlendFinal * FilteredHdrWeight;
+		const V InvBlendSum = One / (HistoryBlend + FilteredBlend);
+		HistoryBlend = HistoryBlend * InvBlendSum;
+		FilteredBlend = FilteredBlend * InvBlendSum;
+		Result =
+		{
+			History.Y * HistoryBlend + Filtered.Y * FilteredBlend,
+			History.Co * HistoryBlend + Filtered.Co * FilteredBlend,
+			History.Cg * HistoryBlend + Filtered.Cg * FilteredBlend,
+		};
+	}
+
+	// Back to RGB; Max() with zero second also turns NaN into zero.
+	const V RGB[3] =
+	{
+		Result.Y + Result.Co - Result.Cg,
+		Result.Y + Result.Cg,
+		Result.Y - Result.Co - Result.Cg,
+	};
+	const int32_t Count = std::min(V::Lanes, C.OutputWidth - X);
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const V Value = QuantizeCaptureFloat(Max(RGB[Channel], Zero), C.MantissaBits[Channel], C.MaxValue[Channel]);
+		Value.StorePartial(C.Output[Channel] + size_t(Y) * C.OutputWidth + X, Count);
+	}
+}
+
+template <typename V>
+void ResolveTile(const FResolveContext& C, int32_t TileX, int32_t TileY)
+{
+	const int32_t MinX = TileX * TileSize;
+	const int32_t MaxX = std::min(MinX + TileSize, C.OutputWidth);
+	const int32_t MaxY = std::min((TileY + 1) * TileSize, C.OutputHeight);
+	for (int32_t Y = TileY * TileSize; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X += V::Lanes)
+		{
+			ResolveSpan<V>(C, X, Y);
+		}
+	}
+}
+
+} //! namespace
+
+bool LoadCaptureTAAGen4Frame(const FCaptureReader& Reader, uint32_t FrameIndex, FCaptureTAAGen4FrameImages& Images, FCaptureTAAGen4Frame& OutFrame,
+	std::vector<uint8_t>& DecodeBuffer)
+{
+	OutFrame = FCaptureTAAGen4Frame();
+	if (!LoadCaptureImage(Reader, FrameIndex, "input", "rgb", Images.Color, DecodeBuffer))
+	{
+		return false;
+	}
+	OutFrame.Color = &Images.Color;
+
+	FCaptureView DepthView;
+	if (Reader.GetView(FrameIndex, "depth", "depth", DepthView, &DecodeBuffer) && ConvertCaptureView(DepthView, Images.Depth))
+	{
+		if (DepthView.PixelFormat == CapturePF_R32_FLOAT)
+		{
+			float* Plane = Images.Depth.GetPlane(0);
+			for (size_t Pixel = 0; Pixel < Images.Depth.GetPlaneSize(); Pixel++)
+			{
+				Plane[Pixel] = Plane[Pixel] > 0.0f ? 1.0f / Plane[Pixel] : 0.0f;
+			}
+		}
+		OutFrame.Depth = &Images.Depth;
+	}
+	if (LoadCaptureImage(Reader, FrameIndex, "velocity", nullptr, Images.Velocity, DecodeBuffer))
+	{
+		OutFrame.Velocity = &Images.Velocity;
+	}
+
+	if (const FCaptureFrameInfo* Info = Reader.GetContainer().FindFrame(Reader.GetFrameId(FrameIndex)))
+	{
+		OutFrame.JitterX = Info->JitterX;
+		OutFrame.JitterY = Info->JitterY;
+		OutFrame.PreExposure = Info->PreExposure > 0.0f ? Info->PreExposure : 1.0f;
+		OutFrame.bCameraCut = (Info->Flags & CaptureFrame_CameraCut) != 0;
+	}
+	return true;
+}
+
+FCaptureTAAGen4::FCaptureTAAGen4(const FCaptureTAAGen4Settings& InSettings)
+	: Settings(InSettings)
+	, Pool(new FCaptureParallelPool(InSettings.NumThreads))
+{
+	if (Settings.bWeightTable)
+	{
+		WeightTable.reset(new FCaptureFilterWeightTable(Settings.FilterKernel, Settings.FilterSize, Settings.FilterSize, 1));
+	}
+}
+
+void FCaptureTAAGen4::Reset()
+{
+	bHasHistory = false;
+}
+
+void FCaptureTAAGen4::Resolve(const FCaptureTAAGen4Frame& Frame, int32_t OutputWidth, int32_t OutputHeight, FCaptureImage& Output)
+{
+	const FCaptureImage& Color = *Frame.Color;
+	Output.Resize(OutputWidth, OutputHeight, 3);
+
+	FResolveContext C;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		C.Color[Channel] = Color.GetPlane(std::min(Channel, Color.NumChannels - 1));
+		C.Output[Channel] = Output.GetPlane(Channel);
+	}
+	C.InputWidth = Color.Width;
+	C.InputHeight = Color.Height;
+	if (Frame.Depth && Frame.Depth->Width == Color.Width && Frame.Depth->Height == Color.Height)
+	{
+		C.Depth = Frame.Depth->GetPlane(0);
+	}
+	if (Frame.Velocity && Frame.Velocity->NumChannels >= 2 && Frame.Velocity->Width == Color.Width && Frame.Velocity->Height == Color.Height)
+	{
+		C.Velocity[0] = Frame.Velocity->GetPlane(0);
+		C.Velocity[1] = Frame.Velocity->GetPlane(1);
+	}
+	C.OutputWidth = OutputWidth;
+	C.OutputHeight = OutputHeight;
+
+	C.bUpsampling = OutputWidth != Color.Width || OutputHeight != Color.Height;
+	C.bUpsampleFiltered = Settings.bUpsampleFiltered;
+	C.bFast = Settings.bFast;
+	C.bCameraCut = Frame.bCameraCut || !bHasHistory || History.Width != OutputWidth || History.Height != OutputHeight;
+
+	if (!C.bUpsampling)
+	{
+		if (WeightTable)
+		{
+			WeightTable->Lookup(Frame.JitterX, Frame.JitterY, Settings.FilterSize, C.SampleWeights, C.PlusWeights);
+		}
+		else
+		{
+			ComputeCaptureFilterWeights(Settings.FilterKernel, Frame.JitterX, Frame.JitterY, Settings.FilterSize, C.SampleWeights, C.PlusWeights);
+		}
+	}
+	C.JitterX = Frame.JitterX;
+	C.JitterY = Frame.JitterY;
+	C.UpscaleFactor = float(OutputWidth) / float(Color.Width);
+
+	C.CurrentFrameWeight = Settings.CurrentFrameWeight;
+	C.ExposureScale = Settings.ExposureScale;
+	C.ClipToPrevClip = Frame.ClipToPrevClip;
+	if (!C.bCameraCut)
+	{
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			C.History[Channel] = History.GetPlane(Channel);
+		}
+		C.HistoryWidth = History.Width;
+		C.HistoryHeight = History.Height;
+		C.HistoryPreExposureCorrection = Frame.PreExposure / HistoryPreExposure;
+		C.ScreenPosAbsMax[0] = 1.0f - 1.0f / float(History.Width);
+		C.ScreenPosAbsMax[1] = 1.0f - 1.0f / float(History.Height);
+		C.HistoryBufferUVMinMax[0] = 0.5f / float(History.Width);
+		C.HistoryBufferUVMinMax[1] = 0.5f / float(History.Height);
+		C.HistoryBufferUVMinMax[2] = (float(History.Width) - 0.5f) / float(History.Width);
+		C.HistoryBufferUVMinMax[3] = (float(History.Height) - 0.5f) / float(History.Height);
+	}
+
+	// FloatRGBA, or FloatR11G11B10 (6, 6 and 5 bits of mantissa) under the same conditions as AddTemporalAAPass().
+	const bool bR11G11B10 = Settings.bR11G11B10History && Settings.bFast;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		C.MantissaBits[Channel] = bR11G11B10 ? (Channel == 2 ? 5 : 6) : 10;
+		C.MaxValue[Channel] = bR11G11B10 ? (Channel == 2 ? 64512.0f : 65024.0f) : 65504.0f;
+	}
+
+	const int32_t NumTilesX = (OutputWidth + TileSize - 1) / TileSize;
+	const int32_t NumTilesY = (OutputHeight + TileSize - 1) / TileSize;
+	const bool bScalar = Settings.bScalar;
+	Neighborhood.Resize(Color.Width, Color.Height, 4);
+	for (int32_t Channel = 0; Channel < 4; Channel++)
+	{
+		C.Neighborhood[Channel] = Neighborhood.GetPlane(Channel);
+	}
+	Pool->ParallelFor(uint32_t(Color.Height), [&](uint32_t Row)
+	{
+		if (bScalar)
+		{
+			CacheNeighborhoodRow<FCaptureFloat1>(C, int32_t(Row));
+		}
+		else
+		{
+			CacheNeighborhoodRow<FCaptureFloat8>(C, int32_t(Row));
+		}
+	});
+	Pool->ParallelFor(uint32_t(NumTilesX * NumTilesY), [&](uint32_t Tile)
+	{
+		if (bScalar)
+		{
+			ResolveTile<FCaptureFloat1>(C, int32_t(Tile) % NumTilesX, int32_t(Tile) / NumTilesX);
+		}
+		else
+		{
+			ResolveTile<FCaptureFloat8>(C, int32_t(Tile) % NumTilesX, int32_t(Tile) / NumTilesX);
+		}
+	});
+
+	History.Resize(OutputWidth, OutputHeight, 3);
+	std::copy(Output.Data.begin(), Output.Data.begin() + Output.GetPlaneSize() * 3, History.Data.begin());
+	HistoryPreExposure = Frame.PreExposure;
+	bHasHistory = true;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "CaptureFilterKernels.h"
+#include "CaptureImage.h"
+#include "CaptureParallel.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class FCaptureReader;
+
+/**
+ * CPU reference of the Gen4 temporal AA resolve, FTAAStandaloneCS of TAA.cpp in its Main and MainUpsampling
+ * configurations, for replaying captured sequences offline and comparing its settings against the frames the
+ * engine produced.
+ *
+ * The resolve of an output pixel follows TAAStandalone.usf: a 3x3 (plus shaped when fast) neighborhood of the input
+ * in YCoCg, filtered with SampleWeights / PlusWeights looked up like SetupSampleWeightParameters() (Main) or
+ * with per pixel Blackman-Harris weights of the jittered distance (MainUpsampling), each sample weighted by
+ * 1 / (4 + luma) against fireflies. The velocity is taken at the closest depth of an X shaped neighborhood, the
+ * history is fetched with a 5 tap Catmull-Rom (bilinear when fast), scaled by the pre-exposure ratio and clipped
+ * towards the filtered color inside the plus neighborhood's box. The blend starts at CurrentFrameWeight, goes to
+ * 0.2 with motion and up when history and current agree (anti-flicker), and is done on HDR weighted colors. A
+ * camera cut or a history position off screen outputs the filtered color. The result is rounded to the history
+ * format, FloatRGBA, or FloatR11G11B10 when R11G11B10History applies, and is both the output and the next history.
+ *
+ * Images are planar float (CaptureImage.h). The input is first converted to YCoCg and HDR weight planes once per
+ * pixel, the CPU side of the shader's neighborhood cache. The output is split into 8x8 tiles like the compute
+ * dispatch and tiles are spread over an FCaptureParallelPool. Each tile row runs as eight AVX2 lanes (CaptureSimd.h) or, with
+ * bScalar, one pixel at a time through the same template: both give the same bits.
+ */
+
+/** The r.TemporalAA* settings the resolve depends on, defaults as in TAA.cpp. */
+struct FCaptureTAAGen4Settings
+{
+	/** r.TemporalAACurrentFrameWeight. */
+	float CurrentFrameWeight = 0.04f;
+
+	/** r.TemporalAAFilterSize, Main only like SetupSampleWeightParameters(). */
+	float FilterSize = 1.0f;
+
+	/** r.TemporalAAFilterKernel, or CatmullRom for r.TemporalAACatmullRom. Main only. */
+	ECaptureFilterKernel FilterKernel = ECaptureFilterKernel::Gaussian;
+
+	/**
+	 * Main looks its weights up in an FCaptureFilterWeightTable like TAA.cpp, rather than evaluating the kernel at
+	 * the jitter of every frame like 4.26 did.
+	 */
+	bool bWeightTable = true;
+
+	/** r.TemporalAAUpsampleFiltered: MainUpsampling filters the input, or takes its nearest sample when off. */
+	bool bUpsampleFiltered = true;
+
+	/** r.TemporalAA.R11G11B10History, which TAA.cpp only honors for fast main passes. */
+	bool bR11G11B10History = false;
+
+	/** TAA_FAST: the 5 sample plus neighborhood with PlusWeights and a bilinear history fetch. */
+	bool bFast = false;
+
+	/** Eye adaptation exposure of the HDR sample weights, 1 when the capture has none. */
+	float ExposureScale = 1.0f;
+
+	/** Worker threads including the caller, 0 for one per hardware thread. */
+	uint32_t NumThreads = 0;
+
+	/** One pixel at a time instead of eight lanes, for checking the SIMD path. */
+	bool bScalar = false;
+};
+
+/** One frame of input, all images at the input view size. */
+struct FCaptureTAAGen4Frame
+{
+	/** Scene color, at least three channels of linear RGB. */
+	const FCaptureImage* Color = nullptr;
+
+	/** Device Z, reversed (near is 1). Optional: without it the velocity is read at the pixel itself. */
+	const FCaptureImage* Depth = nullptr;
+
+	/** Encoded G16R16 velocity as [0, 1] pairs, 0 for pixels that move with the camera. Optional. */
+	const FCaptureImage* Velocity = nullptr;
+
+	/** View.TemporalJitterPixels, in input pixels. */
+	float JitterX = 0.0f;
+	float JitterY = 0.0f;
+
+	float PreExposure = 1.0f;
+	bool bCameraCut = false;
+
+	/**
+	 * Row major ClipToPrevClip of the view for the pixels without velocity, applied to (ScreenPos, DeviceZ, 1).
+	 * Null when the capture has no matrices: those pixels are then taken as static on screen.
+	 */
+	const float* ClipToPrevClip = nullptr;
+};
+
+/** Decoded layers of a captured frame that an FCaptureTAAGen4Frame points to, reused from frame to frame. */
+struct FCaptureTAAGen4FrameImages
+{
+	FCaptureImage Color;
+	FCaptureImage Depth;
+	FCaptureImage Velocity;
+};
+
+/**
+ * Decodes a captured frame for Resolve(): the "input" rgb, "depth" and "velocity" layers into Images and the jitter,
+ * pre-exposure and camera cut of its frame info into OutFrame. Linear R32 depth is turned into its reciprocal, which
+ * orders like device Z. False when the frame has no input.
+ */
+bool LoadCaptureTAAGen4Frame(const FCaptureReader& Reader, uint32_t FrameIndex, FCaptureTAAGen4FrameImages& Images, FCaptureTAAGen4Frame& OutFrame,
+	std::vector<uint8_t>& DecodeBuffer);
+
+class FCaptureTAAGen4
+{
+public:
+	explicit FCaptureTAAGen4(const FCaptureTAAGen4Settings& InSettings);
+
+	const FCaptureTAAGen4Settings& GetSettings() const { return Settings; }
+
+	/**
+	 * Resolves Frame into Output, OutputWidth x OutputHeight with three channels. An output the size of the input
+	 * runs the Main configuration, a larger one MainUpsampling. History of another size, or none, is a camera cut.
+	 */
+	void Resolve(const FCaptureTAAGen4Frame& Frame, int32_t OutputWidth, int32_t OutputHeight, FCaptureImage& Output);
+
+	/** Drops the history, the next frame starts over as after a camera cut. */
+	void Reset();
+
+	const FCaptureImage& GetHistory() const { return History; }
+
+private:
+	FCaptureTAAGen4Settings Settings;
+	std::unique_ptr<FCaptureParallelPool> Pool;
+	std::unique_ptr<FCaptureFilterWeightTable> WeightTable;
+
+	FCaptureImage Neighborhood;
+	FCaptureImage History;
+	float HistoryPreExposure = 1.0f;
+	bool bHasHistory = false;
+};
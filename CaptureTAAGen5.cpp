@@ -0,0 +1,739 @@
+#include "CaptureTAAGen5.h"
+
+#include "CaptureSimd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+
+constexpr int32_t TileSize = 8;
+
+/** DecodeVelocityFromTexture() of 4.26, in its MAD form, as in CaptureTAAGen4.cpp. */
+constexpr float VelocityScale = 1.0f / (0.499f * 0.5f);
+constexpr float VelocityBias = 32767.0f / 65535.0f * VelocityScale;
+
+/** Scattered weights are counted in 1/256 like the shader's fixed point atomics. */
+constexpr float UseCountScale = 256.0f;
+
+const char* const PassNames[] =
+{
+	"ClearPrevTextures", "DilateVelocity", "DecimateHistory", "FilterFrequencies", "CompareHistory", "DilateRejection", "UpdateHistory",
+	"Downsample",
+};
+static_assert(sizeof(PassNames) / sizeof(PassNames[0]) == size_t(ECaptureTAAGen5Pass::Count), "one name per pass");
+
+float QuantizeFloat(float Value, int32_t MantissaBits, float MaxValue)
+{
+	return QuantizeCaptureFloat(FCaptureFloat1::Splat(Value), MantissaBits, MaxValue).V;
+}
+
+/** FloatR11G11B10, which has no sign. */
+float QuantizeR11G11B10(float Value, int32_t Channel)
+{
+	return QuantizeFloat(std::max(Value, 0.0f), Channel == 2 ? 5 : 6, Channel == 2 ? 64512.0f : 65024.0f);
+}
+
+float QuantizeUnorm(float Value, float MaxCode)
+{
+	return std::nearbyint(std::min(std::max(Value, 0.0f), 1.0f) * MaxCode) / MaxCode;
+}
+
+/** A velocity through the G16R16 encoding of DilatedVelocity and back. */
+float QuantizeVelocity(float Velocity)
+{
+	return QuantizeUnorm((Velocity + VelocityBias) / VelocityScale, 65535.0f) * VelocityScale - VelocityBias;
+}
+
+/** ECaptureFilterKernel::BlackmanHarris of a squared distance, inlined for the 3x3 of every history pixel. */
+float BlackmanHarris(float Distance2)
+{
+	const float X2 = std::min(Distance2, 1.0f);
+	return (0.905f * X2 - 1.9f) * X2 + 1.0f;
+}
+
+float Saturate(float Value)
+{
+	return std::min(std::max(Value, 0.0f), 1.0f);
+}
+
+/** The four texels around a position in texels, integers at texel centers. */
+struct FBilinearFootprint
+{
+	size_t Index[4];
+	float Weight[4];
+};
+
+/** Clamped to the texture like a sampler, or with the taps outside of it weighing nothing when scattering. */
+FBilinearFootprint GetBilinearFootprint(float PX, float PY, int32_t Width, int32_t Height, bool bClamp)
+{
+	const float FloorX = std::floor(PX);
+	const float FloorY = std::floor(PY);
+	const float FracX = PX - FloorX;
+	const float FracY = PY - FloorY;
+	const int32_t X0 = int32_t(FloorX);
+	const int32_t Y0 = int32_t(FloorY);
+
+	FBilinearFootprint Footprint;
+	for (int32_t Tap = 0; Tap < 4; Tap++)
+	{
+		int32_t X = X0 + (Tap & 1);
+		int32_t Y = Y0 + (Tap >> 1);
+		float Weight = ((Tap & 1) ? FracX : 1.0f - FracX) * ((Tap >> 1) ? FracY : 1.0f - FracY);
+		if (bClamp)
+		{
+			X = std::min(std::max(X, 0), Width - 1);
+			Y = std::min(std::max(Y, 0), Height - 1);
+		}
+		else if (X < 0 || Y < 0 || X >= Width || Y >= Height)
+		{
+			X = 0;
+			Y = 0;
+			Weight = 0.0f;
+		}
+		Footprint.Index[Tap] = size_t(Y) * Width + X;
+		Footprint.Weight[Tap] = Weight;
+	}
+	return Footprint;
+}
+
+float SampleBilinear(const float* Plane, const FBilinearFootprint& Footprint)
+{
+	return Plane[Footprint.Index[0]] * Footprint.Weight[0] + Plane[Footprint.Index[1]] * Footprint.Weight[1]
+		+ Plane[Footprint.Index[2]] * Footprint.Weight[2] + Plane[Footprint.Index[3]] * Footprint.Weight[3];
+}
+
+/** YCoCg of RGB tonemapped by 1 / (1 + luma), where the comparison happens so highlights do not dominate it. */
+void TonemapToYCoCg(const float RGB[3], float Out[3])
+{
+	const float Luma = std::max(0.25f * RGB[0] + 0.5f * RGB[1] + 0.25f * RGB[2], 0.0f);
+	const float Scale = 1.0f / (1.0f + Luma);
+	const float R = RGB[0] * Scale;
+	const float G = RGB[1] * Scale;
+	const float B = RGB[2] * Scale;
+	Out[0] = 0.25f * R + 0.5f * G + 0.25f * B;
+	Out[1] = 0.5f * R - 0.5f * B;
+	Out[2] = -0.25f * R + 0.5f * G - 0.25f * B;
+}
+
+void RGBToYCoCg(const float RGB[3], float Out[3])
+{
+	Out[0] = 0.25f * RGB[0] + 0.5f * RGB[1] + 0.25f * RGB[2];
+	Out[1] = 0.5f * RGB[0] - 0.5f * RGB[2];
+	Out[2] = -0.25f * RGB[0] + 0.5f * RGB[1] - 0.25f * RGB[2];
+}
+
+void YCoCgToRGB(const float YCoCg[3], float Out[3])
+{
+	Out[0] = YCoCg[0] + YCoCg[1] - YCoCg[2];
+	Out[1] = YCoCg[0] + YCoCg[2];
+	Out[2] = YCoCg[0] - YCoCg[1] - YCoCg[2];
+}
+
+/** Everything the passes need, set up once per frame. */
+struct FGen5Context
+{
+	int32_t InputWidth = 0;
+	int32_t InputHeight = 0;
+	const float* Color[3] = {};
+	const float* Depth = nullptr;
+	const float* Velocity[2] = {};
+	const float* ClipToPrevClip = nullptr;
+	float JitterX = 0.0f;
+	float JitterY = 0.0f;
+
+	int32_t RejectionWidth = 0;
+	int32_t RejectionHeight = 0;
+
+	int32_t HistoryWidth = 0;
+	int32_t HistoryHeight = 0;
+	bool bCameraCut = false;
+	float HistoryPreExposureCorrection = 1.0f;
+	const float* PrevLow[3] = {};
+	const float* PrevHigh[3] = {};
+	const float* PrevMetadata[2] = {};
+
+	std::atomic<uint32_t>* PrevUseCount = nullptr;
+	std::atomic<uint32_t>* PrevClosestDepth = nullptr;
+	float* DilatedVelocity[2] = {};
+	float* ClosestDepth = nullptr;
+	float* Prediction[3] = {};
+	float* ParallaxRejectionMask = nullptr;
+	float* FilteredInput[3] = {};
+	float* FilteredPrediction[3] = {};
+	float* HistoryRejection = nullptr;
+	float* DilatedHistoryRejection = nullptr;
+	float* Low[3] = {};
+	float* High[3] = {};
+	float* Metadata[2] = {};
+	float* SceneColor[3] = {};
+
+	float WorldDepthToPixelWorldRadius = 0.0f;
+	float ParallaxDepthError = 3.0f;
+	float MaxSampleCount = 16.0f;
+	float RejectedSampleCount = 2.0f;
+	int32_t HistoryMantissaBits[3] = {};
+	float HistoryMaxValue[3] = {};
+};
+
+/** Previous position of an input pixel in texels of a Width x Height texture, and whether it was on screen. */
+bool GetPrevPixel(const FGen5Context& C, int32_t X, int32_t Y, float VelocityX, float VelocityY, int32_t Width, int32_t Height, float& OutPX, float& OutPY)
+{
+	const float ScreenPosX = (float(X) + 0.5f) / float(C.InputWidth) * 2.0f - 1.0f;
+	const float ScreenPosY = 1.0f - (float(Y) + 0.5f) / float(C.InputHeight) * 2.0f;
+	const float PrevScreenX = ScreenPosX - VelocityX;
+	const float PrevScreenY = ScreenPosY - VelocityY;
+	OutPX = (PrevScreenX * 0.5f + 0.5f) * float(Width) - 0.5f;
+	OutPY = (0.5f - PrevScreenY * 0.5f) * float(Height) - 0.5f;
+	return std::max(std::fabs(PrevScreenX), std::fabs(PrevScreenY)) < 1.0f;
+}
+
+void ClearPrevTexturesTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			const size_t Pixel = size_t(Y) * C.InputWidth + X;
+			C.PrevUseCount[Pixel].store(0, std::memory_order_relaxed);
+			C.PrevClosestDepth[Pixel].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void DilateVelocityTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			// Closest device Z of the 3x3 neighborhood, reversed so the largest.
+			size_t ClosestIndex = size_t(Y) * C.InputWidth + X;
+			float DeviceZ = C.Depth ? C.Depth[ClosestIndex] : 0.0f;
+			for (int32_t OffsetY = -1; C.Depth && OffsetY <= 1; OffsetY++)
+			{
+				for (int32_t OffsetX = -1; OffsetX <= 1; OffsetX++)
+				{
+					const int32_t SampleX = std::min(std::max(X + OffsetX, 0), C.InputWidth - 1);
+					const int32_t SampleY = std::min(std::max(Y + OffsetY, 0), C.InputHeight - 1);
+					const size_t Index = size_t(SampleY) * C.InputWidth + SampleX;
+					if (C.Depth[Index] > DeviceZ)
+					{
+						DeviceZ = C.Depth[Index];
+						ClosestIndex = Index;
+					}
+				}
+			}
+
+			float VelocityX = 0.0f;
+			float VelocityY = 0.0f;
+			if (C.Velocity[0] && C.Velocity[0][ClosestIndex] > 0.0f)
+			{
+				VelocityX = C.Velocity[0][ClosestIndex] * VelocityScale - VelocityBias;
+				VelocityY = C.Velocity[1][ClosestIndex] * VelocityScale - VelocityBias;
+			}
+			else if (C.ClipToPrevClip)
+			{
+				const float* M = C.ClipToPrevClip;
+				const float ScreenPosX = (float(X) + 0.5f) / float(C.InputWidth) * 2.0f - 1.0f;
+				const float ScreenPosY = 1.0f - (float(Y) + 0.5f) / float(C.InputHeight) * 2.0f;
+				const float PrevX = ScreenPosX * M[0] + ScreenPosY * M[4] + DeviceZ * M[8] + M[12];
+				const float PrevY = ScreenPosX * M[1] + ScreenPosY * M[5] + DeviceZ * M[9] + M[13];
+				const float PrevW = ScreenPosX * M[3] + ScreenPosY * M[7] + DeviceZ * M[11] + M[15];
+				VelocityX = ScreenPosX - PrevX / PrevW;
+				VelocityY = ScreenPosY - PrevY / PrevW;
+			}
+			VelocityX = QuantizeVelocity(VelocityX);
+			VelocityY = QuantizeVelocity(VelocityY);
+			DeviceZ = QuantizeFloat(DeviceZ, 10, 65504.0f);
+
+			const size_t Pixel = size_t(Y) * C.InputWidth + X;
+			C.DilatedVelocity[0][Pixel] = VelocityX;
+			C.DilatedVelocity[1][Pixel] = VelocityY;
+			C.ClosestDepth[Pixel] = DeviceZ;
+
+			// Who lands where in the previous frame, and the closest of them.
+			float PrevX, PrevY;
+			GetPrevPixel(C, X, Y, VelocityX, VelocityY, C.InputWidth, C.InputHeight, PrevX, PrevY);
+			const FBilinearFootprint Footprint = GetBilinearFootprint(PrevX, PrevY, C.InputWidth, C.InputHeight, false);
+			uint32_t DepthBits;
+			memcpy(&DepthBits, &DeviceZ, sizeof(DepthBits));
+			for (int32_t Tap = 0; Tap < 4; Tap++)
+			{
+				const uint32_t UseCount = uint32_t(Footprint.Weight[Tap] * UseCountScale + 0.5f);
+				if (UseCount == 0)
+				{
+					continue;
+				}
+				C.PrevUseCount[Footprint.Index[Tap]].fetch_add(UseCount, std::memory_order_relaxed);
+
+				// Positive floats order like their bits.
+				std::atomic<uint32_t>& ClosestBits = C.PrevClosestDepth[Footprint.Index[Tap]];
+				uint32_t Previous = ClosestBits.load(std::memory_order_relaxed);
+				while (DepthBits > Previous && !ClosestBits.compare_exchange_weak(Previous, DepthBits, std::memory_order_relaxed))
+				{
+				}
+			}
+		}
+	}
+}
+
+void DecimateHistoryTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			const size_t Pixel = size_t(Y) * C.InputWidth + X;
+			const float VelocityX = C.DilatedVelocity[0][Pixel];
+			const float VelocityY = C.DilatedVelocity[1][Pixel];
+
+			float Mask = 0.0f;
+			float Prediction[3] = {};
+			float PrevX, PrevY;
+			if (!C.bCameraCut && GetPrevPixel(C, X, Y, VelocityX, VelocityY, C.InputWidth, C.InputHeight, PrevX, PrevY))
+			{
+				// Parallax: the history is of something else where a closer surface of this frame lands too.
+				const float DeviceZ = C.ClosestDepth[Pixel];
+				const float WorldDepth = DeviceZ > 0.0f ? 1.0f / DeviceZ : INFINITY;
+				const float Tolerance = WorldDepth * C.WorldDepthToPixelWorldRadius * C.ParallaxDepthError;
+				const FBilinearFootprint Footprint = GetBilinearFootprint(PrevX, PrevY, C.InputWidth, C.InputHeight, false);
+				float KeptWeight = 0.0f;
+				float TotalWeight = 0.0f;
+				for (int32_t Tap = 0; Tap < 4; Tap++)
+				{
+					if (Footprint.Weight[Tap] <= 0.0f)
+					{
+						continue;
+					}
+					float Keep = 1.0f;
+					if (C.PrevUseCount[Footprint.Index[Tap]].load(std::memory_order_relaxed) > 0)
+					{
+						const uint32_t PrevBits = C.PrevClosestDepth[Footprint.Index[Tap]].load(std::memory_order_relaxed);
+						float PrevDeviceZ;
+						memcpy(&PrevDeviceZ, &PrevBits, sizeof(PrevDeviceZ));
+						const float PrevWorldDepth = PrevDeviceZ > 0.0f ? 1.0f / PrevDeviceZ : INFINITY;
+						const float Delta = WorldDepth - PrevWorldDepth;
+						Keep = std::isfinite(WorldDepth) ? Saturate(2.0f - Delta / std::max(Tolerance, 1e-20f)) : 1.0f;
+					}
+					KeptWeight += Keep * Footprint.Weight[Tap];
+					TotalWeight += Footprint.Weight[Tap];
+				}
+				Mask = TotalWeight > 0.0f ? KeptWeight / TotalWeight : 1.0f;
+
+				float HistoryX, HistoryY;
+				GetPrevPixel(C, X, Y, VelocityX, VelocityY, C.HistoryWidth, C.HistoryHeight, HistoryX, HistoryY);
+				const FBilinearFootprint HistoryFootprint = GetBilinearFootprint(HistoryX, HistoryY, C.HistoryWidth, C.HistoryHeight, true);
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Prediction[Channel] = SampleBilinear(C.PrevLow[Channel], HistoryFootprint) * C.HistoryPreExposureCorrection;
+				}
+			}
+
+			C.ParallaxRejectionMask[Pixel] = QuantizeUnorm(Mask, 255.0f);
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				C.Prediction[Channel][Pixel] = QuantizeR11G11B10(Prediction[Channel], Channel);
+			}
+		}
+	}
+}
+
+void FilterFrequenciesTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	constexpr float Kernel[3] = { 0.25f, 0.5f, 0.25f };
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			float Input[3] = {};
+			float Prediction[3] = {};
+			float PredictionWeight = 0.0f;
+			for (int32_t OffsetY = -1; OffsetY <= 1; OffsetY++)
+			{
+				for (int32_t OffsetX = -1; OffsetX <= 1; OffsetX++)
+				{
+					const int32_t SampleX = std::min(std::max(X + OffsetX, 0), C.InputWidth - 1);
+					const int32_t SampleY = std::min(std::max(Y + OffsetY, 0), C.InputHeight - 1);
+					const size_t Index = size_t(SampleY) * C.InputWidth + SampleX;
+					const float Weight = Kernel[OffsetX + 1] * Kernel[OffsetY + 1];
+					const float MaskedWeight = Weight * C.ParallaxRejectionMask[Index];
+					for (int32_t Channel = 0; Channel < 3; Channel++)
+					{
+						Input[Channel] += C.Color[Channel][Index] * Weight;
+						Prediction[Channel] += C.Prediction[Channel][Index] * MaskedWeight;
+					}
+					PredictionWeight += MaskedWeight;
+				}
+			}
+
+			// Without any history to predict from, the prediction is the input and the comparison keeps it.
+			const size_t Pixel = size_t(Y) * C.InputWidth + X;
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				C.FilteredInput[Channel][Pixel] = QuantizeR11G11B10(Input[Channel], Channel);
+				C.FilteredPrediction[Channel][Pixel] = QuantizeR11G11B10(PredictionWeight > 0.0f ? Prediction[Channel] / PredictionWeight : Input[Channel], Channel);
+			}
+		}
+	}
+}
+
+/** MinX to MaxY are in rejection pixels, each the most rejecting of the 2x2 low frequency pixels it covers. */
+void CompareHistoryTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	auto LoadTonemapped = [&C](const float* const Planes[3], int32_t X, int32_t Y, float Out[3])
+	{
+		const size_t Index = size_t(std::min(std::max(Y, 0), C.InputHeight - 1)) * C.InputWidth + std::min(std::max(X, 0), C.InputWidth - 1);
+		const float RGB[3] = { Planes[0][Index], Planes[1][Index], Planes[2][Index] };
+		TonemapToYCoCg(RGB, Out);
+	};
+
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			float Rejection = 1.0f;
+			for (int32_t LowY = Y * 2; LowY < std::min(Y * 2 + 2, C.InputHeight); LowY++)
+			{
+				for (int32_t LowX = X * 2; LowX < std::min(X * 2 + 2, C.InputWidth); LowX++)
+				{
+					// Tolerance: the contrast of the input the filtered one averages, at least the quantization error of both.
+					float BoxMin[3] = { INFINITY, INFINITY, INFINITY };
+					float BoxMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+					for (int32_t OffsetY = -1; OffsetY <= 1; OffsetY++)
+					{
+						for (int32_t OffsetX = -1; OffsetX <= 1; OffsetX++)
+						{
+							float Sample[3];
+							LoadTonemapped(C.Color, LowX + OffsetX, LowY + OffsetY, Sample);
+							for (int32_t Channel = 0; Channel < 3; Channel++)
+							{
+								BoxMin[Channel] = std::min(BoxMin[Channel], Sample[Channel]);
+								BoxMax[Channel] = std::max(BoxMax[Channel], Sample[Channel]);
+							}
+						}
+					}
+
+					float Input[3], Prediction[3];
+					LoadTonemapped(C.FilteredInput, LowX, LowY, Input);
+					LoadTonemapped(C.FilteredPrediction, LowX, LowY, Prediction);
+					const float QuantizationError = 1.0f / 256.0f + Input[0] * (1.0f / 64.0f);
+					float MaxRatio = 0.0f;
+					for (int32_t Channel = 0; Channel < 3; Channel++)
+					{
+						const float Tolerance = std::max(BoxMax[Channel] - BoxMin[Channel], QuantizationError);
+						MaxRatio = std::max(MaxRatio, std::fabs(Prediction[Channel] - Input[Channel]) / Tolerance);
+					}
+					Rejection = std::min(Rejection, Saturate(2.0f - MaxRatio));
+				}
+			}
+			C.HistoryRejection[size_t(Y) * C.RejectionWidth + X] = QuantizeUnorm(Rejection, 255.0f);
+		}
+	}
+}
+
+void DilateRejectionTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			float Rejection = 1.0f;
+			for (int32_t SampleY = std::max(Y - 1, 0); SampleY <= std::min(Y + 1, C.RejectionHeight - 1); SampleY++)
+			{
+				for (int32_t SampleX = std::max(X - 1, 0); SampleX <= std::min(X + 1, C.RejectionWidth - 1); SampleX++)
+				{
+					Rejection = std::min(Rejection, C.HistoryRejection[size_t(SampleY) * C.RejectionWidth + SampleX]);
+				}
+			}
+			C.DilatedHistoryRejection[size_t(Y) * C.RejectionWidth + X] = Rejection;
+		}
+	}
+}
+
+void UpdateHistoryTile(const FGen5Context& C, int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY)
+{
+	const float UpscaleFactor = float(C.HistoryWidth) / float(C.InputWidth);
+	for (int32_t Y = MinY; Y < MaxY; Y++)
+	{
+		for (int32_t X = MinX; X < MaxX; X++)
+		{
+			// Input pixel of the history pixel, and the offset of the history pixel from its sample.
+			const float ViewportU = (float(X) + 0.5f) / float(C.HistoryWidth);
+			const float ViewportV = (float(Y) + 0.5f) / float(C.HistoryHeight);
+			const float PPCoX = ViewportU * float(C.InputWidth) + C.JitterX;
+			const float PPCoY = ViewportV * float(C.InputHeight) + C.JitterY;
+			const int32_t InputX = std::min(std::max(int32_t(std::floor(PPCoX)), 0), C.InputWidth - 1);
+			const int32_t InputY = std::min(std::max(int32_t(std::floor(PPCoY)), 0), C.InputHeight - 1);
+			const float KernelX = PPCoX - (float(InputX) + 0.5f);
+			const float KernelY = PPCoY - (float(InputY) + 0.5f);
+
+			// Current frame: Blackman-Harris over the distance in history pixels, whose sum is the samples it adds.
+			float Current[3] = {};
+			float InputWeight = 0.0f;
+			float BoxMin[3] = { INFINITY, INFINITY, INFINITY };
+			float BoxMax[3] = { -INFINITY, -INFINITY, -INFINITY };
+			float Nearest[3] = {};
+			for (int32_t OffsetY = -1; OffsetY <= 1; OffsetY++)
+			{
+				for (int32_t OffsetX = -1; OffsetX <= 1; OffsetX++)
+				{
+					const int32_t SampleX = std::min(std::max(InputX + OffsetX, 0), C.InputWidth - 1);
+					const int32_t SampleY = std::min(std::max(InputY + OffsetY, 0), C.InputHeight - 1);
+					const size_t Index = size_t(SampleY) * C.InputWidth + SampleX;
+					const float RGB[3] = { C.Color[0][Index], C.Color[1][Index], C.Color[2][Index] };
+					const float DistanceX = (float(OffsetX) - KernelX) * UpscaleFactor;
+					const float DistanceY = (float(OffsetY) - KernelY) * UpscaleFactor;
+					const float Weight = BlackmanHarris(DistanceX * DistanceX + DistanceY * DistanceY);
+					float YCoCg[3];
+					RGBToYCoCg(RGB, YCoCg);
+					for (int32_t Channel = 0; Channel < 3; Channel++)
+					{
+						Current[Channel] += RGB[Channel] * Weight;
+						BoxMin[Channel] = std::min(BoxMin[Channel], YCoCg[Channel]);
+						BoxMax[Channel] = std::max(BoxMax[Channel], YCoCg[Channel]);
+						if (OffsetX == 0 && OffsetY == 0)
+						{
+							Nearest[Channel] = RGB[Channel];
+						}
+					}
+					InputWeight += Weight;
+				}
+			}
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				Current[Channel] = InputWeight > 0.0f ? Current[Channel] / InputWeight : Nearest[Channel];
+			}
+
+			// History, and how much of it is kept.
+			const size_t InputPixel = size_t(InputY) * C.InputWidth + InputX;
+			const float VelocityX = C.DilatedVelocity[0][InputPixel];
+			const float VelocityY = C.DilatedVelocity[1][InputPixel];
+			const float ScreenPosX = ViewportU * 2.0f - 1.0f;
+			const float ScreenPosY = 1.0f - ViewportV * 2.0f;
+			const float PrevScreenX = ScreenPosX - VelocityX;
+			const float PrevScreenY = ScreenPosY - VelocityY;
+			const bool bOnScreen = std::max(std::fabs(PrevScreenX), std::fabs(PrevScreenY)) < 1.0f;
+
+			float Count = 0.0f;
+			float Low[3] = {};
+			float High[3] = {};
+			const float Parallax = C.ParallaxRejectionMask[InputPixel];
+			if (!C.bCameraCut && bOnScreen)
+			{
+				const FBilinearFootprint Footprint = GetBilinearFootprint((PrevScreenX * 0.5f + 0.5f) * float(C.HistoryWidth) - 0.5f,
+					(0.5f - PrevScreenY * 0.5f) * float(C.HistoryHeight) - 0.5f, C.HistoryWidth, C.HistoryHeight, true);
+				const float Keep = C.DilatedHistoryRejection[size_t(InputY / 2) * C.RejectionWidth + InputX / 2];
+				Count = SampleBilinear(C.PrevMetadata[0], Footprint) * C.MaxSampleCount * Parallax;
+				Count = std::min(Count, C.RejectedSampleCount + (C.MaxSampleCount - C.RejectedSampleCount) * Keep);
+
+				float HighYCoCg[3], Clamped[3];
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Low[Channel] = SampleBilinear(C.PrevLow[Channel], Footprint) * C.HistoryPreExposureCorrection;
+					High[Channel] = SampleBilinear(C.PrevHigh[Channel], Footprint) * C.HistoryPreExposureCorrection;
+				}
+				RGBToYCoCg(High, HighYCoCg);
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Clamped[Channel] = std::min(std::max(HighYCoCg[Channel], BoxMin[Channel]), BoxMax[Channel]);
+				}
+				float ClampedRGB[3];
+				YCoCgToRGB(Clamped, ClampedRGB);
+				for (int32_t Channel = 0; Channel < 3; Channel++)
+				{
+					High[Channel] = ClampedRGB[Channel] + (High[Channel] - ClampedRGB[Channel]) * Keep;
+				}
+			}
+
+			const float Blend = Count + InputWeight > 0.0f ? InputWeight / (Count + InputWeight) : 1.0f;
+			const size_t Pixel = size_t(Y) * C.HistoryWidth + X;
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				const float NewLow = Low[Channel] + (Current[Channel] - Low[Channel]) * Blend;
+				const float NewHigh = High[Channel] + (Current[Channel] - High[Channel]) * Blend;
+				C.Low[Channel][Pixel] = QuantizeFloat(NewLow, C.HistoryMantissaBits[Channel], C.HistoryMaxValue[Channel]);
+				C.High[Channel][Pixel] = QuantizeFloat(NewHigh, C.HistoryMantissaBits[Channel], C.HistoryMaxValue[Channel]);
+				C.SceneColor[Channel][Pixel] = QuantizeR11G11B10(NewHigh, Channel);
+			}
+			C.Metadata[0][Pixel] = QuantizeUnorm(std::min(Count + InputWeight, C.MaxSampleCount) / C.MaxSampleCount, 255.0f);
+			C.Metadata[1][Pixel] = Parallax;
+		}
+	}
+}
+
+} //! namespace
+
+const char* GetCaptureTAAGen5PassName(ECaptureTAAGen5Pass Pass)
+{
+	return Pass < ECaptureTAAGen5Pass::Count ? PassNames[size_t(Pass)] : "unknown";
+}
+
+FCaptureTAAGen5::FCaptureTAAGen5(const FCaptureTAAGen5Settings& InSettings)
+	: Settings(InSettings)
+	, Pool(new FCaptureParallelPool(InSettings.NumThreads))
+	, Downsampler(FCaptureResampleSettings(), Pool.get())
+{
+	Settings.HistoryScreenPercentage = std::min(std::max(Settings.HistoryScreenPercentage, 100.0f), 200.0f);
+	Settings.MaxSampleCount = std::max(Settings.MaxSampleCount, 1.0f);
+	Settings.RejectedSampleCount = std::min(std::max(Settings.RejectedSampleCount, 0.0f), Settings.MaxSampleCount);
+}
+
+void FCaptureTAAGen5::Reset()
+{
+	bHasHistory = false;
+}
+
+void FCaptureTAAGen5::Resolve(const FCaptureTAAGen5Frame& Frame, int32_t OutputWidth, int32_t OutputHeight, FCaptureImage& Output)
+{
+	const FCaptureImage& Color = *Frame.Color;
+	const int32_t InputWidth = Color.Width;
+	const int32_t InputHeight = Color.Height;
+	const float HistoryUpscaleFactor = Settings.HistoryScreenPercentage / 100.0f;
+	const int32_t HistoryWidth = int32_t(std::ceil(float(OutputWidth) * HistoryUpscaleFactor));
+	const int32_t HistoryHeight = int32_t(std::ceil(float(OutputHeight) * HistoryUpscaleFactor));
+
+	// Last frame's history becomes the previous one, the one before it is reused for this frame's.
+	std::swap(PrevLowFrequencies, Textures.HistoryLowFrequencies);
+	std::swap(PrevHighFrequencies, Textures.HistoryHighFrequencies);
+	std::swap(PrevMetadata, Textures.HistoryMetadata);
+
+	FGen5Context C;
+	C.InputWidth = InputWidth;
+	C.InputHeight = InputHeight;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		C.Color[Channel] = Color.GetPlane(std::min(Channel, Color.NumChannels - 1));
+	}
+	if (Frame.Depth && Frame.Depth->Width == InputWidth && Frame.Depth->Height == InputHeight)
+	{
+		C.Depth = Frame.Depth->GetPlane(0);
+	}
+	if (Frame.Velocity && Frame.Velocity->NumChannels >= 2 && Frame.Velocity->Width == InputWidth && Frame.Velocity->Height == InputHeight)
+	{
+		C.Velocity[0] = Frame.Velocity->GetPlane(0);
+		C.Velocity[1] = Frame.Velocity->GetPlane(1);
+	}
+	C.ClipToPrevClip = Frame.ClipToPrevClip;
+	C.JitterX = Frame.JitterX;
+	C.JitterY = Frame.JitterY;
+	C.RejectionWidth = (InputWidth + 1) / 2;
+	C.RejectionHeight = (InputHeight + 1) / 2;
+	C.HistoryWidth = HistoryWidth;
+	C.HistoryHeight = HistoryHeight;
+	C.bCameraCut = Frame.bCameraCut || !bHasHistory || PrevHighFrequencies.Width != HistoryWidth || PrevHighFrequencies.Height != HistoryHeight;
+	C.WorldDepthToPixelWorldRadius = Settings.TanHalfFieldOfView / float(InputWidth);
+	C.ParallaxDepthError = Settings.ParallaxDepthError;
+	C.MaxSampleCount = Settings.MaxSampleCount;
+	C.RejectedSampleCount = Settings.RejectedSampleCount;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		C.HistoryMantissaBits[Channel] = Settings.bR11G11B10History ? (Channel == 2 ? 5 : 6) : 10;
+		C.HistoryMaxValue[Channel] = Settings.bR11G11B10History ? (Channel == 2 ? 64512.0f : 65024.0f) : 65504.0f;
+	}
+	if (!C.bCameraCut)
+	{
+		C.HistoryPreExposureCorrection = Frame.PreExposure / HistoryPreExposure;
+		for (int32_t Channel = 0; Channel < 3; Channel++)
+		{
+			C.PrevLow[Channel] = PrevLowFrequencies.GetPlane(Channel);
+			C.PrevHigh[Channel] = PrevHighFrequencies.GetPlane(Channel);
+		}
+		C.PrevMetadata[0] = PrevMetadata.GetPlane(0);
+		C.PrevMetadata[1] = PrevMetadata.GetPlane(1);
+	}
+
+	// Textures.
+	const size_t InputSize = size_t(InputWidth) * InputHeight;
+	if (Textures.PrevTexturesSize != InputSize)
+	{
+		Textures.PrevUseCount.reset(new std::atomic<uint32_t>[InputSize]);
+		Textures.PrevClosestDepth.reset(new std::atomic<uint32_t>[InputSize]);
+		Textures.PrevTexturesSize = InputSize;
+	}
+	Textures.DilatedVelocity.Resize(InputWidth, InputHeight, 2);
+	Textures.ClosestDepth.Resize(InputWidth, InputHeight, 1);
+	Textures.Prediction.Resize(InputWidth, InputHeight, 3);
+	Textures.ParallaxRejectionMask.Resize(InputWidth, InputHeight, 1);
+	Textures.FilteredInput.Resize(InputWidth, InputHeight, 3);
+	Textures.FilteredPrediction.Resize(InputWidth, InputHeight, 3);
+	Textures.HistoryRejection.Resize(C.RejectionWidth, C.RejectionHeight, 1);
+	Textures.DilatedHistoryRejection.Resize(C.RejectionWidth, C.RejectionHeight, 1);
+	Textures.HistoryLowFrequencies.Resize(HistoryWidth, HistoryHeight, 3);
+	Textures.HistoryHighFrequencies.Resize(HistoryWidth, HistoryHeight, 3);
+	Textures.HistoryMetadata.Resize(HistoryWidth, HistoryHeight, 2);
+	Textures.SceneColor.Resize(HistoryWidth, HistoryHeight, 3);
+
+	C.PrevUseCount = Textures.PrevUseCount.get();
+	C.PrevClosestDepth = Textures.PrevClosestDepth.get();
+	C.DilatedVelocity[0] = Textures.DilatedVelocity.GetPlane(0);
+	C.DilatedVelocity[1] = Textures.DilatedVelocity.GetPlane(1);
+	C.ClosestDepth = Textures.ClosestDepth.GetPlane(0);
+	C.ParallaxRejectionMask = Textures.ParallaxRejectionMask.GetPlane(0);
+	C.HistoryRejection = Textures.HistoryRejection.GetPlane(0);
+	C.DilatedHistoryRejection = Textures.DilatedHistoryRejection.GetPlane(0);
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		C.Prediction[Channel] = Textures.Prediction.GetPlane(Channel);
+		C.FilteredInput[Channel] = Textures.FilteredInput.GetPlane(Channel);
+		C.FilteredPrediction[Channel] = Textures.FilteredPrediction.GetPlane(Channel);
+		C.Low[Channel] = Textures.HistoryLowFrequencies.GetPlane(Channel);
+		C.High[Channel] = Textures.HistoryHighFrequencies.GetPlane(Channel);
+		C.SceneColor[Channel] = Textures.SceneColor.GetPlane(Channel);
+	}
+	C.Metadata[0] = Textures.HistoryMetadata.GetPlane(0);
+	C.Metadata[1] = Textures.HistoryMetadata.GetPlane(1);
+
+	// Every pass is a dispatch of 8x8 tiles over its extent.
+	auto RunPass = [this, &C](ECaptureTAAGen5Pass Pass, int32_t Width, int32_t Height, void (*Kernel)(const FGen5Context&, int32_t, int32_t, int32_t, int32_t))
+	{
+		const auto Start = std::chrono::steady_clock::now();
+		const int32_t NumTilesX = (Width + TileSize - 1) / TileSize;
+		const int32_t NumTilesY = (Height + TileSize - 1) / TileSize;
+		Pool->ParallelFor(uint32_t(NumTilesX * NumTilesY), [&](uint32_t Tile)
+		{
+			const int32_t MinX = int32_t(Tile) % NumTilesX * TileSize;
+			const int32_t MinY = int32_t(Tile) / NumTilesX * TileSize;
+			Kernel(C, MinX, MinY, std::min(MinX + TileSize, Width), std::min(MinY + TileSize, Height));
+		});
+		PassSeconds[size_t(Pass)] += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	};
+	RunPass(ECaptureTAAGen5Pass::ClearPrevTextures, InputWidth, InputHeight, ClearPrevTexturesTile);
+	RunPass(ECaptureTAAGen5Pass::DilateVelocity, InputWidth, InputHeight, DilateVelocityTile);
+	RunPass(ECaptureTAAGen5Pass::DecimateHistory, InputWidth, InputHeight, DecimateHistoryTile);
+	RunPass(ECaptureTAAGen5Pass::FilterFrequencies, InputWidth, InputHeight, FilterFrequenciesTile);
+	RunPass(ECaptureTAAGen5Pass::CompareHistory, C.RejectionWidth, C.RejectionHeight, CompareHistoryTile);
+	RunPass(ECaptureTAAGen5Pass::DilateRejection, C.RejectionWidth, C.RejectionHeight, DilateRejectionTile);
+	RunPass(ECaptureTAAGen5Pass::UpdateHistory, HistoryWidth, HistoryHeight, UpdateHistoryTile);
+
+	// Back to the output size.
+	const auto DownsampleStart = std::chrono::steady_clock::now();
+	Output.Resize(OutputWidth, OutputHeight, 3);
+	if (HistoryWidth == OutputWidth && HistoryHeight == OutputHeight)
+	{
+		std::copy(Textures.SceneColor.Data.begin(), Textures.SceneColor.Data.begin() + Textures.SceneColor.GetPlaneSize() * 3, Output.Data.begin());
+	}
+	else
+	{
+		Downsampler.Resample(Textures.SceneColor, OutputWidth, OutputHeight, Output);
+		Pool->ParallelFor(uint32_t(OutputHeight), [&](uint32_t Row)
+		{
+			for (int32_t Channel = 0; Channel < 3; Channel++)
+			{
+				float* Dest = Output.GetPlane(Channel) + size_t(Row) * OutputWidth;
+				for (int32_t X = 0; X < OutputWidth; X++)
+				{
+					Dest[X] = QuantizeR11G11B10(Dest[X], Channel);
+				}
+			}
+		});
+	}
+	PassSeconds[size_t(ECaptureTAAGen5Pass::Downsample)] += std::chrono::duration<double>(std::chrono::steady_clock::now() - DownsampleStart).count();
+
+	HistoryPreExposure = Frame.PreExposure;
+	bHasHistory = true;
+}
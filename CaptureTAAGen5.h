@@ -0,0 +1,165 @@
+#pragma once
+
+#include "CaptureImage.h"
+#include "CaptureParallel.h"
+#include "CaptureResample.h"
+#include "CaptureTAAGen4.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/**
+ * CPU reference of the Gen5 TAAU chain, AddGen5MainTemporalAAPasses() of TAA.cpp (r.TemporalAA.Algorithm 1), for
+ * iterating on the algorithm, timing each pass and regression testing it on machines without a GPU.
+ *
+ * The seven passes run in order over the extents the engine dispatches them on, each an 8x8 tile parallel kernel
+ * over an FCaptureParallelPool, and write the textures of the engine in their formats:
+ *
+ *   ClearPrevTextures  input            PrevUseCount, PrevClosestDepth zeroed
+ *   DilateVelocity     input            DilatedVelocity (G16R16) and ClosestDepth (R16F) of the closest depth in 3x3;
+ *                                       scatters the bilinear footprint of every pixel's previous position into
+ *                                       PrevUseCount (weight, 1/256 units) and PrevClosestDepth (max device Z)
+ *   DecimateHistory    low frequency    Prediction (R11G11B10), the low frequency history reprojected, and the
+ *                                       ParallaxRejectionMask (R8): whether something closer than the pixel landed on
+ *                                       its previous position, i.e. it was hidden the frame before
+ *   FilterFrequencies  low frequency    FilteredInput and FilteredPrediction (R11G11B10): both blurred 3x3 over the
+ *                                       same footprint, prediction samples weighted by the parallax mask
+ *   CompareHistory     low frequency    HistoryRejection (R8) at half resolution: how far the filtered prediction is
+ *                                       off the filtered input relative to the local contrast, the most rejecting of
+ *                                       each 2x2
+ *   DilateRejection    rejection        DilatedHistoryRejection (R8), the most rejecting of 3x3
+ *   UpdateHistory      history          the new history and SceneColor (R11G11B10) at the history size
+ *
+ * and the output is brought back from the history size (r.TemporalAA.HistoryScreenPercentage) to the output size
+ * with the Mitchell-Netravali FCaptureResampler, like ComputeMitchellNetravaliDownsample().
+ *
+ * The history is three textures like FTAAHistoryTextures: LowFrequencies and HighFrequencies (FloatRGBA, or
+ * FloatR11G11B10 with R11G11B10History) and Metadata (R8G8: accumulated samples over MaxSampleCount, parallax
+ * validity). UpdateHistory filters the input with Blackman-Harris weights at the history pixel, whose sum is the
+ * number of samples the frame adds. History that passed the frequency comparison is kept as it is rather than
+ * clamped to the input's neighborhood, which is the point of the Gen5 design: rejected history is clamped and its
+ * sample count capped, parallax rejection, off screen history and camera cuts drop the count to zero. The high
+ * frequencies are that output; the low frequencies accumulate the same way without the clamp, so the prediction
+ * DecimateHistory makes from them is not fed back the comparison's own decisions.
+ *
+ * The shaders (TemporalAA/TAA*.usf) are not part of this tree: the passes follow their parameters, extents and
+ * formats, but the arithmetic is this reference's own and is not bit exact against the GPU. It is bit exact against
+ * itself for any number of threads, the scattering pass included since it only adds and takes maxima.
+ */
+
+/** The settings of the chain, defaults as in TAA.cpp. */
+struct FCaptureTAAGen5Settings
+{
+	/** r.TemporalAA.HistoryScreenPercentage, clamped to [100, 200] like the engine. */
+	float HistoryScreenPercentage = 100.0f;
+
+	/** r.TemporalAA.R11G11B10History: the frequency histories as FloatR11G11B10 instead of FloatRGBA. */
+	bool bR11G11B10History = false;
+
+	/** Samples the history accumulates at most; the current frame weighs at least 1 / MaxSampleCount. */
+	float MaxSampleCount = 16.0f;
+
+	/** Samples a history keeps at most where the frequency comparison rejects it. */
+	float RejectedSampleCount = 2.0f;
+
+	/** Depth difference, in pixel world radii, under which the parallax rejection keeps the history entirely. */
+	float ParallaxDepthError = 3.0f;
+
+	/** tan(FOV / 2) of the view for WorldDepthToPixelWorldRadius; 1 for the 90 degrees of a capture without it. */
+	float TanHalfFieldOfView = 1.0f;
+
+	/** Worker threads including the caller, 0 for one per hardware thread. */
+	uint32_t NumThreads = 0;
+};
+
+/** The Gen5 chain reads the same inputs as Gen4. */
+using FCaptureTAAGen5Frame = FCaptureTAAGen4Frame;
+
+enum class ECaptureTAAGen5Pass : uint8_t
+{
+	ClearPrevTextures,
+	DilateVelocity,
+	DecimateHistory,
+	FilterFrequencies,
+	CompareHistory,
+	DilateRejection,
+	UpdateHistory,
+
+	/** ComputeMitchellNetravaliDownsample() when the history is larger than the output. */
+	Downsample,
+
+	Count
+};
+
+const char* GetCaptureTAAGen5PassName(ECaptureTAAGen5Pass Pass);
+
+/** The textures of the chain, as floats rounded to their formats. Valid after Resolve(), reused across frames. */
+struct FCaptureTAAGen5Textures
+{
+	/** Input extent, scattered into by DilateVelocity. Weights in 1/256 and float bits of device Z. */
+	std::unique_ptr<std::atomic<uint32_t>[]> PrevUseCount;
+	std::unique_ptr<std::atomic<uint32_t>[]> PrevClosestDepth;
+	size_t PrevTexturesSize = 0;
+
+	/** Input extent. DilatedVelocity is decoded to screen position units. */
+	FCaptureImage DilatedVelocity;
+	FCaptureImage ClosestDepth;
+
+	/** Low frequency extent, the input's. */
+	FCaptureImage Prediction;
+	FCaptureImage ParallaxRejectionMask;
+	FCaptureImage FilteredInput;
+	FCaptureImage FilteredPrediction;
+
+	/** Rejection extent, half the low frequency one rounded up. 1 keeps the history, 0 rejects it. */
+	FCaptureImage HistoryRejection;
+	FCaptureImage DilatedHistoryRejection;
+
+	/** History extent. */
+	FCaptureImage HistoryLowFrequencies;
+	FCaptureImage HistoryHighFrequencies;
+	FCaptureImage HistoryMetadata;
+	FCaptureImage SceneColor;
+};
+
+class FCaptureTAAGen5
+{
+public:
+	explicit FCaptureTAAGen5(const FCaptureTAAGen5Settings& InSettings);
+
+	const FCaptureTAAGen5Settings& GetSettings() const { return Settings; }
+
+	/**
+	 * Runs the chain on Frame and writes Output, OutputWidth x OutputHeight with three channels: larger than the
+	 * input is TAAU. The history is the output size scaled by the history screen percentage. History of another
+	 * size, or none, is a camera cut.
+	 */
+	void Resolve(const FCaptureTAAGen5Frame& Frame, int32_t OutputWidth, int32_t OutputHeight, FCaptureImage& Output);
+
+	/** Drops the history, the next frame starts over as after a camera cut. */
+	void Reset();
+
+	const FCaptureTAAGen5Textures& GetTextures() const { return Textures; }
+
+	/** Seconds spent in a pass over every Resolve() so far. */
+	double GetPassSeconds(ECaptureTAAGen5Pass Pass) const { return PassSeconds[size_t(Pass)]; }
+
+private:
+	FCaptureTAAGen5Settings Settings;
+	std::unique_ptr<FCaptureParallelPool> Pool;
+
+	/** ComputeMitchellNetravaliDownsample() from the history size, on Pool. */
+	FCaptureResampler Downsampler;
+
+	FCaptureTAAGen5Textures Textures;
+
+	/** The previous frame's history, swapped with the one in Textures as a frame starts. */
+	FCaptureImage PrevLowFrequencies;
+	FCaptureImage PrevHighFrequencies;
+	FCaptureImage PrevMetadata;
+	float HistoryPreExposure = 1.0f;
+	bool bHasHistory = false;
+
+	double PassSeconds[size_t(ECaptureTAAGen5Pass::Count)] = {};
+};
@@ -0,0 +1,225 @@
+#include "CaptureTAASweep.h"
+
+#include "CaptureParallel.h"
+#include "CaptureReader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace
+{
+
+/** Mean absolute difference and PSNR of the RGB of two images after x / (1 + x), as capture_replay reports them. */
+void CompareTonemapped(const FCaptureImage& A, const FCaptureImage& B, double& OutMeanError, double& OutPsnr)
+{
+	double SumAbs = 0.0;
+	double SumSquares = 0.0;
+	for (int32_t Channel = 0; Channel < 3; Channel++)
+	{
+		const float* PlaneA = A.GetPlane(Channel);
+		const float* PlaneB = B.GetPlane(std::min(Channel, B.NumChannels - 1));
+		for (size_t Pixel = 0; Pixel < A.GetPlaneSize(); Pixel++)
+		{
+			const double ValueA = std::max(PlaneA[Pixel], 0.0f);
+			const double ValueB = std::max(PlaneB[Pixel], 0.0f);
+			const double Difference = ValueA / (1.0 + ValueA) - ValueB / (1.0 + ValueB);
+			SumAbs += std::fabs(Difference);
+			SumSquares += Difference * Difference;
+		}
+	}
+	const double Count = double(A.GetPlaneSize() * 3);
+	OutMeanError = SumAbs / Count;
+	OutPsnr = SumSquares > 0.0 ? 10.0 * std::log10(Count / SumSquares) : INFINITY;
+}
+
+/** Everything one setting carries from frame to frame. */
+struct FSweepRun
+{
+	std::unique_ptr<FCaptureTAAGen4> Gen4;
+	std::unique_ptr<FCaptureTAAGen5> Gen5;
+	FCaptureImage Output;
+	FCaptureImage PreviousOutput;
+	FCaptureTAASweepResult Result;
+};
+
+} //! namespace
+
+std::vector<FCaptureTAASweepConfig> ExpandCaptureTAASweepGrid(const FCaptureTAASweepGrid& Grid)
+{
+	std::vector<FCaptureTAASweepConfig> Configs;
+	char Name[256];
+	for (int32_t Algorithm : Grid.Algorithms)
+	{
+		for (bool bFast : Grid.Fasts)
+		{
+			for (float CurrentFrameWeight : Grid.CurrentFrameWeights)
+			{
+				for (float FilterSize : Grid.FilterSizes)
+				{
+					for (bool bCatmullRom : Grid.CatmullRoms)
+					{
+						for (float HistoryScreenPercentage : Grid.HistoryScreenPercentages)
+						{
+							for (bool bR11G11B10 : Grid.R11G11B10Histories)
+							{
+								FCaptureTAASweepConfig Config;
+								Config.bGen5 = Algorithm == 1;
+								if (Config.bGen5)
+								{
+									Config.Gen5.MaxSampleCount = CurrentFrameWeight > 0.0f ? 1.0f / CurrentFrameWeight : Config.Gen5.MaxSampleCount;
+									Config.Gen5.HistoryScreenPercentage = std::min(std::max(HistoryScreenPercentage, 100.0f), 200.0f);
+									Config.Gen5.bR11G11B10History = bR11G11B10;
+									snprintf(Name, sizeof(Name), "gen5 CurrentFrameWeight=%g HistoryScreenPercentage=%g R11G11B10History=%d", CurrentFrameWeight,
+										Config.Gen5.HistoryScreenPercentage, int32_t(bR11G11B10));
+								}
+								else
+								{
+									Config.Gen4.CurrentFrameWeight = CurrentFrameWeight;
+									Config.Gen4.FilterSize = FilterSize;
+									Config.Gen4.FilterKernel = bCatmullRom ? ECaptureFilterKernel::CatmullRom : ECaptureFilterKernel::Gaussian;
+									Config.Gen4.bFast = bFast;
+									Config.Gen4.bR11G11B10History = bFast && bR11G11B10;
+									snprintf(Name, sizeof(Name), "gen4 CurrentFrameWeight=%g FilterSize=%g CatmullRom=%d Fast=%d R11G11B10History=%d",
+										CurrentFrameWeight, FilterSize, int32_t(bCatmullRom), int32_t(bFast), int32_t(Config.Gen4.bR11G11B10History));
+								}
+								Config.Name = Name;
+
+								const bool bDuplicate = std::any_of(Configs.begin(), Configs.end(), [&Config](const FCaptureTAASweepConfig& Other)
+								{
+									return Other.Name == Config.Name;
+								});
+								if (!bDuplicate)
+								{
+									Configs.push_back(std::move(Config));
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	return Configs;
+}
+
+bool LoadCaptureTAASweepFrame(const FCaptureReader& Reader, uint32_t FrameIndex, const char* ReferenceLayer, FCaptureTAASweepFrame& OutFrame)
+{
+	if (!LoadCaptureTAAGen4Frame(Reader, FrameIndex, OutFrame.Images, OutFrame.Frame, OutFrame.DecodeBuffer))
+	{
+		return false;
+	}
+	OutFrame.bHasReference = ReferenceLayer && LoadCaptureImage(Reader, FrameIndex, ReferenceLayer, "rgb", OutFrame.Reference, OutFrame.DecodeBuffer)
+		&& OutFrame.Reference.NumChannels >= 3;
+	return true;
+}
+
+bool RunCaptureTAASweep(const std::vector<FCaptureTAASweepConfig>& Configs, const FCaptureTAASweepOptions& Options, const FCaptureTAASweepLoader& Loader,
+	std::vector<FCaptureTAASweepResult>& OutResults)
+{
+	const uint32_t NumThreads = Options.NumThreads ? Options.NumThreads : std::max(std::thread::hardware_concurrency(), 1u);
+	const uint32_t NumConfigs = uint32_t(Configs.size());
+	FCaptureParallelPool Pool(std::min(NumThreads, NumConfigs + 1));
+	const uint32_t ResolveThreads = std::max(NumThreads / std::max(NumConfigs, 1u), 1u);
+
+	std::vector<FSweepRun> Runs(NumConfigs);
+	for (uint32_t Index = 0; Index < NumConfigs; Index++)
+	{
+		if (Configs[Index].bGen5)
+		{
+			FCaptureTAAGen5Settings Settings = Configs[Index].Gen5;
+			Settings.NumThreads = ResolveThreads;
+			Runs[Index].Gen5.reset(new FCaptureTAAGen5(Settings));
+		}
+		else
+		{
+			FCaptureTAAGen4Settings Settings = Configs[Index].Gen4;
+			Settings.NumThreads = ResolveThreads;
+			Runs[Index].Gen4.reset(new FCaptureTAAGen4(Settings));
+		}
+	}
+
+	// Two frames in flight: the one every setting resolves and the next one being decoded.
+	std::unique_ptr<FCaptureTAASweepFrame> Frames[2] = { std::unique_ptr<FCaptureTAASweepFrame>(new FCaptureTAASweepFrame),
+		std::unique_ptr<FCaptureTAASweepFrame>(new FCaptureTAASweepFrame) };
+	uint32_t NextFrameIndex = 0;
+	auto LoadNext = [&](FCaptureTAASweepFrame& OutFrame)
+	{
+		while (NextFrameIndex < Options.NumFrames)
+		{
+			if (Loader(NextFrameIndex++, OutFrame))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	uint32_t NumLoaded = 0;
+	bool bHasFrame = LoadNext(*Frames[0]);
+	while (bHasFrame)
+	{
+		NumLoaded++;
+		const FCaptureTAASweepFrame& Current = *Frames[0];
+		const int32_t Width = Options.OutputWidth ? Options.OutputWidth : Current.bHasReference ? Current.Reference.Width : Current.Images.Color.Width;
+		const int32_t Height = Options.OutputHeight ? Options.OutputHeight : Current.bHasReference ? Current.Reference.Height : Current.Images.Color.Height;
+		const bool bCompare = Current.bHasReference && Current.Reference.Width == Width && Current.Reference.Height == Height;
+
+		bool bHasNext = false;
+		Pool.ParallelFor(NumConfigs + 1, [&](uint32_t Item)
+		{
+			if (Item == 0)
+			{
+				bHasNext = LoadNext(*Frames[1]);
+				return;
+			}
+
+			FSweepRun& Run = Runs[Item - 1];
+			const auto Start = std::chrono::steady_clock::now();
+			if (Run.Gen5)
+			{
+				Run.Gen5->Resolve(Current.Frame, Width, Height, Run.Output);
+			}
+			else
+			{
+				Run.Gen4->Resolve(Current.Frame, Width, Height, Run.Output);
+			}
+			Run.Result.ResolveSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+			Run.Result.NumResolved++;
+
+			if (bCompare)
+			{
+				double MeanError, Psnr;
+				CompareTonemapped(Run.Output, Current.Reference, MeanError, Psnr);
+				Run.Result.MeanError += MeanError;
+				Run.Result.MeanPsnr += std::min(Psnr, 100.0);
+				Run.Result.NumCompared++;
+			}
+			if (!Current.Frame.bCameraCut && Run.PreviousOutput.Width == Width && Run.PreviousOutput.Height == Height)
+			{
+				double Change, Psnr;
+				CompareTonemapped(Run.Output, Run.PreviousOutput, Change, Psnr);
+				Run.Result.MeanChange += Change;
+				Run.Result.NumChanges++;
+			}
+			std::swap(Run.Output, Run.PreviousOutput);
+		});
+
+		std::swap(Frames[0], Frames[1]);
+		bHasFrame = bHasNext;
+	}
+
+	OutResults.resize(NumConfigs);
+	for (uint32_t Index = 0; Index < NumConfigs; Index++)
+	{
+		FCaptureTAASweepResult& Result = Runs[Index].Result;
+		Result.MeanError /= std::max(Result.NumCompared, 1u);
+		Result.MeanPsnr /= std::max(Result.NumCompared, 1u);
+		Result.MeanChange /= std::max(Result.NumChanges, 1u);
+		OutResults[Index] = Result;
+	}
+	return NumLoaded > 0;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CaptureImage.h"
+#include "CaptureTAAGen4.h"
+#include "CaptureTAAGen5.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class FCaptureReader;
+
+/**
+ * Runs the CPU TAA references over one sequence for a whole grid of settings, instead of one capture_replay (or one
+ * game session) per setting.
+ *
+ * A setting is sequential in time but settings are independent of each other, so the sweep walks the sequence once:
+ * every frame is decoded a single time into memory shared by all settings, then every setting resolves it with its
+ * own history, spread over an FCaptureParallelPool. The next frame is decoded while the settings resolve the current
+ * one. Each resolver keeps to one thread when there are more settings than threads and splits the rest otherwise;
+ * since the resolvers give the same bits on any number of threads, so do the results of a sweep.
+ */
+
+/** One point of the grid: which chain, and its settings. */
+struct FCaptureTAASweepConfig
+{
+	bool bGen5 = false;
+	FCaptureTAAGen4Settings Gen4;
+	FCaptureTAAGen5Settings Gen5;
+
+	/** The cvars the point sets, for reports: "gen4 CurrentFrameWeight=0.04 FilterSize=1 ...". */
+	std::string Name;
+};
+
+/**
+ * The values to sweep, one list per cvar; the grid is their product. Values a chain does not read are collapsed:
+ * Gen4 has no history screen percentage and only rounds to R11G11B10 when fast, Gen5 filters with its own kernel and
+ * takes the current frame weight as its minimum blend, MaxSampleCount = 1 / weight.
+ */
+struct FCaptureTAASweepGrid
+{
+	/** r.TemporalAA.Algorithm: 0 for Gen4, 1 for Gen5. */
+	std::vector<int32_t> Algorithms = { 0 };
+
+	std::vector<float> CurrentFrameWeights = { 0.04f };
+	std::vector<float> FilterSizes = { 1.0f };
+	std::vector<bool> CatmullRoms = { false };
+	std::vector<float> HistoryScreenPercentages = { 100.0f };
+	std::vector<bool> R11G11B10Histories = { false };
+
+	/** Gen4 low quality TAA, the only Gen4 configuration R11G11B10 history applies to. */
+	std::vector<bool> Fasts = { false };
+};
+
+/** Every distinct setting of Grid, in the order of its lists (algorithm outermost). */
+std::vector<FCaptureTAASweepConfig> ExpandCaptureTAASweepGrid(const FCaptureTAASweepGrid& Grid);
+
+/** A decoded frame shared by every setting, and the frame to compare them against when there is one. */
+struct FCaptureTAASweepFrame
+{
+	FCaptureTAAGen4FrameImages Images;
+	FCaptureTAAGen4Frame Frame;
+	FCaptureImage Reference;
+	bool bHasReference = false;
+	std::vector<uint8_t> DecodeBuffer;
+};
+
+/** Fills a frame of the sequence; false skips it. Called from one thread at a time, once per frame. */
+using FCaptureTAASweepLoader = std::function<bool(uint32_t FrameIndex, FCaptureTAASweepFrame& OutFrame)>;
+
+/** LoadCaptureTAAGen4Frame(), and ReferenceLayer's rgb as the reference when the frame has it. */
+bool LoadCaptureTAASweepFrame(const FCaptureReader& Reader, uint32_t FrameIndex, const char* ReferenceLayer, FCaptureTAASweepFrame& OutFrame);
+
+struct FCaptureTAASweepOptions
+{
+	uint32_t NumFrames = 0;
+
+	/** Output size, 0 for the reference's, else the input's. */
+	int32_t OutputWidth = 0;
+	int32_t OutputHeight = 0;
+
+	/** Threads of the whole sweep including the caller, 0 for one per hardware thread. */
+	uint32_t NumThreads = 0;
+};
+
+/** Quality and cost of one setting over the sequence. Errors are on x / (1 + x) tonemapped RGB. */
+struct FCaptureTAASweepResult
+{
+	uint32_t NumResolved = 0;
+
+	/** Mean absolute error and PSNR against the reference, averaged over the frames that have one. */
+	uint32_t NumCompared = 0;
+	double MeanError = 0.0;
+	double MeanPsnr = 0.0;
+
+	/** Mean absolute change from one output to the next, over the frames that are not camera cuts: shimmering. */
+	uint32_t NumChanges = 0;
+	double MeanChange = 0.0;
+
+	/** Time spent resolving, summed over frames. */
+	double ResolveSeconds = 0.0;
+};
+
+/** Resolves the frames Loader gives with every setting of Configs; OutResults[i] is Configs[i]'s. False without any frame. */
+bool RunCaptureTAASweep(const std::vector<FCaptureTAASweepConfig>& Configs, const FCaptureTAASweepOptions& Options, const FCaptureTAASweepLoader& Loader,
+	std::vector<FCaptureTAASweepResult>& OutResults);
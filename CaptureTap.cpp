@@ -0,0 +1,153 @@
+#include "CaptureTap.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+
+char ToLower(char Char)
+{
+	return char(std::tolower((unsigned char)Char));
+}
+
+} //! namespace
+
+bool MatchCaptureTapPattern(const char* Pattern, const char* Name)
+{
+	// Iterative wildcard match: on a mismatch, backtrack to the last '*' and let it swallow one more character.
+	const char* StarPattern = nullptr;
+	const char* StarName = nullptr;
+	while (*Name)
+	{
+		if (*Pattern == '*')
+		{
+			StarPattern = ++Pattern;
+			StarName = Name;
+		}
+		else if (*Pattern == '?' || (*Pattern && ToLower(*Pattern) == ToLower(*Name)))
+		{
+			Pattern++;
+			Name++;
+		}
+		else if (StarPattern)
+		{
+			Pattern = StarPattern;
+			Name = ++StarName;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	while (*Pattern == '*')
+	{
+		Pattern++;
+	}
+	return *Pattern == 0;
+}
+
+void FCaptureTapFilter::Parse(const std::string& List)
+{
+	if (List == Source)
+	{
+		return;
+	}
+	Source = List;
+	Patterns.clear();
+
+	size_t Start = 0;
+	while (Start <= List.size())
+	{
+		size_t End = List.find_first_of(",;", Start);
+		if (End == std::string::npos)
+		{
+			End = List.size();
+		}
+
+		size_t First = Start;
+		size_t Last = End;
+		while (First < Last && std::isspace((unsigned char)List[First]))
+		{
+			First++;
+		}
+		while (Last > First && std::isspace((unsigned char)List[Last - 1]))
+		{
+			Last--;
+		}
+		if (Last > First)
+		{
+			Patterns.push_back(List.substr(First, Last - First));
+		}
+		Start = End + 1;
+	}
+}
+
+int32_t FCaptureTapFilter::Match(const char* Name) const
+{
+	for (size_t Index = 0; Index < Patterns.size(); Index++)
+	{
+		if (MatchCaptureTapPattern(Patterns[Index].c_str(), Name))
+		{
+			return int32_t(Index);
+		}
+	}
+	return -1;
+}
+
+FCaptureTapSchedule ScheduleCaptureTaps(const FCaptureTapFilter& Filter, const std::vector<FCaptureTapCandidate>& Candidates, const FCaptureTapBudget& Budget)
+{
+	FCaptureTapSchedule Schedule;
+	if (Filter.IsEmpty())
+	{
+		return Schedule;
+	}
+
+	struct FMatch
+	{
+		int32_t Pattern;
+		uint32_t Candidate;
+	};
+	std::vector<FMatch> Matches;
+	for (uint32_t Index = 0; Index < uint32_t(Candidates.size()); Index++)
+	{
+		const int32_t Pattern = Filter.Match(Candidates[Index].Name.c_str());
+		if (Pattern >= 0)
+		{
+			Matches.push_back({ Pattern, Index });
+		}
+	}
+	std::stable_sort(Matches.begin(), Matches.end(), [](const FMatch& A, const FMatch& B) { return A.Pattern < B.Pattern; });
+
+	std::vector<const std::string*> Names;
+	for (const FMatch& Match : Matches)
+	{
+		const FCaptureTapCandidate& Candidate = Candidates[Match.Candidate];
+		if (Candidate.Bytes == 0)
+		{
+			Schedule.NumUnsupported++;
+			continue;
+		}
+
+		const bool bDuplicate = std::any_of(Names.begin(), Names.end(), [&Candidate](const std::string* Name) { return *Name == Candidate.Name; });
+		if (bDuplicate)
+		{
+			Schedule.NumDuplicates++;
+			continue;
+		}
+		Names.push_back(&Candidate.Name);
+
+		const bool bCountFits = Budget.MaxTaps == 0 || Schedule.Selected.size() < Budget.MaxTaps;
+		const bool bBytesFit = Budget.MaxBytes == 0 || Schedule.SelectedBytes + Candidate.Bytes <= Budget.MaxBytes;
+		if (!bCountFits || !bBytesFit)
+		{
+			Schedule.NumOverBudget++;
+			continue;
+		}
+
+		Schedule.Selected.push_back(Match.Candidate);
+		Schedule.SelectedBytes += Candidate.Bytes;
+	}
+	return Schedule;
+}
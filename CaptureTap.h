@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Selection of named render graph textures ("taps") to read back without touching the pass that creates them.
+ *
+ * A hook offers every intermediate it produces under its RDG debug name, e.g. TAA.DilatedVelocity or
+ * Debug.TAA.UpdateHistory. r.Capture.Taps lists the names to read back, and only those offers turn into
+ * readbacks. The matching and scheduling below is plain C++ so it can be checked without the engine.
+ */
+
+/** Case insensitive match of Name against Pattern, where '*' matches any run of characters and '?' one character. */
+bool MatchCaptureTapPattern(const char* Pattern, const char* Name);
+
+/** Parsed tap list: comma or semicolon separated patterns, surrounding whitespace ignored. */
+class FCaptureTapFilter
+{
+public:
+	/** Reparses only when List differs from the last one, so it can be fed the console variable every frame. */
+	void Parse(const std::string& List);
+
+	bool IsEmpty() const { return Patterns.empty(); }
+	const std::vector<std::string>& GetPatterns() const { return Patterns; }
+
+	/** Index of the first pattern matching Name, or -1. Earlier patterns are scheduled first. */
+	int32_t Match(const char* Name) const;
+
+private:
+	std::string Source;
+	std::vector<std::string> Patterns;
+};
+
+/** A texture a hook offers for capture. */
+struct FCaptureTapCandidate
+{
+	std::string Name;
+
+	/** Packed size of the readback, 0 if its pixel format cannot be captured. */
+	uint64_t Bytes = 0;
+};
+
+struct FCaptureTapBudget
+{
+	/** Readbacks per hook and frame, 0 for no limit. */
+	uint32_t MaxTaps = 4;
+
+	/** Packed bytes per hook and frame, 0 for no limit. */
+	uint64_t MaxBytes = 0;
+};
+
+struct FCaptureTapSchedule
+{
+	/** Candidates to read back, as indices into the offered list, in the order the readbacks should be queued. */
+	std::vector<uint32_t> Selected;
+	uint64_t SelectedBytes = 0;
+
+	/** Matching candidates left out because of the budget, an uncapturable format or a repeated name. */
+	uint32_t NumOverBudget = 0;
+	uint32_t NumUnsupported = 0;
+	uint32_t NumDuplicates = 0;
+};
+
+/**
+ * Picks the candidates to read back this frame. Candidates that match no pattern are never looked at again.
+ * Matching ones are ordered by the first pattern they match, then by the order they were offered, and taken
+ * greedily while they fit the budget, so a large tap that does not fit does not starve smaller ones after it.
+ * A name is only read back once.
+ */
+FCaptureTapSchedule ScheduleCaptureTaps(const FCaptureTapFilter& Filter, const std::vector<FCaptureTapCandidate>& Candidates, const FCaptureTapBudget& Budget);
@@ -0,0 +1,101 @@
+#include "CaptureTapRHI.h"
+
+#include "HAL/IConsoleManager.h"
+#include "RenderingThread.h"
+#include "SceneRendering.h"
+
+#include "CapturePixelFormat.h"
+#include "CaptureReadbackRHI.h"
+#include "CaptureSession.h"
+#include "CaptureSubsystem.h"
+#include "CaptureTap.h"
+
+namespace
+{
+
+TAutoConsoleVariable<FString> CVarCaptureTaps(
+	TEXT("r.Capture.Taps"),
+	TEXT(""),
+	TEXT("Comma separated RDG texture names to read back from the hooks that offer taps, e.g.\n")
+	TEXT("\"TAA.DilatedVelocity, TAA.History.*, Debug.TAA.*\". '*' and '?' are wildcards, matching ignores case.\n")
+	TEXT("Earlier entries win when the budget is exceeded. Debug.TAA.* only hold data when the shaders write their debug output."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarCaptureTapsMaxPerFrame(
+	TEXT("r.Capture.Taps.MaxPerFrame"),
+	4,
+	TEXT("Taps read back per hook and frame, 0 for no limit. Every tap takes a slot of the readback ring."),
+	ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<float> CVarCaptureTapsMaxMegabytes(
+	TEXT("r.Capture.Taps.MaxMegabytes"),
+	0.0f,
+	TEXT("Packed megabytes of taps read back per hook and frame, 0 for no limit."),
+	ECVF_RenderThreadSafe);
+
+/** Reparsed when the console variable changes, render thread only. */
+FCaptureTapFilter GCaptureTapFilter;
+
+} //! namespace
+
+FCaptureTapList::FCaptureTapList(const FViewInfo& View, const FIntRect& ViewRect)
+{
+	check(IsInRenderingThread());
+
+	GCaptureTapFilter.Parse(TCHAR_TO_UTF8(*CVarCaptureTaps.GetValueOnRenderThread()));
+	bEnabled = !GCaptureTapFilter.IsEmpty() && FCaptureSession::Get().ShouldCapture(View, ViewRect);
+}
+
+void FCaptureTapList::Add(FRDGTextureRef Texture, const FIntRect& Rect)
+{
+	if (!bEnabled || !Texture)
+	{
+		return;
+	}
+
+	const std::string Name = TCHAR_TO_UTF8(Texture->Name);
+	if (GCaptureTapFilter.Match(Name.c_str()) >= 0 && FCaptureSession::Get().ShouldCaptureLayer(Name.c_str()))
+	{
+		Entries.Add({ Texture, Rect });
+	}
+}
+
+void FCaptureTapList::AddReadbackPasses(FRDGBuilder& GraphBuilder)
+{
+	if (!Entries.Num())
+	{
+		return;
+	}
+
+	std::vector<FCaptureTapCandidate> Candidates;
+	Candidates.reserve(Entries.Num());
+	for (const FEntry& Entry : Entries)
+	{
+		const EPixelFormat Format = Entry.Texture->Desc.Format;
+		const FCapturePixelFormatDesc* Desc = FindCapturePixelFormat(uint32(Format));
+		const bool bCapturable = Desc && GPixelFormats[Format].BlockSizeX == 1;
+
+		FCaptureTapCandidate Candidate;
+		Candidate.Name = TCHAR_TO_UTF8(Entry.Texture->Name);
+		Candidate.Bytes = bCapturable ? uint64(Entry.Rect.Area()) * Desc->BytesPerPixel : 0;
+		Candidates.push_back(MoveTemp(Candidate));
+	}
+
+	FCaptureTapBudget Budget;
+	Budget.MaxTaps = uint32(FMath::Max(CVarCaptureTapsMaxPerFrame.GetValueOnRenderThread(), 0));
+	Budget.MaxBytes = uint64(FMath::Max(CVarCaptureTapsMaxMegabytes.GetValueOnRenderThread(), 0.0f) * 1024.0f * 1024.0f);
+
+	const FCaptureTapSchedule Schedule = ScheduleCaptureTaps(GCaptureTapFilter, Candidates, Budget);
+	for (uint32 Index : Schedule.Selected)
+	{
+		FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, Entries[Index].Texture, Entries[Index].Rect,
+			FCaptureSession::Get().MakeRequest(Candidates[Index].Name.c_str()));
+	}
+
+	if (Schedule.NumOverBudget || Schedule.NumUnsupported)
+	{
+		UE_LOG(LogCapture, Verbose, TEXT("Capture taps: %d read back (%.1f MB), %u over budget, %u with an uncapturable format"),
+			int32(Schedule.Selected.size()), double(Schedule.SelectedBytes) / (1024.0 * 1024.0), Schedule.NumOverBudget, Schedule.NumUnsupported);
+	}
+	Entries.Reset();
+}
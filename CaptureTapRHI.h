@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderGraphBuilder.h"
+
+class FViewInfo;
+
+/**
+ * Named intermediates of one hook, read back when r.Capture.Taps selects them.
+ *
+ *	FCaptureTapList Taps(View, InputRect);
+ *	Taps.Add(DilatedVelocityTexture, InputRect);
+ *	...
+ *	Taps.AddReadbackPasses(GraphBuilder);
+ *
+ * Textures are offered under their RDG debug name, which also becomes the layer name in the capture. When the
+ * frame or view is not captured or no tap matches, Add() is a branch and no readback is queued, so only the
+ * selected taps cost bandwidth.
+ */
+class FCaptureTapList
+{
+public:
+	/** Render thread only. Decides once for the hook whether View is captured this frame. */
+	FCaptureTapList(const FViewInfo& View, const FIntRect& ViewRect);
+
+	bool IsEnabled() const { return bEnabled; }
+
+	/** Offers Rect of Texture. It is read back by AddReadbackPasses(), after every pass added so far. */
+	void Add(FRDGTextureRef Texture, const FIntRect& Rect);
+
+	/** Schedules the selected taps within the r.Capture.Taps.* budget and queues their readbacks. */
+	void AddReadbackPasses(FRDGBuilder& GraphBuilder);
+
+private:
+	struct FEntry
+	{
+		FRDGTextureRef Texture;
+		FIntRect Rect;
+	};
+
+	bool bEnabled = false;
+	TArray<FEntry, TInlineAllocator<16>> Entries;
+};
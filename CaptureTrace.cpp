@@ -0,0 +1,343 @@
+#include "CaptureTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> GCaptureTraceEnabled{ false };
+
+namespace
+{
+
+enum class ETraceEvent : uint32_t
+{
+	Scope,
+	Counter,
+};
+
+struct FTraceEvent
+{
+	const char* Name;
+	uint64_t Start;
+
+	/** End time of a scope, value of a counter. */
+	uint64_t Value;
+	ETraceEvent Type;
+};
+
+struct FTraceBuffer
+{
+	uint32_t ThreadId = 0;
+	std::unique_ptr<FTraceEvent[]> Events;
+
+	/** Events started and finished: the event at Index is being written while Begun > Index >= Finished. */
+	std::atomic<uint64_t> Begun{ 0 };
+	std::atomic<uint64_t> Finished{ 0 };
+
+	/** Owned by the registry lock. */
+	std::string ThreadName;
+	uint64_t ExportFrom = 0;
+};
+
+struct FTraceRegistry
+{
+	std::mutex Mutex;
+	std::vector<std::unique_ptr<FTraceBuffer>> Buffers;
+};
+
+FTraceRegistry& GetRegistry()
+{
+	// Never destroyed: threads that outlive static destruction may still record.
+	static FTraceRegistry* Registry = new FTraceRegistry();
+	return *Registry;
+}
+
+thread_local FTraceBuffer* GThreadBuffer = nullptr;
+thread_local const char* GThreadName = nullptr;
+
+FTraceBuffer& GetThreadBuffer()
+{
+	if (!GThreadBuffer)
+	{
+		std::unique_ptr<FTraceBuffer> Buffer = std::make_unique<FTraceBuffer>();
+		Buffer->Events.reset(new FTraceEvent[CaptureTraceEventsPerThread]);
+
+		FTraceRegistry& Registry = GetRegistry();
+		std::lock_guard<std::mutex> Lock(Registry.Mutex);
+		Buffer->ThreadId = uint32_t(Registry.Buffers.size()) + 1;
+		Buffer->ThreadName = GThreadName ? GThreadName : "Thread " + std::to_string(Buffer->ThreadId);
+		GThreadBuffer = Buffer.get();
+		Registry.Buffers.push_back(std::move(Buffer));
+	}
+	return *GThreadBuffer;
+}
+
+void Record(ETraceEvent Type, const char* Name, uint64_t Start, uint64_t Value)
+{
+	FTraceBuffer& Buffer = GetThreadBuffer();
+	const uint64_t Index = Buffer.Finished.load(std::memory_order_relaxed);
+
+	// Announce the slot before overwriting it, so an export that copied it meanwhile knows to drop it.
+	Buffer.Begun.store(Index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	FTraceEvent& Event = Buffer.Events[Index % CaptureTraceEventsPerThread];
+	Event.Name = Name;
+	Event.Start = Start;
+	Event.Value = Value;
+	Event.Type = Type;
+	Buffer.Finished.store(Index + 1, std::memory_order_release);
+}
+
+struct FThreadEvents
+{
+	uint32_t ThreadId = 0;
+	std::string ThreadName;
+	std::vector<FTraceEvent> Events;
+};
+
+/** Copies the events every thread recorded since the last reset. Returns how many were lost to wrap around. */
+uint64_t CollectEvents(std::vector<FThreadEvents>& OutThreads)
+{
+	FTraceRegistry& Registry = GetRegistry();
+	std::lock_guard<std::mutex> Lock(Registry.Mutex);
+
+	uint64_t NumLost = 0;
+	for (const std::unique_ptr<FTraceBuffer>& Buffer : Registry.Buffers)
+	{
+		const uint64_t Finished = Buffer->Finished.load(std::memory_order_acquire);
+		uint64_t First = std::max(Buffer->ExportFrom, Finished > CaptureTraceEventsPerThread ? Finished - CaptureTraceEventsPerThread : 0);
+
+		FThreadEvents Thread;
+		Thread.ThreadId = Buffer->ThreadId;
+		Thread.ThreadName = Buffer->ThreadName;
+		Thread.Events.reserve(size_t(Finished - First));
+		for (uint64_t Index = First; Index < Finished; Index++)
+		{
+			Thread.Events.push_back(Buffer->Events[Index % CaptureTraceEventsPerThread]);
+		}
+
+		// Slots the thread started to reuse while they were copied are garbage.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t Begun = Buffer->Begun.load(std::memory_order_relaxed);
+		const uint64_t FirstIntact = Begun > CaptureTraceEventsPerThread ? Begun - CaptureTraceEventsPerThread : 0;
+		if (FirstIntact > First)
+		{
+			const uint64_t NumTorn = std::min<uint64_t>(FirstIntact - First, Thread.Events.size());
+			Thread.Events.erase(Thread.Events.begin(), Thread.Events.begin() + ptrdiff_t(NumTorn));
+			First += NumTorn;
+		}
+		NumLost += First - std::min(First, Buffer->ExportFrom);
+
+		if (!Thread.Events.empty())
+		{
+			OutThreads.push_back(std::move(Thread));
+		}
+	}
+	return NumLost;
+}
+
+void AppendEscaped(std::string& Out, const char* Text)
+{
+	for (; *Text; Text++)
+	{
+		if (*Text == '"' || *Text == '\\')
+		{
+			Out += '\\';
+		}
+		Out += uint8_t(*Text) < 0x20 ? ' ' : *Text;
+	}
+}
+
+} //! namespace
+
+void SetCaptureTraceEnabled(bool bEnabled)
+{
+	GCaptureTraceEnabled.store(bEnabled, std::memory_order_relaxed);
+}
+
+void ResetCaptureTrace()
+{
+	FTraceRegistry& Registry = GetRegistry();
+	std::lock_guard<std::mutex> Lock(Registry.Mutex);
+	for (const std::unique_ptr<FTraceBuffer>& Buffer : Registry.Buffers)
+	{
+		Buffer->ExportFrom = Buffer->Finished.load(std::memory_order_acquire);
+	}
+}
+
+uint64_t GetCaptureTraceTime()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void SetCaptureTraceThreadName(const char* Name)
+{
+	GThreadName = Name;
+	if (GThreadBuffer)
+	{
+		FTraceRegistry& Registry = GetRegistry();
+		std::lock_guard<std::mutex> Lock(Registry.Mutex);
+		GThreadBuffer->ThreadName = Name;
+	}
+}
+
+void RecordCaptureTraceScope(const char* Name, uint64_t StartTime, uint64_t EndTime)
+{
+	Record(ETraceEvent::Scope, Name, StartTime, std::max(StartTime, EndTime));
+}
+
+void RecordCaptureTraceCounter(const char* Name, int64_t Value)
+{
+	Record(ETraceEvent::Counter, Name, GetCaptureTraceTime(), uint64_t(Value));
+}
+
+FCaptureTraceSummary SummarizeCaptureTrace()
+{
+	std::vector<FThreadEvents> Threads;
+	FCaptureTraceSummary Summary;
+	Summary.NumLost = CollectEvents(Threads);
+
+	// Keyed by name and kind, so a scope and a counter of the same name stay apart.
+	std::map<std::pair<std::string, ETraceEvent>, std::vector<double>> Samples;
+	uint64_t FirstTime = ~0ull;
+	uint64_t LastTime = 0;
+	for (const FThreadEvents& Thread : Threads)
+	{
+		for (const FTraceEvent& Event : Thread.Events)
+		{
+			const bool bScope = Event.Type == ETraceEvent::Scope;
+			Samples[{ Event.Name, Event.Type }].push_back(bScope ? double(Event.Value - Event.Start) : double(int64_t(Event.Value)));
+			FirstTime = std::min(FirstTime, Event.Start);
+			LastTime = std::max(LastTime, bScope ? Event.Value : Event.Start);
+			Summary.NumEvents++;
+		}
+	}
+	Summary.Duration = LastTime > FirstTime ? LastTime - FirstTime : 0;
+
+	for (ETraceEvent Type : { ETraceEvent::Scope, ETraceEvent::Counter })
+	{
+		for (auto& Pair : Samples)
+		{
+			if (Pair.first.second != Type)
+			{
+				continue;
+			}
+
+			std::vector<double>& Values = Pair.second;
+			std::sort(Values.begin(), Values.end());
+
+			FCaptureTraceSummaryRow Row;
+			Row.bCounter = Type == ETraceEvent::Counter;
+			Row.Count = Values.size();
+			Row.Min = Values.front();
+			Row.Max = Values.back();
+			Row.P50 = Values[Values.size() / 2];
+			Row.P99 = Values[std::min(Values.size() - 1, Values.size() * 99 / 100)];
+			for (double Value : Values)
+			{
+				Row.Total += Value;
+			}
+			Row.Name = Pair.first.first;
+			Summary.Rows.push_back(Row);
+		}
+	}
+	return Summary;
+}
+
+std::string FormatCaptureTraceSummary(const FCaptureTraceSummary& Summary)
+{
+	std::string Out;
+	char Line[256];
+
+	snprintf(Line, sizeof(Line), "%llu events over %.1f ms, %llu lost\n", (unsigned long long)Summary.NumEvents, double(Summary.Duration) / 1e6,
+		(unsigned long long)Summary.NumLost);
+	Out += Line;
+
+	bool bScopeHeader = false;
+	bool bCounterHeader = false;
+	for (const FCaptureTraceSummaryRow& Row : Summary.Rows)
+	{
+		if (!Row.bCounter)
+		{
+			if (!bScopeHeader)
+			{
+				snprintf(Line, sizeof(Line), "%-24s %8s %11s %10s %10s %10s %10s\n", "scope", "count", "total ms", "mean us", "p50 us", "p99 us", "max us");
+				Out += Line;
+				bScopeHeader = true;
+			}
+			snprintf(Line, sizeof(Line), "%-24s %8llu %11.2f %10.1f %10.1f %10.1f %10.1f\n", Row.Name.c_str(), (unsigned long long)Row.Count, Row.Total / 1e6,
+				Row.Total / double(Row.Count) / 1e3, Row.P50 / 1e3, Row.P99 / 1e3, Row.Max / 1e3);
+		}
+		else
+		{
+			if (!bCounterHeader)
+			{
+				snprintf(Line, sizeof(Line), "%-24s %8s %11s %10s %10s %10s %10s\n", "counter", "count", "", "mean", "p50", "p99", "max");
+				Out += Line;
+				bCounterHeader = true;
+			}
+			snprintf(Line, sizeof(Line), "%-24s %8llu %11s %10.1f %10.0f %10.0f %10.0f\n", Row.Name.c_str(), (unsigned long long)Row.Count, "",
+				Row.Total / double(Row.Count), Row.P50, Row.P99, Row.Max);
+		}
+		Out += Line;
+	}
+	return Out;
+}
+
+bool WriteCaptureTrace(const std::string& Path)
+{
+	std::vector<FThreadEvents> Threads;
+	CollectEvents(Threads);
+
+	uint64_t FirstTime = ~0ull;
+	for (const FThreadEvents& Thread : Threads)
+	{
+		for (const FTraceEvent& Event : Thread.Events)
+		{
+			FirstTime = std::min(FirstTime, Event.Start);
+		}
+	}
+
+	std::string Json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char Line[256];
+	bool bFirst = true;
+	for (const FThreadEvents& Thread : Threads)
+	{
+		Json += bFirst ? "" : ",\n";
+		bFirst = false;
+		Json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(Thread.ThreadId) + ",\"args\":{\"name\":\"";
+		AppendEscaped(Json, Thread.ThreadName.c_str());
+		Json += "\"}}";
+
+		for (const FTraceEvent& Event : Thread.Events)
+		{
+			Json += ",\n{\"name\":\"";
+			AppendEscaped(Json, Event.Name);
+			if (Event.Type == ETraceEvent::Scope)
+			{
+				// Microseconds with nanosecond digits, the unit of the format.
+				snprintf(Line, sizeof(Line), "\",\"cat\":\"capture\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					Thread.ThreadId, double(Event.Start - FirstTime) / 1e3, double(Event.Value - Event.Start) / 1e3);
+			}
+			else
+			{
+				snprintf(Line, sizeof(Line), "\",\"cat\":\"capture\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+					Thread.ThreadId, double(Event.Start - FirstTime) / 1e3, (long long)int64_t(Event.Value));
+			}
+			Json += Line;
+		}
+	}
+	Json += "\n]}\n";
+
+	FILE* File = fopen(Path.c_str(), "wb");
+	if (!File)
+	{
+		return false;
+	}
+	const bool bWritten = fwrite(Json.data(), 1, Json.size(), File) == Json.size();
+	return fclose(File) == 0 && bWritten;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Timeline of the capture pipeline: scoped timers and counters on every stage (submit, GPU ready, copy,
+ * compress, write, fsync), exported as Chrome trace JSON (chrome://tracing, Perfetto) and as a summary table.
+ *
+ * Every thread records into a buffer of its own, a ring of the last CaptureTraceEventsPerThread events, with two
+ * plain stores and no lock or allocation once the buffer exists. Export may run while the pipeline records and
+ * skips events that were overwritten while it copied them.
+ *
+ * Recording is off until SetCaptureTraceEnabled(true); while off a scope costs one relaxed load. Building with
+ * CAPTURE_TRACE=0 compiles every macro below out. Names must be string literals, only their address is stored.
+ */
+
+#if !defined(CAPTURE_TRACE)
+	#define CAPTURE_TRACE 1
+#endif
+
+static constexpr uint32_t CaptureTraceEventsPerThread = 1 << 16;
+
+extern std::atomic<bool> GCaptureTraceEnabled;
+
+inline bool IsCaptureTraceEnabled()
+{
+	return GCaptureTraceEnabled.load(std::memory_order_relaxed);
+}
+
+/** Starts or stops recording. Buffers keep their events either way. */
+void SetCaptureTraceEnabled(bool bEnabled);
+
+/** Forgets every event recorded so far; the next export starts from here. */
+void ResetCaptureTrace();
+
+/** Monotonic time in nanoseconds, the clock of every event. */
+uint64_t GetCaptureTraceTime();
+
+/** Name the calling thread shows up with in the trace. */
+void SetCaptureTraceThreadName(const char* Name);
+
+void RecordCaptureTraceScope(const char* Name, uint64_t StartTime, uint64_t EndTime);
+void RecordCaptureTraceCounter(const char* Name, int64_t Value);
+
+struct FCaptureTraceSummaryRow
+{
+	std::string Name;
+	bool bCounter = false;
+	uint64_t Count = 0;
+
+	/** Durations in nanoseconds for scopes, values for counters. */
+	double Total = 0.0;
+	double Min = 0.0;
+	double Max = 0.0;
+	double P50 = 0.0;
+	double P99 = 0.0;
+};
+
+struct FCaptureTraceSummary
+{
+	std::vector<FCaptureTraceSummaryRow> Rows;
+	uint64_t NumEvents = 0;
+
+	/** Events that were overwritten before they could be exported. */
+	uint64_t NumLost = 0;
+
+	/** Wall time from the first to the last event, in nanoseconds. */
+	uint64_t Duration = 0;
+};
+
+/** Per name statistics of every event recorded since the last reset, scopes first. */
+FCaptureTraceSummary SummarizeCaptureTrace();
+
+/** The summary as a fixed width table, one row per line. */
+std::string FormatCaptureTraceSummary(const FCaptureTraceSummary& Summary);
+
+/** Writes the events recorded since the last reset as Chrome trace JSON. */
+bool WriteCaptureTrace(const std::string& Path);
+
+class FCaptureTraceScope
+{
+public:
+	explicit FCaptureTraceScope(const char* InName)
+		: Name(InName)
+		, StartTime(IsCaptureTraceEnabled() ? GetCaptureTraceTime() : 0)
+	{
+	}
+
+	~FCaptureTraceScope()
+	{
+		if (StartTime)
+		{
+			RecordCaptureTraceScope(Name, StartTime, GetCaptureTraceTime());
+		}
+	}
+
+	FCaptureTraceScope(const FCaptureTraceScope&) = delete;
+	FCaptureTraceScope& operator=(const FCaptureTraceScope&) = delete;
+
+private:
+	const char* Name;
+	uint64_t StartTime;
+};
+
+#define CAPTURE_TRACE_JOIN_INNER(A, B) A##B
+#define CAPTURE_TRACE_JOIN(A, B) CAPTURE_TRACE_JOIN_INNER(A, B)
+
+#if CAPTURE_TRACE
+	/** Times the rest of the enclosing block. */
+	#define CAPTURE_TRACE_SCOPE(Name) FCaptureTraceScope CAPTURE_TRACE_JOIN(CaptureTraceScope, __LINE__)(Name)
+
+	/** Samples a value, e.g. a queue depth. */
+	#define CAPTURE_TRACE_COUNTER(Name, Value) do { if (IsCaptureTraceEnabled()) { RecordCaptureTraceCounter(Name, int64_t(Value)); } } while (0)
+
+	/** Start time for CAPTURE_TRACE_SPAN, 0 while recording is off. */
+	#define CAPTURE_TRACE_NOW() (IsCaptureTraceEnabled() ? GetCaptureTraceTime() : uint64_t(0))
+
+	/** Records a span that began at Start, taken with CAPTURE_TRACE_NOW() possibly on another thread, and ends now. */
+	#define CAPTURE_TRACE_SPAN(Name, Start) do { const uint64_t CaptureTraceStart = (Start); if (CaptureTraceStart && IsCaptureTraceEnabled()) { RecordCaptureTraceScope(Name, CaptureTraceStart, GetCaptureTraceTime()); } } while (0)
+#else
+	#define CAPTURE_TRACE_SCOPE(Name)
+	#define CAPTURE_TRACE_COUNTER(Name, Value) do { } while (0)
+	#define CAPTURE_TRACE_NOW() uint64_t(0)
+	#define CAPTURE_TRACE_SPAN(Name, Start) do { } while (0)
+#endif
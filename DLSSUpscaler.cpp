@@ -36,8 +36,9 @@
 
 #include "LegacyScreenPercentageDriver.h"
 
-#include <string>
-#include <fstream>
+#include "CaptureReadbackRHI.h"
+#include "CaptureSession.h"
+
 //#include <Runtime/Windows/D3D11RHI/Public/D3D11Resources.h>
 //#include <ThirdParty/NGX/Include/nvsdk_ngx.h>
 
@@ -292,68 +293,6 @@ void FDLSSUpscaler::ReleaseStaticResources()
 	UE_LOG(LogDLSS, Log, TEXT("%s Leave"), ANSI_TO_TCHAR(__FUNCTION__));
 }
 
-static void DumpTexture(std::string Filename, FRHITexture* Texture, FRHICommandListImmediate& RHICmdList)
-{
-	FRHITexture2D* TexRef2D = Texture->GetTexture2D();
-	uint32 LolStride = 0;
-	char* TextureDataPtr = (char*)RHICmdList.LockTexture2D(TexRef2D, 0, EResourceLockMode::RLM_ReadOnly, LolStride, false);
-
-	std::ofstream b_stream(Filename.c_str(), std::fstream::out | std::fstream::binary);
-	EPixelFormat TextureFormat_ = Texture->GetFormat();
-
-	int bytes = TexRef2D->GetSizeX() * TexRef2D->GetSizeY();
-	if (TextureFormat_ == EPixelFormat::PF_FloatRGBA) {
-		bytes = bytes * 4 * 2;
-	}
-	else if (TextureFormat_ == EPixelFormat::PF_DepthStencil) {
-		bytes = bytes * 1 * 4;
-	}
-	else if (TextureFormat_ == EPixelFormat::PF_G16R16F) {
-		bytes = bytes * 2 * 2;
-	}
-
-	if (b_stream) {
-		b_stream.write(TextureDataPtr, bytes);
-	}
-	b_stream.close();
-	RHICmdList.UnlockTexture2D(TexRef2D, 0, false);
-}
-
-int count = 0;
-static void TextureWriting_RenderThread(
-	FRHICommandListImmediate& RHICmdList, FRHITexture* Texture, FRHITexture* TextureInput, FRHITexture* TextureDepth, FRHITexture* TextureVelocity)
-{
-	check(IsInRenderingThread());
-	if (Texture == nullptr)
-	{
-		UE_LOG(LogDLSS, Warning, TEXT("Texture is null"));
-		return;
-	}
-	if (TextureInput == nullptr)
-	{
-		UE_LOG(LogDLSS, Warning, TEXT("TextureInput is null"));
-		return;
-	}
-
-	FRHITexture2D* TexRef2D = Texture->GetTexture2D();
-	int sizeX = TexRef2D->GetSizeX();
-	int sizeY = TexRef2D->GetSizeY();
-	std::string PathRoot = "D:/pc_code/data/DLSS_" + std::to_string(count) + "_" + std::to_string(sizeX) + "_" + std::to_string(sizeY);
-	std::string FilenameOutput = PathRoot + "_output.txt";
-	std::string FilenameInput = PathRoot + "_input.txt";
-	std::string FilenameDepth = PathRoot + "_depth.txt";
-	FRHITexture2D* TexRefVelocity2D = TextureVelocity->GetTexture2D();
-	sizeX = TexRefVelocity2D->GetSizeX();
-	sizeY = TexRefVelocity2D->GetSizeY();
-	std::string VelocityPathRoot = "D:/pc_code/data/DLSS_" + std::to_string(count) + "_" + std::to_string(sizeX) + "_" + std::to_string(sizeY);
-	std::string FilenameVelocity = VelocityPathRoot + "_velocity.txt";
-	DumpTexture(FilenameOutput, Texture, RHICmdList);
-	DumpTexture(FilenameInput, TextureInput, RHICmdList);
-	DumpTexture(FilenameDepth, TextureDepth, RHICmdList);
-	DumpTexture(FilenameVelocity, TextureVelocity, RHICmdList);
-	count++;
-}
-
 void FDLSSUpscaler::AddPasses(
 	FRDGBuilder& GraphBuilder,
 	const FViewInfo& View,
@@ -434,19 +373,24 @@ FDLSSOutputs FDLSSUpscaler::AddDLSSPass(
 	const float ScaleX = float(SrcRect.Width()) / float(DestRect.Width());
 	const float ScaleY = float(SrcRect.Height()) / float(DestRect.Height());
 
-	if (InputHistory.RT[0].IsValid())
+	const bool bCapture = FCaptureSession::Get().ShouldCapture(View, SrcRect);
+
+	if (bCapture && InputHistory.IsValid())
 	{
-		FRHITexture* historyTarget1 = InputHistory.RT[0]->GetRenderTargetItem().TargetableTexture;
-		FRHITexture* historyTargetInput = InputHistory.RT[1]->GetRenderTargetItem().TargetableTexture;
-		FRHITexture* historyTargetDepth = InputHistory.RT[2]->GetRenderTargetItem().TargetableTexture;
-		FRHITexture* historyTargetVelocity = InputHistory.RT[3]->GetRenderTargetItem().TargetableTexture;
+		// The history holds the previous frame, the prefix keeps it apart from this frame's layers in the bundle.
+		// The four targets go out as one batch, so the history is captured whole or not at all.
+		static const char* const HistoryLayers[] = { "history_output", "history_input", "history_depth", "history_velocity" };
 
-		ENQUEUE_RENDER_COMMAND(CaptureCommand)(
-			[historyTarget1, historyTargetInput, historyTargetDepth, historyTargetVelocity](FRHICommandListImmediate& RHICmdList)
+		TArray<FCaptureReadbackBatchItem, TInlineAllocator<4>> HistoryBatch;
+		for (int32 Index = 0; Index < UE_ARRAY_COUNT(HistoryLayers); Index++)
+		{
+			if (InputHistory.RT[Index].IsValid() && FCaptureSession::Get().ShouldCaptureLayer(HistoryLayers[Index]))
 			{
-				TextureWriting_RenderThread(RHICmdList, historyTarget1, historyTargetInput, historyTargetDepth, historyTargetVelocity);
-			});
-
+				FRDGTextureRef HistoryTexture = GraphBuilder.RegisterExternalTexture(InputHistory.RT[Index]);
+				HistoryBatch.Add({ HistoryTexture, FIntRect(FIntPoint::ZeroValue, HistoryTexture->Desc.Extent), FCaptureSession::Get().MakeRequest(HistoryLayers[Index]) });
+			}
+		}
+		FCaptureReadbackRHI::Get().AddBatchedReadbackPasses(GraphBuilder, HistoryBatch);
 	}
 
 	// FDLSSUpscaler::SetupMainGameViewFamily or FDLSSUpscalerEditor::SetupEditorViewFamily 
@@ -587,58 +531,26 @@ FDLSSOutputs FDLSSUpscaler::AddDLSSPass(
 	}
 
 
-	FReadSurfaceDataFlags ReadDataFlags;
-	ReadDataFlags.SetLinearToGamma(false);
-	ReadDataFlags.SetOutputStencil(false);
-	ReadDataFlags.SetMip(0);
+	if (bCapture)
+	{
+		FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, Outputs.SceneColor, FIntRect(0, 0, OutputExtent.X, OutputExtent.Y),
+			FCaptureSession::Get().MakeRequest("output"));
+		FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, Inputs.SceneColorInput, SrcRect,
+			FCaptureSession::Get().MakeRequest("input"));
 
-	
-	FRDGTexture* OutputTexture = Outputs.SceneColor;
-	AddReadbackTexturePass(GraphBuilder, RDG_EVENT_NAME("SaveBitmap"), OutputTexture,
-		[OutputTexture, OutputExtent, ReadDataFlags](FRHICommandListImmediate& RHICmdList)
+		// The combined velocity is written from its origin, at output resolution when motion vectors are dilated.
+		if (Inputs.SceneVelocityInput)
 		{
-			TArray<FFloat16Color> Bitmap;
-
-			RHICmdList.ReadSurfaceFloatData(OutputTexture->GetRHI(), FIntRect(0, 0, OutputExtent.X, OutputExtent.Y), Bitmap, ReadDataFlags);
-
-			uint32 ExtendXWithMSAA = Bitmap.Num() / OutputExtent.Y;
-			
-			std::string PathRoot = "D:/pc_code/data/map_DLSS_" + std::to_string(count) + "_" + std::to_string(OutputExtent.X) + "_" + std::to_string(OutputExtent.Y);
-			std::string Filename = PathRoot + "_output.txt";
-			int bytes = OutputExtent.X * OutputExtent.Y * 4 * 2;
-			std::ofstream b_stream(Filename.c_str(), std::fstream::out | std::fstream::binary);
-
-			if (b_stream) {
-				b_stream.write((char*)Bitmap.GetData(), bytes);
-			}
-			b_stream.close();
-
-	
-		});
+			FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, Inputs.SceneVelocityInput, FIntRect(FIntPoint::ZeroValue, Inputs.SceneVelocityInput->Desc.Extent),
+				FCaptureSession::Get().MakeRequest("velocity"));
+		}
 
-	FRDGTexture* InputTexture = Inputs.SceneColorInput;
-	AddReadbackTexturePass(GraphBuilder, RDG_EVENT_NAME("SaveBitmapInput"), InputTexture,
-		[InputTexture, SrcRect, ReadDataFlags](FRHICommandListImmediate& RHICmdList)
+		if (Inputs.SceneDepthInput)
 		{
-			TArray<FFloat16Color> Bitmap;
-
-			RHICmdList.ReadSurfaceFloatData(InputTexture->GetRHI(), SrcRect, Bitmap, ReadDataFlags);
-
-			uint32 ExtendXWithMSAA = Bitmap.Num() / SrcRect.Height();
-
-
-			std::string PathRoot = "D:/pc_code/data/map_DLSS_" + std::to_string(count) + "_" + std::to_string(SrcRect.Width()) + "_" + std::to_string(SrcRect.Height());
-			std::string Filename = PathRoot + "_input.txt";
-			int bytes = SrcRect.Width() * SrcRect.Height() * 4 * 2;
-			std::ofstream b_stream(Filename.c_str(), std::fstream::out | std::fstream::binary);
-
-			if (b_stream) {
-				b_stream.write((char*)Bitmap.GetData(), bytes);
-			}
-			b_stream.close();
-
-
-		});
+			FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, Inputs.SceneDepthInput, SrcRect,
+				FCaptureSession::Get().MakeDepthRequest(View, "depth"));
+		}
+	}
 
 
 	if (!View.bStatePrevViewInfoIsReadOnly && OutputCustomHistoryInterface)
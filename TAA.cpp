@@ -9,21 +9,10 @@
 #include "SceneTextureParameters.h"
 #include "PixelShaderUtils.h"
 #include "RendererModule.h"
-
-#include <string>
-#include <fstream>
-#include <direct.h>
-#include <iostream>
-#include <iomanip>
-#include <ctime>
-#include <sstream>
-
-int count = 0;
-bool saveFlag = false;
-
-
-std::string g_PathRoot = "E:/DLSS/data/TAA/raw/" ;
-std::string g_PathFolder = "";
+#include "CaptureFilterKernels.h"
+#include "CaptureReadbackRHI.h"
+#include "CaptureSession.h"
+#include "CaptureTapRHI.h"
 
 namespace
 {
@@ -49,7 +38,19 @@ TAutoConsoleVariable<float> CVarTemporalAAFilterSize(
 TAutoConsoleVariable<int32> CVarTemporalAACatmullRom(
 	TEXT("r.TemporalAACatmullRom"),
 	0,
-	TEXT("Whether to use a Catmull-Rom filter kernel. Should be a bit sharper than Gaussian."),
+	TEXT("Whether to use a Catmull-Rom filter kernel. Should be a bit sharper than Gaussian. Overrides r.TemporalAAFilterKernel."),
+	ECVF_Scalability | ECVF_RenderThreadSafe);
+
+TAutoConsoleVariable<int32> CVarTemporalAAFilterKernel(
+	TEXT("r.TemporalAAFilterKernel"),
+	0,
+	TEXT("Reconstruction filter of the 3x3 neighborhood, scaled by r.TemporalAAFilterSize.\n")
+	TEXT(" 0: Gaussian, sigma 0.47 (default)\n")
+	TEXT(" 1: Catmull-Rom\n")
+	TEXT(" 2: Mitchell-Netravali\n")
+	TEXT(" 3: Lanczos-2\n")
+	TEXT(" 4: Lanczos-3\n")
+	TEXT(" 5: Blackman-Harris, as the upsampling passes"),
 	ECVF_Scalability | ECVF_RenderThreadSafe);
 
 TAutoConsoleVariable<int32> CVarTemporalAAPauseCorrect(
@@ -467,15 +468,6 @@ IMPLEMENT_GLOBAL_SHADER(FTAACompareHistoryCS, "/Engine/Private/TemporalAA/TAACom
 IMPLEMENT_GLOBAL_SHADER(FTAADilateRejectionCS, "/Engine/Private/TemporalAA/TAADilateRejection.usf", "MainCS", SF_Compute);
 IMPLEMENT_GLOBAL_SHADER(FTAAUpdateHistoryCS, "/Engine/Private/TemporalAA/TAAUpdateHistory.usf", "MainCS", SF_Compute);
 
-float CatmullRom(float x)
-{
-	float ax = FMath::Abs(x);
-	if (ax > 1.0f)
-		return ((-0.5f * ax + 2.5f) * ax - 4.0f) *ax + 2.0f;
-	else
-		return (1.5f * ax - 2.5f) * ax*ax + 1.0f;
-}
-
 FVector ComputePixelFormatQuantizationError(EPixelFormat PixelFormat)
 {
 	FVector Error;
@@ -501,67 +493,30 @@ void SetupSampleWeightParameters(FTAAStandaloneCS::FParameters* OutTAAParameters
 	float JitterY = TemporalJitterPixels.Y;
 	float ResDivisorInv = 1.0f / float(PassParameters.ResolutionDivisor);
 
-	static const float SampleOffsets[9][2] =
-	{
-		{ -1.0f, -1.0f },
-		{  0.0f, -1.0f },
-		{  1.0f, -1.0f },
-		{ -1.0f,  0.0f },
-		{  0.0f,  0.0f },
-		{  1.0f,  0.0f },
-		{ -1.0f,  1.0f },
-		{  0.0f,  1.0f },
-		{  1.0f,  1.0f },
-	};
-
 	float FilterSize = CVarTemporalAAFilterSize.GetValueOnRenderThread();
-	int32 bCatmullRom = CVarTemporalAACatmullRom.GetValueOnRenderThread();
-
-	// Compute 3x3 weights
+	ECaptureFilterKernel Kernel = ECaptureFilterKernel(FMath::Clamp(CVarTemporalAAFilterKernel.GetValueOnRenderThread(), 0, int32(ECaptureFilterKernel::Count) - 1));
+	if (CVarTemporalAACatmullRom.GetValueOnRenderThread())
 	{
-		float TotalWeight = 0.0f;
-		for (int32 i = 0; i < 9; i++)
-		{
-			float PixelOffsetX = SampleOffsets[i][0] - JitterX * ResDivisorInv;
-			float PixelOffsetY = SampleOffsets[i][1] - JitterY * ResDivisorInv;
-
-			PixelOffsetX /= FilterSize;
-			PixelOffsetY /= FilterSize;
-
-			if (bCatmullRom)
-			{
-				OutTAAParameters->SampleWeights[i] = CatmullRom(PixelOffsetX) * CatmullRom(PixelOffsetY);
-				TotalWeight += OutTAAParameters->SampleWeights[i];
-			}
-			else
-			{
-				// Normal distribution, Sigma = 0.47
-				OutTAAParameters->SampleWeights[i] = FMath::Exp(-2.29f * (PixelOffsetX * PixelOffsetX + PixelOffsetY * PixelOffsetY));
-				TotalWeight += OutTAAParameters->SampleWeights[i];
-			}
-		}
-	
-		for (int32 i = 0; i < 9; i++)
-			OutTAAParameters->SampleWeights[i] /= TotalWeight;
+		Kernel = ECaptureFilterKernel::CatmullRom;
 	}
 
-	// Compute 3x3 + weights.
+	// Kernel and filter size are scalability settings: the table is only rebuilt when one of them changes, every other
+	// frame interpolates the weights of its jitter out of it.
+	static TUniquePtr<FCaptureFilterWeightTable> WeightTable;
+	if (!WeightTable.IsValid() || WeightTable->GetKernel() != Kernel || !WeightTable->Covers(FilterSize))
 	{
-		OutTAAParameters->PlusWeights[0] = OutTAAParameters->SampleWeights[1];
-		OutTAAParameters->PlusWeights[1] = OutTAAParameters->SampleWeights[3];
-		OutTAAParameters->PlusWeights[2] = OutTAAParameters->SampleWeights[4];
-		OutTAAParameters->PlusWeights[3] = OutTAAParameters->SampleWeights[5];
-		OutTAAParameters->PlusWeights[4] = OutTAAParameters->SampleWeights[7];
-		float TotalWeightPlus = (
-			OutTAAParameters->SampleWeights[1] +
-			OutTAAParameters->SampleWeights[3] +
-			OutTAAParameters->SampleWeights[4] +
-			OutTAAParameters->SampleWeights[5] +
-			OutTAAParameters->SampleWeights[7]);
-	
-		for (int32 i = 0; i < 5; i++)
-			OutTAAParameters->PlusWeights[i] /= TotalWeightPlus;
+		WeightTable = MakeUnique<FCaptureFilterWeightTable>(Kernel, FilterSize, FilterSize, 1);
 	}
+
+	float SampleWeights[9];
+	float PlusWeights[5];
+	WeightTable->Lookup(JitterX * ResDivisorInv, JitterY * ResDivisorInv, FilterSize, SampleWeights, PlusWeights);
+
+	for (int32 i = 0; i < 9; i++)
+		OutTAAParameters->SampleWeights[i] = SampleWeights[i];
+
+	for (int32 i = 0; i < 5; i++)
+		OutTAAParameters->PlusWeights[i] = PlusWeights[i];
 }
 
 DECLARE_GPU_STAT(TAA)
@@ -1064,6 +1019,9 @@ static void AddGen5MainTemporalAAPasses(
 
 	FRDGTextureRef BlackDummy = GraphBuilder.RegisterExternalTexture(GSystemTextures.BlackDummy);
 
+	// Intermediates selected by r.Capture.Taps are read back once every pass is added.
+	FCaptureTapList CaptureTaps(View, InputRect);
+
 	FTAACommonParameters CommonParameters;
 	{
 		CommonParameters.InputInfo = GetScreenPassTextureViewportParameters(FScreenPassTextureViewport(
@@ -1091,6 +1049,7 @@ static void AddGen5MainTemporalAAPasses(
 			/* InFlags = */ TexCreate_ShaderResource | TexCreate_UAV);
 
 		FRDGTextureRef DebugTexture = GraphBuilder.CreateTexture(DebugDesc, DebugName);
+		CaptureTaps.Add(DebugTexture, FIntRect(FIntPoint(0, 0), Extent));
 
 		return GraphBuilder.CreateUAV(DebugTexture);
 	};
@@ -1157,6 +1116,11 @@ static void AddGen5MainTemporalAAPasses(
 			ComputeShader,
 			PassParameters,
 			FComputeShaderUtils::GetGroupCount(InputRect.Size(), 8));
+
+		CaptureTaps.Add(DilatedVelocityTexture, InputRect);
+		CaptureTaps.Add(ClosestDepthTexture, InputRect);
+		CaptureTaps.Add(PrevUseCountTexture, InputRect);
+		CaptureTaps.Add(PrevClosestDepthTexture, InputRect);
 	}
 
 	// Setup the previous frame history
@@ -1241,6 +1205,9 @@ static void AddGen5MainTemporalAAPasses(
 			ComputeShader,
 			PassParameters,
 			FComputeShaderUtils::GetGroupCount(InputRect.Size(), 8));
+
+		CaptureTaps.Add(PredictionSceneColorTexture, LowFrequencyRect);
+		CaptureTaps.Add(ParallaxRejectionMaskTexture, LowFrequencyRect);
 	}
 
 	// Reject the history with frequency decomposition.
@@ -1280,6 +1247,9 @@ static void AddGen5MainTemporalAAPasses(
 				ComputeShader,
 				PassParameters,
 				FComputeShaderUtils::GetGroupCount(LowFrequencyRect.Size(), 8));
+
+			CaptureTaps.Add(FilteredInputTexture, LowFrequencyRect);
+			CaptureTaps.Add(FilteredPredictionSceneColorTexture, LowFrequencyRect);
 		}
 
 		// Compare the low frequencies
@@ -1310,6 +1280,8 @@ static void AddGen5MainTemporalAAPasses(
 				ComputeShader,
 				PassParameters,
 				FComputeShaderUtils::GetGroupCount(LowFrequencyRect.Size(), 8));
+
+			CaptureTaps.Add(HistoryRejectionTexture, RejectionRect);
 		}
 	}
 
@@ -1331,6 +1303,8 @@ static void AddGen5MainTemporalAAPasses(
 			ComputeShader,
 			PassParameters,
 			FComputeShaderUtils::GetGroupCount(RejectionRect.Size(), 8));
+
+		CaptureTaps.Add(DilatedHistoryRejectionTexture, RejectionRect);
 	}
 
 	TStaticArray<bool, kHistoryTextures> ExtractHistory;
@@ -1414,8 +1388,17 @@ static void AddGen5MainTemporalAAPasses(
 			ComputeShader,
 			PassParameters,
 			FComputeShaderUtils::GetGroupCount(HistorySize, 8));
+
+		const FIntRect HistoryRect(FIntPoint(0, 0), HistorySize);
+		for (int32 i = 0; i < kHistoryTextures; i++)
+		{
+			CaptureTaps.Add(History.Textures[i], HistoryRect);
+		}
+		CaptureTaps.Add(SceneColorOutputTexture, HistoryRect);
 	}
 
+	CaptureTaps.AddReadbackPasses(GraphBuilder);
+
 	if (!View.bStatePrevViewInfoIsReadOnly)
 	{
 		OutputHistory->SafeRelease();
@@ -1497,36 +1480,23 @@ static void AddGen4MainTemporalAAPasses(
 	TAAParameters.SceneVelocityTexture = PassInputs.SceneVelocityTexture;
 	TAAParameters.SceneColorInput = PassInputs.SceneColorTexture;
 
-	if (saveFlag)
+	const bool bCapture = FCaptureSession::Get().ShouldCapture(View, TAAParameters.InputViewRect);
+	if (bCapture)
 	{
-		FRDGTexture* InputTexture = TAAParameters.SceneColorInput;
-		FReadSurfaceDataFlags ReadDataFlags;
-		ReadDataFlags.SetLinearToGamma(false);
-		ReadDataFlags.SetOutputStencil(false);
-		ReadDataFlags.SetMip(0);
-		FIntRect SrcRect = TAAParameters.InputViewRect;
-
-		AddReadbackTexturePass(GraphBuilder, RDG_EVENT_NAME("SaveBitmapInput"), InputTexture,
-			[InputTexture, SrcRect, ReadDataFlags](FRHICommandListImmediate& RHICmdList)
-			{
-				TArray<FFloat16Color> Bitmap;
-
-				RHICmdList.ReadSurfaceFloatData(InputTexture->GetRHI(), SrcRect, Bitmap, ReadDataFlags);
-
-				uint32 ExtendXWithMSAA = Bitmap.Num() / SrcRect.Height();
-
-
-				std::string Filename = g_PathFolder + std::to_string(count) + "_"  + std::to_string(SrcRect.Width()) + "_" + std::to_string(SrcRect.Height()) + "_input.txt";
-				int bytes = SrcRect.Width() * SrcRect.Height() * 4 * 2;
-				std::ofstream b_stream(Filename.c_str(), std::fstream::out | std::fstream::binary);
-
-				if (b_stream) {
-					b_stream.write((char*)Bitmap.GetData(), bytes);
-				}
-				b_stream.close();
+		FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, TAAParameters.SceneColorInput, TAAParameters.InputViewRect,
+			FCaptureSession::Get().MakeRequest("input"));
 
+		if (TAAParameters.SceneVelocityTexture)
+		{
+			FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, TAAParameters.SceneVelocityTexture, TAAParameters.InputViewRect,
+				FCaptureSession::Get().MakeRequest("velocity"));
+		}
 
-			});
+		if (TAAParameters.SceneDepthTexture)
+		{
+			FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, TAAParameters.SceneDepthTexture, TAAParameters.InputViewRect,
+				FCaptureSession::Get().MakeDepthRequest(View, "depth"));
+		}
 	}
 
 	const FTemporalAAHistory& InputHistory = View.PrevViewInfo.TemporalAAHistory;
@@ -1559,6 +1529,12 @@ static void AddGen4MainTemporalAAPasses(
 		SceneColorTexture = ComputeMitchellNetravaliDownsample(GraphBuilder, View, FScreenPassTexture(SceneColorTexture, InputViewport), OutputViewport);
 	}
 
+	if (bCapture)
+	{
+		FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, SceneColorTexture, SecondaryViewRect,
+			FCaptureSession::Get().MakeRequest("output"));
+	}
+
 	*OutSceneColorTexture = SceneColorTexture;
 	*OutSceneColorViewRect = SecondaryViewRect;
 	*OutSceneColorHalfResTexture = TAAOutputs.DownsampledSceneColor;
@@ -1585,46 +1561,6 @@ public:
 		FRDGTextureRef* OutSceneColorHalfResTexture,
 		FIntRect* OutSceneColorHalfResViewRect) const final
 	{
-		
-		FTAAPassParameters TAAParametersTemp(View);
-		const FIntRect SrcRect = TAAParametersTemp.InputViewRect;
-		const FIntRect DestRect = TAAParametersTemp.OutputViewRect;
-
-		int input_height = SrcRect.Height();
-		if ((input_height == 360) || (input_height == 720))
-		{
-			
-			if (count == 0) {
-				/*auto t = std::time(nullptr);
-				auto tm = *std::localtime(&t);
-
-				std::ostringstream oss;
-				std::put_time(&tm, "%d-%m-%Y %H-%M-%S");
-				auto time_str = oss.str();*/
-
-				time_t rawtime;
-				struct tm* timeinfo;
-				char buffer[80];
-
-				time(&rawtime);
-				timeinfo = localtime(&rawtime);
-
-				strftime(buffer, sizeof(buffer), "%m_%d_%H_%M", timeinfo);
-				std::string time_str(buffer);
-
-				g_PathFolder = g_PathRoot + time_str;
-				_mkdir(g_PathFolder.c_str());
-				g_PathFolder += "/";
-			}
-			
-
-			saveFlag = true;
-			count += 1;
-		}else{
-			saveFlag = false;
-		}
-
-		
 		if (CVarTAAAlgorithm.GetValueOnRenderThread() && DoesPlatformSupportGen5TAA(View.GetShaderPlatform()))
 		{
 			*OutSceneColorHalfResTexture = nullptr;
@@ -0,0 +1,197 @@
+import ctypes
+import os
+import sys
+
+import numpy as np
+
+# Thin ctypes binding over CaptureReader.cpp, and CaptureImage.cpp for float conversion. Build the library next to this file with
+#   g++ -O2 -mavx2 -shared -fPIC CaptureContainer.cpp CaptureReader.cpp CaptureCompress.cpp CaptureHalf.cpp CaptureImage.cpp CapturePack.cpp
+#       CapturePixelFormat.cpp CaptureTrace.cpp -o libcapture_reader.so
+# or on Windows
+#   cl /O2 /arch:AVX2 /LD CaptureContainer.cpp CaptureReader.cpp CaptureCompress.cpp CaptureHalf.cpp CaptureImage.cpp CapturePack.cpp
+#       CapturePixelFormat.cpp CaptureTrace.cpp /Fe:capture_reader.dll
+# Without AVX2 the halves are converted one at a time.
+
+
+class _CaptureView(ctypes.Structure):
+    _fields_ = [
+        ("data", ctypes.c_void_p),
+        ("shape", ctypes.c_int64 * 3),
+        ("strides", ctypes.c_int64 * 3),
+        ("element_type", ctypes.c_int32),
+        ("pixel_format", ctypes.c_uint32),
+        ("frame_id", ctypes.c_uint64),
+    ]
+
+
+class _CaptureFrameInfo(ctypes.Structure):
+    _fields_ = [
+        ("jitter_x", ctypes.c_float),
+        ("jitter_y", ctypes.c_float),
+        ("pre_exposure", ctypes.c_float),
+        ("flags", ctypes.c_uint32),
+        ("num_layers", ctypes.c_uint32),
+        ("num_dropped", ctypes.c_uint32),
+        ("rate_level", ctypes.c_uint32),
+    ]
+
+
+_FRAME_CAMERA_CUT = 1
+_FRAME_LAYERS_SHED = 2
+
+# UNorm24 (packed depth) has no numpy type, its 3 bytes are viewed as uint8 and widened by _widen_unorm24().
+_ELEMENT_UNORM24 = 7
+_ELEMENT_TYPES = [np.uint8, np.float16, np.float32, np.uint16, np.int16, np.uint32, np.int32, np.uint8]
+
+
+def _widen_unorm24(array):
+    """(rows, cols, channels, 3) little endian bytes to float32 step centers, as CaptureUnpackUNorm24() does."""
+    packed = array[..., 0].astype(np.uint32) | (array[..., 1].astype(np.uint32) << 8) | (array[..., 2].astype(np.uint32) << 16)
+    return ((packed.astype(np.float64) + 0.5) / float(1 << 24)).astype(np.float32)
+
+
+def _make_array(view, buffer, offset):
+    shape = tuple(view.shape)
+    strides = tuple(view.strides)
+    if view.element_type == _ELEMENT_UNORM24:
+        return _widen_unorm24(np.ndarray(shape + (3,), dtype=np.uint8, buffer=buffer, offset=offset, strides=strides + (1,)))
+    return np.ndarray(shape, dtype=_ELEMENT_TYPES[view.element_type], buffer=buffer, offset=offset, strides=strides)
+
+
+def _load_library():
+    lib_name = "capture_reader.dll" if sys.platform == "win32" else "libcapture_reader.so"
+    lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), lib_name))
+
+    lib.CaptureReaderOpen.restype = ctypes.c_void_p
+    lib.CaptureReaderOpen.argtypes = [ctypes.c_char_p]
+    lib.CaptureReaderClose.argtypes = [ctypes.c_void_p]
+    lib.CaptureReaderNumFrames.restype = ctypes.c_uint32
+    lib.CaptureReaderNumFrames.argtypes = [ctypes.c_void_p]
+    lib.CaptureReaderFrameId.restype = ctypes.c_uint64
+    lib.CaptureReaderFrameId.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.CaptureReaderNumLayers.restype = ctypes.c_uint32
+    lib.CaptureReaderNumLayers.argtypes = [ctypes.c_void_p]
+    lib.CaptureReaderLayerName.restype = ctypes.c_char_p
+    lib.CaptureReaderLayerName.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.CaptureReaderGetView.restype = ctypes.c_int32
+    lib.CaptureReaderGetView.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(_CaptureView)]
+    lib.CaptureReaderDecodedSize.restype = ctypes.c_uint64
+    lib.CaptureReaderDecodedSize.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_char_p]
+    lib.CaptureReaderDecodeView.restype = ctypes.c_int32
+    lib.CaptureReaderDecodeView.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.POINTER(_CaptureView)]
+    lib.CaptureReaderPrefetch.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+    lib.CaptureReaderFrameInfo.restype = ctypes.c_int32
+    lib.CaptureReaderFrameInfo.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.POINTER(_CaptureFrameInfo)]
+    lib.CaptureReaderNumFloatPlanes.restype = ctypes.c_int32
+    lib.CaptureReaderNumFloatPlanes.argtypes = [ctypes.POINTER(_CaptureView)]
+    lib.CaptureReaderConvertToFloat.restype = ctypes.c_int32
+    lib.CaptureReaderConvertToFloat.argtypes = [ctypes.POINTER(_CaptureView), ctypes.c_void_p]
+    return lib
+
+
+_lib = None
+
+
+class CaptureReader:
+    """Memory-mapped .ucap reader. Arrays returned by view() alias the mapping and must not outlive the reader."""
+
+    def __init__(self, path):
+        global _lib
+        if _lib is None:
+            _lib = _load_library()
+
+        self._handle = _lib.CaptureReaderOpen(path.encode("utf-8"))
+        if not self._handle:
+            raise IOError("cannot open capture {}".format(path))
+
+    def close(self):
+        if self._handle:
+            _lib.CaptureReaderClose(self._handle)
+            self._handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __len__(self):
+        return _lib.CaptureReaderNumFrames(self._handle)
+
+    def frame_id(self, index):
+        return _lib.CaptureReaderFrameId(self._handle, index)
+
+    def layers(self):
+        return [_lib.CaptureReaderLayerName(self._handle, i).decode("utf-8") for i in range(_lib.CaptureReaderNumLayers(self._handle))]
+
+    def prefetch(self, index):
+        _lib.CaptureReaderPrefetch(self._handle, index)
+
+    def frame_info(self, index):
+        """Returns the metadata of frame `index`, or None if it was not captured as a bundle."""
+        info = _CaptureFrameInfo()
+        if not _lib.CaptureReaderFrameInfo(self._handle, index, ctypes.byref(info)):
+            return None
+        return {
+            "jitter": (info.jitter_x, info.jitter_y),
+            "pre_exposure": info.pre_exposure,
+            "camera_cut": bool(info.flags & _FRAME_CAMERA_CUT),
+            "layers": info.num_layers,
+            "dropped_layers": info.num_dropped,
+            "rate_level": info.rate_level,
+            "layers_shed": bool(info.flags & _FRAME_LAYERS_SHED),
+        }
+
+    def _get_view(self, index, layer, component):
+        """Returns the view of frame `index` of `layer` and the array holding its pixels if they had to be decoded."""
+        view = _CaptureView()
+        name = layer.encode("utf-8")
+        if _lib.CaptureReaderGetView(self._handle, index, name, component.encode("utf-8"), ctypes.byref(view)):
+            return view, None
+
+        size = _lib.CaptureReaderDecodedSize(self._handle, index, name)
+        decoded = np.empty(size, dtype=np.uint8)
+        if not size or not _lib.CaptureReaderDecodeView(self._handle, index, name, component.encode("utf-8"), decoded.ctypes.data, size, ctypes.byref(view)):
+            raise KeyError("frame {} has no layer {} {}".format(index, layer, component))
+        return view, decoded
+
+    def view(self, index, layer, component=""):
+        """Returns a (rows, cols, channels) array over frame `index` of `layer` without copying.
+
+        component: "" for every channel, "rgb" for color, "depth" or "stencil" for depth/stencil layers.
+        Compressed layers are decoded into a new array instead, and 24 bit packed depth is widened to float32.
+        """
+        view, decoded = self._get_view(index, layer, component)
+        if decoded is not None:
+            return _make_array(view, decoded, view.data - decoded.ctypes.data)
+
+        shape = tuple(view.shape)
+        strides = tuple(view.strides)
+        # BGR ordered views walk backwards, so the buffer may start before view.data.
+        low = sum(min(0, (n - 1) * s) for n, s in zip(shape, strides))
+        itemsize = 3 if view.element_type == _ELEMENT_UNORM24 else np.dtype(_ELEMENT_TYPES[view.element_type]).itemsize
+        high = sum(max(0, (n - 1) * s) for n, s in zip(shape, strides)) + itemsize
+        buffer = (ctypes.c_uint8 * (high - low)).from_address(view.data + low)
+        array = _make_array(view, buffer, -low)
+        array.flags.writeable = False
+        return array
+
+    def image(self, index, layer, component=""):
+        """Returns frame `index` of `layer` as a new float32 (rows, cols, channels) array, as the C++ tools load it.
+
+        Halves are widened by the SIMD conversion of CaptureHalf.cpp rather than np.float16, unsigned normalized
+        formats are scaled to [0, 1] and FloatR11G11B10 is unpacked into red, green and blue.
+        """
+        view, decoded = self._get_view(index, layer, component)
+        planes = np.empty((_lib.CaptureReaderNumFloatPlanes(ctypes.byref(view)), view.shape[0], view.shape[1]), dtype=np.float32)
+        if not _lib.CaptureReaderConvertToFloat(ctypes.byref(view), planes.ctypes.data):
+            raise TypeError("layer {} has no float meaning".format(layer))
+        return planes.transpose(1, 2, 0)
+
+
+if __name__ == "__main__":
+    with CaptureReader(sys.argv[1]) as reader:
+        print("frames:{}, layers:{}".format(len(reader), reader.layers()))
+        for layer in reader.layers():
+            color = reader.view(0, layer)
+            print("layer:{}, shape:{}, dtype:{}, strides:{}".format(layer, color.shape, color.dtype, color.strides))
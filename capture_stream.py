@@ -0,0 +1,163 @@
+import mmap
+import os
+import struct
+import sys
+import time
+
+import numpy as np
+
+# Reference consumer of the live capture stream (r.Capture.Stream, layout in CaptureStream.h). Pure Python: maps
+# /dev/shm/<name> read only and follows the seqlock of every slot, so it never slows the engine down. Linux only.
+
+_STREAM_MAGIC = 0x54534355
+_STREAM_VERSION = 1
+_STREAM_CLOSED = 1
+_FRAME_CAMERA_CUT = 1
+_FRAME_LAYERS_SHED = 2
+
+_HEADER = struct.Struct("<IIIIQQQ")
+_SLOT = struct.Struct("<QQ")
+_FRAME_INFO = struct.Struct("<IIQfffIII")
+_LAYER = struct.Struct("<32siiIIHHIQQQ")
+_LAYERS_OFFSET = 16 + 64
+
+# Channels and element type of the raw layouts, keyed by CapturePixelFormat.h. Anything else is exposed as bytes.
+_PIXEL_FORMATS = {
+    1: (4, np.float32),   # A32B32G32R32F
+    2: (4, np.uint8),     # B8G8R8A8
+    3: (1, np.uint8),     # G8
+    4: (1, np.uint16),    # G16
+    10: (4, np.float16),  # FloatRGBA
+    13: (1, np.float32),  # R32_FLOAT
+    15: (2, np.float16),  # G16R16F
+    17: (2, np.float32),  # G32R32F
+    21: (1, np.float16),  # R16F
+    37: (4, np.uint8),    # R8G8B8A8
+    96: (3, np.float16),  # PackedFloat16RGB
+    97: (1, np.float16),  # PackedDepth16F
+}
+
+
+class CaptureStream:
+    """Reads frames as they are published. Frames the reader falls behind on are skipped, never waited for."""
+
+    def __init__(self, name="ue_capture"):
+        with open(os.path.join("/dev/shm", name.lstrip("/")), "rb") as file:
+            self._map = mmap.mmap(file.fileno(), 0, prot=mmap.PROT_READ)
+        magic, version, self._num_slots, _, self._slot_size, self._slots_offset, published = _HEADER.unpack_from(self._map, 0)
+        if magic != _STREAM_MAGIC or version != _STREAM_VERSION:
+            self._map.close()
+            raise IOError("{} is not a capture stream".format(name))
+        self._buffer = memoryview(self._map)
+        self._next_epoch = max(published, 1) - 1
+        self.skipped = 0
+        self.torn = 0
+
+    def close(self):
+        if self._map:
+            self._buffer.release()
+            self._map.close()
+            self._map = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def closed(self):
+        return bool(_HEADER.unpack_from(self._map, 0)[3] & _STREAM_CLOSED)
+
+    def _slot(self, epoch):
+        return self._slots_offset + (epoch % self._num_slots) * self._slot_size
+
+    def _sequence(self, slot):
+        return _SLOT.unpack_from(self._map, slot)[0]
+
+    def _begin(self):
+        """Returns (slot, sequence) of the next frame to read, or None if none was published since."""
+        while True:
+            published = _HEADER.unpack_from(self._map, 0)[6]
+            if self._next_epoch >= published:
+                return None
+            oldest = published - self._num_slots + 1 if published >= self._num_slots else 0
+            if self._next_epoch < oldest:
+                self.skipped += oldest - self._next_epoch
+                self._next_epoch = oldest
+
+            slot = self._slot(self._next_epoch)
+            sequence, epoch = _SLOT.unpack_from(self._map, slot)
+            if sequence & 1 or epoch != self._next_epoch:
+                self.skipped += 1
+                self._next_epoch += 1
+                continue
+            self._next_epoch += 1
+            return slot, sequence
+
+    def _parse(self, slot):
+        _, num_layers, frame_id, jitter_x, jitter_y, pre_exposure, flags, num_dropped, rate_level = _FRAME_INFO.unpack_from(self._map, slot + 16)
+        frame = {
+            "frame_id": frame_id,
+            "jitter": (jitter_x, jitter_y),
+            "pre_exposure": pre_exposure,
+            "camera_cut": bool(flags & _FRAME_CAMERA_CUT),
+            "dropped_layers": num_dropped,
+            "rate_level": rate_level,
+            "layers_shed": bool(flags & _FRAME_LAYERS_SHED),
+            "layers": {},
+        }
+        for index in range(min(num_layers, 16)):
+            name, width, height, pixel_format, bytes_per_pixel, codec, _, _, offset, size, _ = _LAYER.unpack_from(self._map, slot + _LAYERS_OFFSET + index * _LAYER.size)
+            data = self._buffer[slot + offset:slot + offset + size]
+            channels, dtype = _PIXEL_FORMATS.get(pixel_format, (bytes_per_pixel, np.uint8))
+            if codec == 0 and size == width * height * channels * np.dtype(dtype).itemsize:
+                array = np.frombuffer(data, dtype=dtype).reshape(height, width, channels)
+            else:
+                # Compressed, or a layout without a numpy type such as depth/stencil: the payload as it was captured.
+                array = np.frombuffer(data, dtype=np.uint8)
+            frame["layers"][name.rstrip(b"\0").decode("utf-8")] = array
+        return frame
+
+    def read(self, copy=True):
+        """Returns the next frame, or None if there is no new one yet.
+
+        With copy=False the arrays alias the ring and the writer may overwrite them at any time: check
+        still_valid(frame) after using them and throw away whatever was computed if it returns False.
+        """
+        while True:
+            begin = self._begin()
+            if begin is None:
+                return None
+            slot, sequence = begin
+            frame = self._parse(slot)
+            if copy:
+                frame["layers"] = {name: np.array(array) for name, array in frame["layers"].items()}
+            frame["_slot"] = (slot, sequence)
+            if not copy or self.still_valid(frame):
+                return frame
+
+    def still_valid(self, frame):
+        """True when the slot of `frame` was not overwritten since read() returned it."""
+        slot, sequence = frame["_slot"]
+        if self._sequence(slot) == sequence:
+            return True
+        self.torn += 1
+        return False
+
+
+if __name__ == "__main__":
+    with CaptureStream(sys.argv[1] if len(sys.argv) > 1 else "ue_capture") as stream:
+        num_frames = 0
+        start = time.time()
+        while True:
+            frame = stream.read()
+            if frame is None:
+                if stream.closed():
+                    break
+                time.sleep(0.001)
+                continue
+            num_frames += 1
+            shapes = ", ".join("{}:{}".format(name, array.shape) for name, array in frame["layers"].items())
+            print("frame:{}, jitter:{}, camera_cut:{}, {}".format(frame["frame_id"], frame["jitter"], frame["camera_cut"], shapes))
+        elapsed = max(time.time() - start, 1e-6)
+        print("read:{}, skipped:{}, torn:{}, {:.1f} fps".format(num_frames, stream.skipped, stream.torn, num_frames / elapsed))
@@ -50,21 +50,8 @@
 #include "ScreenSpaceRayTracing.h"
 #include "SceneViewExtension.h"
 #include "FXSystem.h"
-
-
-#include <string>
-#include <fstream>
-#include <direct.h>
-#include <iostream>
-#include <iomanip>
-#include <ctime>
-#include <sstream>
-
-int count1 = 0;
-
-
-std::string g_PathRoot_1 = "E:/DLSS/data/TAA/raw/";
-std::string g_PathFolder_1 = "";
+#include "CaptureReadbackRHI.h"
+#include "CaptureSession.h"
 
 /** The global center for all post processing activities. */
 FPostProcessing GPostProcessing;
@@ -532,57 +519,9 @@ void AddPostProcessingPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, i
 		// Scene color view rectangle after temporal AA upscale to secondary screen percentage.
 		FIntRect SecondaryViewRect = PrimaryViewRect;
 
-		
-		FIntRect inputRect_temp = SceneColor.ViewRect;
-		int height_temp = inputRect_temp.Height();
-		if ((height_temp == 360) || (height_temp == 720))
+		// The first layer r.Capture.RateControl sheds when the writers fall behind.
+		if (FCaptureSession::Get().ShouldCapture(View, SceneColor.ViewRect) && FCaptureSession::Get().ShouldCaptureLayer("input_post"))
 		{
-			if (count1 == 0) {
-
-				time_t rawtime;
-				struct tm* timeinfo;
-				char buffer[80];
-
-				time(&rawtime);
-				timeinfo = localtime(&rawtime);
-
-				strftime(buffer, sizeof(buffer), "%m_%d_%H_%M", timeinfo);
-				std::string time_str(buffer);
-
-				g_PathFolder_1 = g_PathRoot_1 + time_str;
-				_mkdir(g_PathFolder_1.c_str());
-				g_PathFolder_1 += "/";
-			}
-			count1++;
-
-
-			FRDGTexture* InputTexture = SceneColor.Texture;
-			FReadSurfaceDataFlags ReadDataFlags;
-			ReadDataFlags.SetLinearToGamma(false);
-			ReadDataFlags.SetOutputStencil(false);
-			ReadDataFlags.SetMip(0);
-			FIntRect SrcRect = inputRect_temp;
-
-			AddReadbackTexturePass(GraphBuilder, RDG_EVENT_NAME("SaveBitmapInput1"), InputTexture,
-				[InputTexture, SrcRect, ReadDataFlags](FRHICommandListImmediate& RHICmdList)
-				{
-					TArray<FFloat16Color> Bitmap;
-
-					RHICmdList.ReadSurfaceFloatData(InputTexture->GetRHI(), SrcRect, Bitmap, ReadDataFlags);
-
-					uint32 ExtendXWithMSAA = Bitmap.Num() / SrcRect.Height();
-
-
-					std::string Filename = g_PathFolder_1 + std::to_string(count1) + "_" + std::to_string(SrcRect.Width()) + "_" + std::to_string(SrcRect.Height()) + "_input_post.txt";
-					int bytes = SrcRect.Width() * SrcRect.Height() * 4 * 2;
-					std::ofstream b_stream(Filename.c_str(), std::fstream::out | std::fstream::binary);
-
-					if (b_stream) {
-						b_stream.write((char*)Bitmap.GetData(), bytes);
-					}
-					b_stream.close();
-
-
-				});
-
+			FCaptureReadbackRHI::Get().AddReadbackPass(GraphBuilder, SceneColor.Texture, SceneColor.ViewRect,
+				FCaptureSession::Get().MakeRequest("input_post"));
 		}
\ No newline at end of file
@@ -5,6 +5,9 @@ import os
 import OpenEXR
 import Imath
 
+# Batch conversion is done by CaptureConvert.cpp, which reads .ucap containers and legacy dumps on all cores.
+# This script is kept for converting a handful of legacy dumps by hand.
+
 
 def binaryToEXR(file_name, exr_name, rows, cols, layer):
     print("file_name:{}".format(file_name))